@@ -153,7 +153,7 @@ CommandLineHandler::CommandLineHandler()
     parser().add_option_handler(
         &m_checkpoint_create
             .add_name("--checkpoint-create")
-            .set_description("write a rendering checkpoint after each pass")
+            .set_description("write a rendering checkpoint (.checkpoint file) after each pass")
             .set_syntax("filename")
             .set_min_value_count(0)
             .set_max_value_count(1));
@@ -161,7 +161,7 @@ CommandLineHandler::CommandLineHandler()
     parser().add_option_handler(
         &m_checkpoint_resume
             .add_name("--checkpoint-resume")
-            .set_description("resume rendering from a checkpoint")
+            .set_description("resume rendering from a .checkpoint file or a legacy .exr checkpoint")
             .set_syntax("filename")
             .set_min_value_count(0)
             .set_max_value_count(1));
@@ -0,0 +1,399 @@
+
+//
+// This source file is part of appleseed.
+// Visit https://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2019 The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+// appleseed.foundation headers.
+#include "foundation/platform/compiler.h"
+#ifdef APPLESEED_USE_SSE
+#include "foundation/platform/sse.h"
+#endif
+
+// Standard headers.
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+namespace foundation {
+namespace bvh {
+
+//
+// Compact node (leaf node or interior node) of a BVH.
+//
+// This node offers the same interface as foundation::bvh::Node<AABB> but stores
+// the bounding boxes of its child nodes in single precision, regardless of the
+// precision of AABB. Bounding boxes are rounded outward so that they always
+// enclose the original, full precision bounding boxes: traversal may visit a few
+// more nodes but never misses an intersection.
+//
+// Node type, item count and motion bounding box counts are packed into a single
+// 32-bit word, such that a 3D node fits in 64 bytes (half the size of a 3D node
+// with double precision bounding boxes).
+//
+
+template <typename AABB>
+class APPLESEED_ALIGN(64) CompactNode
+{
+  public:
+    typedef AABB AABBType;
+
+    // Set/get the node type.
+    void make_interior();
+    void make_leaf();
+    bool is_interior() const;
+    bool is_leaf() const;
+
+    // Set/get the bounding boxes of the child nodes (interior nodes only, static case).
+    void set_left_bbox(const AABBType& bbox);
+    void set_right_bbox(const AABBType& bbox);
+    AABBType get_left_bbox() const;
+    AABBType get_right_bbox() const;
+
+    // Set/get the bounding boxes of the child nodes (interior nodes only, motion case).
+    void set_left_bbox_index(const size_t index);
+    void set_left_bbox_count(const size_t count);
+    void set_right_bbox_index(const size_t index);
+    void set_right_bbox_count(const size_t count);
+    size_t get_left_bbox_index() const;
+    size_t get_left_bbox_count() const;
+    size_t get_right_bbox_index() const;
+    size_t get_right_bbox_count() const;
+
+    // Access user data (leaf nodes only).
+    static const size_t MaxUserDataSize;
+    template <typename U> void set_user_data(const U& data);
+    template <typename U> const U& get_user_data() const;
+    template <typename U> U& get_user_data();
+
+    // Set/get the index of the first child node (interior nodes only).
+    void set_child_node_index(const size_t index);
+    size_t get_child_node_index() const;
+
+    // Set/get the index of the first item (leaf nodes only).
+    void set_item_index(const size_t index);
+    size_t get_item_index() const;
+
+    // Set/get the item count (leaf nodes only).
+    void set_item_count(const size_t count);
+    size_t get_item_count() const;
+
+  private:
+    template <typename Tree, typename Visitor, typename Ray, size_t StackSize, size_t N>
+    friend class Intersector;
+
+    typedef typename AABBType::ValueType ValueType;
+    static const size_t Dimension = AABBType::Dimension;
+
+    static const std::uint32_t InteriorFlag = 0x80000000u;
+    static const std::uint32_t CountMask = 0x00007FFFu;
+    static const size_t RightCountShift = 15;
+
+    std::uint32_t                   m_info;                 // interior flag, item count or motion bbox counts
+    std::uint32_t                   m_index;
+
+    // Leaf nodes store their user data in place of the following fields.
+    std::uint32_t                   m_left_bbox_index;
+    std::uint32_t                   m_right_bbox_index;
+    APPLESEED_SIMD4_ALIGN float     m_bbox_data[4 * Dimension];
+
+    static float round_down(const ValueType x);
+    static float round_up(const ValueType x);
+
+    // Retrieve the bounding box coordinate at a given index, using the layout of Node<AABB>::m_bbox_data.
+    ValueType get_bbox_data(const size_t index) const;
+
+#ifdef APPLESEED_USE_SSE
+    // Load two consecutive bounding box coordinates into an SSE register, in double precision.
+    __m128d load_bbox_data(const size_t index) const;
+#endif
+};
+
+
+//
+// CompactNode class implementation.
+//
+
+template <typename AABB>
+inline void CompactNode<AABB>::make_interior()
+{
+    m_info = InteriorFlag;
+}
+
+template <typename AABB>
+inline void CompactNode<AABB>::make_leaf()
+{
+    if (m_info & InteriorFlag)
+        m_info = 0;
+}
+
+template <typename AABB>
+inline bool CompactNode<AABB>::is_interior() const
+{
+    return (m_info & InteriorFlag) != 0;
+}
+
+template <typename AABB>
+inline bool CompactNode<AABB>::is_leaf() const
+{
+    return (m_info & InteriorFlag) == 0;
+}
+
+template <typename AABB>
+inline float CompactNode<AABB>::round_down(const ValueType x)
+{
+    const float y = static_cast<float>(x);
+    return static_cast<ValueType>(y) > x ? std::nextafter(y, -std::numeric_limits<float>::max()) : y;
+}
+
+template <typename AABB>
+inline float CompactNode<AABB>::round_up(const ValueType x)
+{
+    const float y = static_cast<float>(x);
+    return static_cast<ValueType>(y) < x ? std::nextafter(y, std::numeric_limits<float>::max()) : y;
+}
+
+template <typename AABB>
+inline void CompactNode<AABB>::set_left_bbox(const AABBType& bbox)
+{
+    assert(is_interior());
+
+    for (size_t i = 0; i < Dimension; ++i)
+    {
+        m_bbox_data[i * 4 + 0] = round_down(bbox.min[i]);
+        m_bbox_data[i * 4 + 2] = round_up(bbox.max[i]);
+    }
+}
+
+template <typename AABB>
+inline void CompactNode<AABB>::set_right_bbox(const AABBType& bbox)
+{
+    assert(is_interior());
+
+    for (size_t i = 0; i < Dimension; ++i)
+    {
+        m_bbox_data[i * 4 + 1] = round_down(bbox.min[i]);
+        m_bbox_data[i * 4 + 3] = round_up(bbox.max[i]);
+    }
+}
+
+template <typename AABB>
+inline AABB CompactNode<AABB>::get_left_bbox() const
+{
+    assert(is_interior());
+
+    AABBType bbox;
+
+    for (size_t i = 0; i < Dimension; ++i)
+    {
+        bbox.min[i] = static_cast<ValueType>(m_bbox_data[i * 4 + 0]);
+        bbox.max[i] = static_cast<ValueType>(m_bbox_data[i * 4 + 2]);
+    }
+
+    return bbox;
+}
+
+template <typename AABB>
+inline AABB CompactNode<AABB>::get_right_bbox() const
+{
+    assert(is_interior());
+
+    AABBType bbox;
+
+    for (size_t i = 0; i < Dimension; ++i)
+    {
+        bbox.min[i] = static_cast<ValueType>(m_bbox_data[i * 4 + 1]);
+        bbox.max[i] = static_cast<ValueType>(m_bbox_data[i * 4 + 3]);
+    }
+
+    return bbox;
+}
+
+template <typename AABB>
+inline void CompactNode<AABB>::set_left_bbox_index(const size_t index)
+{
+    assert(is_interior());
+    assert(index <= 0xFFFFFFFFu);
+    m_left_bbox_index = static_cast<std::uint32_t>(index);
+}
+
+template <typename AABB>
+inline void CompactNode<AABB>::set_left_bbox_count(const size_t count)
+{
+    assert(is_interior());
+    assert(count <= CountMask);
+    m_info = (m_info & ~CountMask) | static_cast<std::uint32_t>(count);
+}
+
+template <typename AABB>
+inline void CompactNode<AABB>::set_right_bbox_index(const size_t index)
+{
+    assert(is_interior());
+    assert(index <= 0xFFFFFFFFu);
+    m_right_bbox_index = static_cast<std::uint32_t>(index);
+}
+
+template <typename AABB>
+inline void CompactNode<AABB>::set_right_bbox_count(const size_t count)
+{
+    assert(is_interior());
+    assert(count <= CountMask);
+    m_info =
+        (m_info & ~(CountMask << RightCountShift)) |
+        (static_cast<std::uint32_t>(count) << RightCountShift);
+}
+
+template <typename AABB>
+inline size_t CompactNode<AABB>::get_left_bbox_index() const
+{
+    assert(is_interior());
+    return static_cast<size_t>(m_left_bbox_index);
+}
+
+template <typename AABB>
+inline size_t CompactNode<AABB>::get_left_bbox_count() const
+{
+    assert(is_interior());
+    return static_cast<size_t>(m_info & CountMask);
+}
+
+template <typename AABB>
+inline size_t CompactNode<AABB>::get_right_bbox_index() const
+{
+    assert(is_interior());
+    return static_cast<size_t>(m_right_bbox_index);
+}
+
+template <typename AABB>
+inline size_t CompactNode<AABB>::get_right_bbox_count() const
+{
+    assert(is_interior());
+    return static_cast<size_t>((m_info >> RightCountShift) & CountMask);
+}
+
+#define MAX_USER_DATA_SIZE (2 * sizeof(std::uint32_t) + 4 * CompactNode<AABB>::Dimension * sizeof(float))
+
+template <typename AABB>
+const size_t CompactNode<AABB>::MaxUserDataSize = MAX_USER_DATA_SIZE;
+
+template <typename AABB>
+template <typename U>
+inline void CompactNode<AABB>::set_user_data(const U& data)
+{
+    assert(is_leaf());
+    get_user_data<U>() = data;
+}
+
+template <typename AABB>
+template <typename U>
+inline const U& CompactNode<AABB>::get_user_data() const
+{
+    static_assert(sizeof(U) <= MAX_USER_DATA_SIZE, "Not enough space in BVH node for user data");
+    assert(is_leaf());
+    return *reinterpret_cast<const U*>(&m_left_bbox_index);
+}
+
+template <typename AABB>
+template <typename U>
+inline U& CompactNode<AABB>::get_user_data()
+{
+    static_assert(sizeof(U) <= MAX_USER_DATA_SIZE, "Not enough space in BVH node for user data");
+    assert(is_leaf());
+    return *reinterpret_cast<U*>(&m_left_bbox_index);
+}
+
+#undef MAX_USER_DATA_SIZE
+
+template <typename AABB>
+inline void CompactNode<AABB>::set_child_node_index(const size_t index)
+{
+    assert(is_interior());
+    assert(index <= 0xFFFFFFFFu);
+    m_index = static_cast<std::uint32_t>(index);
+}
+
+template <typename AABB>
+inline size_t CompactNode<AABB>::get_child_node_index() const
+{
+    assert(is_interior());
+    return static_cast<size_t>(m_index);
+}
+
+template <typename AABB>
+inline void CompactNode<AABB>::set_item_index(const size_t index)
+{
+    assert(is_leaf());
+    assert(index <= 0xFFFFFFFFu);
+    m_index = static_cast<std::uint32_t>(index);
+}
+
+template <typename AABB>
+inline size_t CompactNode<AABB>::get_item_index() const
+{
+    assert(is_leaf());
+    return static_cast<size_t>(m_index);
+}
+
+template <typename AABB>
+inline void CompactNode<AABB>::set_item_count(const size_t count)
+{
+    assert(is_leaf());
+    assert(count < InteriorFlag);
+    m_info = static_cast<std::uint32_t>(count);
+}
+
+template <typename AABB>
+inline size_t CompactNode<AABB>::get_item_count() const
+{
+    assert(is_leaf());
+    return static_cast<size_t>(m_info);
+}
+
+template <typename AABB>
+inline typename CompactNode<AABB>::ValueType CompactNode<AABB>::get_bbox_data(const size_t index) const
+{
+    return static_cast<ValueType>(m_bbox_data[index]);
+}
+
+#ifdef APPLESEED_USE_SSE
+
+template <typename AABB>
+inline __m128d CompactNode<AABB>::load_bbox_data(const size_t index) const
+{
+    // Load two floats into the lower half of a register, then widen them to doubles.
+    return
+        _mm_cvtps_pd(
+            _mm_castpd_ps(
+                _mm_load_sd(reinterpret_cast<const double*>(m_bbox_data + index))));
+}
+
+#endif
+
+}   // namespace bvh
+}   // namespace foundation
@@ -516,12 +516,12 @@ void Intersector<Tree, Visitor, Ray3d, StackSize, 3>::intersect_no_motion(
         {
             FOUNDATION_BVH_TRAVERSAL_STATS(intersected_bboxes += 2);
 
-            const __m128d xl1 = _mm_mul_pd(rcp_dir_x, _mm_sub_pd(_mm_load_pd(node_ptr->m_bbox_data + 0 + 2 * (1 - ray_info.m_sgn_dir.x)), org_x));
-            const __m128d xl2 = _mm_mul_pd(rcp_dir_x, _mm_sub_pd(_mm_load_pd(node_ptr->m_bbox_data + 0 + 2 * (    ray_info.m_sgn_dir.x)), org_x));
-            const __m128d yl1 = _mm_mul_pd(rcp_dir_y, _mm_sub_pd(_mm_load_pd(node_ptr->m_bbox_data + 4 + 2 * (1 - ray_info.m_sgn_dir.y)), org_y));
-            const __m128d yl2 = _mm_mul_pd(rcp_dir_y, _mm_sub_pd(_mm_load_pd(node_ptr->m_bbox_data + 4 + 2 * (    ray_info.m_sgn_dir.y)), org_y));
-            const __m128d zl1 = _mm_mul_pd(rcp_dir_z, _mm_sub_pd(_mm_load_pd(node_ptr->m_bbox_data + 8 + 2 * (1 - ray_info.m_sgn_dir.z)), org_z));
-            const __m128d zl2 = _mm_mul_pd(rcp_dir_z, _mm_sub_pd(_mm_load_pd(node_ptr->m_bbox_data + 8 + 2 * (    ray_info.m_sgn_dir.z)), org_z));
+            const __m128d xl1 = _mm_mul_pd(rcp_dir_x, _mm_sub_pd(node_ptr->load_bbox_data(0 + 2 * (1 - ray_info.m_sgn_dir.x)), org_x));
+            const __m128d xl2 = _mm_mul_pd(rcp_dir_x, _mm_sub_pd(node_ptr->load_bbox_data(0 + 2 * (    ray_info.m_sgn_dir.x)), org_x));
+            const __m128d yl1 = _mm_mul_pd(rcp_dir_y, _mm_sub_pd(node_ptr->load_bbox_data(4 + 2 * (1 - ray_info.m_sgn_dir.y)), org_y));
+            const __m128d yl2 = _mm_mul_pd(rcp_dir_y, _mm_sub_pd(node_ptr->load_bbox_data(4 + 2 * (    ray_info.m_sgn_dir.y)), org_y));
+            const __m128d zl1 = _mm_mul_pd(rcp_dir_z, _mm_sub_pd(node_ptr->load_bbox_data(8 + 2 * (1 - ray_info.m_sgn_dir.z)), org_z));
+            const __m128d zl2 = _mm_mul_pd(rcp_dir_z, _mm_sub_pd(node_ptr->load_bbox_data(8 + 2 * (    ray_info.m_sgn_dir.z)), org_z));
 
             const __m128d ray_tmax = _mm_set1_pd(rtmax);
             const __m128d tmin = _mm_max_pd(zl1, _mm_max_pd(yl1, _mm_max_pd(xl1, ray_tmin)));
@@ -750,12 +750,12 @@ void Intersector<Tree, Visitor, Ray3d, StackSize, 3>::intersect_motion(
                 }
                 else
                 {
-                    bbox_data[ 0] = node_ptr->m_bbox_data[ 0];
-                    bbox_data[ 2] = node_ptr->m_bbox_data[ 2];
-                    bbox_data[ 4] = node_ptr->m_bbox_data[ 4];
-                    bbox_data[ 6] = node_ptr->m_bbox_data[ 6];
-                    bbox_data[ 8] = node_ptr->m_bbox_data[ 8];
-                    bbox_data[10] = node_ptr->m_bbox_data[10];
+                    bbox_data[ 0] = node_ptr->get_bbox_data(0);
+                    bbox_data[ 2] = node_ptr->get_bbox_data(2);
+                    bbox_data[ 4] = node_ptr->get_bbox_data(4);
+                    bbox_data[ 6] = node_ptr->get_bbox_data(6);
+                    bbox_data[ 8] = node_ptr->get_bbox_data(8);
+                    bbox_data[10] = node_ptr->get_bbox_data(10);
                 }
 
                 // Fetch the right bounding box.
@@ -783,12 +783,12 @@ void Intersector<Tree, Visitor, Ray3d, StackSize, 3>::intersect_motion(
                 }
                 else
                 {
-                    bbox_data[ 1] = node_ptr->m_bbox_data[ 1];
-                    bbox_data[ 3] = node_ptr->m_bbox_data[ 3];
-                    bbox_data[ 5] = node_ptr->m_bbox_data[ 5];
-                    bbox_data[ 7] = node_ptr->m_bbox_data[ 7];
-                    bbox_data[ 9] = node_ptr->m_bbox_data[ 9];
-                    bbox_data[11] = node_ptr->m_bbox_data[11];
+                    bbox_data[ 1] = node_ptr->get_bbox_data(1);
+                    bbox_data[ 3] = node_ptr->get_bbox_data(3);
+                    bbox_data[ 5] = node_ptr->get_bbox_data(5);
+                    bbox_data[ 7] = node_ptr->get_bbox_data(7);
+                    bbox_data[ 9] = node_ptr->get_bbox_data(9);
+                    bbox_data[11] = node_ptr->get_bbox_data(11);
                 }
 
                 const __m128d xl1 = _mm_mul_pd(rcp_dir_x, _mm_sub_pd(_mm_load_pd(bbox_data + 0 + 2 * (1 - ray_info.m_sgn_dir.x)), org_x));
@@ -31,6 +31,9 @@
 
 // appleseed.foundation headers.
 #include "foundation/platform/compiler.h"
+#ifdef APPLESEED_USE_SSE
+#include "foundation/platform/sse.h"
+#endif
 
 // Standard headers.
 #include <cassert>
@@ -105,6 +108,14 @@ class APPLESEED_ALIGN(64) Node
     std::uint32_t                   m_right_bbox_count;
 
     APPLESEED_SIMD4_ALIGN ValueType m_bbox_data[4 * Dimension];
+
+    // Retrieve the bounding box coordinate at a given index.
+    ValueType get_bbox_data(const size_t index) const;
+
+#ifdef APPLESEED_USE_SSE
+    // Load two consecutive bounding box coordinates into an SSE register.
+    __m128d load_bbox_data(const size_t index) const;
+#endif
 };
 
 
@@ -331,5 +342,21 @@ inline size_t Node<AABB>::get_item_count() const
     return static_cast<size_t>(m_item_count);
 }
 
+template <typename AABB>
+inline typename Node<AABB>::ValueType Node<AABB>::get_bbox_data(const size_t index) const
+{
+    return m_bbox_data[index];
+}
+
+#ifdef APPLESEED_USE_SSE
+
+template <typename AABB>
+inline __m128d Node<AABB>::load_bbox_data(const size_t index) const
+{
+    return _mm_load_pd(m_bbox_data + index);
+}
+
+#endif
+
 }   // namespace bvh
 }   // namespace foundation
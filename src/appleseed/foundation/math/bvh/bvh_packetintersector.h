@@ -0,0 +1,503 @@
+
+//
+// This source file is part of appleseed.
+// Visit https://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2019 The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+// appleseed.foundation headers.
+#include "foundation/core/concepts/noncopyable.h"
+#include "foundation/math/bvh/bvh_intersector.h"
+#include "foundation/math/bvh/bvh_statistics.h"
+#include "foundation/math/ray.h"
+#include "foundation/platform/compiler.h"
+#include "foundation/utility/casts.h"
+#ifdef APPLESEED_USE_SSE
+#include "foundation/platform/sse.h"
+#endif
+
+// Standard headers.
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+namespace foundation {
+namespace bvh {
+
+//
+// BVH packet intersector.
+//
+// Traverses a binary BVH with a packet of up to 64 rays at once. Each node is
+// fetched once per packet; its bounding boxes are tested against all active
+// rays of the packet (four rays at a time when SSE is available), and the
+// subtrees that no active ray hits are culled for the whole packet. This is
+// most effective for coherent rays, such as camera rays from a single tile or
+// shadow rays from a single shading point.
+//
+// The Visitor class must conform to the following prototype:
+//
+//      class Visitor
+//        : public foundation::NonCopyable
+//      {
+//        public:
+//          // Visit a leaf with the rays whose bit is set in 'mask'.
+//          // Clear the bits of rays that need not be traced further
+//          // (for instance occluded probe rays), and set 'distances'
+//          // to the distance to the closest hit so far for each ray.
+//          // Return whether BVH traversal should continue or not.
+//          bool visit(
+//              const NodeType&             node,
+//              const RayType               rays[],
+//              const RayInfoType           ray_infos[],
+//              PacketMask&                 mask,
+//              ValueType                   distances[]
+//      #ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+//              , TraversalStatistics&      stats
+//      #endif
+//              );
+//      };
+//
+// Bounding box tests are performed in single precision with the far distance
+// slightly enlarged to compensate for rounding errors. Motion blur is not
+// supported.
+//
+
+// Bit mask of active rays in a packet.
+typedef std::uint64_t PacketMask;
+
+// Maximum number of rays in a packet.
+const size_t MaxPacketSize = 64;
+
+// Return a mask with the first 'ray_count' bits set.
+PacketMask make_packet_mask(const size_t ray_count);
+
+template <
+    typename Tree,
+    typename Visitor,
+    typename Ray,
+    size_t StackSize = 64
+>
+class PacketIntersector
+  : public NonCopyable
+{
+  public:
+    typedef typename Tree::NodeType NodeType;
+    typedef typename Ray::ValueType ValueType;
+    typedef Ray RayType;
+    typedef RayInfo<ValueType, 3> RayInfoType;
+
+    // Intersect a packet of rays with a given BVH without motion. Only the rays whose
+    // bit is set in 'mask' are traced; other rays and their ray infos are never read.
+    void intersect_no_motion(
+        const Tree&             tree,
+        const RayType           rays[],
+        const RayInfoType       ray_infos[],
+        const size_t            ray_count,
+        PacketMask              mask,
+        Visitor&                visitor
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+        , TraversalStatistics&  stats
+#endif
+        ) const;
+
+  private:
+    static const size_t LaneCount = 4;
+    static const size_t MaxGroupCount = MaxPacketSize / LaneCount;
+
+    // Single precision rays in structure-of-arrays form, four rays per group.
+    struct PacketData
+    {
+        APPLESEED_SIMD4_ALIGN float     m_org[3][MaxPacketSize];
+        APPLESEED_SIMD4_ALIGN float     m_rcp_dir[3][MaxPacketSize];
+        APPLESEED_SIMD4_ALIGN float     m_dir_is_neg[3][MaxPacketSize];    // all bits set if the direction is negative
+        APPLESEED_SIMD4_ALIGN float     m_tmin[MaxPacketSize];
+        APPLESEED_SIMD4_ALIGN float     m_tmax[MaxPacketSize];
+    };
+
+    struct StackEntry
+    {
+        const NodeType*         m_node;
+        PacketMask              m_mask;
+    };
+
+    static float to_float(const ValueType x);
+    static float to_float_round_up(const ValueType x);
+
+    // Intersect the active rays of a packet with the bounding boxes of both children of a node.
+    // Return the masks of the rays that hit each box, and the smallest entry distance in each box.
+    static void intersect_children(
+        const PacketData&       packet,
+        const PacketMask        mask,
+        const NodeType&         node,
+        PacketMask              hit_masks[2],
+        float                   tnear[2]);
+};
+
+
+//
+// PacketIntersector class implementation.
+//
+
+inline PacketMask make_packet_mask(const size_t ray_count)
+{
+    assert(ray_count <= MaxPacketSize);
+    return ray_count < MaxPacketSize ? (PacketMask(1) << ray_count) - 1 : ~PacketMask(0);
+}
+
+template <typename Tree, typename Visitor, typename Ray, size_t StackSize>
+inline float PacketIntersector<Tree, Visitor, Ray, StackSize>::to_float(const ValueType x)
+{
+    const ValueType Max = static_cast<ValueType>(std::numeric_limits<float>::max());
+    return
+        x > Max ? +std::numeric_limits<float>::infinity() :
+        x < -Max ? -std::numeric_limits<float>::infinity() :
+        static_cast<float>(x);
+}
+
+template <typename Tree, typename Visitor, typename Ray, size_t StackSize>
+inline float PacketIntersector<Tree, Visitor, Ray, StackSize>::to_float_round_up(const ValueType x)
+{
+    const float y = to_float(x);
+    return static_cast<ValueType>(y) < x ? std::nextafter(y, std::numeric_limits<float>::infinity()) : y;
+}
+
+template <typename Tree, typename Visitor, typename Ray, size_t StackSize>
+inline void PacketIntersector<Tree, Visitor, Ray, StackSize>::intersect_children(
+    const PacketData&           packet,
+    const PacketMask            mask,
+    const NodeType&             node,
+    PacketMask                  hit_masks[2],
+    float                       tnear[2])
+{
+    // Enlarge the far distance to make the single precision slab test conservative.
+    const float FarScale = 1.0f + 4.0f * std::numeric_limits<float>::epsilon();
+
+    // Convert the bounding boxes to single precision. Conversion errors are below one ulp:
+    // moving the bounds outward by one ulp of their magnitude keeps the boxes conservative.
+    const float Eps = std::numeric_limits<float>::epsilon();
+    const float Tiny = std::numeric_limits<float>::min();
+    float bbox_min[2][3], bbox_max[2][3];
+    for (size_t c = 0; c < 2; ++c)
+    {
+        const typename NodeType::AABBType& bbox = c == 0 ? node.get_left_bbox() : node.get_right_bbox();
+
+        for (size_t d = 0; d < 3; ++d)
+        {
+            bbox_min[c][d] = to_float(bbox.min[d]);
+            bbox_max[c][d] = to_float(bbox.max[d]);
+            bbox_min[c][d] -= std::abs(bbox_min[c][d]) * Eps + Tiny;
+            bbox_max[c][d] += std::abs(bbox_max[c][d]) * Eps + Tiny;
+        }
+    }
+
+    hit_masks[0] = hit_masks[1] = 0;
+
+#ifdef APPLESEED_USE_SSE
+
+    __m128 bbox_min4[2][3], bbox_max4[2][3];
+    for (size_t c = 0; c < 2; ++c)
+    {
+        for (size_t d = 0; d < 3; ++d)
+        {
+            bbox_min4[c][d] = _mm_set1_ps(bbox_min[c][d]);
+            bbox_max4[c][d] = _mm_set1_ps(bbox_max[c][d]);
+        }
+    }
+
+    const __m128 far_scale4 = _mm_set1_ps(FarScale);
+    const __m128i lane_bits = _mm_setr_epi32(1, 2, 4, 8);
+    __m128 tnear4[2] =
+    {
+        _mm_set1_ps(std::numeric_limits<float>::infinity()),
+        _mm_set1_ps(std::numeric_limits<float>::infinity())
+    };
+
+    for (size_t g = 0; g < MaxGroupCount && (mask >> (g * LaneCount)) != 0; ++g)
+    {
+        const size_t group_mask = static_cast<size_t>((mask >> (g * LaneCount)) & 0xF);
+        if (group_mask == 0)
+            continue;
+
+        const size_t base = g * LaneCount;
+
+        // _mm_max_ps() and _mm_min_ps() return their second operand if either operand is NaN.
+        const __m128 tmin = _mm_load_ps(packet.m_tmin + base);
+        const __m128 tmax = _mm_load_ps(packet.m_tmax + base);
+        __m128 t0[2] = { tmin, tmin };
+        __m128 t1[2] = { tmax, tmax };
+
+        for (size_t d = 0; d < 3; ++d)
+        {
+            const __m128 org = _mm_load_ps(packet.m_org[d] + base);
+            const __m128 rcp_dir = _mm_load_ps(packet.m_rcp_dir[d] + base);
+            const __m128 neg = _mm_load_ps(packet.m_dir_is_neg[d] + base);
+
+            for (size_t c = 0; c < 2; ++c)
+            {
+                // Select the near and far planes according to the sign of the direction of each ray.
+                const __m128 near_plane = _mm_or_ps(_mm_and_ps(neg, bbox_max4[c][d]), _mm_andnot_ps(neg, bbox_min4[c][d]));
+                const __m128 far_plane = _mm_or_ps(_mm_and_ps(neg, bbox_min4[c][d]), _mm_andnot_ps(neg, bbox_max4[c][d]));
+
+                t0[c] = _mm_max_ps(_mm_mul_ps(_mm_sub_ps(near_plane, org), rcp_dir), t0[c]);
+                t1[c] = _mm_min_ps(_mm_mul_ps(_mm_sub_ps(far_plane, org), rcp_dir), t1[c]);
+            }
+        }
+
+        for (size_t c = 0; c < 2; ++c)
+        {
+            const __m128 hit = _mm_cmple_ps(t0[c], _mm_mul_ps(t1[c], far_scale4));
+            const size_t lane_mask = static_cast<size_t>(_mm_movemask_ps(hit)) & group_mask;
+
+            if (lane_mask != 0)
+            {
+                hit_masks[c] |= PacketMask(lane_mask) << base;
+
+                // Keep track of the smallest entry distance among the active rays that hit the box.
+                const __m128 active =
+                    _mm_castsi128_ps(
+                        _mm_cmpgt_epi32(
+                            _mm_and_si128(_mm_set1_epi32(static_cast<int>(lane_mask)), lane_bits),
+                            _mm_setzero_si128()));
+                tnear4[c] = _mm_min_ps(tnear4[c], _mm_or_ps(_mm_and_ps(active, t0[c]), _mm_andnot_ps(active, tnear4[c])));
+            }
+        }
+    }
+
+    for (size_t c = 0; c < 2; ++c)
+    {
+        APPLESEED_SIMD4_ALIGN float tnear_lanes[4];
+        _mm_store_ps(tnear_lanes, tnear4[c]);
+        tnear[c] = std::min(std::min(tnear_lanes[0], tnear_lanes[1]), std::min(tnear_lanes[2], tnear_lanes[3]));
+    }
+
+#else
+
+    tnear[0] = tnear[1] = std::numeric_limits<float>::infinity();
+
+    for (size_t i = 0; i < MaxPacketSize && (mask >> i) != 0; ++i)
+    {
+        if ((mask & (PacketMask(1) << i)) == 0)
+            continue;
+
+        for (size_t c = 0; c < 2; ++c)
+        {
+            // If the difference is zero and the reciprocal is infinite, the product is NaN:
+            // std::max() and std::min() then return their first argument, ignoring this slab.
+            float t0 = packet.m_tmin[i];
+            float t1 = packet.m_tmax[i];
+
+            for (size_t d = 0; d < 3; ++d)
+            {
+                const bool neg = packet.m_dir_is_neg[d][i] != 0.0f;
+                t0 = std::max(t0, ((neg ? bbox_max[c][d] : bbox_min[c][d]) - packet.m_org[d][i]) * packet.m_rcp_dir[d][i]);
+                t1 = std::min(t1, ((neg ? bbox_min[c][d] : bbox_max[c][d]) - packet.m_org[d][i]) * packet.m_rcp_dir[d][i]);
+            }
+
+            if (t0 <= t1 * FarScale)
+            {
+                hit_masks[c] |= PacketMask(1) << i;
+                tnear[c] = std::min(tnear[c], t0);
+            }
+        }
+    }
+
+#endif
+}
+
+template <typename Tree, typename Visitor, typename Ray, size_t StackSize>
+void PacketIntersector<Tree, Visitor, Ray, StackSize>::intersect_no_motion(
+    const Tree&                 tree,
+    const RayType               rays[],
+    const RayInfoType           ray_infos[],
+    const size_t                ray_count,
+    PacketMask                  mask,
+    Visitor&                    visitor
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+    , TraversalStatistics&      stats
+#endif
+    ) const
+{
+    // Make sure the tree was built.
+    assert(!tree.m_nodes.empty());
+    assert(ray_count <= MaxPacketSize);
+
+    mask &= make_packet_mask(ray_count);
+    if (mask == 0)
+        return;
+
+    // Convert the active rays to single precision. Other lanes get empty intervals.
+    PacketData packet;
+    ValueType distances[MaxPacketSize];
+    for (size_t i = 0; i < MaxPacketSize; ++i)
+    {
+        if ((mask & (PacketMask(1) << i)) != 0)
+        {
+            for (size_t d = 0; d < 3; ++d)
+            {
+                packet.m_org[d][i] = to_float(rays[i].m_org[d]);
+                packet.m_rcp_dir[d][i] = to_float(ray_infos[i].m_rcp_dir[d]);
+                packet.m_dir_is_neg[d][i] = ray_infos[i].m_sgn_dir[d] == 0 ? binary_cast<float>(~std::uint32_t(0)) : 0.0f;
+            }
+
+            packet.m_tmin[i] = std::max(to_float(rays[i].m_tmin), 0.0f);
+            packet.m_tmax[i] = to_float_round_up(rays[i].m_tmax);
+            distances[i] = rays[i].m_tmax;
+        }
+        else
+        {
+            for (size_t d = 0; d < 3; ++d)
+            {
+                packet.m_org[d][i] = 0.0f;
+                packet.m_rcp_dir[d][i] = 1.0f;
+                packet.m_dir_is_neg[d][i] = 0.0f;
+            }
+
+            packet.m_tmin[i] = 1.0f;
+            packet.m_tmax[i] = 0.0f;
+        }
+    }
+
+    // Node stack.
+    StackEntry stack[StackSize];
+    StackEntry* stack_ptr = stack;
+
+    // Current node.
+    const NodeType* node_ptr = &tree.m_nodes[0];
+    PacketMask node_mask = mask;
+
+    // Initialize traversal statistics.
+    FOUNDATION_BVH_TRAVERSAL_STATS(++stats.m_traversal_count);
+    FOUNDATION_BVH_TRAVERSAL_STATS(size_t visited_nodes = 0);
+    FOUNDATION_BVH_TRAVERSAL_STATS(size_t visited_leaves = 0);
+    FOUNDATION_BVH_TRAVERSAL_STATS(size_t intersected_bboxes = 0);
+    FOUNDATION_BVH_TRAVERSAL_STATS(size_t discarded_nodes = 0);
+
+    // Traverse the tree and intersect leaf nodes.
+    while (true)
+    {
+        FOUNDATION_BVH_TRAVERSAL_STATS(++visited_nodes);
+
+        if (node_ptr->is_interior())
+        {
+            FOUNDATION_BVH_TRAVERSAL_STATS(intersected_bboxes += 2);
+
+            // Intersect the bounding boxes of both children with the active rays.
+            PacketMask hit_masks[2];
+            float tnear[2];
+            intersect_children(packet, node_mask, *node_ptr, hit_masks, tnear);
+            const PacketMask left_mask = hit_masks[0];
+            const PacketMask right_mask = hit_masks[1];
+
+            const NodeType* child_ptr = &tree.m_nodes[node_ptr->get_child_node_index()];
+
+            if (left_mask != 0 && right_mask != 0)
+            {
+                // Push the far child node to the stack, continue with the near child node.
+                assert(stack_ptr < stack + StackSize);
+                const size_t far_index = tnear[0] < tnear[1] ? 1 : 0;
+                stack_ptr->m_node = child_ptr + far_index;
+                stack_ptr->m_mask = far_index == 1 ? right_mask : left_mask;
+                ++stack_ptr;
+                node_ptr = child_ptr + (1 - far_index);
+                node_mask = far_index == 1 ? left_mask : right_mask;
+                continue;
+            }
+
+            if (left_mask != 0 || right_mask != 0)
+            {
+                // Continue with the left or right child node.
+                FOUNDATION_BVH_TRAVERSAL_STATS(++discarded_nodes);
+                const size_t index = left_mask != 0 ? 0 : 1;
+                node_ptr = child_ptr + index;
+                node_mask = left_mask | right_mask;
+                continue;
+            }
+
+            FOUNDATION_BVH_TRAVERSAL_STATS(discarded_nodes += 2);
+        }
+        else
+        {
+            // Visit the leaf.
+            FOUNDATION_BVH_TRAVERSAL_STATS(++visited_leaves);
+            PacketMask leaf_mask = node_mask;
+            const bool proceed =
+                visitor.visit(
+                    *node_ptr,
+                    rays,
+                    ray_infos,
+                    leaf_mask,
+                    distances
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+                    , stats
+#endif
+                    );
+
+            // Terminate traversal if the visitor decided so.
+            if (!proceed)
+                break;
+
+            // Deactivate the rays that the visitor is done with.
+            mask &= leaf_mask | ~node_mask;
+            if (mask == 0)
+                break;
+
+            // Keep track of the distance to the closest intersection of each ray.
+            for (size_t i = 0; i < ray_count && (leaf_mask >> i) != 0; ++i)
+            {
+                if ((leaf_mask & (PacketMask(1) << i)) == 0)
+                    continue;
+
+                assert(distances[i] >= ValueType(0.0));
+                packet.m_tmax[i] = std::min(packet.m_tmax[i], to_float_round_up(distances[i]));
+            }
+        }
+
+        // Pop nodes from the stack until one of them is still relevant to an active ray.
+        node_mask = 0;
+        while (stack_ptr > stack && node_mask == 0)
+        {
+            --stack_ptr;
+            node_ptr = stack_ptr->m_node;
+            node_mask = stack_ptr->m_mask & mask;
+        }
+
+        // Terminate traversal if no node is left to visit.
+        if (node_mask == 0)
+            break;
+    }
+
+    // Store traversal statistics.
+    FOUNDATION_BVH_TRAVERSAL_STATS(stats.m_visited_nodes.insert(visited_nodes));
+    FOUNDATION_BVH_TRAVERSAL_STATS(stats.m_visited_leaves.insert(visited_leaves));
+    FOUNDATION_BVH_TRAVERSAL_STATS(stats.m_intersected_bboxes.insert(intersected_bboxes));
+    FOUNDATION_BVH_TRAVERSAL_STATS(stats.m_discarded_nodes.insert(discarded_nodes));
+}
+
+}   // namespace bvh
+}   // namespace foundation
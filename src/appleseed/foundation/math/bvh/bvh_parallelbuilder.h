@@ -0,0 +1,780 @@
+
+//
+// This source file is part of appleseed.
+// Visit https://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2019 The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+// appleseed.foundation headers.
+#include "foundation/core/concepts/noncopyable.h"
+#include "foundation/log/logger.h"
+#include "foundation/platform/thread.h"
+#include "foundation/utility/job/ijob.h"
+#include "foundation/utility/job/jobmanager.h"
+#include "foundation/utility/job/jobqueue.h"
+#include "foundation/utility/stopwatch.h"
+
+// Standard headers.
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace foundation {
+namespace bvh {
+
+namespace impl
+{
+    //
+    // A fragment of a tree, built by a single task of a parallel builder.
+    //
+    // Nodes are stored in the order in which the serial builders would allocate them,
+    // treating the subtrees delegated to other tasks as if they were empty. A delegated
+    // node is a placeholder pointing to the fragment that contains its subtree.
+    //
+
+    template <typename Node>
+    struct TreeFragment
+    {
+        typedef Node NodeType;
+
+        static const size_t NoSubfragment = ~size_t(0);
+
+        std::vector<NodeType>   m_nodes;
+        std::vector<size_t>     m_subfragments;     // for each node, fragment rooted at this node or NoSubfragment
+
+        size_t create_node()
+        {
+            m_nodes.push_back(NodeType());
+            m_subfragments.push_back(NoSubfragment);
+            return m_nodes.size() - 1;
+        }
+    };
+
+
+    //
+    // A thread-safe list of tree fragments.
+    //
+
+    template <typename Fragment>
+    class TreeFragmentList
+      : public NonCopyable
+    {
+      public:
+        typedef Fragment FragmentType;
+        typedef typename FragmentType::NodeType NodeType;
+
+        // Destructor.
+        ~TreeFragmentList();
+
+        // Create a new fragment. Thread-safe.
+        FragmentType* create(size_t& fragment_index);
+
+        // Return the number of fragments.
+        size_t size() const;
+
+        // Delete all fragments.
+        void clear();
+
+        // Assemble all fragments into a single array of nodes, in the order in which the
+        // serial builders would have allocated them. The leaf visitor is invoked on every
+        // leaf node, in tree order, before it is stored.
+        template <typename NodeVector, typename LeafVisitor>
+        void flatten(
+            NodeVector&             nodes,
+            LeafVisitor&            leaf_visitor) const;
+
+      private:
+        Spinlock                    m_lock;
+        std::vector<FragmentType*>  m_fragments;
+
+        template <typename NodeVector, typename LeafVisitor>
+        void flatten_recurse(
+            NodeVector&             nodes,
+            LeafVisitor&            leaf_visitor,
+            const size_t            fragment_index,
+            const size_t            local_node_index,
+            const size_t            node_index) const;
+    };
+
+    // Return the number of threads worth using to subdivide a set of items.
+    inline size_t compute_thread_count(
+        const size_t                item_count,
+        const size_t                thread_count,
+        const size_t                min_task_size)
+    {
+        return item_count >= 2 * min_task_size ? std::max<size_t>(thread_count, 1) : 1;
+    }
+
+    // Run the subdivision job of the root node. Subdivision jobs spawned by the root job
+    // are executed by the same job manager, which reports to the given logger.
+    inline void run_root_job(
+        IJob&                       root_job,
+        JobQueue&                   job_queue,
+        Logger&                     logger,
+        const size_t                thread_count)
+    {
+        if (thread_count > 1)
+        {
+            JobManager job_manager(logger, job_queue, thread_count);
+            job_queue.schedule(&root_job, false);
+            job_manager.start();
+            job_queue.wait_until_completion();
+        }
+        else root_job.execute(0);
+    }
+}
+
+
+//
+// Multithreaded BVH builder.
+//
+// Builds the same tree as foundation::bvh::Builder, but subtrees containing enough items
+// are subdivided in parallel. The Partitioner class must conform to the prototype given
+// in bvh_builder.h, and its partition() method must be safe to call concurrently on
+// disjoint ranges of items.
+//
+
+template <typename Tree, typename Partitioner>
+class ParallelBuilder
+  : public NonCopyable
+{
+  public:
+    // Constructor. Build threads report to the given logger.
+    explicit ParallelBuilder(Logger& logger);
+
+    // Build a tree. Subtrees with fewer than min_task_size items are built by a single thread.
+    template <typename Timer>
+    void build(
+        Tree&           tree,
+        Partitioner&    partitioner,
+        const size_t    size,
+        const size_t    items_per_leaf_hint,
+        const size_t    thread_count,
+        const size_t    min_task_size = 4096);
+
+    // Return the construction time.
+    double get_build_time() const;
+
+    // Return the number of subtrees built as separate tasks during the last build.
+    size_t get_task_count() const;
+
+  private:
+    typedef typename Tree::NodeType NodeType;
+    typedef typename NodeType::AABBType AABBType;
+    typedef impl::TreeFragment<NodeType> FragmentType;
+
+    class SubdivideJob;
+
+    Logger&                                     m_logger;
+    double                                      m_build_time;
+    size_t                                      m_task_count;
+};
+
+
+//
+// Multithreaded BVH builder supporting spatial splits.
+//
+// Builds the same tree as foundation::bvh::SpatialBuilder, but leaves containing enough
+// items are subdivided in parallel. In addition to the prototype given in
+// bvh_spatialbuilder.h, the Partitioner class must provide the following methods:
+//
+//      // Prepare the partitioner for concurrent calls to split() from a number of threads.
+//      void set_thread_count(const size_t thread_count);
+//
+//      // Thread-safe variant of split(), called with the index of the calling thread.
+//      bool split(
+//          const LeafType&     leaf,
+//          const AABBType&     leaf_bbox,
+//          LeafType&           left_leaf,
+//          AABBType&           left_left_bbox,
+//          LeafType&           right_leaf,
+//          AABBType&           right_leaf_bbox,
+//          const size_t        thread_index);
+//
+
+template <typename Tree, typename Partitioner>
+class ParallelSpatialBuilder
+  : public NonCopyable
+{
+  public:
+    typedef typename Tree::NodeType NodeType;
+    typedef typename NodeType::AABBType AABBType;
+    typedef typename Partitioner::LeafType LeafType;
+
+    // Constructor. Build threads report to the given logger.
+    explicit ParallelSpatialBuilder(Logger& logger);
+
+    // Build a tree. Leaves with fewer than min_task_size items are subdivided by a single thread.
+    template <typename Timer>
+    void build(
+        Tree&               tree,
+        Partitioner&        partitioner,
+        LeafType*           root_leaf,
+        const AABBType&     root_leaf_bbox,
+        const size_t        thread_count,
+        const size_t        min_task_size = 4096);
+
+    // Return the construction time.
+    double get_build_time() const;
+
+    // Return the number of subtrees built as separate tasks during the last build.
+    size_t get_task_count() const;
+
+  private:
+    typedef std::vector<const LeafType*> LeafVector;
+
+    struct FragmentType
+      : public impl::TreeFragment<NodeType>
+    {
+        LeafVector m_leaves;
+
+        ~FragmentType()
+        {
+            for (const LeafType* leaf : m_leaves)
+                delete leaf;
+        }
+    };
+
+    class SubdivideJob;
+
+    Logger&                                     m_logger;
+    double                                      m_build_time;
+    size_t                                      m_task_count;
+};
+
+
+//
+// TreeFragment class implementation.
+//
+
+namespace impl
+{
+    template <typename Node>
+    const size_t TreeFragment<Node>::NoSubfragment;
+}
+
+
+//
+// TreeFragmentList class implementation.
+//
+
+namespace impl
+{
+    template <typename Fragment>
+    TreeFragmentList<Fragment>::~TreeFragmentList()
+    {
+        clear();
+    }
+
+    template <typename Fragment>
+    Fragment* TreeFragmentList<Fragment>::create(size_t& fragment_index)
+    {
+        std::unique_ptr<FragmentType> fragment(new FragmentType());
+
+        Spinlock::ScopedLock lock(m_lock);
+        fragment_index = m_fragments.size();
+        m_fragments.push_back(fragment.get());
+
+        return fragment.release();
+    }
+
+    template <typename Fragment>
+    inline size_t TreeFragmentList<Fragment>::size() const
+    {
+        return m_fragments.size();
+    }
+
+    template <typename Fragment>
+    void TreeFragmentList<Fragment>::clear()
+    {
+        for (FragmentType* fragment : m_fragments)
+            delete fragment;
+
+        m_fragments.clear();
+    }
+
+    template <typename Fragment>
+    template <typename NodeVector, typename LeafVisitor>
+    void TreeFragmentList<Fragment>::flatten(
+        NodeVector&                 nodes,
+        LeafVisitor&                leaf_visitor) const
+    {
+        assert(!m_fragments.empty());
+
+        // Every fragment but the first one duplicates the placeholder node it replaces.
+        size_t node_count = 1;
+        for (const FragmentType* fragment : m_fragments)
+            node_count += fragment->m_nodes.size() - 1;
+
+        nodes.clear();
+        nodes.reserve(node_count);
+        nodes.push_back(NodeType());
+
+        flatten_recurse(nodes, leaf_visitor, 0, 0, 0);
+
+        assert(nodes.size() == node_count);
+    }
+
+    template <typename Fragment>
+    template <typename NodeVector, typename LeafVisitor>
+    void TreeFragmentList<Fragment>::flatten_recurse(
+        NodeVector&                 nodes,
+        LeafVisitor&                leaf_visitor,
+        const size_t                fragment_index,
+        const size_t                local_node_index,
+        const size_t                node_index) const
+    {
+        const FragmentType& fragment = *m_fragments[fragment_index];
+
+        // Continue into the fragment holding the subtree rooted at this node.
+        const size_t subfragment_index = fragment.m_subfragments[local_node_index];
+        if (subfragment_index != FragmentType::NoSubfragment)
+        {
+            flatten_recurse(nodes, leaf_visitor, subfragment_index, 0, node_index);
+            return;
+        }
+
+        NodeType node = fragment.m_nodes[local_node_index];
+
+        if (node.is_interior())
+        {
+            // Allocate the child nodes before visiting the subtrees, like the serial builders do.
+            const size_t local_child_node_index = node.get_child_node_index();
+            const size_t child_node_index = nodes.size();
+            node.set_child_node_index(child_node_index);
+            nodes[node_index] = node;
+            nodes.push_back(NodeType());
+            nodes.push_back(NodeType());
+
+            flatten_recurse(nodes, leaf_visitor, fragment_index, local_child_node_index + 0, child_node_index + 0);
+            flatten_recurse(nodes, leaf_visitor, fragment_index, local_child_node_index + 1, child_node_index + 1);
+        }
+        else
+        {
+            leaf_visitor(fragment, node);
+            nodes[node_index] = node;
+        }
+    }
+}
+
+
+//
+// ParallelBuilder class implementation.
+//
+
+template <typename Tree, typename Partitioner>
+class ParallelBuilder<Tree, Partitioner>::SubdivideJob
+  : public IJob
+{
+  public:
+    SubdivideJob(
+        impl::TreeFragmentList<FragmentType>&   fragments,
+        JobQueue&                               job_queue,
+        Partitioner&                            partitioner,
+        const size_t                            min_task_size,
+        FragmentType*                           fragment,
+        const size_t                            begin,
+        const size_t                            end,
+        const AABBType&                         bbox)
+      : m_fragments(fragments)
+      , m_job_queue(job_queue)
+      , m_partitioner(partitioner)
+      , m_min_task_size(min_task_size)
+      , m_fragment(fragment)
+      , m_begin(begin)
+      , m_end(end)
+      , m_bbox(bbox)
+    {
+    }
+
+    void execute(const size_t thread_index) override
+    {
+        subdivide_recurse(m_fragment->create_node(), m_begin, m_end, m_bbox);
+    }
+
+  private:
+    impl::TreeFragmentList<FragmentType>&       m_fragments;
+    JobQueue&                                   m_job_queue;
+    Partitioner&                                m_partitioner;
+    const size_t                                m_min_task_size;
+    FragmentType*                               m_fragment;
+    const size_t                                m_begin;
+    const size_t                                m_end;
+    const AABBType                              m_bbox;
+
+    // Same as Builder::subdivide_recurse(), except that large right subtrees are handed over to other tasks.
+    void subdivide_recurse(
+        const size_t                            node_index,
+        const size_t                            begin,
+        const size_t                            end,
+        const AABBType&                         bbox)
+    {
+        assert(node_index < m_fragment->m_nodes.size());
+
+        // Try to partition the set of items.
+        size_t pivot = end;
+        if (end - begin > 1)
+        {
+            pivot = m_partitioner.partition(begin, end, typename Partitioner::AABBType(bbox));
+            assert(pivot > begin);
+            assert(pivot <= end);
+        }
+
+        if (pivot == end)
+        {
+            // Turn the current node into a leaf node.
+            NodeType& node = m_fragment->m_nodes[node_index];
+            node.make_leaf();
+            node.set_item_index(begin);
+            node.set_item_count(end - begin);
+        }
+        else
+        {
+            // Compute the bounding box of the child nodes.
+            const AABBType left_bbox(m_partitioner.compute_bbox(begin, pivot));
+            const AABBType right_bbox(m_partitioner.compute_bbox(pivot, end));
+
+            // Create the child nodes.
+            const size_t left_node_index = m_fragment->create_node();
+            const size_t right_node_index = m_fragment->create_node();
+
+            // Turn the current node into an interior node.
+            NodeType& node = m_fragment->m_nodes[node_index];
+            node.make_interior();
+            node.set_left_bbox(left_bbox);
+            node.set_right_bbox(right_bbox);
+            node.set_child_node_index(left_node_index);
+
+            // Hand the right subtree over to another task if it is large enough.
+            const bool spawn_right = end - pivot >= m_min_task_size;
+            if (spawn_right)
+            {
+                size_t fragment_index;
+                FragmentType* fragment = m_fragments.create(fragment_index);
+                m_fragment->m_subfragments[right_node_index] = fragment_index;
+                m_job_queue.schedule(
+                    new SubdivideJob(
+                        m_fragments,
+                        m_job_queue,
+                        m_partitioner,
+                        m_min_task_size,
+                        fragment,
+                        pivot,
+                        end,
+                        right_bbox));
+            }
+
+            // Recurse into the left subtree.
+            subdivide_recurse(left_node_index, begin, pivot, left_bbox);
+
+            // Recurse into the right subtree.
+            if (!spawn_right)
+                subdivide_recurse(right_node_index, pivot, end, right_bbox);
+        }
+    }
+};
+
+template <typename Tree, typename Partitioner>
+ParallelBuilder<Tree, Partitioner>::ParallelBuilder(Logger& logger)
+  : m_logger(logger)
+  , m_build_time(0.0)
+  , m_task_count(0)
+{
+}
+
+template <typename Tree, typename Partitioner>
+template <typename Timer>
+void ParallelBuilder<Tree, Partitioner>::build(
+    Tree&                   tree,
+    Partitioner&            partitioner,
+    const size_t            size,
+    const size_t            items_per_leaf_hint,
+    const size_t            thread_count,
+    const size_t            min_task_size)
+{
+    assert(min_task_size > 0);
+
+    // Start stopwatch.
+    Stopwatch<Timer> stopwatch;
+    stopwatch.start();
+
+    // Compute the bounding box of the tree.
+    const AABBType root_bbox(partitioner.compute_bbox(0, size));
+
+    // Subdivide the tree. Single-threaded builds never hand subtrees over to other tasks.
+    const size_t effective_thread_count = impl::compute_thread_count(size, thread_count, min_task_size);
+    impl::TreeFragmentList<FragmentType> fragments;
+    JobQueue job_queue;
+    size_t root_fragment_index;
+    SubdivideJob root_job(
+        fragments,
+        job_queue,
+        partitioner,
+        effective_thread_count > 1 ? min_task_size : ~size_t(0),
+        fragments.create(root_fragment_index),
+        0,              // begin
+        size,           // end
+        root_bbox);
+    impl::run_root_job(root_job, job_queue, m_logger, effective_thread_count);
+    m_task_count = fragments.size();
+
+    // Assemble the final tree. Item indices are already global.
+    struct NoOpLeafVisitor
+    {
+        void operator()(const FragmentType& fragment, NodeType& node) {}
+    };
+    NoOpLeafVisitor leaf_visitor;
+    fragments.flatten(tree.m_nodes, leaf_visitor);
+
+    // Measure and save construction time.
+    stopwatch.measure();
+    m_build_time = stopwatch.get_seconds();
+}
+
+template <typename Tree, typename Partitioner>
+inline double ParallelBuilder<Tree, Partitioner>::get_build_time() const
+{
+    return m_build_time;
+}
+
+template <typename Tree, typename Partitioner>
+inline size_t ParallelBuilder<Tree, Partitioner>::get_task_count() const
+{
+    return m_task_count;
+}
+
+
+//
+// ParallelSpatialBuilder class implementation.
+//
+
+template <typename Tree, typename Partitioner>
+class ParallelSpatialBuilder<Tree, Partitioner>::SubdivideJob
+  : public IJob
+{
+  public:
+    SubdivideJob(
+        impl::TreeFragmentList<FragmentType>&   fragments,
+        JobQueue&                               job_queue,
+        Partitioner&                            partitioner,
+        const size_t                            min_task_size,
+        FragmentType*                           fragment,
+        LeafType*                               leaf,
+        const AABBType&                         leaf_bbox)
+      : m_fragments(fragments)
+      , m_job_queue(job_queue)
+      , m_partitioner(partitioner)
+      , m_min_task_size(min_task_size)
+      , m_fragment(fragment)
+      , m_leaf(leaf)
+      , m_leaf_bbox(leaf_bbox)
+    {
+    }
+
+    void execute(const size_t thread_index) override
+    {
+        subdivide_recurse(thread_index, m_leaf, m_leaf_bbox, m_fragment->create_node());
+    }
+
+  private:
+    impl::TreeFragmentList<FragmentType>&       m_fragments;
+    JobQueue&                                   m_job_queue;
+    Partitioner&                                m_partitioner;
+    const size_t                                m_min_task_size;
+    FragmentType*                               m_fragment;
+    LeafType*                                   m_leaf;
+    const AABBType                              m_leaf_bbox;
+
+    // Same as SpatialBuilder::subdivide_recurse(), except that large right leaves are handed over to other tasks.
+    void subdivide_recurse(
+        const size_t                            thread_index,
+        LeafType*                               leaf,
+        const AABBType&                         leaf_bbox,
+        const size_t                            leaf_node_index)
+    {
+        assert(leaf_node_index < m_fragment->m_nodes.size());
+
+        // Try to split the leaf.
+        LeafType* left_leaf = new LeafType();
+        LeafType* right_leaf = new LeafType();
+        AABBType left_leaf_bbox, right_leaf_bbox;
+        const bool split =
+            m_partitioner.split(
+                *leaf,
+                leaf_bbox,
+                *left_leaf,
+                left_leaf_bbox,
+                *right_leaf,
+                right_leaf_bbox,
+                thread_index);
+
+        if (split)
+        {
+            // Get rid of the current leaf.
+            delete leaf;
+
+            // Create the child nodes.
+            const size_t left_node_index = m_fragment->create_node();
+            const size_t right_node_index = m_fragment->create_node();
+
+            // Turn the current node into an interior node.
+            NodeType& node = m_fragment->m_nodes[leaf_node_index];
+            node.make_interior();
+            node.set_left_bbox(left_leaf_bbox);
+            node.set_right_bbox(right_leaf_bbox);
+            node.set_child_node_index(left_node_index);
+
+            // Hand the right leaf over to another task if it is large enough.
+            const bool spawn_right = right_leaf->size() >= m_min_task_size;
+            if (spawn_right)
+            {
+                size_t fragment_index;
+                FragmentType* fragment = m_fragments.create(fragment_index);
+                m_fragment->m_subfragments[right_node_index] = fragment_index;
+                m_job_queue.schedule(
+                    new SubdivideJob(
+                        m_fragments,
+                        m_job_queue,
+                        m_partitioner,
+                        m_min_task_size,
+                        fragment,
+                        right_leaf,
+                        right_leaf_bbox));
+            }
+
+            // Recurse into the left subtree.
+            subdivide_recurse(thread_index, left_leaf, left_leaf_bbox, left_node_index);
+
+            // Recurse into the right subtree.
+            if (!spawn_right)
+                subdivide_recurse(thread_index, right_leaf, right_leaf_bbox, right_node_index);
+        }
+        else
+        {
+            // Get rid of the child nodes.
+            delete left_leaf;
+            delete right_leaf;
+
+            // Turn the current node into a leaf node.
+            NodeType& node = m_fragment->m_nodes[leaf_node_index];
+            node.make_leaf();
+            node.set_item_index(m_fragment->m_leaves.size());
+            node.set_item_count(leaf->size());
+            m_fragment->m_leaves.push_back(leaf);
+        }
+    }
+};
+
+template <typename Tree, typename Partitioner>
+ParallelSpatialBuilder<Tree, Partitioner>::ParallelSpatialBuilder(Logger& logger)
+  : m_logger(logger)
+  , m_build_time(0.0)
+  , m_task_count(0)
+{
+}
+
+template <typename Tree, typename Partitioner>
+template <typename Timer>
+void ParallelSpatialBuilder<Tree, Partitioner>::build(
+    Tree&                   tree,
+    Partitioner&            partitioner,
+    LeafType*               root_leaf,
+    const AABBType&         root_leaf_bbox,
+    const size_t            thread_count,
+    const size_t            min_task_size)
+{
+    assert(min_task_size > 0);
+
+    // Start stopwatch.
+    Stopwatch<Timer> stopwatch;
+    stopwatch.start();
+
+    // Subdivide the tree. Single-threaded builds never hand subtrees over to other tasks.
+    const size_t effective_thread_count = impl::compute_thread_count(root_leaf->size(), thread_count, min_task_size);
+    partitioner.set_thread_count(effective_thread_count);
+    impl::TreeFragmentList<FragmentType> fragments;
+    JobQueue job_queue;
+    size_t root_fragment_index;
+    SubdivideJob root_job(
+        fragments,
+        job_queue,
+        partitioner,
+        effective_thread_count > 1 ? min_task_size : ~size_t(0),
+        fragments.create(root_fragment_index),
+        root_leaf,
+        root_leaf_bbox);
+    impl::run_root_job(root_job, job_queue, m_logger, effective_thread_count);
+    m_task_count = fragments.size();
+
+    // Assemble the final tree, gathering the leaves in tree order.
+    struct LeafGatherer
+    {
+        LeafVector m_leaves;
+
+        void operator()(const FragmentType& fragment, NodeType& node)
+        {
+            const size_t leaf_index = node.get_item_index();
+            node.set_item_index(m_leaves.size());
+            m_leaves.push_back(fragment.m_leaves[leaf_index]);
+        }
+    };
+    LeafGatherer leaf_gatherer;
+    fragments.flatten(tree.m_nodes, leaf_gatherer);
+
+    // Store the leaves.
+    const LeafVector& leaves = leaf_gatherer.m_leaves;
+    const size_t node_count = tree.m_nodes.size();
+    for (size_t i = 0; i < node_count; ++i)
+    {
+        NodeType& node = tree.m_nodes[i];
+        if (node.is_leaf())
+            node.set_item_index(partitioner.store(*leaves[node.get_item_index()]));
+    }
+
+    // Leaves are owned by the fragments and get deleted along with them.
+    fragments.clear();
+
+    // Measure and save construction time.
+    stopwatch.measure();
+    m_build_time = stopwatch.get_seconds();
+}
+
+template <typename Tree, typename Partitioner>
+inline double ParallelSpatialBuilder<Tree, Partitioner>::get_build_time() const
+{
+    return m_build_time;
+}
+
+template <typename Tree, typename Partitioner>
+inline size_t ParallelSpatialBuilder<Tree, Partitioner>::get_task_count() const
+{
+    return m_task_count;
+}
+
+}   // namespace bvh
+}   // namespace foundation
@@ -46,6 +46,8 @@ namespace bvh {
 //
 // A base class for BVH partitioners.
 //
+// Partitioning disjoint ranges of items from multiple threads is safe.
+//
 
 template <typename AABBVector>
 class PartitionerBase
@@ -176,23 +178,9 @@ void PartitionerBase<AABBVector>::sort_indices(
             assert(left == pivot);
             assert(right == end);
 
-            const size_t size = indices.size();
-
-            if (end - begin > size / 2)
-            {
-                for (size_t i = 0; i < begin; ++i)
-                    m_tmp[i] = indices[i];
-
-                for (size_t i = end; i < size; ++i)
-                    m_tmp[i] = indices[i];
-
-                m_tmp.swap(indices);
-            }
-            else
-            {
-                for (size_t i = begin; i < end; ++i)
-                    indices[i] = m_tmp[i];
-            }
+            // Only touch [begin, end) such that disjoint ranges can be sorted concurrently.
+            for (size_t i = begin; i < end; ++i)
+                indices[i] = m_tmp[i];
         }
     }
 }
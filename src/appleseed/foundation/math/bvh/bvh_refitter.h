@@ -0,0 +1,195 @@
+
+//
+// This source file is part of appleseed.
+// Visit https://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2019 The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+// appleseed.foundation headers.
+#include "foundation/core/concepts/noncopyable.h"
+#include "foundation/math/aabb.h"
+
+// Standard headers.
+#include <cassert>
+#include <cstddef>
+
+namespace foundation {
+namespace bvh {
+
+//
+// Recompute the bounding boxes of an existing BVH from new item bounding boxes,
+// without changing the topology of the tree.
+//
+// Refitting is much cheaper than rebuilding but the quality of the tree degrades
+// as items move away from their original location. Compare the SAH cost of the
+// tree before and after refitting to decide when a full rebuild is warranted.
+//
+// Only trees without motion bounding boxes can be refitted.
+//
+
+template <typename Tree>
+class Refitter
+  : public NonCopyable
+{
+  public:
+    typedef typename Tree::NodeType NodeType;
+    typedef typename NodeType::AABBType AABBType;
+
+    // Refit the tree and return the bounding box of its root node.
+    // leaf_bbox(node) must return the bounding box of the items of a given leaf node.
+    template <typename LeafBBoxFunc>
+    AABBType refit(
+        Tree&                   tree,
+        const LeafBBoxFunc&     leaf_bbox) const;
+
+    // Return the SAH cost of the tree, relative to the surface area of its root node.
+    double compute_sah_cost(
+        const Tree&             tree,
+        const AABBType&         root_bbox,
+        const double            interior_node_traversal_cost,
+        const double            item_intersection_cost) const;
+
+  private:
+    template <typename LeafBBoxFunc>
+    AABBType refit_recurse(
+        Tree&                   tree,
+        const LeafBBoxFunc&     leaf_bbox,
+        const size_t            node_index) const;
+
+    double compute_sah_cost_recurse(
+        const Tree&             tree,
+        const size_t            node_index,
+        const AABBType&         node_bbox,
+        const double            interior_node_traversal_cost,
+        const double            item_intersection_cost) const;
+};
+
+
+//
+// Refitter class implementation.
+//
+
+template <typename Tree>
+template <typename LeafBBoxFunc>
+inline typename Refitter<Tree>::AABBType Refitter<Tree>::refit(
+    Tree&                       tree,
+    const LeafBBoxFunc&         leaf_bbox) const
+{
+    assert(!tree.m_nodes.empty());
+
+    return refit_recurse(tree, leaf_bbox, 0);
+}
+
+template <typename Tree>
+double Refitter<Tree>::compute_sah_cost(
+    const Tree&                 tree,
+    const AABBType&             root_bbox,
+    const double                interior_node_traversal_cost,
+    const double                item_intersection_cost) const
+{
+    assert(!tree.m_nodes.empty());
+
+    if (!root_bbox.is_valid())
+        return 0.0;
+
+    const double root_area = static_cast<double>(half_surface_area(root_bbox));
+
+    if (root_area == 0.0)
+        return 0.0;
+
+    const double cost =
+        compute_sah_cost_recurse(
+            tree,
+            0,
+            root_bbox,
+            interior_node_traversal_cost,
+            item_intersection_cost);
+
+    return cost / root_area;
+}
+
+template <typename Tree>
+template <typename LeafBBoxFunc>
+typename Refitter<Tree>::AABBType Refitter<Tree>::refit_recurse(
+    Tree&                       tree,
+    const LeafBBoxFunc&         leaf_bbox,
+    const size_t                node_index) const
+{
+    NodeType& node = tree.m_nodes[node_index];
+
+    if (node.is_leaf())
+        return leaf_bbox(node);
+
+    const size_t child_node_index = node.get_child_node_index();
+    const AABBType left_bbox = refit_recurse(tree, leaf_bbox, child_node_index);
+    const AABBType right_bbox = refit_recurse(tree, leaf_bbox, child_node_index + 1);
+
+    node.set_left_bbox(left_bbox);
+    node.set_right_bbox(right_bbox);
+
+    AABBType bbox = left_bbox;
+    bbox.insert(right_bbox);
+    return bbox;
+}
+
+template <typename Tree>
+double Refitter<Tree>::compute_sah_cost_recurse(
+    const Tree&                 tree,
+    const size_t                node_index,
+    const AABBType&             node_bbox,
+    const double                interior_node_traversal_cost,
+    const double                item_intersection_cost) const
+{
+    const NodeType& node = tree.m_nodes[node_index];
+
+    const double area =
+        node_bbox.is_valid()
+            ? static_cast<double>(half_surface_area(node_bbox))
+            : 0.0;
+
+    if (node.is_leaf())
+        return area * item_intersection_cost * node.get_item_count();
+
+    const size_t child_node_index = node.get_child_node_index();
+
+    return
+          area * interior_node_traversal_cost
+        + compute_sah_cost_recurse(
+              tree,
+              child_node_index,
+              node.get_left_bbox(),
+              interior_node_traversal_cost,
+              item_intersection_cost)
+        + compute_sah_cost_recurse(
+              tree,
+              child_node_index + 1,
+              node.get_right_bbox(),
+              interior_node_traversal_cost,
+              item_intersection_cost);
+}
+
+}   // namespace bvh
+}   // namespace foundation
@@ -73,6 +73,8 @@ namespace bvh {
 //              const AABBType&     bbox) const;
 //      };
 //
+// ItemHandler methods are called concurrently when the tree is built by multiple threads.
+//
 
 // When defined, additional costly correctness checks are enabled (only in Debug).
 #undef FOUNDATION_SBVH_DEEPCHECK
@@ -112,14 +114,19 @@ class SBVHPartitioner
     // Compute the bounding box of a given leaf.
     AABBType compute_leaf_bbox(const LeafType& leaf) const;
 
+    // Prepare the partitioner for concurrent calls to split() from a given number of threads.
+    void set_thread_count(const size_t thread_count);
+
     // Split a leaf. Return true if the split should be split or false if it should be kept unsplit.
+    // Different leaves may be split concurrently as long as each thread uses its own thread index.
     bool split(
         LeafType&                   leaf,
         const AABBType&             leaf_bbox,
         LeafType&                   left_leaf,
         AABBType&                   left_leaf_bbox,
         LeafType&                   right_leaf,
-        AABBType&                   right_leaf_bbox);
+        AABBType&                   right_leaf_bbox,
+        const size_t                thread_index = 0);
 
     // Store a leaf. Return the index of the first stored item.
     size_t store(const LeafType& leaf);
@@ -142,6 +149,16 @@ class SBVHPartitioner
         size_t      m_exit_counter;     // number of items that end in this bin
     };
 
+    // Per-thread scratch memory and counters.
+    struct Workspace
+    {
+        std::vector<AABBType>       m_left_bboxes;
+        std::vector<Bin>            m_bins;
+        std::vector<std::uint8_t>   m_tags;
+        size_t                      m_spatial_split_count;
+        size_t                      m_object_split_count;
+    };
+
     ItemHandler&                    m_item_handler;
     const AABBVectorType&           m_bboxes;
     const size_t                    m_max_leaf_size;
@@ -151,14 +168,9 @@ class SBVHPartitioner
     const ValueType                 m_item_intersection_cost;
 
     ValueType                       m_root_bbox_rcp_sa;
-    std::vector<AABBType>           m_left_bboxes;
-    std::vector<Bin>                m_bins;
-    std::vector<std::uint8_t>       m_tags;
+    std::vector<Workspace>          m_workspaces;
     std::vector<size_t>             m_final_indices;
 
-    size_t                          m_spatial_split_count;
-    size_t                          m_object_split_count;
-
     void compute_root_bbox_surface_area();
 
     ValueType compute_final_split_cost(
@@ -167,6 +179,7 @@ class SBVHPartitioner
 
     // Find the best object split for a given set of items.
     void find_object_split(
+        Workspace&                  workspace,
         LeafType&                   leaf,
         const AABBType&             leaf_bbox,
         AABBType&                   left_leaf_bbox,
@@ -177,6 +190,7 @@ class SBVHPartitioner
 
     // Find the best spatial split for a given set of items.
     void find_spatial_split(
+        Workspace&                  workspace,
         const LeafType&             leaf,
         const AABBType&             leaf_bbox,
         AABBType&                   left_leaf_bbox,
@@ -186,6 +200,7 @@ class SBVHPartitioner
 
     // Sort a set of items into two subsets according to a given object split.
     void object_sort(
+        Workspace&                  workspace,
         LeafType&                   leaf,
         const size_t                split_dim,
         const size_t                split_pivot,
@@ -224,13 +239,27 @@ SBVHPartitioner<ItemHandler, AABBVector>::SBVHPartitioner(
   , m_rcp_bin_count(ValueType(1.0) / bin_count)
   , m_interior_node_traversal_cost(interior_node_traversal_cost)
   , m_item_intersection_cost(item_intersection_cost)
-  , m_left_bboxes(bboxes.size() > 1 ? bboxes.size() - 1 : 0)
-  , m_bins(bin_count)
-  , m_tags(bboxes.size())
-  , m_spatial_split_count(0)
-  , m_object_split_count(0)
 {
     compute_root_bbox_surface_area();
+    set_thread_count(1);
+}
+
+template <typename ItemHandler, typename AABBVector>
+void SBVHPartitioner<ItemHandler, AABBVector>::set_thread_count(const size_t thread_count)
+{
+    assert(thread_count > 0);
+
+    // Scratch memory is allocated lazily since most threads only ever see small leaves.
+    const size_t old_thread_count = m_workspaces.size();
+    m_workspaces.resize(std::max(thread_count, old_thread_count));
+
+    for (size_t i = old_thread_count; i < m_workspaces.size(); ++i)
+    {
+        Workspace& workspace = m_workspaces[i];
+        workspace.m_bins.resize(m_bin_count);
+        workspace.m_spatial_split_count = 0;
+        workspace.m_object_split_count = 0;
+    }
 }
 
 template <typename ItemHandler, typename AABBVector>
@@ -279,9 +308,13 @@ bool SBVHPartitioner<ItemHandler, AABBVector>::split(
     LeafType&                       left_leaf,
     AABBType&                       left_leaf_bbox,
     LeafType&                       right_leaf,
-    AABBType&                       right_leaf_bbox)
+    AABBType&                       right_leaf_bbox,
+    const size_t                    thread_index)
 {
     assert(!leaf_bbox.is_valid() || leaf_bbox.rank() >= Dimension - 1);
+    assert(thread_index < m_workspaces.size());
+
+    Workspace& workspace = m_workspaces[thread_index];
 
 #ifdef FOUNDATION_SBVH_DEEPCHECK
     // Make sure every item intersects the leaf it belongs to.
@@ -304,6 +337,7 @@ bool SBVHPartitioner<ItemHandler, AABBVector>::split(
     size_t object_split_pivot;
     ValueType object_split_cost = std::numeric_limits<ValueType>::max();
     find_object_split(
+        workspace,
         leaf,
         leaf_bbox,
         object_split_left_bbox,
@@ -338,6 +372,7 @@ bool SBVHPartitioner<ItemHandler, AABBVector>::split(
     if (do_find_spatial_split)
     {
         find_spatial_split(
+            workspace,
             leaf,
             leaf_bbox,
             spatial_split_left_bbox,
@@ -361,6 +396,7 @@ bool SBVHPartitioner<ItemHandler, AABBVector>::split(
         left_leaf_bbox = object_split_left_bbox;
         right_leaf_bbox = object_split_right_bbox;
         object_sort(
+            workspace,
             leaf,
             object_split_dim,
             object_split_pivot,
@@ -368,7 +404,7 @@ bool SBVHPartitioner<ItemHandler, AABBVector>::split(
             right_leaf_bbox,
             left_leaf,
             right_leaf);
-        ++m_object_split_count;
+        ++workspace.m_object_split_count;
         return true;
     }
     else
@@ -383,7 +419,7 @@ bool SBVHPartitioner<ItemHandler, AABBVector>::split(
             right_leaf_bbox,
             left_leaf,
             right_leaf);
-        ++m_spatial_split_count;
+        ++workspace.m_spatial_split_count;
         return true;
     }
 }
@@ -426,6 +462,7 @@ inline typename AABBVector::value_type::ValueType SBVHPartitioner<ItemHandler, A
 
 template <typename ItemHandler, typename AABBVector>
 void SBVHPartitioner<ItemHandler, AABBVector>::find_object_split(
+    Workspace&                      workspace,
     LeafType&                       leaf,
     const AABBType&                 leaf_bbox,
     AABBType&                       left_leaf_bbox,
@@ -434,6 +471,10 @@ void SBVHPartitioner<ItemHandler, AABBVector>::find_object_split(
     size_t&                         best_split_pivot,
     ValueType&                      best_split_cost)
 {
+    std::vector<AABBType>& left_bboxes = workspace.m_left_bboxes;
+    if (left_bboxes.size() < leaf.size() - 1)
+        left_bboxes.resize(leaf.size() - 1);
+
     for (size_t d = 0; d < Dimension; ++d)
     {
         const std::vector<size_t>& indices = leaf.m_indices[d];
@@ -450,7 +491,7 @@ void SBVHPartitioner<ItemHandler, AABBVector>::find_object_split(
             const AABBType clipped_item_bbox = AABBType::intersect(item_bbox, leaf_bbox);
             assert(clipped_item_bbox.is_valid());
             bbox_accumulator.insert(clipped_item_bbox);
-            m_left_bboxes[i] = bbox_accumulator;
+            left_bboxes[i] = bbox_accumulator;
         }
 
         // Right-to-left sweep to accumulate bounding boxes, compute their surface area find the best partition.
@@ -465,7 +506,7 @@ void SBVHPartitioner<ItemHandler, AABBVector>::find_object_split(
             bbox_accumulator.insert(clipped_item_bbox);
 
             // Compute the cost of this partition.
-            const ValueType left_cost = half_surface_area(m_left_bboxes[i - 1]) * i;
+            const ValueType left_cost = half_surface_area(left_bboxes[i - 1]) * i;
             const ValueType right_cost = half_surface_area(bbox_accumulator) * (item_count - i);
             const ValueType split_cost = left_cost + right_cost;
 
@@ -475,7 +516,7 @@ void SBVHPartitioner<ItemHandler, AABBVector>::find_object_split(
                 best_split_cost = split_cost;
                 best_split_dim = d;
                 best_split_pivot = i;
-                left_leaf_bbox = m_left_bboxes[i - 1];
+                left_leaf_bbox = left_bboxes[i - 1];
                 right_leaf_bbox = bbox_accumulator;
             }
         }
@@ -486,6 +527,7 @@ void SBVHPartitioner<ItemHandler, AABBVector>::find_object_split(
 
 template <typename ItemHandler, typename AABBVector>
 void SBVHPartitioner<ItemHandler, AABBVector>::find_spatial_split(
+    Workspace&                      workspace,
     const LeafType&                 leaf,
     const AABBType&                 leaf_bbox,
     AABBType&                       left_leaf_bbox,
@@ -493,6 +535,8 @@ void SBVHPartitioner<ItemHandler, AABBVector>::find_spatial_split(
     SplitType&                      best_split,
     ValueType&                      best_split_cost)
 {
+    std::vector<Bin>& bins = workspace.m_bins;
+
     for (size_t d = 0; d < Dimension; ++d)
     {
         const std::vector<size_t>& indices = leaf.m_indices[d];
@@ -511,7 +555,7 @@ void SBVHPartitioner<ItemHandler, AABBVector>::find_spatial_split(
         // Clear the bins.
         for (size_t i = 0; i < m_bin_count; ++i)
         {
-            Bin& bin = m_bins[i];
+            Bin& bin = bins[i];
             bin.m_bin_bbox.invalidate();
             bin.m_entry_counter = 0;
             bin.m_exit_counter = 0;
@@ -555,21 +599,21 @@ void SBVHPartitioner<ItemHandler, AABBVector>::find_spatial_split(
                 assert(item_clipped_bbox.is_valid());
 
                 // Grow the bounding box associated with this bin.
-                m_bins[b].m_bin_bbox.insert(item_clipped_bbox);
+                bins[b].m_bin_bbox.insert(item_clipped_bbox);
             }
 
             // Update the enter/leave counters.
-            ++m_bins[begin_bin].m_entry_counter;
-            ++m_bins[end_bin].m_exit_counter;
+            ++bins[begin_bin].m_entry_counter;
+            ++bins[end_bin].m_exit_counter;
         }
 
         AABBType bbox_accumulator;
 
         // Left-to-right sweep to compute the left bounding boxes.
-        bbox_accumulator = m_bins[0].m_bin_bbox;
+        bbox_accumulator = bins[0].m_bin_bbox;
         for (size_t i = 1; i < m_bin_count; ++i)
         {
-            Bin& bin = m_bins[i];
+            Bin& bin = bins[i];
             bin.m_left_bbox = bbox_accumulator;
             bbox_accumulator.insert(bin.m_bin_bbox);
         }
@@ -580,7 +624,7 @@ void SBVHPartitioner<ItemHandler, AABBVector>::find_spatial_split(
         bbox_accumulator.invalidate();
         for (size_t i = m_bin_count - 1; i > 0; --i)
         {
-            const Bin& bin = m_bins[i];
+            const Bin& bin = bins[i];
 
             // Compute the right bounding box.
             bbox_accumulator.insert(bin.m_bin_bbox);
@@ -622,6 +666,7 @@ void SBVHPartitioner<ItemHandler, AABBVector>::find_spatial_split(
 
 template <typename ItemHandler, typename AABBVector>
 void SBVHPartitioner<ItemHandler, AABBVector>::object_sort(
+    Workspace&                      workspace,
     LeafType&                       leaf,
     const size_t                    split_dim,
     const size_t                    split_pivot,
@@ -633,13 +678,18 @@ void SBVHPartitioner<ItemHandler, AABBVector>::object_sort(
     const std::vector<size_t>& split_indices = leaf.m_indices[split_dim];
     const size_t size = split_indices.size();
 
+    // Tags are indexed by item since the same item may appear in leaves split by other threads.
+    std::vector<std::uint8_t>& tags = workspace.m_tags;
+    if (tags.size() < m_bboxes.size())
+        tags.resize(m_bboxes.size());
+
     enum { Left = 0, Right = 1 };
 
     for (size_t i = 0; i < split_pivot; ++i)
-        m_tags[split_indices[i]] = Left;
+        tags[split_indices[i]] = Left;
 
     for (size_t i = split_pivot; i < size; ++i)
-        m_tags[split_indices[i]] = Right;
+        tags[split_indices[i]] = Right;
 
     for (size_t d = 0; d < Dimension; ++d)
     {
@@ -679,7 +729,7 @@ void SBVHPartitioner<ItemHandler, AABBVector>::object_sort(
             {
                 const size_t item_index = leaf.m_indices[d][i];
 
-                if (m_tags[item_index] == Left)
+                if (tags[item_index] == Left)
                 {
                     assert(left < split_pivot);
                     left_leaf.m_indices[d][left++] = item_index;
@@ -795,13 +845,23 @@ inline const std::vector<size_t>& SBVHPartitioner<ItemHandler, AABBVector>::get_
 template <typename ItemHandler, typename AABBVector>
 inline size_t SBVHPartitioner<ItemHandler, AABBVector>::get_spatial_split_count() const
 {
-    return m_spatial_split_count;
+    size_t count = 0;
+
+    for (const Workspace& workspace : m_workspaces)
+        count += workspace.m_spatial_split_count;
+
+    return count;
 }
 
 template <typename ItemHandler, typename AABBVector>
 inline size_t SBVHPartitioner<ItemHandler, AABBVector>::get_object_split_count() const
 {
-    return m_object_split_count;
+    size_t count = 0;
+
+    for (const Workspace& workspace : m_workspaces)
+        count += workspace.m_object_split_count;
+
+    return count;
 }
 
 }   // namespace bvh
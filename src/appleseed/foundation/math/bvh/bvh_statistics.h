@@ -31,6 +31,7 @@
 
 // appleseed.foundation headers.
 #include "foundation/core/concepts/noncopyable.h"
+#include "foundation/math/bvh/bvh_node.h"
 #include "foundation/math/population.h"
 #include "foundation/string/string.h"
 #include "foundation/utility/statistics.h"
@@ -38,6 +39,7 @@
 // Standard headers.
 #include <cassert>
 #include <cstddef>
+#include <cstdint>
 
 namespace foundation {
 namespace bvh {
@@ -127,6 +129,12 @@ TreeStatistics<Tree>::TreeStatistics(
         "total " + pretty_uint(tree.m_nodes.size()) +
         "  interior " + pretty_uint(tree.m_nodes.size() - m_leaf_count) +
         "  leaves " + pretty_uint(m_leaf_count));
+    // Compare the memory footprint of the nodes against the footprint of full precision nodes.
+    const std::uint64_t node_memory = tree.m_nodes.size() * sizeof(NodeType);
+    const std::uint64_t full_node_memory = tree.m_nodes.size() * sizeof(Node<AABBType>);
+    insert_percent("node memory", node_memory, full_node_memory);
+    insert_size("node memory savings", full_node_memory > node_memory ? full_node_memory - node_memory : 0);
+
     insert_percent("leaf volume", m_leaf_volume, tree_volume);
     insert("leaf depth", m_leaf_depth);
     insert("leaf size", m_leaf_size);
@@ -65,12 +65,30 @@ class Tree
     template <typename Tree, typename Partitioner>
     friend class SpatialBuilder;
 
+    template <typename Tree, typename Partitioner>
+    friend class ParallelBuilder;
+
+    template <typename Tree, typename Partitioner>
+    friend class ParallelSpatialBuilder;
+
+    template <typename Tree>
+    friend class Refitter;
+
     template <typename Tree>
     friend class TreeStatistics;
 
     template <typename Tree, typename Visitor, typename Ray, size_t StackSize, size_t N>
     friend class Intersector;
 
+    template <typename Tree, size_t Width>
+    friend class WideTree;
+
+    template <typename Tree, typename Visitor, typename Ray, size_t Width, size_t StackSize>
+    friend class WideIntersector;
+
+    template <typename Tree, typename Visitor, typename Ray, size_t StackSize>
+    friend class PacketIntersector;
+
     typedef typename NodeType::AABBType AABBType;
     typedef std::vector<AABBType> AABBVector;
 
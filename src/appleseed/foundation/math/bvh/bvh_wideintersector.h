@@ -0,0 +1,398 @@
+
+//
+// This source file is part of appleseed.
+// Visit https://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2019 The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+// appleseed.foundation headers.
+#include "foundation/core/concepts/noncopyable.h"
+#include "foundation/math/bvh/bvh_intersector.h"
+#include "foundation/math/bvh/bvh_statistics.h"
+#include "foundation/math/bvh/bvh_widetree.h"
+#include "foundation/math/ray.h"
+#include "foundation/platform/compiler.h"
+#ifdef APPLESEED_USE_SSE
+#include "foundation/platform/sse.h"
+#endif
+
+// Standard headers.
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+namespace foundation {
+namespace bvh {
+
+namespace impl
+{
+    // Single precision version of a ray.
+    struct WideRayData
+    {
+        APPLESEED_SIMD4_ALIGN float m_org[4];
+        APPLESEED_SIMD4_ALIGN float m_rcp_dir[4];
+        size_t                      m_near[3];      // index of the near plane in each dimension
+        size_t                      m_far[3];       // index of the far plane in each dimension
+        float                       m_tmin;
+    };
+
+    // Enlarge the far distance to make single precision slab tests conservative.
+    const float WideSlabFarScale = 1.0f + 4.0f * std::numeric_limits<float>::epsilon();
+
+    // Intersect a ray with the Width bounding boxes of a wide node. Return a bit mask of
+    // the boxes that were hit, and store the distances to the entry points in 'tnear'.
+    template <size_t Width>
+    struct WideSlabTest
+    {
+        static size_t intersect(
+            const float             bbox_data[6][Width],
+            const WideRayData&      ray_data,
+            const float             tmax,
+            float                   tnear[Width])
+        {
+            size_t mask = 0;
+
+            for (size_t i = 0; i < Width; ++i)
+            {
+                // If the difference is zero and the reciprocal is infinite, the product is NaN:
+                // std::max() and std::min() then return their first argument, ignoring this slab.
+                float t0 = ray_data.m_tmin;
+                float t1 = tmax;
+
+                for (size_t d = 0; d < 3; ++d)
+                {
+                    t0 = std::max(t0, (bbox_data[ray_data.m_near[d]][i] - ray_data.m_org[d]) * ray_data.m_rcp_dir[d]);
+                    t1 = std::min(t1, (bbox_data[ray_data.m_far[d]][i] - ray_data.m_org[d]) * ray_data.m_rcp_dir[d]);
+                }
+
+                tnear[i] = t0;
+
+                if (t0 <= t1 * WideSlabFarScale)
+                    mask |= size_t(1) << i;
+            }
+
+            return mask;
+        }
+    };
+
+#ifdef APPLESEED_USE_SSE
+
+    template <>
+    struct WideSlabTest<4>
+    {
+        static size_t intersect(
+            const float             bbox_data[6][4],
+            const WideRayData&      ray_data,
+            const float             tmax,
+            float                   tnear[4])
+        {
+            // _mm_max_ps() and _mm_min_ps() return their second operand if either operand is NaN.
+            __m128 t0 = _mm_set1_ps(ray_data.m_tmin);
+            __m128 t1 = _mm_set1_ps(tmax);
+
+            for (size_t d = 0; d < 3; ++d)
+            {
+                const __m128 org = _mm_set1_ps(ray_data.m_org[d]);
+                const __m128 rcp_dir = _mm_set1_ps(ray_data.m_rcp_dir[d]);
+                t0 = _mm_max_ps(_mm_mul_ps(_mm_sub_ps(_mm_load_ps(bbox_data[ray_data.m_near[d]]), org), rcp_dir), t0);
+                t1 = _mm_min_ps(_mm_mul_ps(_mm_sub_ps(_mm_load_ps(bbox_data[ray_data.m_far[d]]), org), rcp_dir), t1);
+            }
+
+            _mm_store_ps(tnear, t0);
+
+            return static_cast<size_t>(
+                _mm_movemask_ps(_mm_cmple_ps(t0, _mm_mul_ps(t1, _mm_set1_ps(WideSlabFarScale)))));
+        }
+    };
+
+#endif
+
+#ifdef APPLESEED_USE_AVX
+
+    template <>
+    struct WideSlabTest<8>
+    {
+        static size_t intersect(
+            const float             bbox_data[6][8],
+            const WideRayData&      ray_data,
+            const float             tmax,
+            float                   tnear[8])
+        {
+            // _mm256_max_ps() and _mm256_min_ps() return their second operand if either operand is NaN.
+            __m256 t0 = _mm256_set1_ps(ray_data.m_tmin);
+            __m256 t1 = _mm256_set1_ps(tmax);
+
+            for (size_t d = 0; d < 3; ++d)
+            {
+                const __m256 org = _mm256_set1_ps(ray_data.m_org[d]);
+                const __m256 rcp_dir = _mm256_set1_ps(ray_data.m_rcp_dir[d]);
+                t0 = _mm256_max_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(bbox_data[ray_data.m_near[d]]), org), rcp_dir), t0);
+                t1 = _mm256_min_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(bbox_data[ray_data.m_far[d]]), org), rcp_dir), t1);
+            }
+
+            _mm256_storeu_ps(tnear, t0);
+
+            return static_cast<size_t>(
+                _mm256_movemask_ps(_mm256_cmp_ps(t0, _mm256_mul_ps(t1, _mm256_set1_ps(WideSlabFarScale)), _CMP_LE_OQ)));
+        }
+    };
+
+#endif
+}
+
+
+//
+// Wide BVH intersector.
+//
+// Tests a ray against all the children of a wide node at once (using SSE for
+// 4-wide nodes and AVX for 8-wide nodes when available), then visits the
+// children that were hit from nearest to farthest. Children farther than the
+// closest intersection found so far are skipped when popped from the stack.
+//
+// Leaves are nodes of the binary tree; the Visitor class must conform to the
+// same prototype as for foundation::bvh::Intersector.
+//
+// Slab tests are performed in single precision with the far distance slightly
+// enlarged to compensate for rounding errors.
+//
+// The default stack size is large enough for any tree built by WideTree::build().
+//
+
+template <
+    typename Tree,
+    typename Visitor,
+    typename Ray,
+    size_t Width,
+    size_t StackSize = WideTree<Tree, Width>::StackSize
+>
+class WideIntersector
+  : public NonCopyable
+{
+  public:
+    typedef WideTree<Tree, Width> WideTreeType;
+    typedef typename WideTreeType::NodeType NodeType;
+    typedef typename Ray::ValueType ValueType;
+    typedef Ray RayType;
+    typedef RayInfo<ValueType, 3> RayInfoType;
+
+    static_assert(
+        StackSize >= WideTreeType::StackSize,
+        "The traversal stack must be able to hold the nodes of a tree of maximum depth");
+
+    // Intersect a ray with a given wide BVH, built from a given binary BVH, without motion.
+    void intersect_no_motion(
+        const Tree&             tree,
+        const WideTreeType&     wide_tree,
+        const RayType&          ray,
+        const RayInfoType&      ray_info,
+        Visitor&                visitor
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+        , TraversalStatistics&  stats
+#endif
+        ) const;
+
+  private:
+    struct StackEntry
+    {
+        std::uint32_t           m_child;
+        float                   m_tnear;
+    };
+
+    static float to_float(const ValueType x);
+    static float to_float_round_up(const ValueType x);
+};
+
+
+//
+// WideIntersector class implementation.
+//
+
+template <typename Tree, typename Visitor, typename Ray, size_t Width, size_t StackSize>
+inline float WideIntersector<Tree, Visitor, Ray, Width, StackSize>::to_float(const ValueType x)
+{
+    // Values out of the range of float (including infinite reciprocals of null
+    // direction components) map to infinities.
+    const ValueType Max = static_cast<ValueType>(std::numeric_limits<float>::max());
+    return
+        x > Max ? +std::numeric_limits<float>::infinity() :
+        x < -Max ? -std::numeric_limits<float>::infinity() :
+        static_cast<float>(x);
+}
+
+template <typename Tree, typename Visitor, typename Ray, size_t Width, size_t StackSize>
+inline float WideIntersector<Tree, Visitor, Ray, Width, StackSize>::to_float_round_up(const ValueType x)
+{
+    const float y = to_float(x);
+    return static_cast<ValueType>(y) < x ? std::nextafter(y, std::numeric_limits<float>::infinity()) : y;
+}
+
+template <typename Tree, typename Visitor, typename Ray, size_t Width, size_t StackSize>
+void WideIntersector<Tree, Visitor, Ray, Width, StackSize>::intersect_no_motion(
+    const Tree&                 tree,
+    const WideTreeType&         wide_tree,
+    const RayType&              ray,
+    const RayInfoType&          ray_info,
+    Visitor&                    visitor
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+    , TraversalStatistics&      stats
+#endif
+    ) const
+{
+    // Make sure the trees were built.
+    assert(!tree.m_nodes.empty());
+    assert(!wide_tree.m_nodes.empty());
+
+    // Convert the ray to single precision.
+    impl::WideRayData ray_data;
+    for (size_t d = 0; d < 3; ++d)
+    {
+        ray_data.m_org[d] = to_float(ray.m_org[d]);
+        ray_data.m_rcp_dir[d] = to_float(ray_info.m_rcp_dir[d]);
+        ray_data.m_near[d] = 2 * d + 1 - ray_info.m_sgn_dir[d];
+        ray_data.m_far[d] = 2 * d + ray_info.m_sgn_dir[d];
+    }
+    ray_data.m_org[3] = ray_data.m_rcp_dir[3] = 0.0f;
+    ray_data.m_tmin = std::max(to_float(ray.m_tmin), 0.0f);
+
+    // Node stack.
+    StackEntry stack[StackSize];
+    StackEntry* stack_ptr = stack;
+
+    // Current node.
+    std::uint32_t child = 0;
+
+    // Initialize traversal statistics.
+    FOUNDATION_BVH_TRAVERSAL_STATS(++stats.m_traversal_count);
+    FOUNDATION_BVH_TRAVERSAL_STATS(size_t visited_nodes = 0);
+    FOUNDATION_BVH_TRAVERSAL_STATS(size_t visited_leaves = 0);
+    FOUNDATION_BVH_TRAVERSAL_STATS(size_t intersected_bboxes = 0);
+    FOUNDATION_BVH_TRAVERSAL_STATS(size_t discarded_nodes = 0);
+
+    // Traverse the tree and intersect leaf nodes.
+    ValueType ray_tmax = ray.m_tmax;
+    float ray_tmax_f = to_float_round_up(ray_tmax);
+    while (true)
+    {
+        FOUNDATION_BVH_TRAVERSAL_STATS(++visited_nodes);
+
+        if ((child & NodeType::LeafFlag) == 0)
+        {
+            const NodeType& node = wide_tree.m_nodes[child];
+            FOUNDATION_BVH_TRAVERSAL_STATS(intersected_bboxes += node.get_child_count());
+
+            // Intersect the bounding boxes of all children.
+            APPLESEED_SIMD4_ALIGN float tnear[Width];
+            const size_t mask =
+                impl::WideSlabTest<Width>::intersect(node.m_bbox_data, ray_data, ray_tmax_f, tnear);
+
+            // Sort the children that were hit from farthest to nearest.
+            size_t hit_count = 0;
+            StackEntry hits[Width];
+            for (size_t i = 0; i < Width; ++i)
+            {
+                if ((mask & (size_t(1) << i)) == 0)
+                    continue;
+
+                size_t j = hit_count++;
+                while (j > 0 && hits[j - 1].m_tnear < tnear[i])
+                {
+                    hits[j] = hits[j - 1];
+                    --j;
+                }
+
+                hits[j].m_child = node.m_children[i];
+                hits[j].m_tnear = tnear[i];
+            }
+
+            FOUNDATION_BVH_TRAVERSAL_STATS(discarded_nodes += node.get_child_count() - hit_count);
+
+            if (hit_count > 0)
+            {
+                // Push the far children to the stack, continue with the nearest child.
+                assert(stack_ptr + hit_count - 1 <= stack + StackSize);
+                for (size_t i = 0; i < hit_count - 1; ++i)
+                    *stack_ptr++ = hits[i];
+                child = hits[hit_count - 1].m_child;
+                continue;
+            }
+        }
+        else
+        {
+            // Visit the leaf.
+            FOUNDATION_BVH_TRAVERSAL_STATS(++visited_leaves);
+            ValueType distance;
+#ifndef NDEBUG
+            distance = ValueType(-1.0);
+#endif
+            const bool proceed =
+                visitor.visit(
+                    tree.m_nodes[child & ~NodeType::LeafFlag],
+                    ray,
+                    ray_info,
+                    distance
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+                    , stats
+#endif
+                    );
+            assert(!proceed || distance >= ValueType(0.0));
+
+            // Terminate traversal if the visitor decided so.
+            if (!proceed)
+                break;
+
+            // Keep track of the distance to the closest intersection.
+            if (ray_tmax > distance)
+            {
+                ray_tmax = distance;
+                ray_tmax_f = to_float_round_up(ray_tmax);
+            }
+        }
+
+        // Pop the nearest node from the stack that is not beyond the closest intersection.
+        while (stack_ptr > stack && (stack_ptr - 1)->m_tnear > ray_tmax_f)
+        {
+            FOUNDATION_BVH_TRAVERSAL_STATS(++discarded_nodes);
+            --stack_ptr;
+        }
+
+        // Terminate traversal if the node stack is empty.
+        if (stack_ptr == stack)
+            break;
+
+        child = (--stack_ptr)->m_child;
+    }
+
+    // Store traversal statistics.
+    FOUNDATION_BVH_TRAVERSAL_STATS(stats.m_visited_nodes.insert(visited_nodes));
+    FOUNDATION_BVH_TRAVERSAL_STATS(stats.m_visited_leaves.insert(visited_leaves));
+    FOUNDATION_BVH_TRAVERSAL_STATS(stats.m_intersected_bboxes.insert(intersected_bboxes));
+    FOUNDATION_BVH_TRAVERSAL_STATS(stats.m_discarded_nodes.insert(discarded_nodes));
+}
+
+}   // namespace bvh
+}   // namespace foundation
@@ -0,0 +1,627 @@
+
+//
+// This source file is part of appleseed.
+// Visit https://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2019 The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+// appleseed.foundation headers.
+#include "foundation/containers/alignedvector.h"
+#include "foundation/math/aabb.h"
+#include "foundation/platform/compiler.h"
+
+// Standard headers.
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace foundation {
+namespace bvh {
+
+//
+// Node of a wide BVH.
+//
+// A wide node holds up to Width children. The bounding boxes of the children
+// are stored in single precision, rounded outward, in structure-of-arrays
+// form so that all the children can be tested against a ray at once.
+//
+// Children are either other wide nodes or leaf nodes of the binary tree the
+// wide BVH was built from: leaves are shared with the binary tree, thus leaf
+// visitors written for the binary tree work unchanged with the wide BVH.
+//
+
+template <size_t Width>
+class APPLESEED_ALIGN(64) WideNode
+{
+  public:
+    static const size_t MaxChildCount = Width;
+
+    // Remove all children.
+    void clear();
+
+    // Add a child node.
+    template <typename AABBType>
+    void add_child(
+        const AABBType&     bbox,
+        const size_t        index,
+        const bool          is_leaf);
+
+    // Set the index of an existing child node.
+    void set_child_index(
+        const size_t        child,
+        const size_t        index);
+
+    // Set the bounding box of an existing child node.
+    template <typename AABBType>
+    void set_child_bbox(
+        const size_t        child,
+        const AABBType&     bbox);
+
+    // Access the child nodes.
+    size_t get_child_count() const;
+    bool is_leaf_child(const size_t child) const;
+    size_t get_child_index(const size_t child) const;
+    AABB3f get_child_bbox(const size_t child) const;
+
+  private:
+    template <typename Tree, typename Visitor, typename Ray, size_t W, size_t StackSize>
+    friend class WideIntersector;
+
+    static const std::uint32_t LeafFlag = 0x80000000u;
+    static const std::uint32_t EmptyChild = 0xFFFFFFFFu;
+
+    // Bounding boxes of the children: min x, max x, min y, max y, min z, max z.
+    float                           m_bbox_data[6][Width];
+
+    // Children indices. Leaf children have the LeafFlag bit set.
+    std::uint32_t                   m_children[Width];
+};
+
+
+//
+// Wide BVH.
+//
+// The wide BVH is built by collapsing an existing binary BVH (built with any
+// of the binary builders and partitioners): starting from the root, each wide
+// node adopts the children of the binary node, then repeatedly replaces the
+// interior child with the largest surface area by its own two children until
+// the node is full. Only the static bounding boxes of the binary tree are
+// used, so the wide BVH does not support motion blur.
+//
+// The depth of the wide BVH is limited to MaxDepth so that the traversal stack of
+// foundation::bvh::WideIntersector, which holds up to Width - 1 nodes per level,
+// cannot overflow. build() fails on deeper trees, which should then be traversed
+// with the binary intersector.
+//
+// The binary tree must outlive the wide BVH. Since the wide BVH only refers to
+// the binary tree in its methods, it can be a member of the binary tree.
+//
+// Once the wide BVH is built, remove_interior_nodes() can discard the interior
+// nodes of the binary tree so that the wide BVH replaces it rather than being
+// stored next to it. The binary tree then only holds the leaves referenced by
+// the wide BVH and can no longer be traversed on its own; refit the wide BVH
+// instead of the binary tree.
+//
+
+template <typename Tree, size_t Width>
+class WideTree
+{
+  public:
+    typedef WideNode<Width> NodeType;
+    typedef AlignedVector<NodeType> NodeVector;
+
+    // Maximum depth of the wide tree, and traversal stack size required to reach it.
+    static const size_t MaxDepth = 64;
+    static const size_t StackSize = (Width - 1) * MaxDepth + 1;
+
+    // Constructor.
+    WideTree();
+
+    typedef typename Tree::NodeType::AABBType AABBType;
+
+    // Collapse a given binary tree into this wide tree. Return false and leave
+    // this tree empty if the wide tree would be deeper than max_depth.
+    bool build(
+        const Tree&                 tree,
+        const size_t                max_depth = MaxDepth);
+
+    // Remove the interior nodes of the binary tree this wide tree was built from,
+    // keeping only its leaf nodes. The binary tree must not have motion bounding boxes.
+    void remove_interior_nodes(Tree& tree);
+
+    // Recompute the bounding boxes of the tree without changing its topology and
+    // return the bounding box of the root node. leaf_bbox(node) must return the
+    // bounding box of the items of a given leaf node of the binary tree.
+    template <typename LeafBBoxFunc>
+    AABBType refit(
+        const Tree&                 tree,
+        const LeafBBoxFunc&         leaf_bbox);
+
+    // Return the SAH cost of the tree, relative to the surface area of its root node.
+    double compute_sah_cost(
+        const Tree&                 tree,
+        const double                interior_node_traversal_cost,
+        const double                item_intersection_cost) const;
+
+    // Clear the tree.
+    void clear();
+
+    // Return true if the tree is empty.
+    bool empty() const;
+
+    // Return the number of wide nodes.
+    size_t get_node_count() const;
+
+    // Return the size (in bytes) of this object in memory.
+    size_t get_memory_size() const;
+
+  private:
+    template <typename T, typename Visitor, typename Ray, size_t W, size_t StackSize>
+    friend class WideIntersector;
+
+    NodeVector                      m_nodes;
+
+    bool collapse_recurse(
+        const Tree&                 tree,
+        const size_t                binary_node_index,
+        const size_t                wide_node_index,
+        const size_t                depth_left);
+
+    bool is_single_leaf() const;
+
+    template <typename LeafBBoxFunc>
+    AABBType refit_recurse(
+        const Tree&                 tree,
+        const LeafBBoxFunc&         leaf_bbox,
+        const size_t                wide_node_index);
+
+    double compute_sah_cost_recurse(
+        const Tree&                 tree,
+        const size_t                wide_node_index,
+        const double                interior_node_traversal_cost,
+        const double                item_intersection_cost) const;
+};
+
+
+//
+// WideNode class implementation.
+//
+
+template <size_t Width>
+inline void WideNode<Width>::clear()
+{
+    for (size_t i = 0; i < Width; ++i)
+    {
+        // Empty children have inverted bounding boxes that never intersect any ray.
+        m_bbox_data[0][i] = m_bbox_data[2][i] = m_bbox_data[4][i] = +std::numeric_limits<float>::max();
+        m_bbox_data[1][i] = m_bbox_data[3][i] = m_bbox_data[5][i] = -std::numeric_limits<float>::max();
+        m_children[i] = EmptyChild;
+    }
+}
+
+template <size_t Width>
+template <typename AABBType>
+inline void WideNode<Width>::add_child(
+    const AABBType&                 bbox,
+    const size_t                    index,
+    const bool                      is_leaf)
+{
+    const size_t child = get_child_count();
+    assert(child < Width);
+    assert(index < LeafFlag);
+
+    m_children[child] = static_cast<std::uint32_t>(index) | (is_leaf ? LeafFlag : 0);
+
+    set_child_bbox(child, bbox);
+}
+
+template <size_t Width>
+inline void WideNode<Width>::set_child_index(
+    const size_t                    child,
+    const size_t                    index)
+{
+    assert(child < get_child_count());
+    assert(index < LeafFlag);
+
+    m_children[child] = (m_children[child] & LeafFlag) | static_cast<std::uint32_t>(index);
+}
+
+template <size_t Width>
+template <typename AABBType>
+inline void WideNode<Width>::set_child_bbox(
+    const size_t                    child,
+    const AABBType&                 bbox)
+{
+    assert(child < get_child_count());
+
+    for (size_t d = 0; d < 3; ++d)
+    {
+        float min = static_cast<float>(bbox.min[d]);
+        float max = static_cast<float>(bbox.max[d]);
+
+        // Round outward so that the single precision bounding box encloses the original one.
+        if (min > bbox.min[d])
+            min = std::nextafter(min, -std::numeric_limits<float>::max());
+        if (max < bbox.max[d])
+            max = std::nextafter(max, +std::numeric_limits<float>::max());
+
+        m_bbox_data[d * 2 + 0][child] = min;
+        m_bbox_data[d * 2 + 1][child] = max;
+    }
+}
+
+template <size_t Width>
+inline size_t WideNode<Width>::get_child_count() const
+{
+    size_t count = 0;
+
+    while (count < Width && m_children[count] != EmptyChild)
+        ++count;
+
+    return count;
+}
+
+template <size_t Width>
+inline bool WideNode<Width>::is_leaf_child(const size_t child) const
+{
+    assert(child < get_child_count());
+    return (m_children[child] & LeafFlag) != 0;
+}
+
+template <size_t Width>
+inline size_t WideNode<Width>::get_child_index(const size_t child) const
+{
+    assert(child < get_child_count());
+    return static_cast<size_t>(m_children[child] & ~LeafFlag);
+}
+
+template <size_t Width>
+inline AABB3f WideNode<Width>::get_child_bbox(const size_t child) const
+{
+    assert(child < get_child_count());
+
+    return
+        AABB3f(
+            Vector3f(m_bbox_data[0][child], m_bbox_data[2][child], m_bbox_data[4][child]),
+            Vector3f(m_bbox_data[1][child], m_bbox_data[3][child], m_bbox_data[5][child]));
+}
+
+
+//
+// WideTree class implementation.
+//
+
+template <typename Tree, size_t Width>
+WideTree<Tree, Width>::WideTree()
+  : m_nodes(typename NodeVector::allocator_type(64))   // align nodes on cache lines for aligned AVX loads
+{
+}
+
+template <typename Tree, size_t Width>
+bool WideTree<Tree, Width>::build(
+    const Tree&                     tree,
+    const size_t                    max_depth)
+{
+    static_assert(Width >= 2, "Wide BVH nodes must have at least two children");
+    static_assert(Tree::NodeType::AABBType::Dimension == 3, "Wide BVHs are only supported in 3D");
+
+    assert(!tree.m_nodes.empty());
+    assert(max_depth > 0 && max_depth <= MaxDepth);
+
+    m_nodes.clear();
+
+    // Each collapse step turns one binary interior node into at least one extra child.
+    m_nodes.reserve(tree.m_nodes.size() / (Width - 1) + 1);
+
+    m_nodes.push_back(NodeType());
+    m_nodes.back().clear();
+
+    if (tree.m_nodes[0].is_leaf())
+    {
+        // The root of the binary tree is a leaf: it covers all space.
+        const float Max = std::numeric_limits<float>::max();
+        m_nodes.back().add_child(AABB3f(Vector3f(-Max), Vector3f(Max)), 0, true);
+    }
+    else if (!collapse_recurse(tree, 0, 0, max_depth - 1))
+    {
+        clear();
+        return false;
+    }
+
+    return true;
+}
+
+template <typename Tree, size_t Width>
+bool WideTree<Tree, Width>::collapse_recurse(
+    const Tree&                     tree,
+    const size_t                    binary_node_index,
+    const size_t                    wide_node_index,
+    const size_t                    depth_left)
+{
+    typedef typename Tree::NodeType BinaryNodeType;
+    typedef typename BinaryNodeType::AABBType AABBType;
+
+    const BinaryNodeType& binary_node = tree.m_nodes[binary_node_index];
+    assert(binary_node.is_interior());
+
+    // Start with the two children of the binary node.
+    size_t child_count = 2;
+    size_t child_indices[Width];
+    AABBType child_bboxes[Width];
+    child_indices[0] = binary_node.get_child_node_index() + 0;
+    child_indices[1] = binary_node.get_child_node_index() + 1;
+    child_bboxes[0] = binary_node.get_left_bbox();
+    child_bboxes[1] = binary_node.get_right_bbox();
+
+    // Open the interior child with the largest surface area until the wide node is full.
+    while (child_count < Width)
+    {
+        size_t best_child = Width;
+        typename AABBType::ValueType best_area(-1.0);
+
+        for (size_t i = 0; i < child_count; ++i)
+        {
+            if (tree.m_nodes[child_indices[i]].is_leaf())
+                continue;
+
+            const typename AABBType::ValueType area = half_surface_area(child_bboxes[i]);
+            if (best_area < area)
+            {
+                best_area = area;
+                best_child = i;
+            }
+        }
+
+        if (best_child == Width)
+            break;
+
+        const BinaryNodeType& opened_node = tree.m_nodes[child_indices[best_child]];
+        child_indices[child_count] = opened_node.get_child_node_index() + 1;
+        child_bboxes[child_count] = opened_node.get_right_bbox();
+        child_indices[best_child] = opened_node.get_child_node_index() + 0;
+        child_bboxes[best_child] = opened_node.get_left_bbox();
+        ++child_count;
+    }
+
+    // Store the children, then allocate and recurse into interior ones one at a time,
+    // so that each subtree immediately follows the node that first references it.
+    for (size_t i = 0; i < child_count; ++i)
+    {
+        const bool is_leaf = tree.m_nodes[child_indices[i]].is_leaf();
+        m_nodes[wide_node_index].add_child(child_bboxes[i], is_leaf ? child_indices[i] : 0, is_leaf);
+    }
+
+    for (size_t i = 0; i < child_count; ++i)
+    {
+        if (tree.m_nodes[child_indices[i]].is_leaf())
+            continue;
+
+        if (depth_left == 0)
+            return false;
+
+        const size_t child_node_index = m_nodes.size();
+        m_nodes.push_back(NodeType());
+        m_nodes.back().clear();
+        m_nodes[wide_node_index].set_child_index(i, child_node_index);
+
+        if (!collapse_recurse(tree, child_indices[i], child_node_index, depth_left - 1))
+            return false;
+    }
+
+    return true;
+}
+
+template <typename Tree, size_t Width>
+void WideTree<Tree, Width>::remove_interior_nodes(Tree& tree)
+{
+    assert(!m_nodes.empty());
+    assert(tree.m_node_bboxes.empty());
+
+    // Move the leaf nodes to the front of the binary tree, preserving their order.
+    std::vector<size_t> new_indices(tree.m_nodes.size(), ~size_t(0));
+    size_t leaf_count = 0;
+
+    for (size_t i = 0, e = tree.m_nodes.size(); i < e; ++i)
+    {
+        if (tree.m_nodes[i].is_leaf())
+        {
+            new_indices[i] = leaf_count;
+            tree.m_nodes[leaf_count++] = tree.m_nodes[i];
+        }
+    }
+
+    // Release the memory used by the interior nodes.
+    typename Tree::NodeVectorType leaf_nodes(
+        tree.m_nodes.begin(),
+        tree.m_nodes.begin() + leaf_count,
+        tree.m_nodes.get_allocator());
+    tree.m_nodes.swap(leaf_nodes);
+
+    // Update the references to the leaf nodes.
+    for (size_t i = 0, e = m_nodes.size(); i < e; ++i)
+    {
+        NodeType& node = m_nodes[i];
+
+        for (size_t c = 0, ce = node.get_child_count(); c < ce; ++c)
+        {
+            if (node.is_leaf_child(c))
+            {
+                assert(new_indices[node.get_child_index(c)] != ~size_t(0));
+                node.set_child_index(c, new_indices[node.get_child_index(c)]);
+            }
+        }
+    }
+}
+
+template <typename Tree, size_t Width>
+template <typename LeafBBoxFunc>
+typename WideTree<Tree, Width>::AABBType WideTree<Tree, Width>::refit(
+    const Tree&                     tree,
+    const LeafBBoxFunc&             leaf_bbox)
+{
+    assert(!m_nodes.empty());
+
+    // A single leaf covers all space, see build().
+    if (is_single_leaf())
+        return leaf_bbox(tree.m_nodes[m_nodes[0].get_child_index(0)]);
+
+    return refit_recurse(tree, leaf_bbox, 0);
+}
+
+template <typename Tree, size_t Width>
+double WideTree<Tree, Width>::compute_sah_cost(
+    const Tree&                     tree,
+    const double                    interior_node_traversal_cost,
+    const double                    item_intersection_cost) const
+{
+    assert(!m_nodes.empty());
+
+    if (is_single_leaf())
+        return 0.0;
+
+    const NodeType& root = m_nodes[0];
+    AABB3f root_bbox;
+    root_bbox.invalidate();
+
+    for (size_t i = 0, e = root.get_child_count(); i < e; ++i)
+        root_bbox.insert(root.get_child_bbox(i));
+
+    if (!root_bbox.is_valid())
+        return 0.0;
+
+    const double root_area = static_cast<double>(half_surface_area(root_bbox));
+
+    if (root_area == 0.0)
+        return 0.0;
+
+    const double cost =
+          root_area * interior_node_traversal_cost
+        + compute_sah_cost_recurse(
+              tree,
+              0,
+              interior_node_traversal_cost,
+              item_intersection_cost);
+
+    return cost / root_area;
+}
+
+template <typename Tree, size_t Width>
+inline bool WideTree<Tree, Width>::is_single_leaf() const
+{
+    return m_nodes.size() == 1 && m_nodes[0].get_child_count() == 1 && m_nodes[0].is_leaf_child(0);
+}
+
+template <typename Tree, size_t Width>
+template <typename LeafBBoxFunc>
+typename WideTree<Tree, Width>::AABBType WideTree<Tree, Width>::refit_recurse(
+    const Tree&                     tree,
+    const LeafBBoxFunc&             leaf_bbox,
+    const size_t                    wide_node_index)
+{
+    AABBType bbox;
+    bbox.invalidate();
+
+    for (size_t i = 0, e = m_nodes[wide_node_index].get_child_count(); i < e; ++i)
+    {
+        const size_t child_index = m_nodes[wide_node_index].get_child_index(i);
+        const AABBType child_bbox =
+            m_nodes[wide_node_index].is_leaf_child(i)
+                ? leaf_bbox(tree.m_nodes[child_index])
+                : refit_recurse(tree, leaf_bbox, child_index);
+
+        m_nodes[wide_node_index].set_child_bbox(i, child_bbox);
+        bbox.insert(child_bbox);
+    }
+
+    return bbox;
+}
+
+template <typename Tree, size_t Width>
+double WideTree<Tree, Width>::compute_sah_cost_recurse(
+    const Tree&                     tree,
+    const size_t                    wide_node_index,
+    const double                    interior_node_traversal_cost,
+    const double                    item_intersection_cost) const
+{
+    const NodeType& node = m_nodes[wide_node_index];
+    double cost = 0.0;
+
+    for (size_t i = 0, e = node.get_child_count(); i < e; ++i)
+    {
+        const AABB3f child_bbox = node.get_child_bbox(i);
+        const double area =
+            child_bbox.is_valid()
+                ? static_cast<double>(half_surface_area(child_bbox))
+                : 0.0;
+
+        if (node.is_leaf_child(i))
+            cost += area * item_intersection_cost * tree.m_nodes[node.get_child_index(i)].get_item_count();
+        else
+        {
+            cost +=
+                  area * interior_node_traversal_cost
+                + compute_sah_cost_recurse(
+                      tree,
+                      node.get_child_index(i),
+                      interior_node_traversal_cost,
+                      item_intersection_cost);
+        }
+    }
+
+    return cost;
+}
+
+template <typename Tree, size_t Width>
+inline void WideTree<Tree, Width>::clear()
+{
+    m_nodes.clear();
+}
+
+template <typename Tree, size_t Width>
+inline bool WideTree<Tree, Width>::empty() const
+{
+    return m_nodes.empty();
+}
+
+template <typename Tree, size_t Width>
+inline size_t WideTree<Tree, Width>::get_node_count() const
+{
+    return m_nodes.size();
+}
+
+template <typename Tree, size_t Width>
+inline size_t WideTree<Tree, Width>::get_memory_size() const
+{
+    return
+          sizeof(*this)
+        + m_nodes.capacity() * sizeof(NodeType);
+}
+
+}   // namespace bvh
+}   // namespace foundation
@@ -92,6 +92,7 @@ class Answer
     const Entry& top() const;
 
   private:
+    template <typename, size_t> friend class HashGridQuery;
     template <typename, size_t> friend class Query;
 
     const size_t        m_max_size;
@@ -0,0 +1,436 @@
+
+//
+// This source file is part of appleseed.
+// Visit https://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2019 The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+// appleseed.foundation headers.
+#include "foundation/core/concepts/noncopyable.h"
+#include "foundation/hash/hash.h"
+#include "foundation/math/aabb.h"
+#include "foundation/math/distance.h"
+#include "foundation/math/knn/knn_answer.h"
+#include "foundation/math/scalar.h"
+#include "foundation/math/vector.h"
+#include "foundation/memory/memory.h"
+
+// Standard headers.
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace foundation {
+namespace knn {
+
+//
+// A uniform grid of points, whose cells are stored in a hash table.
+//
+// Points are sorted by hash table bucket such that the points of a cell are contiguous
+// in memory. This makes fixed radius searches much more cache friendly than k-d tree
+// traversals when the search radius is close to the cell size.
+//
+// Like Tree, the grid exposes points by internal index; use remap() to retrieve the
+// index of a point in the array given to build_move_points().
+//
+
+template <typename T, size_t N>
+class HashGrid
+  : public NonCopyable
+{
+  public:
+    typedef T ValueType;
+    static const size_t Dimension = N;
+
+    typedef Vector<T, N> VectorType;
+
+    // Constructor.
+    HashGrid();
+
+    // Build the grid for a given set of points. The points are moved into the grid.
+    void build_move_points(
+        std::vector<VectorType>&    points,
+        const ValueType             cell_size);
+
+    // Return true if the grid does not contain any point.
+    bool empty() const;
+
+    // Transform an internal index to a user-data index.
+    size_t remap(const size_t i) const;
+
+    // Return the i'th point, where i is an internal index.
+    const VectorType& get_point(const size_t i) const;
+
+    // Return the size of the cells.
+    ValueType get_cell_size() const;
+
+    // Return the number of buckets of the hash table.
+    size_t get_bucket_count() const;
+
+    // Return the size (in bytes) of this object in memory.
+    size_t get_memory_size() const;
+
+  private:
+    template <typename, size_t> friend class HashGridQuery;
+
+    typedef Vector<std::int64_t, N> CellType;
+
+    // Cells are clamped such that grid coordinates fit comfortably in 64-bit integers.
+    static const size_t MaxCellsPerDimension = size_t(1) << 20;
+
+    AABB<T, N>              m_bbox;
+    ValueType               m_cell_size;
+    ValueType               m_rcp_cell_size;
+    CellType                m_max_cell;
+    size_t                  m_bucket_mask;
+
+    std::vector<VectorType> m_points;
+    std::vector<size_t>     m_indices;
+    std::vector<size_t>     m_bucket_offsets;   // first point of each bucket, plus one sentinel
+
+    CellType compute_cell(const VectorType& point) const;
+    size_t compute_bucket(const CellType& cell) const;
+};
+
+typedef HashGrid<float, 2>  HashGrid2f;
+typedef HashGrid<double, 2> HashGrid2d;
+typedef HashGrid<float, 3>  HashGrid3f;
+typedef HashGrid<double, 3> HashGrid3d;
+
+
+//
+// Find the points of a hash grid closest to a query point, within a maximum distance.
+//
+// Fills the answer exactly like foundation::knn::Query: at most answer-size points,
+// strictly closer than the maximum distance, in no particular order.
+//
+
+template <typename T, size_t N>
+class HashGridQuery
+  : public NonCopyable
+{
+  public:
+    typedef T ValueType;
+    static const size_t Dimension = N;
+
+    typedef Vector<T, N> VectorType;
+    typedef HashGrid<T, N> GridType;
+    typedef Answer<T> AnswerType;
+
+    // Constructor.
+    HashGridQuery(
+        const GridType&         grid,
+        AnswerType&             answer);
+
+    // Run the query. Return the number of points tested against the query point.
+    size_t run(
+        const VectorType&       query_point,
+        const ValueType         max_square_distance) const;
+
+  private:
+    typedef typename GridType::CellType CellType;
+
+    // Number of buckets that can be visited without scanning the whole grid.
+    static const size_t MaxVisitedBuckets = 64;
+
+    const GridType&             m_grid;
+    AnswerType&                 m_answer;
+
+    void test_points(
+        const size_t            begin,
+        const size_t            end,
+        const VectorType&       query_point,
+        ValueType&              max_square_dist) const;
+};
+
+typedef HashGridQuery<float, 2>  HashGridQuery2f;
+typedef HashGridQuery<double, 2> HashGridQuery2d;
+typedef HashGridQuery<float, 3>  HashGridQuery3f;
+typedef HashGridQuery<double, 3> HashGridQuery3d;
+
+
+//
+// HashGrid class implementation.
+//
+
+template <typename T, size_t N>
+HashGrid<T, N>::HashGrid()
+  : m_cell_size(T(0.0))
+  , m_rcp_cell_size(T(0.0))
+  , m_bucket_mask(0)
+{
+    m_bbox.invalidate();
+}
+
+template <typename T, size_t N>
+void HashGrid<T, N>::build_move_points(
+    std::vector<VectorType>&    points,
+    const ValueType             cell_size)
+{
+    assert(cell_size >= T(0.0));
+
+    const size_t count = points.size();
+
+    m_points.clear();
+    m_indices.clear();
+    m_bucket_offsets.assign(1, 0);
+    m_bucket_mask = 0;
+    m_bbox.invalidate();
+
+    if (count == 0)
+        return;
+
+    // Compute the bounding box of the points.
+    for (const VectorType& point : points)
+        m_bbox.insert(point);
+
+    // Make sure the grid doesn't have too many cells along any dimension.
+    const ValueType min_cell_size = max_value(m_bbox.extent()) / MaxCellsPerDimension;
+    m_cell_size = std::max(cell_size, min_cell_size);
+    if (m_cell_size == T(0.0))
+        m_cell_size = T(1.0);
+    m_rcp_cell_size = T(1.0) / m_cell_size;
+    m_max_cell = compute_cell(m_bbox.max);
+
+    // Use a power-of-two hash table with about twice as many buckets as points.
+    const size_t bucket_count = next_pow2<std::uint64_t>(2 * count);
+    m_bucket_mask = bucket_count - 1;
+
+    // Count the points of each bucket.
+    std::vector<size_t> point_buckets(count);
+    m_bucket_offsets.assign(bucket_count + 1, 0);
+    for (size_t i = 0; i < count; ++i)
+    {
+        const size_t bucket = compute_bucket(compute_cell(points[i]));
+        point_buckets[i] = bucket;
+        ++m_bucket_offsets[bucket + 1];
+    }
+
+    // Turn point counts into offsets.
+    for (size_t i = 0; i < bucket_count; ++i)
+        m_bucket_offsets[i + 1] += m_bucket_offsets[i];
+
+    // Sort points by bucket.
+    std::vector<size_t> next_slots(m_bucket_offsets.begin(), m_bucket_offsets.end() - 1);
+    m_points.resize(count);
+    m_indices.resize(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        const size_t slot = next_slots[point_buckets[i]]++;
+        m_points[slot] = points[i];
+        m_indices[slot] = i;
+    }
+
+    // Mimic the k-d tree builders which consume the input points.
+    clear_release_memory(points);
+}
+
+template <typename T, size_t N>
+inline bool HashGrid<T, N>::empty() const
+{
+    return m_points.empty();
+}
+
+template <typename T, size_t N>
+inline size_t HashGrid<T, N>::remap(const size_t i) const
+{
+    assert(i < m_indices.size());
+    return m_indices[i];
+}
+
+template <typename T, size_t N>
+inline const Vector<T, N>& HashGrid<T, N>::get_point(const size_t i) const
+{
+    assert(i < m_points.size());
+    return m_points[i];
+}
+
+template <typename T, size_t N>
+inline T HashGrid<T, N>::get_cell_size() const
+{
+    return m_cell_size;
+}
+
+template <typename T, size_t N>
+inline size_t HashGrid<T, N>::get_bucket_count() const
+{
+    return m_bucket_offsets.size() - 1;
+}
+
+template <typename T, size_t N>
+inline size_t HashGrid<T, N>::get_memory_size() const
+{
+    size_t mem_size = sizeof(*this);
+    mem_size += m_points.capacity() * sizeof(VectorType);
+    mem_size += m_indices.capacity() * sizeof(size_t);
+    mem_size += m_bucket_offsets.capacity() * sizeof(size_t);
+    return mem_size;
+}
+
+template <typename T, size_t N>
+inline typename HashGrid<T, N>::CellType HashGrid<T, N>::compute_cell(const VectorType& point) const
+{
+    CellType cell;
+
+    for (size_t d = 0; d < N; ++d)
+    {
+        const ValueType x = std::max((point[d] - m_bbox.min[d]) * m_rcp_cell_size, T(0.0));
+        cell[d] = truncate<std::int64_t>(std::min(x, static_cast<ValueType>(MaxCellsPerDimension)));
+    }
+
+    return cell;
+}
+
+template <typename T, size_t N>
+inline size_t HashGrid<T, N>::compute_bucket(const CellType& cell) const
+{
+    std::uint64_t h = 0;
+
+    for (size_t d = 0; d < N; ++d)
+        h = hash_uint64(h ^ static_cast<std::uint64_t>(cell[d]));
+
+    return static_cast<size_t>(h) & m_bucket_mask;
+}
+
+
+//
+// HashGridQuery class implementation.
+//
+
+template <typename T, size_t N>
+inline HashGridQuery<T, N>::HashGridQuery(
+    const GridType&             grid,
+    AnswerType&                 answer)
+  : m_grid(grid)
+  , m_answer(answer)
+{
+}
+
+template <typename T, size_t N>
+size_t HashGridQuery<T, N>::run(
+    const VectorType&           query_point,
+    const ValueType             max_square_distance) const
+{
+    m_answer.clear();
+
+    if (m_grid.empty())
+        return 0;
+
+    // Compute the range of cells overlapping the search sphere.
+    const ValueType radius = std::sqrt(max_square_distance);
+    const CellType min_cell = m_grid.compute_cell(query_point - VectorType(radius));
+    CellType max_cell = m_grid.compute_cell(query_point + VectorType(radius));
+    size_t cell_count = 1;
+    for (size_t d = 0; d < N; ++d)
+    {
+        max_cell[d] = std::min(max_cell[d], m_grid.m_max_cell[d]);
+        if (min_cell[d] > max_cell[d])
+            return 0;
+        cell_count *= static_cast<size_t>(max_cell[d] - min_cell[d] + 1);
+    }
+
+    ValueType max_square_dist = max_square_distance;
+
+    // Scan the whole grid if the search sphere overlaps too many cells.
+    if (cell_count > MaxVisitedBuckets)
+    {
+        test_points(0, m_grid.m_points.size(), query_point, max_square_dist);
+        return m_grid.m_points.size();
+    }
+
+    // Collect the buckets of the cells. Distinct cells may share a bucket.
+    size_t buckets[MaxVisitedBuckets];
+    size_t bucket_count = 0;
+    CellType cell = min_cell;
+    while (true)
+    {
+        buckets[bucket_count++] = m_grid.compute_bucket(cell);
+
+        size_t d = 0;
+        while (d < N && cell[d] == max_cell[d])
+        {
+            cell[d] = min_cell[d];
+            ++d;
+        }
+
+        if (d == N)
+            break;
+
+        ++cell[d];
+    }
+
+    std::sort(buckets, buckets + bucket_count);
+    bucket_count = std::unique(buckets, buckets + bucket_count) - buckets;
+
+    // Test the points of every bucket.
+    size_t tested_point_count = 0;
+    for (size_t i = 0; i < bucket_count; ++i)
+    {
+        const size_t begin = m_grid.m_bucket_offsets[buckets[i]];
+        const size_t end = m_grid.m_bucket_offsets[buckets[i] + 1];
+        test_points(begin, end, query_point, max_square_dist);
+        tested_point_count += end - begin;
+    }
+
+    return tested_point_count;
+}
+
+template <typename T, size_t N>
+inline void HashGridQuery<T, N>::test_points(
+    const size_t                begin,
+    const size_t                end,
+    const VectorType&           query_point,
+    ValueType&                  max_square_dist) const
+{
+    const size_t max_answer_size = m_answer.m_max_size;
+
+    for (size_t i = begin; i < end; ++i)
+    {
+        const ValueType square_dist = square_distance(m_grid.m_points[i], query_point);
+
+        if (square_dist < max_square_dist)
+        {
+            if (m_answer.m_size == max_answer_size)
+            {
+                m_answer.heap_insert(i, square_dist);
+                max_square_dist = m_answer.top().m_square_dist;
+            }
+            else
+            {
+                m_answer.array_insert(i, square_dist);
+
+                if (m_answer.m_size == max_answer_size)
+                    m_answer.make_heap();
+            }
+        }
+    }
+}
+
+}   // namespace knn
+}   // namespace foundation
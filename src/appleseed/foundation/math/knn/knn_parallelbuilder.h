@@ -0,0 +1,377 @@
+
+//
+// This source file is part of appleseed.
+// Visit https://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2019 The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+// appleseed.foundation headers.
+#include "foundation/core/concepts/noncopyable.h"
+#include "foundation/log/logger.h"
+#include "foundation/math/aabb.h"
+#include "foundation/math/knn/knn_node.h"
+#include "foundation/math/knn/knn_tree.h"
+#include "foundation/math/split.h"
+#include "foundation/math/vector.h"
+#include "foundation/utility/job/ijob.h"
+#include "foundation/utility/job/jobmanager.h"
+#include "foundation/utility/job/jobqueue.h"
+#include "foundation/utility/stopwatch.h"
+
+// Boost headers.
+#include "boost/atomic/atomic.hpp"
+
+// Standard headers.
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+namespace foundation {
+namespace knn {
+
+//
+// Multithreaded k-d tree builder.
+//
+// Builds the same tree as foundation::knn::Builder, but subtrees containing enough
+// points are built in parallel.
+//
+// Since leaves contain at most one point, a subtree containing n > 0 points always
+// has 2n - 1 nodes. The node array can then be allocated upfront, and every task
+// writes its nodes directly at the position where the serial builder would have
+// stored them.
+//
+
+template <typename T, size_t N>
+class ParallelBuilder
+  : public NonCopyable
+{
+  public:
+    typedef T ValueType;
+    static const size_t Dimension = N;
+
+    typedef Vector<T, N> VectorType;
+    typedef Tree<T, N> TreeType;
+
+    // Constructor. Build threads report to the given logger.
+    ParallelBuilder(
+        TreeType&                   tree,
+        Logger&                     logger);
+
+    // Build a tree for a given set of points.
+    // Subtrees with fewer than min_task_size points are built by a single thread.
+    template <typename Timer>
+    void build(
+        const VectorType            points[],
+        const size_t                count,
+        const size_t                thread_count,
+        const size_t                min_task_size = 4096);
+
+    // Like build() but the points will be moved into the tree rather than copied.
+    template <typename Timer>
+    void build_move_points(
+        std::vector<VectorType>&    points,
+        const size_t                thread_count,
+        const size_t                min_task_size = 4096);
+
+    // Return the construction time.
+    double get_build_time() const;
+
+    // Return the number of subtrees built as separate tasks during the last build.
+    size_t get_task_count() const;
+
+  private:
+    typedef typename TreeType::NodeType NodeType;
+    typedef AABB<T, N> BboxType;
+    typedef Split<T> SplitType;
+
+    class PartitionJob;
+
+    TreeType&   m_tree;
+    Logger&     m_logger;
+    double      m_build_time;
+    size_t      m_task_count;
+};
+
+typedef ParallelBuilder<float, 2>  ParallelBuilder2f;
+typedef ParallelBuilder<double, 2> ParallelBuilder2d;
+typedef ParallelBuilder<float, 3>  ParallelBuilder3f;
+typedef ParallelBuilder<double, 3> ParallelBuilder3d;
+
+
+//
+// Implementation.
+//
+
+template <typename T, size_t N>
+class ParallelBuilder<T, N>::PartitionJob
+  : public IJob
+{
+  public:
+    PartitionJob(
+        TreeType&                   tree,
+        std::vector<VectorType>&    sorted_points,
+        JobQueue&                   job_queue,
+        boost::atomic<size_t>&      task_count,
+        const size_t                min_task_size,
+        const size_t                node_index,
+        const size_t                first_free_node_index,
+        const size_t                begin,
+        const size_t                end)
+      : m_tree(tree)
+      , m_sorted_points(sorted_points)
+      , m_job_queue(job_queue)
+      , m_task_count(task_count)
+      , m_min_task_size(min_task_size)
+      , m_node_index(node_index)
+      , m_first_free_node_index(first_free_node_index)
+      , m_begin(begin)
+      , m_end(end)
+    {
+    }
+
+    void execute(const size_t thread_index) override
+    {
+        partition(m_node_index, m_first_free_node_index, m_begin, m_end);
+    }
+
+  private:
+    TreeType&                       m_tree;
+    std::vector<VectorType>&        m_sorted_points;
+    JobQueue&                       m_job_queue;
+    boost::atomic<size_t>&          m_task_count;
+    const size_t                    m_min_task_size;
+    const size_t                    m_node_index;
+    const size_t                    m_first_free_node_index;
+    const size_t                    m_begin;
+    const size_t                    m_end;
+
+    // Same as Builder::partition(), except that large right subtrees are handed over to
+    // other tasks, and points are copied to their final position as leaves are created.
+    void partition(
+        const size_t                parent_node_index,
+        const size_t                first_free_node_index,
+        const size_t                begin,
+        const size_t                end)
+    {
+        const size_t count = end - begin;
+
+        if (count <= 1)
+        {
+            NodeType& parent_node = m_tree.m_nodes[parent_node_index];
+            parent_node.make_leaf();
+            parent_node.set_point_index(begin);
+            parent_node.set_point_count(count);
+
+            if (count == 1)
+                m_sorted_points[begin] = m_tree.m_points[m_tree.m_indices[begin]];
+        }
+        else
+        {
+            const BboxType bbox = compute_bbox(begin, end);
+            SplitType split = SplitType::middle(bbox);
+
+            const size_t* bound =
+                std::partition(
+                    &m_tree.m_indices[0] + begin,
+                    &m_tree.m_indices[0] + end,
+                    [this, &split](const size_t index)
+                    {
+                        // Points on the split plane belong to the right child node.
+                        return m_tree.m_points[index][split.m_dimension] < split.m_abscissa;
+                    });
+
+            size_t pivot = bound - &m_tree.m_indices[0];
+            assert(pivot >= begin);
+            assert(pivot <= end);
+
+            // Split the point set in two if all the points are coincident (see Builder::partition()).
+            if (pivot == begin || pivot == end)
+                pivot = (begin + end) / 2;
+
+            // The left subtree occupies the 2 * (pivot - begin) - 2 nodes following the child nodes.
+            const size_t left_node_index = first_free_node_index;
+            const size_t right_node_index = left_node_index + 1;
+            const size_t left_first_free_node_index = right_node_index + 1;
+            const size_t right_first_free_node_index = first_free_node_index + 2 * (pivot - begin);
+
+            NodeType& parent_node = m_tree.m_nodes[parent_node_index];
+            parent_node.make_interior();
+            parent_node.set_split_dim(split.m_dimension);
+            parent_node.set_split_abs(split.m_abscissa);
+            parent_node.set_child_node_index(left_node_index);
+            parent_node.set_point_index(begin);
+            parent_node.set_point_count(count);
+
+            // Hand the right subtree over to another task if it is large enough.
+            const bool spawn_right = end - pivot >= m_min_task_size;
+            if (spawn_right)
+            {
+                ++m_task_count;
+                m_job_queue.schedule(
+                    new PartitionJob(
+                        m_tree,
+                        m_sorted_points,
+                        m_job_queue,
+                        m_task_count,
+                        m_min_task_size,
+                        right_node_index,
+                        right_first_free_node_index,
+                        pivot,
+                        end));
+            }
+
+            partition(left_node_index, left_first_free_node_index, begin, pivot);
+
+            if (!spawn_right)
+                partition(right_node_index, right_first_free_node_index, pivot, end);
+        }
+    }
+
+    BboxType compute_bbox(
+        const size_t                begin,
+        const size_t                end) const
+    {
+        BboxType bbox;
+        bbox.invalidate();
+
+        for (size_t i = begin; i < end; ++i)
+        {
+            const size_t index = m_tree.m_indices[i];
+            bbox.insert(m_tree.m_points[index]);
+        }
+
+        return bbox;
+    }
+};
+
+template <typename T, size_t N>
+inline ParallelBuilder<T, N>::ParallelBuilder(
+    TreeType&                   tree,
+    Logger&                     logger)
+  : m_tree(tree)
+  , m_logger(logger)
+  , m_build_time(0.0)
+  , m_task_count(0)
+{
+}
+
+template <typename T, size_t N>
+template <typename Timer>
+void ParallelBuilder<T, N>::build(
+    const VectorType            points[],
+    const size_t                count,
+    const size_t                thread_count,
+    const size_t                min_task_size)
+{
+    std::vector<VectorType> vec(count);
+
+    if (count > 0)
+    {
+        assert(points);
+        std::memcpy(&vec[0], points, count * sizeof(VectorType));
+    }
+
+    build_move_points<Timer>(vec, thread_count, min_task_size);
+}
+
+template <typename T, size_t N>
+template <typename Timer>
+void ParallelBuilder<T, N>::build_move_points(
+    std::vector<VectorType>&    points,
+    const size_t                thread_count,
+    const size_t                min_task_size)
+{
+    assert(min_task_size > 0);
+
+    Stopwatch<Timer> stopwatch;
+    stopwatch.start();
+
+    const size_t count = points.size();
+
+    if (count > 0)
+    {
+        m_tree.m_points.swap(points);
+
+        m_tree.m_indices.resize(count);
+
+        for (size_t i = 0; i < count; ++i)
+            m_tree.m_indices[i] = i;
+    }
+
+    m_tree.m_nodes.assign(count > 0 ? 2 * count - 1 : 1, NodeType());
+
+    // Single-threaded builds never hand subtrees over to other tasks.
+    const size_t effective_thread_count =
+        count >= 2 * min_task_size ? std::max<size_t>(thread_count, 1) : 1;
+
+    std::vector<VectorType> sorted_points(count);
+    JobQueue job_queue;
+    boost::atomic<size_t> task_count(1);
+    PartitionJob root_job(
+        m_tree,
+        sorted_points,
+        job_queue,
+        task_count,
+        effective_thread_count > 1 ? min_task_size : ~size_t(0),
+        0,              // node index
+        1,              // first free node index
+        0,              // begin
+        count);         // end
+
+    if (effective_thread_count > 1)
+    {
+        JobManager job_manager(m_logger, job_queue, effective_thread_count);
+        job_queue.schedule(&root_job, false);
+        job_manager.start();
+        job_queue.wait_until_completion();
+    }
+    else root_job.execute(0);
+
+    m_task_count = task_count;
+
+    // Points have been copied in tree order as leaves were created.
+    m_tree.m_points.swap(sorted_points);
+
+    stopwatch.measure();
+    m_build_time = stopwatch.get_seconds();
+}
+
+template <typename T, size_t N>
+inline double ParallelBuilder<T, N>::get_build_time() const
+{
+    return m_build_time;
+}
+
+template <typename T, size_t N>
+inline size_t ParallelBuilder<T, N>::get_task_count() const
+{
+    return m_task_count;
+}
+
+}   // namespace knn
+}   // namespace foundation
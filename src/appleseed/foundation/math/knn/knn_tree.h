@@ -42,6 +42,8 @@
 DECLARE_TEST_CASE(Foundation_Math_Knn_Builder, Build_GivenZeroPoint_BuildsEmptyTree);
 DECLARE_TEST_CASE(Foundation_Math_Knn_Builder, Build_GivenTwoPoints_BuildsCorrectTree);
 DECLARE_TEST_CASE(Foundation_Math_Knn_Builder, Build_GivenEightPoints_GeneratesFifteenNodes);
+DECLARE_TEST_CASE(Foundation_Math_Knn_ParallelBuilder, Build_GivenRandomPoints_BuildsSameTreeAsBuilder);
+DECLARE_TEST_CASE(Foundation_Math_Knn_ParallelBuilder, Build_GivenCoincidentPoints_BuildsSameTreeAsBuilder);
 
 namespace foundation {
 namespace knn {
@@ -71,12 +73,15 @@ class Tree
   private:
     template <typename, size_t> friend class AnyQuery;
     template <typename, size_t> friend class Builder;
+    template <typename, size_t> friend class ParallelBuilder;
     template <typename, size_t> friend class Query;
     template <typename> friend class TreeStatistics;
 
     GRANT_ACCESS_TO_TEST_CASE(Foundation_Math_Knn_Builder, Build_GivenZeroPoint_BuildsEmptyTree);
     GRANT_ACCESS_TO_TEST_CASE(Foundation_Math_Knn_Builder, Build_GivenTwoPoints_BuildsCorrectTree);
     GRANT_ACCESS_TO_TEST_CASE(Foundation_Math_Knn_Builder, Build_GivenEightPoints_GeneratesFifteenNodes);
+    GRANT_ACCESS_TO_TEST_CASE(Foundation_Math_Knn_ParallelBuilder, Build_GivenRandomPoints_BuildsSameTreeAsBuilder);
+    GRANT_ACCESS_TO_TEST_CASE(Foundation_Math_Knn_ParallelBuilder, Build_GivenCoincidentPoints_BuildsSameTreeAsBuilder);
 
     std::vector<VectorType> m_points;
     std::vector<size_t>     m_indices;
@@ -45,12 +45,18 @@ namespace foundation
 //
 // An arena is a temporary heap providing extremely cheap memory allocation.
 //
+// Allocations can be pinned so that they survive subsequent calls to clear().
+// This allows long-lived data to share the arena with short-lived data that
+// is released many times over, such as the storage of a path and the closures
+// of its vertices.
+//
 
 class Arena
 {
   public:
     Arena();
 
+    // Release all allocations made since the last call to clear() or pin().
     void clear();
 
     void* allocate(const size_t size);
@@ -58,6 +64,17 @@ class Arena
     template <typename T> T* allocate();
     template <typename T> T* allocate_noinit();
 
+    // Protect all allocations made so far from subsequent calls to clear().
+    // Return a marker that must be passed to unpin() to lift the protection.
+    std::uint8_t* pin();
+
+    // Lift the protection set by the matching call to pin().
+    // Pins must be lifted in the reverse order they were set.
+    void unpin(std::uint8_t* marker);
+
+    // Return the number of bytes allocated since the last call to clear() or pin().
+    size_t get_size() const;
+
     const std::uint8_t* get_storage() const;
 
   private:
@@ -65,6 +82,7 @@ class Arena
 
     APPLESEED_SIMD4_ALIGN std::uint8_t  m_storage[ArenaSize];
     const std::uint8_t*                 m_end;
+    std::uint8_t*                       m_base;
     std::uint8_t*                       m_current;
 };
 
@@ -75,13 +93,14 @@ class Arena
 
 inline Arena::Arena()
   : m_end(m_storage + ArenaSize)
+  , m_base(m_storage)
   , m_current(m_storage)
 {
 }
 
 inline void Arena::clear()
 {
-    m_current = m_storage;
+    m_current = m_base;
 }
 
 inline void* Arena::allocate(const size_t size)
@@ -113,6 +132,26 @@ inline T* Arena::allocate_noinit()
     return static_cast<T*>(allocate(sizeof(T)));
 }
 
+inline std::uint8_t* Arena::pin()
+{
+    std::uint8_t* marker = m_base;
+    m_base = m_current;
+    return marker;
+}
+
+inline void Arena::unpin(std::uint8_t* marker)
+{
+    assert(marker >= m_storage && marker <= m_base);
+
+    // Allocations made since the pin remain valid until the next call to clear().
+    m_base = marker;
+}
+
+inline size_t Arena::get_size() const
+{
+    return static_cast<size_t>(m_current - m_base);
+}
+
 inline const std::uint8_t* Arena::get_storage() const
 {
     return m_storage;
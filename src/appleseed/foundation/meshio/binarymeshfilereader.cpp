@@ -34,10 +34,19 @@
 #include "foundation/core/exceptions/exceptionioerror.h"
 #include "foundation/math/vector.h"
 #include "foundation/memory/memory.h"
+#include "foundation/meshio/binarymeshformat.h"
 #include "foundation/meshio/imeshbuilder.h"
+#include "foundation/platform/memorymappedfile.h"
 #include "foundation/utility/bufferedfile.h"
+#include "foundation/utility/job/ijob.h"
+#include "foundation/utility/job/jobmanager.h"
+#include "foundation/utility/job/jobqueue.h"
+
+// LZ4 headers.
+#include <lz4.h>
 
 // Standard headers.
+#include <algorithm>
 #include <cstdint>
 #include <cstring>
 #include <memory>
@@ -51,6 +60,18 @@ namespace foundation
 
 BinaryMeshFileReader::BinaryMeshFileReader(const std::string& filename)
   : m_filename(filename)
+  , m_logger(nullptr)
+  , m_thread_count(1)
+{
+}
+
+BinaryMeshFileReader::BinaryMeshFileReader(
+    const std::string&  filename,
+    Logger&             logger,
+    const size_t        thread_count)
+  : m_filename(filename)
+  , m_logger(&logger)
+  , m_thread_count(std::max<size_t>(thread_count, 1))
 {
 }
 
@@ -101,6 +122,12 @@ void BinaryMeshFileReader::read(IMeshBuilder& builder)
         }
         break;
 
+      // Memory-mapped contiguous arrays, optionally LZ4-compressed in chunks.
+      case binarymesh::Version5:
+        file.close();
+        read_mapped_meshes(builder);
+        break;
+
       // Unknown format.
       default:
         throw ExceptionIOError("unknown binarymesh format version");
@@ -264,4 +291,400 @@ void BinaryMeshFileReader::read_face(ReaderAdapter& reader, IMeshBuilder& builde
     builder.end_face();
 }
 
+namespace
+{
+    void throw_corrupted_file()
+    {
+        throw ExceptionIOError("corrupted binarymesh file");
+    }
+
+    // Sequential reader over a mesh record, with bounds checking.
+    class RecordReader
+    {
+      public:
+        RecordReader(const std::uint8_t* begin, const std::uint8_t* end)
+          : m_ptr(begin)
+          , m_end(end)
+        {
+        }
+
+        size_t remaining() const
+        {
+            return static_cast<size_t>(m_end - m_ptr);
+        }
+
+        template <typename T>
+        T read()
+        {
+            if (static_cast<size_t>(m_end - m_ptr) < sizeof(T))
+                throw_corrupted_file();
+
+            T value;
+            std::memcpy(&value, m_ptr, sizeof(T));
+            m_ptr += sizeof(T);
+
+            return value;
+        }
+
+        std::string read_string()
+        {
+            const std::uint16_t length = read<std::uint16_t>();
+
+            if (static_cast<size_t>(m_end - m_ptr) < length)
+                throw_corrupted_file();
+
+            const std::string s(reinterpret_cast<const char*>(m_ptr), length);
+            m_ptr += length;
+
+            return s;
+        }
+
+      private:
+        const std::uint8_t*         m_ptr;
+        const std::uint8_t* const   m_end;
+    };
+
+    struct MappedSection
+    {
+        std::uint32_t               m_compression;
+        std::uint64_t               m_size;
+        std::uint64_t               m_offset;
+        std::uint32_t               m_chunk_size;
+        std::vector<std::uint32_t>  m_chunk_sizes;
+        const std::uint8_t*         m_data;             // uncompressed data
+        std::vector<std::uint8_t>   m_buffer;           // storage for decompressed data
+    };
+
+    class DecompressChunkJob
+      : public IJob
+    {
+      public:
+        DecompressChunkJob(
+            const std::uint8_t*     source,
+            const size_t            source_size,
+            std::uint8_t*           dest,
+            const size_t            dest_size)
+          : m_source(source)
+          , m_source_size(source_size)
+          , m_dest(dest)
+          , m_dest_size(dest_size)
+          , m_success(false)
+        {
+        }
+
+        bool succeeded() const
+        {
+            return m_success;
+        }
+
+        void execute(const size_t thread_index) override
+        {
+            const int decompressed_size =
+                LZ4_decompress_safe(
+                    reinterpret_cast<const char*>(m_source),
+                    reinterpret_cast<char*>(m_dest),
+                    static_cast<int>(m_source_size),
+                    static_cast<int>(m_dest_size));
+
+            m_success = decompressed_size == static_cast<int>(m_dest_size);
+        }
+
+      private:
+        const std::uint8_t* const   m_source;
+        const size_t                m_source_size;
+        std::uint8_t* const         m_dest;
+        const size_t                m_dest_size;
+        bool                        m_success;
+    };
+
+    // Decompress the compressed sections of a mesh record. Chunks are decompressed
+    // with up to thread_count threads when there is more than one of them. Callers
+    // that already read several files in parallel are expected to split their own
+    // thread budget rather than pass the full thread count to every reader.
+    void decompress_sections(
+        const std::uint8_t*         record,
+        const size_t                record_size,
+        std::vector<MappedSection>& sections,
+        Logger*                     logger,
+        const size_t                thread_count)
+    {
+        std::vector<std::unique_ptr<DecompressChunkJob>> jobs;
+
+        for (MappedSection& section : sections)
+        {
+            if (section.m_compression != binarymesh::LZ4ChunkCompression)
+                continue;
+
+            const size_t size = static_cast<size_t>(section.m_size);
+            const size_t chunk_size = section.m_chunk_size;
+
+            if (chunk_size == 0 ||
+                section.m_chunk_sizes.size() != (size + chunk_size - 1) / chunk_size)
+                throw_corrupted_file();
+
+            // LZ4 cannot expand data by more than a factor of 255.
+            if (size / 255 > record_size)
+                throw_corrupted_file();
+
+            section.m_buffer.resize(size);
+            section.m_data = section.m_buffer.empty() ? nullptr : &section.m_buffer[0];
+
+            size_t source_offset = static_cast<size_t>(section.m_offset);
+            for (size_t i = 0, e = section.m_chunk_sizes.size(); i < e; ++i)
+            {
+                const size_t source_size = section.m_chunk_sizes[i];
+                if (source_offset + source_size > record_size)
+                    throw_corrupted_file();
+
+                jobs.emplace_back(
+                    new DecompressChunkJob(
+                        record + source_offset,
+                        source_size,
+                        &section.m_buffer[i * chunk_size],
+                        std::min(chunk_size, size - i * chunk_size)));
+
+                source_offset += source_size;
+            }
+        }
+
+        const size_t effective_thread_count = std::min(thread_count, jobs.size());
+
+        if (logger != nullptr && effective_thread_count > 1)
+        {
+            JobQueue job_queue;
+            JobManager job_manager(*logger, job_queue, effective_thread_count);
+
+            for (const auto& job : jobs)
+                job_queue.schedule(job.get(), false);
+
+            job_manager.start();
+            job_queue.wait_until_completion();
+        }
+        else
+        {
+            for (const auto& job : jobs)
+                job->execute(0);
+        }
+
+        for (const auto& job : jobs)
+        {
+            if (!job->succeeded())
+                throw_corrupted_file();
+        }
+    }
+
+    // Check that the attribute indices of all face vertices are in range.
+    // Vertex normal and texture coordinate indices may be ~0 when absent.
+    void check_face_indices(
+        const std::uint32_t*        face_indices,
+        const size_t                face_vertex_count,
+        const std::uint32_t         vertex_count,
+        const std::uint32_t         vertex_normal_count,
+        const std::uint32_t         tex_coords_count)
+    {
+        const std::uint32_t None = ~std::uint32_t(0);
+
+        for (size_t i = 0; i < face_vertex_count; ++i)
+        {
+            const std::uint32_t* indices = face_indices + 3 * i;
+
+            if (indices[0] >= vertex_count ||
+                (indices[1] >= vertex_normal_count && indices[1] != None) ||
+                (indices[2] >= tex_coords_count && indices[2] != None))
+                throw_corrupted_file();
+        }
+    }
+
+    template <typename T>
+    const T* get_section_array(
+        const std::vector<MappedSection>&   sections,
+        const std::vector<size_t>&          section_indices,
+        const binarymesh::SectionType       type,
+        const size_t                        count)
+    {
+        const size_t index = section_indices[type];
+
+        if (index == ~size_t(0))
+        {
+            if (count > 0)
+                throw_corrupted_file();
+            return nullptr;
+        }
+
+        const MappedSection& section = sections[index];
+
+        if (section.m_size != count * sizeof(T))
+            throw_corrupted_file();
+
+        return reinterpret_cast<const T*>(section.m_data);
+    }
+}
+
+void BinaryMeshFileReader::read_mapped_meshes(IMeshBuilder& builder)
+{
+    const MemoryMappedFile file(m_filename.c_str());
+
+    if (!file.is_open())
+        throw ExceptionIOError();
+
+    size_t offset = binarymesh::FileHeaderSize;
+
+    if (file.size() < offset)
+        throw_corrupted_file();
+
+    while (offset < file.size())
+        offset += read_mapped_mesh(file.data() + offset, file.size() - offset, builder);
+}
+
+size_t BinaryMeshFileReader::read_mapped_mesh(
+    const std::uint8_t*     record,
+    const size_t            max_record_size,
+    IMeshBuilder&           builder)
+{
+    std::uint64_t record_size;
+    if (max_record_size < sizeof(record_size))
+        throw_corrupted_file();
+    std::memcpy(&record_size, record, sizeof(record_size));
+
+    if (record_size == 0 ||
+        record_size > max_record_size ||
+        record_size % binarymesh::SectionAlignment != 0)
+        throw_corrupted_file();
+
+    RecordReader reader(record + sizeof(record_size), record + record_size);
+
+    const std::string mesh_name = reader.read_string();
+
+    const std::uint16_t material_slot_count = reader.read<std::uint16_t>();
+    std::vector<std::string> material_slots(material_slot_count);
+    for (std::uint16_t i = 0; i < material_slot_count; ++i)
+        material_slots[i] = reader.read_string();
+
+    const std::uint32_t vertex_count = reader.read<std::uint32_t>();
+    const std::uint32_t vertex_normal_count = reader.read<std::uint32_t>();
+    const std::uint32_t tex_coords_count = reader.read<std::uint32_t>();
+    const std::uint32_t face_count = reader.read<std::uint32_t>();
+
+    // Read the section table.
+    const std::uint32_t section_count = reader.read<std::uint32_t>();
+    std::vector<MappedSection> sections(section_count);
+    std::vector<size_t> section_indices(binarymesh::SectionTypeCount, ~size_t(0));
+
+    for (std::uint32_t i = 0; i < section_count; ++i)
+    {
+        const std::uint32_t type = reader.read<std::uint32_t>();
+
+        MappedSection& section = sections[i];
+        section.m_compression = reader.read<std::uint32_t>();
+        section.m_size = reader.read<std::uint64_t>();
+        section.m_offset = reader.read<std::uint64_t>();
+        section.m_chunk_size = reader.read<std::uint32_t>();
+
+        // Make sure the chunk sizes fit in the record before allocating them.
+        const std::uint32_t chunk_count = reader.read<std::uint32_t>();
+        if (chunk_count > reader.remaining() / sizeof(std::uint32_t))
+            throw_corrupted_file();
+
+        section.m_chunk_sizes.resize(chunk_count);
+        for (std::uint32_t& chunk_size : section.m_chunk_sizes)
+            chunk_size = reader.read<std::uint32_t>();
+
+        // Ignore unknown sections.
+        if (type < binarymesh::SectionTypeCount)
+            section_indices[type] = i;
+
+        if (section.m_offset > record_size || section.m_offset % binarymesh::SectionAlignment != 0)
+            throw_corrupted_file();
+
+        if (section.m_compression == binarymesh::NoCompression)
+        {
+            // Use uncompressed data in place.
+            if (section.m_size > record_size - section.m_offset)
+                throw_corrupted_file();
+
+            section.m_data = record + section.m_offset;
+        }
+        else if (section.m_compression != binarymesh::LZ4ChunkCompression)
+            throw ExceptionIOError("unknown binarymesh compression method");
+    }
+
+    decompress_sections(record, static_cast<size_t>(record_size), sections, m_logger, m_thread_count);
+
+    const Vector3f* vertices =
+        get_section_array<Vector3f>(sections, section_indices, binarymesh::VerticesSection, vertex_count);
+    const Vector3f* vertex_normals =
+        get_section_array<Vector3f>(sections, section_indices, binarymesh::VertexNormalsSection, vertex_normal_count);
+    const Vector2f* tex_coords =
+        get_section_array<Vector2f>(sections, section_indices, binarymesh::TexCoordsSection, tex_coords_count);
+    const std::uint16_t* face_materials =
+        get_section_array<std::uint16_t>(sections, section_indices, binarymesh::FaceMaterialsSection, face_count);
+
+    // Faces are triangles unless their sizes are given explicitly.
+    const bool triangles_only = section_indices[binarymesh::FaceSizesSection] == ~size_t(0);
+    const std::uint16_t* face_sizes = nullptr;
+    size_t face_vertex_count = 3 * static_cast<size_t>(face_count);
+
+    if (!triangles_only)
+    {
+        face_sizes = get_section_array<std::uint16_t>(sections, section_indices, binarymesh::FaceSizesSection, face_count);
+
+        face_vertex_count = 0;
+        for (std::uint32_t i = 0; i < face_count; ++i)
+        {
+            if (face_sizes[i] < 3)
+                throw_corrupted_file();
+
+            face_vertex_count += face_sizes[i];
+        }
+    }
+
+    const std::uint32_t* face_indices =
+        get_section_array<std::uint32_t>(sections, section_indices, binarymesh::FaceIndicesSection, 3 * face_vertex_count);
+
+    check_face_indices(face_indices, face_vertex_count, vertex_count, vertex_normal_count, tex_coords_count);
+
+    // Hand the arrays over to the mesh builder.
+    builder.begin_mesh(mesh_name.c_str());
+    builder.push_vertex_array(vertices, vertex_count);
+    builder.push_vertex_normal_array(vertex_normals, vertex_normal_count);
+    builder.push_tex_coords_array(tex_coords, tex_coords_count);
+
+    for (const std::string& material_slot : material_slots)
+        builder.push_material_slot(material_slot.c_str());
+
+    if (triangles_only)
+        builder.push_triangle_array(face_indices, face_materials, face_count);
+    else
+    {
+        const std::uint32_t* indices = face_indices;
+
+        for (std::uint32_t i = 0; i < face_count; ++i)
+        {
+            const std::uint16_t count = face_sizes[i];
+
+            ensure_minimum_size(m_vertices, count);
+            ensure_minimum_size(m_vertex_normals, count);
+            ensure_minimum_size(m_tex_coords, count);
+
+            for (std::uint16_t j = 0; j < count; ++j)
+            {
+                m_vertices[j] = *indices++;
+                m_vertex_normals[j] = *indices++;
+                m_tex_coords[j] = *indices++;
+            }
+
+            builder.begin_face(count);
+            builder.set_face_vertices(&m_vertices[0]);
+            builder.set_face_vertex_normals(&m_vertex_normals[0]);
+            builder.set_face_vertex_tex_coords(&m_tex_coords[0]);
+            builder.set_face_material(face_materials[i]);
+            builder.end_face();
+        }
+    }
+
+    builder.end_mesh();
+
+    return static_cast<size_t>(record_size);
+}
+
 }   // namespace foundation
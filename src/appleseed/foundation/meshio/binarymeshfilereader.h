@@ -35,12 +35,14 @@
 
 // Standard headers.
 #include <cstddef>
+#include <cstdint>
 #include <string>
 #include <vector>
 
 // Forward declarations.
 namespace foundation    { class BufferedFile; }
 namespace foundation    { class IMeshBuilder; }
+namespace foundation    { class Logger; }
 namespace foundation    { class ReaderAdapter; }
 
 namespace foundation
@@ -49,19 +51,31 @@ namespace foundation
 //
 // Read for a simple binary mesh file format.
 //
+// Version 5 files are memory-mapped and their attribute arrays are handed to the
+// mesh builder as a whole; see foundation/meshio/binarymeshformat.h.
+//
 
 class BinaryMeshFileReader
   : public IMeshFileReader
 {
   public:
-    // Constructor.
+    // Constructor. Files are read on the calling thread.
     explicit BinaryMeshFileReader(const std::string& filename);
 
+    // Constructor. Compressed chunks of version 5 files are decompressed using
+    // up to thread_count threads, whose messages are sent to a given logger.
+    BinaryMeshFileReader(
+        const std::string&  filename,
+        Logger&             logger,
+        const size_t        thread_count);
+
     // Read a mesh.
     void read(IMeshBuilder& builder) override;
 
   private:
     const std::string       m_filename;
+    Logger*                 m_logger;
+    const size_t            m_thread_count;
     std::vector<size_t>     m_vertices;
     std::vector<size_t>     m_vertex_normals;
     std::vector<size_t>     m_tex_coords;
@@ -77,6 +91,9 @@ class BinaryMeshFileReader
     void read_material_slots(ReaderAdapter& reader, IMeshBuilder& builder);
     void read_faces(ReaderAdapter& reader, IMeshBuilder& builder);
     void read_face(ReaderAdapter& reader, IMeshBuilder& builder);
+
+    void read_mapped_meshes(IMeshBuilder& builder);
+    size_t read_mapped_mesh(const std::uint8_t* record, const size_t max_record_size, IMeshBuilder& builder);
 };
 
 }   // namespace foundation
@@ -33,9 +33,16 @@
 // appleseed.foundation headers.
 #include "foundation/core/exceptions/exceptionioerror.h"
 #include "foundation/math/vector.h"
+#include "foundation/memory/memory.h"
+#include "foundation/meshio/binarymeshformat.h"
 #include "foundation/meshio/imeshwalker.h"
 
+// LZ4 headers.
+#include <lz4.h>
+
 // Standard headers.
+#include <algorithm>
+#include <cassert>
 #include <cstdint>
 #include <cstring>
 
@@ -48,14 +55,109 @@ namespace foundation
 
 namespace
 {
-    // Version of the BinaryMesh file format being written by this code.
-    const std::uint16_t Version = 4;
+    // Version of the BinaryMesh file format written by default by this code.
+    const std::uint16_t DefaultVersion = 4;
+
+    // A section of a version 5 mesh record, ready to be written.
+    struct Section
+    {
+        std::uint32_t               m_type;
+        std::uint32_t               m_compression;
+        std::uint64_t               m_size;             // uncompressed size in bytes
+        std::vector<std::uint8_t>   m_data;             // raw data or compressed chunks
+        std::vector<std::uint32_t>  m_chunk_sizes;      // compressed size of each chunk
+    };
+
+    template <typename T>
+    void append(std::vector<std::uint8_t>& buffer, const T& value)
+    {
+        const size_t offset = buffer.size();
+        buffer.resize(offset + sizeof(T));
+        std::memcpy(&buffer[offset], &value, sizeof(T));
+    }
+
+    void append_string(std::vector<std::uint8_t>& buffer, const char* s)
+    {
+        const std::uint16_t length = static_cast<std::uint16_t>(strlen(s));
+        append(buffer, length);
+        buffer.insert(buffer.end(), s, s + length);
+    }
+
+    template <typename T>
+    Section make_section(
+        const binarymesh::SectionType   type,
+        const std::vector<T>&           values,
+        const bool                      compression)
+    {
+        Section section;
+        section.m_type = static_cast<std::uint32_t>(type);
+        section.m_size = values.size() * sizeof(T);
+
+        const std::uint8_t* data =
+            values.empty() ? nullptr : reinterpret_cast<const std::uint8_t*>(&values[0]);
+        const size_t size = static_cast<size_t>(section.m_size);
+
+        if (compression && size > 0)
+        {
+            // Compress the data one chunk at a time.
+            for (size_t begin = 0; begin < size; begin += binarymesh::ChunkSize)
+            {
+                const size_t chunk_size = std::min(binarymesh::ChunkSize, size - begin);
+                const size_t max_compressed_size =
+                    static_cast<size_t>(LZ4_compressBound(static_cast<int>(chunk_size)));
+
+                const size_t offset = section.m_data.size();
+                section.m_data.resize(offset + max_compressed_size);
+
+                const int compressed_size =
+                    LZ4_compress_default(
+                        reinterpret_cast<const char*>(data + begin),
+                        reinterpret_cast<char*>(&section.m_data[offset]),
+                        static_cast<int>(chunk_size),
+                        static_cast<int>(max_compressed_size));
+                assert(compressed_size > 0);
+
+                section.m_data.resize(offset + compressed_size);
+                section.m_chunk_sizes.push_back(static_cast<std::uint32_t>(compressed_size));
+            }
+
+            // Keep the compressed data only if it is smaller.
+            if (section.m_data.size() < size)
+            {
+                section.m_compression = binarymesh::LZ4ChunkCompression;
+                return section;
+            }
+        }
+
+        section.m_compression = binarymesh::NoCompression;
+        section.m_data.assign(data, data + size);
+        section.m_chunk_sizes.clear();
+
+        return section;
+    }
 }
 
 BinaryMeshFileWriter::BinaryMeshFileWriter(const std::string& filename)
   : m_filename(filename)
   , m_writer(m_file, 256 * 1024)
+  , m_version(DefaultVersion)
+  , m_compression(true)
+{
+}
+
+void BinaryMeshFileWriter::set_format_version(const std::uint16_t version)
 {
+    assert(!m_file.is_open());
+
+    if (version != 4 && version != binarymesh::Version5)
+        throw ExceptionIOError("unsupported binarymesh format version");
+
+    m_version = version;
+}
+
+void BinaryMeshFileWriter::set_compression(const bool compression)
+{
+    m_compression = compression;
 }
 
 void BinaryMeshFileWriter::write(const IMeshWalker& walker)
@@ -74,7 +176,9 @@ void BinaryMeshFileWriter::write(const IMeshWalker& walker)
         write_version();
     }
 
-    write_mesh(walker);
+    if (m_version == binarymesh::Version5)
+        write_mesh_v5(walker);
+    else write_mesh(walker);
 }
 
 void BinaryMeshFileWriter::write_signature()
@@ -85,7 +189,11 @@ void BinaryMeshFileWriter::write_signature()
 
 void BinaryMeshFileWriter::write_version()
 {
-    checked_write(m_file, Version);
+    checked_write(m_file, m_version);
+
+    // Pad the file header so that mesh records start on a 16-byte boundary.
+    if (m_version == binarymesh::Version5)
+        checked_write(m_file, std::uint32_t(0));
 }
 
 void BinaryMeshFileWriter::write_string(const char* s)
@@ -166,4 +274,108 @@ void BinaryMeshFileWriter::write_face(const IMeshWalker& walker, const size_t fa
     checked_write(m_writer, static_cast<std::uint16_t>(walker.get_face_material(face_index)));
 }
 
+void BinaryMeshFileWriter::write_mesh_v5(const IMeshWalker& walker)
+{
+    // Gather the attributes of the mesh into contiguous arrays.
+    std::vector<Vector3f> vertices(walker.get_vertex_count());
+    for (size_t i = 0, e = vertices.size(); i < e; ++i)
+        vertices[i] = Vector3f(walker.get_vertex(i));
+
+    std::vector<Vector3f> vertex_normals(walker.get_vertex_normal_count());
+    for (size_t i = 0, e = vertex_normals.size(); i < e; ++i)
+        vertex_normals[i] = Vector3f(walker.get_vertex_normal(i));
+
+    std::vector<Vector2f> tex_coords(walker.get_tex_coords_count());
+    for (size_t i = 0, e = tex_coords.size(); i < e; ++i)
+        tex_coords[i] = Vector2f(walker.get_tex_coords(i));
+
+    const size_t face_count = walker.get_face_count();
+    std::vector<std::uint16_t> face_sizes(face_count);
+    std::vector<std::uint32_t> face_indices;
+    std::vector<std::uint16_t> face_materials(face_count);
+    bool triangles_only = true;
+
+    face_indices.reserve(face_count * 9);
+
+    for (size_t i = 0; i < face_count; ++i)
+    {
+        const size_t face_size = walker.get_face_vertex_count(i);
+        face_sizes[i] = static_cast<std::uint16_t>(face_size);
+        face_materials[i] = static_cast<std::uint16_t>(walker.get_face_material(i));
+        triangles_only = triangles_only && face_size == 3;
+
+        for (size_t j = 0; j < face_size; ++j)
+        {
+            face_indices.push_back(static_cast<std::uint32_t>(walker.get_face_vertex(i, j)));
+            face_indices.push_back(static_cast<std::uint32_t>(walker.get_face_vertex_normal(i, j)));
+            face_indices.push_back(static_cast<std::uint32_t>(walker.get_face_tex_coords(i, j)));
+        }
+    }
+
+    // Build the sections.
+    std::vector<Section> sections;
+    sections.push_back(make_section(binarymesh::VerticesSection, vertices, m_compression));
+    sections.push_back(make_section(binarymesh::VertexNormalsSection, vertex_normals, m_compression));
+    sections.push_back(make_section(binarymesh::TexCoordsSection, tex_coords, m_compression));
+    if (!triangles_only)
+        sections.push_back(make_section(binarymesh::FaceSizesSection, face_sizes, m_compression));
+    sections.push_back(make_section(binarymesh::FaceIndicesSection, face_indices, m_compression));
+    sections.push_back(make_section(binarymesh::FaceMaterialsSection, face_materials, m_compression));
+
+    // Write the record header. The record size is filled in at the end.
+    m_record.clear();
+    append(m_record, std::uint64_t(0));
+    append_string(m_record, walker.get_name());
+
+    const std::uint16_t material_slot_count = static_cast<std::uint16_t>(walker.get_material_slot_count());
+    append(m_record, material_slot_count);
+    for (std::uint16_t i = 0; i < material_slot_count; ++i)
+        append_string(m_record, walker.get_material_slot(i));
+
+    append(m_record, static_cast<std::uint32_t>(vertices.size()));
+    append(m_record, static_cast<std::uint32_t>(vertex_normals.size()));
+    append(m_record, static_cast<std::uint32_t>(tex_coords.size()));
+    append(m_record, static_cast<std::uint32_t>(face_count));
+    append(m_record, static_cast<std::uint32_t>(sections.size()));
+
+    // Compute the offset of the data of each section.
+    size_t header_size = m_record.size();
+    for (const Section& section : sections)
+        header_size += 32 + 4 * section.m_chunk_sizes.size();
+
+    size_t data_offset = align(header_size, binarymesh::SectionAlignment);
+
+    // Write the section table.
+    for (const Section& section : sections)
+    {
+        append(m_record, section.m_type);
+        append(m_record, section.m_compression);
+        append(m_record, section.m_size);
+        append(m_record, static_cast<std::uint64_t>(data_offset));
+        append(m_record, static_cast<std::uint32_t>(binarymesh::ChunkSize));
+        append(m_record, static_cast<std::uint32_t>(section.m_chunk_sizes.size()));
+        for (const std::uint32_t chunk_size : section.m_chunk_sizes)
+            append(m_record, chunk_size);
+
+        data_offset = align(data_offset + section.m_data.size(), binarymesh::SectionAlignment);
+    }
+
+    assert(m_record.size() == header_size);
+
+    // Write the section data.
+    for (const Section& section : sections)
+    {
+        m_record.resize(align(m_record.size(), binarymesh::SectionAlignment));
+        m_record.insert(m_record.end(), section.m_data.begin(), section.m_data.end());
+    }
+
+    m_record.resize(align(m_record.size(), binarymesh::SectionAlignment));
+    assert(m_record.size() == data_offset);
+
+    const std::uint64_t record_size = m_record.size();
+    std::memcpy(&m_record[0], &record_size, sizeof(record_size));
+
+    checked_write(m_file, &m_record[0], m_record.size());
+}
+
 }   // namespace foundation
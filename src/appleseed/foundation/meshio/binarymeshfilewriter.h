@@ -36,7 +36,9 @@
 
 // Standard headers.
 #include <cstddef>
+#include <cstdint>
 #include <string>
+#include <vector>
 
 // Forward declarations.
 namespace foundation    { class IMeshWalker; }
@@ -55,6 +57,14 @@ class BinaryMeshFileWriter
     // Constructor.
     explicit BinaryMeshFileWriter(const std::string& filename);
 
+    // Set the version of the format to write, 4 (default) or 5.
+    // Must be called before the first mesh is written.
+    void set_format_version(const std::uint16_t version);
+
+    // Enable or disable the compression of version 5 files (enabled by default).
+    // Uncompressed files are larger but can be used in place by memory mapping.
+    void set_compression(const bool compression);
+
     // Write a mesh.
     void write(const IMeshWalker& walker) override;
 
@@ -62,10 +72,15 @@ class BinaryMeshFileWriter
     const std::string           m_filename;
     BufferedFile                m_file;
     LZ4CompressedWriterAdapter  m_writer;
+    std::uint16_t               m_version;
+    bool                        m_compression;
+    std::vector<std::uint8_t>   m_record;
 
     void write_signature();
     void write_version();
 
+    void write_mesh_v5(const IMeshWalker& walker);
+
     void write_string(const char* s);
     void write_mesh(const IMeshWalker& walker);
     void write_vertices(const IMeshWalker& walker);
@@ -0,0 +1,98 @@
+
+//
+// This source file is part of appleseed.
+// Visit https://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2019 The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+// Standard headers.
+#include <cstddef>
+#include <cstdint>
+
+namespace foundation {
+namespace binarymesh {
+
+//
+// Layout of version 5 of the binarymesh file format.
+//
+// Earlier versions store one LZ4 stream in which vertices and faces are interleaved
+// with their counts, and must be decoded one element at a time. Version 5 instead
+// stores each attribute of a mesh as a contiguous array, so that readers can hand
+// whole arrays to the mesh builder:
+//
+//   File header (16 bytes):
+//     char[10]         signature "BINARYMESH"
+//     uint16           version (5)
+//     uint32           reserved (0)
+//
+//   One record per mesh, each starting on a 16-byte boundary:
+//     uint64           size of the record in bytes, multiple of 16
+//     uint16 + chars   mesh name
+//     uint16           number of material slots, followed by their names (uint16 + chars)
+//     uint32           vertex count, vertex normal count, texture coordinates count, face count
+//     uint32           number of sections, followed by the section table:
+//       uint32           section type (SectionType)
+//       uint32           compression (Compression)
+//       uint64           uncompressed size in bytes
+//       uint64           offset of the section data from the start of the record, multiple of 16
+//       uint32           uncompressed chunk size in bytes (all chunks but the last one)
+//       uint32           number of chunks, followed by the compressed size of each chunk (uint32)
+//     section data
+//
+// Uncompressed sections can be used in place from a memory mapping of the file.
+// Compressed sections are split into chunks compressed independently with LZ4,
+// and stored back to back, so that they can be decompressed in parallel.
+//
+// Faces are stored as three (vertex, vertex normal, texture coordinates) uint32
+// indices per face vertex and one uint16 material index per face. The FaceSizes
+// section, listing the vertex count of each face as a uint16, is only present if
+// the mesh contains faces that are not triangles.
+//
+
+const std::uint16_t Version5 = 5;
+const size_t FileHeaderSize = 16;
+const size_t SectionAlignment = 16;
+const size_t ChunkSize = 1024 * 1024;
+
+enum SectionType
+{
+    VerticesSection = 0,                // Vector3f per vertex
+    VertexNormalsSection,               // Vector3f per vertex normal
+    TexCoordsSection,                   // Vector2f per texture coordinates
+    FaceSizesSection,                   // uint16 per face, only for non-triangle meshes
+    FaceIndicesSection,                 // 3 x uint32 per face vertex
+    FaceMaterialsSection,               // uint16 per face
+    SectionTypeCount
+};
+
+enum Compression
+{
+    NoCompression = 0,
+    LZ4ChunkCompression
+};
+
+}   // namespace binarymesh
+}   // namespace foundation
@@ -35,8 +35,12 @@
 // appleseed.main headers.
 #include "main/dllsymbol.h"
 
+// Standard headers.
+#include <cstddef>
+
 // Forward declarations.
 namespace foundation    { class IMeshBuilder; }
+namespace foundation    { class Logger; }
 
 namespace foundation
 {
@@ -59,6 +63,11 @@ class APPLESEED_DLLSYMBOL GenericMeshFileReader
     int get_obj_options() const;
     void set_obj_options(const int obj_options);
 
+    // Allow readers that support it to use up to thread_count threads, whose
+    // messages are sent to a given logger. By default, files are read on the
+    // calling thread.
+    void set_thread_count(Logger& logger, const size_t thread_count);
+
     // Read a mesh.
     void read(IMeshBuilder& builder) override;
 
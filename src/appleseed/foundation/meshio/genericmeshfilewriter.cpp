@@ -64,6 +64,17 @@ GenericMeshFileWriter::~GenericMeshFileWriter()
     delete m_writer;
 }
 
+void GenericMeshFileWriter::set_binarymesh_format(const std::uint16_t version, const bool compression)
+{
+    BinaryMeshFileWriter* writer = dynamic_cast<BinaryMeshFileWriter*>(m_writer);
+
+    if (writer != nullptr)
+    {
+        writer->set_format_version(version);
+        writer->set_compression(compression);
+    }
+}
+
 void GenericMeshFileWriter::write(const IMeshWalker& walker)
 {
     m_writer->write(walker);
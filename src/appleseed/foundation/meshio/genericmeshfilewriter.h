@@ -36,6 +36,9 @@
 // appleseed.main headers.
 #include "main/dllsymbol.h"
 
+// Standard headers.
+#include <cstdint>
+
 // Forward declarations.
 namespace foundation    { class IMeshWalker; }
 
@@ -56,6 +59,10 @@ class APPLESEED_DLLSYMBOL GenericMeshFileWriter
     // Destructor.
     ~GenericMeshFileWriter() override;
 
+    // Set the version of the binarymesh format to write (4 or 5) and whether version 5
+    // files are compressed. Ignored for other file formats. Must be called before write().
+    void set_binarymesh_format(const std::uint16_t version, const bool compression = true);
+
     // Write a mesh.
     void write(const IMeshWalker& walker) override;
 
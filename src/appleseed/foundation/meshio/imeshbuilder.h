@@ -38,6 +38,7 @@
 
 // Standard headers.
 #include <cstddef>
+#include <cstdint>
 
 namespace foundation
 {
@@ -91,6 +92,72 @@ class APPLESEED_DLLSYMBOL IMeshBuilder
 
     // End the definition of the mesh.
     virtual void end_mesh() = 0;
+
+    //
+    // Bulk insertion methods, used by readers of formats that store contiguous arrays.
+    // The default implementations forward each element to the methods above; builders
+    // may override them to adopt whole arrays at once.
+    //
+
+    // Append 'count' vertices to the mesh.
+    virtual void push_vertex_array(const Vector3f vertices[], const size_t count);
+
+    // Append 'count' vertex normals to the mesh. The normals are NOT necessarily unit-length.
+    virtual void push_vertex_normal_array(const Vector3f vertex_normals[], const size_t count);
+
+    // Append 'count' texture coordinates to the mesh.
+    virtual void push_tex_coords_array(const Vector2f tex_coords[], const size_t count);
+
+    // Append 'count' triangles to the mesh. Each corner of a triangle is defined by three
+    // consecutive indices in 'indices': vertex, vertex normal and texture coordinates.
+    virtual void push_triangle_array(
+        const std::uint32_t     indices[],
+        const std::uint16_t     materials[],
+        const size_t            count);
 };
 
+
+//
+// IMeshBuilder class implementation.
+//
+
+inline void IMeshBuilder::push_vertex_array(const Vector3f vertices[], const size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+        push_vertex(Vector3d(vertices[i]));
+}
+
+inline void IMeshBuilder::push_vertex_normal_array(const Vector3f vertex_normals[], const size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+        push_vertex_normal(Vector3d(vertex_normals[i]));
+}
+
+inline void IMeshBuilder::push_tex_coords_array(const Vector2f tex_coords[], const size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+        push_tex_coords(Vector2d(tex_coords[i]));
+}
+
+inline void IMeshBuilder::push_triangle_array(
+    const std::uint32_t         indices[],
+    const std::uint16_t         materials[],
+    const size_t                count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        const std::uint32_t* corners = indices + i * 9;
+        const size_t vertices[3] = { corners[0], corners[3], corners[6] };
+        const size_t vertex_normals[3] = { corners[1], corners[4], corners[7] };
+        const size_t tex_coords[3] = { corners[2], corners[5], corners[8] };
+
+        begin_face(3);
+        set_face_vertices(vertices);
+        set_face_vertex_normals(vertex_normals);
+        set_face_vertex_tex_coords(tex_coords);
+        set_face_material(materials[i]);
+        end_face();
+    }
+}
+
 }   // namespace foundation
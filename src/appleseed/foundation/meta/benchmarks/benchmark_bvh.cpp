@@ -0,0 +1,345 @@
+
+//
+// This source file is part of appleseed.
+// Visit https://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2019 The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+// appleseed.foundation headers.
+#include "foundation/containers/alignedvector.h"
+#include "foundation/math/aabb.h"
+#include "foundation/math/bvh.h"
+#include "foundation/math/intersection/raytrianglemt.h"
+#include "foundation/math/ray.h"
+#include "foundation/math/rng/distribution.h"
+#include "foundation/math/rng/mersennetwister.h"
+#include "foundation/math/sampling/mappings.h"
+#include "foundation/math/vector.h"
+#include "foundation/utility/benchmark.h"
+#include "foundation/utility/stopwatch.h"
+
+// Standard headers.
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+using namespace foundation;
+
+BENCHMARK_SUITE(Foundation_Math_BVH)
+{
+    typedef TriangleMT<double> TriangleType;
+    typedef std::vector<AABB3d> AABBVector;
+    typedef bvh::Tree<AlignedVector<bvh::Node<AABB3d>>> Tree;
+
+    struct Visitor
+    {
+        const std::vector<TriangleType>&    m_triangles;
+        const std::vector<size_t>&          m_ordering;
+        double                              m_distance;
+
+        Visitor(
+            const std::vector<TriangleType>&    triangles,
+            const std::vector<size_t>&          ordering)
+          : m_triangles(triangles)
+          , m_ordering(ordering)
+          , m_distance(std::numeric_limits<double>::max())
+        {
+        }
+
+        bool visit(
+            const Tree::NodeType&       node,
+            const Ray3d&                ray,
+            const RayInfo3d&            ray_info,
+            double&                     distance
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+            , bvh::TraversalStatistics& stats
+#endif
+            )
+        {
+            Ray3d clipped_ray(ray);
+            clipped_ray.m_tmax = m_distance;
+
+            for (size_t i = 0, e = node.get_item_count(); i < e; ++i)
+            {
+                const TriangleType& triangle = m_triangles[m_ordering[node.get_item_index() + i]];
+
+                double t, u, v;
+                if (triangle.intersect(clipped_ray, t, u, v))
+                    clipped_ray.m_tmax = m_distance = t;
+            }
+
+            distance = m_distance;
+            return true;
+        }
+    };
+
+    struct PacketVisitor
+    {
+        const std::vector<TriangleType>&    m_triangles;
+        const std::vector<size_t>&          m_ordering;
+        double                              m_distances[bvh::MaxPacketSize];
+
+        PacketVisitor(
+            const std::vector<TriangleType>&    triangles,
+            const std::vector<size_t>&          ordering)
+          : m_triangles(triangles)
+          , m_ordering(ordering)
+        {
+            for (size_t i = 0; i < bvh::MaxPacketSize; ++i)
+                m_distances[i] = std::numeric_limits<double>::max();
+        }
+
+        bool visit(
+            const Tree::NodeType&       node,
+            const Ray3d                 rays[],
+            const RayInfo3d             ray_infos[],
+            bvh::PacketMask&            mask,
+            double                      distances[]
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+            , bvh::TraversalStatistics& stats
+#endif
+            )
+        {
+            for (size_t r = 0; r < bvh::MaxPacketSize && (mask >> r) != 0; ++r)
+            {
+                if ((mask & (bvh::PacketMask(1) << r)) == 0)
+                    continue;
+
+                Ray3d clipped_ray(rays[r]);
+                clipped_ray.m_tmax = m_distances[r];
+
+                for (size_t i = 0, e = node.get_item_count(); i < e; ++i)
+                {
+                    const TriangleType& triangle = m_triangles[m_ordering[node.get_item_index() + i]];
+
+                    double t, u, v;
+                    if (triangle.intersect(clipped_ray, t, u, v))
+                        clipped_ray.m_tmax = m_distances[r] = t;
+                }
+
+                distances[r] = m_distances[r];
+            }
+
+            return true;
+        }
+    };
+
+    struct FixtureBase
+    {
+        static const size_t TriangleCount = 100000;
+        static const size_t RayCount = 1000;
+        static const size_t CoherentRayCount = 16 * bvh::MaxPacketSize;
+
+        std::vector<TriangleType>   m_triangles;
+        std::vector<size_t>         m_ordering;
+        Tree                        m_tree;
+        std::vector<Ray3d>          m_rays;
+        std::vector<RayInfo3d>      m_ray_infos;
+        std::vector<Ray3d>          m_coherent_rays;
+        std::vector<RayInfo3d>      m_coherent_ray_infos;
+        double                      m_distance;
+
+        FixtureBase()
+          : m_distance(0.0)
+        {
+            MersenneTwister rng;
+
+            // Small triangles scattered over the surface of a unit sphere.
+            AABBVector bboxes;
+            for (size_t i = 0; i < TriangleCount; ++i)
+            {
+                const Vector3d center = sample_sphere_uniform(Vector2d(rand_double2(rng), rand_double2(rng)));
+                const Vector3d v0 = center + 0.01 * sample_sphere_uniform(Vector2d(rand_double2(rng), rand_double2(rng)));
+                const Vector3d v1 = center + 0.01 * sample_sphere_uniform(Vector2d(rand_double2(rng), rand_double2(rng)));
+                const Vector3d v2 = center + 0.01 * sample_sphere_uniform(Vector2d(rand_double2(rng), rand_double2(rng)));
+
+                m_triangles.emplace_back(v0, v1, v2);
+
+                AABB3d bbox;
+                bbox.invalidate();
+                bbox.insert(v0);
+                bbox.insert(v1);
+                bbox.insert(v2);
+                bboxes.push_back(bbox);
+            }
+
+            typedef bvh::SAHPartitioner<AABBVector> Partitioner;
+            Partitioner partitioner(bboxes, 2);
+            bvh::Builder<Tree, Partitioner> builder;
+            builder.build<DefaultWallclockTimer>(m_tree, partitioner, bboxes.size(), 2);
+            m_ordering = partitioner.get_item_ordering();
+
+            // Rays shot from outside the sphere toward random points inside it.
+            for (size_t i = 0; i < RayCount; ++i)
+            {
+                const Vector3d org = 3.0 * sample_sphere_uniform(Vector2d(rand_double2(rng), rand_double2(rng)));
+                const Vector3d target = 0.5 * sample_sphere_uniform(Vector2d(rand_double2(rng), rand_double2(rng)));
+
+                m_rays.emplace_back(org, normalize(target - org));
+                m_ray_infos.emplace_back(m_rays.back());
+            }
+
+            // Packets of rays shot from a common origin toward a small region of the sphere.
+            for (size_t p = 0; p < CoherentRayCount / bvh::MaxPacketSize; ++p)
+            {
+                const Vector3d org = 3.0 * sample_sphere_uniform(Vector2d(rand_double2(rng), rand_double2(rng)));
+                const Vector3d center = -0.5 * org;
+
+                for (size_t i = 0; i < bvh::MaxPacketSize; ++i)
+                {
+                    const Vector3d target = center + 0.02 * sample_sphere_uniform(Vector2d(rand_double2(rng), rand_double2(rng)));
+
+                    m_coherent_rays.emplace_back(org, normalize(target - org));
+                    m_coherent_ray_infos.emplace_back(m_coherent_rays.back());
+                }
+            }
+        }
+    };
+
+    struct BinaryFixture
+      : public FixtureBase
+    {
+        bvh::Intersector<Tree, Visitor, Ray3d> m_intersector;
+
+        void trace_rays()
+        {
+            for (size_t i = 0; i < RayCount; ++i)
+            {
+                Visitor visitor(m_triangles, m_ordering);
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+                bvh::TraversalStatistics stats;
+#endif
+                m_intersector.intersect_no_motion(
+                    m_tree,
+                    m_rays[i],
+                    m_ray_infos[i],
+                    visitor
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+                    , stats
+#endif
+                    );
+                m_distance += visitor.m_distance;
+            }
+        }
+    };
+
+    template <size_t Width>
+    struct WideFixture
+      : public FixtureBase
+    {
+        bvh::WideTree<Tree, Width> m_wide_tree;
+        bvh::WideIntersector<Tree, Visitor, Ray3d, Width> m_intersector;
+
+        WideFixture()
+        {
+            m_wide_tree.build(m_tree);
+        }
+
+        void trace_rays()
+        {
+            for (size_t i = 0; i < RayCount; ++i)
+            {
+                Visitor visitor(m_triangles, m_ordering);
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+                bvh::TraversalStatistics stats;
+#endif
+                m_intersector.intersect_no_motion(
+                    m_tree,
+                    m_wide_tree,
+                    m_rays[i],
+                    m_ray_infos[i],
+                    visitor
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+                    , stats
+#endif
+                    );
+                m_distance += visitor.m_distance;
+            }
+        }
+    };
+
+    struct BinaryCoherentFixture
+      : public FixtureBase
+    {
+        bvh::Intersector<Tree, Visitor, Ray3d> m_intersector;
+
+        void trace_rays()
+        {
+            for (size_t i = 0; i < CoherentRayCount; ++i)
+            {
+                Visitor visitor(m_triangles, m_ordering);
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+                bvh::TraversalStatistics stats;
+#endif
+                m_intersector.intersect_no_motion(
+                    m_tree,
+                    m_coherent_rays[i],
+                    m_coherent_ray_infos[i],
+                    visitor
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+                    , stats
+#endif
+                    );
+                m_distance += visitor.m_distance;
+            }
+        }
+    };
+
+    struct PacketCoherentFixture
+      : public FixtureBase
+    {
+        bvh::PacketIntersector<Tree, PacketVisitor, Ray3d> m_intersector;
+
+        void trace_rays()
+        {
+            for (size_t i = 0; i < CoherentRayCount; i += bvh::MaxPacketSize)
+            {
+                PacketVisitor visitor(m_triangles, m_ordering);
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+                bvh::TraversalStatistics stats;
+#endif
+                m_intersector.intersect_no_motion(
+                    m_tree,
+                    &m_coherent_rays[i],
+                    &m_coherent_ray_infos[i],
+                    bvh::MaxPacketSize,
+                    bvh::make_packet_mask(bvh::MaxPacketSize),
+                    visitor
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+                    , stats
+#endif
+                    );
+
+                for (size_t j = 0; j < bvh::MaxPacketSize; ++j)
+                    m_distance += visitor.m_distances[j];
+            }
+        }
+    };
+
+    BENCHMARK_CASE_F(TraceRays_BinaryBVH, BinaryFixture)    { trace_rays(); }
+    BENCHMARK_CASE_F(TraceRays_4WideBVH, WideFixture<4>)    { trace_rays(); }
+    BENCHMARK_CASE_F(TraceRays_8WideBVH, WideFixture<8>)    { trace_rays(); }
+    BENCHMARK_CASE_F(TraceCoherentRays_BinaryBVH, BinaryCoherentFixture)    { trace_rays(); }
+    BENCHMARK_CASE_F(TraceCoherentRays_PacketBVH, PacketCoherentFixture)    { trace_rays(); }
+}
@@ -72,6 +72,12 @@ BENCHMARK_SUITE(Foundation_Utility_Job)
         }
     };
 
+    //
+    // Scheduling overhead as a function of the number of worker threads.
+    // Jobs are empty, so these benchmarks measure the cost of scheduling,
+    // acquiring (or stealing) and retiring jobs.
+    //
+
     BENCHMARK_CASE_F(SingleThreadedJobExecution, Fixture<1>)
     {
         payload();
@@ -81,4 +87,29 @@ BENCHMARK_SUITE(Foundation_Utility_Job)
     {
         payload();
     }
+
+    BENCHMARK_CASE_F(JobExecutionWith4Threads, Fixture<4>)
+    {
+        payload();
+    }
+
+    BENCHMARK_CASE_F(JobExecutionWith8Threads, Fixture<8>)
+    {
+        payload();
+    }
+
+    BENCHMARK_CASE_F(JobExecutionWith16Threads, Fixture<16>)
+    {
+        payload();
+    }
+
+    BENCHMARK_CASE_F(JobExecutionWith32Threads, Fixture<32>)
+    {
+        payload();
+    }
+
+    BENCHMARK_CASE_F(JobExecutionWith64Threads, Fixture<64>)
+    {
+        payload();
+    }
 }
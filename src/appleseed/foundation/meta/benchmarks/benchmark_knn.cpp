@@ -29,6 +29,7 @@
 
 // appleseed.foundation headers.
 #include "foundation/log/log.h"
+#include "foundation/log/logger.h"
 #include "foundation/math/aabb.h"
 #include "foundation/math/knn.h"
 #include "foundation/math/rng/distribution.h"
@@ -36,6 +37,7 @@
 #include "foundation/math/rng/xorshift32.h"
 #include "foundation/math/vector.h"
 #include "foundation/memory/autoreleaseptr.h"
+#include "foundation/platform/system.h"
 #include "foundation/platform/timers.h"
 #include "foundation/string/string.h"
 #include "foundation/utility/benchmark.h"
@@ -406,3 +408,37 @@ BENCHMARK_SUITE(Foundation_Math_Knn_AnyQuery)
     BENCHMARK_CASE_F(Particles_RandomQueryPoints, ParticlesFixture) { run_queries(); }
     BENCHMARK_CASE_F(PhotonMap_RandomQueryPoints, PhotonMapFixture) { run_queries(); }
 }
+
+BENCHMARK_SUITE(Foundation_Math_Knn_Builder)
+{
+    struct Fixture
+    {
+        std::vector<Vector3f>   m_points;
+        knn::Tree3f             m_tree;
+
+        Fixture()
+          : m_points(100000)
+        {
+            MersenneTwister rng;
+
+            for (Vector3f& point : m_points)
+                point = rand_vector1<Vector3f>(rng);
+        }
+    };
+
+    BENCHMARK_CASE_F(Build_100KPoints, Fixture)
+    {
+        knn::Builder3f builder(m_tree);
+        builder.build<DefaultWallclockTimer>(&m_points[0], m_points.size());
+    }
+
+    BENCHMARK_CASE_F(ParallelBuild_100KPoints, Fixture)
+    {
+        Logger logger;
+        knn::ParallelBuilder3f builder(m_tree, logger);
+        builder.build<DefaultWallclockTimer>(
+            &m_points[0],
+            m_points.size(),
+            System::get_logical_cpu_core_count());
+    }
+}
@@ -0,0 +1,89 @@
+
+//
+// This source file is part of appleseed.
+// Visit https://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2019 The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+// appleseed.foundation headers.
+#include "foundation/memory/arena.h"
+#include "foundation/utility/test.h"
+
+// Standard headers.
+#include <cstdint>
+
+using namespace foundation;
+
+TEST_SUITE(Foundation_Memory_Arena)
+{
+    TEST_CASE(Clear_ReleasesAllAllocations)
+    {
+        Arena arena;
+        void* ptr = arena.allocate(100);
+
+        arena.clear();
+
+        EXPECT_EQ(0, arena.get_size());
+        EXPECT_EQ(ptr, arena.allocate(100));
+    }
+
+    TEST_CASE(Clear_PreservesPinnedAllocations)
+    {
+        Arena arena;
+        void* pinned = arena.allocate(100);
+        arena.pin();
+        void* transient = arena.allocate(100);
+
+        arena.clear();
+
+        EXPECT_EQ(0, arena.get_size());
+        EXPECT_EQ(transient, arena.allocate(100));
+        EXPECT_NEQ(pinned, transient);
+    }
+
+    TEST_CASE(GetSize_ReturnsBytesAllocatedSinceLastPin)
+    {
+        Arena arena;
+        arena.allocate(100);
+        arena.pin();
+        arena.allocate(100);
+
+        EXPECT_EQ(112, arena.get_size());
+    }
+
+    TEST_CASE(Unpin_AllowsClearToReleasePinnedAllocations)
+    {
+        Arena arena;
+        std::uint8_t* marker = arena.pin();
+        void* ptr = arena.allocate(100);
+        std::uint8_t* inner_marker = arena.pin();
+        arena.allocate(100);
+
+        arena.unpin(inner_marker);
+        arena.unpin(marker);
+        arena.clear();
+
+        EXPECT_EQ(ptr, arena.allocate(100));
+    }
+}
@@ -0,0 +1,392 @@
+
+//
+// This source file is part of appleseed.
+// Visit https://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2019 The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+// appleseed.foundation headers.
+#include "foundation/core/exceptions/exceptionioerror.h"
+#include "foundation/log/logger.h"
+#include "foundation/math/vector.h"
+#include "foundation/meshio/binarymeshfilereader.h"
+#include "foundation/meshio/binarymeshfilewriter.h"
+#include "foundation/meshio/imeshwalker.h"
+#include "foundation/meshio/meshbuilderbase.h"
+#include "foundation/utility/test.h"
+
+// Standard headers.
+#include <cstddef>
+#include <string>
+#include <vector>
+
+using namespace foundation;
+
+TEST_SUITE(Foundation_Mesh_BinaryMeshFile)
+{
+    struct Mesh
+    {
+        std::string                 m_name;
+        std::vector<Vector3d>       m_vertices;
+        std::vector<Vector3d>       m_vertex_normals;
+        std::vector<Vector2d>       m_tex_coords;
+        std::vector<std::string>    m_material_slots;
+        std::vector<size_t>         m_face_sizes;
+        std::vector<size_t>         m_face_vertices;        // (vertex, vertex normal, tex coords) triples
+        std::vector<size_t>         m_face_materials;
+        std::vector<size_t>         m_face_offsets;         // first triple of each face
+    };
+
+    struct MeshBuilder
+      : public MeshBuilderBase
+    {
+        std::vector<Mesh> m_meshes;
+
+        void begin_mesh(const char* name) override
+        {
+            m_meshes.emplace_back();
+            m_meshes.back().m_name = name;
+        }
+
+        size_t push_vertex(const Vector3d& v) override
+        {
+            m_meshes.back().m_vertices.push_back(v);
+            return m_meshes.back().m_vertices.size() - 1;
+        }
+
+        size_t push_vertex_normal(const Vector3d& v) override
+        {
+            m_meshes.back().m_vertex_normals.push_back(v);
+            return m_meshes.back().m_vertex_normals.size() - 1;
+        }
+
+        size_t push_tex_coords(const Vector2d& v) override
+        {
+            m_meshes.back().m_tex_coords.push_back(v);
+            return m_meshes.back().m_tex_coords.size() - 1;
+        }
+
+        size_t push_material_slot(const char* name) override
+        {
+            m_meshes.back().m_material_slots.push_back(name);
+            return m_meshes.back().m_material_slots.size() - 1;
+        }
+
+        void begin_face(const size_t vertex_count) override
+        {
+            Mesh& mesh = m_meshes.back();
+            mesh.m_face_offsets.push_back(mesh.m_face_vertices.size() / 3);
+            mesh.m_face_sizes.push_back(vertex_count);
+            mesh.m_face_vertices.resize(mesh.m_face_vertices.size() + 3 * vertex_count);
+        }
+
+        void set_face_vertices(const size_t vertices[]) override
+        {
+            set_face_indices(vertices, 0);
+        }
+
+        void set_face_vertex_normals(const size_t vertex_normals[]) override
+        {
+            set_face_indices(vertex_normals, 1);
+        }
+
+        void set_face_vertex_tex_coords(const size_t tex_coords[]) override
+        {
+            set_face_indices(tex_coords, 2);
+        }
+
+        void set_face_material(const size_t material) override
+        {
+            m_meshes.back().m_face_materials.push_back(material);
+        }
+
+        void set_face_indices(const size_t indices[], const size_t component)
+        {
+            Mesh& mesh = m_meshes.back();
+            const size_t offset = mesh.m_face_offsets.back();
+
+            for (size_t i = 0; i < mesh.m_face_sizes.back(); ++i)
+                mesh.m_face_vertices[3 * (offset + i) + component] = indices[i];
+        }
+    };
+
+    struct MeshWalker
+      : public IMeshWalker
+    {
+        const Mesh& m_mesh;
+
+        explicit MeshWalker(const Mesh& mesh)
+          : m_mesh(mesh)
+        {
+        }
+
+        const char* get_name() const override
+        {
+            return m_mesh.m_name.c_str();
+        }
+
+        size_t get_vertex_count() const override
+        {
+            return m_mesh.m_vertices.size();
+        }
+
+        Vector3d get_vertex(const size_t i) const override
+        {
+            return m_mesh.m_vertices[i];
+        }
+
+        size_t get_vertex_normal_count() const override
+        {
+            return m_mesh.m_vertex_normals.size();
+        }
+
+        Vector3d get_vertex_normal(const size_t i) const override
+        {
+            return m_mesh.m_vertex_normals[i];
+        }
+
+        size_t get_tex_coords_count() const override
+        {
+            return m_mesh.m_tex_coords.size();
+        }
+
+        Vector2d get_tex_coords(const size_t i) const override
+        {
+            return m_mesh.m_tex_coords[i];
+        }
+
+        size_t get_material_slot_count() const override
+        {
+            return m_mesh.m_material_slots.size();
+        }
+
+        const char* get_material_slot(const size_t i) const override
+        {
+            return m_mesh.m_material_slots[i].c_str();
+        }
+
+        size_t get_face_count() const override
+        {
+            return m_mesh.m_face_sizes.size();
+        }
+
+        size_t get_face_vertex_count(const size_t face_index) const override
+        {
+            return m_mesh.m_face_sizes[face_index];
+        }
+
+        size_t get_face_vertex(const size_t face_index, const size_t vertex_index) const override
+        {
+            return get_face_index(face_index, vertex_index, 0);
+        }
+
+        size_t get_face_vertex_normal(const size_t face_index, const size_t vertex_index) const override
+        {
+            return get_face_index(face_index, vertex_index, 1);
+        }
+
+        size_t get_face_tex_coords(const size_t face_index, const size_t vertex_index) const override
+        {
+            return get_face_index(face_index, vertex_index, 2);
+        }
+
+        size_t get_face_material(const size_t face_index) const override
+        {
+            return m_mesh.m_face_materials[face_index];
+        }
+
+        size_t get_face_index(const size_t face_index, const size_t vertex_index, const size_t component) const
+        {
+            return m_mesh.m_face_vertices[3 * (m_mesh.m_face_offsets[face_index] + vertex_index) + component];
+        }
+    };
+
+    void push_face(
+        Mesh&                       mesh,
+        const size_t                vertex_count,
+        const size_t                first_vertex,
+        const size_t                material)
+    {
+        mesh.m_face_offsets.push_back(mesh.m_face_vertices.size() / 3);
+        mesh.m_face_sizes.push_back(vertex_count);
+        mesh.m_face_materials.push_back(material);
+
+        for (size_t i = 0; i < vertex_count; ++i)
+        {
+            mesh.m_face_vertices.push_back(first_vertex + i);
+            mesh.m_face_vertices.push_back(first_vertex + i);
+            mesh.m_face_vertices.push_back(first_vertex + i);
+        }
+    }
+
+    Mesh create_mesh(const std::string& name, const size_t face_vertex_count, const size_t face_count)
+    {
+        Mesh mesh;
+        mesh.m_name = name;
+        mesh.m_material_slots.push_back("front");
+        mesh.m_material_slots.push_back("back");
+
+        for (size_t i = 0; i < face_count; ++i)
+        {
+            const size_t vertex_count = i % 2 == 0 ? 3 : face_vertex_count;
+            const size_t first_vertex = mesh.m_vertices.size();
+
+            for (size_t j = 0; j < vertex_count; ++j)
+            {
+                const double x = static_cast<double>(i);
+                const double y = static_cast<double>(j);
+                mesh.m_vertices.emplace_back(x, y, 0.5);
+                mesh.m_vertex_normals.emplace_back(0.0, 0.0, 1.0);
+                mesh.m_tex_coords.emplace_back(x * 0.25, y * 0.5);
+            }
+
+            push_face(mesh, vertex_count, first_vertex, i % 2);
+        }
+
+        return mesh;
+    }
+
+    void write_meshes(
+        const char*                 filename,
+        const std::uint16_t         version,
+        const bool                  compression,
+        const std::vector<Mesh>&    meshes)
+    {
+        BinaryMeshFileWriter writer(filename);
+        writer.set_format_version(version);
+        writer.set_compression(compression);
+
+        for (const Mesh& mesh : meshes)
+            writer.write(MeshWalker(mesh));
+    }
+
+    std::vector<Mesh> read_meshes(const char* filename)
+    {
+        BinaryMeshFileReader reader(filename);
+        MeshBuilder builder;
+        reader.read(builder);
+        return builder.m_meshes;
+    }
+
+    std::vector<Mesh> read_meshes(const char* filename, const size_t thread_count)
+    {
+        Logger logger;
+        BinaryMeshFileReader reader(filename, logger, thread_count);
+        MeshBuilder builder;
+        reader.read(builder);
+        return builder.m_meshes;
+    }
+
+    bool are_equal(const Mesh& lhs, const Mesh& rhs)
+    {
+        return
+            lhs.m_name == rhs.m_name &&
+            lhs.m_vertices == rhs.m_vertices &&
+            lhs.m_vertex_normals == rhs.m_vertex_normals &&
+            lhs.m_tex_coords == rhs.m_tex_coords &&
+            lhs.m_material_slots == rhs.m_material_slots &&
+            lhs.m_face_sizes == rhs.m_face_sizes &&
+            lhs.m_face_vertices == rhs.m_face_vertices &&
+            lhs.m_face_materials == rhs.m_face_materials;
+    }
+
+    TEST_CASE(Version5_Compressed_TriangleMeshes_RoundTrip)
+    {
+        std::vector<Mesh> meshes;
+        meshes.push_back(create_mesh("first", 3, 10));
+        meshes.push_back(create_mesh("second", 3, 25));
+
+        write_meshes("unit tests/outputs/test_binarymeshfile_v5_compressed.binarymesh", 5, true, meshes);
+        const std::vector<Mesh> result = read_meshes("unit tests/outputs/test_binarymeshfile_v5_compressed.binarymesh");
+
+        ASSERT_EQ(2, result.size());
+        EXPECT_TRUE(are_equal(meshes[0], result[0]));
+        EXPECT_TRUE(are_equal(meshes[1], result[1]));
+    }
+
+    TEST_CASE(Version5_Compressed_MultiChunkMesh_ParallelRead_RoundTrip)
+    {
+        // Large enough for the vertex and face sections to span several chunks.
+        std::vector<Mesh> meshes;
+        meshes.push_back(create_mesh("large", 3, 100000));
+
+        write_meshes("unit tests/outputs/test_binarymeshfile_v5_multichunk.binarymesh", 5, true, meshes);
+        const std::vector<Mesh> result = read_meshes("unit tests/outputs/test_binarymeshfile_v5_multichunk.binarymesh", 4);
+
+        ASSERT_EQ(1, result.size());
+        EXPECT_TRUE(are_equal(meshes[0], result[0]));
+    }
+
+    TEST_CASE(Version5_FaceVertexIndexOutOfRange_ThrowsIOError)
+    {
+        std::vector<Mesh> meshes;
+        meshes.push_back(create_mesh("invalid", 3, 10));
+        meshes[0].m_face_vertices[3] = meshes[0].m_vertices.size();
+
+        write_meshes("unit tests/outputs/test_binarymeshfile_v5_invalid_index.binarymesh", 5, false, meshes);
+
+        EXPECT_EXCEPTION(ExceptionIOError,
+        {
+            read_meshes("unit tests/outputs/test_binarymeshfile_v5_invalid_index.binarymesh");
+        });
+    }
+
+    TEST_CASE(Version5_Uncompressed_TriangleMeshes_RoundTrip)
+    {
+        std::vector<Mesh> meshes;
+        meshes.push_back(create_mesh("first", 3, 10));
+        meshes.push_back(create_mesh("second", 3, 25));
+
+        write_meshes("unit tests/outputs/test_binarymeshfile_v5_uncompressed.binarymesh", 5, false, meshes);
+        const std::vector<Mesh> result = read_meshes("unit tests/outputs/test_binarymeshfile_v5_uncompressed.binarymesh");
+
+        ASSERT_EQ(2, result.size());
+        EXPECT_TRUE(are_equal(meshes[0], result[0]));
+        EXPECT_TRUE(are_equal(meshes[1], result[1]));
+    }
+
+    TEST_CASE(Version5_PolygonMesh_RoundTrip)
+    {
+        std::vector<Mesh> meshes;
+        meshes.push_back(create_mesh("polygons", 5, 20));
+
+        write_meshes("unit tests/outputs/test_binarymeshfile_v5_polygons.binarymesh", 5, true, meshes);
+        const std::vector<Mesh> result = read_meshes("unit tests/outputs/test_binarymeshfile_v5_polygons.binarymesh");
+
+        ASSERT_EQ(1, result.size());
+        EXPECT_TRUE(are_equal(meshes[0], result[0]));
+    }
+
+    TEST_CASE(Version4_PolygonMesh_RoundTrip)
+    {
+        std::vector<Mesh> meshes;
+        meshes.push_back(create_mesh("polygons", 5, 20));
+
+        write_meshes("unit tests/outputs/test_binarymeshfile_v4.binarymesh", 4, true, meshes);
+        const std::vector<Mesh> result = read_meshes("unit tests/outputs/test_binarymeshfile_v4.binarymesh");
+
+        ASSERT_EQ(1, result.size());
+        EXPECT_TRUE(are_equal(meshes[0], result[0]));
+    }
+}
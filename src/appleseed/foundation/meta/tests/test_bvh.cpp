@@ -29,15 +29,21 @@
 
 // appleseed.foundation headers.
 #include "foundation/containers/alignedvector.h"
+#include "foundation/log/logger.h"
 #include "foundation/math/aabb.h"
 #include "foundation/math/bvh.h"
+#include "foundation/math/intersection/rayaabb.h"
 #include "foundation/math/ray.h"
+#include "foundation/math/rng/distribution.h"
+#include "foundation/math/rng/mersennetwister.h"
 #include "foundation/math/vector.h"
 #include "foundation/utility/iostreamop.h"
+#include "foundation/utility/stopwatch.h"
 #include "foundation/utility/test.h"
 
 // Standard headers.
 #include <cstddef>
+#include <limits>
 #include <vector>
 
 using namespace foundation;
@@ -75,6 +81,160 @@ TEST_SUITE(Foundation_Math_BVH_Node)
     }
 }
 
+TEST_SUITE(Foundation_Math_BVH_CompactNode)
+{
+    typedef bvh::CompactNode<AABB3d> NodeType;
+
+    TEST_CASE(CompactNodeIsHalfTheSizeOfFullPrecisionNode)
+    {
+        EXPECT_EQ(64, sizeof(NodeType));
+        EXPECT_EQ(2 * sizeof(NodeType), sizeof(bvh::Node<AABB3d>));
+    }
+
+    TEST_CASE(TestStorageAndRetrievalOfExactlyRepresentableBoundingBoxes)
+    {
+        static const AABB3d LeftBBox(Vector3d(1.0, 2.0, 3.0), Vector3d(4.0, 5.0, 6.0));
+        static const AABB3d RightBBox(Vector3d(7.0, 8.0, 9.0), Vector3d(10.0, 11.0, 12.0));
+
+        NodeType node;
+        node.make_interior();
+
+        node.set_left_bbox(LeftBBox);
+        node.set_right_bbox(RightBBox);
+
+        EXPECT_EQ(LeftBBox, node.get_left_bbox());
+        EXPECT_EQ(RightBBox, node.get_right_bbox());
+    }
+
+    TEST_CASE(RetrievedBoundingBoxesEncloseStoredBoundingBoxes)
+    {
+        static const AABB3d LeftBBox(Vector3d(0.1, -0.2, 1.0e-9), Vector3d(0.3, 1.0 / 3.0, 1234.5678901));
+        static const AABB3d RightBBox(Vector3d(-1.0e6 / 7.0, 0.7, -0.3), Vector3d(-0.1, 2.0 / 3.0, 1.0e-7));
+
+        NodeType node;
+        node.make_interior();
+
+        node.set_left_bbox(LeftBBox);
+        node.set_right_bbox(RightBBox);
+
+        const AABB3d left_bbox = node.get_left_bbox();
+        const AABB3d right_bbox = node.get_right_bbox();
+
+        for (size_t i = 0; i < 3; ++i)
+        {
+            EXPECT_TRUE(left_bbox.min[i] <= LeftBBox.min[i]);
+            EXPECT_TRUE(left_bbox.max[i] >= LeftBBox.max[i]);
+            EXPECT_TRUE(right_bbox.min[i] <= RightBBox.min[i]);
+            EXPECT_TRUE(right_bbox.max[i] >= RightBBox.max[i]);
+        }
+    }
+
+    TEST_CASE(TestStorageAndRetrievalOfMotionBoundingBoxIndicesAndCounts)
+    {
+        NodeType node;
+        node.make_interior();
+
+        node.set_child_node_index(42);
+        node.set_left_bbox_index(1000);
+        node.set_left_bbox_count(3);
+        node.set_right_bbox_index(2000);
+        node.set_right_bbox_count(5);
+
+        EXPECT_TRUE(node.is_interior());
+        EXPECT_EQ(42, node.get_child_node_index());
+        EXPECT_EQ(1000, node.get_left_bbox_index());
+        EXPECT_EQ(3, node.get_left_bbox_count());
+        EXPECT_EQ(2000, node.get_right_bbox_index());
+        EXPECT_EQ(5, node.get_right_bbox_count());
+    }
+
+    TEST_CASE(TestStorageAndRetrievalOfLeafData)
+    {
+        NodeType node;
+        node.make_interior();
+        node.make_leaf();
+
+        node.set_item_index(12);
+        node.set_item_count(34);
+        node.set_user_data<double>(56.0);
+
+        EXPECT_TRUE(node.is_leaf());
+        EXPECT_EQ(12, node.get_item_index());
+        EXPECT_EQ(34, node.get_item_count());
+        EXPECT_EQ(56.0, node.get_user_data<double>());
+    }
+
+    struct Tree
+      : public bvh::Tree<AlignedVector<NodeType>>
+    {
+        // Build a root node with two leaves: [0, 1]^3 on the left, [2, 3]^3 on the right.
+        Tree()
+        {
+            m_nodes.resize(3);
+
+            m_nodes[0].make_interior();
+            m_nodes[0].set_child_node_index(1);
+            m_nodes[0].set_left_bbox_count(1);
+            m_nodes[0].set_right_bbox_count(1);
+            m_nodes[0].set_left_bbox(AABB3d(Vector3d(0.0), Vector3d(1.0)));
+            m_nodes[0].set_right_bbox(AABB3d(Vector3d(2.0), Vector3d(3.0)));
+
+            for (size_t i = 1; i < 3; ++i)
+            {
+                m_nodes[i].make_leaf();
+                m_nodes[i].set_item_index(i - 1);
+                m_nodes[i].set_item_count(1);
+            }
+        }
+    };
+
+    struct Visitor
+    {
+        std::vector<size_t> m_visited_items;
+
+        bool visit(
+            const NodeType&             node,
+            const Ray3d&                ray,
+            const RayInfo3d&            ray_info,
+            double&                     distance
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+            , bvh::TraversalStatistics& stats
+#endif
+            )
+        {
+            m_visited_items.push_back(node.get_item_index());
+            distance = ray.m_tmax;
+            return true;
+        }
+    };
+
+    TEST_CASE(IntersectorVisitsOnlyLeavesHitByRay)
+    {
+        const Tree tree;
+
+        const Ray3d ray(Vector3d(0.5, 0.5, -1.0), Vector3d(0.0, 0.0, 1.0));
+        const RayInfo3d ray_info(ray);
+
+        Visitor visitor;
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+        bvh::TraversalStatistics stats;
+#endif
+        bvh::Intersector<Tree, Visitor, Ray3d> intersector;
+        intersector.intersect_no_motion(
+            tree,
+            ray,
+            ray_info,
+            visitor
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+            , stats
+#endif
+            );
+
+        ASSERT_EQ(1, visitor.m_visited_items.size());
+        EXPECT_EQ(0, visitor.m_visited_items[0]);
+    }
+}
+
 TEST_SUITE(Foundation_Math_BVH_SpatialBuilder)
 {
     struct ItemHandler
@@ -120,6 +280,311 @@ TEST_SUITE(Foundation_Math_BVH_SpatialBuilder)
     }
 }
 
+TEST_SUITE(Foundation_Math_BVH_ParallelBuilder)
+{
+    typedef std::vector<AABB3d> AABBVector;
+    typedef bvh::Node<AABB3d> NodeType;
+
+    struct Tree
+      : public bvh::Tree<AlignedVector<NodeType>>
+    {
+        using bvh::Tree<AlignedVector<NodeType>>::m_nodes;
+    };
+
+    struct ItemHandler
+    {
+        const AABBVector& m_bboxes;
+
+        explicit ItemHandler(const AABBVector& bboxes)
+          : m_bboxes(bboxes)
+        {
+        }
+
+        double get_bbox_grow_eps() const
+        {
+            return 1.0e-9;
+        }
+
+        AABB3d clip(
+            const size_t    item_index,
+            const size_t    dimension,
+            const double    slab_min,
+            const double    slab_max) const
+        {
+            AABB3d bbox = m_bboxes[item_index];
+
+            if (bbox.min[dimension] < slab_min)
+                bbox.min[dimension] = slab_min;
+
+            if (bbox.max[dimension] > slab_max)
+                bbox.max[dimension] = slab_max;
+
+            return bbox;
+        }
+
+        bool intersect(
+            const size_t    item_index,
+            const AABB3d&   bbox) const
+        {
+            return AABB3d::overlap(m_bboxes[item_index], bbox);
+        }
+    };
+
+    AABBVector make_random_bboxes(const size_t count)
+    {
+        MersenneTwister rng;
+        AABBVector bboxes;
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            const Vector3d center(rand_double1(rng), rand_double1(rng), rand_double1(rng));
+            const Vector3d extent(0.001 + 0.02 * rand_double1(rng));
+            bboxes.emplace_back(center - extent, center + extent);
+        }
+
+        return bboxes;
+    }
+
+    bool are_equal(const Tree& lhs, const Tree& rhs)
+    {
+        if (lhs.m_nodes.size() != rhs.m_nodes.size())
+            return false;
+
+        for (size_t i = 0, e = lhs.m_nodes.size(); i < e; ++i)
+        {
+            const NodeType& lhs_node = lhs.m_nodes[i];
+            const NodeType& rhs_node = rhs.m_nodes[i];
+
+            if (lhs_node.is_leaf() != rhs_node.is_leaf())
+                return false;
+
+            if (lhs_node.is_leaf())
+            {
+                if (lhs_node.get_item_index() != rhs_node.get_item_index() ||
+                    lhs_node.get_item_count() != rhs_node.get_item_count())
+                    return false;
+            }
+            else
+            {
+                if (lhs_node.get_child_node_index() != rhs_node.get_child_node_index() ||
+                    lhs_node.get_left_bbox() != rhs_node.get_left_bbox() ||
+                    lhs_node.get_right_bbox() != rhs_node.get_right_bbox())
+                    return false;
+            }
+        }
+
+        return true;
+    }
+
+    TEST_CASE(ParallelBuilderBuildsSameTreeAsBuilder)
+    {
+        const AABBVector bboxes = make_random_bboxes(5000);
+
+        typedef bvh::SAHPartitioner<AABBVector> Partitioner;
+
+        Partitioner serial_partitioner(bboxes, 2);
+        Tree serial_tree;
+        bvh::Builder<Tree, Partitioner> serial_builder;
+        serial_builder.build<DefaultWallclockTimer>(serial_tree, serial_partitioner, bboxes.size(), 2);
+
+        Partitioner parallel_partitioner(bboxes, 2);
+        Tree parallel_tree;
+        Logger logger;
+        bvh::ParallelBuilder<Tree, Partitioner> parallel_builder(logger);
+        parallel_builder.build<DefaultWallclockTimer>(parallel_tree, parallel_partitioner, bboxes.size(), 2, 4, 64);
+
+        EXPECT_TRUE(parallel_builder.get_task_count() > 1);
+        EXPECT_TRUE(are_equal(serial_tree, parallel_tree));
+        EXPECT_EQ(serial_partitioner.get_item_ordering(), parallel_partitioner.get_item_ordering());
+    }
+
+    TEST_CASE(ParallelBuilderUsesSingleTaskWhenSingleThreaded)
+    {
+        const AABBVector bboxes = make_random_bboxes(1000);
+
+        typedef bvh::SAHPartitioner<AABBVector> Partitioner;
+        Partitioner partitioner(bboxes, 2);
+
+        Tree tree;
+        Logger logger;
+        bvh::ParallelBuilder<Tree, Partitioner> builder(logger);
+        builder.build<DefaultWallclockTimer>(tree, partitioner, bboxes.size(), 2, 1, 64);
+
+        EXPECT_EQ(1, builder.get_task_count());
+    }
+
+    TEST_CASE(ParallelSpatialBuilderBuildsSameTreeAsSpatialBuilder)
+    {
+        const AABBVector bboxes = make_random_bboxes(5000);
+        const ItemHandler item_handler(bboxes);
+
+        typedef bvh::SBVHPartitioner<const ItemHandler, AABBVector> Partitioner;
+
+        Partitioner serial_partitioner(item_handler, bboxes, 2);
+        Partitioner::LeafType* serial_root_leaf = serial_partitioner.create_root_leaf();
+        const AABB3d serial_root_leaf_bbox = serial_partitioner.compute_leaf_bbox(*serial_root_leaf);
+        Tree serial_tree;
+        bvh::SpatialBuilder<Tree, Partitioner> serial_builder;
+        serial_builder.build<DefaultWallclockTimer>(serial_tree, serial_partitioner, serial_root_leaf, serial_root_leaf_bbox);
+
+        Partitioner parallel_partitioner(item_handler, bboxes, 2);
+        Partitioner::LeafType* parallel_root_leaf = parallel_partitioner.create_root_leaf();
+        const AABB3d parallel_root_leaf_bbox = parallel_partitioner.compute_leaf_bbox(*parallel_root_leaf);
+        Tree parallel_tree;
+        Logger logger;
+        bvh::ParallelSpatialBuilder<Tree, Partitioner> parallel_builder(logger);
+        parallel_builder.build<DefaultWallclockTimer>(parallel_tree, parallel_partitioner, parallel_root_leaf, parallel_root_leaf_bbox, 4, 64);
+
+        EXPECT_TRUE(parallel_builder.get_task_count() > 1);
+        EXPECT_TRUE(are_equal(serial_tree, parallel_tree));
+        EXPECT_EQ(serial_partitioner.get_item_ordering(), parallel_partitioner.get_item_ordering());
+        EXPECT_EQ(serial_partitioner.get_spatial_split_count(), parallel_partitioner.get_spatial_split_count());
+        EXPECT_EQ(serial_partitioner.get_object_split_count(), parallel_partitioner.get_object_split_count());
+    }
+}
+
+TEST_SUITE(Foundation_Math_BVH_Refitter)
+{
+    typedef std::vector<AABB3d> AABBVector;
+    typedef bvh::Node<AABB3d> NodeType;
+
+    struct Tree
+      : public bvh::Tree<AlignedVector<NodeType>>
+    {
+        using bvh::Tree<AlignedVector<NodeType>>::m_nodes;
+    };
+
+    struct LeafBBox
+    {
+        const AABBVector&           m_bboxes;
+        const std::vector<size_t>&  m_ordering;
+
+        LeafBBox(
+            const AABBVector&           bboxes,
+            const std::vector<size_t>&  ordering)
+          : m_bboxes(bboxes)
+          , m_ordering(ordering)
+        {
+        }
+
+        AABB3d operator()(const NodeType& node) const
+        {
+            AABB3d bbox;
+            bbox.invalidate();
+
+            for (size_t i = 0, e = node.get_item_count(); i < e; ++i)
+                bbox.insert(m_bboxes[m_ordering[node.get_item_index() + i]]);
+
+            return bbox;
+        }
+    };
+
+    struct Fixture
+    {
+        typedef bvh::SAHPartitioner<AABBVector> Partitioner;
+
+        AABBVector              m_bboxes;
+        Tree                    m_tree;
+        std::vector<size_t>     m_ordering;
+
+        Fixture()
+        {
+            MersenneTwister rng;
+
+            for (size_t i = 0; i < 1000; ++i)
+            {
+                const Vector3d center(rand_double1(rng), rand_double1(rng), rand_double1(rng));
+                const Vector3d extent(0.001 + 0.02 * rand_double1(rng));
+                m_bboxes.emplace_back(center - extent, center + extent);
+            }
+
+            Partitioner partitioner(m_bboxes, 2);
+            bvh::Builder<Tree, Partitioner> builder;
+            builder.build<DefaultWallclockTimer>(m_tree, partitioner, m_bboxes.size(), 2);
+            m_ordering = partitioner.get_item_ordering();
+        }
+
+        AABB3d compute_bbox(const AABBVector& bboxes) const
+        {
+            AABB3d bbox;
+            bbox.invalidate();
+
+            for (size_t i = 0, e = bboxes.size(); i < e; ++i)
+                bbox.insert(bboxes[i]);
+
+            return bbox;
+        }
+
+        bool contains(const AABB3d& outer, const AABB3d& inner) const
+        {
+            for (size_t i = 0; i < 3; ++i)
+            {
+                if (inner.min[i] < outer.min[i] || inner.max[i] > outer.max[i])
+                    return false;
+            }
+
+            return true;
+        }
+
+        // Return true if the bounding box of every node encloses the bounding boxes of its items.
+        bool are_items_enclosed(
+            const AABBVector&   bboxes,
+            const size_t        node_index,
+            const AABB3d&       node_bbox) const
+        {
+            const NodeType& node = m_tree.m_nodes[node_index];
+
+            if (node.is_leaf())
+                return contains(node_bbox, LeafBBox(bboxes, m_ordering)(node));
+
+            return
+                contains(node_bbox, node.get_left_bbox()) &&
+                contains(node_bbox, node.get_right_bbox()) &&
+                are_items_enclosed(bboxes, node.get_child_node_index(), node.get_left_bbox()) &&
+                are_items_enclosed(bboxes, node.get_child_node_index() + 1, node.get_right_bbox());
+        }
+    };
+
+    TEST_CASE_F(Refit_GivenTranslatedItems_ReturnsTranslatedRootBBox, Fixture)
+    {
+        AABBVector moved_bboxes = m_bboxes;
+        for (size_t i = 0, e = moved_bboxes.size(); i < e; ++i)
+            moved_bboxes[i].translate(Vector3d(10.0, 0.0, 0.0));
+
+        bvh::Refitter<Tree> refitter;
+        const AABB3d root_bbox = refitter.refit(m_tree, LeafBBox(moved_bboxes, m_ordering));
+
+        EXPECT_EQ(compute_bbox(moved_bboxes), root_bbox);
+        EXPECT_TRUE(are_items_enclosed(moved_bboxes, 0, root_bbox));
+    }
+
+    TEST_CASE_F(ComputeSAHCost_GivenUnchangedItems_ReturnsSameCostAfterRefit, Fixture)
+    {
+        bvh::Refitter<Tree> refitter;
+        const AABB3d root_bbox = compute_bbox(m_bboxes);
+        const double cost_before = refitter.compute_sah_cost(m_tree, root_bbox, 1.0, 1.0);
+
+        refitter.refit(m_tree, LeafBBox(m_bboxes, m_ordering));
+        const double cost_after = refitter.compute_sah_cost(m_tree, root_bbox, 1.0, 1.0);
+
+        EXPECT_FEQ(cost_before, cost_after);
+    }
+
+    TEST_CASE_F(ComputeSAHCost_GivenScrambledItems_ReturnsHigherCostAfterRefit, Fixture)
+    {
+        bvh::Refitter<Tree> refitter;
+        const AABB3d root_bbox = compute_bbox(m_bboxes);
+        const double cost_before = refitter.compute_sah_cost(m_tree, root_bbox, 1.0, 1.0);
+
+        // Reverse the items, as if every item had moved to the position of another one.
+        AABBVector scrambled_bboxes(m_bboxes.rbegin(), m_bboxes.rend());
+        refitter.refit(m_tree, LeafBBox(scrambled_bboxes, m_ordering));
+        const double cost_after = refitter.compute_sah_cost(m_tree, root_bbox, 1.0, 1.0);
+
+        EXPECT_GT(2.0 * cost_before, cost_after);
+    }
+}
+
 TEST_SUITE(Foundation_Math_BVH_Intersector_2D)
 {
     typedef bvh::Node<AABB2d> NodeType;
@@ -149,3 +614,652 @@ TEST_SUITE(Foundation_Math_BVH_Intersector_2D)
         > intersector;
     }
 }
+
+TEST_SUITE(Foundation_Math_BVH_WideIntersector)
+{
+    typedef std::vector<AABB3d> AABBVector;
+    typedef bvh::Tree<AlignedVector<bvh::Node<AABB3d>>> Tree;
+    typedef Tree::NodeType NodeType;
+
+    struct Visitor
+    {
+        const AABBVector&           m_bboxes;
+        const std::vector<size_t>&  m_ordering;
+        double                      m_closest_distance;
+        size_t                      m_closest_item;
+        size_t                      m_visited_leaves;
+
+        Visitor(
+            const AABBVector&           bboxes,
+            const std::vector<size_t>&  ordering)
+          : m_bboxes(bboxes)
+          , m_ordering(ordering)
+          , m_closest_distance(std::numeric_limits<double>::max())
+          , m_closest_item(~size_t(0))
+          , m_visited_leaves(0)
+        {
+        }
+
+        bool visit(
+            const NodeType&             node,
+            const Ray3d&                ray,
+            const RayInfo3d&            ray_info,
+            double&                     distance
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+            , bvh::TraversalStatistics& stats
+#endif
+            )
+        {
+            ++m_visited_leaves;
+
+            for (size_t i = 0, e = node.get_item_count(); i < e; ++i)
+            {
+                const size_t item = m_ordering[node.get_item_index() + i];
+
+                double tmin;
+                if (intersect(ray, ray_info, m_bboxes[item], tmin) && tmin < m_closest_distance)
+                {
+                    m_closest_distance = tmin;
+                    m_closest_item = item;
+                }
+            }
+
+            distance = m_closest_distance;
+            return true;
+        }
+    };
+
+    struct Fixture
+    {
+        AABBVector                  m_bboxes;
+        std::vector<size_t>         m_ordering;
+        Tree                        m_tree;
+        MersenneTwister             m_rng;
+
+        Fixture()
+        {
+            for (size_t i = 0; i < 1000; ++i)
+            {
+                const Vector3d center(rand_double1(m_rng), rand_double1(m_rng), rand_double1(m_rng));
+                const Vector3d extent(0.01 + 0.02 * rand_double1(m_rng));
+                m_bboxes.emplace_back(center - extent, center + extent);
+            }
+
+            typedef bvh::SAHPartitioner<AABBVector> Partitioner;
+            Partitioner partitioner(m_bboxes, 2);
+
+            bvh::Builder<Tree, Partitioner> builder;
+            builder.build<DefaultWallclockTimer>(m_tree, partitioner, m_bboxes.size(), 2);
+
+            m_ordering = partitioner.get_item_ordering();
+        }
+
+        Ray3d make_random_ray()
+        {
+            const Vector3d org(
+                rand_double1(m_rng, -0.5, 1.5),
+                rand_double1(m_rng, -0.5, 1.5),
+                rand_double1(m_rng, -0.5, 1.5));
+
+            const Vector3d target(rand_double1(m_rng), rand_double1(m_rng), rand_double1(m_rng));
+
+            return Ray3d(org, normalize(target - org));
+        }
+
+        // Return the number of rays for which both intersectors disagree.
+        template <size_t Width>
+        size_t trace_random_rays(size_t& hit_count, const bool remove_interior_nodes = false)
+        {
+            Tree leaf_tree(m_tree);
+            bvh::WideTree<Tree, Width> wide_tree;
+            wide_tree.build(leaf_tree);
+
+            if (remove_interior_nodes)
+                wide_tree.remove_interior_nodes(leaf_tree);
+
+            bvh::Intersector<Tree, Visitor, Ray3d> binary_intersector;
+            bvh::WideIntersector<Tree, Visitor, Ray3d, Width> wide_intersector;
+
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+            bvh::TraversalStatistics stats;
+#endif
+
+            size_t mismatch_count = 0;
+            hit_count = 0;
+
+            for (size_t i = 0; i < 1000; ++i)
+            {
+                const Ray3d ray = make_random_ray();
+                const RayInfo3d ray_info(ray);
+
+                Visitor binary_visitor(m_bboxes, m_ordering);
+                binary_intersector.intersect_no_motion(
+                    m_tree,
+                    ray,
+                    ray_info,
+                    binary_visitor
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+                    , stats
+#endif
+                    );
+
+                Visitor wide_visitor(m_bboxes, m_ordering);
+                wide_intersector.intersect_no_motion(
+                    leaf_tree,
+                    wide_tree,
+                    ray,
+                    ray_info,
+                    wide_visitor
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+                    , stats
+#endif
+                    );
+
+                if (binary_visitor.m_closest_item != wide_visitor.m_closest_item ||
+                    binary_visitor.m_closest_distance != wide_visitor.m_closest_distance)
+                    ++mismatch_count;
+
+                if (binary_visitor.m_closest_item != ~size_t(0))
+                    ++hit_count;
+            }
+
+            return mismatch_count;
+        }
+    };
+
+    TEST_CASE_F(FourWideIntersectorFindsSameClosestHitsAsBinaryIntersector, Fixture)
+    {
+        size_t hit_count;
+        EXPECT_EQ(0, trace_random_rays<4>(hit_count));
+        EXPECT_TRUE(hit_count > 0);
+    }
+
+    TEST_CASE_F(EightWideIntersectorFindsSameClosestHitsAsBinaryIntersector, Fixture)
+    {
+        size_t hit_count;
+        EXPECT_EQ(0, trace_random_rays<8>(hit_count));
+        EXPECT_TRUE(hit_count > 0);
+    }
+
+    TEST_CASE_F(WideIntersectorFindsSameClosestHitsAfterBinaryInteriorNodesAreRemoved, Fixture)
+    {
+        size_t hit_count;
+        EXPECT_EQ(0, trace_random_rays<4>(hit_count, true));
+        EXPECT_TRUE(hit_count > 0);
+    }
+
+    TEST_CASE_F(RemoveInteriorNodes_ReleasesMemory, Fixture)
+    {
+        const size_t initial_size = m_tree.get_memory_size();
+
+        bvh::WideTree<Tree, 4> wide_tree;
+        wide_tree.build(m_tree);
+        wide_tree.remove_interior_nodes(m_tree);
+
+        EXPECT_LT(initial_size, m_tree.get_memory_size());
+    }
+
+    TEST_CASE_F(Build_GivenTreeDeeperThanMaxDepth_FailsAndLeavesTreeEmpty, Fixture)
+    {
+        bvh::WideTree<Tree, 4> wide_tree;
+        const bool success = wide_tree.build(m_tree, 1);
+
+        EXPECT_FALSE(success);
+        EXPECT_TRUE(wide_tree.empty());
+    }
+
+    TEST_CASE_F(Refit_GivenUnchangedItems_PreservesSAHCost, Fixture)
+    {
+        bvh::WideTree<Tree, 4> wide_tree;
+        wide_tree.build(m_tree);
+        wide_tree.remove_interior_nodes(m_tree);
+
+        const double initial_cost = wide_tree.compute_sah_cost(m_tree, 1.0, 1.0);
+
+        const AABB3d root_bbox =
+            wide_tree.refit(
+                m_tree,
+                [this](const NodeType& node)
+                {
+                    AABB3d bbox;
+                    bbox.invalidate();
+
+                    for (size_t i = 0, e = node.get_item_count(); i < e; ++i)
+                        bbox.insert(m_bboxes[m_ordering[node.get_item_index() + i]]);
+
+                    return bbox;
+                });
+
+        AABB3d expected_root_bbox;
+        expected_root_bbox.invalidate();
+        for (const AABB3d& bbox : m_bboxes)
+            expected_root_bbox.insert(bbox);
+
+        EXPECT_EQ(expected_root_bbox, root_bbox);
+        EXPECT_GT(0.0, initial_cost);
+        EXPECT_FEQ(initial_cost, wide_tree.compute_sah_cost(m_tree, 1.0, 1.0));
+    }
+
+    TEST_CASE_F(Refit_GivenTranslatedItems_FindsSameClosestHitsAsTranslatedRays, Fixture)
+    {
+        bvh::WideTree<Tree, 4> wide_tree;
+        wide_tree.build(m_tree);
+        wide_tree.remove_interior_nodes(m_tree);
+
+        const Vector3d offset(10.0, 0.0, 0.0);
+        AABBVector moved_bboxes;
+        for (const AABB3d& bbox : m_bboxes)
+            moved_bboxes.emplace_back(bbox.min + offset, bbox.max + offset);
+
+        wide_tree.refit(
+            m_tree,
+            [&](const NodeType& node)
+            {
+                AABB3d bbox;
+                bbox.invalidate();
+
+                for (size_t i = 0, e = node.get_item_count(); i < e; ++i)
+                    bbox.insert(moved_bboxes[m_ordering[node.get_item_index() + i]]);
+
+                return bbox;
+            });
+
+        bvh::WideIntersector<Tree, Visitor, Ray3d, 4> intersector;
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+        bvh::TraversalStatistics stats;
+#endif
+
+        size_t mismatch_count = 0;
+        size_t hit_count = 0;
+
+        for (size_t i = 0; i < 1000; ++i)
+        {
+            const Ray3d ray = make_random_ray();
+            const RayInfo3d ray_info(ray);
+            const Ray3d moved_ray(ray.m_org + offset, ray.m_dir);
+            const RayInfo3d moved_ray_info(moved_ray);
+
+            // Reference: brute force intersection of the original items with the original ray.
+            size_t expected_item = ~size_t(0);
+            double expected_distance = std::numeric_limits<double>::max();
+            for (size_t j = 0, e = m_bboxes.size(); j < e; ++j)
+            {
+                double tmin;
+                if (intersect(ray, ray_info, m_bboxes[j], tmin) && tmin < expected_distance)
+                {
+                    expected_distance = tmin;
+                    expected_item = j;
+                }
+            }
+
+            Visitor visitor(moved_bboxes, m_ordering);
+            intersector.intersect_no_motion(
+                m_tree,
+                wide_tree,
+                moved_ray,
+                moved_ray_info,
+                visitor
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+                , stats
+#endif
+                );
+
+            if (visitor.m_closest_item != expected_item)
+                ++mismatch_count;
+
+            if (expected_item != ~size_t(0))
+                ++hit_count;
+        }
+
+        EXPECT_EQ(0, mismatch_count);
+        EXPECT_TRUE(hit_count > 0);
+    }
+
+    TEST_CASE(WideTreeBuiltFromSingleLeafTreeVisitsLeaf)
+    {
+        AABBVector bboxes;
+        bboxes.emplace_back(Vector3d(0.0), Vector3d(1.0));
+
+        typedef bvh::SAHPartitioner<AABBVector> Partitioner;
+        Partitioner partitioner(bboxes);
+
+        Tree tree;
+        bvh::Builder<Tree, Partitioner> builder;
+        builder.build<DefaultWallclockTimer>(tree, partitioner, bboxes.size(), 1);
+
+        bvh::WideTree<Tree, 4> wide_tree;
+        wide_tree.build(tree);
+
+        const Ray3d ray(Vector3d(0.5, 0.5, -1.0), Vector3d(0.0, 0.0, 1.0));
+        const RayInfo3d ray_info(ray);
+
+        Visitor visitor(bboxes, partitioner.get_item_ordering());
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+        bvh::TraversalStatistics stats;
+#endif
+        bvh::WideIntersector<Tree, Visitor, Ray3d, 4> intersector;
+        intersector.intersect_no_motion(
+            tree,
+            wide_tree,
+            ray,
+            ray_info,
+            visitor
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+            , stats
+#endif
+            );
+
+        EXPECT_EQ(1, wide_tree.get_node_count());
+        EXPECT_EQ(1, visitor.m_visited_leaves);
+        EXPECT_EQ(0, visitor.m_closest_item);
+        EXPECT_EQ(1.0, visitor.m_closest_distance);
+    }
+}
+
+TEST_SUITE(Foundation_Math_BVH_PacketIntersector)
+{
+    typedef std::vector<AABB3d> AABBVector;
+    typedef bvh::Tree<AlignedVector<bvh::Node<AABB3d>>> Tree;
+    typedef Tree::NodeType NodeType;
+
+    struct Visitor
+    {
+        const AABBVector&           m_bboxes;
+        const std::vector<size_t>&  m_ordering;
+        double                      m_closest_distance;
+        size_t                      m_closest_item;
+
+        Visitor(
+            const AABBVector&           bboxes,
+            const std::vector<size_t>&  ordering)
+          : m_bboxes(bboxes)
+          , m_ordering(ordering)
+          , m_closest_distance(std::numeric_limits<double>::max())
+          , m_closest_item(~size_t(0))
+        {
+        }
+
+        bool visit(
+            const NodeType&             node,
+            const Ray3d&                ray,
+            const RayInfo3d&            ray_info,
+            double&                     distance
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+            , bvh::TraversalStatistics& stats
+#endif
+            )
+        {
+            for (size_t i = 0, e = node.get_item_count(); i < e; ++i)
+            {
+                const size_t item = m_ordering[node.get_item_index() + i];
+
+                double tmin;
+                if (intersect(ray, ray_info, m_bboxes[item], tmin) && tmin < m_closest_distance)
+                {
+                    m_closest_distance = tmin;
+                    m_closest_item = item;
+                }
+            }
+
+            distance = m_closest_distance;
+            return true;
+        }
+    };
+
+    struct PacketVisitor
+    {
+        const AABBVector&           m_bboxes;
+        const std::vector<size_t>&  m_ordering;
+        const bool                  m_probe;
+        double                      m_closest_distance[bvh::MaxPacketSize];
+        size_t                      m_closest_item[bvh::MaxPacketSize];
+
+        PacketVisitor(
+            const AABBVector&           bboxes,
+            const std::vector<size_t>&  ordering,
+            const bool                  probe)
+          : m_bboxes(bboxes)
+          , m_ordering(ordering)
+          , m_probe(probe)
+        {
+            for (size_t i = 0; i < bvh::MaxPacketSize; ++i)
+            {
+                m_closest_distance[i] = std::numeric_limits<double>::max();
+                m_closest_item[i] = ~size_t(0);
+            }
+        }
+
+        bool visit(
+            const NodeType&             node,
+            const Ray3d                 rays[],
+            const RayInfo3d             ray_infos[],
+            bvh::PacketMask&            mask,
+            double                      distances[]
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+            , bvh::TraversalStatistics& stats
+#endif
+            )
+        {
+            for (size_t r = 0; r < bvh::MaxPacketSize; ++r)
+            {
+                if ((mask & (bvh::PacketMask(1) << r)) == 0)
+                    continue;
+
+                for (size_t i = 0, e = node.get_item_count(); i < e; ++i)
+                {
+                    const size_t item = m_ordering[node.get_item_index() + i];
+
+                    double tmin;
+                    if (intersect(rays[r], ray_infos[r], m_bboxes[item], tmin) && tmin < m_closest_distance[r])
+                    {
+                        m_closest_distance[r] = tmin;
+                        m_closest_item[r] = item;
+                    }
+                }
+
+                // Probe rays are done as soon as they hit something.
+                if (m_probe && m_closest_item[r] != ~size_t(0))
+                    mask &= ~(bvh::PacketMask(1) << r);
+
+                distances[r] = std::min(distances[r], m_closest_distance[r]);
+            }
+
+            return true;
+        }
+    };
+
+    struct Fixture
+    {
+        AABBVector                  m_bboxes;
+        std::vector<size_t>         m_ordering;
+        Tree                        m_tree;
+        MersenneTwister             m_rng;
+
+        Fixture()
+        {
+            for (size_t i = 0; i < 1000; ++i)
+            {
+                const Vector3d center(rand_double1(m_rng), rand_double1(m_rng), rand_double1(m_rng));
+                const Vector3d extent(0.01 + 0.02 * rand_double1(m_rng));
+                m_bboxes.emplace_back(center - extent, center + extent);
+            }
+
+            typedef bvh::SAHPartitioner<AABBVector> Partitioner;
+            Partitioner partitioner(m_bboxes, 2);
+
+            bvh::Builder<Tree, Partitioner> builder;
+            builder.build<DefaultWallclockTimer>(m_tree, partitioner, m_bboxes.size(), 2);
+
+            m_ordering = partitioner.get_item_ordering();
+        }
+
+        // Generate a packet of rays starting from a common origin, as shadow rays would.
+        void make_random_packet(Ray3d rays[], RayInfo3d ray_infos[], const size_t ray_count)
+        {
+            const Vector3d org(
+                rand_double1(m_rng, -0.5, 1.5),
+                rand_double1(m_rng, -0.5, 1.5),
+                rand_double1(m_rng, -0.5, 1.5));
+
+            for (size_t i = 0; i < ray_count; ++i)
+            {
+                const Vector3d target(rand_double1(m_rng), rand_double1(m_rng), rand_double1(m_rng));
+                rays[i] = Ray3d(org, normalize(target - org));
+                ray_infos[i] = RayInfo3d(rays[i]);
+            }
+        }
+
+        // Return the number of rays for which the packet and the binary intersectors disagree.
+        size_t trace_random_packets(const size_t ray_count, const bvh::PacketMask mask, size_t& hit_count)
+        {
+            bvh::Intersector<Tree, Visitor, Ray3d> binary_intersector;
+            bvh::PacketIntersector<Tree, PacketVisitor, Ray3d> packet_intersector;
+
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+            bvh::TraversalStatistics stats;
+#endif
+
+            size_t mismatch_count = 0;
+            hit_count = 0;
+
+            for (size_t p = 0; p < 50; ++p)
+            {
+                Ray3d rays[bvh::MaxPacketSize];
+                RayInfo3d ray_infos[bvh::MaxPacketSize];
+                make_random_packet(rays, ray_infos, ray_count);
+
+                PacketVisitor packet_visitor(m_bboxes, m_ordering, false);
+                packet_intersector.intersect_no_motion(
+                    m_tree,
+                    rays,
+                    ray_infos,
+                    ray_count,
+                    mask,
+                    packet_visitor
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+                    , stats
+#endif
+                    );
+
+                for (size_t i = 0; i < ray_count; ++i)
+                {
+                    if ((mask & (bvh::PacketMask(1) << i)) == 0)
+                    {
+                        // Inactive rays must not be traced.
+                        if (packet_visitor.m_closest_item[i] != ~size_t(0))
+                            ++mismatch_count;
+                        continue;
+                    }
+
+                    Visitor binary_visitor(m_bboxes, m_ordering);
+                    binary_intersector.intersect_no_motion(
+                        m_tree,
+                        rays[i],
+                        ray_infos[i],
+                        binary_visitor
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+                        , stats
+#endif
+                        );
+
+                    if (binary_visitor.m_closest_item != packet_visitor.m_closest_item[i] ||
+                        binary_visitor.m_closest_distance != packet_visitor.m_closest_distance[i])
+                        ++mismatch_count;
+
+                    if (binary_visitor.m_closest_item != ~size_t(0))
+                        ++hit_count;
+                }
+            }
+
+            return mismatch_count;
+        }
+
+        // Return the number of probe rays for which the packet and the binary intersectors disagree.
+        size_t probe_random_packets(const size_t ray_count)
+        {
+            bvh::Intersector<Tree, Visitor, Ray3d> binary_intersector;
+            bvh::PacketIntersector<Tree, PacketVisitor, Ray3d> packet_intersector;
+
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+            bvh::TraversalStatistics stats;
+#endif
+
+            size_t mismatch_count = 0;
+
+            for (size_t p = 0; p < 50; ++p)
+            {
+                Ray3d rays[bvh::MaxPacketSize];
+                RayInfo3d ray_infos[bvh::MaxPacketSize];
+                make_random_packet(rays, ray_infos, ray_count);
+
+                PacketVisitor packet_visitor(m_bboxes, m_ordering, true);
+                packet_intersector.intersect_no_motion(
+                    m_tree,
+                    rays,
+                    ray_infos,
+                    ray_count,
+                    bvh::make_packet_mask(ray_count),
+                    packet_visitor
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+                    , stats
+#endif
+                    );
+
+                for (size_t i = 0; i < ray_count; ++i)
+                {
+                    Visitor binary_visitor(m_bboxes, m_ordering);
+                    binary_intersector.intersect_no_motion(
+                        m_tree,
+                        rays[i],
+                        ray_infos[i],
+                        binary_visitor
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+                        , stats
+#endif
+                        );
+
+                    const bool binary_hit = binary_visitor.m_closest_item != ~size_t(0);
+                    const bool packet_hit = packet_visitor.m_closest_item[i] != ~size_t(0);
+
+                    if (binary_hit != packet_hit)
+                        ++mismatch_count;
+                }
+            }
+
+            return mismatch_count;
+        }
+    };
+
+    TEST_CASE(MakePacketMask_ReturnsMaskWithFirstBitsSet)
+    {
+        EXPECT_EQ(0, bvh::make_packet_mask(0));
+        EXPECT_EQ(0x7, bvh::make_packet_mask(3));
+        EXPECT_EQ(~bvh::PacketMask(0), bvh::make_packet_mask(bvh::MaxPacketSize));
+    }
+
+    TEST_CASE_F(FullPacketFindsSameClosestHitsAsBinaryIntersector, Fixture)
+    {
+        size_t hit_count;
+        EXPECT_EQ(0, trace_random_packets(bvh::MaxPacketSize, ~bvh::PacketMask(0), hit_count));
+        EXPECT_TRUE(hit_count > 0);
+    }
+
+    TEST_CASE_F(PartialPacketFindsSameClosestHitsAsBinaryIntersector, Fixture)
+    {
+        size_t hit_count;
+        EXPECT_EQ(0, trace_random_packets(13, ~bvh::PacketMask(0), hit_count));
+        EXPECT_TRUE(hit_count > 0);
+    }
+
+    TEST_CASE_F(PacketWithSparseMaskOnlyTracesActiveRays, Fixture)
+    {
+        size_t hit_count;
+        EXPECT_EQ(0, trace_random_packets(bvh::MaxPacketSize, 0x5555AAAA0F0F00FFULL, hit_count));
+        EXPECT_TRUE(hit_count > 0);
+    }
+
+    TEST_CASE_F(ProbePacketFindsSameOccludedRaysAsBinaryIntersector, Fixture)
+    {
+        EXPECT_EQ(0, probe_random_packets(bvh::MaxPacketSize));
+    }
+}
@@ -188,6 +188,25 @@ TEST_SUITE(Foundation_Utility_Cache_LRUCache)
         cache.get(9);   // flushes 6, cache contains 9
         ASSERT_EQ(9000, element_swapper.m_memory_size);
     }
+
+    TEST_CASE(Evict_UnloadsLeastRecentlyUsedElement)
+    {
+        KeyHasher key_hasher;
+        ElementSwapperTrackingSize element_swapper;
+        LRUCache<Key, KeyHasher, Element, ElementSwapperTrackingSize> cache(key_hasher, element_swapper);
+
+        cache.get(1);
+        cache.get(2);
+        cache.get(1);   // cache contains 1 and 2, 2 is the least recently used element
+
+        ASSERT_TRUE(cache.evict());
+        ASSERT_EQ(1000, element_swapper.m_memory_size);
+
+        ASSERT_TRUE(cache.evict());
+        ASSERT_EQ(0, element_swapper.m_memory_size);
+
+        EXPECT_FALSE(cache.evict());
+    }
 }
 
 TEST_SUITE(Foundation_Utility_Cache_DualStageCache)
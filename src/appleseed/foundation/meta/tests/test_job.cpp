@@ -294,6 +294,55 @@ TEST_SUITE(Foundation_Utility_Job_JobQueue)
 
         EXPECT_EQ(0, destruction_count);
     }
+
+    TEST_CASE(AcquireScheduledJobStealsFromOtherLanes)
+    {
+        JobQueue job_queue;
+        job_queue.set_lane_count(2);
+        job_queue.schedule(new EmptyJob());     // goes to lane 0
+
+        const JobQueue::RunningJobInfo running_job_info =
+            job_queue.acquire_scheduled_job(1);
+
+        EXPECT_NEQ(0, running_job_info.first.m_job);
+        EXPECT_EQ(0, running_job_info.second);
+        EXPECT_EQ(1, job_queue.get_steal_count());
+
+        job_queue.retire_running_job(running_job_info);
+
+        EXPECT_FALSE(job_queue.has_scheduled_or_running_jobs());
+    }
+
+    TEST_CASE(SetLaneCountPreservesScheduledJobs)
+    {
+        IJob* job1 = new EmptyJob();
+        IJob* job2 = new EmptyJob();
+        IJob* job3 = new EmptyJob();
+
+        JobQueue job_queue;
+        job_queue.set_lane_count(2);
+        job_queue.schedule(job1);
+        job_queue.schedule(job2);
+        job_queue.schedule(job3);
+
+        job_queue.set_lane_count(1);
+
+        EXPECT_EQ(1, job_queue.get_lane_count());
+        EXPECT_EQ(3, job_queue.get_scheduled_job_count());
+
+        const JobQueue::RunningJobInfo info1 = job_queue.acquire_scheduled_job();
+        const JobQueue::RunningJobInfo info2 = job_queue.acquire_scheduled_job();
+        const JobQueue::RunningJobInfo info3 = job_queue.acquire_scheduled_job();
+
+        EXPECT_EQ(job1, info1.first.m_job);
+        EXPECT_EQ(job2, info2.first.m_job);
+        EXPECT_EQ(job3, info3.first.m_job);
+        EXPECT_EQ(0, job_queue.get_steal_count());
+
+        job_queue.retire_running_job(info1);
+        job_queue.retire_running_job(info2);
+        job_queue.retire_running_job(info3);
+    }
 }
 
 TEST_SUITE(Foundation_Utility_Job_JobManager)
@@ -373,6 +422,27 @@ TEST_SUITE(Foundation_Utility_Job_JobManager)
 
         EXPECT_EQ(1, execution_count);
     }
+
+    TEST_CASE(MultipleWorkerThreadsExecuteAllJobs)
+    {
+        Logger logger;
+        JobQueue job_queue;
+        JobManager job_manager(logger, job_queue, 4);
+
+        volatile std::uint32_t execution_count = 0;
+
+        for (size_t i = 0; i < 100; ++i)
+        {
+            job_queue.schedule(
+                new JobNotifyingAboutExecution(&execution_count));
+        }
+
+        job_manager.start();
+        job_queue.wait_until_completion();
+
+        EXPECT_EQ(4, job_queue.get_lane_count());
+        EXPECT_EQ(100, execution_count);
+    }
 }
 
 TEST_SUITE(Foundation_Utility_Job_WorkerThread)
@@ -28,6 +28,7 @@
 //
 
 // appleseed.foundation headers.
+#include "foundation/log/logger.h"
 #include "foundation/math/distance.h"
 #include "foundation/math/knn.h"
 #include "foundation/math/permutation.h"
@@ -145,6 +146,85 @@ TEST_SUITE(Foundation_Math_Knn_Builder)
     }
 }
 
+TEST_SUITE(Foundation_Math_Knn_ParallelBuilder)
+{
+    bool are_identical(const knn::Tree3d::NodeType& lhs, const knn::Tree3d::NodeType& rhs)
+    {
+        if (lhs.is_leaf() != rhs.is_leaf() ||
+            lhs.get_point_index() != rhs.get_point_index() ||
+            lhs.get_point_count() != rhs.get_point_count())
+            return false;
+
+        return
+            lhs.is_leaf() ||
+            (lhs.get_child_node_index() == rhs.get_child_node_index() &&
+             lhs.get_split_dim() == rhs.get_split_dim() &&
+             lhs.get_split_abs() == rhs.get_split_abs());
+    }
+
+    bool are_identical(
+        const std::vector<knn::Tree3d::NodeType>&   lhs,
+        const std::vector<knn::Tree3d::NodeType>&   rhs)
+    {
+        if (lhs.size() != rhs.size())
+            return false;
+
+        for (size_t i = 0; i < lhs.size(); ++i)
+        {
+            if (!are_identical(lhs[i], rhs[i]))
+                return false;
+        }
+
+        return true;
+    }
+
+    struct Fixture
+    {
+        knn::Tree3d m_expected_tree;
+        knn::Tree3d m_tree;
+        size_t      m_task_count;
+
+        void build(const std::vector<Vector3d>& points)
+        {
+            knn::Builder3d builder(m_expected_tree);
+            builder.build<DefaultWallclockTimer>(&points[0], points.size());
+
+            Logger logger;
+            knn::ParallelBuilder3d parallel_builder(m_tree, logger);
+            parallel_builder.build<DefaultWallclockTimer>(&points[0], points.size(), 4, 16);
+            m_task_count = parallel_builder.get_task_count();
+        }
+    };
+
+    TEST_CASE_F(Build_GivenRandomPoints_BuildsSameTreeAsBuilder, Fixture)
+    {
+        MersenneTwister rng;
+
+        std::vector<Vector3d> points(1000);
+        for (size_t i = 0; i < points.size(); ++i)
+            points[i] = rand_vector1<Vector3d>(rng);
+
+        build(points);
+
+        EXPECT_GT(1, m_task_count);
+        EXPECT_TRUE(m_expected_tree.m_points == m_tree.m_points);
+        EXPECT_TRUE(m_expected_tree.m_indices == m_tree.m_indices);
+        EXPECT_TRUE(are_identical(m_expected_tree.m_nodes, m_tree.m_nodes));
+    }
+
+    TEST_CASE_F(Build_GivenCoincidentPoints_BuildsSameTreeAsBuilder, Fixture)
+    {
+        const std::vector<Vector3d> points(100, Vector3d(1.0));
+
+        build(points);
+
+        EXPECT_GT(1, m_task_count);
+        EXPECT_TRUE(m_expected_tree.m_points == m_tree.m_points);
+        EXPECT_TRUE(m_expected_tree.m_indices == m_tree.m_indices);
+        EXPECT_TRUE(are_identical(m_expected_tree.m_nodes, m_tree.m_nodes));
+    }
+}
+
 TEST_SUITE(Foundation_Math_Knn_Answer)
 {
     TEST_CASE(Size_AfterZeroInsertion_ReturnsZero)
@@ -464,6 +544,92 @@ TEST_SUITE(Foundation_Math_Knn_Query)
     }
 }
 
+TEST_SUITE(Foundation_Math_Knn_HashGridQuery)
+{
+    TEST_CASE(Run_GivenEmptyGrid_ReturnsEmptyAnswer)
+    {
+        std::vector<Vector3d> points;
+
+        knn::HashGrid3d grid;
+        grid.build_move_points(points, 0.1);
+
+        knn::Answer<double> answer(4);
+        knn::HashGridQuery3d query(grid, answer);
+        const size_t tested_point_count = query.run(Vector3d(0.0), 1.0);
+
+        EXPECT_EQ(0, tested_point_count);
+        EXPECT_TRUE(answer.empty());
+    }
+
+    bool do_results_match_tree_query(
+        const double                cell_size,
+        const double                query_max_square_distance)
+    {
+        const size_t PointCount = 1000;
+        const size_t QueryCount = 200;
+        const size_t AnswerSize = 20;
+
+        MersenneTwister rng;
+
+        std::vector<Vector3d> points;
+        for (size_t i = 0; i < PointCount; ++i)
+            points.push_back(rand_vector1<Vector3d>(rng));
+
+        knn::Tree3d tree;
+        knn::Builder3d builder(tree);
+        builder.build<DefaultWallclockTimer>(&points[0], points.size());
+
+        knn::HashGrid3d grid;
+        grid.build_move_points(points, cell_size);
+
+        knn::Answer<double> tree_answer(AnswerSize);
+        knn::Query3d tree_query(tree, tree_answer);
+
+        knn::Answer<double> grid_answer(AnswerSize);
+        knn::HashGridQuery3d grid_query(grid, grid_answer);
+
+        for (size_t i = 0; i < QueryCount; ++i)
+        {
+            const Vector3d q = rand_vector1<Vector3d>(rng);
+
+            tree_query.run(q, query_max_square_distance);
+            tree_answer.sort();
+
+            grid_query.run(q, query_max_square_distance);
+            grid_answer.sort();
+
+            if (grid_answer.size() != tree_answer.size())
+                return false;
+
+            for (size_t j = 0; j < grid_answer.size(); ++j)
+            {
+                if (grid.remap(grid_answer.get(j).m_index) != tree.remap(tree_answer.get(j).m_index))
+                    return false;
+
+                if (grid_answer.get(j).m_square_dist != tree_answer.get(j).m_square_dist)
+                    return false;
+            }
+        }
+
+        return true;
+    }
+
+    TEST_CASE(Run_GivenSearchRadiusEqualToCellSize_ReturnsIdenticalResultsAsTreeQuery)
+    {
+        EXPECT_TRUE(do_results_match_tree_query(0.1, square(0.1)));
+    }
+
+    TEST_CASE(Run_GivenSearchRadiusLargerThanCellSize_ReturnsIdenticalResultsAsTreeQuery)
+    {
+        EXPECT_TRUE(do_results_match_tree_query(0.07, square(0.1)));
+    }
+
+    TEST_CASE(Run_GivenSearchRadiusMuchLargerThanCellSize_ReturnsIdenticalResultsAsTreeQuery)
+    {
+        EXPECT_TRUE(do_results_match_tree_query(0.01, square(0.1)));
+    }
+}
+
 TEST_SUITE(Foundation_Math_Knn_AnyQuery)
 {
     void generate_random_points(
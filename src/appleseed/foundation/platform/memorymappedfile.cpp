@@ -0,0 +1,177 @@
+
+//
+// This source file is part of appleseed.
+// Visit https://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2019 The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+// Interface header.
+#include "memorymappedfile.h"
+
+// appleseed.foundation headers.
+#ifdef _WIN32
+#include "foundation/platform/windows.h"
+#endif
+
+// Platform headers.
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace foundation
+{
+
+//
+// MemoryMappedFile class implementation.
+//
+
+struct MemoryMappedFile::Impl
+{
+    bool                    m_is_open;
+    const std::uint8_t*     m_data;
+    size_t                  m_size;
+#ifdef _WIN32
+    HANDLE                  m_file;
+    HANDLE                  m_mapping;
+#endif
+
+    Impl()
+      : m_is_open(false)
+      , m_data(nullptr)
+      , m_size(0)
+#ifdef _WIN32
+      , m_file(INVALID_HANDLE_VALUE)
+      , m_mapping(nullptr)
+#endif
+    {
+    }
+};
+
+MemoryMappedFile::MemoryMappedFile(const char* path)
+  : impl(new Impl())
+{
+#ifdef _WIN32
+
+    impl->m_file =
+        CreateFileA(
+            path,
+            GENERIC_READ,
+            FILE_SHARE_READ,
+            nullptr,
+            OPEN_EXISTING,
+            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+            nullptr);
+
+    if (impl->m_file == INVALID_HANDLE_VALUE)
+        return;
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(impl->m_file, &file_size))
+        return;
+
+    impl->m_size = static_cast<size_t>(file_size.QuadPart);
+
+    // Empty files cannot be mapped.
+    if (impl->m_size == 0)
+    {
+        impl->m_is_open = true;
+        return;
+    }
+
+    impl->m_mapping = CreateFileMappingA(impl->m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (impl->m_mapping == nullptr)
+        return;
+
+    impl->m_data = static_cast<const std::uint8_t*>(MapViewOfFile(impl->m_mapping, FILE_MAP_READ, 0, 0, 0));
+    impl->m_is_open = impl->m_data != nullptr;
+
+#else
+
+    const int fd = open(path, O_RDONLY);
+    if (fd == -1)
+        return;
+
+    struct stat file_info;
+    if (fstat(fd, &file_info) == 0)
+    {
+        impl->m_size = static_cast<size_t>(file_info.st_size);
+
+        if (impl->m_size == 0)
+        {
+            // Empty files cannot be mapped.
+            impl->m_is_open = true;
+        }
+        else
+        {
+            void* data = mmap(nullptr, impl->m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data != MAP_FAILED)
+            {
+                impl->m_data = static_cast<const std::uint8_t*>(data);
+                impl->m_is_open = true;
+            }
+        }
+    }
+
+    // The mapping remains valid after the file descriptor is closed.
+    close(fd);
+
+#endif
+}
+
+MemoryMappedFile::~MemoryMappedFile()
+{
+#ifdef _WIN32
+    if (impl->m_data != nullptr)
+        UnmapViewOfFile(impl->m_data);
+    if (impl->m_mapping != nullptr)
+        CloseHandle(impl->m_mapping);
+    if (impl->m_file != INVALID_HANDLE_VALUE)
+        CloseHandle(impl->m_file);
+#else
+    if (impl->m_data != nullptr)
+        munmap(const_cast<std::uint8_t*>(impl->m_data), impl->m_size);
+#endif
+
+    delete impl;
+}
+
+bool MemoryMappedFile::is_open() const
+{
+    return impl->m_is_open;
+}
+
+const std::uint8_t* MemoryMappedFile::data() const
+{
+    return impl->m_data;
+}
+
+size_t MemoryMappedFile::size() const
+{
+    return impl->m_size;
+}
+
+}   // namespace foundation
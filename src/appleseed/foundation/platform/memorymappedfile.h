@@ -0,0 +1,74 @@
+
+//
+// This source file is part of appleseed.
+// Visit https://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2019 The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+// appleseed.foundation headers.
+#include "foundation/core/concepts/noncopyable.h"
+
+// appleseed.main headers.
+#include "main/dllsymbol.h"
+
+// Standard headers.
+#include <cstddef>
+#include <cstdint>
+
+namespace foundation
+{
+
+//
+// A read-only view of the contents of a file mapped into memory.
+//
+// The mapping starts on a page boundary and is therefore suitably aligned for any type.
+//
+
+class APPLESEED_DLLSYMBOL MemoryMappedFile
+  : public NonCopyable
+{
+  public:
+    // Constructor, maps a given file into memory. Check is_open() to find out if it succeeded.
+    explicit MemoryMappedFile(const char* path);
+
+    // Destructor, unmaps the file.
+    ~MemoryMappedFile();
+
+    // Return true if the file was successfully mapped.
+    bool is_open() const;
+
+    // Return the contents of the file, or nullptr if the file is empty or not mapped.
+    const std::uint8_t* data() const;
+
+    // Return the size of the file in bytes.
+    size_t size() const;
+
+  private:
+    struct Impl;
+    Impl* impl;
+};
+
+}   // namespace foundation
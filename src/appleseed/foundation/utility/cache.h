@@ -472,6 +472,10 @@ class LRUCache
     // Get an element from the cache.
     ElementType& get(const KeyType& key);
 
+    // Unload the least recently used element that can be unloaded.
+    // Return false if no element could be unloaded.
+    bool evict();
+
     // Return the size (in bytes) of this object in memory.
     size_t get_memory_size() const;
 
@@ -967,6 +971,23 @@ get(const KeyType& key)
     }
 }
 
+FOUNDATION_LRUCACHE_TEMPLATE_DEF(bool)
+evict()
+{
+    for (typename Queue::reverse_iterator i = m_queue.rbegin(); i != m_queue.rend(); ++i)
+    {
+        if (m_element_swapper.unload(i->m_key, i->m_element))
+        {
+            m_index.erase(i->m_key);
+            m_queue.erase(succ(i).base());
+            --m_queue_size;
+            return true;
+        }
+    }
+
+    return false;
+}
+
 FOUNDATION_LRUCACHE_TEMPLATE_DEF(inline size_t)
 get_memory_size() const
 {
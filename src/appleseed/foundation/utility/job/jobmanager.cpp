@@ -37,6 +37,7 @@
 #include "foundation/utility/job/workerthread.h"
 
 // Standard headers.
+#include <algorithm>
 #include <cassert>
 #include <vector>
 
@@ -102,6 +103,9 @@ void JobManager::start()
     // Create worker threads if they don't already exist.
     if (impl->m_worker_threads.empty())
     {
+        // Give each worker thread its own lane in the job queue.
+        impl->m_job_queue.set_lane_count(std::max<size_t>(impl->m_thread_count, 1));
+
         for (size_t i = 0; i < impl->m_thread_count; ++i)
         {
             impl->m_worker_threads.push_back(
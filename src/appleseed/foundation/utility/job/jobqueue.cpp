@@ -32,16 +32,18 @@
 
 // appleseed.foundation headers.
 #include "foundation/platform/thread.h"
-#include "foundation/utility/foreach.h"
-#include "foundation/utility/iterators.h"
 #include "foundation/utility/job/abortswitch.h"
 #include "foundation/utility/job/ijob.h"
 
 // Boost headers.
+#include "boost/atomic/atomic.hpp"
 #include "boost/thread/condition_variable.hpp"
 
 // Standard headers.
+#include <algorithm>
 #include <cassert>
+#include <deque>
+#include <vector>
 
 namespace foundation
 {
@@ -52,20 +54,71 @@ namespace foundation
 
 struct JobQueue::Impl
 {
+    typedef std::deque<JobInfo> JobDeque;
+
+    struct Lane
+      : public NonCopyable
+    {
+        Spinlock                    m_lock;
+        JobDeque                    m_jobs;
+    };
+
+    typedef std::vector<Lane*> LaneVector;
+
+    // The mutex and the condition variables are only used to put threads to sleep
+    // and to wake them up; lanes are protected by their own spinlock.
     mutable boost::mutex            m_mutex;
-    boost::condition_variable_any   m_event;
-    JobList                         m_scheduled_jobs;
-    JobList                         m_running_jobs;
+    boost::condition_variable_any   m_job_event;
+    boost::condition_variable_any   m_completion_event;
+    LaneVector                      m_lanes;
+    boost::atomic<size_t>           m_scheduled_job_count;
+    boost::atomic<size_t>           m_running_job_count;
+    boost::atomic<size_t>           m_total_job_count;
+    boost::atomic<size_t>           m_job_waiter_count;
+    boost::atomic<size_t>           m_completion_waiter_count;
+    boost::atomic<size_t>           m_next_lane;
+    boost::atomic<size_t>           m_steal_count;
+
+    Impl()
+      : m_scheduled_job_count(0)
+      , m_running_job_count(0)
+      , m_total_job_count(0)
+      , m_job_waiter_count(0)
+      , m_completion_waiter_count(0)
+      , m_next_lane(0)
+      , m_steal_count(0)
+    {
+        m_lanes.push_back(new Lane());
+    }
 
-    static void delete_jobs(JobList& list)
+    ~Impl()
     {
-        for (each<JobList> i = list; i; ++i)
+        for (size_t i = 0, e = m_lanes.size(); i < e; ++i)
+            delete m_lanes[i];
+    }
+
+    static void delete_jobs(JobDeque& jobs)
+    {
+        for (size_t i = 0, e = jobs.size(); i < e; ++i)
         {
-            if (i->m_owned)
-                delete i->m_job;
+            if (jobs[i].m_owned)
+                delete jobs[i].m_job;
         }
 
-        list.clear();
+        jobs.clear();
+    }
+
+    // Wake up threads waiting on a given event, if any. The state change these threads
+    // are waiting for must have been made visible before calling this method.
+    void notify(
+        boost::condition_variable_any&  event,
+        const boost::atomic<size_t>&    waiter_count)
+    {
+        if (waiter_count > 0)
+        {
+            boost::mutex::scoped_lock lock(m_mutex);
+            event.notify_all();
+        }
     }
 };
 
@@ -79,142 +132,258 @@ JobQueue::~JobQueue()
     // We assume that worker threads are not running, so we don't lock.
 
     // At this point, no job must be running.
-    assert(impl->m_running_jobs.empty());
+    assert(impl->m_running_job_count == 0);
 
     // Delete all scheduled jobs that the queue owns.
-    Impl::delete_jobs(impl->m_scheduled_jobs);
+    for (size_t i = 0, e = impl->m_lanes.size(); i < e; ++i)
+        Impl::delete_jobs(impl->m_lanes[i]->m_jobs);
 
     delete impl;
 }
 
 void JobQueue::clear_scheduled_jobs()
 {
-    boost::mutex::scoped_lock lock(impl->m_mutex);
+    for (size_t i = 0, e = impl->m_lanes.size(); i < e; ++i)
+    {
+        Impl::Lane& lane = *impl->m_lanes[i];
 
-    impl->delete_jobs(impl->m_scheduled_jobs);
+        // Detach the scheduled jobs of this lane, then delete them outside of the lock.
+        Impl::JobDeque jobs;
+        {
+            Spinlock::ScopedLock lock(lane.m_lock);
+            jobs.swap(lane.m_jobs);
+        }
+
+        const size_t job_count = jobs.size();
+        impl->m_scheduled_job_count -= job_count;
+        Impl::delete_jobs(jobs);
+        impl->m_total_job_count -= job_count;
+    }
 
     // Notify worker threads that all scheduled jobs are gone.
-    impl->m_event.notify_all();
+    boost::mutex::scoped_lock lock(impl->m_mutex);
+    impl->m_job_event.notify_all();
+    impl->m_completion_event.notify_all();
 }
 
 bool JobQueue::has_scheduled_jobs() const
 {
-    boost::mutex::scoped_lock lock(impl->m_mutex);
-
-    return !impl->m_scheduled_jobs.empty();
+    return impl->m_scheduled_job_count > 0;
 }
 
 bool JobQueue::has_running_jobs() const
 {
-    boost::mutex::scoped_lock lock(impl->m_mutex);
-
-    return !impl->m_running_jobs.empty();
+    return impl->m_running_job_count > 0;
 }
 
 bool JobQueue::has_scheduled_or_running_jobs() const
 {
-    boost::mutex::scoped_lock lock(impl->m_mutex);
-
-    return !impl->m_scheduled_jobs.empty() || !impl->m_running_jobs.empty();
+    return get_total_job_count() > 0;
 }
 
 size_t JobQueue::get_scheduled_job_count() const
 {
-    boost::mutex::scoped_lock lock(impl->m_mutex);
-
-    return impl->m_scheduled_jobs.size();
+    return impl->m_scheduled_job_count;
 }
 
 size_t JobQueue::get_running_job_count() const
 {
-    boost::mutex::scoped_lock lock(impl->m_mutex);
-
-    return impl->m_running_jobs.size();
+    return impl->m_running_job_count;
 }
 
 size_t JobQueue::get_total_job_count() const
 {
-    boost::mutex::scoped_lock lock(impl->m_mutex);
-
-    return impl->m_scheduled_jobs.size() + impl->m_running_jobs.size();
+    // The total job count is maintained separately since reading the scheduled
+    // and running job counts one after the other could miss a job in transit.
+    return impl->m_total_job_count;
 }
 
 void JobQueue::schedule(IJob* job, const bool transfer_ownership)
 {
     assert(job);
 
-    boost::mutex::scoped_lock lock(impl->m_mutex);
+    // Distribute jobs over lanes in a round-robin fashion.
+    const size_t lane_index = impl->m_next_lane++ % impl->m_lanes.size();
+    Impl::Lane& lane = *impl->m_lanes[lane_index];
 
-    impl->m_scheduled_jobs.push_back(JobInfo(job, transfer_ownership));
+    // Account for the job before it becomes visible to worker threads.
+    ++impl->m_total_job_count;
+    ++impl->m_scheduled_job_count;
+
+    {
+        Spinlock::ScopedLock lock(lane.m_lock);
+        lane.m_jobs.push_back(JobInfo(job, transfer_ownership));
+    }
 
     // Notify worker threads that a new scheduled job is available.
-    impl->m_event.notify_all();
+    impl->notify(impl->m_job_event, impl->m_job_waiter_count);
 }
 
 void JobQueue::wait_until_completion()
 {
     boost::mutex::scoped_lock lock(impl->m_mutex);
 
+    ++impl->m_completion_waiter_count;
+
     // Wait until there is no more scheduled or running jobs.
-    while (!impl->m_scheduled_jobs.empty() || !impl->m_running_jobs.empty())
-        impl->m_event.wait(lock);
+    while (get_total_job_count() > 0)
+        impl->m_completion_event.wait(lock);
+
+    --impl->m_completion_waiter_count;
 }
 
-JobQueue::RunningJobInfo JobQueue::acquire_scheduled_job()
+void JobQueue::set_lane_count(const size_t lane_count)
 {
-    boost::mutex::scoped_lock lock(impl->m_mutex);
+    assert(lane_count > 0);
+    assert(impl->m_running_job_count == 0);
+
+    if (lane_count == impl->m_lanes.size())
+        return;
 
-    return acquire_scheduled_job_no_lock();
+    // Collect scheduled jobs in scheduling order.
+    std::vector<Impl::JobDeque> old_jobs(impl->m_lanes.size());
+    size_t job_count = 0;
+    for (size_t i = 0, e = impl->m_lanes.size(); i < e; ++i)
+    {
+        old_jobs[i].swap(impl->m_lanes[i]->m_jobs);
+        job_count += old_jobs[i].size();
+        delete impl->m_lanes[i];
+    }
+
+    // Create the new lanes.
+    impl->m_lanes.resize(lane_count);
+    for (size_t i = 0; i < lane_count; ++i)
+        impl->m_lanes[i] = new Impl::Lane();
+
+    // Redistribute scheduled jobs. Jobs were scheduled round-robin starting at lane 0,
+    // so interleaving the old lanes restores the original scheduling order.
+    size_t next_lane = 0;
+    for (size_t j = 0; job_count > 0; ++j)
+    {
+        for (size_t i = 0, e = old_jobs.size(); i < e; ++i)
+        {
+            if (j < old_jobs[i].size())
+            {
+                impl->m_lanes[next_lane++ % lane_count]->m_jobs.push_back(old_jobs[i][j]);
+                --job_count;
+            }
+        }
+    }
+
+    impl->m_next_lane = next_lane;
 }
 
-JobQueue::RunningJobInfo JobQueue::acquire_scheduled_job_no_lock()
+size_t JobQueue::get_lane_count() const
 {
-    // Bail out if there is no scheduled job.
-    if (impl->m_scheduled_jobs.empty())
-        return RunningJobInfo(JobInfo(nullptr, false), impl->m_running_jobs.end());
-
-    // Move the next scheduled job to the end of the queue of running jobs.
-    const JobInfo job_info = impl->m_scheduled_jobs.front();
-    impl->m_scheduled_jobs.pop_front();
-    impl->m_running_jobs.push_back(job_info);
+    return impl->m_lanes.size();
+}
 
-    // Notify worker threads that a job has moved from the scheduled to the running state.
-    impl->m_event.notify_all();
+size_t JobQueue::get_steal_count() const
+{
+    return impl->m_steal_count;
+}
 
-    return RunningJobInfo(job_info, pred(impl->m_running_jobs.end()));
+void JobQueue::clear_statistics()
+{
+    impl->m_steal_count = 0;
 }
 
-JobQueue::RunningJobInfo JobQueue::wait_for_scheduled_job(AbortSwitch& abort_switch)
+JobQueue::RunningJobInfo JobQueue::acquire_scheduled_job(const size_t lane_index)
 {
-    boost::mutex::scoped_lock lock(impl->m_mutex);
+    const size_t lane_count = impl->m_lanes.size();
+    const size_t own_lane = lane_index % lane_count;
+
+    // Bail out early if there is no scheduled job.
+    if (impl->m_scheduled_job_count == 0)
+        return RunningJobInfo(JobInfo(nullptr, false), own_lane);
 
-    // Wait for a scheduled job to be available.
-    while (!abort_switch.is_aborted() && impl->m_scheduled_jobs.empty())    // order matters
-        impl->m_event.wait(lock);
+    // Visit our own lane first, then the other lanes in order of increasing distance:
+    // own_lane, own_lane + 1, own_lane - 1, own_lane + 2, own_lane - 2, etc.
+    for (size_t i = 0; i < lane_count; ++i)
+    {
+        const size_t offset = (i + 1) / 2;
+        const size_t victim =
+            (i & 1) != 0
+                ? (own_lane + offset) % lane_count
+                : (own_lane + lane_count - offset) % lane_count;
+
+        Impl::Lane& lane = *impl->m_lanes[victim];
+
+        IJob* job;
+        bool owned;
+
+        {
+            Spinlock::ScopedLock lock(lane.m_lock);
 
-    return acquire_scheduled_job_no_lock();
+            if (lane.m_jobs.empty())
+                continue;
+
+            // Take the oldest job from our own lane, and the newest job from other lanes
+            // to stay away from the end of the lane used by its owner.
+            const JobInfo& job_info = i == 0 ? lane.m_jobs.front() : lane.m_jobs.back();
+            job = job_info.m_job;
+            owned = job_info.m_owned;
+
+            if (i == 0)
+                lane.m_jobs.pop_front();
+            else lane.m_jobs.pop_back();
+        }
+
+        // Move the job from the scheduled to the running state.
+        ++impl->m_running_job_count;
+        --impl->m_scheduled_job_count;
+
+        if (i > 0)
+            ++impl->m_steal_count;
+
+        return RunningJobInfo(JobInfo(job, owned), victim);
+    }
+
+    return RunningJobInfo(JobInfo(nullptr, false), own_lane);
 }
 
-void JobQueue::retire_running_job(const RunningJobInfo& running_job_info)
+JobQueue::RunningJobInfo JobQueue::wait_for_scheduled_job(
+    AbortSwitch&    abort_switch,
+    const size_t    lane_index)
 {
-    boost::mutex::scoped_lock lock(impl->m_mutex);
+    while (true)
+    {
+        const RunningJobInfo running_job_info = acquire_scheduled_job(lane_index);
+
+        if (running_job_info.first.m_job != nullptr || abort_switch.is_aborted())
+            return running_job_info;
+
+        boost::mutex::scoped_lock lock(impl->m_mutex);
+
+        ++impl->m_job_waiter_count;
+
+        // Wait for a scheduled job to be available.
+        while (!abort_switch.is_aborted() && impl->m_scheduled_job_count == 0)   // order matters
+            impl->m_job_event.wait(lock);
 
-    // Remove the job from the running list.
-    impl->m_running_jobs.erase(running_job_info.second);
+        --impl->m_job_waiter_count;
+    }
+}
 
-    // Delete the job.
+void JobQueue::retire_running_job(const RunningJobInfo& running_job_info)
+{
+    // Delete the job before it stops being counted, such that wait_until_completion()
+    // only returns once all owned jobs are destructed.
     if (running_job_info.first.m_owned)
         delete running_job_info.first.m_job;
 
-    // Notify worker threads that a scheduled job was retired.
-    impl->m_event.notify_all();
+    --impl->m_running_job_count;
+
+    // Notify waiting threads if this was the last job.
+    if (--impl->m_total_job_count == 0)
+        impl->notify(impl->m_completion_event, impl->m_completion_waiter_count);
 }
 
 void JobQueue::signal_event()
 {
     boost::mutex::scoped_lock lock(impl->m_mutex);
 
-    impl->m_event.notify_all();
+    impl->m_job_event.notify_all();
 }
 
 }   // namespace foundation
@@ -31,7 +31,6 @@
 
 // appleseed.foundation headers.
 #include "foundation/core/concepts/noncopyable.h"
-#include "foundation/memory/poolallocator.h"
 #include "foundation/utility/test.h"
 
 // appleseed.main headers.
@@ -39,7 +38,6 @@
 
 // Standard headers.
 #include <cstddef>
-#include <list>
 #include <utility>
 
 // Forward declarations.
@@ -52,6 +50,8 @@ DECLARE_TEST_CASE(Foundation_Utility_Job_JobQueue, AcquireScheduledJobWorksOnNon
 DECLARE_TEST_CASE(Foundation_Utility_Job_JobQueue, RetiringRunningJobWorks);
 DECLARE_TEST_CASE(Foundation_Utility_Job_JobQueue, RunningJobOwnedByQueueIsDestructedWhenRetired);
 DECLARE_TEST_CASE(Foundation_Utility_Job_JobQueue, RunningJobNotOwnedByQueueIsNotDestructedWhenRetired);
+DECLARE_TEST_CASE(Foundation_Utility_Job_JobQueue, AcquireScheduledJobStealsFromOtherLanes);
+DECLARE_TEST_CASE(Foundation_Utility_Job_JobQueue, SetLaneCountPreservesScheduledJobs);
 
 namespace foundation
 {
@@ -66,6 +66,14 @@ namespace foundation
 //   - scheduled: the job was inserted into the job queue, but hasn't yet been executed
 //   - running: the job is currently being executed
 //
+// Scheduled jobs are spread over a number of lanes, one per worker thread.
+// Each lane is protected by its own lock: a worker thread first takes jobs
+// from its own lane and only steals jobs from other lanes when its own lane
+// is empty. Victims are visited in order of increasing distance from the
+// worker's own lane, such that neighboring workers (which tend to share
+// caches and memory nodes) are tried first. A queue that is not bound to
+// a job manager has a single lane.
+//
 
 class APPLESEED_DLLSYMBOL JobQueue
   : public NonCopyable
@@ -105,6 +113,20 @@ class APPLESEED_DLLSYMBOL JobQueue
     // Wait until all scheduled and running jobs are completed.
     void wait_until_completion();
 
+    // Set the number of lanes. Scheduled jobs are redistributed among the new lanes.
+    // Not thread-safe: must only be called while no worker thread is running.
+    void set_lane_count(const size_t lane_count);
+
+    // Return the number of lanes.
+    size_t get_lane_count() const;
+
+    // Return the number of jobs that were stolen from another lane since the
+    // creation of the queue or the last call to clear_statistics().
+    size_t get_steal_count() const;
+
+    // Reset the steal counter.
+    void clear_statistics();
+
   private:
     friend class WorkerThread;
 
@@ -116,6 +138,8 @@ class APPLESEED_DLLSYMBOL JobQueue
     GRANT_ACCESS_TO_TEST_CASE(Foundation_Utility_Job_JobQueue, RetiringRunningJobWorks);
     GRANT_ACCESS_TO_TEST_CASE(Foundation_Utility_Job_JobQueue, RunningJobOwnedByQueueIsDestructedWhenRetired);
     GRANT_ACCESS_TO_TEST_CASE(Foundation_Utility_Job_JobQueue, RunningJobNotOwnedByQueueIsNotDestructedWhenRetired);
+    GRANT_ACCESS_TO_TEST_CASE(Foundation_Utility_Job_JobQueue, AcquireScheduledJobStealsFromOtherLanes);
+    GRANT_ACCESS_TO_TEST_CASE(Foundation_Utility_Job_JobQueue, SetLaneCountPreservesScheduledJobs);
 
     struct JobInfo
     {
@@ -129,18 +153,18 @@ class APPLESEED_DLLSYMBOL JobQueue
         }
     };
 
-    typedef std::list<JobInfo, PoolAllocator<JobInfo, 64>> JobList;
-
-    typedef std::pair<JobInfo, JobList::iterator> RunningJobInfo;
+    // A running job and the index of the lane it was acquired from.
+    typedef std::pair<JobInfo, size_t> RunningJobInfo;
 
     // Acquire a scheduled job and change its state from 'scheduled' to 'running'.
-    RunningJobInfo acquire_scheduled_job();
-
-    // Acquire a scheduled job without any locking.
-    RunningJobInfo acquire_scheduled_job_no_lock();
+    // The job is taken from the given lane if possible, otherwise it is stolen
+    // from another lane.
+    RunningJobInfo acquire_scheduled_job(const size_t lane_index = 0);
 
     // Wait for a scheduled job to be available.
-    RunningJobInfo wait_for_scheduled_job(AbortSwitch& abort_switch);
+    RunningJobInfo wait_for_scheduled_job(
+        AbortSwitch&    abort_switch,
+        const size_t    lane_index);
 
     // Retire a running job. The job is deleted if it is owned by the queue.
     void retire_running_job(const RunningJobInfo& running_job_info);
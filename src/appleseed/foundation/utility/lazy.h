@@ -98,6 +98,10 @@ class Lazy
     // Return the source object associated with that lazy object, if any.
     ObjectType* get_source_object() const;
 
+    // Return the object if it was already constructed, nullptr otherwise.
+    // This method is not thread-safe with respect to concurrent object construction.
+    ObjectType* get_constructed_object() const;
+
   private:
     template <typename> friend class Access;
 
@@ -386,6 +390,12 @@ inline typename Lazy<Object>::ObjectType* Lazy<Object>::get_source_object() cons
     return m_source_object;
 }
 
+template <typename Object>
+inline typename Lazy<Object>::ObjectType* Lazy<Object>::get_constructed_object() const
+{
+    return m_object;
+}
+
 
 //
 // Access class implementation.
@@ -59,6 +59,7 @@
 #include "foundation/utility/foreach.h"
 #include "foundation/utility/lazy.h"
 #include "foundation/utility/statistics.h"
+#include "foundation/utility/stopwatch.h"
 
 // Standard headers.
 #include <algorithm>
@@ -80,6 +81,8 @@ namespace renderer
 AssemblyTree::AssemblyTree(const Scene& scene)
   : TreeType(AlignedAllocator<void>(System::get_l1_data_cache_line_size()))
   , m_scene(scene)
+  , m_build_sah_cost(0.0)
+  , m_tree_build_thread_count(System::get_logical_cpu_core_count())
 #ifdef APPLESEED_WITH_EMBREE
   , m_use_embree(false)
   , m_dirty(false)
@@ -94,7 +97,9 @@ AssemblyTree::~AssemblyTree()
 
 void AssemblyTree::update()
 {
-    rebuild_assembly_tree();
+    if (!refit_assembly_tree())
+        rebuild_assembly_tree();
+
     update_tree_hierarchy();
 }
 
@@ -111,7 +116,8 @@ size_t AssemblyTree::get_memory_size() const
 void AssemblyTree::collect_assembly_instances(
     const AssemblyInstanceContainer&    assembly_instances,
     const TransformSequence&            parent_transform_seq,
-    AABBVector&                         assembly_instance_bboxes)
+    ItemVector&                         items,
+    AABBVector&                         assembly_instance_bboxes) const
 {
     for (const_each<AssemblyInstanceContainer> i = assembly_instances; i; ++i)
     {
@@ -130,6 +136,7 @@ void AssemblyTree::collect_assembly_instances(
         collect_assembly_instances(
             assembly.assembly_instances(),
             cumulated_transform_seq,
+            items,
             assembly_instance_bboxes);
 
         // Skip empty assemblies.
@@ -137,7 +144,7 @@ void AssemblyTree::collect_assembly_instances(
             continue;
 
         // Create and store an item for this assembly instance.
-        m_items.emplace_back(
+        items.emplace_back(
             &assembly,
             &assembly_instance,
             cumulated_transform_seq);
@@ -156,6 +163,8 @@ void AssemblyTree::rebuild_assembly_tree()
     // Clear the current tree.
     clear();
     m_items.clear();
+    m_item_ordering.clear();
+    m_item_instance_uids.clear();
 
     Statistics statistics;
 
@@ -165,6 +174,7 @@ void AssemblyTree::rebuild_assembly_tree()
     collect_assembly_instances(
         m_scene.assembly_instances(),
         TransformSequence(),
+        m_items,
         assembly_instance_bboxes);
 
     RENDERER_LOG_INFO(
@@ -202,6 +212,25 @@ void AssemblyTree::rebuild_assembly_tree()
 
         // Store the items in the tree leaves whenever possible.
         store_items_in_leaves(statistics);
+
+        // Remember where items come from and the quality of the tree, to allow refitting it.
+        m_item_ordering = ordering;
+        m_item_instance_uids.reserve(m_items.size());
+        for (const_each<ItemVector> i = m_items; i; ++i)
+            m_item_instance_uids.push_back(i->m_assembly_instance->get_uid());
+
+        AABB3d root_bbox;
+        root_bbox.invalidate();
+        for (const_each<AABBVector> i = assembly_instance_bboxes; i; ++i)
+            root_bbox.insert(*i);
+
+        bvh::Refitter<AssemblyTree> refitter;
+        m_build_sah_cost =
+            refitter.compute_sah_cost(
+                *this,
+                root_bbox,
+                AssemblyTreeInteriorNodeTraversalCost,
+                AssemblyTreeTriangleIntersectionCost);
     }
 
     // Print assembly tree statistics.
@@ -211,6 +240,79 @@ void AssemblyTree::rebuild_assembly_tree()
             statistics).to_string().c_str());
 }
 
+bool AssemblyTree::refit_assembly_tree()
+{
+    // Nothing to refit if the tree is empty.
+    if (m_items.empty())
+        return false;
+
+    Stopwatch<DefaultWallclockTimer> stopwatch;
+    stopwatch.start();
+
+    // Collect assembly instances and their bounding boxes.
+    ItemVector items;
+    AABBVector assembly_instance_bboxes;
+    collect_assembly_instances(
+        m_scene.assembly_instances(),
+        TransformSequence(),
+        items,
+        assembly_instance_bboxes);
+
+    // The topology of the tree changed if assembly instances were added, removed or reordered.
+    if (items.size() != m_items.size())
+        return false;
+
+    for (size_t i = 0, e = m_items.size(); i < e; ++i)
+    {
+        const Item& item = items[m_item_ordering[i]];
+
+        if (item.m_assembly_instance->get_uid() != m_item_instance_uids[i] ||
+            item.m_assembly_uid != m_items[i].m_assembly_uid)
+            return false;
+    }
+
+    // Recompute the bounding boxes of the nodes.
+    bvh::Refitter<AssemblyTree> refitter;
+    const AABB3d root_bbox =
+        refitter.refit(
+            *this,
+            [&](const NodeType& node)
+            {
+                AABB3d leaf_bbox;
+                leaf_bbox.invalidate();
+
+                for (size_t i = 0, e = node.get_item_count(); i < e; ++i)
+                    leaf_bbox.insert(assembly_instance_bboxes[m_item_ordering[node.get_item_index() + i]]);
+
+                return leaf_bbox;
+            });
+
+    // Rebuild the tree if its quality degraded too much.
+    const double sah_cost =
+        refitter.compute_sah_cost(
+            *this,
+            root_bbox,
+            AssemblyTreeInteriorNodeTraversalCost,
+            AssemblyTreeTriangleIntersectionCost);
+    if (sah_cost > m_build_sah_cost * AssemblyTreeMaxRefitCostRatio)
+        return false;
+
+    // Store the items with their new transforms, in tree order.
+    for (size_t i = 0, e = m_items.size(); i < e; ++i)
+        m_items[i] = items[m_item_ordering[i]];
+
+    Statistics statistics;
+    store_items_in_leaves(statistics);
+
+    RENDERER_LOG_INFO(
+        "refitted assembly tree (%s %s) in %s.",
+        pretty_int(m_items.size()).c_str(),
+        plural(m_items.size(), "assembly instance").c_str(),
+        pretty_time(stopwatch.measure().get_seconds()).c_str());
+
+    return true;
+}
+
 void AssemblyTree::store_items_in_leaves(Statistics& statistics)
 {
     size_t leaf_count = 0;
@@ -278,7 +380,14 @@ void AssemblyTree::update_tree_hierarchy()
                 continue;
             }
 
-            // The child trees of this assembly are out-of-date: delete them.
+            // The child trees of this assembly are out-of-date: refit them if their
+            // topology didn't change, otherwise delete them.
+            if (refit_child_trees(assembly))
+            {
+                m_assembly_versions[assembly.get_uid()] = current_version_id;
+                continue;
+            }
+
             delete_child_trees(assembly.get_uid());
         }
 
@@ -391,6 +500,59 @@ void AssemblyTree::create_child_trees(const Assembly& assembly)
     }
 }
 
+namespace
+{
+    struct RefitTriangleTree
+    {
+        const GAABB3 m_bbox;
+
+        explicit RefitTriangleTree(const GAABB3& bbox)
+          : m_bbox(bbox)
+        {
+        }
+
+        bool operator()(TriangleTree& tree) const
+        {
+            return tree.refit(m_bbox);
+        }
+    };
+}
+
+bool AssemblyTree::refit_child_trees(const Assembly& assembly)
+{
+#ifdef APPLESEED_WITH_EMBREE
+    if (use_embree() || m_dirty)
+        return false;
+#endif
+
+    // Only triangle trees can be refitted; curve trees are always rebuilt.
+    if (m_curve_trees.find(assembly.get_uid()) != m_curve_trees.end() ||
+        has_object_instances_of_type(assembly, CurveObjectFactory().get_model()))
+        return false;
+
+    const TriangleTreeContainer::iterator triangle_tree_it =
+        m_triangle_trees.find(assembly.get_uid());
+
+    if (triangle_tree_it == m_triangle_trees.end() ||
+        !has_object_instances_of_type(assembly, MeshObjectFactory().get_model()))
+        return false;
+
+    // Compute the assembly space bounding box of the assembly.
+    const GAABB3 assembly_bbox =
+        compute_parent_bbox<GAABB3>(
+            assembly.object_instances().begin(),
+            assembly.object_instances().end());
+
+    const std::uint64_t hash = hash_assembly_geometry(assembly, MeshObjectFactory().get_model());
+    RefitTriangleTree refit_triangle_tree(assembly_bbox);
+
+    return
+        m_triangle_tree_repository.update(
+            triangle_tree_it->second,
+            hash,
+            refit_triangle_tree);
+}
+
 void AssemblyTree::create_triangle_tree(const Assembly& assembly)
 {
     const std::uint64_t hash = hash_assembly_geometry(assembly, MeshObjectFactory().get_model());
@@ -410,7 +572,9 @@ void AssemblyTree::create_triangle_tree(const Assembly& assembly)
                     m_scene,
                     assembly.get_uid(),
                     assembly_bbox,
-                    assembly)));
+                    assembly,
+                    m_tree_cache_directory,
+                    m_tree_build_thread_count)));
 
         tree = new Lazy<TriangleTree>(std::move(triangle_tree_factory));
         m_triangle_tree_repository.insert(hash, tree);
@@ -438,7 +602,8 @@ void AssemblyTree::create_curve_tree(const Assembly& assembly)
                     m_scene,
                     assembly.get_uid(),
                     assembly_bbox,
-                    assembly)));
+                    assembly,
+                    m_tree_cache_directory)));
 
         tree = new Lazy<CurveTree>(std::move(curve_tree_factory));
         m_curve_tree_repository.insert(hash, tree);
@@ -447,6 +612,26 @@ void AssemblyTree::create_curve_tree(const Assembly& assembly)
     m_curve_trees.insert(std::make_pair(assembly.get_uid(), tree));
 }
 
+const std::string& AssemblyTree::get_tree_cache_directory() const
+{
+    return m_tree_cache_directory;
+}
+
+void AssemblyTree::set_tree_cache_directory(const std::string& path)
+{
+    m_tree_cache_directory = path;
+}
+
+size_t AssemblyTree::get_tree_build_thread_count() const
+{
+    return m_tree_build_thread_count;
+}
+
+void AssemblyTree::set_tree_build_thread_count(const size_t thread_count)
+{
+    m_tree_build_thread_count = thread_count;
+}
+
 #ifdef APPLESEED_WITH_EMBREE
 
 bool AssemblyTree::use_embree() const
@@ -684,6 +869,20 @@ bool AssemblyLeafVisitor::visit(
                         visitor
 #ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
                         , m_triangle_tree_stats
+#endif
+                        );
+                }
+                else if (triangle_tree->has_wide_tree())
+                {
+                    TriangleTreeWideIntersector wide_intersector;
+                    wide_intersector.intersect_no_motion(
+                        *triangle_tree,
+                        triangle_tree->get_wide_tree(),
+                        asm_inst_shading_point.m_ray,
+                        asm_inst_ray_info,
+                        visitor
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+                        , m_triangle_tree_stats
 #endif
                         );
                 }
@@ -926,6 +1125,20 @@ bool AssemblyLeafProbeVisitor::visit(
                         visitor
 #ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
                         , m_triangle_tree_stats
+#endif
+                        );
+                }
+                else if (triangle_tree->has_wide_tree())
+                {
+                    TriangleTreeWideProbeIntersector wide_intersector;
+                    wide_intersector.intersect_no_motion(
+                        *triangle_tree,
+                        triangle_tree->get_wide_tree(),
+                        asm_inst_ray,
+                        asm_inst_ray_info,
+                        visitor
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+                        , m_triangle_tree_stats
 #endif
                         );
                 }
@@ -1053,4 +1266,116 @@ bool AssemblyLeafProbeVisitor::visit(
     return true;
 }
 
+
+//
+// AssemblyLeafPacketVisitor class implementation.
+//
+
+bool AssemblyLeafPacketVisitor::visit(
+    const AssemblyTree::NodeType&       node,
+    const ShadingRay                    rays[],
+    const ShadingRay::RayInfoType       ray_infos[],
+    bvh::PacketMask&                    mask,
+    double                              distances[]
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+    , bvh::TraversalStatistics&         stats
+#endif
+    )
+{
+    for (size_t i = 0; i < bvh::MaxPacketSize; ++i)
+    {
+        if ((mask & (bvh::PacketMask(1) << i)) == 0)
+            continue;
+
+        // The single ray visitor is stateless: all its results go to the shading point.
+        AssemblyLeafVisitor visitor(
+            m_shading_points[i],
+            m_tree,
+            m_triangle_tree_cache,
+            m_curve_tree_cache,
+#ifdef APPLESEED_WITH_EMBREE
+            m_embree_scene_cache,
+#endif
+            m_parent_shading_point
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+            , m_triangle_tree_stats
+            , m_curve_tree_stats
+#endif
+            );
+
+        // Trace the ray of the shading point, whose far distance shrinks as hits are found.
+        visitor.visit(
+            node,
+            m_shading_points[i].m_ray,
+            ray_infos[i],
+            distances[i]
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+            , stats
+#endif
+            );
+    }
+
+    // Continue traversal.
+    return true;
+}
+
+
+//
+// AssemblyLeafPacketProbeVisitor class implementation.
+//
+
+bool AssemblyLeafPacketProbeVisitor::visit(
+    const AssemblyTree::NodeType&       node,
+    const ShadingRay                    rays[],
+    const ShadingRay::RayInfoType       ray_infos[],
+    bvh::PacketMask&                    mask,
+    double                              distances[]
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+    , bvh::TraversalStatistics&         stats
+#endif
+    )
+{
+    for (size_t i = 0; i < bvh::MaxPacketSize; ++i)
+    {
+        const bvh::PacketMask ray_bit = bvh::PacketMask(1) << i;
+
+        if ((mask & ray_bit) == 0)
+            continue;
+
+        AssemblyLeafProbeVisitor visitor(
+            m_tree,
+            m_triangle_tree_cache,
+            m_curve_tree_cache,
+#ifdef APPLESEED_WITH_EMBREE
+            m_embree_scene_cache,
+#endif
+            m_parent_shading_point
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+            , m_triangle_tree_stats
+            , m_curve_tree_stats
+#endif
+            );
+
+        visitor.visit(
+            node,
+            rays[i],
+            ray_infos[i],
+            distances[i]
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+            , stats
+#endif
+            );
+
+        // Occluded rays need not be traced any further.
+        if (visitor.hit())
+        {
+            m_hit_mask |= ray_bit;
+            mask &= ~ray_bit;
+        }
+    }
+
+    // Terminate traversal once all rays are occluded.
+    return mask != 0;
+}
+
 }   // namespace renderer
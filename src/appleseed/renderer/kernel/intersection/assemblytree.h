@@ -34,6 +34,7 @@
 #ifdef APPLESEED_WITH_EMBREE
 #include "renderer/kernel/intersection/embreescene.h"
 #endif
+#include "renderer/kernel/intersection/intersectionsettings.h"
 #include "renderer/kernel/intersection/probevisitorbase.h"
 #include "renderer/kernel/intersection/treerepository.h"
 #include "renderer/kernel/intersection/triangletree.h"
@@ -53,6 +54,7 @@
 // Standard headers.
 #include <cstddef>
 #include <map>
+#include <string>
 #include <vector>
 
 // Forward declarations.
@@ -70,9 +72,7 @@ namespace renderer
 
 class AssemblyTree
   : public foundation::bvh::Tree<
-               foundation::AlignedVector<
-                   foundation::bvh::Node<foundation::AABB3d>
-               >
+               foundation::AlignedVector<AssemblyTreeNodeType>
            >
 {
   public:
@@ -88,6 +88,15 @@ class AssemblyTree
     // Return the size (in bytes) of this object in memory.
     size_t get_memory_size() const;
 
+    // Set the directory where triangle and curve trees are cached across renders.
+    // The tree cache is disabled if the path is empty.
+    const std::string& get_tree_cache_directory() const;
+    void set_tree_cache_directory(const std::string& path);
+
+    // Set the number of threads used to build triangle trees.
+    size_t get_tree_build_thread_count() const;
+    void set_tree_build_thread_count(const size_t thread_count);
+
 #ifdef APPLESEED_WITH_EMBREE
 
     bool use_embree() const;
@@ -125,11 +134,18 @@ class AssemblyTree
     typedef std::vector<foundation::AABB3d> AABBVector;
     typedef std::vector<const Assembly*> AssemblyVector;
     typedef std::map<foundation::UniqueID, foundation::VersionID> AssemblyVersionMap;
+    typedef std::vector<foundation::UniqueID> UniqueIDVector;
 
     const Scene&                    m_scene;
     ItemVector                      m_items;
+    std::vector<size_t>             m_item_ordering;        // index of each item in collection order
+    UniqueIDVector                  m_item_instance_uids;   // assembly instance UID of each item
+    double                          m_build_sah_cost;
     AssemblyVersionMap              m_assembly_versions;
 
+    std::string                     m_tree_cache_directory;
+    size_t                          m_tree_build_thread_count;
+
     TreeRepository<TriangleTree>    m_triangle_tree_repository;
     TriangleTreeContainer           m_triangle_trees;
 
@@ -148,9 +164,11 @@ class AssemblyTree
     void collect_assembly_instances(
         const AssemblyInstanceContainer&        assembly_instances,
         const TransformSequence&                parent_transform_seq,
-        AABBVector&                             assembly_instance_bboxes);
+        ItemVector&                             items,
+        AABBVector&                             assembly_instance_bboxes) const;
 
     void rebuild_assembly_tree();
+    bool refit_assembly_tree();
     void store_items_in_leaves(foundation::Statistics& statistics);
 
     void update_tree_hierarchy();
@@ -158,6 +176,7 @@ class AssemblyTree
     void delete_unused_child_trees(const AssemblyVector& assemblies);
 
     void create_child_trees(const Assembly& assembly);
+    bool refit_child_trees(const Assembly& assembly);
     void create_triangle_tree(const Assembly& assembly);
     void create_curve_tree(const Assembly& assembly);
 
@@ -276,6 +295,108 @@ class AssemblyLeafProbeVisitor
 #endif
 };
 
+//
+// Assembly leaf visitors for packets of rays. Packets are culled as a whole
+// against the assembly tree; the assemblies found in a leaf are then visited
+// one ray at a time by the single ray visitors above.
+//
+
+class AssemblyLeafPacketVisitor
+  : public foundation::NonCopyable
+{
+  public:
+    // Constructor.
+    AssemblyLeafPacketVisitor(
+        ShadingPoint                                shading_points[],
+        const AssemblyTree&                         tree,
+        TriangleTreeAccessCache&                    triangle_tree_cache,
+        CurveTreeAccessCache&                       curve_tree_cache,
+#ifdef APPLESEED_WITH_EMBREE
+        EmbreeSceneAccessCache&                     embree_scene_cache,
+#endif
+        const ShadingPoint*                         parent_shading_point
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+        , foundation::bvh::TraversalStatistics&     triangle_tree_stats
+        , foundation::bvh::TraversalStatistics&     curve_tree_stats
+#endif
+        );
+
+    // Visit a leaf.
+    bool visit(
+        const AssemblyTree::NodeType&               node,
+        const ShadingRay                            rays[],
+        const ShadingRay::RayInfoType               ray_infos[],
+        foundation::bvh::PacketMask&                mask,
+        double                                      distances[]
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+        , foundation::bvh::TraversalStatistics&     stats
+#endif
+        );
+
+  private:
+    ShadingPoint*                                   m_shading_points;
+    const AssemblyTree&                             m_tree;
+    TriangleTreeAccessCache&                        m_triangle_tree_cache;
+    CurveTreeAccessCache&                           m_curve_tree_cache;
+#ifdef APPLESEED_WITH_EMBREE
+    EmbreeSceneAccessCache&                         m_embree_scene_cache;
+#endif
+    const ShadingPoint*                             m_parent_shading_point;
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+    foundation::bvh::TraversalStatistics&           m_triangle_tree_stats;
+    foundation::bvh::TraversalStatistics&           m_curve_tree_stats;
+#endif
+};
+
+class AssemblyLeafPacketProbeVisitor
+  : public foundation::NonCopyable
+{
+  public:
+    // Constructor.
+    AssemblyLeafPacketProbeVisitor(
+        const AssemblyTree&                         tree,
+        TriangleTreeAccessCache&                    triangle_tree_cache,
+        CurveTreeAccessCache&                       curve_tree_cache,
+#ifdef APPLESEED_WITH_EMBREE
+        EmbreeSceneAccessCache&                     embree_scene_cache,
+#endif
+        const ShadingPoint*                         parent_shading_point
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+        , foundation::bvh::TraversalStatistics&     triangle_tree_stats
+        , foundation::bvh::TraversalStatistics&     curve_tree_stats
+#endif
+        );
+
+    // Return the mask of the rays that hit something.
+    foundation::bvh::PacketMask get_hit_mask() const;
+
+    // Visit a leaf.
+    bool visit(
+        const AssemblyTree::NodeType&               node,
+        const ShadingRay                            rays[],
+        const ShadingRay::RayInfoType               ray_infos[],
+        foundation::bvh::PacketMask&                mask,
+        double                                      distances[]
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+        , foundation::bvh::TraversalStatistics&     stats
+#endif
+        );
+
+  private:
+    const AssemblyTree&                             m_tree;
+    TriangleTreeAccessCache&                        m_triangle_tree_cache;
+    CurveTreeAccessCache&                           m_curve_tree_cache;
+#ifdef APPLESEED_WITH_EMBREE
+    EmbreeSceneAccessCache&                         m_embree_scene_cache;
+#endif
+    const ShadingPoint*                             m_parent_shading_point;
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+    foundation::bvh::TraversalStatistics&           m_triangle_tree_stats;
+    foundation::bvh::TraversalStatistics&           m_curve_tree_stats;
+#endif
+    foundation::bvh::PacketMask                     m_hit_mask;
+};
+
 
 //
 // Assembly tree intersectors.
@@ -293,6 +414,18 @@ typedef foundation::bvh::Intersector<
     ShadingRay
 > AssemblyTreeProbeIntersector;
 
+typedef foundation::bvh::PacketIntersector<
+    AssemblyTree,
+    AssemblyLeafPacketVisitor,
+    ShadingRay
+> AssemblyTreePacketIntersector;
+
+typedef foundation::bvh::PacketIntersector<
+    AssemblyTree,
+    AssemblyLeafPacketProbeVisitor,
+    ShadingRay
+> AssemblyTreePacketProbeIntersector;
+
 
 //
 // AssemblyLeafVisitor class implementation.
@@ -359,4 +492,76 @@ inline AssemblyLeafProbeVisitor::AssemblyLeafProbeVisitor(
 {
 }
 
+
+//
+// AssemblyLeafPacketVisitor class implementation.
+//
+
+inline AssemblyLeafPacketVisitor::AssemblyLeafPacketVisitor(
+    ShadingPoint                                    shading_points[],
+    const AssemblyTree&                             tree,
+    TriangleTreeAccessCache&                        triangle_tree_cache,
+    CurveTreeAccessCache&                           curve_tree_cache,
+#ifdef APPLESEED_WITH_EMBREE
+    EmbreeSceneAccessCache&                         embree_scene_cache,
+#endif
+    const ShadingPoint*                             parent_shading_point
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+    , foundation::bvh::TraversalStatistics&         triangle_tree_stats
+    , foundation::bvh::TraversalStatistics&         curve_tree_stats
+#endif
+    )
+  : m_shading_points(shading_points)
+  , m_tree(tree)
+  , m_triangle_tree_cache(triangle_tree_cache)
+  , m_curve_tree_cache(curve_tree_cache)
+#ifdef APPLESEED_WITH_EMBREE
+  , m_embree_scene_cache(embree_scene_cache)
+#endif
+  , m_parent_shading_point(parent_shading_point)
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+  , m_triangle_tree_stats(triangle_tree_stats)
+  , m_curve_tree_stats(curve_tree_stats)
+#endif
+{
+}
+
+
+//
+// AssemblyLeafPacketProbeVisitor class implementation.
+//
+
+inline AssemblyLeafPacketProbeVisitor::AssemblyLeafPacketProbeVisitor(
+    const AssemblyTree&                             tree,
+    TriangleTreeAccessCache&                        triangle_tree_cache,
+    CurveTreeAccessCache&                           curve_tree_cache,
+#ifdef APPLESEED_WITH_EMBREE
+    EmbreeSceneAccessCache&                         embree_scene_cache,
+#endif
+    const ShadingPoint*                             parent_shading_point
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+    , foundation::bvh::TraversalStatistics&         triangle_tree_stats
+    , foundation::bvh::TraversalStatistics&         curve_tree_stats
+#endif
+    )
+  : m_tree(tree)
+  , m_triangle_tree_cache(triangle_tree_cache)
+  , m_curve_tree_cache(curve_tree_cache)
+#ifdef APPLESEED_WITH_EMBREE
+  , m_embree_scene_cache(embree_scene_cache)
+#endif
+  , m_parent_shading_point(parent_shading_point)
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+  , m_triangle_tree_stats(triangle_tree_stats)
+  , m_curve_tree_stats(curve_tree_stats)
+#endif
+  , m_hit_mask(0)
+{
+}
+
+inline foundation::bvh::PacketMask AssemblyLeafPacketProbeVisitor::get_hit_mask() const
+{
+    return m_hit_mask;
+}
+
 }   // namespace renderer
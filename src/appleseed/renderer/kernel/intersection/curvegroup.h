@@ -0,0 +1,219 @@
+
+//
+// This source file is part of appleseed.
+// Visit https://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2019 The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+// appleseed.renderer headers.
+#include "renderer/global/globaltypes.h"
+#include "renderer/kernel/intersection/intersectionsettings.h"
+
+// appleseed.foundation headers.
+#include "foundation/platform/compiler.h"
+#ifdef APPLESEED_USE_SSE
+#include "foundation/platform/sse.h"
+#endif
+
+// Standard headers.
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+
+namespace renderer
+{
+
+//
+// A group of up to four curves of the same degree.
+//
+// The control points and widths of the curves are stored in structure-of-arrays
+// form so that a leaf of the curve tree can reject all the curves a ray misses
+// with a single 4-wide test. This test is the one the curve intersector starts
+// with: the bounding box of the control points, in the ray space defined by
+// make_curve_projection_transform(), must overlap the footprint of the ray.
+// Curves that fail it are guaranteed to be missed by the intersector.
+//
+
+template <typename CurveType>
+class APPLESEED_SIMD4_ALIGN CurveGroup
+{
+  public:
+    static const size_t MaxCurveCount = 4;
+
+    // Store up to MaxCurveCount curves.
+    void set(const CurveType* curves, const size_t count);
+
+    // Return a mask in which bit i is set if the i'th curve may be hit before tmax,
+    // expressed as a distance along the normalized ray direction.
+    std::uint32_t cull(
+        const CurveMatrixType&  xfm,
+        const GScalar           tmax) const;
+
+  private:
+    static const size_t ControlPointCount = CurveType::Degree + 1;
+
+    GScalar         m_x[ControlPointCount][MaxCurveCount];
+    GScalar         m_y[ControlPointCount][MaxCurveCount];
+    GScalar         m_z[ControlPointCount][MaxCurveCount];
+    GScalar         m_half_max_width[MaxCurveCount];
+    std::uint32_t   m_curve_mask;
+};
+
+
+//
+// CurveGroup class implementation.
+//
+
+template <typename CurveType>
+const size_t CurveGroup<CurveType>::MaxCurveCount;
+
+template <typename CurveType>
+void CurveGroup<CurveType>::set(const CurveType* curves, const size_t count)
+{
+    assert(count <= MaxCurveCount);
+
+    for (size_t i = 0; i < MaxCurveCount; ++i)
+    {
+        const bool valid = i < count;
+
+        for (size_t j = 0; j < ControlPointCount; ++j)
+        {
+            m_x[j][i] = valid ? curves[i].get_control_point(j).x : GScalar(0.0);
+            m_y[j][i] = valid ? curves[i].get_control_point(j).y : GScalar(0.0);
+            m_z[j][i] = valid ? curves[i].get_control_point(j).z : GScalar(0.0);
+        }
+
+        m_half_max_width[i] = valid ? GScalar(0.5) * curves[i].compute_max_width() : GScalar(0.0);
+    }
+
+    m_curve_mask = (1U << count) - 1;
+}
+
+template <typename CurveType>
+inline std::uint32_t CurveGroup<CurveType>::cull(
+    const CurveMatrixType&      xfm,
+    const GScalar               tmax) const
+{
+    // The projection transform is affine, its fourth row is (0, 0, 0, 1).
+    assert(xfm[12] == GScalar(0.0) && xfm[13] == GScalar(0.0) && xfm[14] == GScalar(0.0) && xfm[15] == GScalar(1.0));
+
+#ifdef APPLESEED_USE_SSE
+
+    static_assert(std::is_same<GScalar, float>::value, "The SIMD curve culling kernel requires single precision");
+
+    __m128 min_x = _mm_set1_ps(std::numeric_limits<float>::max());
+    __m128 min_y = min_x;
+    __m128 min_z = min_x;
+    __m128 max_x = _mm_set1_ps(-std::numeric_limits<float>::max());
+    __m128 max_y = max_x;
+    __m128 max_z = max_x;
+
+    for (size_t j = 0; j < ControlPointCount; ++j)
+    {
+        const __m128 x = _mm_load_ps(m_x[j]);
+        const __m128 y = _mm_load_ps(m_y[j]);
+        const __m128 z = _mm_load_ps(m_z[j]);
+
+        // Same evaluation order as the scalar matrix-vector product, for identical results.
+        const __m128 px =
+            _mm_add_ps(
+                _mm_add_ps(
+                    _mm_add_ps(
+                        _mm_mul_ps(_mm_set1_ps(xfm[0]), x),
+                        _mm_mul_ps(_mm_set1_ps(xfm[1]), y)),
+                    _mm_mul_ps(_mm_set1_ps(xfm[2]), z)),
+                _mm_set1_ps(xfm[3]));
+        const __m128 py =
+            _mm_add_ps(
+                _mm_add_ps(
+                    _mm_add_ps(
+                        _mm_mul_ps(_mm_set1_ps(xfm[4]), x),
+                        _mm_mul_ps(_mm_set1_ps(xfm[5]), y)),
+                    _mm_mul_ps(_mm_set1_ps(xfm[6]), z)),
+                _mm_set1_ps(xfm[7]));
+        const __m128 pz =
+            _mm_add_ps(
+                _mm_add_ps(
+                    _mm_add_ps(
+                        _mm_mul_ps(_mm_set1_ps(xfm[8]), x),
+                        _mm_mul_ps(_mm_set1_ps(xfm[9]), y)),
+                    _mm_mul_ps(_mm_set1_ps(xfm[10]), z)),
+                _mm_set1_ps(xfm[11]));
+
+        min_x = _mm_min_ps(min_x, px);
+        min_y = _mm_min_ps(min_y, py);
+        min_z = _mm_min_ps(min_z, pz);
+        max_x = _mm_max_ps(max_x, px);
+        max_y = _mm_max_ps(max_y, py);
+        max_z = _mm_max_ps(max_z, pz);
+    }
+
+    const __m128 half_width = _mm_load_ps(m_half_max_width);
+    const __m128 neg_half_width = _mm_sub_ps(_mm_setzero_ps(), half_width);
+
+    __m128 overlap = _mm_cmple_ps(min_z, _mm_set1_ps(tmax));
+    overlap = _mm_and_ps(overlap, _mm_cmpge_ps(max_z, _mm_set1_ps(1.0e-6f)));
+    overlap = _mm_and_ps(overlap, _mm_cmple_ps(min_x, half_width));
+    overlap = _mm_and_ps(overlap, _mm_cmpge_ps(max_x, neg_half_width));
+    overlap = _mm_and_ps(overlap, _mm_cmple_ps(min_y, half_width));
+    overlap = _mm_and_ps(overlap, _mm_cmpge_ps(max_y, neg_half_width));
+
+    return static_cast<std::uint32_t>(_mm_movemask_ps(overlap)) & m_curve_mask;
+
+#else
+
+    std::uint32_t mask = 0;
+
+    for (size_t i = 0; i < MaxCurveCount; ++i)
+    {
+        GAABB3 bbox;
+        bbox.invalidate();
+
+        for (size_t j = 0; j < ControlPointCount; ++j)
+        {
+            bbox.insert(
+                GVector3(
+                    xfm[0] * m_x[j][i] + xfm[1] * m_y[j][i] + xfm[ 2] * m_z[j][i] + xfm[ 3],
+                    xfm[4] * m_x[j][i] + xfm[5] * m_y[j][i] + xfm[ 6] * m_z[j][i] + xfm[ 7],
+                    xfm[8] * m_x[j][i] + xfm[9] * m_y[j][i] + xfm[10] * m_z[j][i] + xfm[11]));
+        }
+
+        const GScalar half_width = m_half_max_width[i];
+
+        if (bbox.min.z <= tmax      && bbox.max.z >= GScalar(1.0e-6) &&
+            bbox.min.x <= half_width && bbox.max.x >= -half_width     &&
+            bbox.min.y <= half_width && bbox.max.y >= -half_width)
+            mask |= 1U << i;
+    }
+
+    return mask & m_curve_mask;
+
+#endif
+}
+
+}   // namespace renderer
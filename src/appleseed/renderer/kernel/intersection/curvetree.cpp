@@ -31,6 +31,7 @@
 
 // appleseed.renderer headers.
 #include "renderer/global/globallogger.h"
+#include "renderer/kernel/intersection/treecache.h"
 #include "renderer/modeling/object/curveobject.h"
 #include "renderer/modeling/object/object.h"
 #include "renderer/modeling/scene/assembly.h"
@@ -41,6 +42,7 @@
 
 // appleseed.foundation headers.
 #include "foundation/core/exceptions/exceptionnotimplemented.h"
+#include "foundation/hash/murmurhash.h"
 #include "foundation/math/beziercurve.h"
 #include "foundation/math/permutation.h"
 #include "foundation/math/transform.h"
@@ -55,7 +57,9 @@
 #include "foundation/utility/stopwatch.h"
 
 // Standard headers.
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <cstring>
 #include <string>
 
@@ -64,6 +68,66 @@ using namespace foundation;
 namespace renderer
 {
 
+namespace
+{
+    // Compute the bounding box of a cubic Bezier curve from its extrema rather than
+    // from its control points, then grow it by the curve's half width.
+    GAABB3 compute_tight_curve_bbox(const Curve3Type& curve)
+    {
+        GAABB3 bbox;
+        bbox.invalidate();
+        bbox.insert(curve.get_control_point(0));
+        bbox.insert(curve.get_control_point(3));
+
+        for (size_t d = 0; d < 3; ++d)
+        {
+            const GScalar p0 = curve.get_control_point(0)[d];
+            const GScalar p1 = curve.get_control_point(1)[d];
+            const GScalar p2 = curve.get_control_point(2)[d];
+            const GScalar p3 = curve.get_control_point(3)[d];
+
+            // The derivative of the curve along this axis is proportional to a.t^2 + b.t + c.
+            const GScalar a = p3 - GScalar(3.0) * p2 + GScalar(3.0) * p1 - p0;
+            const GScalar b = GScalar(2.0) * (p2 - GScalar(2.0) * p1 + p0);
+            const GScalar c = p1 - p0;
+
+            GScalar roots[2];
+            size_t root_count = 0;
+
+            if (std::abs(a) < GScalar(1.0e-12))
+            {
+                if (b != GScalar(0.0))
+                    roots[root_count++] = -c / b;
+            }
+            else
+            {
+                const GScalar delta = b * b - GScalar(4.0) * a * c;
+
+                if (delta >= GScalar(0.0))
+                {
+                    const GScalar sqrt_delta = std::sqrt(delta);
+                    const GScalar rcp_2a = GScalar(0.5) / a;
+                    roots[root_count++] = (-b - sqrt_delta) * rcp_2a;
+                    roots[root_count++] = (-b + sqrt_delta) * rcp_2a;
+                }
+            }
+
+            for (size_t i = 0; i < root_count; ++i)
+            {
+                if (roots[i] > GScalar(0.0) && roots[i] < GScalar(1.0))
+                    bbox.insert(curve.evaluate_point(roots[i]));
+            }
+        }
+
+        // Never exceed the bounding box of the control points.
+        bbox = GAABB3::intersect(bbox, curve.compute_bbox());
+
+        bbox.grow(GVector3(GScalar(0.5) * curve.compute_max_width()));
+
+        return bbox;
+    }
+}
+
 //
 // CurveTree class implementation.
 //
@@ -72,11 +136,13 @@ CurveTree::Arguments::Arguments(
     const Scene&            scene,
     const UniqueID          curve_tree_uid,
     const GAABB3&           bbox,
-    const Assembly&         assembly)
+    const Assembly&         assembly,
+    const std::string&      cache_directory)
   : m_scene(scene)
   , m_curve_tree_uid(curve_tree_uid)
   , m_bbox(bbox)
   , m_assembly(assembly)
+  , m_cache_directory(cache_directory)
 {
 }
 
@@ -95,13 +161,36 @@ CurveTree::CurveTree(const Arguments& arguments)
     Stopwatch<DefaultWallclockTimer> stopwatch;
     stopwatch.start();
 
-    // Build the tree.
+    // Look the tree up in the tree cache.
+    const bool use_cache = !m_arguments.m_cache_directory.empty();
+    const MurmurHash cache_key =
+        use_cache ? compute_cache_key(algorithm) : MurmurHash();
+    const bool loaded_from_cache = use_cache && load_from_cache(cache_key);
+
     Statistics statistics;
-    if (algorithm == "bvh")
-        build_bvh(params, time, statistics);
-    else throw ExceptionNotImplemented();
-    statistics.insert_time("total build time", stopwatch.measure().get_seconds());
-    statistics.insert_size("nodes alignment", alignment(&m_nodes[0]));
+
+    if (loaded_from_cache)
+    {
+        statistics.insert_time("cache load time", stopwatch.measure().get_seconds());
+        statistics.insert_size("nodes alignment", alignment(&m_nodes[0]));
+    }
+    else
+    {
+        // Build the tree.
+        if (algorithm == "bvh")
+            build_bvh(params, time, statistics);
+        else throw ExceptionNotImplemented();
+        statistics.insert_time("total build time", stopwatch.measure().get_seconds());
+        statistics.insert_size("nodes alignment", alignment(&m_nodes[0]));
+
+        // Store the tree into the tree cache.
+        if (use_cache)
+        {
+            stopwatch.start();
+            save_to_cache(cache_key);
+            statistics.insert_time("cache save time", stopwatch.measure().get_seconds());
+        }
+    }
 
     // Print curve tree statistics.
     RENDERER_LOG_DEBUG("%s",
@@ -110,6 +199,104 @@ CurveTree::CurveTree(const Arguments& arguments)
             statistics).to_string().c_str());
 }
 
+MurmurHash CurveTree::compute_cache_key(const std::string& algorithm) const
+{
+    MurmurHash key;
+
+    // Memory layout of the tree.
+    key.append(sizeof(NodeType));
+    key.append(sizeof(CurveKey));
+    key.append(sizeof(Curve1Type));
+    key.append(sizeof(Curve3Type));
+
+    // Construction parameters.
+    key.append(algorithm);
+    key.append(CurveTreeDefaultMaxLeafSize);
+    key.append(CurveTreeDefaultInteriorNodeTraversalCost);
+    key.append(CurveTreeDefaultCurveIntersectionCost);
+    key.append(m_arguments.m_bbox);
+
+    // Geometry.
+    const ObjectInstanceContainer& object_instances = m_arguments.m_assembly.object_instances();
+    for (size_t i = 0, e = object_instances.size(); i < e; ++i)
+    {
+        const ObjectInstance* object_instance = object_instances.get_by_index(i);
+        assert(object_instance);
+
+        const Object& object = object_instance->get_object();
+        if (strcmp(object.get_model(), CurveObjectFactory().get_model()) != 0)
+            continue;
+
+        const CurveObject& curve_object = static_cast<const CurveObject&>(object);
+
+        key.append(i);
+        key.append(object_instance->get_transform().get_local_to_parent());
+
+        const size_t curve1_count = curve_object.get_curve1_count();
+        key.append(curve1_count);
+        for (size_t j = 0; j < curve1_count; ++j)
+            key.append(curve_object.get_curve1(j));
+
+        const size_t curve3_count = curve_object.get_curve3_count();
+        key.append(curve3_count);
+        for (size_t j = 0; j < curve3_count; ++j)
+            key.append(curve_object.get_curve3(j));
+    }
+
+    return key;
+}
+
+bool CurveTree::load_from_cache(const MurmurHash& key)
+{
+    TreeCacheReader reader(m_arguments.m_cache_directory, "curvetree", key);
+
+    if (!reader.is_open())
+        return false;
+
+    if (reader.read(m_nodes) &&
+        reader.read(m_curves1) &&
+        reader.read(m_curves3) &&
+        reader.read(m_curve_keys) &&
+        !m_nodes.empty())
+    {
+        build_curve_groups();
+
+        RENDERER_LOG_INFO(
+            "loaded curve tree #" FMT_UNIQUE_ID " from tree cache (%s %s).",
+            m_arguments.m_curve_tree_uid,
+            pretty_uint(m_curve_keys.size()).c_str(),
+            plural(m_curve_keys.size(), "curve").c_str());
+        return true;
+    }
+
+    RENDERER_LOG_WARNING(
+        "ignoring invalid tree cache entry for curve tree #" FMT_UNIQUE_ID ".",
+        m_arguments.m_curve_tree_uid);
+
+    // Leave the tree empty so that it gets rebuilt from scratch.
+    clear();
+    m_curves1.clear();
+    m_curves3.clear();
+    m_curve_keys.clear();
+
+    return false;
+}
+
+void CurveTree::save_to_cache(const MurmurHash& key) const
+{
+    TreeCacheWriter writer(m_arguments.m_cache_directory, "curvetree", key);
+
+    if (!writer.is_open())
+        return;
+
+    writer.write(m_nodes);
+    writer.write(m_curves1);
+    writer.write(m_curves3);
+    writer.write(m_curve_keys);
+
+    writer.commit();
+}
+
 void CurveTree::collect_curves(std::vector<GAABB3>& curve_bboxes)
 {
     const ObjectInstanceContainer& object_instances = m_arguments.m_assembly.object_instances();
@@ -165,8 +352,7 @@ void CurveTree::collect_curves(std::vector<GAABB3>& curve_bboxes)
                 0,                  // for now we assume all the curves have the same material
                 3);                 // curve degree
 
-            GAABB3 curve_bbox = curve.compute_bbox();
-            curve_bbox.grow(GVector3(GScalar(0.5) * curve.compute_max_width()));
+            const GAABB3 curve_bbox = compute_tight_curve_bbox(curve);
 
             m_curves3.push_back(curve);
             m_curve_keys.push_back(curve_key);
@@ -221,7 +407,13 @@ void CurveTree::build_bvh(
         reorder_curve_keys(ordering);
         reorder_curves(ordering);
         reorder_curve_keys_in_leaf_nodes();
+        build_curve_groups();
     }
+
+    statistics.insert_size(
+        "curve groups size",
+          m_curve1_groups.size() * sizeof(Curve1GroupType)
+        + m_curve3_groups.size() * sizeof(Curve3GroupType));
 }
 
 void CurveTree::reorder_curve_keys(const std::vector<size_t>& ordering)
@@ -301,6 +493,39 @@ void CurveTree::reorder_curve_keys_in_leaf_nodes()
     }
 }
 
+void CurveTree::build_curve_groups()
+{
+    m_curve1_groups.clear();
+    m_curve3_groups.clear();
+
+    for (size_t i = 0; i < m_nodes.size(); ++i)
+    {
+        if (!m_nodes[i].is_leaf())
+            continue;
+
+        LeafUserData& user_data = m_nodes[i].get_user_data<LeafUserData>();
+
+        // Leaves normally fit in a single group, but degenerate ones may hold more curves.
+        user_data.m_curve1_group_index = static_cast<std::uint32_t>(m_curve1_groups.size());
+        for (size_t j = 0; j < user_data.m_curve1_count; j += Curve1GroupType::MaxCurveCount)
+        {
+            m_curve1_groups.emplace_back();
+            m_curve1_groups.back().set(
+                &m_curves1[user_data.m_curve1_offset + j],
+                std::min<size_t>(user_data.m_curve1_count - j, Curve1GroupType::MaxCurveCount));
+        }
+
+        user_data.m_curve3_group_index = static_cast<std::uint32_t>(m_curve3_groups.size());
+        for (size_t j = 0; j < user_data.m_curve3_count; j += Curve3GroupType::MaxCurveCount)
+        {
+            m_curve3_groups.emplace_back();
+            m_curve3_groups.back().set(
+                &m_curves3[user_data.m_curve3_offset + j],
+                std::min<size_t>(user_data.m_curve3_count - j, Curve3GroupType::MaxCurveCount));
+        }
+    }
+}
+
 
 //
 // CurveTreeFactory class implementation.
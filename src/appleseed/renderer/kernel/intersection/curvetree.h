@@ -30,6 +30,7 @@
 
 // appleseed.renderer headers.
 #include "renderer/global/globaltypes.h"
+#include "renderer/kernel/intersection/curvegroup.h"
 #include "renderer/kernel/intersection/curvekey.h"
 #include "renderer/kernel/intersection/intersectionsettings.h"
 #include "renderer/kernel/intersection/probevisitorbase.h"
@@ -49,9 +50,11 @@
 #include <cstdint>
 #include <map>
 #include <memory>
+#include <string>
 #include <vector>
 
 // Forward declarations.
+namespace foundation    { class MurmurHash; }
 namespace foundation    { class Statistics; }
 namespace renderer      { class Assembly; }
 namespace renderer      { class ParamArray; }
@@ -79,13 +82,15 @@ class CurveTree
         const foundation::UniqueID              m_curve_tree_uid;
         const GAABB3                            m_bbox;
         const Assembly&                         m_assembly;
+        const std::string                       m_cache_directory;  // tree cache disabled if empty
 
         // Constructor.
         Arguments(
             const Scene&                        scene,
             const foundation::UniqueID          curve_tree_uid,
             const GAABB3&                       bbox,
-            const Assembly&                     assembly);
+            const Assembly&                     assembly,
+            const std::string&                  cache_directory);
     };
 
     // Constructor, builds the tree for a given assembly.
@@ -95,18 +100,32 @@ class CurveTree
     friend class CurveLeafVisitor;
     friend class CurveLeafProbeVisitor;
 
+    typedef CurveGroup<Curve1Type> Curve1GroupType;
+    typedef CurveGroup<Curve3Type> Curve3GroupType;
+
     struct LeafUserData
     {
         std::uint32_t       m_curve1_offset;
         std::uint32_t       m_curve1_count;
         std::uint32_t       m_curve3_offset;
         std::uint32_t       m_curve3_count;
+        std::uint32_t       m_curve1_group_index;
+        std::uint32_t       m_curve3_group_index;
     };
 
-    const Arguments         m_arguments;
-    std::vector<Curve1Type> m_curves1;
-    std::vector<Curve3Type> m_curves3;
-    std::vector<CurveKey>   m_curve_keys;
+    const Arguments                                 m_arguments;
+    std::vector<Curve1Type>                         m_curves1;
+    std::vector<Curve3Type>                         m_curves3;
+    std::vector<CurveKey>                           m_curve_keys;
+    foundation::AlignedVector<Curve1GroupType>      m_curve1_groups;
+    foundation::AlignedVector<Curve3GroupType>      m_curve3_groups;
+
+    // Compute a hash of everything the tree is built from, used to look up the tree cache.
+    foundation::MurmurHash compute_cache_key(
+        const std::string&                      algorithm) const;
+
+    bool load_from_cache(const foundation::MurmurHash& key);
+    void save_to_cache(const foundation::MurmurHash& key) const;
 
     void collect_curves(std::vector<GAABB3>& curve_bboxes);
 
@@ -123,6 +142,9 @@ class CurveTree
 
     // Reorder curve keys in leaf nodes so that all degree-1 curve keys come before degree-3 ones.
     void reorder_curve_keys_in_leaf_nodes();
+
+    // Store the curves of each leaf node into consecutive curve groups.
+    void build_curve_groups();
 };
 
 
@@ -275,35 +297,63 @@ inline bool CurveLeafVisitor::visit(
 {
     const CurveTree::LeafUserData& user_data = node.get_user_data<CurveTree::LeafUserData>();
 
-    size_t curve_index = node.get_item_index();
+    const size_t curve1_index = node.get_item_index();
+    const size_t curve3_index = curve1_index + user_data.m_curve1_count;
+    const GScalar norm_dir = foundation::norm(ray.m_dir);
+
     size_t hit_curve_index = ~size_t(0);
     GScalar u, v, t = ray.m_tmax;
 
-    for (std::uint32_t i = 0; i < user_data.m_curve1_count; ++i, ++curve_index)
+    if (user_data.m_curve1_count > 0)
     {
-        const Curve1Type& curve = m_tree.m_curves1[user_data.m_curve1_offset + i];
-        if (Curve1IntersectorType::intersect(curve, ray, m_xfm_matrix, u, v, t))
+        // Only intersect the curves that survive the culling test of their group.
+        const CurveTree::Curve1GroupType* group = &m_tree.m_curve1_groups[user_data.m_curve1_group_index];
+        std::uint32_t mask = 0;
+
+        for (std::uint32_t i = 0; i < user_data.m_curve1_count; ++i)
         {
-            m_shading_point.m_primitive_type = ShadingPoint::PrimitiveCurve1;
-            m_shading_point.m_ray.m_tmax = static_cast<double>(t);
-            m_shading_point.m_bary[0] = static_cast<float>(u);
-            m_shading_point.m_bary[1] = static_cast<float>(v);
-            hit_curve_index = curve_index;
+            if (i % CurveTree::Curve1GroupType::MaxCurveCount == 0)
+                mask = (group++)->cull(m_xfm_matrix, t * norm_dir);
+
+            if ((mask & (1U << (i % CurveTree::Curve1GroupType::MaxCurveCount))) == 0)
+                continue;
+
+            const Curve1Type& curve = m_tree.m_curves1[user_data.m_curve1_offset + i];
+            if (Curve1IntersectorType::intersect(curve, ray, m_xfm_matrix, u, v, t))
+            {
+                m_shading_point.m_primitive_type = ShadingPoint::PrimitiveCurve1;
+                m_shading_point.m_ray.m_tmax = static_cast<double>(t);
+                m_shading_point.m_bary[0] = static_cast<float>(u);
+                m_shading_point.m_bary[1] = static_cast<float>(v);
+                hit_curve_index = curve1_index + i;
+            }
         }
     }
 
     FOUNDATION_BVH_TRAVERSAL_STATS(stats.m_intersected_items.insert(curve1_curve_count));
 
-    for (std::uint32_t i = 0; i < user_data.m_curve3_count; ++i, ++curve_index)
+    if (user_data.m_curve3_count > 0)
     {
-        const Curve3Type& curve = m_tree.m_curves3[user_data.m_curve3_offset + i];
-        if (Curve3IntersectorType::intersect(curve, ray, m_xfm_matrix, u, v, t))
+        const CurveTree::Curve3GroupType* group = &m_tree.m_curve3_groups[user_data.m_curve3_group_index];
+        std::uint32_t mask = 0;
+
+        for (std::uint32_t i = 0; i < user_data.m_curve3_count; ++i)
         {
-            m_shading_point.m_primitive_type = ShadingPoint::PrimitiveCurve3;
-            m_shading_point.m_ray.m_tmax = static_cast<double>(t);
-            m_shading_point.m_bary[0] = static_cast<float>(u);
-            m_shading_point.m_bary[1] = static_cast<float>(v);
-            hit_curve_index = curve_index;
+            if (i % CurveTree::Curve3GroupType::MaxCurveCount == 0)
+                mask = (group++)->cull(m_xfm_matrix, t * norm_dir);
+
+            if ((mask & (1U << (i % CurveTree::Curve3GroupType::MaxCurveCount))) == 0)
+                continue;
+
+            const Curve3Type& curve = m_tree.m_curves3[user_data.m_curve3_offset + i];
+            if (Curve3IntersectorType::intersect(curve, ray, m_xfm_matrix, u, v, t))
+            {
+                m_shading_point.m_primitive_type = ShadingPoint::PrimitiveCurve3;
+                m_shading_point.m_ray.m_tmax = static_cast<double>(t);
+                m_shading_point.m_bary[0] = static_cast<float>(u);
+                m_shading_point.m_bary[1] = static_cast<float>(v);
+                hit_curve_index = curve3_index + i;
+            }
         }
     }
 
@@ -346,27 +396,53 @@ inline bool CurveLeafProbeVisitor::visit(
 {
     const CurveTree::LeafUserData& user_data = node.get_user_data<CurveTree::LeafUserData>();
 
-    for (std::uint32_t i = 0; i < user_data.m_curve1_count; ++i)
+    const GScalar tmax = ray.m_tmax * foundation::norm(ray.m_dir);
+
+    if (user_data.m_curve1_count > 0)
     {
-        const Curve1Type& curve = m_tree.m_curves1[user_data.m_curve1_offset + i];
-        if (Curve1IntersectorType::intersect(curve, ray, m_xfm_matrix))
+        const CurveTree::Curve1GroupType* group = &m_tree.m_curve1_groups[user_data.m_curve1_group_index];
+        std::uint32_t mask = 0;
+
+        for (std::uint32_t i = 0; i < user_data.m_curve1_count; ++i)
         {
-            FOUNDATION_BVH_TRAVERSAL_STATS(stats.m_intersected_items.insert(i + 1));
-            m_hit = true;
-            return false;
+            if (i % CurveTree::Curve1GroupType::MaxCurveCount == 0)
+                mask = (group++)->cull(m_xfm_matrix, tmax);
+
+            if ((mask & (1U << (i % CurveTree::Curve1GroupType::MaxCurveCount))) == 0)
+                continue;
+
+            const Curve1Type& curve = m_tree.m_curves1[user_data.m_curve1_offset + i];
+            if (Curve1IntersectorType::intersect(curve, ray, m_xfm_matrix))
+            {
+                FOUNDATION_BVH_TRAVERSAL_STATS(stats.m_intersected_items.insert(i + 1));
+                m_hit = true;
+                return false;
+            }
         }
     }
 
     FOUNDATION_BVH_TRAVERSAL_STATS(stats.m_intersected_items.insert(curve1_curve_count));
 
-    for (std::uint32_t i = 0; i < user_data.m_curve3_count; ++i)
+    if (user_data.m_curve3_count > 0)
     {
-        const Curve3Type& curve = m_tree.m_curves3[user_data.m_curve3_offset + i];
-        if (Curve3IntersectorType::intersect(curve, ray, m_xfm_matrix))
+        const CurveTree::Curve3GroupType* group = &m_tree.m_curve3_groups[user_data.m_curve3_group_index];
+        std::uint32_t mask = 0;
+
+        for (std::uint32_t i = 0; i < user_data.m_curve3_count; ++i)
         {
-            FOUNDATION_BVH_TRAVERSAL_STATS(stats.m_intersected_items.insert(i + 1));
-            m_hit = true;
-            return false;
+            if (i % CurveTree::Curve3GroupType::MaxCurveCount == 0)
+                mask = (group++)->cull(m_xfm_matrix, tmax);
+
+            if ((mask & (1U << (i % CurveTree::Curve3GroupType::MaxCurveCount))) == 0)
+                continue;
+
+            const Curve3Type& curve = m_tree.m_curves3[user_data.m_curve3_offset + i];
+            if (Curve3IntersectorType::intersect(curve, ray, m_xfm_matrix))
+            {
+                FOUNDATION_BVH_TRAVERSAL_STATS(stats.m_intersected_items.insert(i + 1));
+                m_hit = true;
+                return false;
+            }
         }
     }
 
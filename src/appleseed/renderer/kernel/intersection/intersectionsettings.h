@@ -33,7 +33,9 @@
 #include "renderer/global/globaltypes.h"
 
 // appleseed.foundation headers.
+#include "foundation/math/aabb.h"
 #include "foundation/math/beziercurve.h"
+#include "foundation/math/bvh.h"
 #include "foundation/math/intersection/raytrianglemt.h"
 #include "foundation/math/matrix.h"
 
@@ -47,6 +49,10 @@ namespace renderer
 // Assembly tree settings.
 //
 
+// Node format of the assembly tree. Use foundation::bvh::CompactNode to store
+// child bounding boxes in single precision and halve the size of the nodes.
+typedef foundation::bvh::Node<foundation::AABB3d> AssemblyTreeNodeType;
+
 // Maximum number of assemblies per leaf.
 const size_t AssemblyTreeMaxLeafSize = 1;
 
@@ -56,6 +62,10 @@ const double AssemblyTreeInteriorNodeTraversalCost = 1.0;
 // Relative cost of intersecting an assembly.
 const double AssemblyTreeTriangleIntersectionCost = 10.0;
 
+// The assembly tree is rebuilt instead of refitted when assembly instances moved so much
+// that the SAH cost of the refitted tree exceeds this many times the cost of the built tree.
+const double AssemblyTreeMaxRefitCostRatio = 1.5;
+
 
 //
 // Triangle tree settings.
@@ -68,6 +78,12 @@ typedef foundation::TriangleMT<GScalar> GTriangleType;
 typedef foundation::TriangleMT<double> TriangleType;
 typedef foundation::TriangleMTSupportPlane<double> TriangleSupportPlaneType;
 
+// Node format of the triangle tree. Compact nodes store child bounding boxes in
+// single precision (rounded outward) and are half the size of regular nodes.
+// Since triangles are stored in single precision anyway, little culling
+// efficiency is lost. Use foundation::bvh::Node for full precision nodes.
+typedef foundation::bvh::CompactNode<foundation::AABB3d> TriangleTreeNodeType;
+
 // Maximum number of triangles per leaf.
 const size_t TriangleTreeDefaultMaxLeafSize = 2;
 
@@ -80,6 +96,14 @@ const GScalar TriangleTreeDefaultTriangleIntersectionCost(1.0);
 // Number of bins used during SBVH construction.
 const size_t TriangleTreeDefaultBinCount = 256;
 
+// Minimum number of triangles in a subtree for it to be built by a separate task.
+// Smaller subtrees are built by the thread that partitioned their parent node.
+const size_t TriangleTreeMinBuildTaskSize = 4096;
+
+// Triangle trees are rebuilt instead of refitted when triangles moved so much that the
+// SAH cost of the refitted tree exceeds this many times the cost of the built tree.
+const double TriangleTreeMaxRefitCostRatio = 1.5;
+
 // Define this symbol to enable reordering the nodes of triangle trees for better
 // locality of reference. Requires a lot of temporary memory for minimal results.
 #undef RENDERER_TRIANGLE_TREE_REORDER_NODES
@@ -87,6 +111,14 @@ const size_t TriangleTreeDefaultBinCount = 256;
 // Depth of a subtree in the van Emde Boas node layout.
 const size_t TriangleTreeSubtreeDepth = 3;
 
+// Number of children per node of the wide BVHs static triangle trees are collapsed
+// into, unless the wide_bvh acceleration structure parameter is false (4 for SSE, 8 for AVX).
+#ifdef APPLESEED_USE_AVX
+const size_t TriangleTreeWideBVHWidth = 8;
+#else
+const size_t TriangleTreeWideBVHWidth = 4;
+#endif
+
 // Size of the triangle tree access cache.
 const size_t TriangleTreeAccessCacheLines = 128;
 const size_t TriangleTreeAccessCacheWays = 2;
@@ -110,8 +142,8 @@ typedef foundation::BezierCurveIntersector<Curve3Type> Curve3IntersectorType;
 // Matrix used in curve intersections
 typedef foundation::Matrix<GScalar, 4, 4> CurveMatrixType;
 
-// Maximum number of curves per leaf.
-const size_t CurveTreeDefaultMaxLeafSize = 1;
+// Maximum number of curves per leaf, at most the number of curves culled at once by a leaf.
+const size_t CurveTreeDefaultMaxLeafSize = 4;
 
 // Relative cost of traversing an interior node.
 const GScalar CurveTreeDefaultInteriorNodeTraversalCost(1.0);
@@ -237,6 +237,173 @@ bool Intersector::trace_probe(
     return visitor.hit();
 }
 
+bvh::PacketMask Intersector::trace_with_assembly_culling(
+    const ShadingRay                    rays[],
+    const size_t                        ray_count,
+    ShadingPoint                        shading_points[],
+    const bvh::PacketMask               mask,
+    const ShadingPoint*                 parent_shading_point) const
+{
+    assert(ray_count <= bvh::MaxPacketSize);
+    assert(parent_shading_point == nullptr || parent_shading_point->is_valid());
+
+    const bvh::PacketMask active_mask = mask & bvh::make_packet_mask(ray_count);
+
+    // Initialize the shading points and compute ray infos once for the entire traversal.
+    ShadingRay::RayInfoType ray_infos[bvh::MaxPacketSize];
+    for (size_t i = 0; i < ray_count; ++i)
+    {
+        if ((active_mask & (bvh::PacketMask(1) << i)) == 0)
+            continue;
+
+        ShadingPoint& shading_point = shading_points[i];
+
+        assert(is_normalized(rays[i].m_dir));
+        assert(shading_point.m_scene == nullptr);
+        assert(!shading_point.is_valid());
+        assert(parent_shading_point != &shading_point);
+
+        // Update ray casting statistics.
+        ++m_shading_ray_count;
+
+        shading_point.m_texture_cache = &m_texture_cache;
+        shading_point.m_scene = &m_trace_context.get_scene();
+        shading_point.m_ray = rays[i];
+
+        ray_infos[i] = ShadingRay::RayInfoType(shading_point.m_ray);
+    }
+
+    if (active_mask == 0)
+        return 0;
+
+    // Refine and offset the previous intersection point.
+    if (parent_shading_point &&
+        parent_shading_point->hit_surface() &&
+        !(parent_shading_point->m_members & ShadingPoint::HasRefinedPoints))
+        parent_shading_point->refine_and_offset();
+
+    // Retrieve assembly tree.
+    const AssemblyTree& assembly_tree = m_trace_context.get_assembly_tree();
+
+    // Check the intersection between the rays and the assembly tree.
+    AssemblyTreePacketIntersector intersector;
+    AssemblyLeafPacketVisitor visitor(
+        shading_points,
+        assembly_tree,
+        m_triangle_tree_cache,
+        m_curve_tree_cache,
+#ifdef APPLESEED_WITH_EMBREE
+        m_embree_scene_cache,
+#endif
+        parent_shading_point
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+        , m_triangle_tree_traversal_stats
+        , m_curve_tree_traversal_stats
+#endif
+        );
+    intersector.intersect_no_motion(
+        assembly_tree,
+        rays,
+        ray_infos,
+        ray_count,
+        active_mask,
+        visitor
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+        , m_assembly_tree_traversal_stats
+#endif
+        );
+
+    bvh::PacketMask hit_mask = 0;
+    for (size_t i = 0; i < ray_count; ++i)
+    {
+        if ((active_mask & (bvh::PacketMask(1) << i)) == 0)
+            continue;
+
+        ShadingPoint& shading_point = shading_points[i];
+
+        // Detect and report self-intersections.
+        if (m_report_self_intersections)
+            report_self_intersection(shading_point, parent_shading_point);
+
+        const ShadingRay::Medium* medium = rays[i].get_current_medium();
+        if (!shading_point.hit_surface() && medium != nullptr && medium->get_volume() != nullptr)
+            shading_point.m_primitive_type = ShadingPoint::PrimitiveVolume;
+
+        if (shading_point.hit_surface())
+            hit_mask |= bvh::PacketMask(1) << i;
+    }
+
+    return hit_mask;
+}
+
+bvh::PacketMask Intersector::trace_probe_with_assembly_culling(
+    const ShadingRay                    rays[],
+    const size_t                        ray_count,
+    const bvh::PacketMask               mask,
+    const ShadingPoint*                 parent_shading_point) const
+{
+    assert(ray_count <= bvh::MaxPacketSize);
+    assert(parent_shading_point == 0 || parent_shading_point->hit_surface());
+
+    const bvh::PacketMask active_mask = mask & bvh::make_packet_mask(ray_count);
+
+    // Compute ray infos once for the entire traversal.
+    ShadingRay::RayInfoType ray_infos[bvh::MaxPacketSize];
+    for (size_t i = 0; i < ray_count; ++i)
+    {
+        if ((active_mask & (bvh::PacketMask(1) << i)) == 0)
+            continue;
+
+        assert(is_normalized(rays[i].m_dir));
+
+        // Update ray casting statistics.
+        ++m_probe_ray_count;
+
+        ray_infos[i] = ShadingRay::RayInfoType(rays[i]);
+    }
+
+    if (active_mask == 0)
+        return 0;
+
+    // Refine and offset the previous intersection point.
+    if (parent_shading_point &&
+        parent_shading_point->hit_surface() &&
+        !(parent_shading_point->m_members & ShadingPoint::HasRefinedPoints))
+        parent_shading_point->refine_and_offset();
+
+    // Retrieve assembly tree.
+    const AssemblyTree& assembly_tree = m_trace_context.get_assembly_tree();
+
+    // Check the intersection between the rays and the assembly tree.
+    AssemblyTreePacketProbeIntersector intersector;
+    AssemblyLeafPacketProbeVisitor visitor(
+        assembly_tree,
+        m_triangle_tree_cache,
+        m_curve_tree_cache,
+#ifdef APPLESEED_WITH_EMBREE
+        m_embree_scene_cache,
+#endif
+        parent_shading_point
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+        , m_triangle_tree_traversal_stats
+        , m_curve_tree_traversal_stats
+#endif
+        );
+    intersector.intersect_no_motion(
+        assembly_tree,
+        rays,
+        ray_infos,
+        ray_count,
+        active_mask,
+        visitor
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+        , m_assembly_tree_traversal_stats
+#endif
+        );
+
+    return visitor.get_hit_mask();
+}
+
 void Intersector::make_triangle_shading_point(
     ShadingPoint&                       shading_point,
     const ShadingRay&                   shading_ray,
@@ -83,6 +83,26 @@ class Intersector
         const ShadingRay&                   ray,
         const ShadingPoint*                 parent_shading_point = nullptr) const;
 
+    // Trace up to foundation::bvh::MaxPacketSize world space rays through the scene,
+    // culling them as a packet against the assembly tree only: each ray then goes
+    // through the triangle and curve trees on its own, exactly as with trace().
+    // Only the rays whose bit is set in 'mask' are traced; their shading points are
+    // initialized as by trace(). Return the mask of the rays that hit a surface.
+    foundation::bvh::PacketMask trace_with_assembly_culling(
+        const ShadingRay                    rays[],
+        const size_t                        ray_count,
+        ShadingPoint                        shading_points[],
+        const foundation::bvh::PacketMask   mask,
+        const ShadingPoint*                 parent_shading_point = nullptr) const;
+
+    // Probe ray counterpart of trace_with_assembly_culling(). Only the rays whose bit
+    // is set in 'mask' are traced. Return the mask of the rays that hit something.
+    foundation::bvh::PacketMask trace_probe_with_assembly_culling(
+        const ShadingRay                    rays[],
+        const size_t                        ray_count,
+        const foundation::bvh::PacketMask   mask,
+        const ShadingPoint*                 parent_shading_point = nullptr) const;
+
     // Manufacture a triangle hit "by hand".
     // There is no restriction placed on the shading point passed to this method.
     // For instance it may have been previously initialized and used.
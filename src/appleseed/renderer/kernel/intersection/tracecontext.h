@@ -68,6 +68,12 @@ class APPLESEED_DLLSYMBOL TraceContext
     // Synchronize the trace context with the scene.
     void update();
 
+    // Set the directory where triangle and curve trees are cached across renders.
+    void set_tree_cache_directory(const char* path);
+
+    // Set the number of threads used to build triangle trees.
+    void set_tree_build_thread_count(const size_t thread_count);
+
 #ifdef APPLESEED_WITH_EMBREE
     void set_use_embree(const bool value);
 #endif
@@ -0,0 +1,290 @@
+
+//
+// This source file is part of appleseed.
+// Visit https://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2019 The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+// Interface header.
+#include "treecache.h"
+
+// appleseed.renderer headers.
+#include "renderer/global/globallogger.h"
+
+// Boost headers.
+#include "boost/filesystem.hpp"
+#include "boost/system/error_code.hpp"
+
+// Standard headers.
+#include <cstring>
+
+using namespace foundation;
+namespace bf = boost::filesystem;
+
+namespace renderer
+{
+
+namespace
+{
+    // Bump this number whenever the layout of cached trees changes.
+    const std::uint32_t FormatVersion = 1;
+
+    const char Magic[8] = { 'A', 'S', 'T', 'R', 'E', 'E', 'C', 'H' };
+
+    const size_t ArrayAlignment = 64;
+
+    struct FileHeader
+    {
+        char            m_magic[8];
+        std::uint32_t   m_version;
+        std::uint32_t   m_padding;
+        std::uint64_t   m_key_h1;
+        std::uint64_t   m_key_h2;
+    };
+
+    struct ArrayHeader
+    {
+        std::uint64_t   m_item_size;
+        std::uint64_t   m_item_count;
+    };
+
+    size_t align_offset(const size_t offset)
+    {
+        return (offset + ArrayAlignment - 1) & ~(ArrayAlignment - 1);
+    }
+
+    std::string make_cache_file_path(
+        const std::string&  directory,
+        const char*         tree_type,
+        const MurmurHash&   key)
+    {
+        const std::string filename = std::string(tree_type) + "-" + key.to_string() + ".bvh";
+        return (bf::path(directory) / filename).string();
+    }
+
+    std::string make_temporary_file_path(const std::string& path)
+    {
+        return path + bf::unique_path(".%%%%-%%%%-%%%%.tmp").string();
+    }
+
+    FileHeader make_file_header(const MurmurHash& key)
+    {
+        FileHeader header;
+        std::memcpy(header.m_magic, Magic, sizeof(Magic));
+        header.m_version = FormatVersion;
+        header.m_padding = 0;
+        header.m_key_h1 = key.h1();
+        header.m_key_h2 = key.h2();
+        return header;
+    }
+}
+
+
+//
+// TreeCacheWriter class implementation.
+//
+
+TreeCacheWriter::TreeCacheWriter(
+    const std::string&      directory,
+    const char*             tree_type,
+    const MurmurHash&       key)
+  : m_path(make_cache_file_path(directory, tree_type, key))
+  , m_temp_path(make_temporary_file_path(m_path))
+  , m_size(0)
+  , m_succeeded(false)
+{
+    boost::system::error_code ec;
+    bf::create_directories(directory, ec);
+
+    if (ec)
+    {
+        RENDERER_LOG_WARNING(
+            "failed to create tree cache directory %s: %s.",
+            directory.c_str(),
+            ec.message().c_str());
+        return;
+    }
+
+    if (!m_file.open(m_temp_path.c_str(), BufferedFile::BinaryType, BufferedFile::WriteMode))
+    {
+        RENDERER_LOG_WARNING("failed to create tree cache file %s.", m_temp_path.c_str());
+        return;
+    }
+
+    m_succeeded = true;
+
+    const FileHeader header = make_file_header(key);
+    write_bytes(&header, sizeof(header));
+}
+
+TreeCacheWriter::~TreeCacheWriter()
+{
+    if (m_file.is_open())
+    {
+        m_file.close();
+
+        boost::system::error_code ec;
+        bf::remove(m_temp_path, ec);
+    }
+}
+
+bool TreeCacheWriter::is_open() const
+{
+    return m_file.is_open();
+}
+
+bool TreeCacheWriter::commit()
+{
+    if (!m_file.is_open())
+        return false;
+
+    boost::system::error_code ec;
+
+    if (!m_file.close() || !m_succeeded)
+    {
+        bf::remove(m_temp_path, ec);
+        RENDERER_LOG_WARNING("failed to write tree cache file %s.", m_temp_path.c_str());
+        return false;
+    }
+
+    // Renaming is atomic: other renders either see the previous file or the complete new one.
+    bf::rename(m_temp_path, m_path, ec);
+
+    if (ec)
+    {
+        bf::remove(m_temp_path, ec);
+        RENDERER_LOG_WARNING(
+            "failed to write tree cache file %s: %s.",
+            m_path.c_str(),
+            ec.message().c_str());
+        return false;
+    }
+
+    return true;
+}
+
+void TreeCacheWriter::write_array(
+    const void*             data,
+    const size_t            item_size,
+    const size_t            item_count)
+{
+    if (!m_file.is_open())
+        return;
+
+    ArrayHeader header;
+    header.m_item_size = item_size;
+    header.m_item_count = item_count;
+    write_bytes(&header, sizeof(header));
+
+    // Pad the file so that the array starts on an aligned offset.
+    static const std::uint8_t Padding[ArrayAlignment] = { 0 };
+    write_bytes(Padding, align_offset(m_size) - m_size);
+
+    write_bytes(data, item_size * item_count);
+}
+
+void TreeCacheWriter::write_bytes(const void* data, const size_t size)
+{
+    if (size == 0)
+        return;
+
+    if (m_file.write(data, size) != size)
+        m_succeeded = false;
+
+    m_size += size;
+}
+
+
+//
+// TreeCacheReader class implementation.
+//
+
+TreeCacheReader::TreeCacheReader(
+    const std::string&      directory,
+    const char*             tree_type,
+    const MurmurHash&       key)
+  : m_offset(0)
+{
+    const std::string path = make_cache_file_path(directory, tree_type, key);
+
+    boost::system::error_code ec;
+    if (!bf::exists(path, ec))
+        return;
+
+    std::unique_ptr<MemoryMappedFile> file(new MemoryMappedFile(path.c_str()));
+
+    if (!file->is_open() || file->size() < sizeof(FileHeader))
+    {
+        RENDERER_LOG_WARNING("failed to open tree cache file %s.", path.c_str());
+        return;
+    }
+
+    // Reject files written by a different version of the cache or colliding on the file name.
+    const FileHeader expected_header = make_file_header(key);
+    if (std::memcmp(file->data(), &expected_header, sizeof(FileHeader)) != 0)
+    {
+        RENDERER_LOG_WARNING("ignoring invalid or outdated tree cache file %s.", path.c_str());
+        return;
+    }
+
+    m_file = std::move(file);
+    m_offset = sizeof(FileHeader);
+}
+
+bool TreeCacheReader::is_open() const
+{
+    return m_file.get() != nullptr;
+}
+
+const void* TreeCacheReader::read_array(
+    const size_t            item_size,
+    size_t&                 item_count)
+{
+    if (!m_file)
+        return nullptr;
+
+    const size_t file_size = m_file->size();
+
+    if (m_offset + sizeof(ArrayHeader) > file_size)
+        return nullptr;
+
+    ArrayHeader header;
+    std::memcpy(&header, m_file->data() + m_offset, sizeof(ArrayHeader));
+
+    if (header.m_item_size != item_size)
+        return nullptr;
+
+    const size_t data_offset = align_offset(m_offset + sizeof(ArrayHeader));
+
+    if (data_offset > file_size ||
+        header.m_item_count > (file_size - data_offset) / item_size)
+        return nullptr;
+
+    item_count = static_cast<size_t>(header.m_item_count);
+    m_offset = data_offset + item_count * item_size;
+
+    return m_file->data() + data_offset;
+}
+
+}   // namespace renderer
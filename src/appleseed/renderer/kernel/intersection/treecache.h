@@ -0,0 +1,220 @@
+
+//
+// This source file is part of appleseed.
+// Visit https://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2019 The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+// appleseed.foundation headers.
+#include "foundation/core/concepts/noncopyable.h"
+#include "foundation/hash/murmurhash.h"
+#include "foundation/platform/memorymappedfile.h"
+#include "foundation/utility/bufferedfile.h"
+
+// Standard headers.
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace renderer
+{
+
+//
+// A persistent, on-disk cache of acceleration structures.
+//
+// Each cached tree lives in its own file, named after the type of the tree and a hash
+// of everything the tree is built from. Files are written under a temporary name and
+// renamed once complete, so that renders sharing a cache directory (for instance on a
+// render farm) never observe partially written files.
+//
+// A cache file is a small header followed by a sequence of arrays. Arrays must be read
+// back in the order they were written; each array is aligned on a 64-byte boundary.
+//
+
+class TreeCacheWriter
+  : public foundation::NonCopyable
+{
+  public:
+    // Constructor, creates a temporary file in the cache directory.
+    TreeCacheWriter(
+        const std::string&              directory,
+        const char*                     tree_type,
+        const foundation::MurmurHash&   key);
+
+    // Destructor, deletes the temporary file if commit() was not called or failed.
+    ~TreeCacheWriter();
+
+    // Return true if the temporary file could be created.
+    bool is_open() const;
+
+    // Append an array of trivially copyable items.
+    template <typename Vector>
+    void write(const Vector& vec);
+
+    // Append a single trivially copyable value.
+    template <typename T>
+    void write_value(const T& value);
+
+    // Move the file to its final location. Return true on success.
+    bool commit();
+
+  private:
+    const std::string           m_path;
+    const std::string           m_temp_path;
+    foundation::BufferedFile    m_file;
+    size_t                      m_size;
+    bool                        m_succeeded;
+
+    void write_array(
+        const void*             data,
+        const size_t            item_size,
+        const size_t            item_count);
+
+    void write_bytes(
+        const void*             data,
+        const size_t            size);
+};
+
+class TreeCacheReader
+  : public foundation::NonCopyable
+{
+  public:
+    // Constructor, maps the cache file matching a given key, if any.
+    TreeCacheReader(
+        const std::string&              directory,
+        const char*                     tree_type,
+        const foundation::MurmurHash&   key);
+
+    // Return true if a valid cache file was found.
+    bool is_open() const;
+
+    // Read the next array. Return false if the file is truncated or of a different layout.
+    template <typename Vector>
+    bool read(Vector& vec);
+
+    // Read the next single value.
+    template <typename T>
+    bool read_value(T& value);
+
+  private:
+    std::unique_ptr<foundation::MemoryMappedFile>   m_file;
+    size_t                                          m_offset;
+
+    // Return a pointer to the next array, or nullptr on error.
+    const void* read_array(
+        const size_t            item_size,
+        size_t&                 item_count);
+};
+
+// Append the contents of an array of trivially copyable items to a hash.
+template <typename Vector>
+void hash_vector(foundation::MurmurHash& hash, const Vector& vec);
+
+
+//
+// TreeCacheWriter class implementation.
+//
+
+template <typename Vector>
+inline void TreeCacheWriter::write(const Vector& vec)
+{
+    write_array(
+        vec.empty() ? nullptr : &vec[0],
+        sizeof(typename Vector::value_type),
+        vec.size());
+}
+
+template <typename T>
+inline void TreeCacheWriter::write_value(const T& value)
+{
+    write_array(&value, sizeof(T), 1);
+}
+
+
+//
+// TreeCacheReader class implementation.
+//
+
+template <typename Vector>
+inline bool TreeCacheReader::read(Vector& vec)
+{
+    typedef typename Vector::value_type ValueType;
+
+    size_t item_count;
+    const void* data = read_array(sizeof(ValueType), item_count);
+
+    if (data == nullptr)
+        return false;
+
+    const ValueType* items = static_cast<const ValueType*>(data);
+    vec.assign(items, items + item_count);
+
+    return true;
+}
+
+template <typename T>
+inline bool TreeCacheReader::read_value(T& value)
+{
+    size_t item_count;
+    const void* data = read_array(sizeof(T), item_count);
+
+    if (data == nullptr || item_count != 1)
+        return false;
+
+    value = *static_cast<const T*>(data);
+
+    return true;
+}
+
+
+//
+// Utility functions implementation.
+//
+
+template <typename Vector>
+void hash_vector(foundation::MurmurHash& hash, const Vector& vec)
+{
+    typedef typename Vector::value_type ValueType;
+
+    hash.append(vec.size());
+
+    // Hash large arrays in chunks since MurmurHash only supports up to 2 GB at a time.
+    const size_t ChunkSize = 1024 * 1024 * 1024;
+    const std::uint8_t* data = reinterpret_cast<const std::uint8_t*>(vec.data());
+    size_t remaining = vec.size() * sizeof(ValueType);
+
+    while (remaining > 0)
+    {
+        const size_t size = std::min(remaining, ChunkSize);
+        hash.append(data, size);
+        data += size;
+        remaining -= size;
+    }
+}
+
+}   // namespace renderer
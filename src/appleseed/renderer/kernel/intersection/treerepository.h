@@ -61,6 +61,13 @@ class TreeRepository
     LazyTreeType* acquire(const std::uint64_t key);
     void release(LazyTreeType* tree);
 
+    // Update an already constructed tree in place for new content identified by new_key,
+    // by calling func(tree). This is only attempted when no one else references the tree
+    // and no other tree already matches the new content. Return false if func() failed or
+    // if the update was not attempted, in which case the tree must be rebuilt instead.
+    template <typename Func>
+    bool update(LazyTreeType* tree, const std::uint64_t new_key, Func& func);
+
     template <typename Func>
     void for_each(Func& func);
 
@@ -135,6 +142,41 @@ void TreeRepository<TreeType>::release(LazyTreeType* tree)
     }
 }
 
+template <typename TreeType>
+template <typename Func>
+bool TreeRepository<TreeType>::update(LazyTreeType* tree, const std::uint64_t new_key, Func& func)
+{
+    const typename TreeIndex::iterator i = m_index.find(tree);
+    assert(i != m_index.end());
+
+    const typename TreeContainer::iterator t = m_trees.find(i->second);
+    assert(t != m_trees.end());
+
+    // Don't modify a tree that is shared with other assemblies.
+    if (t->second.m_ref > 1)
+        return false;
+
+    // Prefer sharing an existing tree matching the new content.
+    if (new_key != i->second && m_trees.find(new_key) != m_trees.end())
+        return false;
+
+    // Trees that were never constructed are cheaper to rebuild.
+    TreeType* object = tree->get_constructed_object();
+    if (object == nullptr || !func(*object))
+        return false;
+
+    // Index the tree under its new key.
+    if (new_key != i->second)
+    {
+        const TreeInfo info = t->second;
+        m_trees.erase(t);
+        m_trees.insert(std::make_pair(new_key, info));
+        i->second = new_key;
+    }
+
+    return true;
+}
+
 template <typename TreeType>
 template <typename Func>
 void TreeRepository<TreeType>::for_each(Func& func)
@@ -33,6 +33,7 @@
 // appleseed.renderer headers.
 #include "renderer/global/globallogger.h"
 #include "renderer/kernel/intersection/intersectionfilter.h"
+#include "renderer/kernel/intersection/treecache.h"
 #include "renderer/kernel/intersection/triangleencoder.h"
 #include "renderer/kernel/intersection/triangleitemhandler.h"
 #include "renderer/kernel/intersection/trianglevertexinfo.h"
@@ -54,6 +55,7 @@
 #include "renderer/utility/paramarray.h"
 
 // appleseed.foundation headers.
+#include "foundation/hash/murmurhash.h"
 #include "foundation/math/area.h"
 #include "foundation/math/intersection/aabbtriangle.h"
 #include "foundation/math/scalar.h"
@@ -68,6 +70,7 @@
 #include "foundation/string/string.h"
 #include "foundation/utility/api/apistring.h"
 #include "foundation/utility/foreach.h"
+#include "foundation/utility/job.h"
 #include "foundation/utility/makevector.h"
 #include "foundation/utility/statistics.h"
 #include "foundation/utility/stopwatch.h"
@@ -75,6 +78,7 @@
 // Standard headers.
 #include <algorithm>
 #include <cassert>
+#include <memory>
 #include <set>
 #include <string>
 
@@ -386,11 +390,15 @@ TriangleTree::Arguments::Arguments(
     const Scene&            scene,
     const UniqueID          triangle_tree_uid,
     const GAABB3&           bbox,
-    const Assembly&         assembly)
+    const Assembly&         assembly,
+    const std::string&      cache_directory,
+    const size_t            thread_count)
   : m_scene(scene)
   , m_triangle_tree_uid(triangle_tree_uid)
   , m_bbox(bbox)
   , m_assembly(assembly)
+  , m_cache_directory(cache_directory)
+  , m_thread_count(thread_count)
 {
 }
 
@@ -405,26 +413,74 @@ TriangleTree::TriangleTree(const Arguments& arguments)
     const std::string algorithm = params.get_optional<std::string>("algorithm", "bvh", make_vector("bvh", "sbvh"), message_context);
     const double time = params.get_optional<double>("time", 0.5);
     const bool save_memory = params.get_optional<bool>("save_temporary_memory", false);
+    const bool wide_bvh = params.get_optional<bool>("wide_bvh", true);
+    const size_t thread_count = m_arguments.m_thread_count;
 
     // Start stopwatch.
     Stopwatch<DefaultWallclockTimer> stopwatch;
     stopwatch.start();
 
-    // Build the tree.
+    // Look the tree up in the tree cache.
+    const bool use_cache = !m_arguments.m_cache_directory.empty();
+    const MurmurHash cache_key =
+        use_cache ? compute_cache_key(params, algorithm, time) : MurmurHash();
+    const bool loaded_from_cache = use_cache && load_from_cache(cache_key);
+
     Statistics statistics;
-    if (algorithm == "bvh")
-        build_bvh(params, time, save_memory, statistics);
-    else build_sbvh(params, time, save_memory, statistics);
-    statistics.insert_time("total build time", stopwatch.measure().get_seconds());
-    statistics.insert_size("nodes alignment", alignment(&m_nodes[0]));
+
+    if (loaded_from_cache)
+    {
+        statistics.insert_time("cache load time", stopwatch.measure().get_seconds());
+        statistics.insert_size("nodes alignment", alignment(&m_nodes[0]));
+    }
+    else
+    {
+        // Build the tree.
+        if (algorithm == "bvh")
+            build_bvh(params, time, save_memory, thread_count, statistics);
+        else build_sbvh(params, time, save_memory, thread_count, statistics);
+        statistics.insert_time("total build time", stopwatch.measure().get_seconds());
+        statistics.insert_size("nodes alignment", alignment(&m_nodes[0]));
 
 #ifdef RENDERER_TRIANGLE_TREE_REORDER_NODES
-    // Optimize the tree layout in memory.
-    TreeOptimizer<NodeVectorType> tree_optimizer(m_nodes);
-    tree_optimizer.optimize_node_layout(TriangleTreeSubtreeDepth);
-    assert(m_nodes.size() == m_nodes.capacity());
+        // Optimize the tree layout in memory.
+        TreeOptimizer<NodeVectorType> tree_optimizer(m_nodes);
+        tree_optimizer.optimize_node_layout(TriangleTreeSubtreeDepth);
+        assert(m_nodes.size() == m_nodes.capacity());
 #endif
 
+        // Store the tree into the tree cache.
+        if (use_cache)
+        {
+            stopwatch.start();
+            save_to_cache(cache_key);
+            statistics.insert_time("cache save time", stopwatch.measure().get_seconds());
+        }
+    }
+
+    // Collapse the tree into a wide BVH for faster traversal of static geometry.
+    // The wide BVH replaces the interior nodes of the binary tree.
+    if (wide_bvh && m_moving_triangle_count == 0)
+    {
+        stopwatch.start();
+        if (m_wide_tree.build(*this))
+        {
+            m_wide_tree.remove_interior_nodes(*this);
+            statistics.insert_time("wide bvh build time", stopwatch.measure().get_seconds());
+            statistics.insert("wide bvh nodes", m_wide_tree.get_node_count());
+            statistics.insert_size("wide bvh size", m_wide_tree.get_memory_size());
+        }
+        else
+        {
+            RENDERER_LOG_WARNING(
+                "triangle tree #" FMT_UNIQUE_ID " is too deep for a wide bvh, keeping the binary bvh.",
+                m_arguments.m_triangle_tree_uid);
+        }
+    }
+
+    // Remember the quality of the tree to decide when refitting it is no longer worth it.
+    m_build_sah_cost = compute_sah_cost();
+
     // Print triangle tree statistics.
     RENDERER_LOG_DEBUG("%s",
         StatisticsVector::make(
@@ -456,7 +512,9 @@ size_t TriangleTree::get_memory_size() const
         - sizeof(*static_cast<const TreeType*>(this))
         + sizeof(*this)
         + m_triangle_keys.capacity() * sizeof(TriangleKey)
-        + m_leaf_data.capacity() * sizeof(std::uint8_t);
+        + m_leaf_data.capacity() * sizeof(std::uint8_t)
+        - sizeof(m_wide_tree)
+        + m_wide_tree.get_memory_size();
 }
 
 namespace
@@ -492,12 +550,366 @@ namespace
 
         return count;
     }
+
+    //
+    // A job invoking a function on a range of items.
+    //
+
+    template <typename Function>
+    class RangeJob
+      : public IJob
+    {
+      public:
+        RangeJob(
+            const Function&     function,
+            const size_t        begin,
+            const size_t        end)
+          : m_function(function)
+          , m_begin(begin)
+          , m_end(end)
+        {
+        }
+
+        void execute(const size_t thread_index) override
+        {
+            m_function(m_begin, m_end);
+        }
+
+      private:
+        const Function&         m_function;
+        const size_t            m_begin;
+        const size_t            m_end;
+    };
+
+    // Invoke function(begin, end) on consecutive ranges of [0, item_count), in parallel.
+    template <typename Function>
+    void parallel_for_ranges(
+        const size_t            item_count,
+        const size_t            thread_count,
+        const Function&         function)
+    {
+        const size_t MinRangeSize = 1024;
+
+        const size_t range_count =
+            std::min(
+                std::max<size_t>(item_count / MinRangeSize, 1),
+                thread_count * 4);
+
+        if (thread_count < 2 || range_count < 2)
+        {
+            function(0, item_count);
+            return;
+        }
+
+        std::vector<std::unique_ptr<RangeJob<Function>>> jobs;
+        for (size_t i = 0; i < range_count; ++i)
+        {
+            jobs.emplace_back(
+                new RangeJob<Function>(
+                    function,
+                    i * item_count / range_count,
+                    (i + 1) * item_count / range_count));
+        }
+
+        JobQueue job_queue;
+        JobManager job_manager(
+            global_logger(),
+            job_queue,
+            std::min(thread_count, range_count));
+
+        for (const auto& job : jobs)
+            job_queue.schedule(job.get(), false);
+
+        job_manager.start();
+        job_queue.wait_until_completion();
+    }
+}
+
+MurmurHash TriangleTree::compute_cache_key(
+    const ParamArray&   params,
+    const std::string&  algorithm,
+    const double        time) const
+{
+    MurmurHash key;
+
+    // Memory layout of the tree.
+    key.append(sizeof(NodeType));
+    key.append(sizeof(TriangleKey));
+    key.append(sizeof(GScalar));
+#ifdef RENDERER_TRIANGLE_TREE_REORDER_NODES
+    key.append(TriangleTreeSubtreeDepth);
+#endif
+
+    // Construction parameters.
+    key.append(algorithm);
+    key.append(time);
+    key.append(params.get_optional<size_t>("max_leaf_size", TriangleTreeDefaultMaxLeafSize));
+    key.append(params.get_optional<size_t>("bin_count", TriangleTreeDefaultBinCount));
+    key.append(params.get_optional<GScalar>("interior_node_traversal_cost", TriangleTreeDefaultInteriorNodeTraversalCost));
+    key.append(params.get_optional<GScalar>("triangle_intersection_cost", TriangleTreeDefaultTriangleIntersectionCost));
+    key.append(m_arguments.m_bbox);
+
+    // Geometry.
+    const ObjectInstanceContainer& object_instances = m_arguments.m_assembly.object_instances();
+    std::vector<GVector3> vertex_poses;
+    for (size_t i = 0, e = object_instances.size(); i < e; ++i)
+    {
+        const ObjectInstance* object_instance = object_instances.get_by_index(i);
+        assert(object_instance);
+
+        const Object& object = object_instance->get_object();
+        if (strcmp(object.get_model(), MeshObjectFactory().get_model()) != 0)
+            continue;
+
+        const MeshObject& mesh = static_cast<const MeshObject&>(object);
+        const StaticTriangleTess& tess = mesh.get_static_triangle_tess();
+
+        key.append(i);
+        key.append(object_instance->get_transform().get_local_to_parent());
+        key.append(object_instance->get_vis_flags());
+        hash_vector(key, tess.m_vertices);
+        hash_vector(key, tess.m_primitives);
+
+        const size_t vertex_count = tess.m_vertices.size();
+        const size_t motion_segment_count = tess.get_motion_segment_count();
+        key.append(motion_segment_count);
+
+        for (size_t m = 0; m < motion_segment_count; ++m)
+        {
+            vertex_poses.resize(vertex_count);
+            for (size_t v = 0; v < vertex_count; ++v)
+                vertex_poses[v] = tess.get_vertex_pose(v, m);
+            hash_vector(key, vertex_poses);
+        }
+    }
+
+    return key;
+}
+
+bool TriangleTree::load_from_cache(const MurmurHash& key)
+{
+    TreeCacheReader reader(m_arguments.m_cache_directory, "triangletree", key);
+
+    if (!reader.is_open())
+        return false;
+
+    if (reader.read(m_nodes) &&
+        reader.read(m_node_bboxes) &&
+        reader.read(m_triangle_keys) &&
+        reader.read(m_leaf_data) &&
+        reader.read_value(m_static_triangle_count) &&
+        reader.read_value(m_moving_triangle_count) &&
+        !m_nodes.empty())
+    {
+        RENDERER_LOG_INFO(
+            "loaded triangle tree #" FMT_UNIQUE_ID " from tree cache (%s %s, %s %s).",
+            m_arguments.m_triangle_tree_uid,
+            pretty_uint(m_static_triangle_count).c_str(),
+            plural(m_static_triangle_count, "static triangle").c_str(),
+            pretty_uint(m_moving_triangle_count).c_str(),
+            plural(m_moving_triangle_count, "moving triangle").c_str());
+        return true;
+    }
+
+    RENDERER_LOG_WARNING(
+        "ignoring invalid tree cache entry for triangle tree #" FMT_UNIQUE_ID ".",
+        m_arguments.m_triangle_tree_uid);
+
+    // Leave the tree empty so that it gets rebuilt from scratch.
+    clear();
+    m_node_bboxes.clear();
+    m_triangle_keys.clear();
+    m_leaf_data.clear();
+
+    return false;
+}
+
+void TriangleTree::save_to_cache(const MurmurHash& key) const
+{
+    TreeCacheWriter writer(m_arguments.m_cache_directory, "triangletree", key);
+
+    if (!writer.is_open())
+        return;
+
+    writer.write(m_nodes);
+    writer.write(m_node_bboxes);
+    writer.write(m_triangle_keys);
+    writer.write(m_leaf_data);
+    writer.write_value(m_static_triangle_count);
+    writer.write_value(m_moving_triangle_count);
+
+    writer.commit();
+}
+
+bool TriangleTree::refit(const GAABB3& bbox)
+{
+    // Trees containing moving triangles store per-node motion bounding boxes and are always rebuilt.
+    if (m_moving_triangle_count > 0)
+        return false;
+
+    Stopwatch<DefaultWallclockTimer> stopwatch;
+    stopwatch.start();
+
+    const ParamArray& params = m_arguments.m_assembly.get_parameters().child("acceleration_structure");
+    const double time = params.get_optional<double>("time", 0.5);
+    const bool save_memory = params.get_optional<bool>("save_temporary_memory", false);
+    const size_t thread_count = m_arguments.m_thread_count;
+
+    // Collect the triangles intersecting the new bounding box of the tree.
+    const Arguments arguments(
+        m_arguments.m_scene,
+        m_arguments.m_triangle_tree_uid,
+        bbox,
+        m_arguments.m_assembly,
+        m_arguments.m_cache_directory,
+        m_arguments.m_thread_count);
+    std::vector<TriangleKey> triangle_keys;
+    std::vector<TriangleVertexInfo> triangle_vertex_infos;
+    std::vector<GVector3> triangle_vertices;
+    std::vector<GAABB3> triangle_bboxes;
+    collect_triangles(
+        arguments,
+        time,
+        save_memory,
+        &triangle_keys,
+        &triangle_vertex_infos,
+        &triangle_vertices,
+        &triangle_bboxes);
+
+    if (count_static_triangles(triangle_vertex_infos) != triangle_vertex_infos.size())
+        return false;
+
+    // Find the collected triangle referenced by each triangle key stored in the tree.
+    // Collected triangles are sorted by object instance index, then by triangle index.
+    const auto key_less = [](const TriangleKey& lhs, const TriangleKey& rhs)
+    {
+        return
+            lhs.get_object_instance_index() != rhs.get_object_instance_index()
+                ? lhs.get_object_instance_index() < rhs.get_object_instance_index()
+                : lhs.get_triangle_index() < rhs.get_triangle_index();
+    };
+
+    std::vector<size_t> triangle_indices(m_triangle_keys.size());
+    std::vector<bool> referenced(triangle_keys.size(), false);
+    size_t referenced_count = 0;
+
+    for (size_t i = 0, e = m_triangle_keys.size(); i < e; ++i)
+    {
+        const auto it =
+            std::lower_bound(
+                triangle_keys.begin(),
+                triangle_keys.end(),
+                m_triangle_keys[i],
+                key_less);
+
+        // The topology of the tree changed if a triangle is no longer there.
+        if (it == triangle_keys.end() || key_less(m_triangle_keys[i], *it))
+            return false;
+
+        const size_t triangle_index = it - triangle_keys.begin();
+        triangle_indices[i] = triangle_index;
+
+        if (!referenced[triangle_index])
+        {
+            referenced[triangle_index] = true;
+            ++referenced_count;
+        }
+    }
+
+    // The topology of the tree changed if new triangles must be inserted.
+    if (referenced_count != triangle_keys.size())
+        return false;
+
+    // Recompute the bounding boxes of the nodes.
+    const auto leaf_bbox_func = [&](const NodeType& node)
+    {
+        GAABB3 leaf_bbox;
+        leaf_bbox.invalidate();
+
+        for (size_t i = 0, e = node.get_item_count(); i < e; ++i)
+            leaf_bbox.insert(triangle_bboxes[triangle_indices[node.get_item_index() + i]]);
+
+        return AABB3d(leaf_bbox);
+    };
+
+    if (has_wide_tree())
+        m_wide_tree.refit(*this, leaf_bbox_func);
+    else
+    {
+        bvh::Refitter<TriangleTree> refitter;
+        refitter.refit(*this, leaf_bbox_func);
+    }
+
+    // Rebuild the tree if its quality degraded too much. The tree is left in a
+    // valid state either way since its nodes enclose the new triangles.
+    const double sah_cost = compute_sah_cost();
+    if (sah_cost > m_build_sah_cost * TriangleTreeMaxRefitCostRatio)
+    {
+        RENDERER_LOG_DEBUG(
+            "triangle tree #" FMT_UNIQUE_ID " degraded too much to be refitted (sah cost %f, was %f).",
+            m_arguments.m_triangle_tree_uid,
+            sah_cost,
+            m_build_sah_cost);
+        return false;
+    }
+
+    // Store the new triangles into the tree.
+    Statistics statistics;
+    store_triangles(
+        triangle_indices,
+        triangle_vertex_infos,
+        triangle_vertices,
+        triangle_keys,
+        thread_count,
+        statistics);
+
+    RENDERER_LOG_INFO(
+        "refitted triangle tree #" FMT_UNIQUE_ID " in %s.",
+        m_arguments.m_triangle_tree_uid,
+        pretty_time(stopwatch.measure().get_seconds()).c_str());
+
+    return true;
+}
+
+double TriangleTree::compute_sah_cost() const
+{
+    const ParamArray& params = m_arguments.m_assembly.get_parameters().child("acceleration_structure");
+    const double interior_node_traversal_cost =
+        params.get_optional<GScalar>("interior_node_traversal_cost", TriangleTreeDefaultInteriorNodeTraversalCost);
+    const double triangle_intersection_cost =
+        params.get_optional<GScalar>("triangle_intersection_cost", TriangleTreeDefaultTriangleIntersectionCost);
+
+    if (has_wide_tree())
+    {
+        return
+            m_wide_tree.compute_sah_cost(
+                *this,
+                interior_node_traversal_cost,
+                triangle_intersection_cost);
+    }
+
+    const NodeType& root = m_nodes.front();
+
+    if (root.is_leaf())
+        return 0.0;
+
+    AABB3d root_bbox = root.get_left_bbox();
+    root_bbox.insert(root.get_right_bbox());
+
+    bvh::Refitter<TriangleTree> refitter;
+    return
+        refitter.compute_sah_cost(
+            *this,
+            root_bbox,
+            interior_node_traversal_cost,
+            triangle_intersection_cost);
 }
 
 void TriangleTree::build_bvh(
     const ParamArray&   params,
     const double        time,
     const bool          save_memory,
+    const size_t        thread_count,
     Statistics&         statistics)
 {
     Stopwatch<DefaultWallclockTimer> stopwatch;
@@ -548,13 +960,15 @@ void TriangleTree::build_bvh(
         triangle_intersection_cost);
 
     // Build the tree.
-    typedef bvh::Builder<TriangleTree, Partitioner> Builder;
-    Builder builder;
+    typedef bvh::ParallelBuilder<TriangleTree, Partitioner> Builder;
+    Builder builder(global_logger());
     builder.build<DefaultWallclockTimer>(
         *this,
         partitioner,
         triangle_keys.size(),
-        max_leaf_size);
+        max_leaf_size,
+        thread_count,
+        TriangleTreeMinBuildTaskSize);
     statistics.merge(
         bvh::TreeStatistics<TriangleTree>(*this, AABB3d(m_arguments.m_bbox)));
 
@@ -579,7 +993,7 @@ void TriangleTree::build_bvh(
         partitioner.get_item_ordering(),
         triangle_vertex_infos,
         triangle_vertices,
-        0);
+        thread_count);
 
     // Store triangles and triangle keys into the tree.
     store_triangles(
@@ -587,10 +1001,13 @@ void TriangleTree::build_bvh(
         triangle_vertex_infos,
         triangle_vertices,
         triangle_keys,
+        thread_count,
         statistics);
 
     const double store_time = stopwatch.measure().get_seconds();
 
+    statistics.insert("build threads", thread_count);
+    statistics.insert("partition tasks", builder.get_task_count());
     statistics.insert_time("collection time", collection_time);
     statistics.insert_time("partition time", builder.get_build_time());
     statistics.insert_time("store time", store_time);
@@ -600,6 +1017,7 @@ void TriangleTree::build_sbvh(
     const ParamArray&   params,
     const double        time,
     const bool          save_memory,
+    const size_t        thread_count,
     Statistics&         statistics)
 {
     Stopwatch<DefaultWallclockTimer> stopwatch;
@@ -644,8 +1062,8 @@ void TriangleTree::build_sbvh(
     const GScalar triangle_intersection_cost = params.get_optional<GScalar>("triangle_intersection_cost", TriangleTreeDefaultTriangleIntersectionCost);
 
     // Create the partitioner.
-    typedef bvh::SBVHPartitioner<TriangleItemHandler, std::vector<AABB3d>> Partitioner;
-    TriangleItemHandler triangle_handler(
+    typedef bvh::SBVHPartitioner<const TriangleItemHandler, std::vector<AABB3d>> Partitioner;
+    const TriangleItemHandler triangle_handler(
         triangle_vertex_infos,
         triangle_vertices,
         triangle_bboxes);
@@ -662,13 +1080,15 @@ void TriangleTree::build_sbvh(
     const AABB3d root_leaf_bbox = partitioner.compute_leaf_bbox(*root_leaf);
 
     // Build the tree.
-    typedef bvh::SpatialBuilder<TriangleTree, Partitioner> Builder;
-    Builder builder;
+    typedef bvh::ParallelSpatialBuilder<TriangleTree, Partitioner> Builder;
+    Builder builder(global_logger());
     builder.build<DefaultWallclockTimer>(
         *this,
         partitioner,
         root_leaf,
-        root_leaf_bbox);
+        root_leaf_bbox,
+        thread_count,
+        TriangleTreeMinBuildTaskSize);
     statistics.merge(bvh::TreeStatistics<TriangleTree>(*this, AABB3d(m_arguments.m_bbox)));
 
     // Add splits statistics.
@@ -690,7 +1110,7 @@ void TriangleTree::build_sbvh(
         partitioner.get_item_ordering(),
         triangle_vertex_infos,
         triangle_vertices,
-        0);
+        thread_count);
 
     // Store triangles and triangle keys into the tree.
     store_triangles(
@@ -698,10 +1118,13 @@ void TriangleTree::build_sbvh(
         triangle_vertex_infos,
         triangle_vertices,
         triangle_keys,
+        thread_count,
         statistics);
 
     const double store_time = stopwatch.measure().get_seconds();
 
+    statistics.insert("build threads", thread_count);
+    statistics.insert("partition tasks", builder.get_task_count());
     statistics.insert_time("collection time", collection_time);
     statistics.insert_time("partition time", builder.get_build_time());
     statistics.insert_time("store time", store_time);
@@ -752,61 +1175,14 @@ namespace
 #endif
 }
 
-std::vector<GAABB3> TriangleTree::compute_motion_bboxes(
-    const std::vector<size_t>&               triangle_indices,
-    const std::vector<TriangleVertexInfo>&   triangle_vertex_infos,
-    const std::vector<GVector3>&             triangle_vertices,
-    const size_t                             node_index)
+namespace
 {
-    NodeType& node = m_nodes[node_index];
-
-    if (node.is_interior())
-    {
-        const std::vector<GAABB3> left_bboxes =
-            compute_motion_bboxes(
-                triangle_indices,
-                triangle_vertex_infos,
-                triangle_vertices,
-                node.get_child_node_index() + 0);
-
-        const std::vector<GAABB3> right_bboxes =
-            compute_motion_bboxes(
-                triangle_indices,
-                triangle_vertex_infos,
-                triangle_vertices,
-                node.get_child_node_index() + 1);
-
-        node.set_left_bbox_count(left_bboxes.size());
-        node.set_right_bbox_count(right_bboxes.size());
-
-        if (left_bboxes.size() > 1)
-        {
-            node.set_left_bbox_index(m_node_bboxes.size());
-
-            for (std::vector<GAABB3>::const_iterator i = left_bboxes.begin(); i != left_bboxes.end(); ++i)
-                m_node_bboxes.push_back(swizzle(AABB3d(*i)));
-        }
-
-        if (right_bboxes.size() > 1)
-        {
-            node.set_right_bbox_index(m_node_bboxes.size());
-
-            for (std::vector<GAABB3>::const_iterator i = right_bboxes.begin(); i != right_bboxes.end(); ++i)
-                m_node_bboxes.push_back(swizzle(AABB3d(*i)));
-        }
-
-        const size_t bbox_count = std::max(left_bboxes.size(), right_bboxes.size());
-        std::vector<GAABB3> bboxes(bbox_count);
-
-        for (size_t i = 0; i < bbox_count; ++i)
-        {
-            bboxes[i] = left_bboxes[i * left_bboxes.size() / bbox_count];
-            bboxes[i].insert(right_bboxes[i * right_bboxes.size() / bbox_count]);
-        }
-
-        return bboxes;
-    }
-    else
+    // Compute the bounding boxes of the triangles of a leaf, for each motion step.
+    std::vector<GAABB3> compute_leaf_motion_bboxes(
+        const TriangleTreeNodeType&             node,
+        const std::vector<size_t>&              triangle_indices,
+        const std::vector<TriangleVertexInfo>&  triangle_vertex_infos,
+        const std::vector<GVector3>&            triangle_vertices)
     {
         const size_t item_begin = node.get_item_index();
         const size_t item_count = node.get_item_count();
@@ -875,104 +1251,219 @@ std::vector<GAABB3> TriangleTree::compute_motion_bboxes(
     }
 }
 
+void TriangleTree::compute_motion_bboxes(
+    const std::vector<size_t>&               triangle_indices,
+    const std::vector<TriangleVertexInfo>&   triangle_vertex_infos,
+    const std::vector<GVector3>&             triangle_vertices,
+    const size_t                             thread_count)
+{
+    // Compute the bounding boxes of the leaves in parallel.
+    std::vector<std::vector<GAABB3>> leaf_bboxes(m_nodes.size());
+    parallel_for_ranges(
+        m_nodes.size(),
+        thread_count,
+        [&](const size_t begin, const size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+            {
+                const NodeType& node = m_nodes[i];
+
+                if (node.is_leaf())
+                {
+                    leaf_bboxes[i] =
+                        compute_leaf_motion_bboxes(
+                            node,
+                            triangle_indices,
+                            triangle_vertex_infos,
+                            triangle_vertices);
+                }
+            }
+        });
+
+    // Propagate them up the tree.
+    propagate_motion_bboxes(leaf_bboxes, 0);
+}
+
+std::vector<GAABB3> TriangleTree::propagate_motion_bboxes(
+    std::vector<std::vector<GAABB3>>&        leaf_bboxes,
+    const size_t                             node_index)
+{
+    NodeType& node = m_nodes[node_index];
+
+    if (node.is_interior())
+    {
+        const std::vector<GAABB3> left_bboxes =
+            propagate_motion_bboxes(
+                leaf_bboxes,
+                node.get_child_node_index() + 0);
+
+        const std::vector<GAABB3> right_bboxes =
+            propagate_motion_bboxes(
+                leaf_bboxes,
+                node.get_child_node_index() + 1);
+
+        node.set_left_bbox_count(left_bboxes.size());
+        node.set_right_bbox_count(right_bboxes.size());
+
+        if (left_bboxes.size() > 1)
+        {
+            node.set_left_bbox_index(m_node_bboxes.size());
+
+            for (std::vector<GAABB3>::const_iterator i = left_bboxes.begin(); i != left_bboxes.end(); ++i)
+                m_node_bboxes.push_back(swizzle(AABB3d(*i)));
+        }
+
+        if (right_bboxes.size() > 1)
+        {
+            node.set_right_bbox_index(m_node_bboxes.size());
+
+            for (std::vector<GAABB3>::const_iterator i = right_bboxes.begin(); i != right_bboxes.end(); ++i)
+                m_node_bboxes.push_back(swizzle(AABB3d(*i)));
+        }
+
+        const size_t bbox_count = std::max(left_bboxes.size(), right_bboxes.size());
+        std::vector<GAABB3> bboxes(bbox_count);
+
+        for (size_t i = 0; i < bbox_count; ++i)
+        {
+            bboxes[i] = left_bboxes[i * left_bboxes.size() / bbox_count];
+            bboxes[i].insert(right_bboxes[i * right_bboxes.size() / bbox_count]);
+        }
+
+        return bboxes;
+    }
+    else return std::move(leaf_bboxes[node_index]);
+}
+
 void TriangleTree::store_triangles(
     const std::vector<size_t>&               triangle_indices,
     const std::vector<TriangleVertexInfo>&   triangle_vertex_infos,
     const std::vector<GVector3>&             triangle_vertices,
     const std::vector<TriangleKey>&          triangle_keys,
+    const size_t                             thread_count,
     Statistics&                              statistics)
 {
     const size_t node_count = m_nodes.size();
 
-    // Gather statistics.
+    // Collect the leaves.
 
-    size_t leaf_count = 0;
-    size_t fat_leaf_count = 0;
-    size_t leaf_data_size = 0;
+    std::vector<size_t> leaf_nodes;
 
     for (size_t i = 0; i < node_count; ++i)
     {
-        const NodeType& node = m_nodes[i];
+        if (m_nodes[i].is_leaf())
+            leaf_nodes.push_back(i);
+    }
+
+    const size_t leaf_count = leaf_nodes.size();
+
+    // Compute the size of the encoded triangles of each leaf.
+
+    std::vector<size_t> leaf_sizes(leaf_count);
 
-        if (node.is_leaf())
+    parallel_for_ranges(
+        leaf_count,
+        thread_count,
+        [&](const size_t begin, const size_t end)
         {
-            ++leaf_count;
+            for (size_t i = begin; i < end; ++i)
+            {
+                const NodeType& node = m_nodes[leaf_nodes[i]];
+
+                leaf_sizes[i] =
+                    TriangleEncoder::compute_size(
+                        triangle_vertex_infos,
+                        triangle_indices,
+                        node.get_item_index(),
+                        node.get_item_count());
+            }
+        });
 
-            const size_t item_begin = node.get_item_index();
-            const size_t item_count = node.get_item_count();
+    // Assign storage to the leaves, in tree order. Fat leaves store their triangles
+    // directly in their user data, other leaves store them in the leaf data array.
 
-            const size_t leaf_size =
-                TriangleEncoder::compute_size(
-                    triangle_vertex_infos,
-                    triangle_indices,
-                    item_begin,
-                    item_count);
+    const size_t InlineLeafSize = NodeType::MaxUserDataSize - sizeof(std::uint32_t);
+    const size_t NoLeafDataOffset = ~size_t(0);
+
+    std::vector<size_t> key_offsets(leaf_count);
+    std::vector<size_t> leaf_data_offsets(leaf_count);
+
+    size_t key_count = 0;
+    size_t fat_leaf_count = 0;
+    size_t leaf_data_size = 0;
 
-            if (leaf_size < NodeType::MaxUserDataSize)
-                ++fat_leaf_count;
-            else leaf_data_size += leaf_size;
+    for (size_t i = 0; i < leaf_count; ++i)
+    {
+        key_offsets[i] = key_count;
+        key_count += m_nodes[leaf_nodes[i]].get_item_count();
+
+        if (leaf_sizes[i] <= InlineLeafSize)
+        {
+            leaf_data_offsets[i] = NoLeafDataOffset;
+            ++fat_leaf_count;
+        }
+        else
+        {
+            leaf_data_offsets[i] = leaf_data_size;
+            leaf_data_size += leaf_sizes[i];
         }
     }
 
     // Store triangle keys and triangles.
 
-    m_triangle_keys.reserve(triangle_indices.size());
+    m_triangle_keys.resize(key_count);
     m_leaf_data.resize(leaf_data_size);
 
-    MemoryWriter leaf_data_writer(m_leaf_data.empty() ? nullptr : &m_leaf_data[0]);
-
-    for (size_t i = 0; i < node_count; ++i)
-    {
-        NodeType& node = m_nodes[i];
-
-        if (node.is_leaf())
+    parallel_for_ranges(
+        leaf_count,
+        thread_count,
+        [&](const size_t begin, const size_t end)
         {
-            const size_t item_begin = node.get_item_index();
-            const size_t item_count = node.get_item_count();
+            for (size_t i = begin; i < end; ++i)
+            {
+                NodeType& node = m_nodes[leaf_nodes[i]];
 
-            node.set_item_index(m_triangle_keys.size());
+                const size_t item_begin = node.get_item_index();
+                const size_t item_count = node.get_item_count();
 
-            for (size_t j = 0; j < item_count; ++j)
-            {
-                const size_t triangle_index = triangle_indices[item_begin + j];
-                m_triangle_keys.push_back(triangle_keys[triangle_index]);
-            }
+                node.set_item_index(key_offsets[i]);
 
-            const size_t leaf_size =
-                TriangleEncoder::compute_size(
-                    triangle_vertex_infos,
-                    triangle_indices,
-                    item_begin,
-                    item_count);
+                for (size_t j = 0; j < item_count; ++j)
+                {
+                    const size_t triangle_index = triangle_indices[item_begin + j];
+                    m_triangle_keys[key_offsets[i] + j] = triangle_keys[triangle_index];
+                }
 
-            MemoryWriter user_data_writer(&node.get_user_data<std::uint8_t>());
+                MemoryWriter user_data_writer(&node.get_user_data<std::uint8_t>());
 
-            if (leaf_size <= NodeType::MaxUserDataSize - sizeof(std::uint32_t))
-            {
-                user_data_writer.write<std::uint32_t>(~std::uint32_t(0));
+                if (leaf_data_offsets[i] == NoLeafDataOffset)
+                {
+                    user_data_writer.write<std::uint32_t>(~std::uint32_t(0));
+
+                    TriangleEncoder::encode(
+                        triangle_vertex_infos,
+                        triangle_vertices,
+                        triangle_indices,
+                        item_begin,
+                        item_count,
+                        user_data_writer);
+                }
+                else
+                {
+                    user_data_writer.write(static_cast<std::uint32_t>(leaf_data_offsets[i]));
 
-                TriangleEncoder::encode(
-                    triangle_vertex_infos,
-                    triangle_vertices,
-                    triangle_indices,
-                    item_begin,
-                    item_count,
-                    user_data_writer);
-            }
-            else
-            {
-                user_data_writer.write(static_cast<std::uint32_t>(leaf_data_writer.offset()));
+                    MemoryWriter leaf_data_writer(&m_leaf_data[leaf_data_offsets[i]]);
 
-                TriangleEncoder::encode(
-                    triangle_vertex_infos,
-                    triangle_vertices,
-                    triangle_indices,
-                    item_begin,
-                    item_count,
-                    leaf_data_writer);
+                    TriangleEncoder::encode(
+                        triangle_vertex_infos,
+                        triangle_vertices,
+                        triangle_indices,
+                        item_begin,
+                        item_count,
+                        leaf_data_writer);
+                }
             }
-        }
-    }
+        });
 
     statistics.insert_percent("fat leaves", fat_leaf_count, leaf_count);
 }
@@ -52,9 +52,11 @@
 #include <cstdint>
 #include <map>
 #include <memory>
+#include <string>
 #include <vector>
 
 // Forward declarations.
+namespace foundation    { class MurmurHash; }
 namespace foundation    { class Statistics; }
 namespace renderer      { class Assembly; }
 namespace renderer      { class IntersectionFilter; }
@@ -74,9 +76,7 @@ typedef std::map<std::uint64_t, IntersectionFilter*> IntersectionFilterRepositor
 
 class TriangleTree
   : public foundation::bvh::Tree<
-               foundation::AlignedVector<
-                   foundation::bvh::Node<foundation::AABB3d>
-               >
+               foundation::AlignedVector<TriangleTreeNodeType>
            >
 {
   public:
@@ -87,13 +87,17 @@ class TriangleTree
         const foundation::UniqueID              m_triangle_tree_uid;
         const GAABB3                            m_bbox;
         const Assembly&                         m_assembly;
+        const std::string                       m_cache_directory;  // tree cache disabled if empty
+        const size_t                            m_thread_count;     // number of build threads
 
         // Constructor.
         Arguments(
             const Scene&                        scene,
             const foundation::UniqueID          triangle_tree_uid,
             const GAABB3&                       bbox,
-            const Assembly&                     assembly);
+            const Assembly&                     assembly,
+            const std::string&                  cache_directory,
+            const size_t                        thread_count);
     };
 
     // Constructor, builds the tree for a given assembly.
@@ -105,6 +109,21 @@ class TriangleTree
     // Update the non-geometry aspects of the tree.
     void update_non_geometry(const bool enable_intersection_filters);
 
+    // Refit the tree to the current geometry of its assembly, keeping its topology.
+    // Return false if the tree must be rebuilt instead, for instance because triangles
+    // were added or removed, or because the quality of the tree degraded too much.
+    bool refit(const GAABB3& bbox);
+
+    typedef foundation::bvh::WideTree<TriangleTree, TriangleTreeWideBVHWidth> WideTreeType;
+
+    // Return true if this tree was collapsed into a wide BVH. In that case, only
+    // the leaf nodes of the binary tree are kept and the wide BVH must be used
+    // for traversal.
+    bool has_wide_tree() const;
+
+    // Return the wide BVH collapsed from this tree.
+    const WideTreeType& get_wide_tree() const;
+
     // Return the number of static and moving triangles.
     size_t get_static_triangle_count() const;
     size_t get_moving_triangle_count() const;
@@ -120,6 +139,7 @@ class TriangleTree
 
     size_t                                      m_static_triangle_count;
     size_t                                      m_moving_triangle_count;
+    double                                      m_build_sah_cost;
 
     std::vector<TriangleKey>                    m_triangle_keys;
     std::vector<std::uint8_t>                   m_leaf_data;
@@ -127,22 +147,41 @@ class TriangleTree
     IntersectionFilterRepository                m_intersection_filters_repository;
     std::vector<const IntersectionFilter*>      m_intersection_filters;
 
+    WideTreeType                                m_wide_tree;
+
+    // Compute a hash of everything the tree is built from, used to look up the tree cache.
+    foundation::MurmurHash compute_cache_key(
+        const ParamArray&                       params,
+        const std::string&                      algorithm,
+        const double                            time) const;
+
+    bool load_from_cache(const foundation::MurmurHash& key);
+    void save_to_cache(const foundation::MurmurHash& key) const;
+
+    double compute_sah_cost() const;
+
     void build_bvh(
         const ParamArray&                       params,
         const double                            time,
         const bool                              save_memory,
+        const size_t                            thread_count,
         foundation::Statistics&                 statistics);
 
     void build_sbvh(
         const ParamArray&                       params,
         const double                            time,
         const bool                              save_memory,
+        const size_t                            thread_count,
         foundation::Statistics&                 statistics);
 
-    std::vector<GAABB3> compute_motion_bboxes(
+    void compute_motion_bboxes(
         const std::vector<size_t>&              triangle_indices,
         const std::vector<TriangleVertexInfo>&  triangle_vertex_infos,
         const std::vector<GVector3>&            triangle_vertices,
+        const size_t                            thread_count);
+
+    std::vector<GAABB3> propagate_motion_bboxes(
+        std::vector<std::vector<GAABB3>>&       leaf_bboxes,
         const size_t                            node_index);
 
     void store_triangles(
@@ -150,6 +189,7 @@ class TriangleTree
         const std::vector<TriangleVertexInfo>&  triangle_vertex_infos,
         const std::vector<GVector3>&            triangle_vertices,
         const std::vector<TriangleKey>&         triangle_keys,
+        const size_t                            thread_count,
         foundation::Statistics&                 statistics);
 
     void update_intersection_filters();
@@ -287,11 +327,35 @@ typedef foundation::bvh::Intersector<
     TriangleTreeStackSize
 > TriangleTreeProbeIntersector;
 
+typedef foundation::bvh::WideIntersector<
+    TriangleTree,
+    TriangleLeafVisitor,
+    foundation::Ray3d,
+    TriangleTreeWideBVHWidth
+> TriangleTreeWideIntersector;
+
+typedef foundation::bvh::WideIntersector<
+    TriangleTree,
+    TriangleLeafProbeVisitor,
+    foundation::Ray3d,
+    TriangleTreeWideBVHWidth
+> TriangleTreeWideProbeIntersector;
+
 
 //
 // TriangleTree class implementation.
 //
 
+inline bool TriangleTree::has_wide_tree() const
+{
+    return !m_wide_tree.empty();
+}
+
+inline const TriangleTree::WideTreeType& TriangleTree::get_wide_tree() const
+{
+    return m_wide_tree;
+}
+
 inline size_t TriangleTree::get_static_triangle_count() const
 {
     return m_static_triangle_count;
@@ -38,6 +38,7 @@
 #include "renderer/modeling/light/light.h"
 #include "renderer/modeling/material/material.h"
 #include "renderer/modeling/scene/scene.h"
+#include "renderer/utility/settingsparsing.h"
 
 // Standard headers.
 #include <cassert>
@@ -78,6 +79,30 @@ Dictionary BackwardLightSampler::get_params_metadata()
                             .insert("label", "Light Tree")
                             .insert("help", "Lights organized in a BVH"))));
 
+    metadata.insert(
+        "enable_importance_caching",
+        Dictionary()
+            .insert("type", "bool")
+            .insert("default", "false")
+            .insert("label", "Enable Importance Caching")
+            .insert("help", "Learn which lights contribute to each region of the scene during the first passes and sample them more often (light tree only)"));
+
+    metadata.insert(
+        "importance_cache_resolution",
+        Dictionary()
+            .insert("type", "int")
+            .insert("default", "16")
+            .insert("label", "Importance Cache Resolution")
+            .insert("help", "Number of cells of the importance cache along each axis of the scene"));
+
+    metadata.insert(
+        "importance_cache_learning_passes",
+        Dictionary()
+            .insert("type", "int")
+            .insert("default", "4")
+            .insert("label", "Importance Cache Learning Passes")
+            .insert("help", "Number of passes during which light contributions are learned"));
+
     metadata.merge(LightSamplerBase::get_params_metadata());
 
     return metadata;
@@ -87,6 +112,9 @@ BackwardLightSampler::BackwardLightSampler(
     const Scene&                        scene,
     const ParamArray&                   params)
   : LightSamplerBase(params)
+  , m_importance_cache_learning_passes(0)
+  , m_importance_cache_pass_count(0)
+  , m_recording_lightset_samples(false)
 {
     // Read which sampling algorithm should be used.
     m_use_light_tree = params.get_optional<std::string>("algorithm", "cdf") == "lighttree";
@@ -169,12 +197,28 @@ BackwardLightSampler::BackwardLightSampler(
         m_light_tree.reset(new LightTree(m_light_tree_lights, m_emitting_shapes));
 
         // Build the light tree.
-        const std::vector<size_t> tri_index_to_node_index = m_light_tree->build();
+        const std::vector<size_t> tri_index_to_node_index =
+            m_light_tree->build(get_rendering_thread_count(params));
         assert(tri_index_to_node_index.size() == m_emitting_shapes.size());
 
         // Associate light tree nodes to emitting shapes.
         for (size_t i = 0, e = m_emitting_shapes.size(); i < e; ++i)
             m_emitting_shapes[i].m_light_tree_node_index = tri_index_to_node_index[i];
+
+        // Enable importance caching.
+        if (m_light_tree->is_built() &&
+            params.get_optional<bool>("enable_importance_caching", false))
+        {
+            const AABB3d scene_bbox(scene.compute_bbox());
+            if (scene_bbox.is_valid())
+            {
+                m_light_tree->enable_importance_cache(
+                    scene_bbox,
+                    params.get_optional<size_t>("importance_cache_resolution", 16));
+                m_importance_cache_learning_passes =
+                    params.get_optional<size_t>("importance_cache_learning_passes", 4);
+            }
+        }
     }
     else
     {
@@ -250,6 +294,40 @@ float BackwardLightSampler::evaluate_pdf(
     return shape_probability;
 }
 
+void BackwardLightSampler::on_pass_begin()
+{
+    m_recording_lightset_samples =
+        has_importance_cache() &&
+        m_importance_cache_pass_count < m_importance_cache_learning_passes;
+}
+
+void BackwardLightSampler::on_pass_end()
+{
+    if (!m_recording_lightset_samples)
+        return;
+
+    m_recording_lightset_samples = false;
+
+    m_light_tree->update_importance_cache();
+    ++m_importance_cache_pass_count;
+}
+
+void BackwardLightSampler::record_lightset_sample(
+    const ShadingPoint&                 shading_point,
+    const LightSample&                  light_sample,
+    const float                         contribution) const
+{
+    assert(has_importance_cache());
+
+    // Only emitting shapes can be attributed to a leaf of the light tree.
+    m_light_tree->record_contribution(
+        shading_point,
+        light_sample.m_shape != nullptr
+            ? light_sample.m_shape->m_light_tree_node_index
+            : ~size_t(0),
+        contribution);
+}
+
 void BackwardLightSampler::sample_light_tree(
     const ShadingRay::Time&             time,
     const Vector3f&                     s,
@@ -92,10 +92,30 @@ class BackwardLightSampler
         const ShadingPoint&                 light_shading_point,
         const ShadingPoint&                 surface_shading_point) const;
 
+    // Return true if the light tree learns light contributions in an importance cache.
+    bool has_importance_cache() const;
+
+    // Pass hooks driving the learning of the importance cache.
+    // Must not be called while the light set is being sampled.
+    void on_pass_begin();
+    void on_pass_end();
+
+    // Return true if light set samples should be reported with record_lightset_sample().
+    bool is_recording_lightset_samples() const;
+
+    // Report the contribution (divided by its probability) of a light set sample. Thread-safe.
+    void record_lightset_sample(
+        const ShadingPoint&                 shading_point,
+        const LightSample&                  light_sample,
+        const float                         contribution) const;
+
   private:
     bool                                    m_use_light_tree;
     NonPhysicalLightVector                  m_light_tree_lights;
     std::unique_ptr<LightTree>              m_light_tree;
+    size_t                                  m_importance_cache_learning_passes;
+    size_t                                  m_importance_cache_pass_count;
+    bool                                    m_recording_lightset_samples;
 
     void sample_light_tree(
         const ShadingRay::Time&             time,
@@ -127,4 +147,14 @@ inline bool BackwardLightSampler::has_lightset() const
     return !m_emitting_shapes.empty() || !m_light_tree_lights.empty();
 }
 
+inline bool BackwardLightSampler::has_importance_cache() const
+{
+    return m_light_tree && m_light_tree->has_importance_cache();
+}
+
+inline bool BackwardLightSampler::is_recording_lightset_samples() const
+{
+    return m_recording_lightset_samples;
+}
+
 }   // namespace renderer
@@ -161,6 +161,11 @@ void DirectLightingIntegrator::compute_outgoing_radiance_light_sampling_low_vari
     {
         DirectShadingComponents lightset_radiance;
 
+        // When the light sampler is learning, the contribution of each sample is isolated and reported.
+        const bool record_samples = m_light_sampler.is_recording_lightset_samples();
+        DirectShadingComponents sample_radiance;
+        DirectShadingComponents& sample_target = record_samples ? sample_radiance : lightset_radiance;
+
         sampling_context.split_in_place(3, m_light_sample_count);
 
         for (size_t i = 0, e = m_light_sample_count; i < e; ++i)
@@ -173,6 +178,9 @@ void DirectLightingIntegrator::compute_outgoing_radiance_light_sampling_low_vari
                 m_material_sampler.get_shading_point(),
                 sample);
 
+            if (record_samples)
+                sample_radiance.set(0.0f);
+
             // Add the contribution of the chosen light.
             if (sample.m_shape)
             {
@@ -181,7 +189,7 @@ void DirectLightingIntegrator::compute_outgoing_radiance_light_sampling_low_vari
                     sample,
                     mis_heuristic,
                     outgoing,
-                    lightset_radiance,
+                    sample_target,
                     light_path_stream);
             }
             else
@@ -190,9 +198,18 @@ void DirectLightingIntegrator::compute_outgoing_radiance_light_sampling_low_vari
                     sampling_context,
                     sample,
                     outgoing,
-                    lightset_radiance,
+                    sample_target,
                     light_path_stream);
             }
+
+            if (record_samples)
+            {
+                m_light_sampler.record_lightset_sample(
+                    m_material_sampler.get_shading_point(),
+                    sample,
+                    average_value(sample_radiance.m_beauty));
+                lightset_radiance += sample_radiance;
+            }
         }
 
         if (m_light_sample_count > 1)
@@ -44,10 +44,18 @@
 #include "foundation/math/permutation.h"
 #include "foundation/math/scalar.h"
 #include "foundation/math/vector.h"
+#include "foundation/memory/alignedallocator.h"
+#include "foundation/memory/memory.h"
+#include "foundation/platform/compiler.h"
 #include "foundation/platform/timers.h"
+#include "foundation/utility/stopwatch.h"
 #include "foundation/utility/vpythonfile.h"
+#ifdef APPLESEED_USE_SSE
+#include "foundation/platform/sse.h"
+#endif
 
 // Standard headers.
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 #include <limits>
@@ -61,6 +69,12 @@ namespace renderer
 // LightTree class implementation.
 //
 
+namespace
+{
+    // Subtrees with fewer lights are built by a single thread.
+    const size_t LightTreeMinBuildTaskSize = 4096;
+}
+
 LightTree::LightTree(
     const std::vector<NonPhysicalLightInfo>&      non_physical_lights,
     const std::vector<EmittingShape>&             emitting_shapes)
@@ -68,10 +82,12 @@ LightTree::LightTree(
   , m_emitting_shapes(emitting_shapes)
   , m_tree_depth(0)
   , m_is_built(false)
+  , m_wide_nodes(AlignedAllocator<LightTreeWideNode>(APPLESEED_ALIGNOF(LightTreeWideNode)))
+  , m_slot_count(0)
 {
 }
 
-std::vector<size_t> LightTree::build()
+std::vector<size_t> LightTree::build(const size_t thread_count)
 {
     AABBVector light_bboxes;
 
@@ -115,9 +131,15 @@ std::vector<size_t> LightTree::build()
     Partitioner partitioner(light_bboxes);
 
     // Build the light tree.
-    typedef bvh::Builder<LightTree, Partitioner> Builder;
-    Builder builder;
-    builder.build<DefaultWallclockTimer>(*this, partitioner, m_items.size(), 1);
+    typedef bvh::ParallelBuilder<LightTree, Partitioner> Builder;
+    Builder builder(global_logger());
+    builder.build<DefaultWallclockTimer>(
+        *this,
+        partitioner,
+        m_items.size(),
+        1,
+        thread_count,
+        LightTreeMinBuildTaskSize);
 
     // Reorder m_items vector to match the ordering in the LightTree.
     if (!m_items.empty())
@@ -140,11 +162,36 @@ std::vector<size_t> LightTree::build()
         tri_index_to_node_index.resize(m_emitting_shapes.size());
         recursive_node_update(0, 0, 0, tri_index_to_node_index);
 
+        // Collapse the tree into the wide tree used for sampling.
+        Stopwatch<DefaultWallclockTimer> stopwatch;
+        stopwatch.start();
+        build_wide_tree();
+        stopwatch.measure();
+
+        // Keep what probability evaluation and importance caching need to know about
+        // the binary tree, then release it: sampling only uses the wide tree.
+        const size_t node_count = m_nodes.size();
+        m_node_parents.resize(node_count);
+        for (size_t i = 0; i < node_count; ++i)
+        {
+            m_node_parents[i] =
+                m_nodes[i].is_root()
+                    ? ~std::uint32_t(0)
+                    : static_cast<std::uint32_t>(m_nodes[i].get_parent());
+        }
+        assign_importance_cache_slots();
+        clear_release_memory(m_nodes);
+
         // Print light tree statistics.
         Statistics statistics;
-        statistics.insert("nodes", m_nodes.size());
+        statistics.insert("nodes", node_count);
+        statistics.insert("wide nodes", m_wide_nodes.size());
+        statistics.insert_size("wide tree size", m_wide_nodes.size() * sizeof(LightTreeWideNode));
         statistics.insert("max tree depth", m_tree_depth);
+        statistics.insert("build threads", thread_count);
+        statistics.insert("build tasks", builder.get_task_count());
         statistics.insert_time("total build time", builder.get_build_time());
+        statistics.insert_time("wide tree build time", stopwatch.get_seconds());
         RENDERER_LOG_INFO("%s",
             StatisticsVector::make(
                 "light tree statistics",
@@ -245,30 +292,55 @@ void LightTree::sample(
     assert(is_built());
 
     light_probability = 1.0f;
-    size_t node_index = 0;
+    size_t item_index = 0;
 
-    while (!m_nodes[node_index].is_leaf())
+    // The wide tree is empty when the binary tree is reduced to a single leaf.
+    if (!m_wide_nodes.empty())
     {
-        const auto& node = m_nodes[node_index];
+        const Vector3f point(shading_point.get_point());
+        const Vector3f normal = get_lighting_normal(shading_point);
+        const size_t cache_cell_index = get_cache_cell_index(shading_point);
 
-        float p1, p2;
-        child_node_probabilites(node, shading_point, p1, p2);
+        size_t wide_node_index = 0;
 
-        if (s < p1)
+        while (true)
         {
-            light_probability *= p1;
-            s /= p1;
-            node_index = node.get_child_node_index();
-        }
-        else
-        {
-            light_probability *= p2;
-            s = (s - p1) / p2;
-            node_index = node.get_child_node_index() + 1;
+            const LightTreeWideNode& node = m_wide_nodes[wide_node_index];
+
+            float probabilities[4];
+            compute_wide_node_probabilities(node, point, normal, cache_cell_index, probabilities);
+
+            // Select an outer child. The last child with a nonzero probability
+            // is selected if s is out of range because of rounding errors.
+            size_t lane = 4;
+            float lane_cdf = 0.0f;
+            float cdf = 0.0f;
+            for (size_t i = 0; i < 4; ++i)
+            {
+                if (probabilities[i] > 0.0f)
+                {
+                    lane = i;
+                    lane_cdf = cdf;
+                    cdf += probabilities[i];
+                    if (s < cdf)
+                        break;
+                }
+            }
+            assert(lane < 4);
+
+            light_probability *= probabilities[lane];
+            s = saturate((s - lane_cdf) / probabilities[lane]);
+
+            if (node.is_leaf_child(lane))
+            {
+                item_index = node.get_child_index(lane);
+                break;
+            }
+
+            wide_node_index = node.get_child_index(lane);
         }
     }
 
-    const size_t item_index = m_nodes[node_index].get_item_index();
     const Item& item = m_items[item_index];
     light_type = item.m_light_type;
     light_index = item.m_light_index;
@@ -278,27 +350,202 @@ float LightTree::evaluate_node_pdf(
     const ShadingPoint&     shading_point,
     size_t                  node_index) const
 {
-    size_t parent_index = m_nodes[node_index].get_parent();
+    assert(node_index < m_leaf_wide_lanes.size());
+
+    if (m_wide_nodes.empty())
+        return 1.0f;
+
+    const Vector3f point(shading_point.get_point());
+    const Vector3f normal = get_lighting_normal(shading_point);
+
+    // Use the same importance cache cell as sample() to keep both consistent.
+    const size_t cache_cell_index = get_cache_cell_index(shading_point);
+
+    // Start from the wide node containing the leaf and go backwards towards the root node.
+    const std::uint32_t wide_lane = m_leaf_wide_lanes[node_index];
+    assert(wide_lane != LightTreeWideNode::EmptyChild);
+    size_t wide_node_index = wide_lane / 4;
+    size_t lane = wide_lane % 4;
     float pdf = 1.0f;
 
-    do
+    while (true)
     {
-        const LightTreeNode<AABB3d>& node = m_nodes[parent_index];
+        const LightTreeWideNode& node = m_wide_nodes[wide_node_index];
 
-        float p1, p2;
-        child_node_probabilites(node, shading_point, p1, p2);
+        float probabilities[4];
+        compute_wide_node_probabilities(node, point, normal, cache_cell_index, probabilities);
 
-        pdf *= node.get_child_node_index() == node_index ? p1 : p2;
+        pdf *= probabilities[lane];
 
-        // Save the child index to be sure which probability should be taken
-        // into consideration.
-        node_index = parent_index;
-        parent_index = m_nodes[node_index].get_parent();
-    } while (!m_nodes[node_index].is_root());
+        if (wide_node_index == 0)
+            break;
+
+        lane = node.m_parent % 4;
+        wide_node_index = node.m_parent / 4;
+    }
 
     return pdf;
 }
 
+namespace
+{
+    // Interior nodes deeper than this level are not tracked by the importance cache.
+    const size_t ImportanceCacheMaxLevel = 6;
+
+    // Minimum number of light samples a cell must have received before its learned
+    // probabilities are used.
+    const size_t ImportanceCacheMinSampleCount = 64;
+
+    // Weight of the learned probabilities. The remaining weight is given to the
+    // probabilities computed from the bounding boxes and power of the nodes, which
+    // guarantees that no light is ever given a zero probability by the cache.
+    const float ImportanceCacheLearnedWeight = 0.5f;
+}
+
+void LightTree::assign_importance_cache_slots()
+{
+    // Assign a slot to every node up to the maximum tracked level.
+    m_node_slots.assign(m_nodes.size(), ~std::uint32_t(0));
+    m_slot_count = 0;
+    for (size_t i = 0, e = m_nodes.size(); i < e; ++i)
+    {
+        if (m_nodes[i].get_level() <= ImportanceCacheMaxLevel)
+            m_node_slots[i] = static_cast<std::uint32_t>(m_slot_count++);
+    }
+
+    // Find the nodes whose subtree contains non-physical lights. Their contributions are
+    // not recorded (they are not attributed to a leaf), so their selection is not learned.
+    // Children are always stored after their parent, hence the reverse traversal.
+    std::vector<bool> has_non_physical_lights(m_nodes.size(), false);
+    for (size_t i = m_nodes.size(); i-- > 0; )
+    {
+        const LightTreeNode<AABB3d>& node = m_nodes[i];
+        if (node.is_leaf())
+        {
+            has_non_physical_lights[i] =
+                m_items[node.get_item_index()].m_light_type == NonPhysicalLightType;
+        }
+        else
+        {
+            const size_t child = node.get_child_node_index();
+            has_non_physical_lights[i] =
+                has_non_physical_lights[child] || has_non_physical_lights[child + 1];
+        }
+    }
+
+    // Collect the interior nodes whose child selection can be learned.
+    m_cached_nodes.clear();
+    for (size_t i = 0, e = m_nodes.size(); i < e; ++i)
+    {
+        const LightTreeNode<AABB3d>& node = m_nodes[i];
+        if (node.is_leaf() || has_non_physical_lights[i])
+            continue;
+
+        const size_t child = node.get_child_node_index();
+        if (m_node_slots[child] == ~std::uint32_t(0) || m_node_slots[child + 1] == ~std::uint32_t(0))
+            continue;
+
+        CachedNode cached_node;
+        cached_node.m_slot = m_node_slots[i];
+        cached_node.m_left_slot = m_node_slots[child];
+        cached_node.m_right_slot = m_node_slots[child + 1];
+        m_cached_nodes.push_back(cached_node);
+    }
+}
+
+void LightTree::enable_importance_cache(
+    const AABB3d&           bbox,
+    const size_t            resolution)
+{
+    assert(is_built());
+
+    m_importance_cache.reset(new LightTreeImportanceCache(bbox, resolution, m_slot_count));
+
+    Statistics statistics;
+    statistics.insert("cells", m_importance_cache->get_cell_count());
+    statistics.insert("tracked nodes", m_slot_count);
+    statistics.insert("learned nodes", m_cached_nodes.size());
+    statistics.insert_size("memory size", m_importance_cache->get_memory_size());
+    RENDERER_LOG_INFO("%s",
+        StatisticsVector::make(
+            "light tree importance cache statistics",
+            statistics).to_string().c_str());
+}
+
+bool LightTree::has_importance_cache() const
+{
+    return m_importance_cache != nullptr;
+}
+
+void LightTree::record_contribution(
+    const ShadingPoint&     shading_point,
+    const size_t            leaf_node_index,
+    const float             contribution) const
+{
+    assert(has_importance_cache());
+
+    const size_t cell_index = m_importance_cache->get_cell_index(shading_point.get_point());
+    m_importance_cache->record_sample(cell_index);
+
+    if (leaf_node_index == ~size_t(0) || !(contribution > 0.0f))
+        return;
+
+    // Credit the contribution to every tracked ancestor of the leaf.
+    size_t node_index = leaf_node_index;
+    while (true)
+    {
+        const std::uint32_t slot = m_node_slots[node_index];
+        if (slot != ~std::uint32_t(0))
+            m_importance_cache->record_contribution(cell_index, slot, contribution);
+
+        const std::uint32_t parent = m_node_parents[node_index];
+        if (parent == ~std::uint32_t(0))
+            break;
+
+        node_index = parent;
+    }
+}
+
+void LightTree::update_importance_cache()
+{
+    assert(has_importance_cache());
+
+    size_t learned_cell_count = 0;
+
+    for (size_t cell_index = 0, e = m_importance_cache->get_cell_count(); cell_index < e; ++cell_index)
+    {
+        if (m_importance_cache->get_sample_count(cell_index) < ImportanceCacheMinSampleCount)
+            continue;
+
+        ++learned_cell_count;
+
+        for (const CachedNode& cached_node : m_cached_nodes)
+        {
+            const float left = m_importance_cache->get_contribution(cell_index, cached_node.m_left_slot);
+            const float right = m_importance_cache->get_contribution(cell_index, cached_node.m_right_slot);
+            const float total = left + right;
+
+            m_importance_cache->set_learned_probability(
+                cell_index,
+                cached_node.m_slot,
+                total > 0.0f ? saturate(left / total) : -1.0f);
+        }
+    }
+
+    RENDERER_LOG_DEBUG(
+        "light tree importance cache: " FMT_SIZE_T " out of " FMT_SIZE_T " cells learned.",
+        learned_cell_count,
+        m_importance_cache->get_cell_count());
+}
+
+size_t LightTree::get_cache_cell_index(const ShadingPoint& shading_point) const
+{
+    return
+        m_importance_cache
+            ? m_importance_cache->get_cell_index(shading_point.get_point())
+            : ~size_t(0);
+}
+
 namespace
 {
     // [1] Section 2.2.
@@ -347,81 +594,316 @@ namespace
         else
             return contribution;
     }
+
+    // Compute, for each outer child of a wide node, the square distance from a point to
+    // the child, the cosine of the angle between a normal and the direction to the center
+    // of the child, and the square sine of the half-angle subtended by the child.
+    void compute_lane_geometry(
+        const LightTreeWideNode::OuterLanes&    lanes,
+        const Vector3f&                         point,
+        const Vector3f&                         normal,
+        float                                   square_distance[4],
+        float                                   cos_omega[4],
+        float                                   sin_sigma2[4])
+    {
+#ifdef APPLESEED_USE_SSE
+
+        const __m128 one = _mm_set1_ps(1.0f);
+
+        __m128 d2 = _mm_setzero_ps();
+        __m128 c2 = _mm_setzero_ps();
+        __m128 n_dot_c = _mm_setzero_ps();
+
+        for (size_t d = 0; d < 3; ++d)
+        {
+            const __m128 p = _mm_set1_ps(point[d]);
+            const __m128 delta = _mm_sub_ps(_mm_load_ps(lanes.m_position[d]), p);
+            const __m128 center = _mm_sub_ps(_mm_load_ps(lanes.m_center[d]), p);
+            d2 = _mm_add_ps(d2, _mm_mul_ps(delta, delta));
+            c2 = _mm_add_ps(c2, _mm_mul_ps(center, center));
+            n_dot_c = _mm_add_ps(n_dot_c, _mm_mul_ps(_mm_set1_ps(normal[d]), center));
+        }
+
+        const __m128 cos_o = _mm_div_ps(n_dot_c, _mm_sqrt_ps(c2));
+        const __m128 r2 = _mm_load_ps(lanes.m_square_radius);
+
+        _mm_storeu_ps(square_distance, d2);
+        _mm_storeu_ps(cos_omega, _mm_max_ps(_mm_min_ps(cos_o, one), _mm_set1_ps(-1.0f)));
+        _mm_storeu_ps(sin_sigma2, _mm_min_ps(_mm_div_ps(r2, d2), one));
+
+#else
+
+        for (size_t i = 0; i < 4; ++i)
+        {
+            const Vector3f position(lanes.m_position[0][i], lanes.m_position[1][i], lanes.m_position[2][i]);
+            const Vector3f center(lanes.m_center[0][i], lanes.m_center[1][i], lanes.m_center[2][i]);
+
+            square_distance[i] = foundation::square_distance(point, position);
+            cos_omega[i] = clamp(dot(normal, normalize(center - point)), -1.0f, 1.0f);
+            sin_sigma2[i] = std::min(1.0f, lanes.m_square_radius[i] / square_distance[i]);
+        }
+
+#endif
+    }
+
+    // Compute the importance of a child given its geometry as seen from a shading point.
+    float compute_child_importance(
+        const float                             importance,
+        const float                             square_radius,
+        const float                             square_distance,
+        const float                             cos_omega,
+        const float                             sin_sigma2)
+    {
+        // Empty lanes and lights without importance don't contribute.
+        if (importance == 0.0f)
+            return 0.0f;
+
+        // Evaluated point is inside the bbox.
+        // The original Nathan's implementation returns importance divided by the node surface area.
+        // However, replacing the surface area by the square distance showed to result in less noise.
+        if (square_distance <= square_radius)
+            return importance / square_distance;
+
+        //
+        // Implementation of Lambertian lighting model for sub-hemispherical light sources.
+        // Reference:
+        //  [1] Area Light Sources for Real-Time Graphics
+        //      https://www.microsoft.com/en-us/research/wp-content/uploads/1996/03/arealights.pdf
+        //
+        const float cos_sigma = std::sqrt(1.0f - sin_sigma2);
+        const float approx_contribution = sub_hemispherical_light_source_contribution(cos_omega, cos_sigma);
+
+        assert(approx_contribution > 0.0f);
+        return importance / square_radius * approx_contribution;
+    }
+
+    // Compute the importance of each outer child of a wide node for a given point and normal.
+    void compute_outer_importances(
+        const LightTreeWideNode::OuterLanes&    lanes,
+        const Vector3f&                         point,
+        const Vector3f&                         normal,
+        float                                   importances[4])
+    {
+        float square_distance[4], cos_omega[4], sin_sigma2[4];
+        compute_lane_geometry(lanes, point, normal, square_distance, cos_omega, sin_sigma2);
+
+        for (size_t i = 0; i < 4; ++i)
+        {
+            importances[i] =
+                compute_child_importance(
+                    lanes.m_importance[i],
+                    lanes.m_square_radius[i],
+                    square_distance[i],
+                    cos_omega[i],
+                    sin_sigma2[i]);
+        }
+    }
+
+    // Compute the importance of each inner child of a wide node for a given point and normal.
+    void compute_inner_importances(
+        const LightTreeWideNode&                node,
+        const Vector3f&                         point,
+        const Vector3f&                         normal,
+        const float                             outer_importances[4],
+        float                                   importances[2])
+    {
+        for (size_t k = 0; k < 2; ++k)
+        {
+            const size_t lane = 2 * k;
+
+            // An inner child that is a leaf is also stored as an outer child.
+            if (node.is_empty_child(lane + 1))
+            {
+                importances[k] = outer_importances[lane];
+                continue;
+            }
+
+            const LightTreeWideNode::InnerLanes& inner = node.m_inner;
+            const Vector3f center(inner.m_center[0][k], inner.m_center[1][k], inner.m_center[2][k]);
+            const float square_radius = inner.m_square_radius[k];
+            const float square_distance = foundation::square_distance(point, center);
+
+            importances[k] =
+                compute_child_importance(
+                    node.m_outer.m_importance[lane] + node.m_outer.m_importance[lane + 1],
+                    square_radius,
+                    square_distance,
+                    clamp(dot(normal, normalize(center - point)), -1.0f, 1.0f),
+                    std::min(1.0f, square_radius / square_distance));
+        }
+    }
+}
+
+void LightTree::build_wide_tree()
+{
+    m_wide_nodes.clear();
+    m_leaf_wide_lanes.assign(m_nodes.size(), LightTreeWideNode::EmptyChild);
+
+    // A tree reduced to a single leaf has no wide node.
+    if (m_nodes[0].is_leaf())
+        return;
+
+    m_wide_nodes.push_back(LightTreeWideNode());
+    build_wide_node_recurse(0, 0);
+}
+
+void LightTree::build_wide_node_recurse(
+    const size_t                    binary_node_index,
+    const size_t                    wide_node_index)
+{
+    const LightTreeNode<AABB3d>& binary_node = m_nodes[binary_node_index];
+    assert(binary_node.is_interior());
+
+    // Work on a copy since m_wide_nodes grows while child wide nodes are created.
+    LightTreeWideNode wide_node = m_wide_nodes[wide_node_index];
+
+    const size_t inner_indices[2] =
+    {
+        binary_node.get_child_node_index(),
+        binary_node.get_child_node_index() + 1
+    };
+    const AABB3d inner_bboxes[2] =
+    {
+        binary_node.get_left_bbox(),
+        binary_node.get_right_bbox()
+    };
+
+    wide_node.m_binary_nodes[0] = static_cast<std::uint32_t>(binary_node_index);
+    wide_node.m_binary_nodes[1] = static_cast<std::uint32_t>(inner_indices[0]);
+    wide_node.m_binary_nodes[2] = static_cast<std::uint32_t>(inner_indices[1]);
+
+    size_t pending_binary_indices[4];
+    size_t pending_wide_indices[4];
+    size_t pending_count = 0;
+
+    for (size_t k = 0; k < 2; ++k)
+    {
+        const size_t inner_index = inner_indices[k];
+        const LightTreeNode<AABB3d>& inner_node = m_nodes[inner_index];
+
+        wide_node.m_inner.set(k, inner_bboxes[k]);
+
+        if (inner_node.is_leaf())
+        {
+            // The leaf occupies the first of its two outer lanes.
+            const size_t lane = 2 * k;
+            set_wide_node_outer_lane(wide_node, lane, inner_index, inner_bboxes[k]);
+            m_leaf_wide_lanes[inner_index] = static_cast<std::uint32_t>(wide_node_index * 4 + lane);
+            continue;
+        }
+
+        for (size_t j = 0; j < 2; ++j)
+        {
+            const size_t lane = 2 * k + j;
+            const size_t outer_index = inner_node.get_child_node_index() + j;
+            const AABB3d outer_bbox = j == 0 ? inner_node.get_left_bbox() : inner_node.get_right_bbox();
+
+            set_wide_node_outer_lane(wide_node, lane, outer_index, outer_bbox);
+
+            if (m_nodes[outer_index].is_leaf())
+            {
+                m_leaf_wide_lanes[outer_index] = static_cast<std::uint32_t>(wide_node_index * 4 + lane);
+            }
+            else
+            {
+                const size_t child_wide_node_index = m_wide_nodes.size();
+                assert(child_wide_node_index < LightTreeWideNode::LeafFlag / 4);
+
+                m_wide_nodes.push_back(LightTreeWideNode());
+                m_wide_nodes.back().m_parent = static_cast<std::uint32_t>(wide_node_index * 4 + lane);
+
+                wide_node.m_children[lane] = static_cast<std::uint32_t>(child_wide_node_index);
+
+                pending_binary_indices[pending_count] = outer_index;
+                pending_wide_indices[pending_count] = child_wide_node_index;
+                ++pending_count;
+            }
+        }
+    }
+
+    m_wide_nodes[wide_node_index] = wide_node;
+
+    for (size_t i = 0; i < pending_count; ++i)
+        build_wide_node_recurse(pending_binary_indices[i], pending_wide_indices[i]);
 }
 
-float LightTree::compute_node_probability(
-    const LightTreeNode<AABB3d>&    node,
-    const AABB3d&                   bbox,
-    const ShadingPoint&             shading_point) const
+void LightTree::set_wide_node_outer_lane(
+    LightTreeWideNode&              wide_node,
+    const size_t                    lane,
+    const size_t                    binary_node_index,
+    const AABB3d&                   bbox) const
 {
-    // Calculate probability of a single node based on its contribution over solid angle.
-    const float r2 = static_cast<float>(bbox.square_radius());
-    const float rcp_surface_area = 1.0f / r2;
+    const LightTreeNode<AABB3d>& node = m_nodes[binary_node_index];
 
     // Triangle centroid is a more precise position than the center of the bbox.
     Vector3d position;
     if (node.is_leaf())
     {
-        const Item& item = m_items[node.get_item_index()];
+        const size_t item_index = node.get_item_index();
+        const Item& item = m_items[item_index];
         if (item.m_light_type == EmittingShapeType)
             position = m_emitting_shapes[item.m_light_index].get_centroid();
         else position = bbox.center();
+
+        // Leaves refer to their item directly since the binary tree is released after the build.
+        assert(item_index < LightTreeWideNode::LeafFlag);
+        wide_node.m_children[lane] = static_cast<std::uint32_t>(item_index) | LightTreeWideNode::LeafFlag;
     }
     else position = bbox.center();
 
-    const Vector3d& surface_point = shading_point.get_point();
-
-    const float distance2 =
-        static_cast<float>(square_distance(surface_point, position));
-
-    // Evaluated point is outside the bbox.
-    // The original Nathan's implementation returns importance divided by the node surface area.
-    // However, replacing the surface area by the square distance showed to result in less noise.
-    if (distance2 <= r2)
-        return node.get_importance() / distance2;
-
-    //
-    // Implementation of Lambertian lighting model for sub-hemispherical light sources.
-    // Reference:
-    //  [1] Area Light Sources for Real-Time Graphics
-    //      https://www.microsoft.com/en-us/research/wp-content/uploads/1996/03/arealights.pdf
-    //
-    const Vector3d outcoming_light_direction = normalize(bbox.center() - surface_point);
-    const float sin_sigma2 = std::min(1.0f, (r2 / distance2));
-    const float cos_sigma = std::sqrt(1.0f - sin_sigma2);
-
-    const Vector3d& incoming_light_direction = shading_point.get_ray().m_dir;
+    wide_node.m_outer.set(lane, position, bbox, node.get_importance());
+}
 
-    // [1] "Arbitrary direction D receives light only if dot(D,L) >= 0".
-    const Vector3d& N = (dot(shading_point.get_geometric_normal(), incoming_light_direction) <= 0.0f)
-        ? shading_point.get_shading_normal()
-        : -shading_point.get_shading_normal();
+void LightTree::compute_wide_node_probabilities(
+    const LightTreeWideNode&        node,
+    const Vector3f&                 point,
+    const Vector3f&                 normal,
+    const size_t                    cache_cell_index,
+    float                           probabilities[4]) const
+{
+    // Node has currently no info about its own bbox characteristics.
+    // Hence the geometry of the children is stored in their parent.
+    float outer_importances[4], inner_importances[2];
+    compute_outer_importances(node.m_outer, point, normal, outer_importances);
+    compute_inner_importances(node, point, normal, outer_importances, inner_importances);
+
+    // Probabilities of the inner children.
+    float inner_probabilities[2] = { inner_importances[0], inner_importances[1] };
+    normalize_child_probabilities(
+        node.m_binary_nodes[0],
+        cache_cell_index,
+        inner_probabilities[0],
+        inner_probabilities[1]);
+
+    // Probabilities of the outer children.
+    for (size_t k = 0; k < 2; ++k)
+    {
+        const size_t lane = 2 * k;
 
-    const float cos_omega = clamp(static_cast<float>(dot(N, outcoming_light_direction)), -1.0f, 1.0f);
-    const float approx_contribution = sub_hemispherical_light_source_contribution(cos_omega, cos_sigma);
+        if (node.is_empty_child(lane + 1))
+        {
+            // The inner child is a leaf.
+            probabilities[lane + 0] = inner_probabilities[k];
+            probabilities[lane + 1] = 0.0f;
+        }
+        else
+        {
+            float p1 = outer_importances[lane + 0];
+            float p2 = outer_importances[lane + 1];
+            normalize_child_probabilities(node.m_binary_nodes[1 + k], cache_cell_index, p1, p2);
 
-    assert(approx_contribution > 0.0f);
-    return node.get_importance() * rcp_surface_area * approx_contribution;
+            probabilities[lane + 0] = inner_probabilities[k] * p1;
+            probabilities[lane + 1] = inner_probabilities[k] * p2;
+        }
+    }
 }
 
-void LightTree::child_node_probabilites(
-    const LightTreeNode<AABB3d>&    node,
-    const ShadingPoint&             shading_point,
+void LightTree::normalize_child_probabilities(
+    const size_t                    binary_node_index,
+    const size_t                    cache_cell_index,
     float&                          p1,
     float&                          p2) const
 {
-    const auto& child1 = m_nodes[node.get_child_node_index()];
-    const auto& child2 = m_nodes[node.get_child_node_index() + 1];
-
-    // Node has currently no info about its own bbox characteristics.
-    // Hence we have to extract it before from its parent.
-    // todo: make LightTreeNode aware of its bbox!
-    const auto& bbox_left = node.get_left_bbox();
-    const auto& bbox_right = node.get_right_bbox();
-
-    p1 = compute_node_probability(child1, bbox_left, shading_point);
-    p2 = compute_node_probability(child2, bbox_right, shading_point);
-
     // Normalize probabilities.
     const float total = p1 + p2;
     if (total <= 0.0f)
@@ -435,9 +917,38 @@ void LightTree::child_node_probabilites(
         p2 /= total;
     }
 
+    // Blend in the probability learned by the importance cache, if any.
+    if (cache_cell_index != ~size_t(0))
+    {
+        const std::uint32_t slot = m_node_slots[binary_node_index];
+        if (slot != ~std::uint32_t(0))
+        {
+            const float learned_p1 =
+                m_importance_cache->get_learned_probability(cache_cell_index, slot);
+
+            if (learned_p1 >= 0.0f)
+            {
+                p1 = lerp(p1, learned_p1, ImportanceCacheLearnedWeight);
+                p2 = 1.0f - p1;
+            }
+        }
+    }
+
     assert(feq(p1 + p2, 1.0f));
 }
 
+Vector3f LightTree::get_lighting_normal(const ShadingPoint& shading_point)
+{
+    const Vector3d& incoming_light_direction = shading_point.get_ray().m_dir;
+
+    // [1] "Arbitrary direction D receives light only if dot(D,L) >= 0".
+    const Vector3d& N = (dot(shading_point.get_geometric_normal(), incoming_light_direction) <= 0.0f)
+        ? shading_point.get_shading_normal()
+        : -shading_point.get_shading_normal();
+
+    return Vector3f(N);
+}
+
 void LightTree::draw_tree_structure(
     const std::string&       filename_base,
     const AABB3d&            root_bbox,
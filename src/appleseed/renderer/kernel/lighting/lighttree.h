@@ -29,17 +29,22 @@
 #pragma once
 
 // appleseed.renderer headers.
+#include "renderer/kernel/lighting/lighttree_importancecache.h"
 #include "renderer/kernel/lighting/lighttree_node.h"
+#include "renderer/kernel/lighting/lighttree_widenode.h"
 #include "renderer/kernel/lighting/lighttypes.h"
 
 // appleseed.foundation headers.
 #include "foundation/containers/alignedvector.h"
 #include "foundation/math/aabb.h"
 #include "foundation/math/bvh.h"
+#include "foundation/math/vector.h"
 #include "foundation/utility/statistics.h"
 
 // Standard headers.
 #include <cstddef>
+#include <cstdint>
+#include <memory>
 
 // Forward declarations.
 namespace renderer  { class ShadingPoint; }
@@ -50,6 +55,10 @@ namespace renderer
 //
 // Light tree.
 //
+// The binary tree is built in parallel, then collapsed into a 4-wide tree of compact
+// single precision nodes that is used for sampling and probability evaluation. Only
+// the parent and importance cache slot of each binary node are kept after the build.
+//
 
 class LightTree
   : public foundation::bvh::Tree<
@@ -65,7 +74,9 @@ class LightTree
         const std::vector<NonPhysicalLightInfo>&      non_physical_lights,
         const std::vector<EmittingShape>&             emitting_shapes);
 
-    std::vector<size_t> build();
+    // Build the tree using a given number of threads. Return the index of the binary
+    // leaf node of each emitting shape.
+    std::vector<size_t> build(const size_t thread_count);
 
     bool is_built() const;
 
@@ -82,6 +93,27 @@ class LightTree
         const ShadingPoint&             surface_point,
         const size_t                    node_index) const;
 
+    // Enable importance caching: the contributions of light samples are recorded in
+    // a grid of cells covering a given bounding box, and sampling is biased toward the
+    // subtrees that actually contributed to the shading points of each cell.
+    void enable_importance_cache(
+        const foundation::AABB3d&       bbox,
+        const size_t                    resolution);
+
+    // Return true if importance caching is enabled.
+    bool has_importance_cache() const;
+
+    // Record the contribution of a light sample chosen by sample(), divided by its probability.
+    // The leaf node index is ~0 if the light sample cannot be attributed to a leaf. Thread-safe.
+    void record_contribution(
+        const ShadingPoint&             shading_point,
+        const size_t                    leaf_node_index,
+        const float                     contribution) const;
+
+    // Update the learned probabilities from the contributions recorded so far.
+    // Must not be called while the tree is being sampled.
+    void update_importance_cache();
+
   private:
     struct Item
     {
@@ -110,6 +142,15 @@ class LightTree
     typedef std::vector<EmittingShape>              EmittingShapeVector;
     typedef std::vector<Item>                       ItemVector;
     typedef std::vector<size_t>                     IndexLUT;
+    typedef foundation::AlignedVector<LightTreeWideNode> WideNodeVector;
+
+    // An interior node whose child selection is learned by the importance cache.
+    struct CachedNode
+    {
+        size_t                                      m_slot;
+        size_t                                      m_left_slot;
+        size_t                                      m_right_slot;
+    };
 
     const NonPhysicalLightVector&                   m_non_physical_lights;
     const EmittingShapeVector&                      m_emitting_shapes;
@@ -117,6 +158,15 @@ class LightTree
     size_t                                          m_tree_depth;
     bool                                            m_is_built;
 
+    WideNodeVector                                  m_wide_nodes;
+    std::vector<std::uint32_t>                      m_leaf_wide_lanes;  // wide node index * 4 + lane of each binary leaf node
+    std::vector<std::uint32_t>                      m_node_parents;     // parent of each binary node, ~0 for the root
+
+    std::unique_ptr<LightTreeImportanceCache>       m_importance_cache;
+    std::vector<std::uint32_t>                      m_node_slots;       // importance cache slot of each binary node, ~0 if none
+    size_t                                          m_slot_count;
+    std::vector<CachedNode>                         m_cached_nodes;
+
     // Calculate the tree depth.
     // Assign total importance to each node of the tree, where total importance
     // represents the sum of all its child nodes importances.
@@ -126,18 +176,43 @@ class LightTree
         const size_t                                node_level,
         IndexLUT&                                   tri_index_to_node_index);
 
-    float compute_node_probability(
-        const LightTreeNode<foundation::AABB3d>&    node,
-        const foundation::AABB3d&                   bbox,
-        const ShadingPoint&                         shading_point) const;
-
-    void child_node_probabilites(
-        const LightTreeNode<foundation::AABB3d>&    node,
-        const ShadingPoint&                         shading_point,
+    // Collapse the binary tree into the wide tree.
+    void build_wide_tree();
+    void build_wide_node_recurse(
+        const size_t                                binary_node_index,
+        const size_t                                wide_node_index);
+    void set_wide_node_outer_lane(
+        LightTreeWideNode&                          wide_node,
+        const size_t                                lane,
+        const size_t                                binary_node_index,
+        const foundation::AABB3d&                   bbox) const;
+
+    // Assign importance cache slots to the binary nodes whose child selection can be learned.
+    void assign_importance_cache_slots();
+
+    // Compute the probabilities of selecting each outer child of a wide node.
+    // The cache cell index is ~0 when importance caching is disabled.
+    void compute_wide_node_probabilities(
+        const LightTreeWideNode&                    node,
+        const foundation::Vector3f&                 point,
+        const foundation::Vector3f&                 normal,
+        const size_t                                cache_cell_index,
+        float                                       probabilities[4]) const;
+
+    // Turn the importances of the children of a binary node into probabilities.
+    void normalize_child_probabilities(
+        const size_t                                binary_node_index,
+        const size_t                                cache_cell_index,
         float&                                      p1,
         float&                                      p2) const;
 
+    // Return the normal used to estimate the contribution of lights to a shading point.
+    static foundation::Vector3f get_lighting_normal(const ShadingPoint& shading_point);
+
+    size_t get_cache_cell_index(const ShadingPoint& shading_point) const;
+
     // Dump the tree bounding boxes to a VPython file on disk.
+    // Only valid during build(), before the binary tree is released.
     void draw_tree_structure(
         const std::string&                          filename_base,
         const foundation::AABB3d&                   root_bbox,
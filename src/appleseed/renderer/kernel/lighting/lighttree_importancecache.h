@@ -0,0 +1,228 @@
+
+//
+// This source file is part of appleseed.
+// Visit https://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2019 The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+// appleseed.foundation headers.
+#include "foundation/core/concepts/noncopyable.h"
+#include "foundation/math/aabb.h"
+#include "foundation/math/scalar.h"
+#include "foundation/math/vector.h"
+#include "foundation/platform/atomic.h"
+
+// Standard headers.
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace renderer
+{
+
+//
+// A uniform grid of light tree importance records.
+//
+// Each cell accumulates, for a fixed set of light tree nodes (slots), the contributions
+// of the light samples taken from shading points inside the cell. Contributions are
+// recorded concurrently during rendering, while learned probabilities are published
+// between passes and are read-only while rendering.
+//
+
+class LightTreeImportanceCache
+  : public foundation::NonCopyable
+{
+  public:
+    // Constructor.
+    LightTreeImportanceCache(
+        const foundation::AABB3d&   bbox,
+        const size_t                resolution,
+        const size_t                slot_count);
+
+    // Return the number of cells of the grid.
+    size_t get_cell_count() const;
+
+    // Return the number of slots per cell.
+    size_t get_slot_count() const;
+
+    // Return the index of the cell containing a given point.
+    // Points outside the bounding box of the grid map to the closest cell.
+    size_t get_cell_index(const foundation::Vector3d& point) const;
+
+    // Record a light sample taken from a given cell. Thread-safe.
+    void record_sample(const size_t cell_index);
+
+    // Record the contribution of a light sample to a given slot. Thread-safe.
+    void record_contribution(
+        const size_t                cell_index,
+        const size_t                slot_index,
+        const float                 contribution);
+
+    // Return the number of light samples recorded in a given cell.
+    size_t get_sample_count(const size_t cell_index) const;
+
+    // Return the sum of the contributions recorded in a given slot.
+    float get_contribution(
+        const size_t                cell_index,
+        const size_t                slot_index) const;
+
+    // Set/get the learned probability of a slot, negative when nothing was learned.
+    void set_learned_probability(
+        const size_t                cell_index,
+        const size_t                slot_index,
+        const float                 probability);
+    float get_learned_probability(
+        const size_t                cell_index,
+        const size_t                slot_index) const;
+
+    // Return the size (in bytes) of this object in memory.
+    size_t get_memory_size() const;
+
+  private:
+    const foundation::AABB3d        m_bbox;
+    const size_t                    m_resolution;
+    const size_t                    m_slot_count;
+    foundation::Vector3d            m_rcp_cell_extent;
+    std::vector<std::uint32_t>      m_sample_counts;
+    std::vector<float>              m_contributions;
+    std::vector<float>              m_learned_probabilities;
+};
+
+
+//
+// LightTreeImportanceCache class implementation.
+//
+
+inline LightTreeImportanceCache::LightTreeImportanceCache(
+    const foundation::AABB3d&       bbox,
+    const size_t                    resolution,
+    const size_t                    slot_count)
+  : m_bbox(bbox)
+  , m_resolution(std::max<size_t>(resolution, 1))
+  , m_slot_count(slot_count)
+{
+    assert(m_bbox.is_valid());
+
+    const foundation::Vector3d extent = m_bbox.extent();
+    for (size_t i = 0; i < 3; ++i)
+        m_rcp_cell_extent[i] = extent[i] > 0.0 ? m_resolution / extent[i] : 0.0;
+
+    const size_t cell_count = m_resolution * m_resolution * m_resolution;
+    m_sample_counts.assign(cell_count, 0);
+    m_contributions.assign(cell_count * m_slot_count, 0.0f);
+    m_learned_probabilities.assign(cell_count * m_slot_count, -1.0f);
+}
+
+inline size_t LightTreeImportanceCache::get_cell_count() const
+{
+    return m_sample_counts.size();
+}
+
+inline size_t LightTreeImportanceCache::get_slot_count() const
+{
+    return m_slot_count;
+}
+
+inline size_t LightTreeImportanceCache::get_cell_index(const foundation::Vector3d& point) const
+{
+    size_t cell_index = 0;
+
+    for (size_t i = 3; i-- > 0; )
+    {
+        const double x = (point[i] - m_bbox.min[i]) * m_rcp_cell_extent[i];
+        const size_t coord =
+            x > 0.0
+                ? std::min(foundation::truncate<size_t>(x), m_resolution - 1)
+                : 0;
+        cell_index = cell_index * m_resolution + coord;
+    }
+
+    assert(cell_index < get_cell_count());
+    return cell_index;
+}
+
+inline void LightTreeImportanceCache::record_sample(const size_t cell_index)
+{
+    assert(cell_index < get_cell_count());
+    foundation::atomic_inc(&m_sample_counts[cell_index]);
+}
+
+inline void LightTreeImportanceCache::record_contribution(
+    const size_t                    cell_index,
+    const size_t                    slot_index,
+    const float                     contribution)
+{
+    assert(cell_index < get_cell_count());
+    assert(slot_index < m_slot_count);
+    foundation::atomic_add(&m_contributions[cell_index * m_slot_count + slot_index], contribution);
+}
+
+inline size_t LightTreeImportanceCache::get_sample_count(const size_t cell_index) const
+{
+    assert(cell_index < get_cell_count());
+    return m_sample_counts[cell_index];
+}
+
+inline float LightTreeImportanceCache::get_contribution(
+    const size_t                    cell_index,
+    const size_t                    slot_index) const
+{
+    assert(cell_index < get_cell_count());
+    assert(slot_index < m_slot_count);
+    return m_contributions[cell_index * m_slot_count + slot_index];
+}
+
+inline void LightTreeImportanceCache::set_learned_probability(
+    const size_t                    cell_index,
+    const size_t                    slot_index,
+    const float                     probability)
+{
+    assert(cell_index < get_cell_count());
+    assert(slot_index < m_slot_count);
+    m_learned_probabilities[cell_index * m_slot_count + slot_index] = probability;
+}
+
+inline float LightTreeImportanceCache::get_learned_probability(
+    const size_t                    cell_index,
+    const size_t                    slot_index) const
+{
+    assert(cell_index < get_cell_count());
+    assert(slot_index < m_slot_count);
+    return m_learned_probabilities[cell_index * m_slot_count + slot_index];
+}
+
+inline size_t LightTreeImportanceCache::get_memory_size() const
+{
+    return
+          sizeof(*this)
+        + m_sample_counts.capacity() * sizeof(std::uint32_t)
+        + m_contributions.capacity() * sizeof(float)
+        + m_learned_probabilities.capacity() * sizeof(float);
+}
+
+}   // namespace renderer
@@ -0,0 +1,240 @@
+
+//
+// This source file is part of appleseed.
+// Visit https://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2019 The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+// appleseed.foundation headers.
+#include "foundation/math/aabb.h"
+#include "foundation/math/vector.h"
+#include "foundation/platform/compiler.h"
+
+// Standard headers.
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+namespace renderer
+{
+
+//
+// Node of the 4-wide light tree.
+//
+// A wide node collapses two levels of the binary light tree: a binary node, its two
+// inner children, and up to four outer children (the children of the inner children,
+// or the inner children themselves when they are leaves). The geometry of the children
+// is stored in single precision, in structure-of-arrays form, so that the importance
+// of all the outer children can be evaluated at once.
+//
+// The importance of an inner child is the sum of the importances of its outer children,
+// and an inner child that is a leaf is also stored as an outer child, hence only the
+// bounding boxes of the inner children are stored. Nodes are exactly three cache lines.
+//
+// The probability of selecting an outer child is the product of the probabilities of
+// the two binary decisions it stands for, hence sampling the wide tree is equivalent
+// to sampling the binary tree.
+//
+
+class APPLESEED_ALIGN(64) LightTreeWideNode
+{
+  public:
+    static const std::uint32_t LeafFlag = 0x80000000u;
+    static const std::uint32_t EmptyChild = 0xFFFFFFFFu;
+
+    // Geometry and importance of the four outer children.
+    struct OuterLanes
+    {
+        float           m_position[3][4];       // point from which the distance to the child is measured
+        float           m_center[3][4];         // center of the bounding box of the child
+        float           m_square_radius[4];     // square radius of the bounding box of the child
+        float           m_importance[4];
+
+        void clear();
+
+        void set(
+            const size_t                lane,
+            const foundation::Vector3d& position,
+            const foundation::AABB3d&   bbox,
+            const float                 importance);
+    };
+
+    // Geometry of the two inner children, whose distance is measured from their center.
+    struct InnerLanes
+    {
+        float           m_center[3][2];
+        float           m_square_radius[2];
+
+        void clear();
+
+        void set(
+            const size_t                lane,
+            const foundation::AABB3d&   bbox);
+    };
+
+    OuterLanes          m_outer;
+    InnerLanes          m_inner;
+
+    // Outer children: index of a wide node, index of a light tree item with LeafFlag
+    // set, or EmptyChild. Lanes 0 and 1 belong to the left inner child, lanes 2 and 3
+    // to the right inner child. When an inner child is a leaf, it occupies the first of
+    // its two lanes and the second one is empty.
+    std::uint32_t       m_children[4];
+
+    // Indices of the binary node and of its left and right children.
+    std::uint32_t       m_binary_nodes[3];
+
+    // Index of the parent wide node * 4 + lane of this node in the parent, EmptyChild for the root.
+    std::uint32_t       m_parent;
+
+    // Constructor, calls clear().
+    LightTreeWideNode();
+
+    // Reset the node to an empty state.
+    void clear();
+
+    // Return true if a given outer child is a leaf of the binary tree.
+    bool is_leaf_child(const size_t lane) const;
+
+    // Return true if a given outer child does not exist.
+    bool is_empty_child(const size_t lane) const;
+
+    // Return the index of the wide node or of the light tree item of a given outer child.
+    size_t get_child_index(const size_t lane) const;
+};
+
+static_assert(
+    sizeof(LightTreeWideNode) ==
+        sizeof(LightTreeWideNode::OuterLanes) +
+        sizeof(LightTreeWideNode::InnerLanes) +
+        8 * sizeof(std::uint32_t) &&
+    sizeof(LightTreeWideNode) % 64 == 0,
+    "renderer::LightTreeWideNode must fill whole cache lines without padding");
+
+
+//
+// LightTreeWideNode class implementation.
+//
+
+inline void LightTreeWideNode::OuterLanes::clear()
+{
+    for (size_t i = 0; i < 4; ++i)
+    {
+        for (size_t d = 0; d < 3; ++d)
+        {
+            m_position[d][i] = 0.0f;
+            m_center[d][i] = 0.0f;
+        }
+
+        m_square_radius[i] = 1.0f;
+        m_importance[i] = 0.0f;
+    }
+}
+
+inline void LightTreeWideNode::OuterLanes::set(
+    const size_t                        lane,
+    const foundation::Vector3d&         position,
+    const foundation::AABB3d&           bbox,
+    const float                         importance)
+{
+    assert(lane < 4);
+
+    const foundation::Vector3d center = bbox.center();
+
+    for (size_t d = 0; d < 3; ++d)
+    {
+        m_position[d][lane] = static_cast<float>(position[d]);
+        m_center[d][lane] = static_cast<float>(center[d]);
+    }
+
+    m_square_radius[lane] = static_cast<float>(bbox.square_radius());
+    m_importance[lane] = importance;
+}
+
+inline void LightTreeWideNode::InnerLanes::clear()
+{
+    for (size_t i = 0; i < 2; ++i)
+    {
+        for (size_t d = 0; d < 3; ++d)
+            m_center[d][i] = 0.0f;
+
+        m_square_radius[i] = 1.0f;
+    }
+}
+
+inline void LightTreeWideNode::InnerLanes::set(
+    const size_t                        lane,
+    const foundation::AABB3d&           bbox)
+{
+    assert(lane < 2);
+
+    const foundation::Vector3d center = bbox.center();
+
+    for (size_t d = 0; d < 3; ++d)
+        m_center[d][lane] = static_cast<float>(center[d]);
+
+    m_square_radius[lane] = static_cast<float>(bbox.square_radius());
+}
+
+inline LightTreeWideNode::LightTreeWideNode()
+{
+    clear();
+}
+
+inline void LightTreeWideNode::clear()
+{
+    m_outer.clear();
+    m_inner.clear();
+
+    for (size_t i = 0; i < 4; ++i)
+        m_children[i] = EmptyChild;
+
+    for (size_t i = 0; i < 3; ++i)
+        m_binary_nodes[i] = EmptyChild;
+
+    m_parent = EmptyChild;
+}
+
+inline bool LightTreeWideNode::is_leaf_child(const size_t lane) const
+{
+    assert(lane < 4);
+    return m_children[lane] != EmptyChild && (m_children[lane] & LeafFlag) != 0;
+}
+
+inline bool LightTreeWideNode::is_empty_child(const size_t lane) const
+{
+    assert(lane < 4);
+    return m_children[lane] == EmptyChild;
+}
+
+inline size_t LightTreeWideNode::get_child_index(const size_t lane) const
+{
+    assert(lane < 4);
+    assert(!is_empty_child(lane));
+    return static_cast<size_t>(m_children[lane] & ~LeafFlag);
+}
+
+}   // namespace renderer
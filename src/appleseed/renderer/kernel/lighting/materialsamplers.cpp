@@ -30,6 +30,7 @@
 #include "materialsamplers.h"
 
 // appleseed.renderer headers.
+#include "renderer/kernel/lighting/sdtree.h"
 #include "renderer/kernel/lighting/tracer.h"
 #include "renderer/kernel/shading/directshadingcomponents.h"
 #include "renderer/kernel/shading/shadingcontext.h"
@@ -53,11 +54,15 @@ BSDFSampler::BSDFSampler(
     const BSDF&                 bsdf,
     const void*                 bsdf_data,
     const int                   bsdf_sampling_modes,
-    const ShadingPoint&         shading_point)
+    const ShadingPoint&         shading_point,
+    const DTree*                guiding_dtree,
+    const float                 bsdf_sampling_fraction)
   : m_bsdf(bsdf)
   , m_bsdf_data(bsdf_data)
   , m_bsdf_sampling_modes(bsdf_sampling_modes)
   , m_shading_point(shading_point)
+  , m_guiding_dtree(guiding_dtree)
+  , m_bsdf_sampling_fraction(bsdf_sampling_fraction)
 {
     m_local_geometry.m_shading_point = &shading_point;
     m_local_geometry.m_geometric_normal = Vector3f(shading_point.get_geometric_normal());
@@ -174,7 +179,7 @@ float BSDFSampler::evaluate(
     const int                   light_sampling_modes,
     DirectShadingComponents&    value) const
 {
-    return
+    const float pdf =
         m_bsdf.evaluate(
             m_bsdf_data,
             false,              // not adjoint
@@ -184,6 +189,13 @@ float BSDFSampler::evaluate(
             Vector3f(incoming),
             light_sampling_modes,
             value);
+
+    if (m_guiding_dtree == nullptr || pdf == 0.0f)
+        return pdf;
+
+    return
+        m_bsdf_sampling_fraction * pdf +
+        (1.0f - m_bsdf_sampling_fraction) * m_guiding_dtree->evaluate_pdf(incoming);
 }
 
 
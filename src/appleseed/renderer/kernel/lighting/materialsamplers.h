@@ -39,6 +39,7 @@
 
 // Forward declarations.
 namespace renderer  { class DirectShadingComponents; }
+namespace renderer  { class DTree; }
 namespace renderer  { class ShadingContext; }
 namespace renderer  { class ShadingPoint; }
 
@@ -95,11 +96,15 @@ class BSDFSampler
   : public IMaterialSampler
 {
   public:
+    // When a learned radiance distribution is given, evaluate() returns the probability
+    // density of the one-sample combination of the BSDF and of that distribution.
     BSDFSampler(
         const BSDF&                     bsdf,
         const void*                     bsdf_data,
         const int                       bsdf_sampling_modes,
-        const ShadingPoint&             shading_point);
+        const ShadingPoint&             shading_point,
+        const DTree*                    guiding_dtree = nullptr,
+        const float                     bsdf_sampling_fraction = 1.0f);
 
     const foundation::Vector3d& get_point() const override;
 
@@ -140,6 +145,8 @@ class BSDFSampler
     const void*                         m_bsdf_data;
     const int                           m_bsdf_sampling_modes;
     const ShadingPoint&                 m_shading_point;
+    const DTree*                        m_guiding_dtree;
+    const float                         m_bsdf_sampling_fraction;
     BSDF::LocalGeometry                 m_local_geometry;
 };
 
@@ -36,6 +36,7 @@
 #include "renderer/kernel/intersection/intersector.h"
 #include "renderer/kernel/lighting/pathvertex.h"
 #include "renderer/kernel/lighting/scatteringmode.h"
+#include "renderer/kernel/lighting/sdtree.h"
 #include "renderer/kernel/shading/shadingcontext.h"
 #include "renderer/kernel/shading/shadingpoint.h"
 #include "renderer/kernel/shading/shadingray.h"
@@ -52,6 +53,7 @@
 // appleseed.foundation headers.
 #include "foundation/core/concepts/noncopyable.h"
 #include "foundation/math/dual.h"
+#include "foundation/math/population.h"
 #include "foundation/math/ray.h"
 #include "foundation/math/rr.h"
 #include "foundation/math/sampling/mappings.h"
@@ -64,6 +66,8 @@
 #include <algorithm>
 #include <cassert>
 #include <cstddef>
+#include <cstdint>
+#include <new>
 
 namespace renderer
 {
@@ -116,7 +120,8 @@ class PathTracer
         const size_t                max_volume_bounces,
         const bool                  clamp_roughness,
         const size_t                max_iterations = 1000,
-        const double                near_start = 0.0);          // abort tracing if the first ray is shorter than this
+        const double                near_start = 0.0,           // abort tracing if the first ray is shorter than this
+        PathGuidingContext*         path_guiding_context = nullptr);
 
     size_t trace(
         SamplingContext&            sampling_context,
@@ -131,7 +136,9 @@ class PathTracer
         const ShadingPoint&         shading_point,
         const bool                  clear_arena = true);
 
-    const ShadingPoint& get_path_vertex(const size_t i) const;
+    // Return the number of bytes written at each path vertex: its shading point
+    // and the closures and inputs allocated in the per-thread arena.
+    const foundation::Population<std::uint64_t>& get_vertex_footprint() const;
 
   private:
     PathVisitor&                    m_path_visitor;
@@ -145,12 +152,28 @@ class PathTracer
     const bool                      m_clamp_roughness;
     const size_t                    m_max_iterations;
     const double                    m_near_start;
+    PathGuidingContext*             m_path_guiding_context;
     size_t                          m_diffuse_bounces;
     size_t                          m_glossy_bounces;
     size_t                          m_specular_bounces;
     size_t                          m_volume_bounces;
     size_t                          m_iterations;
-    foundation::Arena               m_shading_point_arena;
+    ShadingPoint*                   m_shading_points;
+    foundation::Population<std::uint64_t> m_vertex_footprint;
+
+    // Number of shading points the path tracer cycles through. At most four are in use
+    // at once: those of the current vertex, of the parent vertex, of the next vertex,
+    // and of the exit point of a participating medium.
+    enum { ShadingPointCount = 4 };
+
+    // Return a cleared shading point distinct from the ones that are still in use.
+    ShadingPoint* acquire_shading_point(
+        const ShadingPoint*         in_use1,
+        const ShadingPoint*         in_use2,
+        const ShadingPoint*         in_use3 = nullptr) const;
+
+    // Release the closures and inputs of the current path vertex.
+    void recycle_arena(const ShadingContext& shading_context);
 
     // Determine whether a ray can pass through a surface with a given alpha value.
     static bool pass_through(
@@ -172,6 +195,14 @@ class PathTracer
         BSDFSample&                 sample,
         ShadingRay&                 ray);
 
+    // Combine the BSDF sample with a sample of the learned radiance distribution
+    // using one-sample multiple importance sampling.
+    void guide_bounce(
+        SamplingContext&            sampling_context,
+        const PathVertex&           vertex,
+        const BSDF::LocalGeometry&  local_geometry,
+        BSDFSample&                 sample) const;
+
     // This method performs raymarching across the volume.
     // Returns whether the path should be continued.
     bool march(
@@ -199,7 +230,8 @@ inline PathTracer<PathVisitor, VolumeVisitor, Adjoint>::PathTracer(
     const size_t                max_volume_bounces,
     const bool                  clamp_roughness,
     const size_t                max_iterations,
-    const double                near_start)
+    const double                near_start,
+    PathGuidingContext*         path_guiding_context)
   : m_path_visitor(path_visitor)
   , m_volume_visitor(volume_visitor)
   , m_rr_min_path_length(rr_min_path_length)
@@ -211,6 +243,8 @@ inline PathTracer<PathVisitor, VolumeVisitor, Adjoint>::PathTracer(
   , m_clamp_roughness(clamp_roughness)
   , m_max_iterations(max_iterations)
   , m_near_start(near_start)
+  , m_path_guiding_context(path_guiding_context)
+  , m_shading_points(nullptr)
 {
 }
 
@@ -264,12 +298,24 @@ size_t PathTracer<PathVisitor, VolumeVisitor, Adjoint>::trace(
     m_volume_bounces = 0;
     m_iterations = 0;
 
+    // Store the shading points of the path in the per-thread arena, next to the closures,
+    // and keep them there while the arena is cleared at every vertex. Cycling through a
+    // few shading points keeps the memory written by the path small and warm in caches.
+    foundation::Arena& arena = shading_context.get_arena();
+    m_shading_points =
+        static_cast<ShadingPoint*>(
+            arena.allocate(ShadingPointCount * sizeof(ShadingPoint)));
+    std::uint8_t* arena_marker = arena.pin();
+
     while (true)
     {
-        if (clear_arena)
-            shading_context.get_arena().clear();
+        if (clear_arena && m_iterations > 0)
+            recycle_arena(shading_context);
 
-        ShadingPoint* next_shading_point = m_shading_point_arena.allocate<ShadingPoint>();
+        ShadingPoint* next_shading_point =
+            acquire_shading_point(
+                vertex.m_shading_point,
+                vertex.m_parent_shading_point);
 
 #ifndef NDEBUG
         // Save the sampling context at the beginning of the iteration.
@@ -638,6 +684,12 @@ size_t PathTracer<PathVisitor, VolumeVisitor, Adjoint>::trace(
         vertex.m_shading_point = next_shading_point;
     }
 
+    if (clear_arena)
+        recycle_arena(shading_context);
+
+    arena.unpin(arena_marker);
+    m_shading_points = nullptr;
+
     return vertex.m_path_length;
 }
 
@@ -721,6 +773,10 @@ bool PathTracer<PathVisitor, VolumeVisitor, Adjoint>::process_bounce(
 
         if (vertex.m_path_length == 1 && sample.get_mode() == ScatteringMode::Diffuse)
             m_path_visitor.on_first_diffuse_bounce(vertex, sample.m_aov_components.m_albedo);
+
+        // Optionally sample the learned radiance distribution instead.
+        if (m_path_guiding_context)
+            guide_bounce(sampling_context, vertex, local_geometry, sample);
     }
     else
     {
@@ -751,6 +807,16 @@ bool PathTracer<PathVisitor, VolumeVisitor, Adjoint>::process_bounce(
         sample.m_value /= sample.get_probability();
     vertex.m_throughput *= sample.m_value.m_beauty;
 
+    // Let the learned radiance distribution know about the scattering event.
+    if (m_path_guiding_context && sample.get_mode() != ScatteringMode::Specular)
+    {
+        m_path_guiding_context->add_vertex(
+            vertex.get_point(),
+            sample.m_incoming.get_value(),
+            vertex.m_throughput,
+            sample.get_probability());
+    }
+
     // Update bounce counters.
     ++vertex.m_path_length;
     m_diffuse_bounces +=  (sample.get_mode() >> ScatteringMode::DiffuseBitShift)  & 1;
@@ -778,6 +844,86 @@ bool PathTracer<PathVisitor, VolumeVisitor, Adjoint>::process_bounce(
     return true;
 }
 
+template <typename PathVisitor, typename VolumeVisitor, bool Adjoint>
+void PathTracer<PathVisitor, VolumeVisitor, Adjoint>::guide_bounce(
+    SamplingContext&            sampling_context,
+    const PathVertex&           vertex,
+    const BSDF::LocalGeometry&  local_geometry,
+    BSDFSample&                 sample) const
+{
+    const DTree* dtree = m_path_guiding_context->get_guiding_dtree(vertex);
+    if (dtree == nullptr)
+        return;
+
+    const float bsdf_fraction = m_path_guiding_context->get_sd_tree().get_bsdf_sampling_fraction();
+
+    sampling_context.split_in_place(3, 1);
+    const foundation::Vector3f s = sampling_context.next2<foundation::Vector3f>();
+
+    if (s[0] < bsdf_fraction)
+    {
+        // Keep the BSDF sample.
+        if (sample.get_mode() == ScatteringMode::None)
+            return;
+
+        if (sample.get_mode() == ScatteringMode::Specular)
+        {
+            // The learned distribution cannot generate this direction.
+            sample.m_value /= bsdf_fraction;
+        }
+        else
+        {
+            const float guide_prob = dtree->evaluate_pdf(sample.m_incoming.get_value());
+            sample.set_to_scattering(
+                sample.get_mode(),
+                bsdf_fraction * sample.get_probability() + (1.0f - bsdf_fraction) * guide_prob);
+        }
+    }
+    else
+    {
+        // Sample the learned distribution and evaluate the BSDF in the chosen direction.
+        float guide_prob;
+        const foundation::Vector3f incoming =
+            dtree->sample(foundation::Vector2f(s[1], s[2]), guide_prob);
+
+        const foundation::Vector3f outgoing(vertex.m_outgoing.get_value());
+        DirectShadingComponents value;
+        const float bsdf_prob =
+            vertex.m_bsdf->evaluate(
+                vertex.m_bsdf_data,
+                Adjoint,
+                true,       // multiply by |cos(incoming, normal)|
+                local_geometry,
+                outgoing,
+                incoming,
+                vertex.m_scattering_modes,
+                value);
+
+        if (bsdf_prob == 0.0f)
+        {
+            sample.set_to_absorption();
+            return;
+        }
+
+        // Classify the scattering event for bounce limits and visibility flags.
+        const bool diffuse =
+            ScatteringMode::has_diffuse(vertex.m_scattering_modes) &&
+            vertex.m_bsdf->evaluate_pdf(
+                vertex.m_bsdf_data,
+                Adjoint,
+                local_geometry,
+                outgoing,
+                incoming,
+                ScatteringMode::Diffuse) > 0.0f;
+
+        sample.m_incoming = foundation::Dual3f(incoming);
+        sample.m_value = value;
+        sample.set_to_scattering(
+            diffuse ? ScatteringMode::Diffuse : ScatteringMode::Glossy,
+            bsdf_fraction * bsdf_prob + (1.0f - bsdf_fraction) * guide_prob);
+    }
+}
+
 template <typename PathVisitor, typename VolumeVisitor, bool Adjoint>
 bool PathTracer<PathVisitor, VolumeVisitor, Adjoint>::march(
     SamplingContext&            sampling_context,
@@ -804,7 +950,7 @@ bool PathTracer<PathVisitor, VolumeVisitor, Adjoint>::march(
 
     while (true)
     {
-        shading_context.get_arena().clear();
+        recycle_arena(shading_context);
 
         // Put a hard limit on the number of iterations.
         if (m_iterations++ == m_max_iterations)
@@ -894,7 +1040,11 @@ bool PathTracer<PathVisitor, VolumeVisitor, Adjoint>::march(
         // Bounce.
         //
 
-        ShadingPoint* next_shading_point = m_shading_point_arena.allocate<ShadingPoint>();
+        ShadingPoint* next_shading_point =
+            acquire_shading_point(
+                vertex.m_shading_point,
+                vertex.m_parent_shading_point,
+                &exit_point);
         shading_context.get_intersector().make_volume_shading_point(
             *next_shading_point,
             volume_ray,
@@ -994,9 +1144,40 @@ bool PathTracer<PathVisitor, VolumeVisitor, Adjoint>::march(
 }
 
 template <typename PathVisitor, typename VolumeVisitor, bool Adjoint>
-inline const ShadingPoint& PathTracer<PathVisitor, VolumeVisitor, Adjoint>::get_path_vertex(const size_t i) const
+inline ShadingPoint* PathTracer<PathVisitor, VolumeVisitor, Adjoint>::acquire_shading_point(
+    const ShadingPoint*         in_use1,
+    const ShadingPoint*         in_use2,
+    const ShadingPoint*         in_use3) const
+{
+    assert(m_shading_points);
+
+    for (size_t i = 0; i < ShadingPointCount; ++i)
+    {
+        ShadingPoint* shading_point = m_shading_points + i;
+
+        if (shading_point != in_use1 && shading_point != in_use2 && shading_point != in_use3)
+            return new (shading_point) ShadingPoint();
+    }
+
+    assert(!"All shading points are in use.");
+    return nullptr;
+}
+
+template <typename PathVisitor, typename VolumeVisitor, bool Adjoint>
+inline void PathTracer<PathVisitor, VolumeVisitor, Adjoint>::recycle_arena(
+    const ShadingContext&       shading_context)
+{
+    foundation::Arena& arena = shading_context.get_arena();
+
+    m_vertex_footprint.insert(sizeof(ShadingPoint) + arena.get_size());
+
+    arena.clear();
+}
+
+template <typename PathVisitor, typename VolumeVisitor, bool Adjoint>
+inline const foundation::Population<std::uint64_t>& PathTracer<PathVisitor, VolumeVisitor, Adjoint>::get_vertex_footprint() const
 {
-    return reinterpret_cast<const ShadingPoint*>(m_shading_point_arena.get_storage())[i];
+    return m_vertex_footprint;
 }
 
 }   // namespace renderer
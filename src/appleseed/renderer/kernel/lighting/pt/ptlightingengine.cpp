@@ -41,6 +41,7 @@
 #include "renderer/kernel/lighting/pathtracer.h"
 #include "renderer/kernel/lighting/pathvertex.h"
 #include "renderer/kernel/lighting/scatteringmode.h"
+#include "renderer/kernel/lighting/sdtree.h"
 #include "renderer/kernel/lighting/volumelightingintegrator.h"
 #include "renderer/kernel/shading/shadingcomponents.h"
 #include "renderer/kernel/shading/shadingcontext.h"
@@ -57,6 +58,7 @@
 #include "foundation/containers/dictionary.h"
 #include "foundation/math/mis.h"
 #include "foundation/math/population.h"
+#include "foundation/math/scalar.h"
 #include "foundation/math/vector.h"
 #include "foundation/string/string.h"
 #include "foundation/utility/statistics.h"
@@ -98,9 +100,11 @@ namespace
         PTLightingEngine(
             const BackwardLightSampler&     light_sampler,
             LightPathRecorder&              light_path_recorder,
+            SDTree*                         sd_tree,
             const ParamArray&               params)
           : m_params(params)
           , m_light_sampler(light_sampler)
+          , m_sd_tree(sd_tree)
           , m_light_path_stream(
               m_params.m_record_light_paths
                   ? light_path_recorder.create_stream()
@@ -135,7 +139,8 @@ namespace
                 "  max ray intensity             %s\n"
                 "  volume distance samples       %s\n"
                 "  equiangular sampling          %s\n"
-                "  clamp roughness               %s",
+                "  clamp roughness               %s\n"
+                "  path guiding                  %s",
                 m_params.m_enable_dl ? "on" : "off",
                 m_params.m_enable_ibl ? "on" : "off",
                 m_params.m_enable_caustics ? "on" : "off",
@@ -152,7 +157,8 @@ namespace
                 m_params.m_has_max_ray_intensity ? pretty_scalar(m_params.m_max_ray_intensity).c_str() : "unlimited",
                 pretty_int(m_params.m_distance_sample_count).c_str(),
                 m_params.m_enable_equiangular_sampling ? "on" : "off",
-                m_params.m_clamp_roughness ? "on" : "off");
+                m_params.m_clamp_roughness ? "on" : "off",
+                m_params.m_enable_path_guiding ? "on" : "off");
         }
 
         void compute_lighting(
@@ -171,36 +177,72 @@ namespace
                     shading_point.get_ray().m_org);
             }
 
-            if (m_params.m_next_event_estimation)
+            if (m_sd_tree)
             {
-                do_compute_lighting<PathVisitorNextEventEstimation, VolumeVisitorDistanceSampling>(
+                // Guide the path with the learned radiance distribution and let it learn from the path.
+                PathGuidingContext path_guiding_context(*m_sd_tree);
+                compute_path_lighting(
                     sampling_context,
                     shading_context,
                     shading_point,
                     radiance,
-                    aov_components);
+                    aov_components,
+                    &path_guiding_context);
+                path_guiding_context.commit();
             }
             else
             {
-                do_compute_lighting<PathVisitorSimple, VolumeVisitorSimple>(
+                compute_path_lighting(
                     sampling_context,
                     shading_context,
                     shading_point,
                     radiance,
-                    aov_components);
+                    aov_components,
+                    nullptr);
             }
 
             if (m_light_path_stream)
                 m_light_path_stream->end_path();
         }
 
+        void compute_path_lighting(
+            SamplingContext&        sampling_context,
+            const ShadingContext&   shading_context,
+            const ShadingPoint&     shading_point,
+            ShadingComponents&      radiance,               // output radiance, in W.sr^-1.m^-2
+            AOVComponents&          aov_components,
+            PathGuidingContext*     path_guiding_context)
+        {
+            if (m_params.m_next_event_estimation)
+            {
+                do_compute_lighting<PathVisitorNextEventEstimation, VolumeVisitorDistanceSampling>(
+                    sampling_context,
+                    shading_context,
+                    shading_point,
+                    radiance,
+                    aov_components,
+                    path_guiding_context);
+            }
+            else
+            {
+                do_compute_lighting<PathVisitorSimple, VolumeVisitorSimple>(
+                    sampling_context,
+                    shading_context,
+                    shading_point,
+                    radiance,
+                    aov_components,
+                    path_guiding_context);
+            }
+        }
+
         template <typename PathVisitor, typename VolumeVisitor>
         void do_compute_lighting(
             SamplingContext&        sampling_context,
             const ShadingContext&   shading_context,
             const ShadingPoint&     shading_point,
             ShadingComponents&      radiance,               // output radiance, in W.sr^-1.m^-2
-            AOVComponents&          aov_components)
+            AOVComponents&          aov_components,
+            PathGuidingContext*     path_guiding_context)
         {
             PathVisitor path_visitor(
                 m_params,
@@ -210,7 +252,8 @@ namespace
                 shading_point.get_scene(),
                 radiance,
                 aov_components,
-                m_light_path_stream);
+                m_light_path_stream,
+                path_guiding_context);
 
             VolumeVisitor volume_visitor(
                 m_params,
@@ -231,7 +274,9 @@ namespace
                 m_params.m_max_specular_bounces,
                 m_params.m_max_volume_bounces,
                 m_params.m_clamp_roughness,
-                shading_context.get_max_iterations());
+                shading_context.get_max_iterations(),
+                0.0,                                    // near_start
+                path_guiding_context);
 
             const size_t path_length =
                 path_tracer.trace(
@@ -242,6 +287,7 @@ namespace
             // Update statistics.
             ++m_path_count;
             m_path_length.insert(path_length);
+            m_vertex_footprint.merge(path_tracer.get_vertex_footprint());
         }
 
         StatisticsVector get_statistics() const override
@@ -249,11 +295,11 @@ namespace
             Statistics stats;
             stats.insert("path count", m_path_count);
             stats.insert("path length", m_path_length);
+            stats.insert("vertex footprint", m_vertex_footprint, "bytes");
 
             return StatisticsVector::make("path tracing statistics", stats);
         }
 
-      private:
         struct Parameters
         {
             const bool      m_enable_dl;                    // is direct lighting enabled?
@@ -285,6 +331,11 @@ namespace
 
             const bool      m_record_light_paths;
 
+            const bool      m_enable_path_guiding;          // guide paths with a learned radiance distribution?
+            const size_t    m_guiding_training_passes;      // number of passes during which the radiance distribution is learned
+            const float     m_guiding_bsdf_sampling_fraction;   // probability of sampling the BSDF rather than the learned distribution
+            const size_t    m_guiding_max_memory;           // memory budget of the learned distribution, in megabytes
+
             explicit Parameters(const ParamArray& params)
               : m_enable_dl(params.get_optional<bool>("enable_dl", true))
               , m_enable_ibl(params.get_optional<bool>("enable_ibl", true))
@@ -305,6 +356,10 @@ namespace
               , m_distance_sample_count(params.get_optional<size_t>("volume_distance_samples", 2))
               , m_enable_equiangular_sampling(!params.get_optional<bool>("optimize_for_lights_outside_volumes", false))
               , m_record_light_paths(params.get_optional<bool>("record_light_paths", false))
+              , m_enable_path_guiding(params.get_optional<bool>("enable_path_guiding", false))
+              , m_guiding_training_passes(params.get_optional<size_t>("guiding_training_passes", 8))
+              , m_guiding_bsdf_sampling_fraction(clamp(params.get_optional<float>("guiding_bsdf_sampling_fraction", 0.5f), 0.1f, 1.0f))
+              , m_guiding_max_memory(params.get_optional<size_t>("guiding_max_memory", 256))
             {
                 // Precompute the reciprocal of the number of light samples.
                 m_rcp_dl_light_sample_count =
@@ -330,12 +385,15 @@ namespace
             }
         };
 
+      private:
         const Parameters                m_params;
         const BackwardLightSampler&     m_light_sampler;
+        SDTree*                         m_sd_tree;
         LightPathStream*                m_light_path_stream;
 
         std::uint64_t                   m_path_count;
         Population<std::uint64_t>       m_path_length;
+        Population<std::uint64_t>       m_vertex_footprint;
 
         size_t                          m_inf_volume_ray_warnings;
         static const size_t             MaxInfVolumeRayWarnings = 5;
@@ -385,6 +443,7 @@ namespace
             ShadingComponents&                  m_path_radiance;
             AOVComponents&                      m_aov_components;
             LightPathStream*                    m_light_path_stream;
+            PathGuidingContext*                 m_path_guiding_context;
             bool                                m_omit_emitted_light;
 
             PathVisitorBase(
@@ -395,7 +454,8 @@ namespace
                 const Scene&                    scene,
                 ShadingComponents&              path_radiance,
                 AOVComponents&                  aov_components,
-                LightPathStream*                light_path_stream)
+                LightPathStream*                light_path_stream,
+                PathGuidingContext*             path_guiding_context)
               : m_params(params)
               , m_light_sampler(light_sampler)
               , m_sampling_context(sampling_context)
@@ -404,9 +464,36 @@ namespace
               , m_path_radiance(path_radiance)
               , m_aov_components(aov_components)
               , m_light_path_stream(light_path_stream)
+              , m_path_guiding_context(path_guiding_context)
               , m_omit_emitted_light(false)
             {
             }
+
+            void add_path_radiance(
+                const PathVertex&               vertex,
+                const Spectrum&                 radiance)
+            {
+                m_path_radiance.add_emission(
+                    vertex.m_path_length,
+                    vertex.m_aov_mode,
+                    radiance);
+
+                if (m_path_guiding_context)
+                    m_path_guiding_context->add_radiance(radiance);
+            }
+
+            void add_path_radiance(
+                const PathVertex&               vertex,
+                const DirectShadingComponents&  radiance)
+            {
+                m_path_radiance.add(
+                    vertex.m_path_length,
+                    vertex.m_aov_mode,
+                    radiance);
+
+                if (m_path_guiding_context)
+                    m_path_guiding_context->add_radiance(radiance.m_beauty);
+            }
         };
 
         //
@@ -425,7 +512,8 @@ namespace
                 const Scene&                    scene,
                 ShadingComponents&              path_radiance,
                 AOVComponents&                  aov_components,
-                LightPathStream*                light_path_stream)
+                LightPathStream*                light_path_stream,
+                PathGuidingContext*             path_guiding_context)
               : PathVisitorBase(
                     params,
                     light_sampler,
@@ -434,7 +522,8 @@ namespace
                     scene,
                     path_radiance,
                     aov_components,
-                    light_path_stream)
+                    light_path_stream,
+                    path_guiding_context)
             {
             }
 
@@ -461,10 +550,7 @@ namespace
 
                 // Update path radiance.
                 env_radiance *= vertex.m_throughput;
-                m_path_radiance.add_emission(
-                    vertex.m_path_length,
-                    vertex.m_aov_mode,
-                    env_radiance);
+                add_path_radiance(vertex, env_radiance);
             }
 
             void on_hit(const PathVertex& vertex)
@@ -488,10 +574,7 @@ namespace
                     emitted_radiance *= vertex.m_throughput;
 
                     // Update path radiance.
-                    m_path_radiance.add_emission(
-                        vertex.m_path_length,
-                        vertex.m_aov_mode,
-                        emitted_radiance);
+                    add_path_radiance(vertex, emitted_radiance);
                 }
                 else
                 {
@@ -530,7 +613,8 @@ namespace
                 const Scene&                    scene,
                 ShadingComponents&              path_radiance,
                 AOVComponents&                  aov_components,
-                LightPathStream*                light_path_stream)
+                LightPathStream*                light_path_stream,
+                PathGuidingContext*             path_guiding_context)
               : PathVisitorBase(
                     params,
                     light_sampler,
@@ -539,7 +623,8 @@ namespace
                     scene,
                     path_radiance,
                     aov_components,
-                    light_path_stream)
+                    light_path_stream,
+                    path_guiding_context)
               , m_is_indirect_lighting(false)
             {
             }
@@ -590,10 +675,7 @@ namespace
                     clamp_contribution(env_radiance, m_params.m_max_ray_intensity);
 
                 // Update path radiance.
-                m_path_radiance.add_emission(
-                    vertex.m_path_length,
-                    vertex.m_aov_mode,
-                    env_radiance);
+                add_path_radiance(vertex, env_radiance);
             }
 
             void on_hit(const PathVertex& vertex)
@@ -621,10 +703,7 @@ namespace
                         clamp_contribution(emitted_radiance, m_params.m_max_ray_intensity);
 
                     // Update path radiance.
-                    m_path_radiance.add_emission(
-                        vertex.m_path_length,
-                        vertex.m_aov_mode,
-                        emitted_radiance);
+                    add_path_radiance(vertex, emitted_radiance);
                 }
                 else
                 {
@@ -676,6 +755,12 @@ namespace
                     }
                 }
 
+                // The path may be extended by sampling the learned radiance distribution.
+                const DTree* guiding_dtree =
+                    m_path_guiding_context
+                        ? m_path_guiding_context->get_guiding_dtree(vertex)
+                        : nullptr;
+
                 // Direct lighting contribution.
                 if (m_params.m_enable_dl || vertex.m_path_length > 1)
                 {
@@ -687,6 +772,7 @@ namespace
                             *vertex.m_bsdf,
                             vertex.m_bsdf_data,
                             vertex.m_scattering_modes,
+                            guiding_dtree,
                             vertex_radiance,
                             m_light_path_stream);
                     }
@@ -703,6 +789,7 @@ namespace
                             *vertex.m_bsdf,
                             vertex.m_bsdf_data,
                             vertex.m_scattering_modes,
+                            guiding_dtree,
                             vertex_radiance,
                             m_light_path_stream);
                     }
@@ -716,10 +803,7 @@ namespace
                     clamp_contribution(vertex_radiance, m_params.m_max_ray_intensity);
 
                 // Update path radiance.
-                m_path_radiance.add(
-                    vertex.m_path_length,
-                    vertex.m_aov_mode,
-                    vertex_radiance);
+                add_path_radiance(vertex, vertex_radiance);
             }
 
           private:
@@ -754,6 +838,7 @@ namespace
                 const BSDF&                 bsdf,
                 const void*                 bsdf_data,
                 const int                   scattering_modes,
+                const DTree*                guiding_dtree,
                 DirectShadingComponents&    vertex_radiance,
                 LightPathStream*            light_path_stream)
             {
@@ -771,9 +856,11 @@ namespace
                     bsdf,
                     bsdf_data,
                     scattering_modes,       // bsdf_sampling_modes (unused)
-                    shading_point);
+                    shading_point,
+                    guiding_dtree,
+                    m_params.m_guiding_bsdf_sampling_fraction);
 
-                // This path will be extended via BSDF sampling: sample the lights only.
+                // This path will be extended via BSDF or guided sampling: sample the lights only.
                 const DirectLightingIntegrator integrator(
                     m_shading_context,
                     m_light_sampler,
@@ -805,6 +892,7 @@ namespace
                 const BSDF&                 bsdf,
                 const void*                 bsdf_data,
                 const int                   scattering_modes,
+                const DTree*                guiding_dtree,
                 DirectShadingComponents&    vertex_radiance,
                 LightPathStream*            light_path_stream)
             {
@@ -819,9 +907,11 @@ namespace
                     bsdf,
                     bsdf_data,
                     scattering_modes,       // bsdf_sampling_modes (unused)
-                    shading_point);
+                    shading_point,
+                    guiding_dtree,
+                    m_params.m_guiding_bsdf_sampling_fraction);
 
-                // This path will be extended via BSDF sampling: sample the environment only.
+                // This path will be extended via BSDF or guided sampling: sample the environment only.
                 compute_ibl_environment_sampling(
                     m_sampling_context,
                     m_shading_context,
@@ -1218,16 +1308,74 @@ Dictionary PTLightingEngineFactory::get_params_metadata()
             .insert("label", "Record Light Paths")
             .insert("help", "Record light paths in memory to later allow visualizing them or saving them to disk"));
 
+    metadata.dictionaries().insert(
+        "enable_path_guiding",
+        Dictionary()
+            .insert("type", "bool")
+            .insert("default", "false")
+            .insert("label", "Enable Path Guiding")
+            .insert("help", "Learn the distribution of incoming light during the first passes and use it to guide paths (not supported by the progressive frame renderer)"));
+
+    metadata.dictionaries().insert(
+        "guiding_training_passes",
+        Dictionary()
+            .insert("type", "int")
+            .insert("default", "8")
+            .insert("min", "1")
+            .insert("label", "Guiding Training Passes")
+            .insert("help", "Number of passes during which the distribution of incoming light is learned"));
+
+    metadata.dictionaries().insert(
+        "guiding_bsdf_sampling_fraction",
+        Dictionary()
+            .insert("type", "float")
+            .insert("default", "0.5")
+            .insert("min", "0.1")
+            .insert("max", "1.0")
+            .insert("label", "Guiding BSDF Sampling Fraction")
+            .insert("help", "Probability of sampling the BSDF rather than the learned distribution of incoming light"));
+
+    metadata.dictionaries().insert(
+        "guiding_max_memory",
+        Dictionary()
+            .insert("type", "int")
+            .insert("default", "256")
+            .insert("min", "1")
+            .insert("label", "Guiding Max Memory")
+            .insert("help", "Maximum amount of memory in megabytes used by the learned distribution of incoming light"));
+
     return metadata;
 }
 
 PTLightingEngineFactory::PTLightingEngineFactory(
+    const Scene&                    scene,
     const BackwardLightSampler&     light_sampler,
     LightPathRecorder&              light_path_recorder,
     const ParamArray&               params)
   : m_light_sampler(light_sampler)
   , m_light_path_recorder(light_path_recorder)
   , m_params(params)
+{
+    const PTLightingEngine::Parameters engine_params(params);
+
+    if (engine_params.m_enable_path_guiding)
+    {
+        const GAABB3 scene_bbox = scene.compute_bbox();
+
+        if (scene_bbox.is_valid())
+        {
+            m_sd_tree.reset(
+                new SDTree(
+                    AABB3d(scene_bbox),
+                    engine_params.m_guiding_bsdf_sampling_fraction,
+                    engine_params.m_guiding_training_passes,
+                    engine_params.m_guiding_max_memory * 1024 * 1024));
+        }
+        else RENDERER_LOG_WARNING("scene is empty, disabling path guiding.");
+    }
+}
+
+PTLightingEngineFactory::~PTLightingEngineFactory()
 {
 }
 
@@ -1242,7 +1390,19 @@ ILightingEngine* PTLightingEngineFactory::create()
         new PTLightingEngine(
             m_light_sampler,
             m_light_path_recorder,
+            m_sd_tree.get(),
             m_params);
 }
 
+bool PTLightingEngineFactory::has_path_guiding() const
+{
+    return m_sd_tree != nullptr;
+}
+
+void PTLightingEngineFactory::on_pass_end()
+{
+    if (m_sd_tree)
+        m_sd_tree->update();
+}
+
 }   // namespace renderer
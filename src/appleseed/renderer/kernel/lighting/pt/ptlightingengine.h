@@ -36,10 +36,15 @@
 // appleseed.foundation headers.
 #include "foundation/platform/compiler.h"
 
+// Standard headers.
+#include <memory>
+
 // Forward declarations.
 namespace foundation    { class Dictionary; }
 namespace renderer      { class BackwardLightSampler; }
 namespace renderer      { class LightPathRecorder; }
+namespace renderer      { class Scene; }
+namespace renderer      { class SDTree; }
 
 namespace renderer
 {
@@ -57,20 +62,31 @@ class PTLightingEngineFactory
 
     // Constructor.
     PTLightingEngineFactory(
+        const Scene&                    scene,
         const BackwardLightSampler&     light_sampler,
         LightPathRecorder&              light_path_recorder,
         const ParamArray&               params);
 
+    // Destructor.
+    ~PTLightingEngineFactory() override;
+
     // Delete this instance.
     void release() override;
 
     // Return a new path tracing lighting engine instance.
     ILightingEngine* create() override;
 
+    // Return true if paths are guided by a radiance distribution learned across passes.
+    bool has_path_guiding() const;
+
+    // Refine the learned radiance distribution at the end of a pass.
+    void on_pass_end();
+
   private:
     const BackwardLightSampler&         m_light_sampler;
     LightPathRecorder&                  m_light_path_recorder;
     ParamArray                          m_params;
+    std::unique_ptr<SDTree>             m_sd_tree;
 };
 
 }   // namespace renderer
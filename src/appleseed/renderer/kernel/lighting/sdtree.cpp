@@ -0,0 +1,579 @@
+
+//
+// This source file is part of appleseed.
+// Visit https://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2019 The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+// Interface header.
+#include "sdtree.h"
+
+// appleseed.renderer headers.
+#include "renderer/global/globallogger.h"
+#include "renderer/kernel/lighting/pathvertex.h"
+#include "renderer/kernel/lighting/scatteringmode.h"
+#include "renderer/modeling/bsdf/bsdf.h"
+
+// appleseed.foundation headers.
+#include "foundation/math/scalar.h"
+#include "foundation/platform/atomic.h"
+#include "foundation/platform/timers.h"
+#include "foundation/string/string.h"
+#include "foundation/utility/statistics.h"
+#include "foundation/utility/stopwatch.h"
+
+// Standard headers.
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <utility>
+
+using namespace foundation;
+
+namespace renderer
+{
+
+namespace
+{
+    // Fraction of the energy of a quadtree above which a quadrant is subdivided.
+    const float DTreeSubdivisionThreshold = 0.01f;
+
+    // Maximum depth of the directional quadtrees.
+    const size_t DTreeMaxDepth = 20;
+
+    // Number of samples recorded in a spatial leaf during a pass above which it is split.
+    const std::uint32_t SpatialSplitThreshold = 12000;
+
+    // Largest value strictly less than 1.
+    const float OneMinusEpsilon = 1.0f - 0.5f * std::numeric_limits<float>::epsilon();
+
+    Vector2f direction_to_canonical(const Vector3f& direction)
+    {
+        const float cos_theta = clamp(direction.z, -1.0f, 1.0f);
+
+        float phi = std::atan2(direction.y, direction.x);
+        if (phi < 0.0f)
+            phi += TwoPi<float>();
+
+        return
+            Vector2f(
+                clamp((cos_theta + 1.0f) * 0.5f, 0.0f, OneMinusEpsilon),
+                clamp(phi * RcpTwoPi<float>(), 0.0f, OneMinusEpsilon));
+    }
+
+    Vector3f canonical_to_direction(const Vector2f& p)
+    {
+        const float cos_theta = 2.0f * p.x - 1.0f;
+        const float sin_theta = std::sqrt(std::max(1.0f - cos_theta * cos_theta, 0.0f));
+        const float phi = TwoPi<float>() * p.y;
+
+        return
+            Vector3f(
+                sin_theta * std::cos(phi),
+                sin_theta * std::sin(phi),
+                cos_theta);
+    }
+
+    // Pick one of two halves of [0, 1) with a given probability for the lower half, and remap s into it.
+    size_t sample_half(const float p_lower, float& s)
+    {
+        if (s < p_lower)
+        {
+            s = std::min(s / p_lower, OneMinusEpsilon);
+            return 0;
+        }
+        else
+        {
+            s = std::min((s - p_lower) / (1.0f - p_lower), OneMinusEpsilon);
+            return 1;
+        }
+    }
+}
+
+
+//
+// DTree class implementation.
+//
+
+DTree::DTree()
+  : m_nodes(1, Node())
+{
+    Node& root = m_nodes[0];
+
+    for (size_t i = 0; i < 4; ++i)
+    {
+        root.m_sums[i] = 0.0f;
+        root.m_children[i] = 0;
+    }
+}
+
+Vector3f DTree::sample(const Vector2f& s, float& pdf) const
+{
+    assert(is_valid());
+
+    Vector2f p(s);
+    Vector2f origin(0.0f);
+    float size = 1.0f;
+    size_t node_index = 0;
+    pdf = 1.0f;
+
+    while (true)
+    {
+        const Node& node = m_nodes[node_index];
+        const float total = node.m_sums[0] + node.m_sums[1] + node.m_sums[2] + node.m_sums[3];
+        assert(total > 0.0f);
+
+        // Choose the column, then the quadrant within the column.
+        const size_t x = sample_half((node.m_sums[0] + node.m_sums[2]) / total, p.x);
+        const float column = node.m_sums[x] + node.m_sums[x + 2];
+        const size_t y = sample_half(node.m_sums[x] / column, p.y);
+        const size_t quadrant = x + 2 * y;
+
+        pdf *= 4.0f * node.m_sums[quadrant] / total;
+
+        size *= 0.5f;
+        origin.x += x * size;
+        origin.y += y * size;
+
+        if (node.m_children[quadrant] == 0)
+            break;
+
+        node_index = node.m_children[quadrant];
+    }
+
+    pdf *= RcpFourPi<float>();
+
+    return canonical_to_direction(origin + size * p);
+}
+
+float DTree::evaluate_pdf(const Vector3f& direction) const
+{
+    Vector2f p = direction_to_canonical(direction);
+    size_t node_index = 0;
+    float pdf = RcpFourPi<float>();
+
+    while (true)
+    {
+        const Node& node = m_nodes[node_index];
+        const float total = node.m_sums[0] + node.m_sums[1] + node.m_sums[2] + node.m_sums[3];
+        if (total <= 0.0f)
+            return 0.0f;
+
+        const size_t x = p.x < 0.5f ? 0 : 1;
+        const size_t y = p.y < 0.5f ? 0 : 1;
+        const size_t quadrant = x + 2 * y;
+
+        pdf *= 4.0f * node.m_sums[quadrant] / total;
+
+        if (node.m_children[quadrant] == 0 || pdf == 0.0f)
+            return pdf;
+
+        p.x = 2.0f * p.x - x;
+        p.y = 2.0f * p.y - y;
+        node_index = node.m_children[quadrant];
+    }
+}
+
+void DTree::record(const Vector3f& direction, const float radiance)
+{
+    Vector2f p = direction_to_canonical(direction);
+    size_t node_index = 0;
+
+    while (true)
+    {
+        Node& node = m_nodes[node_index];
+
+        const size_t x = p.x < 0.5f ? 0 : 1;
+        const size_t y = p.y < 0.5f ? 0 : 1;
+        const size_t quadrant = x + 2 * y;
+
+        atomic_add(&node.m_sums[quadrant], radiance);
+
+        if (node.m_children[quadrant] == 0)
+            break;
+
+        p.x = 2.0f * p.x - x;
+        p.y = 2.0f * p.y - y;
+        node_index = node.m_children[quadrant];
+    }
+}
+
+void DTree::refine_from(
+    const DTree&        source,
+    const float         subdivision_threshold,
+    const size_t        max_depth,
+    const size_t        max_node_count)
+{
+    struct Entry
+    {
+        size_t  m_source_index;             // corresponding node of the source tree, ~0 if none
+        float   m_source_sums[4];           // energy of the quadrants of this node in the source tree
+        size_t  m_depth;
+    };
+
+    const float total = source.get_energy();
+
+    m_nodes.assign(1, Node());
+
+    std::vector<Entry> entries;
+    entries.reserve(source.m_nodes.size());
+    entries.push_back(Entry());
+    entries[0].m_source_index = 0;
+    entries[0].m_depth = 1;
+    std::copy(source.m_nodes[0].m_sums, source.m_nodes[0].m_sums + 4, entries[0].m_source_sums);
+
+    // Nodes are created in breadth-first order so that the node budget limits depth evenly.
+    for (size_t node_index = 0; node_index < m_nodes.size(); ++node_index)
+    {
+        const Entry entry = entries[node_index];
+
+        for (size_t quadrant = 0; quadrant < 4; ++quadrant)
+        {
+            m_nodes[node_index].m_sums[quadrant] = 0.0f;
+            m_nodes[node_index].m_children[quadrant] = 0;
+
+            const float energy = entry.m_source_sums[quadrant];
+
+            if (total <= 0.0f ||
+                energy <= subdivision_threshold * total ||
+                entry.m_depth >= max_depth ||
+                m_nodes.size() + 1 > max_node_count)
+                continue;
+
+            Entry child;
+            child.m_source_index =
+                entry.m_source_index != ~size_t(0)
+                    ? source.m_nodes[entry.m_source_index].m_children[quadrant]
+                    : 0;
+            child.m_depth = entry.m_depth + 1;
+
+            if (child.m_source_index != 0)
+            {
+                // The source tree knows how the energy is distributed below this quadrant.
+                const Node& source_child = source.m_nodes[child.m_source_index];
+                std::copy(source_child.m_sums, source_child.m_sums + 4, child.m_source_sums);
+            }
+            else
+            {
+                // Otherwise assume that the energy is uniformly distributed.
+                child.m_source_index = ~size_t(0);
+                std::fill(child.m_source_sums, child.m_source_sums + 4, 0.25f * energy);
+            }
+
+            m_nodes[node_index].m_children[quadrant] = static_cast<std::uint32_t>(m_nodes.size());
+            m_nodes.push_back(Node());
+            entries.push_back(child);
+        }
+    }
+
+    m_nodes.shrink_to_fit();
+}
+
+
+//
+// SDTree class implementation.
+//
+
+SDTree::SDTree(
+    const AABB3d&       bbox,
+    const float         bsdf_sampling_fraction,
+    const size_t        training_pass_count,
+    const size_t        max_memory_size)
+  : m_bsdf_sampling_fraction(bsdf_sampling_fraction)
+  , m_training_pass_count(training_pass_count)
+  , m_max_memory_size(max_memory_size)
+  , m_bbox(bbox)
+  , m_pass_count(0)
+  , m_trained(false)
+{
+    assert(bsdf_sampling_fraction > 0.0f && bsdf_sampling_fraction <= 1.0f);
+
+    // Make sure the bounding box has a non-zero extent along every axis.
+    m_bbox.robust_grow(1.0e-4);
+
+    const Vector3d extent = m_bbox.extent();
+    for (size_t i = 0; i < 3; ++i)
+        m_rcp_extent[i] = 1.0 / extent[i];
+
+    SpatialNode root;
+    root.m_children[0] = root.m_children[1] = 0;
+    root.m_axis = 0;
+    root.m_leaf_index = 0;
+    m_nodes.push_back(root);
+
+    m_leaves.push_back(SpatialLeaf());
+    m_leaves[0].m_sample_count = 0;
+}
+
+void SDTree::record(
+    const Vector3d&     point,
+    const Vector3f&     direction,
+    const float         radiance)
+{
+    assert(is_recording());
+
+    const size_t leaf_index = find_leaf(point);
+    if (leaf_index == ~size_t(0))
+        return;
+
+    SpatialLeaf& leaf = m_leaves[leaf_index];
+    atomic_inc(&leaf.m_sample_count);
+
+    if (radiance > 0.0f && std::isfinite(radiance))
+        leaf.m_recording_dtree.record(direction, radiance);
+}
+
+void SDTree::update()
+{
+    if (!is_recording())
+        return;
+
+    Stopwatch<DefaultWallclockTimer> stopwatch;
+    stopwatch.start();
+
+    std::uint64_t recorded_sample_count = 0;
+    for (const SpatialLeaf& leaf : m_leaves)
+        recorded_sample_count += leaf.m_sample_count;
+
+    // Split the spatial leaves that received the most samples.
+    const size_t split_leaf_count = refine_spatial_tree();
+
+    ++m_pass_count;
+
+    // Sample the radiance recorded during this pass from now on.
+    m_trained = false;
+    for (SpatialLeaf& leaf : m_leaves)
+    {
+        if (leaf.m_recording_dtree.is_valid())
+        {
+            leaf.m_sampling_dtree = std::move(leaf.m_recording_dtree);
+            m_trained = true;
+        }
+        else if (leaf.m_sampling_dtree.is_valid())
+            m_trained = true;
+
+        leaf.m_recording_dtree = DTree();
+        leaf.m_sample_count = 0;
+    }
+
+    if (is_recording())
+    {
+        // Share what remains of the memory budget among the quadtrees recording the next pass.
+        const size_t memory_size = get_memory_size();
+        const size_t remaining_memory_size =
+            m_max_memory_size > memory_size ? m_max_memory_size - memory_size : 0;
+        const size_t max_dtree_node_count =
+            std::max<size_t>(
+                remaining_memory_size / (m_leaves.size() * DTree::get_node_memory_size()),
+                1);
+
+        for (SpatialLeaf& leaf : m_leaves)
+        {
+            leaf.m_recording_dtree.refine_from(
+                leaf.m_sampling_dtree,
+                DTreeSubdivisionThreshold,
+                DTreeMaxDepth,
+                max_dtree_node_count);
+        }
+    }
+
+    size_t dtree_node_count = 0;
+    for (const SpatialLeaf& leaf : m_leaves)
+        dtree_node_count += leaf.m_sampling_dtree.get_node_count();
+
+    stopwatch.measure();
+
+    Statistics statistics;
+    statistics.insert("recorded samples", recorded_sample_count);
+    statistics.insert("split spatial leaves", split_leaf_count);
+    statistics.insert("spatial leaves", m_leaves.size());
+    statistics.insert("directional nodes", dtree_node_count);
+    statistics.insert_size("memory size", get_memory_size());
+    statistics.insert_time("update time", stopwatch.get_seconds());
+    RENDERER_LOG_INFO("%s",
+        StatisticsVector::make(
+            "path guiding training pass " + pretty_uint(m_pass_count) +
+                " of " + pretty_uint(m_training_pass_count) + " statistics",
+            statistics).to_string().c_str());
+}
+
+size_t SDTree::get_memory_size() const
+{
+    size_t size =
+        sizeof(*this) +
+        m_nodes.capacity() * sizeof(SpatialNode) +
+        m_leaves.capacity() * sizeof(SpatialLeaf);
+
+    for (const SpatialLeaf& leaf : m_leaves)
+    {
+        size += leaf.m_sampling_dtree.get_memory_size() - sizeof(DTree);
+        size += leaf.m_recording_dtree.get_memory_size() - sizeof(DTree);
+    }
+
+    return size;
+}
+
+size_t SDTree::find_leaf(const Vector3d& point) const
+{
+    Vector3d p = (point - m_bbox.min) * m_rcp_extent;
+
+    for (size_t i = 0; i < 3; ++i)
+    {
+        if (!(p[i] >= 0.0 && p[i] <= 1.0))
+            return ~size_t(0);
+    }
+
+    size_t node_index = 0;
+
+    while (true)
+    {
+        const SpatialNode& node = m_nodes[node_index];
+
+        if (node.m_children[0] == 0)
+            return node.m_leaf_index;
+
+        const size_t axis = node.m_axis;
+        const size_t child = p[axis] < 0.5 ? 0 : 1;
+        p[axis] = 2.0 * p[axis] - child;
+        node_index = node.m_children[child];
+    }
+}
+
+size_t SDTree::refine_spatial_tree()
+{
+    size_t memory_size = get_memory_size();
+    size_t split_leaf_count = 0;
+
+    // Newly created nodes are visited as well, so that leaves are split recursively.
+    for (size_t node_index = 0; node_index < m_nodes.size(); ++node_index)
+    {
+        if (m_nodes[node_index].m_children[0] != 0)
+            continue;
+
+        const size_t leaf_index = m_nodes[node_index].m_leaf_index;
+        if (m_leaves[leaf_index].m_sample_count <= SpatialSplitThreshold)
+            continue;
+
+        // Honor the memory budget: a new leaf duplicates the quadtrees of its parent.
+        const size_t leaf_memory_size =
+            sizeof(SpatialLeaf) + 2 * sizeof(SpatialNode) +
+            2 * (m_leaves[leaf_index].m_recording_dtree.get_memory_size() - sizeof(DTree));
+        if (memory_size + leaf_memory_size > m_max_memory_size)
+            break;
+        memory_size += leaf_memory_size;
+
+        // Both halves are assumed to have received half of the samples.
+        m_leaves[leaf_index].m_sample_count /= 2;
+        const size_t new_leaf_index = m_leaves.size();
+        m_leaves.push_back(m_leaves[leaf_index]);
+
+        const std::uint32_t child_axis = (m_nodes[node_index].m_axis + 1) % 3;
+        const size_t first_child_index = m_nodes.size();
+
+        SpatialNode child;
+        child.m_children[0] = child.m_children[1] = 0;
+        child.m_axis = child_axis;
+        child.m_leaf_index = static_cast<std::uint32_t>(leaf_index);
+        m_nodes.push_back(child);
+        child.m_leaf_index = static_cast<std::uint32_t>(new_leaf_index);
+        m_nodes.push_back(child);
+
+        SpatialNode& node = m_nodes[node_index];
+        node.m_children[0] = static_cast<std::uint32_t>(first_child_index);
+        node.m_children[1] = static_cast<std::uint32_t>(first_child_index + 1);
+
+        ++split_leaf_count;
+    }
+
+    m_nodes.shrink_to_fit();
+    m_leaves.shrink_to_fit();
+
+    return split_leaf_count;
+}
+
+
+//
+// PathGuidingContext class implementation.
+//
+
+const DTree* PathGuidingContext::get_guiding_dtree(const PathVertex& vertex) const
+{
+    // The learned distribution can only help with non-specular scattering above the surface.
+    if (vertex.m_bsdf == nullptr ||
+        vertex.m_bssrdf != nullptr ||
+        vertex.m_bsdf->is_purely_specular() ||
+        !(ScatteringMode::has_diffuse(vertex.m_scattering_modes) ||
+          ScatteringMode::has_glossy(vertex.m_scattering_modes)))
+        return nullptr;
+
+    return m_sd_tree.get_sampling_dtree(vertex.get_point());
+}
+
+void PathGuidingContext::add_vertex(
+    const Vector3d&     point,
+    const Vector3f&     direction,
+    const Spectrum&     throughput,
+    const float         pdf)
+{
+    if (!m_recording || m_vertex_count == MaxVertexCount)
+        return;
+
+    Vertex& vertex = m_vertices[m_vertex_count++];
+    vertex.m_point = point;
+    vertex.m_direction = direction;
+    vertex.m_pdf = pdf;
+    vertex.m_radiance.set(0.0f);
+
+    for (size_t i = 0, e = Spectrum::size(); i < e; ++i)
+        vertex.m_rcp_throughput[i] = throughput[i] > 0.0f ? 1.0f / throughput[i] : 0.0f;
+}
+
+void PathGuidingContext::add_radiance(const Spectrum& radiance)
+{
+    for (size_t i = 0; i < m_vertex_count; ++i)
+    {
+        Spectrum vertex_radiance(radiance);
+        vertex_radiance *= m_vertices[i].m_rcp_throughput;
+        m_vertices[i].m_radiance += vertex_radiance;
+    }
+}
+
+void PathGuidingContext::commit()
+{
+    for (size_t i = 0; i < m_vertex_count; ++i)
+    {
+        const Vertex& vertex = m_vertices[i];
+
+        m_sd_tree.record(
+            vertex.m_point,
+            vertex.m_direction,
+            average_value(vertex.m_radiance) / vertex.m_pdf);
+    }
+
+    m_vertex_count = 0;
+}
+
+}   // namespace renderer
@@ -0,0 +1,308 @@
+
+//
+// This source file is part of appleseed.
+// Visit https://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2019 The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+// appleseed.renderer headers.
+#include "renderer/global/globaltypes.h"
+
+// appleseed.foundation headers.
+#include "foundation/core/concepts/noncopyable.h"
+#include "foundation/math/aabb.h"
+#include "foundation/math/vector.h"
+
+// Standard headers.
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Forward declarations.
+namespace renderer  { class PathVertex; }
+
+namespace renderer
+{
+
+//
+// Learned distribution of incident radiance used to guide path tracing (SD-tree).
+//
+// The scene is partitioned by a binary spatial tree whose leaves hold two directional
+// quadtrees over the cylindrical parameterization of the sphere of directions: one that
+// is sampled during the current pass and one that records radiance for the next pass.
+// Both trees are refined at the end of each training pass, within a fixed memory budget.
+//
+// Reference:
+//
+//   Practical Path Guiding for Efficient Light-Transport Simulation
+//   Thomas Muller, Markus Gross, Jan Novak
+//   https://tom94.net/data/publications/mueller17practical/mueller17practical.pdf
+//
+
+class DTree
+{
+  public:
+    // Constructor.
+    DTree();
+
+    // Return true if this distribution carries energy and can be sampled.
+    bool is_valid() const;
+
+    // Return the total recorded energy.
+    float get_energy() const;
+
+    // Return the number of nodes of the quadtree.
+    size_t get_node_count() const;
+
+    // Return the size in bytes of the quadtree.
+    size_t get_memory_size() const;
+
+    // Return the size in bytes of a single node of the quadtree.
+    static size_t get_node_memory_size();
+
+    // Sample a direction and return its probability density with respect to solid angle.
+    foundation::Vector3f sample(
+        const foundation::Vector2f&     s,
+        float&                          pdf) const;
+
+    // Evaluate the probability density of a direction with respect to solid angle.
+    float evaluate_pdf(const foundation::Vector3f& direction) const;
+
+    // Record radiance arriving from a given direction. Thread-safe.
+    void record(
+        const foundation::Vector3f&     direction,
+        const float                     radiance);
+
+    // Rebuild this quadtree with the structure of another quadtree, subdivided where
+    // it recorded more than a given fraction of its energy. All sums are cleared.
+    void refine_from(
+        const DTree&                    source,
+        const float                     subdivision_threshold,
+        const size_t                    max_depth,
+        const size_t                    max_node_count);
+
+  private:
+    struct Node
+    {
+        float           m_sums[4];          // energy recorded in each quadrant
+        std::uint32_t   m_children[4];      // index of the child node, 0 for leaves
+    };
+
+    std::vector<Node>   m_nodes;
+};
+
+class SDTree
+  : public foundation::NonCopyable
+{
+  public:
+    // Constructor.
+    SDTree(
+        const foundation::AABB3d&       bbox,
+        const float                     bsdf_sampling_fraction,
+        const size_t                    training_pass_count,
+        const size_t                    max_memory_size);           // in bytes
+
+    // Return the probability of sampling the BSDF rather than the learned distribution.
+    float get_bsdf_sampling_fraction() const;
+
+    // Return true while the current pass contributes to training.
+    bool is_recording() const;
+
+    // Return the directional distribution to sample at a given point,
+    // or nullptr if nothing has been learned there yet.
+    const DTree* get_sampling_dtree(const foundation::Vector3d& point) const;
+
+    // Record radiance arriving at a given point. The radiance is expected to be divided
+    // by the probability density of the direction it arrives from. Thread-safe.
+    void record(
+        const foundation::Vector3d&     point,
+        const foundation::Vector3f&     direction,
+        const float                     radiance);
+
+    // Refine the tree from the radiance recorded during the pass that just ended.
+    // Must not be called while rendering.
+    void update();
+
+    // Return the size in bytes of the tree.
+    size_t get_memory_size() const;
+
+  private:
+    struct SpatialNode
+    {
+        std::uint32_t   m_children[2];      // index of the child nodes, 0 for leaves
+        std::uint32_t   m_axis;
+        std::uint32_t   m_leaf_index;
+    };
+
+    struct SpatialLeaf
+    {
+        DTree           m_sampling_dtree;
+        DTree           m_recording_dtree;
+        std::uint32_t   m_sample_count;
+    };
+
+    const float                 m_bsdf_sampling_fraction;
+    const size_t                m_training_pass_count;
+    const size_t                m_max_memory_size;
+    foundation::AABB3d          m_bbox;
+    foundation::Vector3d        m_rcp_extent;
+    std::vector<SpatialNode>    m_nodes;
+    std::vector<SpatialLeaf>    m_leaves;
+    size_t                      m_pass_count;
+    bool                        m_trained;
+
+    size_t find_leaf(const foundation::Vector3d& point) const;
+
+    size_t refine_spatial_tree();
+};
+
+//
+// Radiance carried by a single path, recorded into an SD-tree once the path is complete.
+//
+
+class PathGuidingContext
+  : public foundation::NonCopyable
+{
+  public:
+    // Constructor.
+    explicit PathGuidingContext(SDTree& sd_tree);
+
+    // Return the SD-tree guiding the path.
+    const SDTree& get_sd_tree() const;
+
+    // Return the directional distribution to sample at a given path vertex,
+    // or nullptr if the scattering event should not be guided.
+    const DTree* get_guiding_dtree(const PathVertex& vertex) const;
+
+    // Add a vertex whose outgoing direction was sampled with a given probability density.
+    // The throughput is the path throughput after scattering at this vertex.
+    void add_vertex(
+        const foundation::Vector3d&     point,
+        const foundation::Vector3f&     direction,
+        const Spectrum&                 throughput,
+        const float                     pdf);
+
+    // Add radiance, weighted by the path throughput, reaching the camera through the path.
+    void add_radiance(const Spectrum& radiance);
+
+    // Record the radiance arriving at each vertex of the path into the SD-tree.
+    void commit();
+
+  private:
+    struct Vertex
+    {
+        Spectrum                m_rcp_throughput;
+        Spectrum                m_radiance;
+        foundation::Vector3d    m_point;
+        foundation::Vector3f    m_direction;
+        float                   m_pdf;
+    };
+
+    enum { MaxVertexCount = 16 };
+
+    SDTree&                     m_sd_tree;
+    const bool                  m_recording;
+    Vertex                      m_vertices[MaxVertexCount];
+    size_t                      m_vertex_count;
+};
+
+
+//
+// DTree class implementation.
+//
+
+inline bool DTree::is_valid() const
+{
+    return get_energy() > 0.0f;
+}
+
+inline float DTree::get_energy() const
+{
+    const Node& root = m_nodes[0];
+    return root.m_sums[0] + root.m_sums[1] + root.m_sums[2] + root.m_sums[3];
+}
+
+inline size_t DTree::get_node_count() const
+{
+    return m_nodes.size();
+}
+
+inline size_t DTree::get_memory_size() const
+{
+    return sizeof(*this) + m_nodes.capacity() * sizeof(Node);
+}
+
+inline size_t DTree::get_node_memory_size()
+{
+    return sizeof(Node);
+}
+
+
+//
+// SDTree class implementation.
+//
+
+inline float SDTree::get_bsdf_sampling_fraction() const
+{
+    return m_bsdf_sampling_fraction;
+}
+
+inline bool SDTree::is_recording() const
+{
+    return m_pass_count < m_training_pass_count;
+}
+
+inline const DTree* SDTree::get_sampling_dtree(const foundation::Vector3d& point) const
+{
+    if (!m_trained)
+        return nullptr;
+
+    const size_t leaf_index = find_leaf(point);
+    if (leaf_index == ~size_t(0))
+        return nullptr;
+
+    const DTree& dtree = m_leaves[leaf_index].m_sampling_dtree;
+    return dtree.is_valid() ? &dtree : nullptr;
+}
+
+
+//
+// PathGuidingContext class implementation.
+//
+
+inline PathGuidingContext::PathGuidingContext(SDTree& sd_tree)
+  : m_sd_tree(sd_tree)
+  , m_recording(sd_tree.is_recording())
+  , m_vertex_count(0)
+{
+}
+
+inline const SDTree& PathGuidingContext::get_sd_tree() const
+{
+    return m_sd_tree;
+}
+
+}   // namespace renderer
@@ -46,7 +46,9 @@ using namespace foundation;
 namespace renderer
 {
 
-SPPMImportonMap::SPPMImportonMap(SPPMImportonVector& importons)
+SPPMImportonMap::SPPMImportonMap(
+    SPPMImportonVector&     importons,
+    const size_t            thread_count)
 {
     const size_t importon_count = importons.size();
 
@@ -57,11 +59,13 @@ SPPMImportonMap::SPPMImportonMap(SPPMImportonVector& importons)
             pretty_uint(importon_count).c_str(),
             importon_count > 1 ? "importons" : "importon");
 
-        knn::Builder3f builder(*this);
-        builder.build_move_points<DefaultWallclockTimer>(importons);
+        knn::ParallelBuilder3f builder(*this, global_logger());
+        builder.build_move_points<DefaultWallclockTimer>(importons, thread_count);
 
         Statistics statistics;
         statistics.insert_time("build time", builder.get_build_time());
+        statistics.insert("build threads", thread_count);
+        statistics.insert("build tasks", builder.get_task_count());
         statistics.merge(knn::TreeStatistics<knn::Tree3f>(*this));
 
         RENDERER_LOG_DEBUG("%s",
@@ -34,6 +34,9 @@
 // appleseed.foundation headers.
 #include "foundation/math/knn.h"
 
+// Standard headers.
+#include <cstddef>
+
 namespace renderer
 {
 
@@ -42,7 +45,9 @@ class SPPMImportonMap
 {
   public:
     // Constructor, *moves* the importons into the map.
-    explicit SPPMImportonMap(SPPMImportonVector& importons);
+    SPPMImportonMap(
+        SPPMImportonVector&     importons,
+        const std::size_t       thread_count);
 };
 
 }   // namespace renderer
@@ -178,6 +178,7 @@ namespace
                 shading_point.get_scene(),
                 m_working_set,
                 m_answer,
+                m_photon_lookup_candidates,
                 radiance);
 
             VolumeVisitor volume_visitor;
@@ -211,6 +212,9 @@ namespace
             stats.insert("path count", m_path_count);
             stats.insert("path length", m_path_length);
 
+            if (m_params.m_photon_map_type == SPPMParameters::HashGrid)
+                stats.insert("photon lookup candidates", m_photon_lookup_candidates);
+
             return StatisticsVector::make("sppm statistics", stats);
         }
 
@@ -223,6 +227,7 @@ namespace
         Population<std::uint64_t>           m_path_length;
         SPPMLightingEngineWorkingSet&       m_working_set;
         knn::Answer<float>                  m_answer;
+        Population<std::uint64_t>           m_photon_lookup_candidates;
 
         // todo: move out of this class.
         struct PathVisitor
@@ -237,6 +242,7 @@ namespace
             const EnvironmentEDF*               m_env_edf;
             SPPMLightingEngineWorkingSet&       m_working_set;
             knn::Answer<float>&                 m_answer;
+            Population<std::uint64_t>&          m_photon_lookup_candidates;
             ShadingComponents&                  m_path_radiance;
 
             PathVisitor(
@@ -250,6 +256,7 @@ namespace
                 const Scene&                    scene,
                 SPPMLightingEngineWorkingSet&   working_set,
                 knn::Answer<float>&             answer,
+                Population<std::uint64_t>&      photon_lookup_candidates,
                 ShadingComponents&              path_radiance)
               : m_params(params)
               , m_pass_callback(pass_callback)
@@ -261,6 +268,7 @@ namespace
               , m_env_edf(scene.get_environment()->get_environment_edf())
               , m_working_set(working_set)
               , m_answer(answer)
+              , m_photon_lookup_candidates(photon_lookup_candidates)
               , m_path_radiance(path_radiance)
             {
             }
@@ -470,10 +478,13 @@ namespace
                 const float radius = m_pass_callback.get_photon_lookup_radius();
 
                 // Find the nearby photons around the path vertex.
-                const knn::Query3f query(photon_map, m_answer);
-                query.run(point, radius * radius);
+                const std::size_t candidate_count =
+                    photon_map.find_nearest_photons(point, radius * radius, m_answer);
                 const std::size_t photon_count = m_answer.size();
 
+                if (photon_map.get_type() == SPPMParameters::HashGrid)
+                    m_photon_lookup_candidates.insert(candidate_count);
+
                 // Compute the square radius of the lookup disk.
                 float max_square_dist;
                 if (photon_count < m_params.m_max_photons_per_estimate)
@@ -692,11 +703,11 @@ namespace
             Spectrum&               radiance)
         {
             const SPPMPhotonMap& photon_map = m_pass_callback.get_photon_map();
-            const knn::Query3f query(photon_map, m_answer);
 
-            query.run(
+            photon_map.find_nearest_photons(
                 Vector3f(shading_point.get_point()),
-                square(m_params.m_view_photons_radius));
+                square(m_params.m_view_photons_radius),
+                m_answer);
 
             radiance.set(0.0f);
 
@@ -775,6 +786,28 @@ Dictionary SPPMLightingEngineFactory::get_params_metadata()
                             .insert("label", "Poly")
                             .insert("help", "Polychromatic photons"))));
 
+    metadata.dictionaries().insert(
+        "photon_map_type",
+        Dictionary()
+            .insert("type", "enum")
+            .insert("values", "kdtree|hashgrid")
+            .insert("default", "kdtree")
+            .insert("label", "Photon Map Type")
+            .insert("help", "Spatial data structure used to find the photons around a path vertex")
+            .insert(
+                "options",
+                Dictionary()
+                    .insert(
+                        "kdtree",
+                        Dictionary()
+                            .insert("label", "K-d Tree")
+                            .insert("help", "Store photons in a k-d tree"))
+                    .insert(
+                        "hashgrid",
+                        Dictionary()
+                            .insert("label", "Hash Grid")
+                            .insert("help", "Store photons in a hashed uniform grid whose cells match the lookup radius"))));
+
     metadata.dictionaries().insert(
         "dl_type",
         Dictionary()
@@ -76,6 +76,23 @@ namespace
                 : SPPMParameters::Polychromatic;
     }
 
+    SPPMParameters::PhotonMapType get_photon_map_type(
+        const ParamArray&   params,
+        const char*         name,
+        const char*         default_value)
+    {
+        const std::string value =
+            params.get_optional<std::string>(
+                name,
+                default_value,
+                make_vector("kdtree", "hashgrid"));
+
+        return
+            value == "kdtree"
+                ? SPPMParameters::KdTree
+                : SPPMParameters::HashGrid;
+    }
+
     SPPMParameters::Mode get_mode(
         const ParamArray&   params,
         const char*         name,
@@ -98,7 +115,9 @@ SPPMParameters::SPPMParameters(const ParamArray& params)
   : m_spectrum_mode(get_spectrum_mode(params))
   , m_sampling_mode(get_sampling_context_mode(params))
   , m_pass_count(params.get_optional<size_t>("passes", 1))
+  , m_thread_count(get_rendering_thread_count(params))
   , m_photon_type(get_photon_type(params, "photon_type", "poly"))
+  , m_photon_map_type(get_photon_map_type(params, "photon_map_type", "kdtree"))
   , m_dl_mode(get_mode(params, "dl_mode", "rt"))
   , m_enable_ibl(params.get_optional<bool>("enable_ibl", true))
   , m_enable_caustics(params.get_optional<bool>("enable_caustics", true))
@@ -135,10 +154,12 @@ void SPPMParameters::print() const
     RENDERER_LOG_INFO(
         "sppm settings:\n"
         "  photon type                   %s\n"
+        "  photon map type               %s\n"
         "  dl                            %s\n"
         "  ibl                           %s\n"
         "  importons                     %s",
         m_photon_type == Monochromatic ? "monochromatic" : "polychromatic",
+        m_photon_map_type == KdTree ? "k-d tree" : "hash grid",
         m_dl_mode == RayTraced ? "ray traced" :
         m_dl_mode == SPPM ? "sppm" : "off",
         m_enable_ibl ? "on" : "off",
@@ -44,13 +44,16 @@ namespace renderer
 struct SPPMParameters
 {
     enum PhotonType { Monochromatic, Polychromatic };
+    enum PhotonMapType { KdTree, HashGrid };
     enum Mode { RayTraced, SPPM, Off };
 
     const Spectrum::Mode        m_spectrum_mode;
     const SamplingContext::Mode m_sampling_mode;
     const std::size_t           m_pass_count;
+    const std::size_t           m_thread_count;                             // number of threads used to build photon and importon maps
 
     const PhotonType            m_photon_type;
+    const PhotonMapType         m_photon_map_type;                          // spatial data structure used for photon lookups
 
     const Mode                  m_dl_mode;                                  // direct lighting mode
     const bool                  m_enable_ibl;                               // is image-based lighting enabled?
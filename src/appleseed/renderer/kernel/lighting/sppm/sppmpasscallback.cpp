@@ -157,7 +157,12 @@ void SPPMPassCallback::on_pass_begin(
             return;
 
         // Build a new photon map.
-        m_photon_map.reset(new SPPMPhotonMap(m_photons));
+        m_photon_map.reset(
+            new SPPMPhotonMap(
+                m_photons,
+                m_params.m_photon_map_type,
+                m_photon_lookup_radius,
+                m_params.m_thread_count));
 
         if (m_initial_photon_lookup_radius > 0.0f)
         {
@@ -213,7 +218,7 @@ void SPPMPassCallback::on_pass_end(
                 pretty_size(importons.capacity() * sizeof(SPPMImportonVector::value_type)).c_str());
 
             // Build a new importon map.
-            m_importon_map.reset(new SPPMImportonMap(importons));
+            m_importon_map.reset(new SPPMImportonMap(importons, m_params.m_thread_count));
         }
     }
 
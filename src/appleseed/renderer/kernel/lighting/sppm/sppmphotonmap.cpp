@@ -38,6 +38,7 @@
 #include "foundation/platform/defaulttimers.h"
 #include "foundation/string/string.h"
 #include "foundation/utility/statistics.h"
+#include "foundation/utility/stopwatch.h"
 
 // Standard headers.
 #include <cstddef>
@@ -48,7 +49,12 @@ using namespace foundation;
 namespace renderer
 {
 
-SPPMPhotonMap::SPPMPhotonMap(SPPMPhotonVector& photons)
+SPPMPhotonMap::SPPMPhotonMap(
+    SPPMPhotonVector&                   photons,
+    const SPPMParameters::PhotonMapType type,
+    const float                         lookup_radius,
+    const size_t                        thread_count)
+  : m_type(type)
 {
     const size_t photon_count = photons.size();
 
@@ -59,13 +65,31 @@ SPPMPhotonMap::SPPMPhotonMap(SPPMPhotonVector& photons)
             pretty_uint(photon_count).c_str(),
             photon_count > 1 ? "photons" : "photon");
 
-        knn::Builder3f builder(*this);
-        builder.build_move_points<DefaultWallclockTimer>(photons.m_positions);
-
         Statistics statistics;
-        statistics.insert_time("build time", builder.get_build_time());
-        statistics.insert_size("size", photons.get_memory_size());  // size without the photon positions since they were moved out
-        statistics.merge(knn::TreeStatistics<knn::Tree3f>(*this));
+
+        if (m_type == SPPMParameters::KdTree)
+        {
+            knn::ParallelBuilder3f builder(m_tree, global_logger());
+            builder.build_move_points<DefaultWallclockTimer>(photons.m_positions, thread_count);
+
+            statistics.insert_time("build time", builder.get_build_time());
+            statistics.insert("build threads", thread_count);
+            statistics.insert("build tasks", builder.get_task_count());
+            statistics.insert_size("size", photons.get_memory_size());  // size without the photon positions since they were moved out
+            statistics.merge(knn::TreeStatistics<knn::Tree3f>(m_tree));
+        }
+        else
+        {
+            Stopwatch<DefaultWallclockTimer> stopwatch;
+            stopwatch.start();
+
+            m_grid.build_move_points(photons.m_positions, lookup_radius);
+
+            statistics.insert_time("build time", stopwatch.measure().get_seconds());
+            statistics.insert_size("size", photons.get_memory_size() + m_grid.get_memory_size());
+            statistics.insert("cell size", m_grid.get_cell_size());
+            statistics.insert("buckets", m_grid.get_bucket_count());
+        }
 
         RENDERER_LOG_DEBUG("%s",
             StatisticsVector::make(
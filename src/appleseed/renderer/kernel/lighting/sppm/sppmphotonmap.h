@@ -29,8 +29,16 @@
 
 #pragma once
 
+// appleseed.renderer headers.
+#include "renderer/kernel/lighting/sppm/sppmparameters.h"
+
 // appleseed.foundation headers.
+#include "foundation/core/concepts/noncopyable.h"
 #include "foundation/math/knn.h"
+#include "foundation/math/vector.h"
+
+// Standard headers.
+#include <cstddef>
 
 // Forward declarations.
 namespace renderer  { class SPPMPhotonVector; }
@@ -39,11 +47,84 @@ namespace renderer
 {
 
 class SPPMPhotonMap
-  : public foundation::knn::Tree3f
+  : public foundation::NonCopyable
 {
   public:
     // Constructor, *moves* the photon positions into the map.
-    explicit SPPMPhotonMap(SPPMPhotonVector& photons);
+    // The cells of the hash grid backend are sized to the given lookup radius.
+    // The k-d tree backend is built with the given number of threads.
+    SPPMPhotonMap(
+        SPPMPhotonVector&                   photons,
+        const SPPMParameters::PhotonMapType type,
+        const float                         lookup_radius,
+        const std::size_t                   thread_count);
+
+    // Return the spatial data structure used by this photon map.
+    SPPMParameters::PhotonMapType get_type() const;
+
+    // Return true if the map does not contain any photon.
+    bool empty() const;
+
+    // Transform an internal index to a photon index.
+    std::size_t remap(const std::size_t i) const;
+
+    // Return the position of the i'th photon, where i is an internal index.
+    const foundation::Vector3f& get_point(const std::size_t i) const;
+
+    // Find the photons closest to a given point, strictly within a given square distance.
+    // Return the number of photons tested with the hash grid backend, 0 otherwise.
+    std::size_t find_nearest_photons(
+        const foundation::Vector3f&         point,
+        const float                         max_square_distance,
+        foundation::knn::Answer<float>&     answer) const;
+
+  private:
+    const SPPMParameters::PhotonMapType     m_type;
+    foundation::knn::Tree3f                 m_tree;
+    foundation::knn::HashGrid3f             m_grid;
 };
 
+
+//
+// SPPMPhotonMap class implementation.
+//
+
+inline SPPMParameters::PhotonMapType SPPMPhotonMap::get_type() const
+{
+    return m_type;
+}
+
+inline bool SPPMPhotonMap::empty() const
+{
+    return m_type == SPPMParameters::KdTree ? m_tree.empty() : m_grid.empty();
+}
+
+inline std::size_t SPPMPhotonMap::remap(const std::size_t i) const
+{
+    return m_type == SPPMParameters::KdTree ? m_tree.remap(i) : m_grid.remap(i);
+}
+
+inline const foundation::Vector3f& SPPMPhotonMap::get_point(const std::size_t i) const
+{
+    return m_type == SPPMParameters::KdTree ? m_tree.get_point(i) : m_grid.get_point(i);
+}
+
+inline std::size_t SPPMPhotonMap::find_nearest_photons(
+    const foundation::Vector3f&             point,
+    const float                             max_square_distance,
+    foundation::knn::Answer<float>&         answer) const
+{
+    if (m_type == SPPMParameters::KdTree)
+    {
+        const foundation::knn::Query3f query(m_tree, answer);
+        query.run(point, max_square_distance);
+        return 0;
+    }
+    else
+    {
+        const foundation::knn::HashGridQuery3f query(m_grid, answer);
+        return query.run(point, max_square_distance);
+    }
+}
+
 }   // namespace renderer
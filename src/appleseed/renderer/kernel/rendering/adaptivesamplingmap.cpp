@@ -0,0 +1,289 @@
+
+//
+// This source file is part of appleseed.
+// Visit https://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2019 The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+// Interface header.
+#include "adaptivesamplingmap.h"
+
+// appleseed.foundation headers.
+#include "foundation/image/color.h"
+#include "foundation/math/fastmath.h"
+#include "foundation/math/scalar.h"
+
+// Standard headers.
+#include <algorithm>
+#include <cmath>
+
+using namespace foundation;
+
+namespace renderer
+{
+
+//
+// Estimation of the noise level of a pixel or a block of pixels.
+//
+
+float compute_weighted_pixel_variance(
+    const float*            main,
+    const float*            second)
+{
+    // Get weights.
+    const float main_weight = *main++;
+    const float rcp_main_weight = main_weight == 0.0f ? 0.0f : 1.0f / main_weight;
+    const float second_weight = *second++;
+    const float rcp_second_weight = second_weight == 0.0f ? 0.0f : 1.0f / second_weight;
+
+    // Get colors and assign weights.
+    Color4f main_color(main[0], main[1], main[2], main[3]);
+    main_color *= rcp_main_weight;
+
+    Color4f second_color(second[0], second[1], second[2], second[3]);
+    second_color *= rcp_second_weight;
+
+    const float rgb = std::abs(main_color.r) + std::abs(main_color.g) + std::abs(main_color.b);
+
+    if (rgb == 0.0f)
+        return 0.0f;
+
+    // Compute variance.
+    return
+        fast_rcp_sqrt(rgb) * (
+            std::abs(main_color.r - second_color.r) +
+            std::abs(main_color.g - second_color.g) +
+            std::abs(main_color.b - second_color.b));
+}
+
+float compute_tile_variance(
+    const AABB2u&           bb,
+    const AccumulatorTile*  main,
+    const AccumulatorTile*  second)
+{
+    float error = 0.0f;
+
+    assert(main->get_crop_window() == second->get_crop_window());
+    assert(main->get_crop_window().contains(bb.min));
+    assert(main->get_crop_window().contains(bb.max));
+
+    // Loop over block pixels.
+    for (size_t y = bb.min.y; y <= bb.max.y; ++y)
+    {
+        for (size_t x = bb.min.x; x <= bb.max.x; ++x)
+        {
+            const float* main_ptr = main->pixel(x, y);
+            const float* second_ptr = second->pixel(x, y);
+
+            error = std::max(error, compute_weighted_pixel_variance(main_ptr, second_ptr));
+        }
+    }
+
+    return error;
+}
+
+
+//
+// AdaptiveSamplingMap class implementation.
+//
+
+const float AdaptiveSamplingMap::MinSamplingProbability = 0.05f;
+
+AdaptiveSamplingMap::AdaptiveSamplingMap(
+    const AABB2u&           crop_window,
+    const size_t            block_size,
+    const float             noise_threshold,
+    const size_t            min_samples)
+  : m_crop_window(crop_window)
+  , m_block_size(block_size)
+  , m_noise_threshold(noise_threshold)
+  , m_min_samples(min_samples)
+  , m_block_count_x((crop_window.extent(0) + block_size - 1) / block_size)
+  , m_block_count_y((crop_window.extent(1) + block_size - 1) / block_size)
+  , m_block_errors(m_block_count_x * m_block_count_y)
+  , m_block_spp(m_block_count_x * m_block_count_y)
+  , m_probabilities(new boost::atomic<float>[m_block_count_x * m_block_count_y])
+  , m_block_cdf(new boost::atomic<float>[m_block_count_x * m_block_count_y])
+{
+    assert(block_size > 0);
+
+    clear();
+}
+
+void AdaptiveSamplingMap::clear()
+{
+    const size_t block_count = get_block_count();
+
+    for (size_t i = 0; i < block_count; ++i)
+    {
+        m_block_errors[i] = 0.0f;
+        m_block_spp[i] = 0.0f;
+        m_probabilities[i].store(1.0f, boost::memory_order_relaxed);
+    }
+
+    update_block_cdf();
+
+    m_converged_block_count = 0;
+    m_max_block_error = 0.0f;
+    m_converged.store(false);
+}
+
+void AdaptiveSamplingMap::update(
+    const AccumulatorTile&  main,
+    const AccumulatorTile&  second)
+{
+    assert(main.get_width() == second.get_width());
+    assert(main.get_height() == second.get_height());
+    assert(main.get_crop_window().contains(m_crop_window.min));
+    assert(main.get_crop_window().contains(m_crop_window.max));
+
+    float max_unconverged_error = 0.0f;
+
+    m_converged_block_count = 0;
+    m_max_block_error = 0.0f;
+
+    // Estimate the noise level and the sample density of each block.
+    for (size_t by = 0; by < m_block_count_y; ++by)
+    {
+        for (size_t bx = 0; bx < m_block_count_x; ++bx)
+        {
+            const size_t block_index = by * m_block_count_x + bx;
+            const AABB2u block = get_block(block_index);
+
+            float error = 0.0f;
+            float weight = 0.0f;
+
+            for (size_t y = block.min.y; y <= block.max.y; ++y)
+            {
+                for (size_t x = block.min.x; x <= block.max.x; ++x)
+                {
+                    const float* main_ptr = main.pixel(x, y);
+                    const float* second_ptr = second.pixel(x, y);
+
+                    error = std::max(error, compute_weighted_pixel_variance(main_ptr, second_ptr));
+                    weight += main_ptr[0];
+                }
+            }
+
+            const float spp = weight / block.volume();
+
+            m_block_errors[block_index] = error;
+            m_block_spp[block_index] = spp;
+            m_max_block_error = std::max(m_max_block_error, error);
+
+            // A block is only considered converged once it received enough samples
+            // for its noise estimate to be reliable.
+            if (spp > 0.0f && spp >= m_min_samples && error <= m_noise_threshold)
+                ++m_converged_block_count;
+            else max_unconverged_error = std::max(max_unconverged_error, error);
+        }
+    }
+
+    // Redistribute samples toward the noisiest blocks.
+    const float rcp_max_unconverged_error =
+        max_unconverged_error > 0.0f ? 1.0f / max_unconverged_error : 0.0f;
+
+    for (size_t i = 0, e = get_block_count(); i < e; ++i)
+    {
+        const float error = m_block_errors[i];
+        const float spp = m_block_spp[i];
+
+        float probability;
+
+        if (spp == 0.0f || spp < m_min_samples)
+            probability = 1.0f;
+        else if (error <= m_noise_threshold)
+            probability = 0.0f;
+        else probability = clamp(error * rcp_max_unconverged_error, MinSamplingProbability, 1.0f);
+
+        m_probabilities[i].store(probability, boost::memory_order_relaxed);
+    }
+
+    update_block_cdf();
+
+    m_converged.store(m_converged_block_count == get_block_count());
+}
+
+size_t AdaptiveSamplingMap::sample_block(const float s) const
+{
+    assert(s >= 0.0f && s < 1.0f);
+
+    // Find the first block whose cumulative probability exceeds s. The distribution may
+    // be updated concurrently: the search always ends on a valid block regardless.
+    size_t begin = 0;
+    size_t end = get_block_count() - 1;
+
+    while (begin < end)
+    {
+        const size_t middle = (begin + end) / 2;
+
+        if (m_block_cdf[middle].load(boost::memory_order_relaxed) > s)
+            end = middle;
+        else begin = middle + 1;
+    }
+
+    return begin;
+}
+
+void AdaptiveSamplingMap::update_block_cdf()
+{
+    const size_t block_count = get_block_count();
+
+    // Weight blocks by their pixel count so that the density of samples within a block
+    // is proportional to its sampling probability.
+    float total = 0.0f;
+    for (size_t i = 0; i < block_count; ++i)
+    {
+        total +=
+            m_probabilities[i].load(boost::memory_order_relaxed) *
+            static_cast<float>(get_block(i).volume());
+    }
+
+    // Leave the distribution untouched once every block has converged: there is nothing left to sample.
+    if (total == 0.0f)
+        return;
+
+    const float rcp_total = 1.0f / total;
+    float cdf = 0.0f;
+    size_t last_sampled_block = 0;
+
+    for (size_t i = 0; i < block_count; ++i)
+    {
+        const float weight =
+            m_probabilities[i].load(boost::memory_order_relaxed) *
+            static_cast<float>(get_block(i).volume());
+
+        if (weight > 0.0f)
+            last_sampled_block = i;
+
+        cdf += weight;
+        m_block_cdf[i].store(cdf * rcp_total, boost::memory_order_relaxed);
+    }
+
+    // Make sure that rounding errors can't select a block past the last one with a nonzero probability.
+    for (size_t i = last_sampled_block; i < block_count; ++i)
+        m_block_cdf[i].store(1.0f, boost::memory_order_relaxed);
+}
+
+}   // namespace renderer
@@ -0,0 +1,203 @@
+
+//
+// This source file is part of appleseed.
+// Visit https://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2019 The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+// appleseed.foundation headers.
+#include "foundation/core/concepts/noncopyable.h"
+#include "foundation/image/accumulatortile.h"
+#include "foundation/math/aabb.h"
+#include "foundation/math/vector.h"
+#include "foundation/platform/atomic.h"
+
+// Standard headers.
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace renderer
+{
+
+//
+// Estimation of the noise level of a pixel or a block of pixels.
+//
+
+// Compute the variance of a weighted pixel given the value of the same pixel with 2 different samples count.
+// The first given pixel `main` contains N samples.
+// The second given pixel `second` contains N/2 samples (samples included in `second` are also in `main`).
+float compute_weighted_pixel_variance(
+    const float*                        main,
+    const float*                        second);
+
+// Compute the variance of the tile `main` for pixels in the bounding box `bb`.
+// A second tile `second` is used which contains half of the samples of `main`.
+float compute_tile_variance(
+    const foundation::AABB2u&           bb,
+    const foundation::AccumulatorTile*  main,
+    const foundation::AccumulatorTile*  second);
+
+
+//
+// A frame-wide map of sampling probabilities driving adaptive sampling in progressive mode.
+//
+// The crop window is divided into square blocks of pixels. Each time the map is updated,
+// the noise level of every block is estimated and blocks whose noise level is below the
+// noise threshold are considered converged: they won't receive any more samples. Other
+// blocks are sampled with a probability proportional to their noise level, relative to
+// the noisiest block of the frame.
+//
+// Sample generators draw blocks from a cumulative distribution over the blocks, where
+// each block is weighted by its sampling probability and its pixel count, so that no
+// sample is spent on converged blocks.
+//
+
+class AdaptiveSamplingMap
+  : public foundation::NonCopyable
+{
+  public:
+    // Constructor.
+    AdaptiveSamplingMap(
+        const foundation::AABB2u&           crop_window,
+        const size_t                        block_size,
+        const float                         noise_threshold,
+        const size_t                        min_samples);
+
+    // Reset the map to its initial state: all blocks are sampled uniformly.
+    void clear();
+
+    // Update the map given a framebuffer containing all samples and a framebuffer
+    // containing half of them. Must not be called concurrently with itself.
+    void update(
+        const foundation::AccumulatorTile&  main,
+        const foundation::AccumulatorTile&  second);
+
+    // Return the sampling density of a given pixel relative to the noisiest block. Thread-safe.
+    float get_sampling_probability(
+        const size_t                        x,
+        const size_t                        y) const;
+
+    // Choose a block given a uniform random number in [0, 1) and return its index. Thread-safe.
+    size_t sample_block(const float s) const;
+
+    // Return the pixels of a given block.
+    foundation::AABB2u get_block(const size_t block_index) const;
+
+    // Return true if all blocks have converged. Thread-safe.
+    bool is_converged() const;
+
+    // Return the number of blocks.
+    size_t get_block_count() const;
+
+    // Return the number of converged blocks, as of the last update.
+    size_t get_converged_block_count() const;
+
+    // Return the highest noise level of all blocks, as of the last update.
+    float get_max_block_error() const;
+
+  private:
+    // Minimum sampling probability of a block that hasn't converged yet.
+    static const float MinSamplingProbability;
+
+    const foundation::AABB2u                m_crop_window;
+    const size_t                            m_block_size;
+    const float                             m_noise_threshold;
+    const size_t                            m_min_samples;
+    const size_t                            m_block_count_x;
+    const size_t                            m_block_count_y;
+
+    std::vector<float>                      m_block_errors;
+    std::vector<float>                      m_block_spp;
+    std::unique_ptr<boost::atomic<float>[]> m_probabilities;
+    std::unique_ptr<boost::atomic<float>[]> m_block_cdf;
+    size_t                                  m_converged_block_count;
+    float                                   m_max_block_error;
+    boost::atomic<bool>                     m_converged;
+
+    // Rebuild the distribution sample_block() draws blocks from.
+    void update_block_cdf();
+};
+
+
+//
+// AdaptiveSamplingMap class implementation.
+//
+
+inline float AdaptiveSamplingMap::get_sampling_probability(
+    const size_t                            x,
+    const size_t                            y) const
+{
+    assert(m_crop_window.contains(foundation::Vector2u(x, y)));
+
+    const size_t bx = (x - m_crop_window.min.x) / m_block_size;
+    const size_t by = (y - m_crop_window.min.y) / m_block_size;
+
+    return m_probabilities[by * m_block_count_x + bx].load(boost::memory_order_relaxed);
+}
+
+inline foundation::AABB2u AdaptiveSamplingMap::get_block(const size_t block_index) const
+{
+    assert(block_index < get_block_count());
+
+    const size_t bx = block_index % m_block_count_x;
+    const size_t by = block_index / m_block_count_x;
+
+    const foundation::Vector2u block_min(
+        m_crop_window.min.x + bx * m_block_size,
+        m_crop_window.min.y + by * m_block_size);
+
+    return
+        foundation::AABB2u(
+            block_min,
+            foundation::Vector2u(
+                std::min(block_min.x + m_block_size - 1, m_crop_window.max.x),
+                std::min(block_min.y + m_block_size - 1, m_crop_window.max.y)));
+}
+
+inline bool AdaptiveSamplingMap::is_converged() const
+{
+    return m_converged.load(boost::memory_order_relaxed);
+}
+
+inline size_t AdaptiveSamplingMap::get_block_count() const
+{
+    return m_block_count_x * m_block_count_y;
+}
+
+inline size_t AdaptiveSamplingMap::get_converged_block_count() const
+{
+    return m_converged_block_count;
+}
+
+inline float AdaptiveSamplingMap::get_max_block_error() const
+{
+    return m_max_block_error;
+}
+
+}   // namespace renderer
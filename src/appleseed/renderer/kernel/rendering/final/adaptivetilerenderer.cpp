@@ -35,6 +35,7 @@
 #include "renderer/kernel/aov/aovaccumulator.h"
 #include "renderer/kernel/aov/imagestack.h"
 #include "renderer/kernel/aov/tilestack.h"
+#include "renderer/kernel/rendering/adaptivesamplingmap.h"
 #include "renderer/kernel/rendering/ipixelrenderer.h"
 #include "renderer/kernel/rendering/isamplerenderer.h"
 #include "renderer/kernel/rendering/ishadingresultframebufferfactory.h"
@@ -54,7 +55,6 @@
 #include "foundation/image/image.h"
 #include "foundation/image/tile.h"
 #include "foundation/math/aabb.h"
-#include "foundation/math/fastmath.h"
 #include "foundation/math/filtersamplingtable.h"
 #include "foundation/math/ordering.h"
 #include "foundation/math/population.h"
@@ -146,72 +146,6 @@ namespace
     };
 
 
-    //
-    // Calculation of noise level inside a block or a pixel.
-    //
-
-    // Compute the variance of a weighted pixel given the value of the same pixel with 2 different samples count.
-    // The first given pixel `main` contains N samples.
-    // The second given pixel `second` contains N/2 samples (samples included in `second` are also in `main`).
-    float compute_weighted_pixel_variance(
-        const float*            main,
-        const float*            second)
-    {
-        // Get weights.
-        const float main_weight = *main++;
-        const float rcp_main_weight = main_weight == 0.0f ? 0.0f : 1.0f / main_weight;
-        const float second_weight = *second++;
-        const float rcp_second_weight = second_weight == 0.0f ? 0.0f : 1.0f / second_weight;
-
-        // Get colors and assign weights.
-        Color4f main_color(main[0], main[1], main[2], main[3]);
-        main_color *= rcp_main_weight;
-
-        Color4f second_color(second[0], second[1], second[2], second[3]);
-        second_color *= rcp_second_weight;
-
-        const float rgb = std::abs(main_color.r) + std::abs(main_color.g) + std::abs(main_color.b);
-
-        if (rgb == 0.0f)
-            return 0.0f;
-
-        // Compute variance.
-        return
-            fast_rcp_sqrt(rgb) * (
-                std::abs(main_color.r - second_color.r) +
-                std::abs(main_color.g - second_color.g) +
-                std::abs(main_color.b - second_color.b));
-    }
-
-    // Compute the variance of the tile `main` for pixels in the bounding box `bb`.
-    // A second tile `second` is used which contains half of the samples of `main`.
-    float compute_tile_variance(
-        const AABB2u&           bb,
-        const AccumulatorTile*  main,
-        const AccumulatorTile*  second)
-    {
-        float error = 0.0f;
-
-        assert(main->get_crop_window() == second->get_crop_window());
-        assert(main->get_crop_window().contains(bb.min));
-        assert(main->get_crop_window().contains(bb.max));
-
-        // Loop over block pixels.
-        for (size_t y = bb.min.y; y <= bb.max.y; ++y)
-        {
-            for (size_t x = bb.min.x; x <= bb.max.x; ++x)
-            {
-                const float* main_ptr = main->pixel(x, y);
-                const float* second_ptr = second->pixel(x, y);
-
-                error = std::max(error, compute_weighted_pixel_variance(main_ptr, second_ptr));
-            }
-        }
-
-        return error;
-    }
-
-
     //
     // Adaptive tile renderer.
     //
@@ -33,6 +33,7 @@
 // appleseed.renderer headers.
 #include "renderer/global/globaltypes.h"
 #include "renderer/kernel/aov/aovaccumulator.h"
+#include "renderer/kernel/rendering/adaptivesamplingmap.h"
 #include "renderer/kernel/rendering/isamplerenderer.h"
 #include "renderer/kernel/rendering/localsampleaccumulationbuffer.h"
 #include "renderer/kernel/rendering/pixelcontext.h"
@@ -45,15 +46,18 @@
 // appleseed.foundation headers.
 #include "foundation/image/canvasproperties.h"
 #include "foundation/image/image.h"
+#include "foundation/math/aabb.h"
 #include "foundation/math/filtersamplingtable.h"
 #include "foundation/math/population.h"
 #include "foundation/math/qmc.h"
+#include "foundation/math/rng/distribution.h"
 #include "foundation/math/scalar.h"
 #include "foundation/math/vector.h"
 #include "foundation/memory/autoreleaseptr.h"
 #include "foundation/utility/statistics.h"
 
 // Standard headers.
+#include <algorithm>
 #include <cassert>
 #include <cstdint>
 #include <vector>
@@ -156,14 +160,32 @@ namespace
             const size_t Bases[2] = { 2, 3 };
             const Vector2d s = halton_sequence<double, 2>(Bases, sequence_index);
 
-            // Compute the coordinates of the pixel in the padded crop window.
-            const Vector2d t(s[0] * m_window_width_next_pow2, s[1] * m_window_height_next_pow3);
-            const int x = truncate<int>(t[0]);
-            const int y = truncate<int>(t[1]);
+            int x, y;
 
-            // Reject samples that fall outside the actual frame.
-            if (x >= m_window_width || y >= m_window_height)
-                return 0;
+            if (m_sampling_map != nullptr && !m_sampling_map->is_converged())
+            {
+                // Choose a block of pixels according to the adaptive sampling map,
+                // then place the sample inside this block.
+                const size_t block_index = m_sampling_map->sample_block(rand_float2(m_rng));
+                const AABB2u block = m_sampling_map->get_block(block_index);
+                const Vector2u block_size = block.extent();
+                const Vector2u p(
+                    block.min.x + std::min(truncate<size_t>(s[0] * block_size.x), block_size.x - 1),
+                    block.min.y + std::min(truncate<size_t>(s[1] * block_size.y), block_size.y - 1));
+                x = static_cast<int>(p.x) - m_window_origin_x;
+                y = static_cast<int>(p.y) - m_window_origin_y;
+            }
+            else
+            {
+                // Compute the coordinates of the pixel in the padded crop window.
+                const Vector2d t(s[0] * m_window_width_next_pow2, s[1] * m_window_height_next_pow3);
+                x = truncate<int>(t[0]);
+                y = truncate<int>(t[1]);
+
+                // Reject samples that fall outside the actual frame.
+                if (x >= m_window_width || y >= m_window_height)
+                    return 0;
+            }
 
             // Create a sampling context. We start with an initial dimension of 2,
             // corresponding to the Halton sequence used for the sample positions.
@@ -31,7 +31,6 @@
 #include "globalsampleaccumulationbuffer.h"
 
 // appleseed.renderer headers.
-#include "renderer/kernel/rendering/sample.h"
 #include "renderer/modeling/frame/frame.h"
 
 // appleseed.foundation headers.
@@ -40,10 +39,13 @@
 #include "foundation/image/image.h"
 #include "foundation/image/pixel.h"
 #include "foundation/image/tile.h"
+#include "foundation/math/vector.h"
+#include "foundation/memory/memory.h"
 #include "foundation/utility/job/iabortswitch.h"
 
-// Boost headers.
-#include "boost/chrono/duration.hpp"
+// Standard headers.
+#include <algorithm>
+#include <cassert>
 
 using namespace foundation;
 
@@ -54,17 +56,30 @@ GlobalSampleAccumulationBuffer::GlobalSampleAccumulationBuffer(
     const size_t    width,
     const size_t    height)
   : m_fb(width, height, 3)
+  , m_stripe_count((height + StripeHeight - 1) / StripeHeight)
+  , m_stripes(new Stripe[m_stripe_count])
 {
 }
 
 void GlobalSampleAccumulationBuffer::clear()
 {
-    // Request exclusive access.
-    boost::unique_lock<boost::shared_mutex> lock(m_mutex);
+    // Request exclusive access to all stripes.
+    for (size_t i = 0; i < m_stripe_count; ++i)
+        m_stripes[i].m_merge_mutex.lock();
+
+    for (size_t i = 0; i < m_stripe_count; ++i)
+    {
+        Stripe& stripe = m_stripes[i];
+        Spinlock::ScopedLock lock(stripe.m_queue_lock);
+        clear_keep_memory(stripe.m_queue);
+    }
 
     m_sample_count = 0;
 
     m_fb.clear();
+
+    for (size_t i = 0; i < m_stripe_count; ++i)
+        m_stripes[i].m_merge_mutex.unlock();
 }
 
 void GlobalSampleAccumulationBuffer::store_samples(
@@ -72,25 +87,71 @@ void GlobalSampleAccumulationBuffer::store_samples(
     const Sample    samples[],
     IAbortSwitch&   abort_switch)
 {
-    // Request non-exclusive access.
-    boost::shared_lock<boost::shared_mutex> lock(m_mutex, boost::defer_lock);
-    while (true)
+    if (abort_switch.is_aborted())
+        return;
+
+    const size_t height = m_fb.get_height();
+    const Sample* sample_end = samples + sample_count;
+
+    ScratchBuffers* scratch_buffers = m_scratch_buffers.get();
+    if (scratch_buffers == nullptr)
     {
-        if (abort_switch.is_aborted())
-            return;
-        if (lock.try_lock_for(boost::chrono::milliseconds(5)))
-            break;
+        scratch_buffers = new ScratchBuffers();
+        m_scratch_buffers.reset(scratch_buffers);
     }
 
-    size_t counter = 0;
+    // Count the samples falling into each stripe. Samples outside the buffer are ignored.
+    std::vector<size_t>& offsets = scratch_buffers->m_offsets;
+    offsets.assign(m_stripe_count + 1, 0);
+    for (const Sample* s = samples; s < sample_end; ++s)
+    {
+        const size_t y = static_cast<size_t>(s->m_pixel_coords.y);
+        if (y < height)
+            ++offsets[y / StripeHeight + 1];
+    }
 
-    const Sample* sample_end = samples + sample_count;
+    for (size_t i = 0; i < m_stripe_count; ++i)
+        offsets[i + 1] += offsets[i];
+
+    // Sort the samples by stripe.
+    std::vector<Sample>& sorted_samples = scratch_buffers->m_sorted_samples;
+    clear_keep_memory(sorted_samples);
+    sorted_samples.resize(offsets[m_stripe_count]);
     for (const Sample* s = samples; s < sample_end; ++s)
     {
-        if ((counter++ & 4096) == 0 && abort_switch.is_aborted())
-            return;
+        const size_t y = static_cast<size_t>(s->m_pixel_coords.y);
+        if (y < height)
+            sorted_samples[offsets[y / StripeHeight]++] = *s;
+    }
+
+    // Queue the samples of each stripe. After the scatter, offsets[i] is the end of stripe i.
+    size_t begin = 0;
+    for (size_t i = 0; i < m_stripe_count; ++i)
+    {
+        const size_t end = offsets[i];
+        if (begin == end)
+            continue;
+
+        Stripe& stripe = m_stripes[i];
+        bool full;
+
+        {
+            Spinlock::ScopedLock lock(stripe.m_queue_lock);
+            stripe.m_queue.insert(
+                stripe.m_queue.end(),
+                sorted_samples.begin() + begin,
+                sorted_samples.begin() + end);
+            full = stripe.m_queue.size() >= MaxQueuedSamples;
+        }
 
-        m_fb.atomic_add(Vector2u(s->m_pixel_coords), &s->m_color[0]);
+        // Merge the queue if it is full, unless someone else is already merging this stripe.
+        if (full && stripe.m_merge_mutex.try_lock())
+        {
+            merge_stripe(stripe);
+            stripe.m_merge_mutex.unlock();
+        }
+
+        begin = end;
     }
 }
 
@@ -98,40 +159,33 @@ void GlobalSampleAccumulationBuffer::develop_to_frame(
     Frame&          frame,
     IAbortSwitch&   abort_switch)
 {
-    // Request exclusive access.
-    boost::unique_lock<boost::shared_mutex> lock(m_mutex, boost::defer_lock);
-    while (true)
-    {
-        if (abort_switch.is_aborted())
-            return;
-        if (lock.try_lock_for(boost::chrono::milliseconds(5)))
-            break;
-    }
-
-    Image& image = frame.image();
-    const CanvasProperties& frame_props = image.properties();
+    const CanvasProperties& frame_props = frame.image().properties();
 
     assert(frame_props.m_canvas_width == m_fb.get_width());
     assert(frame_props.m_canvas_height == m_fb.get_height());
     assert(frame_props.m_channel_count == 4);
 
-    const float scale = 1.0f / m_sample_count;
+    // Request exclusive access to all stripes. Storing threads keep queuing samples.
+    for (size_t i = 0; i < m_stripe_count; ++i)
+        m_stripes[i].m_merge_mutex.lock();
 
-    for (size_t ty = 0; ty < frame_props.m_tile_count_y; ++ty)
-    {
-        for (size_t tx = 0; tx < frame_props.m_tile_count_x; ++tx)
-        {
-            if (abort_switch.is_aborted())
-                return;
+    for (size_t i = 0; i < m_stripe_count; ++i)
+        merge_stripe(m_stripes[i]);
 
-            Tile& tile = image.tile(tx, ty);
+    // Read the sample count once all stripes are merged, so that all stripes are
+    // normalized by the same count and no banding appears between them.
+    const float scale = 1.0f / m_sample_count;
 
-            const size_t x = tx * frame_props.m_tile_width;
-            const size_t y = ty * frame_props.m_tile_height;
+    for (size_t i = 0; i < m_stripe_count; ++i)
+    {
+        if (abort_switch.is_aborted())
+            break;
 
-            develop_to_tile(tile, x, y, tx, ty, scale);
-        }
+        develop_stripe_to_frame(frame, i, scale);
     }
+
+    for (size_t i = 0; i < m_stripe_count; ++i)
+        m_stripes[i].m_merge_mutex.unlock();
 }
 
 void GlobalSampleAccumulationBuffer::increment_sample_count(const std::uint64_t delta_sample_count)
@@ -139,27 +193,50 @@ void GlobalSampleAccumulationBuffer::increment_sample_count(const std::uint64_t
     m_sample_count += delta_sample_count;
 }
 
-void GlobalSampleAccumulationBuffer::develop_to_tile(
-    Tile&           tile,
-    const size_t    origin_x,
-    const size_t    origin_y,
-    const size_t    tile_x,
-    const size_t    tile_y,
+void GlobalSampleAccumulationBuffer::merge_stripe(Stripe& stripe)
+{
+    // Grab the queued samples, leaving an empty queue behind for storing threads.
+    {
+        Spinlock::ScopedLock lock(stripe.m_queue_lock);
+        stripe.m_queue.swap(stripe.m_merge_queue);
+    }
+
+    for (const Sample& sample : stripe.m_merge_queue)
+        m_fb.add(Vector2u(sample.m_pixel_coords), &sample.m_color[0]);
+
+    clear_keep_memory(stripe.m_merge_queue);
+}
+
+void GlobalSampleAccumulationBuffer::develop_stripe_to_frame(
+    Frame&          frame,
+    const size_t    stripe_index,
     const float     scale) const
 {
-    const size_t tile_width = tile.get_width();
-    const size_t tile_height = tile.get_height();
+    Image& image = frame.image();
+    const CanvasProperties& frame_props = image.properties();
 
-    for (size_t y = 0; y < tile_height; ++y)
+    const size_t y_begin = stripe_index * StripeHeight;
+    const size_t y_end = std::min<size_t>(y_begin + StripeHeight, frame_props.m_canvas_height);
+
+    for (size_t y = y_begin; y < y_end; ++y)
     {
-        for (size_t x = 0; x < tile_width; ++x)
+        const size_t tile_y = y / frame_props.m_tile_height;
+        const size_t pixel_y = y - tile_y * frame_props.m_tile_height;
+
+        for (size_t tile_x = 0; tile_x < frame_props.m_tile_count_x; ++tile_x)
         {
-            const float* ptr = m_fb.pixel(origin_x + x, origin_y + y);
+            Tile& tile = image.tile(tile_x, tile_y);
+            const size_t origin_x = tile_x * frame_props.m_tile_width;
+
+            for (size_t x = 0, tile_width = tile.get_width(); x < tile_width; ++x)
+            {
+                const float* ptr = m_fb.pixel(origin_x + x, y);
 
-            Color4f color(ptr[1], ptr[2], ptr[3], 1.0f);
-            color.rgb() *= scale;
+                Color4f color(ptr[1], ptr[2], ptr[3], 1.0f);
+                color.rgb() *= scale;
 
-            tile.set_pixel(x, y, color);
+                tile.set_pixel(x, pixel_y, color);
+            }
         }
     }
 }
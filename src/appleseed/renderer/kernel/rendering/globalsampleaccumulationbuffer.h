@@ -30,6 +30,7 @@
 #pragma once
 
 // appleseed.renderer headers.
+#include "renderer/kernel/rendering/sample.h"
 #include "renderer/kernel/rendering/sampleaccumulationbuffer.h"
 
 // appleseed.foundation headers.
@@ -37,19 +38,34 @@
 #include "foundation/platform/compiler.h"
 #include "foundation/platform/thread.h"
 
+// Boost headers.
+#include "boost/thread/tss.hpp"
+
 // Standard headers.
 #include <cstddef>
 #include <cstdint>
+#include <memory>
+#include <vector>
 
 // Forward declarations.
 namespace foundation    { class IAbortSwitch; }
 namespace foundation    { class Tile; }
 namespace renderer      { class Frame; }
-namespace renderer      { class Sample; }
 
 namespace renderer
 {
 
+//
+// A frame-sized sample accumulation buffer that samples can be stored into anywhere.
+//
+// The buffer is split into horizontal stripes. Threads storing samples only append them
+// to the queue of the stripe they belong to, holding that stripe's queue lock for the
+// duration of a copy. Queued samples are merged into the buffer lazily: when a queue
+// grows too long, or when the buffer is developed. A stripe's queue is swapped with an
+// empty one before being merged, so that samples keep being stored while the stripe
+// is being merged or developed: developing the buffer never blocks rendering.
+//
+
 class GlobalSampleAccumulationBuffer
   : public SampleAccumulationBuffer
 {
@@ -77,15 +93,35 @@ class GlobalSampleAccumulationBuffer
     void increment_sample_count(const std::uint64_t delta_sample_count);
 
   private:
-    boost::shared_mutex             m_mutex;
+    enum { StripeHeight = 16 };                 // height of a stripe, in pixels
+    enum { MaxQueuedSamples = 4096 };           // number of samples that triggers a merge
+
+    struct Stripe
+    {
+        foundation::Spinlock        m_queue_lock;       // protects m_queue
+        std::vector<Sample>         m_queue;            // samples waiting to be merged
+        boost::mutex                m_merge_mutex;      // protects the stripe's pixels and m_merge_queue
+        std::vector<Sample>         m_merge_queue;      // samples being merged
+    };
+
+    // Per-thread buffers used to sort samples by stripe, kept across calls to store_samples().
+    struct ScratchBuffers
+    {
+        std::vector<size_t>         m_offsets;
+        std::vector<Sample>         m_sorted_samples;
+    };
+
     foundation::AccumulatorTile     m_fb;
+    const size_t                    m_stripe_count;
+    std::unique_ptr<Stripe[]>       m_stripes;
+    boost::thread_specific_ptr<ScratchBuffers> m_scratch_buffers;
 
-    void develop_to_tile(
-        foundation::Tile&           tile,
-        const size_t                origin_x,
-        const size_t                origin_y,
-        const size_t                tile_x,
-        const size_t                tile_y,
+    // Merge the queued samples of a stripe into the buffer. The stripe's merge mutex must be held.
+    void merge_stripe(Stripe& stripe);
+
+    void develop_stripe_to_frame(
+        Frame&                      frame,
+        const size_t                stripe_index,
         const float                 scale) const;
 };
 
@@ -38,6 +38,7 @@
 // Forward declarations.
 namespace foundation    { class IAbortSwitch; }
 namespace foundation    { class StatisticsVector; }
+namespace renderer      { class AdaptiveSamplingMap; }
 namespace renderer      { class SampleAccumulationBuffer; }
 
 namespace renderer
@@ -57,6 +58,10 @@ class ISampleGenerator
     // Reset the sample generator to its initial state.
     virtual void reset() = 0;
 
+    // Set the map according to which samples are distributed over the frame,
+    // or nullptr to distribute samples uniformly.
+    virtual void set_sampling_map(const AdaptiveSamplingMap* sampling_map) = 0;
+
     // Generate a given number of samples and accumulate them into a buffer.
     virtual void generate_samples(
         const size_t                sample_count,
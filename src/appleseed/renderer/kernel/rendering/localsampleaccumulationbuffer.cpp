@@ -33,10 +33,12 @@
 // appleseed.renderer headers.
 #include "renderer/kernel/aov/imagestack.h"
 #include "renderer/kernel/aov/tilestack.h"
+#include "renderer/kernel/rendering/adaptivesamplingmap.h"
 #include "renderer/kernel/rendering/sample.h"
 #include "renderer/modeling/frame/frame.h"
 
 // appleseed.foundation headers.
+#include "foundation/hash/hash.h"
 #include "foundation/image/accumulatortile.h"
 #include "foundation/image/canvasproperties.h"
 #include "foundation/image/color.h"
@@ -77,12 +79,20 @@ namespace renderer
 //   pushing samples to and the level that is displayed. As soon as a level contains enough
 //   samples, it becomes the new active level.
 //
+//   When adaptive sampling is used, an additional full resolution level receives half of
+//   the samples. Comparing it with the highest resolution level of the pyramid gives an
+//   estimate of the noise level of each pixel. This level is only allocated when noise estimation
+//   is enabled so that renders that don't use adaptive sampling don't pay for it. It must receive
+//   samples from the start of the render: since the weights of its pixels are compared with those
+//   of the highest resolution level, a late start would bias the noise estimate.
+//
 
 // #define PRINT_DETAILED_PERF_REPORTS
 
 LocalSampleAccumulationBuffer::LocalSampleAccumulationBuffer(
     const size_t        width,
     const size_t        height)
+  : m_half_level(nullptr)
 {
     const size_t MinSize = 32;
 
@@ -111,6 +121,8 @@ LocalSampleAccumulationBuffer::LocalSampleAccumulationBuffer(
 
 LocalSampleAccumulationBuffer::~LocalSampleAccumulationBuffer()
 {
+    delete m_half_level;
+
     delete[] m_remaining_pixels;
 
     for (size_t i = 0, e = m_levels.size(); i < e; ++i)
@@ -143,6 +155,11 @@ void LocalSampleAccumulationBuffer::clear()
     }
 
     m_active_level = static_cast<std::uint32_t>(m_levels.size() - 1);
+
+    if (m_half_level != nullptr)
+        m_half_level->clear();
+
+    m_half_level_seed = 0;
 }
 
 void LocalSampleAccumulationBuffer::store_samples(
@@ -193,6 +210,28 @@ void LocalSampleAccumulationBuffer::store_samples(
             }
         }
 
+        // Store half of the samples into the half-sample level. Samples are picked at random:
+        // consecutive samples follow a low discrepancy sequence, picking every other sample
+        // would select samples from the same regions of the frame.
+        if (m_half_level != nullptr)
+        {
+            const std::uint32_t seed =
+                m_half_level_seed.fetch_add(static_cast<std::uint32_t>(sample_count));
+
+            for (size_t i = 0; i < sample_count; ++i)
+            {
+                if ((hash_uint32(seed + static_cast<std::uint32_t>(i)) & 1) == 0)
+                    continue;
+
+                const Sample& s = samples[i];
+                m_half_level->atomic_add(
+                    Vector2u(
+                        static_cast<size_t>(s.m_pixel_coords.x),
+                        static_cast<size_t>(s.m_pixel_coords.y)),
+                    &s.m_color[0]);
+            }
+        }
+
         m_lock.unlock_read();
     }
 
@@ -303,6 +342,46 @@ void LocalSampleAccumulationBuffer::develop_to_frame(
 #endif
 }
 
+void LocalSampleAccumulationBuffer::enable_noise_estimation()
+{
+    // Request exclusive access.
+    LockType::ScopedWriteLock lock(m_lock);
+
+    assert(m_sample_count == 0);
+
+    if (m_half_level == nullptr)
+    {
+        m_half_level =
+            new AccumulatorTile(
+                m_levels[0]->get_width(),
+                m_levels[0]->get_height(),
+                4);
+        m_half_level->clear();
+    }
+}
+
+bool LocalSampleAccumulationBuffer::update_sampling_map(
+    AdaptiveSamplingMap&    map,
+    IAbortSwitch&           abort_switch)
+{
+    if (m_half_level == nullptr)
+        return false;
+
+    // Request exclusive access.
+    while (!m_lock.try_lock_write())
+    {
+        foundation::sleep(5);
+        if (abort_switch.is_aborted())
+            return false;
+    }
+
+    map.update(*m_levels[0], *m_half_level);
+
+    m_lock.unlock_write();
+
+    return true;
+}
+
 void LocalSampleAccumulationBuffer::develop_to_tile(
     Tile&                   color_tile,
     const size_t            image_width,
@@ -47,6 +47,7 @@
 namespace foundation    { class AccumulatorTile; }
 namespace foundation    { class IAbortSwitch; }
 namespace foundation    { class Tile; }
+namespace renderer      { class AdaptiveSamplingMap; }
 namespace renderer      { class Frame; }
 namespace renderer      { class Sample; }
 
@@ -79,6 +80,16 @@ class LocalSampleAccumulationBuffer
         Frame&                                  frame,
         foundation::IAbortSwitch&               abort_switch) override;
 
+    // Start storing half of the samples into an additional full resolution level.
+    // Must be called before any sample is stored.
+    void enable_noise_estimation() override;
+
+    // Estimate the noise level of the buffer and update an adaptive sampling map accordingly.
+    // Return false if the map was left untouched, that is if noise estimation is disabled. Thread-safe.
+    bool update_sampling_map(
+        AdaptiveSamplingMap&                    map,
+        foundation::IAbortSwitch&               abort_switch) override;
+
     // Exposed for tests and benchmarks.
     static void develop_to_tile(
         foundation::Tile&                       color_tile,
@@ -99,6 +110,8 @@ class LocalSampleAccumulationBuffer
     std::vector<foundation::Vector2f>           m_level_scales;
     boost::atomic<std::int32_t>*                m_remaining_pixels;
     boost::atomic<std::uint32_t>                m_active_level;
+    foundation::AccumulatorTile*                m_half_level;           // full resolution, half of the samples
+    boost::atomic<std::uint32_t>                m_half_level_seed;
 };
 
 }   // namespace renderer
@@ -224,6 +224,9 @@ struct MasterRenderer::Impl
             // Insert rendering time into frame's render info.
             render_info.insert("render_time", m_project.get_rendering_timer().get_seconds());
 
+            // Wait for checkpoint writes to complete, even if rendering was aborted.
+            m_project.get_frame()->flush_checkpoint();
+
             // Don't proceed further if rendering failed.
             if (result.m_status != RenderingResult::Succeeded)
                 return result;
@@ -385,6 +388,15 @@ struct MasterRenderer::Impl
              RENDERER_LOG_INFO("using Intel Embree ray tracing kernel.");
         else RENDERER_LOG_INFO("using built-in ray tracing kernel.");
 
+        // Let triangle and curve trees be loaded from and saved to the tree cache.
+        const std::string tree_cache_directory = m_params.get_optional<std::string>("tree_cache_directory", "");
+        m_project.set_tree_cache_directory(tree_cache_directory.c_str());
+        if (!tree_cache_directory.empty())
+            RENDERER_LOG_INFO("using tree cache directory %s.", tree_cache_directory.c_str());
+
+        // Build triangle trees with as many threads as are used for rendering.
+        m_project.set_tree_build_thread_count(get_rendering_thread_count(m_params));
+
         // Updating the device scene causes ray tracing acceleration structures to be updated or rebuilt.
         if (!m_render_device->build_or_update_scene())
         {
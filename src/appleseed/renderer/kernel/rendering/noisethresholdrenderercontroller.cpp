@@ -0,0 +1,256 @@
+
+//
+// This source file is part of appleseed.
+// Visit https://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2019 The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+// Interface header.
+#include "noisethresholdrenderercontroller.h"
+
+// appleseed.renderer headers.
+#include "renderer/global/globallogger.h"
+#include "renderer/utility/paramarray.h"
+
+// appleseed.foundation headers.
+#include "foundation/platform/defaulttimers.h"
+#include "foundation/platform/thread.h"
+#include "foundation/string/string.h"
+#include "foundation/utility/stopwatch.h"
+
+// Standard headers.
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+using namespace foundation;
+
+namespace renderer
+{
+
+//
+// NoiseThresholdRendererController class implementation.
+//
+
+namespace
+{
+    // Number of most recent noise level records used for extrapolation.
+    const size_t MaxRecordCount = 8;
+
+    // Fitted curves along which the noise level doesn't decrease at least this fast are rejected.
+    const double MaxSlope = -0.05;
+}
+
+struct NoiseThresholdRendererController::Impl
+{
+    const float                         m_noise_threshold;
+    ParamArray&                         m_render_info;
+
+    mutable Spinlock                    m_spinlock;                 // protects all members below
+    Stopwatch<DefaultWallclockTimer>    m_stopwatch;
+    std::vector<Vector2d>               m_records;                  // (time, noise level) records
+    float                               m_noise_level;
+    bool                                m_converged;
+    double                              m_time_to_noise_threshold;
+    bool                                m_has_new_record;
+
+    Impl(
+        const float                     noise_threshold,
+        ParamArray&                     render_info)
+      : m_noise_threshold(noise_threshold)
+      , m_render_info(render_info)
+    {
+        clear();
+    }
+
+    void clear()
+    {
+        m_records.clear();
+        m_noise_level = 0.0f;
+        m_converged = false;
+        m_time_to_noise_threshold = -1.0;
+        m_has_new_record = false;
+    }
+};
+
+NoiseThresholdRendererController::NoiseThresholdRendererController(
+    const float                         noise_threshold,
+    ParamArray&                         render_info)
+  : impl(new Impl(noise_threshold, render_info))
+{
+}
+
+NoiseThresholdRendererController::~NoiseThresholdRendererController()
+{
+    delete impl;
+}
+
+void NoiseThresholdRendererController::on_frame_begin()
+{
+    Spinlock::ScopedLock lock(impl->m_spinlock);
+
+    impl->clear();
+    impl->m_stopwatch.start();
+}
+
+void NoiseThresholdRendererController::on_rendering_pause()
+{
+    Spinlock::ScopedLock lock(impl->m_spinlock);
+
+    impl->m_stopwatch.pause();
+}
+
+void NoiseThresholdRendererController::on_rendering_resume()
+{
+    Spinlock::ScopedLock lock(impl->m_spinlock);
+
+    impl->m_stopwatch.resume();
+}
+
+void NoiseThresholdRendererController::on_progress()
+{
+    float noise_level;
+    double time_to_noise_threshold;
+
+    {
+        Spinlock::ScopedLock lock(impl->m_spinlock);
+
+        if (!impl->m_has_new_record)
+            return;
+
+        impl->m_has_new_record = false;
+        noise_level = impl->m_noise_level;
+        time_to_noise_threshold = impl->m_time_to_noise_threshold;
+    }
+
+    impl->m_render_info.insert("noise_level", noise_level);
+
+    if (time_to_noise_threshold >= 0.0)
+    {
+        impl->m_render_info.insert("time_to_noise_threshold", time_to_noise_threshold);
+
+        RENDERER_LOG_INFO(
+            "noise level %s, estimated time to noise threshold %s",
+            pretty_scalar(noise_level, 3).c_str(),
+            pretty_time(time_to_noise_threshold).c_str());
+    }
+}
+
+IRendererController::Status NoiseThresholdRendererController::get_status() const
+{
+    Spinlock::ScopedLock lock(impl->m_spinlock);
+
+    return impl->m_converged ? TerminateRendering : ContinueRendering;
+}
+
+void NoiseThresholdRendererController::record_noise_level(
+    const float                         noise_level,
+    const bool                          converged)
+{
+    Spinlock::ScopedLock lock(impl->m_spinlock);
+
+    const double time = impl->m_stopwatch.measure().get_seconds();
+
+    impl->m_records.emplace_back(time, static_cast<double>(noise_level));
+    if (impl->m_records.size() > MaxRecordCount)
+        impl->m_records.erase(impl->m_records.begin());
+
+    impl->m_noise_level = noise_level;
+    impl->m_converged = converged;
+
+    if (converged)
+        impl->m_time_to_noise_threshold = 0.0;
+    else
+    {
+        const double target_time =
+            extrapolate_time_to_noise_level(impl->m_records, impl->m_noise_threshold);
+
+        impl->m_time_to_noise_threshold =
+            target_time >= 0.0 ? std::max(target_time - time, 0.0) : -1.0;
+    }
+
+    impl->m_has_new_record = true;
+}
+
+double NoiseThresholdRendererController::get_time_to_noise_threshold() const
+{
+    Spinlock::ScopedLock lock(impl->m_spinlock);
+
+    return impl->m_time_to_noise_threshold;
+}
+
+double NoiseThresholdRendererController::extrapolate_time_to_noise_level(
+    const std::vector<Vector2d>&        records,
+    const double                        target_noise_level)
+{
+    if (records.empty())
+        return -1.0;
+
+    const Vector2d& last = records.back();
+
+    if (last.x <= 0.0 || last.y <= 0.0)
+        return -1.0;
+
+    if (last.y <= target_noise_level)
+        return last.x;
+
+    // Fit a line to the records in log-log space: log(noise) = a + b * log(time).
+    double sx = 0.0, sy = 0.0, sxx = 0.0, sxy = 0.0;
+    size_t n = 0;
+
+    for (const Vector2d& r : records)
+    {
+        if (r.x > 0.0 && r.y > 0.0)
+        {
+            const double x = std::log(r.x);
+            const double y = std::log(r.y);
+            sx += x;
+            sy += y;
+            sxx += x * x;
+            sxy += x * y;
+            ++n;
+        }
+    }
+
+    // Default to the convergence rate of Monte Carlo integration: noise ~ 1 / sqrt(time).
+    double slope = -0.5;
+
+    if (n >= 2)
+    {
+        const double d = n * sxx - sx * sx;
+
+        if (d > 1.0e-9)
+        {
+            const double fitted_slope = (n * sxy - sx * sy) / d;
+
+            if (fitted_slope < MaxSlope)
+                slope = fitted_slope;
+        }
+    }
+
+    // Extrapolate from the most recent record.
+    return last.x * std::pow(target_noise_level / last.y, 1.0 / slope);
+}
+
+}   // namespace renderer
@@ -0,0 +1,104 @@
+
+//
+// This source file is part of appleseed.
+// Visit https://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2019 The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+// appleseed.renderer headers.
+#include "renderer/kernel/rendering/defaultrenderercontroller.h"
+
+// appleseed.foundation headers.
+#include "foundation/math/vector.h"
+#include "foundation/platform/compiler.h"
+
+// appleseed.main headers.
+#include "main/dllsymbol.h"
+
+// Standard headers.
+#include <vector>
+
+// Forward declarations.
+namespace renderer  { class ParamArray; }
+
+namespace renderer
+{
+
+//
+// A renderer controller that stops rendering once the noise level of the frame has
+// reached a given threshold, and that predicts how long it will take to get there.
+//
+// The frame renderer periodically reports the noise level of the frame. Assuming the
+// noise level decreases as a power of the rendering time, the controller fits such a
+// curve to the most recent reports and extrapolates it to the noise threshold.
+//
+// The noise level and the estimated remaining rendering time are logged and stored in
+// the frame's render info as "noise_level" and "time_to_noise_threshold" (in seconds)
+// from on_progress().
+//
+
+class APPLESEED_DLLSYMBOL NoiseThresholdRendererController
+  : public DefaultRendererController
+{
+  public:
+    // Constructor.
+    NoiseThresholdRendererController(
+        const float                             noise_threshold,
+        ParamArray&                             render_info);
+
+    // Destructor.
+    ~NoiseThresholdRendererController() override;
+
+    void on_frame_begin() override;
+    void on_rendering_pause() override;
+    void on_rendering_resume() override;
+    void on_progress() override;
+
+    Status get_status() const override;
+
+    // Report the current noise level of the frame, and whether every part of the frame
+    // has reached the noise threshold. Thread-safe.
+    void record_noise_level(
+        const float                             noise_level,
+        const bool                              converged);
+
+    // Return the estimated remaining rendering time in seconds, or a negative value
+    // if no estimate is available yet. Thread-safe.
+    double get_time_to_noise_threshold() const;
+
+    // Estimate the time at which the noise level will reach a target value given a series
+    // of (time, noise level) records, or return a negative value if no estimate can be made.
+    // Exposed for tests.
+    static double extrapolate_time_to_noise_level(
+        const std::vector<foundation::Vector2d>& records,
+        const double                            target_noise_level);
+
+  private:
+    struct Impl;
+    Impl* impl;
+};
+
+}   // namespace renderer
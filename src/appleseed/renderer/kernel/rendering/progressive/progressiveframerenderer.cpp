@@ -32,12 +32,15 @@
 
 // appleseed.renderer headers.
 #include "renderer/global/globallogger.h"
+#include "renderer/kernel/rendering/adaptivesamplingmap.h"
 #include "renderer/kernel/rendering/iframerenderer.h"
 #include "renderer/kernel/rendering/isamplegenerator.h"
 #include "renderer/kernel/rendering/itilecallback.h"
+#include "renderer/kernel/rendering/noisethresholdrenderercontroller.h"
 #include "renderer/kernel/rendering/progressive/samplecounter.h"
 #include "renderer/kernel/rendering/progressive/samplecounthistory.h"
 #include "renderer/kernel/rendering/progressive/samplegeneratorjob.h"
+#include "renderer/kernel/rendering/renderercontrollercollection.h"
 #include "renderer/kernel/rendering/sampleaccumulationbuffer.h"
 #include "renderer/kernel/rendering/timedrenderercontroller.h"
 #include "renderer/modeling/frame/frame.h"
@@ -88,6 +91,9 @@ namespace
 {
     using SampleCountHistoryType = SampleCountHistory<128>;
 
+    // Size in pixels of the square blocks adaptive sampling operates on.
+    const size_t AdaptiveSamplingBlockSize = 16;
+
 
     //
     // Frame display thread.
@@ -252,17 +258,21 @@ namespace
     {
       public:
         StatisticsFunc(
-            const Project&              project,
-            SampleAccumulationBuffer&   buffer,
-            SampleCountHistoryType&     sample_count_history,
-            Spinlock&                   sample_count_history_spinlock,
-            const bool                  perf_stats,
-            const bool                  luminance_stats,
-            const Image*                ref_image,
-            const double                ref_image_avg_lum,
-            IAbortSwitch&               abort_switch)
+            const Project&                      project,
+            SampleAccumulationBuffer&           buffer,
+            AdaptiveSamplingMap*                sampling_map,
+            NoiseThresholdRendererController*   noise_threshold_controller,
+            SampleCountHistoryType&             sample_count_history,
+            Spinlock&                           sample_count_history_spinlock,
+            const bool                          perf_stats,
+            const bool                          luminance_stats,
+            const Image*                        ref_image,
+            const double                        ref_image_avg_lum,
+            IAbortSwitch&                       abort_switch)
           : m_project(project)
           , m_buffer(buffer)
+          , m_sampling_map(sampling_map)
+          , m_noise_threshold_controller(noise_threshold_controller)
           , m_sample_count_history(sample_count_history)
           , m_sample_count_history_spinlock(sample_count_history_spinlock)
           , m_perf_stats(perf_stats)
@@ -334,6 +344,9 @@ namespace
                     const double time = (m_timer.read() - m_timer_start_value) * m_rcp_timer_frequency;
                     record_and_print_perf_stats(time);
 
+                    if (m_sampling_map)
+                        update_sampling_map();
+
                     if (m_luminance_stats || m_ref_image)
                         record_and_print_convergence_stats();
                 }
@@ -343,24 +356,26 @@ namespace
         }
 
       private:
-        const Project&                  m_project;
-        SampleAccumulationBuffer&       m_buffer;
-        SampleCountHistoryType&         m_sample_count_history;
-        Spinlock&                       m_sample_count_history_spinlock;
-        const bool                      m_perf_stats;
-        const bool                      m_luminance_stats;
-        const Image*                    m_ref_image;
-        const double                    m_ref_image_avg_lum;
-        IAbortSwitch&                   m_abort_switch;
-        ThreadFlag                      m_pause_flag;
-
-        DefaultWallclockTimer           m_timer;
-        double                          m_rcp_timer_frequency;
-        std::uint64_t                   m_timer_start_value;
-
-        double                          m_rcp_pixel_count;
-        std::vector<Vector2d>           m_sample_count_records;     // total sample count over time
-        std::vector<Vector2d>           m_rmsd_records;             // RMS deviation over time
+        const Project&                      m_project;
+        SampleAccumulationBuffer&           m_buffer;
+        AdaptiveSamplingMap*                m_sampling_map;
+        NoiseThresholdRendererController*   m_noise_threshold_controller;
+        SampleCountHistoryType&             m_sample_count_history;
+        Spinlock&                           m_sample_count_history_spinlock;
+        const bool                          m_perf_stats;
+        const bool                          m_luminance_stats;
+        const Image*                        m_ref_image;
+        const double                        m_ref_image_avg_lum;
+        IAbortSwitch&                       m_abort_switch;
+        ThreadFlag                          m_pause_flag;
+
+        DefaultWallclockTimer               m_timer;
+        double                              m_rcp_timer_frequency;
+        std::uint64_t                       m_timer_start_value;
+
+        double                              m_rcp_pixel_count;
+        std::vector<Vector2d>               m_sample_count_records;     // total sample count over time
+        std::vector<Vector2d>               m_rmsd_records;             // RMS deviation over time
 
         void record_and_print_perf_stats(const double time)
         {
@@ -383,6 +398,35 @@ namespace
                 m_sample_count_records.emplace_back(time, static_cast<double>(samples));
         }
 
+        void update_sampling_map()
+        {
+            assert(m_sampling_map);
+
+            // Estimate the noise level of the frame and redistribute samples accordingly.
+            if (!m_buffer.update_sampling_map(*m_sampling_map, m_abort_switch))
+                return;
+
+            if (m_noise_threshold_controller)
+            {
+                m_noise_threshold_controller->record_noise_level(
+                    m_sampling_map->get_max_block_error(),
+                    m_sampling_map->is_converged());
+            }
+
+            if (m_sampling_map->is_converged())
+            {
+                RENDERER_LOG_INFO("all pixels have reached the noise threshold, stopping rendering.");
+                return;
+            }
+
+            RENDERER_LOG_INFO(
+                "%s pixel blocks converged, max noise level %s",
+                pretty_percent(
+                    m_sampling_map->get_converged_block_count(),
+                    m_sampling_map->get_block_count()).c_str(),
+                pretty_scalar(m_sampling_map->get_max_block_error(), 3).c_str());
+        }
+
         void record_and_print_convergence_stats()
         {
             assert(m_luminance_stats || m_ref_image);
@@ -444,7 +488,8 @@ namespace
                     ? m_params.m_max_average_spp * project.get_frame()->get_crop_window().volume()
                     : m_params.m_max_average_spp)
           , m_ref_image_avg_lum(0.0)
-          , m_renderer_controller(m_params.m_time_limit)
+          , m_timed_renderer_controller(m_params.m_time_limit)
+          , m_noise_threshold_renderer_controller(m_params.m_noise_threshold, project.get_frame()->render_info())
         {
             // We must have a generator factory, but it's OK not to have a callback factory.
             assert(generator_factory);
@@ -452,6 +497,23 @@ namespace
             // Create an accumulation buffer.
             m_buffer.reset(generator_factory->create_sample_accumulation_buffer());
 
+            // Stop rendering when the time limit is reached or, with adaptive sampling, when the frame has converged.
+            m_renderer_controller.insert(&m_timed_renderer_controller);
+            if (m_params.m_adaptive_sampling)
+                m_renderer_controller.insert(&m_noise_threshold_renderer_controller);
+
+            // Create the adaptive sampling map.
+            if (m_params.m_adaptive_sampling)
+            {
+                m_buffer->enable_noise_estimation();
+                m_sampling_map.reset(
+                    new AdaptiveSamplingMap(
+                        project.get_frame()->get_crop_window(),
+                        AdaptiveSamplingBlockSize,
+                        m_params.m_noise_threshold,
+                        m_params.m_min_samples));
+            }
+
             // Create and initialize the job manager.
             m_job_manager.reset(
                 new JobManager(
@@ -466,6 +528,7 @@ namespace
             {
                 m_sample_generators.push_back(
                     generator_factory->create(i, m_params.m_thread_count));
+                m_sample_generators.back()->set_sampling_map(m_sampling_map.get());
             }
 
             // Create rendering jobs, one per rendering thread.
@@ -477,6 +540,7 @@ namespace
                         *m_buffer.get(),
                         m_sample_generators[i],
                         m_sample_counter,
+                        m_sampling_map.get(),
                         m_params.m_sampling_profile,
                         m_params.m_spectrum_mode,
                         m_job_queue,
@@ -536,6 +600,9 @@ namespace
                 "  rendering threads             %s\n"
                 "  max average samples per pixel %s\n"
                 "  time limit                    %s\n"
+                "  adaptive sampling             %s\n"
+                "  noise threshold               %f\n"
+                "  min samples                   %s\n"
                 "  max fps                       %f\n"
                 "  collect performance stats     %s\n"
                 "  collect luminance stats       %s",
@@ -548,6 +615,9 @@ namespace
                 m_params.m_time_limit == std::numeric_limits<double>::max()
                     ? "unlimited"
                     : pretty_time(m_params.m_time_limit).c_str(),
+                m_params.m_adaptive_sampling ? "on" : "off",
+                m_params.m_noise_threshold,
+                pretty_uint(m_params.m_min_samples).c_str(),
                 m_params.m_max_fps,
                 m_params.m_perf_stats ? "on" : "off",
                 m_params.m_luminance_stats ? "on" : "off");
@@ -581,6 +651,9 @@ namespace
             m_buffer->clear();
             m_sample_counter.clear();
 
+            if (m_sampling_map)
+                m_sampling_map->clear();
+
             m_sample_count_history_spinlock.lock();
             m_sample_count_history.clear();
             m_sample_count_history_spinlock.unlock();
@@ -605,6 +678,8 @@ namespace
                 new StatisticsFunc(
                     m_project,
                     *m_buffer,
+                    m_sampling_map.get(),
+                    m_params.m_adaptive_sampling ? &m_noise_threshold_renderer_controller : nullptr,
                     m_sample_count_history,
                     m_sample_count_history_spinlock,
                     m_params.m_perf_stats,
@@ -718,6 +793,9 @@ namespace
             const size_t                            m_thread_count;       // number of rendering threads
             const std::uint64_t                     m_max_average_spp;    // maximum average number of samples to compute per pixel
             const double                            m_time_limit;         // maximum rendering time in seconds
+            const bool                              m_adaptive_sampling;  // concentrate samples in noisy regions and stop once noise is low enough?
+            const float                             m_noise_threshold;    // maximum noise level of a converged pixel block
+            const size_t                            m_min_samples;        // minimum average number of samples per pixel before a pixel block may converge
             const double                            m_max_fps;            // maximum display frequency in frames/second
             const bool                              m_perf_stats;         // collect and print performance statistics?
             const bool                              m_luminance_stats;    // collect and print luminance statistics?
@@ -729,6 +807,9 @@ namespace
               , m_thread_count(get_rendering_thread_count(params))
               , m_max_average_spp(params.get_optional<std::uint64_t>("max_average_spp", std::numeric_limits<std::uint64_t>::max()))
               , m_time_limit(params.get_optional<double>("time_limit", std::numeric_limits<double>::max()))
+              , m_adaptive_sampling(params.get_optional<bool>("adaptive_sampling", false))
+              , m_noise_threshold(params.get_optional<float>("noise_threshold", 0.1f))
+              , m_min_samples(params.get_optional<size_t>("min_samples", 16))
               , m_max_fps(params.get_optional<double>("max_fps", 30.0))
               , m_perf_stats(params.get_optional<bool>("performance_statistics", false))
               , m_luminance_stats(params.get_optional<bool>("luminance_statistics", false))
@@ -757,6 +838,7 @@ namespace
         Spinlock                                    m_sample_count_history_spinlock;
 
         std::unique_ptr<SampleAccumulationBuffer>   m_buffer;
+        std::unique_ptr<AdaptiveSamplingMap>        m_sampling_map;
 
         JobQueue                                    m_job_queue;
         std::unique_ptr<JobManager>                 m_job_manager;
@@ -775,7 +857,9 @@ namespace
         std::unique_ptr<StatisticsFunc>             m_statistics_func;
         std::unique_ptr<boost::thread>              m_statistics_thread;
 
-        TimedRendererController                     m_renderer_controller;
+        TimedRendererController                     m_timed_renderer_controller;
+        NoiseThresholdRendererController            m_noise_threshold_renderer_controller;
+        RendererControllerCollection                m_renderer_controller;
 
         void print_sample_generators_stats() const
         {
@@ -786,6 +870,15 @@ namespace
             for (auto sample_generator : m_sample_generators)
                 stats.merge(sample_generator->get_statistics());
 
+            if (m_sampling_map)
+            {
+                Statistics sampling_map_stats;
+                sampling_map_stats.insert("pixel blocks", m_sampling_map->get_block_count());
+                sampling_map_stats.insert("converged blocks", m_sampling_map->get_converged_block_count());
+                sampling_map_stats.insert("max noise level", m_sampling_map->get_max_block_error());
+                stats.insert("adaptive sampling statistics", sampling_map_stats);
+            }
+
             RENDERER_LOG_DEBUG("%s", stats.to_string().c_str());
         }
     };
@@ -817,6 +910,34 @@ Dictionary ProgressiveFrameRendererFactory::get_params_metadata()
             .insert("label", "Max Average Samples Per Pixel")
             .insert("help", "Maximum number of average samples per pixel"));
 
+    metadata.dictionaries().insert(
+        "adaptive_sampling",
+        Dictionary()
+            .insert("type", "bool")
+            .insert("default", "false")
+            .insert("label", "Adaptive Sampling")
+            .insert("help", "Concentrate samples in noisy regions of the frame and stop rendering once the noise threshold is reached everywhere"));
+
+    metadata.dictionaries().insert(
+        "noise_threshold",
+        Dictionary()
+            .insert("type", "float")
+            .insert("default", "0.1")
+            .insert("min", "0.0001")
+            .insert("max", "10000.0")
+            .insert("label", "Noise Threshold")
+            .insert("help", "Maximum amount of noise allowed in the image"));
+
+    metadata.dictionaries().insert(
+        "min_samples",
+        Dictionary()
+            .insert("type", "int")
+            .insert("default", "16")
+            .insert("min", "0")
+            .insert("max", "1000000")
+            .insert("label", "Min Samples")
+            .insert("help", "Minimum average number of samples per pixel before a region of the frame may be considered converged"));
+
     metadata.dictionaries().insert(
         "time_limit",
         Dictionary()
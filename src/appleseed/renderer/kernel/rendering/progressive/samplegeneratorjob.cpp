@@ -32,6 +32,7 @@
 
 // appleseed.renderer headers.
 #include "renderer/global/globallogger.h"
+#include "renderer/kernel/rendering/adaptivesamplingmap.h"
 #include "renderer/kernel/rendering/isamplegenerator.h"
 #include "renderer/kernel/rendering/progressive/samplecounter.h"
 #include "renderer/kernel/rendering/sampleaccumulationbuffer.h"
@@ -81,6 +82,7 @@ SampleGeneratorJob::SampleGeneratorJob(
     SampleAccumulationBuffer&   buffer,
     ISampleGenerator*           sample_generator,
     SampleCounter&              sample_counter,
+    const AdaptiveSamplingMap*  sampling_map,
     const SamplingProfile&      sampling_profile,
     const Spectrum::Mode        spectrum_mode,
     JobQueue&                   job_queue,
@@ -89,6 +91,7 @@ SampleGeneratorJob::SampleGeneratorJob(
   : m_buffer(buffer)
   , m_sample_generator(sample_generator)
   , m_sample_counter(sample_counter)
+  , m_sampling_map(sampling_map)
   , m_sampling_profile(sampling_profile)
   , m_spectrum_mode(spectrum_mode)
   , m_job_queue(job_queue)
@@ -108,6 +111,10 @@ void SampleGeneratorJob::execute(const size_t thread_index)
     const double t1 = stopwatch.get_seconds();
 #endif
 
+    // Terminate this job if the whole frame has converged.
+    if (m_sampling_map != nullptr && m_sampling_map->is_converged())
+        return;
+
     // We will base the number of samples to be rendered by this job on
     // the number of samples already reserved (not necessarily rendered).
     const std::uint64_t current_sample_count = m_sample_counter.read();
@@ -40,6 +40,7 @@
 #include <cstdint>
 
 // Forward declarations.
+namespace renderer  { class AdaptiveSamplingMap; }
 namespace renderer  { class ISampleGenerator; }
 namespace renderer  { class SampleAccumulationBuffer; }
 namespace renderer  { class SampleCounter; }
@@ -77,6 +78,7 @@ class SampleGeneratorJob
         SampleAccumulationBuffer&   buffer,
         ISampleGenerator*           sample_generator,
         SampleCounter&              sample_counter,
+        const AdaptiveSamplingMap*  sampling_map,
         const SamplingProfile&      sampling_profile,
         const Spectrum::Mode        spectrum_mode,
         foundation::JobQueue&       job_queue,
@@ -90,6 +92,7 @@ class SampleGeneratorJob
     SampleAccumulationBuffer&       m_buffer;
     ISampleGenerator*               m_sample_generator;
     SampleCounter&                  m_sample_counter;
+    const AdaptiveSamplingMap*      m_sampling_map;
     const SamplingProfile           m_sampling_profile;
     const Spectrum::Mode            m_spectrum_mode;
     foundation::JobQueue&           m_job_queue;
@@ -96,6 +96,49 @@ namespace
         copy_param(child, source, "rendering_threads");
         return child;
     }
+
+    // Let the backward light sampler and the path tracer learn from the first passes.
+    class PTPassCallback
+      : public IPassCallback
+    {
+      public:
+        PTPassCallback(
+            BackwardLightSampler&       light_sampler,
+            PTLightingEngineFactory&    lighting_engine_factory)
+          : m_light_sampler(light_sampler)
+          , m_lighting_engine_factory(lighting_engine_factory)
+        {
+        }
+
+        void release() override
+        {
+            delete this;
+        }
+
+        void on_pass_begin(
+            const Frame&                frame,
+            JobQueue&                   job_queue,
+            IAbortSwitch&               abort_switch) override
+        {
+            if (m_light_sampler.has_importance_cache())
+                m_light_sampler.on_pass_begin();
+        }
+
+        void on_pass_end(
+            const Frame&                frame,
+            JobQueue&                   job_queue,
+            IAbortSwitch&               abort_switch) override
+        {
+            if (m_light_sampler.has_importance_cache())
+                m_light_sampler.on_pass_end();
+
+            m_lighting_engine_factory.on_pass_end();
+        }
+
+      private:
+        BackwardLightSampler&           m_light_sampler;
+        PTLightingEngineFactory&        m_lighting_engine_factory;
+    };
 }
 
 RendererComponents::RendererComponents(
@@ -187,11 +230,35 @@ bool RendererComponents::create_lighting_engine_factory()
                 m_scene,
                 get_child_and_inherit_globals(m_params, "light_sampler")));
 
-        m_lighting_engine_factory.reset(
+        ParamArray pt_params = get_child_and_inherit_globals(m_params, "pt");     // todo: change to "pt_lighting_engine"?
+
+        // Path guiding is trained at the end of the first passes, but the progressive
+        // frame renderer never ends a pass: the SD-tree would record radiance forever
+        // without ever being refined.
+        if (pt_params.get_optional<bool>("enable_path_guiding", false) &&
+            m_params.get_optional<std::string>("frame_renderer", "generic") == "progressive")
+        {
+            RENDERER_LOG_WARNING("path guiding is not supported by the progressive frame renderer, disabling it.");
+            pt_params.insert("enable_path_guiding", false);
+        }
+
+        PTLightingEngineFactory* pt_lighting_engine_factory =
             new PTLightingEngineFactory(
+                m_scene,
                 *m_backward_light_sampler,
                 m_project.get_light_path_recorder(),
-                get_child_and_inherit_globals(m_params, "pt")));    // todo: change to "pt_lighting_engine"?
+                pt_params);
+
+        m_lighting_engine_factory.reset(pt_lighting_engine_factory);
+
+        if (m_backward_light_sampler->has_importance_cache() ||
+            pt_lighting_engine_factory->has_path_guiding())
+        {
+            m_pass_callback.reset(
+                new PTPassCallback(
+                    *m_backward_light_sampler,
+                    *pt_lighting_engine_factory));
+        }
 
         return true;
     }
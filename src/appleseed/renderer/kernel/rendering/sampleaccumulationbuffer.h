@@ -39,6 +39,7 @@
 
 // Forward declarations.
 namespace foundation    { class IAbortSwitch; }
+namespace renderer      { class AdaptiveSamplingMap; }
 namespace renderer      { class Frame; }
 namespace renderer      { class Sample; }
 
@@ -69,6 +70,16 @@ class SampleAccumulationBuffer
         Frame&                      frame,
         foundation::IAbortSwitch&   abort_switch) = 0;
 
+    // Start collecting what update_sampling_map() needs to estimate the noise level of the buffer.
+    // Must be called before any sample is stored. The default implementation does nothing.
+    virtual void enable_noise_estimation();
+
+    // Estimate the noise level of the buffer and update an adaptive sampling map accordingly.
+    // Return false if the map was left untouched, which the default implementation does. Thread-safe.
+    virtual bool update_sampling_map(
+        AdaptiveSamplingMap&        map,
+        foundation::IAbortSwitch&   abort_switch);
+
   protected:
     boost::atomic<std::uint64_t> m_sample_count;
 };
@@ -83,4 +94,15 @@ inline std::uint64_t SampleAccumulationBuffer::get_sample_count() const
     return m_sample_count;
 }
 
+inline void SampleAccumulationBuffer::enable_noise_estimation()
+{
+}
+
+inline bool SampleAccumulationBuffer::update_sampling_map(
+    AdaptiveSamplingMap&            map,
+    foundation::IAbortSwitch&       abort_switch)
+{
+    return false;
+}
+
 }   // namespace renderer
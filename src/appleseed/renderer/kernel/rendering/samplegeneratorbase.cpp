@@ -57,7 +57,8 @@ namespace
 SampleGeneratorBase::SampleGeneratorBase(
     const size_t                generator_index,
     const size_t                generator_count)
-  : m_generator_index(generator_index)
+  : m_sampling_map(nullptr)
+  , m_generator_index(generator_index)
   , m_stride((generator_count - 1) * SampleBatchSize)
 {
     reset();
@@ -70,6 +71,11 @@ void SampleGeneratorBase::reset()
     m_invalid_sample_count = 0;
 }
 
+void SampleGeneratorBase::set_sampling_map(const AdaptiveSamplingMap* sampling_map)
+{
+    m_sampling_map = sampling_map;
+}
+
 void SampleGeneratorBase::generate_samples(
     const size_t                sample_count,
     SampleAccumulationBuffer&   buffer,
@@ -40,6 +40,7 @@
 
 // Forward declarations.
 namespace foundation    { class IAbortSwitch; }
+namespace renderer      { class AdaptiveSamplingMap; }
 namespace renderer      { class SampleAccumulationBuffer; }
 
 namespace renderer
@@ -60,6 +61,9 @@ class SampleGeneratorBase
     // Reset the sample generator to its initial state.
     void reset() override;
 
+    // Set the map according to which samples are distributed over the frame.
+    void set_sampling_map(const AdaptiveSamplingMap* sampling_map) override;
+
     // Generate a given number of samples and accumulate them into a buffer.
     void generate_samples(
         const size_t                sample_count,
@@ -69,6 +73,8 @@ class SampleGeneratorBase
   protected:
     typedef std::vector<Sample> SampleVector;
 
+    const AdaptiveSamplingMap*      m_sampling_map;
+
     // Generate one or multiple samples for a given sequence index and store them in 'samples'.
     // Return the number of samples that were stored.
     virtual size_t generate_samples(
@@ -38,6 +38,7 @@
 
 // appleseed.foundation headers.
 #include "foundation/math/basis.h"
+#include "foundation/math/bvh.h"
 #include "foundation/math/vector.h"
 
 // Standard headers.
@@ -50,9 +51,15 @@ namespace renderer
 //
 // Compute ambient occlusion at a given point in space.
 //
+// Ambient occlusion rays all start at the same point, so they are traced in small
+// packets that are culled together against the assembly tree.
+//
 // todo: implement optional computation of the mean unoccluded direction.
 //
 
+// Number of ambient occlusion rays traced at once (keeps the packet on the stack small).
+const size_t AmbientOcclusionPacketSize = 16;
+
 template <typename SamplingFunction>
 double compute_ambient_occlusion(
     const SamplingContext&  sampling_context,
@@ -79,26 +86,44 @@ double compute_ambient_occlusion(
     size_t computed_samples = 0;
     size_t occluded_samples = 0;
 
-    for (size_t i = 0; i < sample_count; ++i)
+    for (size_t i = 0; i < sample_count; )
     {
-        // Generate a direction over the unit hemisphere.
-        ray.m_dir = sampling_function(child_sampling_context.next2<foundation::Vector2d>());
+        ShadingRay rays[AmbientOcclusionPacketSize];
+        size_t ray_count = 0;
 
-        // Transform the direction to world space.
-        ray.m_dir = shading_basis.transform_to_parent(ray.m_dir);
+        for (; i < sample_count && ray_count < AmbientOcclusionPacketSize; ++i)
+        {
+            // Generate a direction over the unit hemisphere.
+            ray.m_dir = sampling_function(child_sampling_context.next2<foundation::Vector2d>());
 
-        // Don't cast rays on or below the geometric surface.
-        if (foundation::dot(ray.m_dir, geometric_normal) <= 0.0)
-            continue;
+            // Transform the direction to world space.
+            ray.m_dir = shading_basis.transform_to_parent(ray.m_dir);
+
+            // Don't cast rays on or below the geometric surface.
+            if (foundation::dot(ray.m_dir, geometric_normal) <= 0.0)
+                continue;
 
-        // Compute the ray origin.
-        ray.m_org = shading_point.get_point();
+            // Compute the ray origin.
+            ray.m_org = shading_point.get_point();
+
+            // Count the number of computed samples.
+            ++computed_samples;
+
+            rays[ray_count++] = ray;
+        }
+
+        if (ray_count == 0)
+            continue;
 
-        // Count the number of computed samples.
-        ++computed_samples;
+        // Trace the ambient occlusion rays and count the number of occluded samples.
+        foundation::bvh::PacketMask occluded_mask =
+            intersector.trace_probe_with_assembly_culling(
+                rays,
+                ray_count,
+                foundation::bvh::make_packet_mask(ray_count),
+                &shading_point);
 
-        // Trace the ambient occlusion ray and count the number of occluded samples.
-        if (intersector.trace_probe(ray, &shading_point))
+        for (; occluded_mask != 0; occluded_mask &= occluded_mask - 1)
             ++occluded_samples;
     }
 
@@ -38,6 +38,7 @@
 #include "renderer/modeling/shadergroup/shadergroup.h"
 
 // Standard headers.
+#include <algorithm>
 #include <cassert>
 
 using namespace foundation;
@@ -76,6 +77,42 @@ void OSLShaderGroupExec::execute_shading(
         shading_point.get_ray().m_flags);
 }
 
+bool OSLShaderGroupExec::supports_batched_execution()
+{
+    return false;
+}
+
+void OSLShaderGroupExec::execute_shading_batch(
+    BatchEntry*                     entries,
+    const size_t                    count) const
+{
+    // Make the shading points that share a shader group contiguous.
+    std::stable_sort(
+        entries,
+        entries + count,
+        [](const BatchEntry& lhs, const BatchEntry& rhs)
+        {
+            return lhs.m_shader_group < rhs.m_shader_group;
+        });
+
+    // Execute each shader group on all its shading points in a row.
+    for (size_t begin = 0, end; begin < count; begin = end)
+    {
+        const ShaderGroup* shader_group = entries[begin].m_shader_group;
+
+        end = begin + 1;
+        while (end < count && entries[end].m_shader_group == shader_group)
+            ++end;
+
+        if (shader_group == nullptr)
+            continue;
+
+        // Scalar fallback, see supports_batched_execution().
+        for (size_t i = begin; i < end; ++i)
+            execute_shading(*shader_group, *entries[i].m_shading_point);
+    }
+}
+
 void OSLShaderGroupExec::execute_subsurface(
     const ShaderGroup&              shader_group,
     const ShadingPoint&             shading_point) const
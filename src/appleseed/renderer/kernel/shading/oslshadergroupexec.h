@@ -43,6 +43,9 @@
 #include "OSL/oslversion.h"
 #include "foundation/platform/_endoslheaders.h"
 
+// Standard headers.
+#include <cstddef>
+
 // Forward declarations.
 namespace foundation    { class Arena; }
 namespace renderer      { class OSLShadingSystem; }
@@ -64,6 +67,18 @@ class OSLShaderGroupExec
 
     ~OSLShaderGroupExec();
 
+    // A shading point waiting for the execution of its surface shader group.
+    struct BatchEntry
+    {
+        const ShaderGroup*              m_shader_group;
+        const ShadingPoint*             m_shading_point;
+    };
+
+    // Return true if a shader group can be executed on several shading points at once.
+    // OSL's batched shading system requires batched renderer services, which appleseed
+    // does not implement yet: batches are always executed one shading point at a time.
+    static bool supports_batched_execution();
+
     foundation::Color3f execute_background(
         const ShaderGroup&              shader_group,
         const foundation::Vector3f&     outgoing) const;
@@ -77,14 +92,15 @@ class OSLShaderGroupExec
 
     OSL::PerThreadInfo*                 m_osl_thread_info;
     OSL::ShadingContext*                m_osl_shading_context;
-    char*                               m_osl_mem_pool;
-    char*                               m_osl_mem_pool_start;
-    mutable size_t                      m_osl_mem_used;
 
     void execute_shading(
         const ShaderGroup&              shader_group,
         const ShadingPoint&             shading_point) const;
 
+    void execute_shading_batch(
+        BatchEntry*                     entries,
+        const size_t                    count) const;
+
     void execute_subsurface(
         const ShaderGroup&              shader_group,
         const ShadingPoint&             shading_point) const;
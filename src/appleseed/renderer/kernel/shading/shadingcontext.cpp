@@ -94,6 +94,15 @@ void ShadingContext::execute_osl_shading(
         shading_point);
 }
 
+void ShadingContext::execute_osl_shading_batch(
+    OSLShaderGroupExec::BatchEntry* entries,
+    const size_t                    count) const
+{
+    m_shadergroup_exec.execute_shading_batch(
+        entries,
+        count);
+}
+
 void ShadingContext::execute_osl_subsurface(
     const ShaderGroup&      shader_group,
     const ShadingPoint&     shading_point) const
@@ -101,6 +101,13 @@ class ShadingContext
         const ShaderGroup&          shader_group,
         const ShadingPoint&         shading_point) const;
 
+    // Execute the OSL shader groups of a batch of shading points, grouping the shading
+    // points by shader group. Entries are reordered; entries without a shader group are
+    // skipped.
+    void execute_osl_shading_batch(
+        OSLShaderGroupExec::BatchEntry* entries,
+        const size_t                    count) const;
+
     void execute_osl_subsurface(
         const ShaderGroup&          shader_group,
         const ShadingPoint&         shading_point) const;
@@ -270,6 +270,7 @@ class ShadingPoint
     };
 
   private:
+    friend class AssemblyLeafPacketVisitor;
     friend class AssemblyLeafProbeVisitor;
     friend class AssemblyLeafVisitor;
     friend class CurveLeafVisitor;
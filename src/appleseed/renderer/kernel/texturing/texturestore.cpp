@@ -42,6 +42,7 @@
 #include "foundation/image/color.h"
 #include "foundation/image/colorspace.h"
 #include "foundation/image/tile.h"
+#include "foundation/math/scalar.h"
 #include "foundation/memory/memory.h"
 #include "foundation/platform/types.h"
 #include "foundation/string/string.h"
@@ -83,18 +84,176 @@ size_t TextureStore::get_default_size()
 TextureStore::TextureStore(
     const Scene&        scene,
     const ParamArray&   params)
-  : m_tile_swapper(scene, params)
-  , m_tile_cache(m_tile_key_hasher, m_tile_swapper)
+  : m_params(params)
+  , m_shard_mask(m_params.m_shard_count - 1)
 {
+    gather_assemblies(scene.assemblies());
+
+    m_shards.reserve(m_params.m_shard_count);
+
+    for (size_t i = 0; i < m_params.m_shard_count; ++i)
+    {
+        m_shards.push_back(
+            new Shard(
+                scene,
+                m_params,
+                m_assemblies,
+                m_memory_tracker,
+                m_tile_key_hasher));
+    }
+
+    print_settings();
+}
+
+TextureStore::~TextureStore()
+{
+    for (size_t i = 0, e = m_shards.size(); i < e; ++i)
+        delete m_shards[i];
 }
 
 StatisticsVector TextureStore::get_statistics() const
 {
-    Statistics stats = make_single_stage_cache_stats(m_tile_cache);
-    stats.insert_size("peak size", m_tile_swapper.get_peak_memory_size());
+    Statistics stats;
+    std::uint64_t lock_count = 0;
+    std::uint64_t contended_lock_count = 0;
+    std::uint64_t foreign_eviction_count = 0;
+
+    for (size_t i = 0, e = m_shards.size(); i < e; ++i)
+    {
+        const Shard& shard = *m_shards[i];
+        stats.merge(make_single_stage_cache_stats(shard.m_tile_cache));
+        lock_count += shard.m_lock_count;
+        contended_lock_count += shard.m_contended_lock_count;
+        foreign_eviction_count += shard.m_foreign_eviction_count;
+    }
+
+    stats.insert_size("peak size", m_memory_tracker.m_peak_memory_size);
+    stats.insert("shards", m_shards.size());
+    stats.insert_percent("contended lookups", contended_lock_count, lock_count);
+    stats.insert("cross-shard evictions", foreign_eviction_count);
+
     return StatisticsVector::make("texture store statistics", stats);
 }
 
+void TextureStore::gather_assemblies(const AssemblyContainer& assemblies)
+{
+    for (const Assembly& assembly : assemblies)
+    {
+        m_assemblies[assembly.get_uid()] = &assembly;
+        gather_assemblies(assembly.assemblies());
+    }
+}
+
+void TextureStore::print_settings() const
+{
+    RENDERER_LOG_INFO(
+        "texture store settings:\n"
+        "  max store size                %s\n"
+        "  shards                        %s\n"
+        "  track store size              %s\n"
+        "  track tile loading            %s\n"
+        "  track tile unloading          %s",
+        pretty_size(m_params.m_memory_limit).c_str(),
+        pretty_uint(m_params.m_shard_count).c_str(),
+        m_params.m_track_store_size ? "on" : "off",
+        m_params.m_track_tile_loading ? "on" : "off",
+        m_params.m_track_tile_unloading ? "on" : "off");
+}
+
+void TextureStore::evict_from_other_shards(const size_t shard_index)
+{
+    // Lock one shard at a time so that threads evicting concurrently never deadlock.
+    for (size_t i = 1, e = m_shards.size(); i < e; ++i)
+    {
+        Shard& shard = *m_shards[(shard_index + i) & m_shard_mask];
+
+        boost::mutex::scoped_lock lock(shard.m_mutex);
+
+        while (m_memory_tracker.m_memory_size > m_params.m_memory_limit)
+        {
+            if (!shard.m_tile_cache.evict())
+                break;
+
+            ++shard.m_foreign_eviction_count;
+        }
+
+        if (m_memory_tracker.m_memory_size <= m_params.m_memory_limit)
+            break;
+    }
+}
+
+
+//
+// TextureStore::Parameters class implementation.
+//
+
+namespace
+{
+    size_t get_shard_count(const ParamArray& params)
+    {
+        const size_t shard_count = params.get_optional<size_t>("shard_count", 16);
+        return next_pow2(std::max<size_t>(shard_count, 1));
+    }
+}
+
+TextureStore::Parameters::Parameters(const ParamArray& params)
+  : m_memory_limit(params.get_optional<size_t>("max_size", TextureStore::get_default_size()))
+  , m_shard_count(get_shard_count(params))
+  , m_track_tile_loading(params.get_optional<bool>("track_tile_loading", false))
+  , m_track_tile_unloading(params.get_optional<bool>("track_tile_unloading", false))
+  , m_track_store_size(params.get_optional<bool>("track_store_size", false))
+{
+    assert(m_memory_limit > 0);
+    assert(is_pow2(m_shard_count));
+}
+
+
+//
+// TextureStore::MemoryTracker class implementation.
+//
+
+TextureStore::MemoryTracker::MemoryTracker()
+  : m_memory_size(0)
+  , m_peak_memory_size(0)
+{
+}
+
+size_t TextureStore::MemoryTracker::add(const size_t tile_memory_size)
+{
+    const size_t memory_size = m_memory_size += tile_memory_size;
+
+    size_t peak_memory_size = m_peak_memory_size;
+    while (memory_size > peak_memory_size &&
+           !m_peak_memory_size.compare_exchange_weak(peak_memory_size, memory_size)) {}
+
+    return memory_size;
+}
+
+size_t TextureStore::MemoryTracker::remove(const size_t tile_memory_size)
+{
+    assert(m_memory_size >= tile_memory_size);
+    return m_memory_size -= tile_memory_size;
+}
+
+
+//
+// TextureStore::Shard class implementation.
+//
+
+TextureStore::Shard::Shard(
+    const Scene&        scene,
+    const Parameters&   params,
+    const AssemblyMap&  assemblies,
+    MemoryTracker&      memory_tracker,
+    TileKeyHasher&      tile_key_hasher)
+  : m_tile_swapper(scene, params, assemblies, memory_tracker)
+  , m_tile_cache(tile_key_hasher, m_tile_swapper)
+  , m_lock_count(0)
+  , m_contended_lock_count(0)
+  , m_foreign_eviction_count(0)
+{
+}
+
 
 //
 // TextureStore::TileSwapper class implementation.
@@ -163,40 +322,34 @@ namespace
 
 TextureStore::TileSwapper::TileSwapper(
     const Scene&        scene,
-    const ParamArray&   params)
+    const Parameters&   params,
+    const AssemblyMap&  assemblies,
+    MemoryTracker&      memory_tracker)
   : m_scene(scene)
   , m_params(params)
-  , m_memory_size(0)
-  , m_peak_memory_size(0)
+  , m_assemblies(assemblies)
+  , m_memory_tracker(memory_tracker)
 {
-    gather_assemblies(scene.assemblies());
-    print_settings();
 }
 
-void TextureStore::TileSwapper::print_settings() const
+Texture* TextureStore::TileSwapper::get_texture(const TileKey& key) const
 {
-    RENDERER_LOG_INFO(
-        "texture store settings:\n"
-        "  max store size                %s\n"
-        "  track store size              %s\n"
-        "  track tile loading            %s\n"
-        "  track tile unloading          %s",
-        pretty_size(m_params.m_memory_limit).c_str(),
-        m_params.m_track_store_size ? "on" : "off",
-        m_params.m_track_tile_loading ? "on" : "off",
-        m_params.m_track_tile_unloading ? "on" : "off");
+    // Fetch the texture container.
+    if (key.m_assembly_uid == ~UniqueID(0))
+        return m_scene.textures().get_by_uid(key.m_texture_uid);
+
+    // The assembly map is shared by all shards: don't use operator[] which may insert.
+    const AssemblyMap::const_iterator i = m_assemblies.find(key.m_assembly_uid);
+    assert(i != m_assemblies.end());
+
+    // Fetch the texture.
+    return i->second->textures().get_by_uid(key.m_texture_uid);
 }
 
 void TextureStore::TileSwapper::load(const TileKey& key, TileRecord& record)
 {
-    // Fetch the texture container.
-    const TextureContainer& textures =
-        key.m_assembly_uid == ~UniqueID(0)
-            ? m_scene.textures()
-            : m_assemblies[key.m_assembly_uid]->textures();
-
     // Fetch the texture.
-    Texture* texture = textures.get_by_uid(key.m_texture_uid);
+    Texture* texture = get_texture(key);
     assert(texture != nullptr);
 
     if (m_params.m_track_tile_loading)
@@ -231,26 +384,26 @@ void TextureStore::TileSwapper::load(const TileKey& key, TileRecord& record)
     }
 
     // Track the amount of memory used by the tile cache.
-    m_memory_size += record.m_tile_ptr.get_tile()->get_memory_size();
-    m_peak_memory_size = std::max(m_peak_memory_size, m_memory_size);
+    const size_t memory_size =
+        m_memory_tracker.add(record.m_tile_ptr.get_tile()->get_memory_size());
 
     if (m_params.m_track_store_size)
     {
-        if (m_memory_size > m_params.m_memory_limit)
+        if (memory_size > m_params.m_memory_limit)
         {
             RENDERER_LOG_DEBUG(
                 "texture store size is %s, exceeding capacity %s by %s.",
-                pretty_size(m_memory_size).c_str(),
+                pretty_size(memory_size).c_str(),
                 pretty_size(m_params.m_memory_limit).c_str(),
-                pretty_size(m_memory_size - m_params.m_memory_limit).c_str());
+                pretty_size(memory_size - m_params.m_memory_limit).c_str());
         }
         else
         {
             RENDERER_LOG_DEBUG(
                 "texture store size is %s, below capacity %s by %s.",
-                pretty_size(m_memory_size).c_str(),
+                pretty_size(memory_size).c_str(),
                 pretty_size(m_params.m_memory_limit).c_str(),
-                pretty_size(m_params.m_memory_limit - m_memory_size).c_str());
+                pretty_size(m_params.m_memory_limit - memory_size).c_str());
         }
     }
 }
@@ -262,20 +415,12 @@ bool TextureStore::TileSwapper::unload(const TileKey& key, TileRecord& record)
         return false;
 
     // Track the amount of memory used by the tile cache.
-    const size_t tile_memory_size = record.m_tile_ptr.get_tile()->get_memory_size();
-    assert(m_memory_size >= tile_memory_size);
-    m_memory_size -= tile_memory_size;
+    m_memory_tracker.remove(record.m_tile_ptr.get_tile()->get_memory_size());
 
     if (m_params.m_track_tile_unloading)
     {
-        // Fetch the texture container.
-        const TextureContainer& textures =
-            key.m_assembly_uid == ~UniqueID(0)
-            ? m_scene.textures()
-            : m_assemblies[key.m_assembly_uid]->textures();
-
         // Fetch the texture.
-        Texture* texture = textures.get_by_uid(key.m_texture_uid);
+        Texture* texture = get_texture(key);
 
         if (texture != nullptr)
         {
@@ -304,27 +449,4 @@ bool TextureStore::TileSwapper::unload(const TileKey& key, TileRecord& record)
     return true;
 }
 
-void TextureStore::TileSwapper::gather_assemblies(const AssemblyContainer& assemblies)
-{
-    for (const Assembly& assembly : assemblies)
-    {
-        m_assemblies[assembly.get_uid()] = &assembly;
-        gather_assemblies(assembly.assemblies());
-    }
-}
-
-
-//
-// TextureStore::TileSwapper::Parameters class implementation.
-//
-
-TextureStore::TileSwapper::Parameters::Parameters(const ParamArray& params)
-  : m_memory_limit(params.get_optional<size_t>("max_size", TextureStore::get_default_size()))
-  , m_track_tile_loading(params.get_optional<bool>("track_tile_loading", false))
-  , m_track_tile_unloading(params.get_optional<bool>("track_tile_unloading", false))
-  , m_track_store_size(params.get_optional<bool>("track_store_size", false))
-{
-    assert(m_memory_limit > 0);
-}
-
 }   // namespace renderer
@@ -41,17 +41,22 @@
 #include "foundation/utility/cache.h"
 #include "foundation/utility/uid.h"
 
+// Boost headers.
+#include "boost/atomic/atomic.hpp"
+
 // Standard headers.
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
 #include <map>
+#include <vector>
 
 // Forward declarations.
 namespace foundation    { class Dictionary; }
 namespace foundation    { class StatisticsVector; }
 namespace renderer      { class ParamArray; }
 namespace renderer      { class Scene; }
+namespace renderer      { class Texture; }
 
 namespace renderer
 {
@@ -59,6 +64,15 @@ namespace renderer
 //
 // A shared store for texture tiles (the backend of the thread-local texture cache).
 //
+// The store is split into a number of shards, selected by the hash of the tile key.
+// Each shard has its own lock and its own LRU cache, so that threads fetching tiles
+// from different shards (including threads loading tiles from disk) don't wait for
+// each other. The memory limit applies to the store as a whole: a shard evicts its
+// least recently used tiles as soon as the total size of the store exceeds the limit,
+// and if that is not enough (e.g. when most tiles live in other shards), tiles are
+// then evicted from the other shards. Only tiles currently in use may keep the store
+// above its limit.
+//
 
 class TextureStore
   : public foundation::NonCopyable
@@ -120,6 +134,9 @@ class TextureStore
         const Scene&        scene,
         const ParamArray&   params = ParamArray());
 
+    // Destructor.
+    ~TextureStore();
+
     // Acquire an element from the store. Thread-safe.
     TileRecord& acquire(const TileKey& key);
 
@@ -130,6 +147,32 @@ class TextureStore
     foundation::StatisticsVector get_statistics() const;
 
   private:
+    struct Parameters
+    {
+        const size_t    m_memory_limit;
+        const size_t    m_shard_count;
+        const bool      m_track_tile_loading;
+        const bool      m_track_tile_unloading;
+        const bool      m_track_store_size;
+
+        explicit Parameters(const ParamArray& params);
+    };
+
+    typedef std::map<foundation::UniqueID, const Assembly*> AssemblyMap;
+
+    // Memory usage of the store, shared by all shards.
+    struct MemoryTracker
+    {
+        boost::atomic<size_t>   m_memory_size;
+        boost::atomic<size_t>   m_peak_memory_size;
+
+        MemoryTracker();
+
+        // Account for a tile entering or leaving the store. Return the new size of the store.
+        size_t add(const size_t tile_memory_size);
+        size_t remove(const size_t tile_memory_size);
+    };
+
     class TileSwapper
       : public foundation::NonCopyable
     {
@@ -137,10 +180,9 @@ class TextureStore
         // Constructor.
         TileSwapper(
             const Scene&        scene,
-            const ParamArray&   params);
-
-        // Print tile swapper's settings.
-        void print_settings() const;
+            const Parameters&   params,
+            const AssemblyMap&  assemblies,
+            MemoryTracker&      memory_tracker);
 
         // Load a cache line.
         void load(const TileKey& key, TileRecord& record);
@@ -151,29 +193,13 @@ class TextureStore
         // Return true if the cache is full, false otherwise.
         bool is_full(const size_t element_count) const;
 
-        // Return the peak memory size in bytes of the tile cache.
-        size_t get_peak_memory_size() const;
-
       private:
-        struct Parameters
-        {
-            const size_t    m_memory_limit;
-            const bool      m_track_tile_loading;
-            const bool      m_track_tile_unloading;
-            const bool      m_track_store_size;
-
-            explicit Parameters(const ParamArray& params);
-        };
-
-        typedef std::map<foundation::UniqueID, const Assembly*> AssemblyMap;
-
         const Scene&        m_scene;
-        const Parameters    m_params;
-        size_t              m_memory_size;
-        size_t              m_peak_memory_size;
-        AssemblyMap         m_assemblies;
+        const Parameters&   m_params;
+        const AssemblyMap&  m_assemblies;
+        MemoryTracker&      m_memory_tracker;
 
-        void gather_assemblies(const AssemblyContainer& assemblies);
+        Texture* get_texture(const TileKey& key) const;
     };
 
     typedef foundation::LRUCache<
@@ -183,10 +209,36 @@ class TextureStore
         TileSwapper
     > TileCache;
 
-    boost::mutex            m_mutex;
+    struct Shard
+      : public foundation::NonCopyable
+    {
+        boost::mutex    m_mutex;
+        TileSwapper     m_tile_swapper;
+        TileCache       m_tile_cache;
+        std::uint64_t   m_lock_count;               // protected by m_mutex
+        std::uint64_t   m_contended_lock_count;     // protected by m_mutex
+        std::uint64_t   m_foreign_eviction_count;   // protected by m_mutex
+
+        Shard(
+            const Scene&        scene,
+            const Parameters&   params,
+            const AssemblyMap&  assemblies,
+            MemoryTracker&      memory_tracker,
+            TileKeyHasher&      tile_key_hasher);
+    };
+
+    const Parameters        m_params;
+    AssemblyMap             m_assemblies;
+    MemoryTracker           m_memory_tracker;
     TileKeyHasher           m_tile_key_hasher;
-    TileSwapper             m_tile_swapper;
-    TileCache               m_tile_cache;
+    std::vector<Shard*>     m_shards;
+    size_t                  m_shard_mask;
+
+    void gather_assemblies(const AssemblyContainer& assemblies);
+    void print_settings() const;
+
+    // Evict tiles from all shards but a given one until the store is back under its limit.
+    void evict_from_other_shards(const size_t shard_index);
 };
 
 
@@ -196,11 +248,29 @@ class TextureStore
 
 inline TextureStore::TileRecord& TextureStore::acquire(const TileKey& key)
 {
-    boost::mutex::scoped_lock lock(m_mutex);
+    // Use the high bits of the hash to select the shard, the low bits are used by the LRU cache's index.
+    const size_t shard_index = (m_tile_key_hasher(key) >> 16) & m_shard_mask;
+    Shard& shard = *m_shards[shard_index];
+
+    boost::mutex::scoped_lock lock(shard.m_mutex, boost::defer_lock);
 
-    TileRecord& record = m_tile_cache.get(key);
+    if (!lock.try_lock())
+    {
+        lock.lock();
+        ++shard.m_contended_lock_count;
+    }
+
+    ++shard.m_lock_count;
+
+    TileRecord& record = shard.m_tile_cache.get(key);
     foundation::atomic_inc(&record.m_owners);
 
+    lock.unlock();
+
+    // The record is now in use and cannot be evicted, even once the lock is released.
+    if (m_memory_tracker.m_memory_size > m_params.m_memory_limit)
+        evict_from_other_shards(shard_index);
+
     return record;
 }
 
@@ -312,12 +382,7 @@ inline size_t TextureStore::TileKeyHasher::operator()(const TileKey& key) const
 
 inline bool TextureStore::TileSwapper::is_full(const size_t element_count) const
 {
-    return m_memory_size >= m_params.m_memory_limit;
-}
-
-inline size_t TextureStore::TileSwapper::get_peak_memory_size() const
-{
-    return m_peak_memory_size;
+    return m_memory_tracker.m_memory_size >= m_params.m_memory_limit;
 }
 
 }   // namespace renderer
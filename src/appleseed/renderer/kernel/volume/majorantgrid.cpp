@@ -0,0 +1,313 @@
+
+//
+// This source file is part of appleseed.
+// Visit https://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2019 The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+// Interface header.
+#include "majorantgrid.h"
+
+// Standard headers.
+#include <algorithm>
+#include <string>
+
+using namespace foundation;
+using namespace std;
+
+namespace renderer
+{
+
+//
+// MajorantGrid class implementation.
+//
+
+MajorantGrid::MajorantGrid(
+    const VoxelGrid&    voxel_grid,
+    const size_t        density_channel_index,
+    const float         density_scale,
+    const size_t        base_cell_size)
+  : m_empty_cell_count(0)
+{
+    assert(density_channel_index < voxel_grid.get_channel_count());
+    assert(density_scale >= 0.0f);
+    assert(base_cell_size > 0);
+
+    build_finest_level(
+        voxel_grid,
+        density_channel_index,
+        density_scale,
+        base_cell_size);
+
+    build_coarser_levels();
+}
+
+MajorantGrid::MajorantGrid(
+    const SparseVoxelGrid&  voxel_grid,
+    const size_t            density_channel_index,
+    const float             density_scale)
+  : m_empty_cell_count(0)
+{
+    assert(density_channel_index < voxel_grid.get_channel_count());
+    assert(density_scale >= 0.0f);
+
+    build_finest_level(
+        voxel_grid,
+        density_channel_index,
+        density_scale);
+
+    build_coarser_levels();
+}
+
+size_t MajorantGrid::get_cell_count() const
+{
+    size_t cell_count = 0;
+
+    for (const Level& level : m_levels)
+        cell_count += level.m_bounds.size();
+
+    return cell_count;
+}
+
+size_t MajorantGrid::get_memory_size() const
+{
+    return
+          sizeof(*this)
+        + m_levels.capacity() * sizeof(Level)
+        + get_cell_count() * sizeof(Bounds);
+}
+
+StatisticsVector MajorantGrid::get_statistics() const
+{
+    const Level& finest_level = m_levels.front();
+
+    Statistics stats;
+    stats.insert(
+        "finest level",
+        to_string(finest_level.m_res[0]) + "x" +
+        to_string(finest_level.m_res[1]) + "x" +
+        to_string(finest_level.m_res[2]));
+    stats.insert("levels", m_levels.size());
+    stats.insert("cells", get_cell_count());
+    stats.insert_percent("empty cells", m_empty_cell_count, finest_level.m_bounds.size());
+    stats.insert("majorant", get_majorant());
+    stats.insert("minorant", get_minorant());
+    stats.insert_size("memory size", get_memory_size());
+
+    return StatisticsVector::make("majorant grid statistics", stats);
+}
+
+MajorantGrid::Level& MajorantGrid::create_finest_level(
+    const size_t        voxel_res[3],
+    const size_t        base_cell_size)
+{
+    m_levels.emplace_back();
+    Level& level = m_levels.back();
+
+    for (size_t i = 0; i < 3; ++i)
+    {
+        // Number of trilinear cells along this axis, as used by VoxelGrid::linear_lookup().
+        const size_t trilinear_cell_count = max<size_t>(voxel_res[i] - 1, 1);
+
+        level.m_res[i] = (trilinear_cell_count + base_cell_size - 1) / base_cell_size;
+        level.m_cell_size[i] = static_cast<double>(base_cell_size) / trilinear_cell_count;
+        level.m_rcp_cell_size[i] = 1.0 / level.m_cell_size[i];
+    }
+
+    level.m_bounds.resize(level.m_res[0] * level.m_res[1] * level.m_res[2]);
+
+    return level;
+}
+
+void MajorantGrid::build_finest_level(
+    const VoxelGrid&    voxel_grid,
+    const size_t        density_channel_index,
+    const float         density_scale,
+    const size_t        base_cell_size)
+{
+    const size_t voxel_res[3] =
+    {
+        voxel_grid.get_xres(),
+        voxel_grid.get_yres(),
+        voxel_grid.get_zres()
+    };
+
+    Level& level = create_finest_level(voxel_res, base_cell_size);
+
+    for (size_t z = 0, cell_index = 0; z < level.m_res[2]; ++z)
+    {
+        for (size_t y = 0; y < level.m_res[1]; ++y)
+        {
+            for (size_t x = 0; x < level.m_res[0]; ++x, ++cell_index)
+            {
+                // A block of trilinear cells is influenced by the voxels at both of its ends.
+                const size_t x0 = x * base_cell_size, x1 = min((x + 1) * base_cell_size, voxel_res[0] - 1);
+                const size_t y0 = y * base_cell_size, y1 = min((y + 1) * base_cell_size, voxel_res[1] - 1);
+                const size_t z0 = z * base_cell_size, z1 = min((z + 1) * base_cell_size, voxel_res[2] - 1);
+
+                float min_density = numeric_limits<float>::max();
+                float max_density = 0.0f;
+
+                for (size_t vz = z0; vz <= z1; ++vz)
+                {
+                    for (size_t vy = y0; vy <= y1; ++vy)
+                    {
+                        for (size_t vx = x0; vx <= x1; ++vx)
+                        {
+                            const float density = voxel_grid.voxel(vx, vy, vz)[density_channel_index];
+                            assert(density >= 0.0f);
+
+                            min_density = min(min_density, density);
+                            max_density = max(max_density, density);
+                        }
+                    }
+                }
+
+                Bounds& bounds = level.m_bounds[cell_index];
+                bounds.m_min = min_density * density_scale;
+                bounds.m_max = max_density * density_scale;
+
+                if (bounds.m_max == 0.0f)
+                    ++m_empty_cell_count;
+            }
+        }
+    }
+}
+
+void MajorantGrid::build_finest_level(
+    const SparseVoxelGrid&  voxel_grid,
+    const size_t            density_channel_index,
+    const float             density_scale)
+{
+    const size_t voxel_res[3] =
+    {
+        voxel_grid.get_xres(),
+        voxel_grid.get_yres(),
+        voxel_grid.get_zres()
+    };
+
+    const size_t BrickSize = SparseVoxelGrid::BrickSize;
+    Level& level = create_finest_level(voxel_res, BrickSize);
+
+    for (size_t z = 0, cell_index = 0; z < level.m_res[2]; ++z)
+    {
+        for (size_t y = 0; y < level.m_res[1]; ++y)
+        {
+            for (size_t x = 0; x < level.m_res[0]; ++x, ++cell_index)
+            {
+                // The trilinear cells of brick (x, y, z) also depend on the first
+                // voxels of the next bricks along each axis, when they exist.
+                const size_t bx1 = (x + 1) * BrickSize < voxel_res[0] ? x + 1 : x;
+                const size_t by1 = (y + 1) * BrickSize < voxel_res[1] ? y + 1 : y;
+                const size_t bz1 = (z + 1) * BrickSize < voxel_res[2] ? z + 1 : z;
+
+                float min_density = numeric_limits<float>::max();
+                float max_density = 0.0f;
+
+                for (size_t bz = z; bz <= bz1; ++bz)
+                {
+                    for (size_t by = y; by <= by1; ++by)
+                    {
+                        for (size_t bx = x; bx <= bx1; ++bx)
+                        {
+                            const size_t brick_index = voxel_grid.find_brick(bx, by, bz);
+
+                            if (brick_index == SparseVoxelGrid::InvalidBrick)
+                                min_density = 0.0f;
+                            else
+                            {
+                                assert(voxel_grid.get_brick_min(brick_index, density_channel_index) >= 0.0f);
+                                min_density = min(min_density, voxel_grid.get_brick_min(brick_index, density_channel_index));
+                                max_density = max(max_density, voxel_grid.get_brick_max(brick_index, density_channel_index));
+                            }
+                        }
+                    }
+                }
+
+                Bounds& bounds = level.m_bounds[cell_index];
+                bounds.m_min = min_density * density_scale;
+                bounds.m_max = max_density * density_scale;
+
+                if (bounds.m_max == 0.0f)
+                    ++m_empty_cell_count;
+            }
+        }
+    }
+}
+
+void MajorantGrid::build_coarser_levels()
+{
+    while (m_levels.back().m_res[0] > 1 ||
+           m_levels.back().m_res[1] > 1 ||
+           m_levels.back().m_res[2] > 1)
+    {
+        m_levels.emplace_back();
+
+        const Level& child_level = m_levels[m_levels.size() - 2];
+        Level& level = m_levels.back();
+
+        for (size_t i = 0; i < 3; ++i)
+        {
+            level.m_res[i] = (child_level.m_res[i] + 1) / 2;
+            level.m_cell_size[i] = 2.0 * child_level.m_cell_size[i];
+            level.m_rcp_cell_size[i] = 1.0 / level.m_cell_size[i];
+        }
+
+        level.m_bounds.resize(level.m_res[0] * level.m_res[1] * level.m_res[2]);
+
+        for (size_t z = 0, cell_index = 0; z < level.m_res[2]; ++z)
+        {
+            for (size_t y = 0; y < level.m_res[1]; ++y)
+            {
+                for (size_t x = 0; x < level.m_res[0]; ++x, ++cell_index)
+                {
+                    Bounds& bounds = level.m_bounds[cell_index];
+                    bounds.m_min = numeric_limits<float>::max();
+                    bounds.m_max = 0.0f;
+
+                    const size_t cz1 = min(2 * z + 1, child_level.m_res[2] - 1);
+                    const size_t cy1 = min(2 * y + 1, child_level.m_res[1] - 1);
+                    const size_t cx1 = min(2 * x + 1, child_level.m_res[0] - 1);
+
+                    for (size_t cz = 2 * z; cz <= cz1; ++cz)
+                    {
+                        for (size_t cy = 2 * y; cy <= cy1; ++cy)
+                        {
+                            for (size_t cx = 2 * x; cx <= cx1; ++cx)
+                            {
+                                const Bounds& child_bounds =
+                                    child_level.m_bounds[(cz * child_level.m_res[1] + cy) * child_level.m_res[0] + cx];
+
+                                bounds.m_min = min(bounds.m_min, child_bounds.m_min);
+                                bounds.m_max = max(bounds.m_max, child_bounds.m_max);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+}   // namespace renderer
@@ -0,0 +1,494 @@
+
+//
+// This source file is part of appleseed.
+// Visit https://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2019 The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+// appleseed.renderer headers.
+#include "renderer/global/globaltypes.h"
+#include "renderer/kernel/volume/sparsevoxelgrid.h"
+#include "renderer/kernel/volume/volume.h"
+
+// appleseed.foundation headers.
+#include "foundation/core/concepts/noncopyable.h"
+#include "foundation/math/aabb.h"
+#include "foundation/math/intersection/rayaabb.h"
+#include "foundation/math/ray.h"
+#include "foundation/math/scalar.h"
+#include "foundation/math/vector.h"
+#include "foundation/utility/statistics.h"
+
+// Standard headers.
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+namespace renderer
+{
+
+//
+// A hierarchy of conservative extinction bounds over a voxel grid.
+//
+// The finest level stores the minimum and maximum extinction over blocks of
+// base_cell_size^3 trilinear cells of the voxel grid, such that the bounds hold
+// for any value returned by VoxelGrid::linear_lookup(). Each coarser level halves
+// the resolution of the level below it, up to a single root cell.
+//
+// Rays are traversed in the unit cube space of the voxel grid with a hierarchical
+// 3D DDA: empty cells are skipped at the coarsest level they appear at, and a cell
+// is only refined when the gap between its majorant and its minorant would cause
+// too many null collisions over the segment of the ray that crosses it.
+//
+
+class MajorantGrid
+  : public foundation::NonCopyable
+{
+  public:
+    // Constructor. Extinction coefficients are the density channel times density_scale.
+    MajorantGrid(
+        const VoxelGrid&                voxel_grid,
+        const size_t                    density_channel_index,
+        const float                     density_scale = 1.0f,
+        const size_t                    base_cell_size = 4);
+
+    // Constructor. The finest level is built from the per-brick bounds of a sparse voxel
+    // grid, with one cell per brick, so that unallocated bricks are skipped entirely.
+    MajorantGrid(
+        const SparseVoxelGrid&          voxel_grid,
+        const size_t                    density_channel_index,
+        const float                     density_scale = 1.0f);
+
+    // Return the number of levels in the hierarchy.
+    size_t get_level_count() const;
+
+    // Return the total number of cells in the hierarchy.
+    size_t get_cell_count() const;
+
+    // Return the bounds of the extinction coefficient over the whole grid.
+    float get_minorant() const;
+    float get_majorant() const;
+
+    // Return the size in bytes of the hierarchy.
+    size_t get_memory_size() const;
+
+    foundation::StatisticsVector get_statistics() const;
+
+    // Visit the segments of a ray that cross cells of nonzero majorant, front to back.
+    // The ray is expressed in the unit cube space of the voxel grid and its direction
+    // must be unit-length. The visitor is invoked as visitor(t0, t1, minorant, majorant)
+    // and may return false to stop the traversal, in which case false is returned.
+    template <typename Visitor>
+    bool traverse(
+        const foundation::Ray3d&        ray,
+        Visitor&                        visitor) const;
+
+  private:
+    struct Bounds
+    {
+        float   m_min;
+        float   m_max;
+    };
+
+    struct Level
+    {
+        size_t                  m_res[3];
+        foundation::Vector3d    m_cell_size;            // in the unit cube
+        foundation::Vector3d    m_rcp_cell_size;
+        std::vector<Bounds>     m_bounds;
+    };
+
+    std::vector<Level>  m_levels;                       // finest level first
+    size_t              m_empty_cell_count;
+
+    Level& create_finest_level(
+        const size_t                    voxel_res[3],
+        const size_t                    base_cell_size);
+
+    void build_finest_level(
+        const VoxelGrid&                voxel_grid,
+        const size_t                    density_channel_index,
+        const float                     density_scale,
+        const size_t                    base_cell_size);
+
+    void build_finest_level(
+        const SparseVoxelGrid&          voxel_grid,
+        const size_t                    density_channel_index,
+        const float                     density_scale);
+
+    void build_coarser_levels();
+
+    template <typename Visitor>
+    bool traverse_level(
+        const size_t                    level_index,
+        const foundation::Ray3d&        ray,
+        const double                    tmin,
+        const double                    tmax,
+        const size_t                    cell_min[3],
+        const size_t                    cell_max[3],
+        Visitor&                        visitor) const;
+};
+
+
+//
+// Sample a free-flight distance along a ray with delta tracking, using the local
+// majorant of each segment returned by MajorantGrid::traverse(). Tentative collisions
+// below the local minorant are accepted without evaluating the extinction.
+//
+// The extinction function is invoked as extinction(point) with a point in the unit
+// cube space of the voxel grid and must not exceed the bounds stored in the grid.
+// Returns true and sets distance if a real collision occurs within the ray interval.
+//
+
+template <typename ExtinctionFunction>
+bool delta_tracking(
+    const MajorantGrid&                 grid,
+    const foundation::Ray3d&            ray,
+    ExtinctionFunction&                 extinction,
+    SamplingContext&                    sampling_context,
+    double&                             distance);
+
+
+//
+// Estimate the transmission along a ray with residual ratio tracking: the minorant
+// of each segment is integrated analytically and only the residual extinction is
+// tracked, so that homogeneous regions require no extinction evaluation at all.
+//
+
+template <typename ExtinctionFunction>
+float ratio_tracking(
+    const MajorantGrid&                 grid,
+    const foundation::Ray3d&            ray,
+    ExtinctionFunction&                 extinction,
+    SamplingContext&                    sampling_context);
+
+
+//
+// MajorantGrid class implementation.
+//
+
+inline size_t MajorantGrid::get_level_count() const
+{
+    return m_levels.size();
+}
+
+inline float MajorantGrid::get_minorant() const
+{
+    return m_levels.back().m_bounds[0].m_min;
+}
+
+inline float MajorantGrid::get_majorant() const
+{
+    return m_levels.back().m_bounds[0].m_max;
+}
+
+template <typename Visitor>
+bool MajorantGrid::traverse(
+    const foundation::Ray3d&            ray,
+    Visitor&                            visitor) const
+{
+    assert(foundation::is_normalized(ray.m_dir));
+
+    foundation::Ray3d clipped_ray(ray);
+    const foundation::RayInfo3d ray_info(clipped_ray);
+    const foundation::AABB3d unit_cube(
+        foundation::Vector3d(0.0),
+        foundation::Vector3d(1.0));
+
+    if (!foundation::clip(clipped_ray, ray_info, unit_cube))
+        return true;
+
+    const size_t root_cell[3] = { 0, 0, 0 };
+
+    return
+        traverse_level(
+            m_levels.size() - 1,
+            ray,
+            clipped_ray.m_tmin,
+            clipped_ray.m_tmax,
+            root_cell,
+            root_cell,
+            visitor);
+}
+
+template <typename Visitor>
+bool MajorantGrid::traverse_level(
+    const size_t                        level_index,
+    const foundation::Ray3d&            ray,
+    const double                        tmin,
+    const double                        tmax,
+    const size_t                        cell_min[3],
+    const size_t                        cell_max[3],
+    Visitor&                            visitor) const
+{
+    // Refine a cell when its bounds would cause more null collisions than this, on average.
+    const double RefinementThreshold = 1.0;
+
+    const Level& level = m_levels[level_index];
+    const foundation::Vector3d entry = ray.point_at(tmin);
+
+    size_t cell[3];
+    int step[3];
+    double t_next[3];
+    double t_delta[3];
+
+    for (size_t i = 0; i < 3; ++i)
+    {
+        // Find the cell containing the entry point, resolving ties in the direction of the ray.
+        const double c = entry[i] * level.m_rcp_cell_size[i];
+        double fc = std::floor(c);
+        if (fc == c && ray.m_dir[i] < 0.0)
+            fc -= 1.0;
+
+        const double clamped_fc =
+            foundation::clamp(fc, static_cast<double>(cell_min[i]), static_cast<double>(cell_max[i]));
+        cell[i] = static_cast<size_t>(clamped_fc);
+
+        if (ray.m_dir[i] > 0.0)
+        {
+            step[i] = +1;
+            t_next[i] = ((cell[i] + 1) * level.m_cell_size[i] - ray.m_org[i]) / ray.m_dir[i];
+            t_delta[i] = level.m_cell_size[i] / ray.m_dir[i];
+        }
+        else if (ray.m_dir[i] < 0.0)
+        {
+            step[i] = -1;
+            t_next[i] = (cell[i] * level.m_cell_size[i] - ray.m_org[i]) / ray.m_dir[i];
+            t_delta[i] = -level.m_cell_size[i] / ray.m_dir[i];
+        }
+        else
+        {
+            step[i] = 0;
+            t_next[i] = std::numeric_limits<double>::max();
+            t_delta[i] = std::numeric_limits<double>::max();
+        }
+    }
+
+    double t = tmin;
+
+    while (true)
+    {
+        const size_t axis =
+            t_next[0] < t_next[1]
+                ? (t_next[0] < t_next[2] ? 0 : 2)
+                : (t_next[1] < t_next[2] ? 1 : 2);
+
+        const double t_exit = std::min(t_next[axis], tmax);
+
+        if (t_exit > t)
+        {
+            const Bounds& bounds =
+                level.m_bounds[(cell[2] * level.m_res[1] + cell[1]) * level.m_res[0] + cell[0]];
+
+            if (bounds.m_max > 0.0f)
+            {
+                if (level_index > 0 &&
+                    (bounds.m_max - bounds.m_min) * (t_exit - t) > RefinementThreshold)
+                {
+                    const Level& child_level = m_levels[level_index - 1];
+
+                    size_t child_cell_min[3];
+                    size_t child_cell_max[3];
+
+                    for (size_t i = 0; i < 3; ++i)
+                    {
+                        child_cell_min[i] = 2 * cell[i];
+                        child_cell_max[i] = std::min(2 * cell[i] + 1, child_level.m_res[i] - 1);
+                    }
+
+                    if (!traverse_level(level_index - 1, ray, t, t_exit, child_cell_min, child_cell_max, visitor))
+                        return false;
+                }
+                else
+                {
+                    if (!visitor(t, t_exit, bounds.m_min, bounds.m_max))
+                        return false;
+                }
+            }
+        }
+
+        if (t_next[axis] >= tmax)
+            return true;
+
+        if (step[axis] > 0 ? cell[axis] == cell_max[axis] : cell[axis] == cell_min[axis])
+            return true;
+
+        t = t_exit;
+        cell[axis] += step[axis];
+        t_next[axis] += t_delta[axis];
+    }
+}
+
+
+//
+// Tracking estimators implementation.
+//
+
+namespace impl
+{
+    template <typename ExtinctionFunction>
+    struct DeltaTrackingVisitor
+    {
+        const foundation::Ray3d&    m_ray;
+        ExtinctionFunction&         m_extinction;
+        SamplingContext&            m_sampling_context;
+        double                      m_distance;
+
+        DeltaTrackingVisitor(
+            const foundation::Ray3d&    ray,
+            ExtinctionFunction&         extinction,
+            SamplingContext&            sampling_context)
+          : m_ray(ray)
+          , m_extinction(extinction)
+          , m_sampling_context(sampling_context)
+          , m_distance(-1.0)
+        {
+        }
+
+        bool operator()(
+            const double                t0,
+            const double                t1,
+            const float                 minorant,
+            const float                 majorant)
+        {
+            // Free-flight distances are memoryless: restart from the segment entry.
+            double t = t0;
+
+            while (true)
+            {
+                m_sampling_context.split_in_place(2, 1);
+                const foundation::Vector2f s = m_sampling_context.next2<foundation::Vector2f>();
+
+                t -= std::log(1.0 - static_cast<double>(s[0])) / majorant;
+                if (t >= t1)
+                    return true;
+
+                const float threshold = s[1] * majorant;
+
+                // The extinction is at least the minorant: the collision is real.
+                if (threshold < minorant)
+                {
+                    m_distance = t;
+                    return false;
+                }
+
+                if (threshold < m_extinction(m_ray.point_at(t)))
+                {
+                    m_distance = t;
+                    return false;
+                }
+            }
+        }
+    };
+
+    template <typename ExtinctionFunction>
+    struct RatioTrackingVisitor
+    {
+        const foundation::Ray3d&    m_ray;
+        ExtinctionFunction&         m_extinction;
+        SamplingContext&            m_sampling_context;
+        double                      m_transmission;
+
+        RatioTrackingVisitor(
+            const foundation::Ray3d&    ray,
+            ExtinctionFunction&         extinction,
+            SamplingContext&            sampling_context)
+          : m_ray(ray)
+          , m_extinction(extinction)
+          , m_sampling_context(sampling_context)
+          , m_transmission(1.0)
+        {
+        }
+
+        bool operator()(
+            const double                t0,
+            const double                t1,
+            const float                 minorant,
+            const float                 majorant)
+        {
+            // Control variate: the minorant part of the optical depth is known exactly.
+            m_transmission *= std::exp(-static_cast<double>(minorant) * (t1 - t0));
+
+            const double residual_majorant = static_cast<double>(majorant) - minorant;
+
+            if (residual_majorant > 0.0)
+            {
+                double t = t0;
+
+                while (true)
+                {
+                    m_sampling_context.split_in_place(1, 1);
+                    const float s = m_sampling_context.next2<float>();
+
+                    t -= std::log(1.0 - static_cast<double>(s)) / residual_majorant;
+                    if (t >= t1)
+                        break;
+
+                        const double residual = m_extinction(m_ray.point_at(t)) - minorant;
+                    m_transmission *= std::max(1.0 - residual / residual_majorant, 0.0);
+
+                    if (m_transmission == 0.0)
+                        return false;
+                }
+            }
+
+            return m_transmission > 0.0;
+        }
+    };
+}
+
+template <typename ExtinctionFunction>
+bool delta_tracking(
+    const MajorantGrid&                 grid,
+    const foundation::Ray3d&            ray,
+    ExtinctionFunction&                 extinction,
+    SamplingContext&                    sampling_context,
+    double&                             distance)
+{
+    impl::DeltaTrackingVisitor<ExtinctionFunction> visitor(ray, extinction, sampling_context);
+    if (grid.traverse(ray, visitor))
+        return false;
+
+    distance = visitor.m_distance;
+    return true;
+}
+
+template <typename ExtinctionFunction>
+float ratio_tracking(
+    const MajorantGrid&                 grid,
+    const foundation::Ray3d&            ray,
+    ExtinctionFunction&                 extinction,
+    SamplingContext&                    sampling_context)
+{
+    impl::RatioTrackingVisitor<ExtinctionFunction> visitor(ray, extinction, sampling_context);
+    grid.traverse(ray, visitor);
+
+    return static_cast<float>(visitor.m_transmission);
+}
+
+}   // namespace renderer
@@ -0,0 +1,457 @@
+
+//
+// This source file is part of appleseed.
+// Visit https://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2019 The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+// Interface header.
+#include "sparsevoxelgrid.h"
+
+// appleseed.foundation headers.
+#include "foundation/utility/cc.h"
+
+// Standard headers.
+#include <algorithm>
+#include <cstdio>
+#include <limits>
+#include <new>
+
+using namespace foundation;
+using namespace std;
+
+namespace renderer
+{
+
+//
+// SparseVoxelGrid class implementation.
+//
+
+const size_t SparseVoxelGrid::BrickLog2;
+const size_t SparseVoxelGrid::BrickSize;
+const size_t SparseVoxelGrid::BrickVoxelCount;
+const size_t SparseVoxelGrid::NodeLog2;
+const size_t SparseVoxelGrid::NodeSize;
+const size_t SparseVoxelGrid::NodeBrickCount;
+const size_t SparseVoxelGrid::InvalidBrick;
+
+SparseVoxelGrid::SparseVoxelGrid(
+    const size_t        nx,
+    const size_t        ny,
+    const size_t        nz,
+    const size_t        channel_count)
+  : m_nx(nx)
+  , m_ny(ny)
+  , m_nz(nz)
+  , m_max_x(static_cast<double>(nx - 1))
+  , m_max_y(static_cast<double>(ny - 1))
+  , m_max_z(static_cast<double>(nz - 1))
+  , m_channel_count(channel_count)
+  , m_zero_voxel(channel_count, 0.0f)
+{
+    assert(m_nx > 0);
+    assert(m_ny > 0);
+    assert(m_nz > 0);
+    assert(m_channel_count > 0);
+
+    const size_t NodeVoxelSize = BrickSize * NodeSize;
+
+    m_root_res[0] = (nx + NodeVoxelSize - 1) / NodeVoxelSize;
+    m_root_res[1] = (ny + NodeVoxelSize - 1) / NodeVoxelSize;
+    m_root_res[2] = (nz + NodeVoxelSize - 1) / NodeVoxelSize;
+
+    m_root.assign(m_root_res[0] * m_root_res[1] * m_root_res[2], 0);
+}
+
+SparseVoxelGrid::SparseVoxelGrid(const VoxelGrid& grid)
+  : SparseVoxelGrid(
+        grid.get_xres(),
+        grid.get_yres(),
+        grid.get_zres(),
+        grid.get_channel_count())
+{
+    const size_t brick_res[3] =
+    {
+        (m_nx + BrickSize - 1) / BrickSize,
+        (m_ny + BrickSize - 1) / BrickSize,
+        (m_nz + BrickSize - 1) / BrickSize
+    };
+
+    for (size_t bz = 0; bz < brick_res[2]; ++bz)
+    {
+        for (size_t by = 0; by < brick_res[1]; ++by)
+        {
+            for (size_t bx = 0; bx < brick_res[0]; ++bx)
+            {
+                const size_t x0 = bx * BrickSize, x1 = min(x0 + BrickSize, m_nx);
+                const size_t y0 = by * BrickSize, y1 = min(y0 + BrickSize, m_ny);
+                const size_t z0 = bz * BrickSize, z1 = min(z0 + BrickSize, m_nz);
+
+                // Skip bricks in which all voxels are zero.
+                bool empty = true;
+
+                for (size_t z = z0; empty && z < z1; ++z)
+                {
+                    for (size_t y = y0; empty && y < y1; ++y)
+                    {
+                        for (size_t x = x0; empty && x < x1; ++x)
+                        {
+                            const float* src = grid.voxel(x, y, z);
+
+                            for (size_t c = 0; c < m_channel_count; ++c)
+                            {
+                                if (src[c] != 0.0f)
+                                {
+                                    empty = false;
+                                    break;
+                                }
+                            }
+                        }
+                    }
+                }
+
+                if (empty)
+                    continue;
+
+                for (size_t z = z0; z < z1; ++z)
+                {
+                    for (size_t y = y0; y < y1; ++y)
+                    {
+                        for (size_t x = x0; x < x1; ++x)
+                        {
+                            const float* src = grid.voxel(x, y, z);
+                            float* dest = voxel(x, y, z);
+
+                            for (size_t c = 0; c < m_channel_count; ++c)
+                                dest[c] = src[c];
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    update_brick_bounds();
+}
+
+size_t SparseVoxelGrid::get_memory_size() const
+{
+    return
+          sizeof(*this)
+        + m_root.capacity() * sizeof(uint32_t)
+        + m_nodes.capacity() * sizeof(uint32_t)
+        + m_brick_coords.capacity() * sizeof(Vector3u)
+        + m_brick_voxels.capacity() * sizeof(float)
+        + m_brick_bounds.capacity() * sizeof(float)
+        + m_zero_voxel.capacity() * sizeof(float);
+}
+
+size_t SparseVoxelGrid::insert_brick(
+    const size_t        bx,
+    const size_t        by,
+    const size_t        bz)
+{
+    const size_t root_index =
+        ((bz >> NodeLog2) * m_root_res[1] + (by >> NodeLog2)) * m_root_res[0] + (bx >> NodeLog2);
+    assert(root_index < m_root.size());
+
+    if (m_root[root_index] == 0)
+    {
+        m_nodes.resize(m_nodes.size() + NodeBrickCount, 0);
+        m_root[root_index] = static_cast<uint32_t>(m_nodes.size() / NodeBrickCount);
+    }
+
+    const size_t NodeMask = NodeSize - 1;
+    uint32_t& brick =
+        m_nodes[
+            (m_root[root_index] - 1) * NodeBrickCount +
+            ((bz & NodeMask) * NodeSize + (by & NodeMask)) * NodeSize + (bx & NodeMask)];
+
+    if (brick == 0)
+    {
+        m_brick_coords.emplace_back(bx, by, bz);
+        m_brick_voxels.resize(m_brick_voxels.size() + BrickVoxelCount * m_channel_count, 0.0f);
+        m_brick_bounds.resize(m_brick_bounds.size() + 2 * m_channel_count, 0.0f);
+        brick = static_cast<uint32_t>(m_brick_coords.size());
+    }
+
+    return brick - 1;
+}
+
+void SparseVoxelGrid::update_brick_bounds()
+{
+    for (size_t brick_index = 0, e = m_brick_coords.size(); brick_index < e; ++brick_index)
+    {
+        const Vector3u& coords = m_brick_coords[brick_index];
+        const float* voxels = get_brick_voxels(brick_index);
+        float* bounds = &m_brick_bounds[brick_index * m_channel_count * 2];
+
+        for (size_t c = 0; c < m_channel_count; ++c)
+        {
+            bounds[c * 2] = numeric_limits<float>::max();
+            bounds[c * 2 + 1] = -numeric_limits<float>::max();
+        }
+
+        // Only consider the voxels that lie inside the grid.
+        const size_t x_count = min(BrickSize, m_nx - coords.x * BrickSize);
+        const size_t y_count = min(BrickSize, m_ny - coords.y * BrickSize);
+        const size_t z_count = min(BrickSize, m_nz - coords.z * BrickSize);
+
+        for (size_t z = 0; z < z_count; ++z)
+        {
+            for (size_t y = 0; y < y_count; ++y)
+            {
+                for (size_t x = 0; x < x_count; ++x)
+                {
+                    const float* src = voxels + ((z * BrickSize + y) * BrickSize + x) * m_channel_count;
+
+                    for (size_t c = 0; c < m_channel_count; ++c)
+                    {
+                        bounds[c * 2] = min(bounds[c * 2], src[c]);
+                        bounds[c * 2 + 1] = max(bounds[c * 2 + 1], src[c]);
+                    }
+                }
+            }
+        }
+    }
+}
+
+
+//
+// Sparse voxel grid I/O.
+//
+
+namespace
+{
+    const uint32_t SparseVoxelGridFileMagic = CC32('S', 'V', 'G', '1');
+    const uint32_t BrickChunkTag = CC32('B', 'R', 'C', 'K');
+    const uint32_t EndChunkTag = CC32('E', 'N', 'D', ' ');
+
+    // Limits on the header of a file. They bound the memory allocated before any brick
+    // is read (the root table is at most 128^3 entries) and keep chunk sizes in 32 bits.
+    const uint32_t MaxResolution = 1 << 14;     // in voxels, along each axis
+    const uint32_t MaxChannelCount = 64;
+
+    struct SparseVoxelGridFileHeader
+    {
+        uint32_t    m_magic;
+        uint32_t    m_xres;
+        uint32_t    m_yres;
+        uint32_t    m_zres;
+        uint32_t    m_channel_count;
+        uint32_t    m_brick_size;
+    };
+
+    struct ChunkHeader
+    {
+        uint32_t    m_tag;
+        uint32_t    m_size;
+    };
+
+    // Return the size in bytes of an open file, or 0 if it cannot be determined.
+    size_t get_file_size(FILE* file)
+    {
+        const long position = ftell(file);
+
+        if (position < 0 || fseek(file, 0, SEEK_END) != 0)
+            return 0;
+
+        const long size = ftell(file);
+
+        if (fseek(file, position, SEEK_SET) != 0 || size < 0)
+            return 0;
+
+        return static_cast<size_t>(size);
+    }
+
+    // Read the chunks following the header. remaining_size is the number of bytes left
+    // in the file: bricks are only allocated once the file is known to contain them.
+    bool read_bricks(
+        FILE*               file,
+        size_t              remaining_size,
+        SparseVoxelGrid&    grid)
+    {
+        const size_t brick_res[3] =
+        {
+            (grid.get_xres() + SparseVoxelGrid::BrickSize - 1) / SparseVoxelGrid::BrickSize,
+            (grid.get_yres() + SparseVoxelGrid::BrickSize - 1) / SparseVoxelGrid::BrickSize,
+            (grid.get_zres() + SparseVoxelGrid::BrickSize - 1) / SparseVoxelGrid::BrickSize
+        };
+
+        const size_t voxel_data_size =
+            SparseVoxelGrid::BrickVoxelCount * grid.get_channel_count() * sizeof(float);
+
+        while (true)
+        {
+            ChunkHeader chunk;
+            if (remaining_size < sizeof(ChunkHeader) ||
+                fread(&chunk, sizeof(ChunkHeader), 1, file) < 1)
+                return false;
+
+            remaining_size -= sizeof(ChunkHeader);
+
+            if (chunk.m_tag == EndChunkTag)
+                return true;
+
+            if (chunk.m_size > remaining_size)
+                return false;
+
+            remaining_size -= chunk.m_size;
+
+            if (chunk.m_tag != BrickChunkTag)
+            {
+                // Skip unknown chunks.
+                if (fseek(file, static_cast<long>(chunk.m_size), SEEK_CUR) != 0)
+                    return false;
+                continue;
+            }
+
+            if (chunk.m_size != 3 * sizeof(uint32_t) + voxel_data_size)
+                return false;
+
+            uint32_t coords[3];
+            if (fread(coords, sizeof(coords), 1, file) < 1)
+                return false;
+
+            if (coords[0] >= brick_res[0] || coords[1] >= brick_res[1] || coords[2] >= brick_res[2])
+                return false;
+
+            const size_t brick_index = grid.insert_brick(coords[0], coords[1], coords[2]);
+
+            if (fread(grid.get_brick_voxels(brick_index), voxel_data_size, 1, file) < 1)
+                return false;
+        }
+    }
+}
+
+unique_ptr<SparseVoxelGrid> read_sparse_voxel_grid_file(const char* filename)
+{
+    assert(filename);
+
+    FILE* file = fopen(filename, "rb");
+
+    if (file == nullptr)
+        return unique_ptr<SparseVoxelGrid>(nullptr);
+
+    // Read and check the file header. The file must at least hold the header and the end chunk.
+    const size_t file_size = get_file_size(file);
+    SparseVoxelGridFileHeader header;
+    if (file_size < sizeof(SparseVoxelGridFileHeader) + sizeof(ChunkHeader) ||
+        fread(&header, sizeof(SparseVoxelGridFileHeader), 1, file) < 1 ||
+        header.m_magic != SparseVoxelGridFileMagic ||
+        header.m_xres == 0 || header.m_xres > MaxResolution ||
+        header.m_yres == 0 || header.m_yres > MaxResolution ||
+        header.m_zres == 0 || header.m_zres > MaxResolution ||
+        header.m_channel_count == 0 || header.m_channel_count > MaxChannelCount ||
+        header.m_brick_size != SparseVoxelGrid::BrickSize)
+    {
+        fclose(file);
+        return unique_ptr<SparseVoxelGrid>(nullptr);
+    }
+
+    unique_ptr<SparseVoxelGrid> grid;
+    bool success;
+
+    try
+    {
+        grid.reset(
+            new SparseVoxelGrid(
+                header.m_xres,
+                header.m_yres,
+                header.m_zres,
+                header.m_channel_count));
+
+        success = read_bricks(file, file_size - sizeof(SparseVoxelGridFileHeader), *grid);
+    }
+    catch (const bad_alloc&)
+    {
+        success = false;
+    }
+
+    fclose(file);
+
+    if (!success)
+        return unique_ptr<SparseVoxelGrid>(nullptr);
+
+    grid->update_brick_bounds();
+
+    return grid;
+}
+
+bool write_sparse_voxel_grid_file(
+    const char*             filename,
+    const SparseVoxelGrid&  grid)
+{
+    assert(filename);
+
+    FILE* file = fopen(filename, "wb");
+
+    if (file == nullptr)
+        return false;
+
+    SparseVoxelGridFileHeader header;
+    header.m_magic = SparseVoxelGridFileMagic;
+    header.m_xres = static_cast<uint32_t>(grid.get_xres());
+    header.m_yres = static_cast<uint32_t>(grid.get_yres());
+    header.m_zres = static_cast<uint32_t>(grid.get_zres());
+    header.m_channel_count = static_cast<uint32_t>(grid.get_channel_count());
+    header.m_brick_size = static_cast<uint32_t>(SparseVoxelGrid::BrickSize);
+
+    bool success = fwrite(&header, sizeof(SparseVoxelGridFileHeader), 1, file) == 1;
+
+    const size_t voxel_data_size =
+        SparseVoxelGrid::BrickVoxelCount * grid.get_channel_count() * sizeof(float);
+
+    for (size_t i = 0, e = grid.get_brick_count(); success && i < e; ++i)
+    {
+        ChunkHeader chunk;
+        chunk.m_tag = BrickChunkTag;
+        chunk.m_size = static_cast<uint32_t>(3 * sizeof(uint32_t) + voxel_data_size);
+
+        const Vector3u& coords = grid.get_brick_coordinates(i);
+        const uint32_t brick_coords[3] =
+        {
+            static_cast<uint32_t>(coords.x),
+            static_cast<uint32_t>(coords.y),
+            static_cast<uint32_t>(coords.z)
+        };
+
+        success =
+            fwrite(&chunk, sizeof(ChunkHeader), 1, file) == 1 &&
+            fwrite(brick_coords, sizeof(brick_coords), 1, file) == 1 &&
+            fwrite(grid.get_brick_voxels(i), voxel_data_size, 1, file) == 1;
+    }
+
+    if (success)
+    {
+        ChunkHeader chunk;
+        chunk.m_tag = EndChunkTag;
+        chunk.m_size = 0;
+        success = fwrite(&chunk, sizeof(ChunkHeader), 1, file) == 1;
+    }
+
+    return fclose(file) == 0 && success;
+}
+
+}   // namespace renderer
@@ -0,0 +1,413 @@
+
+//
+// This source file is part of appleseed.
+// Visit https://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2019 The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+// appleseed.renderer headers.
+#include "renderer/kernel/volume/volume.h"
+
+// appleseed.foundation headers.
+#include "foundation/core/concepts/noncopyable.h"
+#include "foundation/math/scalar.h"
+#include "foundation/math/vector.h"
+#include "foundation/platform/compiler.h"
+
+// Standard headers.
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace renderer
+{
+
+//
+// A sparse voxel grid.
+//
+// Voxels are stored in dense bricks of BrickSize^3 voxels. Bricks are referenced
+// by internal nodes covering NodeSize^3 bricks, themselves referenced by a dense
+// root table. Only bricks containing nonzero voxels need to be allocated, so that
+// memory scales with the occupied region rather than with the bounding box; voxels
+// of unallocated bricks read as zero.
+//
+// Lookups follow the conventions of VoxelGrid: points are expressed in the unit
+// cube [0,1]^3 and the corner voxels lie on the faces of the cube.
+//
+
+class SparseVoxelGrid
+  : public foundation::NonCopyable
+{
+  public:
+    static const size_t BrickLog2 = 3;
+    static const size_t BrickSize = 1 << BrickLog2;                 // in voxels
+    static const size_t BrickVoxelCount = BrickSize * BrickSize * BrickSize;
+    static const size_t NodeLog2 = 4;
+    static const size_t NodeSize = 1 << NodeLog2;                   // in bricks
+    static const size_t NodeBrickCount = NodeSize * NodeSize * NodeSize;
+    static const size_t InvalidBrick = ~size_t(0);
+
+    // Constructor, creates an empty grid.
+    SparseVoxelGrid(
+        const size_t                nx,
+        const size_t                ny,
+        const size_t                nz,
+        const size_t                channel_count);
+
+    // Constructor, copies the bricks of a dense voxel grid that contain nonzero voxels.
+    explicit SparseVoxelGrid(const VoxelGrid& grid);
+
+    // Get the grid properties.
+    size_t get_xres() const;
+    size_t get_yres() const;
+    size_t get_zres() const;
+    size_t get_channel_count() const;
+
+    // Return the number of allocated bricks.
+    size_t get_brick_count() const;
+
+    // Return the size in bytes of the grid.
+    size_t get_memory_size() const;
+
+    // Return the index of the brick at given brick coordinates, or InvalidBrick if it is not allocated.
+    size_t find_brick(
+        const size_t                bx,
+        const size_t                by,
+        const size_t                bz) const;
+
+    // Return the index of the brick at given brick coordinates, allocating it if necessary.
+    size_t insert_brick(
+        const size_t                bx,
+        const size_t                by,
+        const size_t                bz);
+
+    // Access the properties and voxels of an allocated brick.
+    const foundation::Vector3u& get_brick_coordinates(const size_t brick_index) const;
+    float* get_brick_voxels(const size_t brick_index);
+    const float* get_brick_voxels(const size_t brick_index) const;
+
+    // Return the bounds of a channel over an allocated brick.
+    // Only valid after update_brick_bounds() was called.
+    float get_brick_min(const size_t brick_index, const size_t channel) const;
+    float get_brick_max(const size_t brick_index, const size_t channel) const;
+
+    // Recompute the bounds of all bricks. Must be called after voxels were modified.
+    void update_brick_bounds();
+
+    // Return a voxel, or nullptr if it belongs to an unallocated brick.
+    const float* find_voxel(
+        const size_t                x,
+        const size_t                y,
+        const size_t                z) const;
+
+    // Return a voxel, allocating its brick if necessary.
+    float* voxel(
+        const size_t                x,
+        const size_t                y,
+        const size_t                z);
+
+    // Perform a trilinearly interpolated lookup of the voxel grid.
+    // 'point' must be expressed in the unit cube [0,1]^3.
+    void linear_lookup(
+        const foundation::Vector3d& point,
+        float*                      values) const;
+
+  private:
+    const size_t                        m_nx;
+    const size_t                        m_ny;
+    const size_t                        m_nz;
+    const double                        m_max_x;
+    const double                        m_max_y;
+    const double                        m_max_z;
+    const size_t                        m_channel_count;
+    size_t                              m_root_res[3];
+    std::vector<std::uint32_t>          m_root;             // internal node index + 1, 0 if empty
+    std::vector<std::uint32_t>          m_nodes;            // brick index + 1, 0 if empty
+    std::vector<foundation::Vector3u>   m_brick_coords;
+    std::vector<float>                  m_brick_voxels;
+    std::vector<float>                  m_brick_bounds;     // min and max of each channel of each brick
+    std::vector<float>                  m_zero_voxel;
+
+    const float* get_voxel_or_zero(
+        const size_t                x,
+        const size_t                y,
+        const size_t                z) const;
+};
+
+
+//
+// Sparse voxel grid I/O.
+//
+// Files start with a header made of the magic number 'SVG1', the resolution of
+// the grid, the number of channels and the size of bricks, followed by a sequence
+// of chunks. Each chunk is made of a tag, the size in bytes of its payload and the
+// payload itself. 'BRCK' chunks contain the coordinates of a brick followed by its
+// voxels, x varying fastest, with channels interleaved; an 'END ' chunk terminates
+// the file. Chunks with unknown tags are skipped. All values are 32-bit and stored
+// in the native byte order.
+//
+
+// Read a sparse voxel grid file. Return nullptr if the file cannot be read or is invalid,
+// including when its header describes a grid larger than 16384 voxels along any axis or
+// with more than 64 channels.
+std::unique_ptr<SparseVoxelGrid> read_sparse_voxel_grid_file(const char* filename);
+
+// Write a sparse voxel grid file. Return false if the file cannot be written.
+bool write_sparse_voxel_grid_file(
+    const char*                     filename,
+    const SparseVoxelGrid&          grid);
+
+
+//
+// SparseVoxelGrid class implementation.
+//
+
+inline size_t SparseVoxelGrid::get_xres() const
+{
+    return m_nx;
+}
+
+inline size_t SparseVoxelGrid::get_yres() const
+{
+    return m_ny;
+}
+
+inline size_t SparseVoxelGrid::get_zres() const
+{
+    return m_nz;
+}
+
+inline size_t SparseVoxelGrid::get_channel_count() const
+{
+    return m_channel_count;
+}
+
+inline size_t SparseVoxelGrid::get_brick_count() const
+{
+    return m_brick_coords.size();
+}
+
+inline size_t SparseVoxelGrid::find_brick(
+    const size_t                    bx,
+    const size_t                    by,
+    const size_t                    bz) const
+{
+    const size_t root_index =
+        ((bz >> NodeLog2) * m_root_res[1] + (by >> NodeLog2)) * m_root_res[0] + (bx >> NodeLog2);
+    assert(root_index < m_root.size());
+
+    const std::uint32_t node = m_root[root_index];
+
+    if (node == 0)
+        return InvalidBrick;
+
+    const size_t NodeMask = NodeSize - 1;
+    const std::uint32_t brick =
+        m_nodes[
+            (node - 1) * NodeBrickCount +
+            ((bz & NodeMask) * NodeSize + (by & NodeMask)) * NodeSize + (bx & NodeMask)];
+
+    return brick == 0 ? InvalidBrick : brick - 1;
+}
+
+inline const foundation::Vector3u& SparseVoxelGrid::get_brick_coordinates(const size_t brick_index) const
+{
+    assert(brick_index < m_brick_coords.size());
+    return m_brick_coords[brick_index];
+}
+
+inline float* SparseVoxelGrid::get_brick_voxels(const size_t brick_index)
+{
+    assert(brick_index < m_brick_coords.size());
+    return &m_brick_voxels[brick_index * BrickVoxelCount * m_channel_count];
+}
+
+inline const float* SparseVoxelGrid::get_brick_voxels(const size_t brick_index) const
+{
+    assert(brick_index < m_brick_coords.size());
+    return &m_brick_voxels[brick_index * BrickVoxelCount * m_channel_count];
+}
+
+inline float SparseVoxelGrid::get_brick_min(const size_t brick_index, const size_t channel) const
+{
+    assert(channel < m_channel_count);
+    return m_brick_bounds[(brick_index * m_channel_count + channel) * 2];
+}
+
+inline float SparseVoxelGrid::get_brick_max(const size_t brick_index, const size_t channel) const
+{
+    assert(channel < m_channel_count);
+    return m_brick_bounds[(brick_index * m_channel_count + channel) * 2 + 1];
+}
+
+inline const float* SparseVoxelGrid::find_voxel(
+    const size_t                    x,
+    const size_t                    y,
+    const size_t                    z) const
+{
+    assert(x < m_nx);
+    assert(y < m_ny);
+    assert(z < m_nz);
+
+    const size_t brick_index = find_brick(x >> BrickLog2, y >> BrickLog2, z >> BrickLog2);
+
+    if (brick_index == InvalidBrick)
+        return nullptr;
+
+    const size_t BrickMask = BrickSize - 1;
+    const size_t voxel_index = ((z & BrickMask) * BrickSize + (y & BrickMask)) * BrickSize + (x & BrickMask);
+
+    return get_brick_voxels(brick_index) + voxel_index * m_channel_count;
+}
+
+inline float* SparseVoxelGrid::voxel(
+    const size_t                    x,
+    const size_t                    y,
+    const size_t                    z)
+{
+    assert(x < m_nx);
+    assert(y < m_ny);
+    assert(z < m_nz);
+
+    const size_t brick_index = insert_brick(x >> BrickLog2, y >> BrickLog2, z >> BrickLog2);
+
+    const size_t BrickMask = BrickSize - 1;
+    const size_t voxel_index = ((z & BrickMask) * BrickSize + (y & BrickMask)) * BrickSize + (x & BrickMask);
+
+    return get_brick_voxels(brick_index) + voxel_index * m_channel_count;
+}
+
+inline const float* SparseVoxelGrid::get_voxel_or_zero(
+    const size_t                    x,
+    const size_t                    y,
+    const size_t                    z) const
+{
+    const float* voxel = find_voxel(x, y, z);
+    return voxel != nullptr ? voxel : &m_zero_voxel[0];
+}
+
+inline void SparseVoxelGrid::linear_lookup(
+    const foundation::Vector3d&     point,
+    float* APPLESEED_RESTRICT       values) const
+{
+    // Compute the coordinates of the voxel containing the lookup point.
+    const double x = foundation::saturate(point.x) * m_max_x;
+    const double y = foundation::saturate(point.y) * m_max_y;
+    const double z = foundation::saturate(point.z) * m_max_z;
+    const size_t ix0 = foundation::truncate<size_t>(x);
+    const size_t iy0 = foundation::truncate<size_t>(y);
+    const size_t iz0 = foundation::truncate<size_t>(z);
+    const size_t ix1 = ix0 == m_nx - 1 ? ix0 : ix0 + 1;
+    const size_t iy1 = iy0 == m_ny - 1 ? iy0 : iy0 + 1;
+    const size_t iz1 = iz0 == m_nz - 1 ? iz0 : iz0 + 1;
+
+    // Compute interpolation weights.
+    const float x1 = static_cast<float>(x - ix0);
+    const float y1 = static_cast<float>(y - iy0);
+    const float z1 = static_cast<float>(z - iz0);
+    const float x0 = 1.0f - x1;
+    const float y0 = 1.0f - y1;
+    const float z0 = 1.0f - z1;
+    const float y0z0 = y0 * z0;
+    const float y1z0 = y1 * z0;
+    const float y0z1 = y0 * z1;
+    const float y1z1 = y1 * z1;
+    const float w000 = x0 * y0z0;
+    const float w100 = x1 * y0z0;
+    const float w010 = x0 * y1z0;
+    const float w110 = x1 * y1z0;
+    const float w001 = x0 * y0z1;
+    const float w101 = x1 * y0z1;
+    const float w011 = x0 * y1z1;
+    const float w111 = x1 * y1z1;
+
+    // Compute source pointers.
+    const float* APPLESEED_RESTRICT src000;
+    const float* APPLESEED_RESTRICT src100;
+    const float* APPLESEED_RESTRICT src010;
+    const float* APPLESEED_RESTRICT src110;
+    const float* APPLESEED_RESTRICT src001;
+    const float* APPLESEED_RESTRICT src101;
+    const float* APPLESEED_RESTRICT src011;
+    const float* APPLESEED_RESTRICT src111;
+
+    if ((ix0 >> BrickLog2) == (ix1 >> BrickLog2) &&
+        (iy0 >> BrickLog2) == (iy1 >> BrickLog2) &&
+        (iz0 >> BrickLog2) == (iz1 >> BrickLog2))
+    {
+        // Fast path: all eight voxels belong to the same brick.
+        const float* src = find_voxel(ix0, iy0, iz0);
+
+        if (src == nullptr)
+        {
+            for (size_t i = 0; i < m_channel_count; ++i)
+                values[i] = 0.0f;
+            return;
+        }
+
+        const size_t dx = (ix1 - ix0) * m_channel_count;
+        const size_t dy = (iy1 - iy0) * BrickSize * m_channel_count;
+        const size_t dz = (iz1 - iz0) * BrickSize * BrickSize * m_channel_count;
+
+        src000 = src;
+        src100 = src + dx;
+        src010 = src + dy;
+        src001 = src + dz;
+        src110 = src100 + dy;
+        src101 = src100 + dz;
+        src011 = src010 + dz;
+        src111 = src110 + dz;
+    }
+    else
+    {
+        src000 = get_voxel_or_zero(ix0, iy0, iz0);
+        src100 = get_voxel_or_zero(ix1, iy0, iz0);
+        src010 = get_voxel_or_zero(ix0, iy1, iz0);
+        src110 = get_voxel_or_zero(ix1, iy1, iz0);
+        src001 = get_voxel_or_zero(ix0, iy0, iz1);
+        src101 = get_voxel_or_zero(ix1, iy0, iz1);
+        src011 = get_voxel_or_zero(ix0, iy1, iz1);
+        src111 = get_voxel_or_zero(ix1, iy1, iz1);
+    }
+
+    // Blend.
+    for (size_t i = 0; i < m_channel_count; ++i)
+    {
+       *values++ =
+           *src000++ * w000 +
+           *src100++ * w100 +
+           *src010++ * w010 +
+           *src110++ * w110 +
+           *src001++ * w001 +
+           *src101++ * w101 +
+           *src011++ * w011 +
+           *src111++ * w111;
+    }
+}
+
+}   // namespace renderer
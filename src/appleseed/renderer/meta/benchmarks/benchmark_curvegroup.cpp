@@ -0,0 +1,145 @@
+
+//
+// This source file is part of appleseed.
+// Visit https://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2019 The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+// appleseed.renderer headers.
+#include "renderer/global/globaltypes.h"
+#include "renderer/kernel/intersection/curvegroup.h"
+#include "renderer/kernel/intersection/intersectionsettings.h"
+
+// appleseed.foundation headers.
+#include "foundation/image/color.h"
+#include "foundation/math/beziercurve.h"
+#include "foundation/math/rng/distribution.h"
+#include "foundation/math/rng/mersennetwister.h"
+#include "foundation/math/vector.h"
+#include "foundation/utility/benchmark.h"
+
+// Standard headers.
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+using namespace foundation;
+using namespace renderer;
+
+BENCHMARK_SUITE(Renderer_Kernel_Intersection_CurveGroup)
+{
+    // Leaves of a generated hair asset: groups of four neighboring strands, intersected
+    // by rays aimed at random strands, as the curve tree leaf visitors would do.
+    struct Fixture
+    {
+        static const size_t StrandCount = 4096;
+        static const size_t RayCount = 16;
+
+        std::vector<Curve3Type>                 m_curves;
+        std::vector<CurveGroup<Curve3Type>>     m_groups;
+        GRay3                                   m_rays[RayCount];
+        CurveMatrixType                         m_xfm[RayCount];
+        size_t                                  m_hit_count;
+
+        Fixture()
+          : m_hit_count(0)
+        {
+            MersenneTwister rng;
+
+            // Strands grow upward from a regular grid of roots, so that groups are spatially coherent.
+            const size_t Res = 64;
+
+            for (size_t i = 0; i < StrandCount; ++i)
+            {
+                GVector3 ctrl_pts[4];
+                ctrl_pts[0] =
+                    GVector3(
+                        (i % Res + rand_float1(rng)) / Res,
+                        0.0f,
+                        (i / Res + rand_float1(rng)) / Res);
+
+                for (size_t j = 1; j < 4; ++j)
+                {
+                    ctrl_pts[j] =
+                        ctrl_pts[j - 1] +
+                        GVector3(rand_float1(rng, -0.02f, 0.02f), 0.1f, rand_float1(rng, -0.02f, 0.02f));
+                }
+
+                m_curves.emplace_back(ctrl_pts, 0.002f, 1.0f, Color3f(1.0f));
+            }
+
+            m_groups.resize(StrandCount / 4);
+            for (size_t i = 0; i < m_groups.size(); ++i)
+                m_groups[i].set(&m_curves[4 * i], 4);
+
+            for (size_t i = 0; i < RayCount; ++i)
+            {
+                const Curve3Type& curve = m_curves[rand_int1(rng, 0, StrandCount - 1)];
+                const GVector3 target = curve.evaluate_point(rand_float1(rng));
+                const GVector3 org(rand_float1(rng, -1.0f, 2.0f), rand_float1(rng, 0.0f, 0.5f), -1.0f);
+
+                m_rays[i] = GRay3(org, target - org, 0.0f, 10.0f);
+                make_curve_projection_transform(m_xfm[i], m_rays[i]);
+            }
+        }
+    };
+
+    BENCHMARK_CASE_F(IntersectCurves_OneByOne, Fixture)
+    {
+        for (size_t r = 0; r < RayCount; ++r)
+        {
+            for (size_t i = 0; i < StrandCount; ++i)
+            {
+                GScalar u, v, t = m_rays[r].m_tmax;
+
+                if (Curve3IntersectorType::intersect(m_curves[i], m_rays[r], m_xfm[r], u, v, t))
+                    ++m_hit_count;
+            }
+        }
+    }
+
+    BENCHMARK_CASE_F(IntersectCurves_CulledFourAtATime, Fixture)
+    {
+        for (size_t r = 0; r < RayCount; ++r)
+        {
+            const GScalar tmax = m_rays[r].m_tmax * norm(m_rays[r].m_dir);
+
+            for (size_t g = 0; g < m_groups.size(); ++g)
+            {
+                const std::uint32_t mask = m_groups[g].cull(m_xfm[r], tmax);
+
+                for (size_t i = 0; i < 4; ++i)
+                {
+                    if ((mask & (1U << i)) == 0)
+                        continue;
+
+                    GScalar u, v, t = m_rays[r].m_tmax;
+
+                    if (Curve3IntersectorType::intersect(m_curves[4 * g + i], m_rays[r], m_xfm[r], u, v, t))
+                        ++m_hit_count;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,118 @@
+
+//
+// This source file is part of appleseed.
+// Visit https://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2019 The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+// appleseed.renderer headers.
+#include "renderer/kernel/rendering/globalsampleaccumulationbuffer.h"
+#include "renderer/kernel/rendering/sample.h"
+
+// appleseed.foundation headers.
+#include "foundation/image/color.h"
+#include "foundation/math/rng/distribution.h"
+#include "foundation/math/rng/mersennetwister.h"
+#include "foundation/math/vector.h"
+#include "foundation/platform/thread.h"
+#include "foundation/utility/job/abortswitch.h"
+#include "foundation/utility/benchmark.h"
+
+// Standard headers.
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+using namespace foundation;
+using namespace renderer;
+
+BENCHMARK_SUITE(Renderer_Kernel_Rendering_GlobalSampleAccumulationBuffer)
+{
+    // Light tracing splats samples all over the frame: store batches of samples
+    // at random pixels from a varying number of threads at once.
+    struct Fixture
+    {
+        static const size_t Width = 512;
+        static const size_t Height = 512;
+        static const size_t SamplesPerThread = 64 * 1024;
+
+        GlobalSampleAccumulationBuffer  m_buffer;
+        std::vector<Sample>             m_samples;
+        AbortSwitch                     m_abort_switch;
+
+        Fixture()
+          : m_buffer(Width, Height)
+        {
+            m_buffer.clear();
+
+            MersenneTwister rng;
+            m_samples.resize(SamplesPerThread);
+
+            for (size_t i = 0; i < SamplesPerThread; ++i)
+            {
+                m_samples[i].m_pixel_coords =
+                    Vector2i(
+                        rand_int1(rng, 0, Width - 1),
+                        rand_int1(rng, 0, Height - 1));
+                m_samples[i].m_color = Color4f(1.0f);
+            }
+        }
+
+        void store_samples(const size_t thread_count)
+        {
+            boost::thread_group threads;
+
+            for (size_t i = 0; i < thread_count; ++i)
+            {
+                threads.create_thread(
+                    [this]()
+                    {
+                        m_buffer.store_samples(m_samples.size(), &m_samples[0], m_abort_switch);
+                    });
+            }
+
+            threads.join_all();
+        }
+    };
+
+    BENCHMARK_CASE_F(StoreSamples_1Thread, Fixture)
+    {
+        store_samples(1);
+    }
+
+    BENCHMARK_CASE_F(StoreSamples_4Threads, Fixture)
+    {
+        store_samples(4);
+    }
+
+    BENCHMARK_CASE_F(StoreSamples_16Threads, Fixture)
+    {
+        store_samples(16);
+    }
+
+    BENCHMARK_CASE_F(StoreSamples_64Threads, Fixture)
+    {
+        store_samples(64);
+    }
+}
@@ -0,0 +1,220 @@
+
+//
+// This source file is part of appleseed.
+// Visit https://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2019 The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+// appleseed.renderer headers.
+#include "renderer/global/globaltypes.h"
+#include "renderer/kernel/lighting/backwardlightsampler.h"
+#include "renderer/kernel/lighting/lightsample.h"
+#include "renderer/kernel/shading/shadingpoint.h"
+#include "renderer/kernel/shading/shadingpointbuilder.h"
+#include "renderer/kernel/shading/shadingray.h"
+#include "renderer/modeling/edf/diffuseedf.h"
+#include "renderer/modeling/material/genericmaterial.h"
+#include "renderer/modeling/object/meshobject.h"
+#include "renderer/modeling/object/triangle.h"
+#include "renderer/modeling/scene/assembly.h"
+#include "renderer/modeling/scene/assemblyinstance.h"
+#include "renderer/modeling/scene/containers.h"
+#include "renderer/modeling/scene/objectinstance.h"
+#include "renderer/modeling/scene/scene.h"
+#include "renderer/modeling/scene/visibilityflags.h"
+#include "renderer/utility/paramarray.h"
+#include "renderer/utility/testutils.h"
+
+// appleseed.foundation headers.
+#include "foundation/containers/dictionary.h"
+#include "foundation/image/color.h"
+#include "foundation/math/basis.h"
+#include "foundation/math/rng/distribution.h"
+#include "foundation/math/rng/mersennetwister.h"
+#include "foundation/math/sampling/mappings.h"
+#include "foundation/math/transform.h"
+#include "foundation/math/vector.h"
+#include "foundation/memory/autoreleaseptr.h"
+#include "foundation/utility/benchmark.h"
+
+// Standard headers.
+#include <cstddef>
+#include <memory>
+
+using namespace foundation;
+using namespace renderer;
+
+BENCHMARK_SUITE(Renderer_Kernel_Lighting_LightTree)
+{
+    // A synthetic scene made of many small light-emitting triangles scattered in a unit cube.
+    struct ManyLightsScene
+      : public TestSceneBase
+    {
+        static const size_t LightCount = 100000;
+
+        ManyLightsScene()
+        {
+            create_color_entity("white", Color3f(1.0f));
+
+            auto_release_ptr<Assembly> assembly(AssemblyFactory().create("assembly"));
+
+            assembly->edfs().insert(
+                DiffuseEDFFactory().create(
+                    "edf",
+                    ParamArray().insert("radiance", "white")));
+
+            assembly->materials().insert(
+                GenericMaterialFactory().create(
+                    "material",
+                    ParamArray().insert("edf", "edf")));
+
+            auto_release_ptr<MeshObject> mesh_object(
+                MeshObjectFactory().create("lights", ParamArray()));
+
+            MersenneTwister rng;
+
+            for (size_t i = 0; i < LightCount; ++i)
+            {
+                Vector3f center;
+                center[0] = rand_float1(rng);
+                center[1] = rand_float1(rng);
+                center[2] = rand_float1(rng);
+
+                const float Size = 0.001f;
+                mesh_object->push_vertex(GVector3(center[0] - Size, center[1], center[2] - Size));
+                mesh_object->push_vertex(GVector3(center[0] + Size, center[1], center[2] - Size));
+                mesh_object->push_vertex(GVector3(center[0], center[1], center[2] + Size));
+                mesh_object->push_triangle(Triangle(3 * i + 0, 3 * i + 1, 3 * i + 2, 0));
+            }
+
+            mesh_object->push_material_slot("material");
+
+            auto_release_ptr<Object> object(mesh_object.release());
+            assembly->objects().insert(object);
+
+            StringDictionary material_mappings;
+            material_mappings.insert("material", "material");
+
+            assembly->object_instances().insert(
+                ObjectInstanceFactory::create(
+                    "lights_inst",
+                    ParamArray(),
+                    "lights",
+                    Transformd::identity(),
+                    material_mappings,
+                    material_mappings));
+
+            m_scene.assemblies().insert(assembly);
+
+            m_scene.assembly_instances().insert(
+                AssemblyInstanceFactory::create(
+                    "assembly_inst",
+                    ParamArray(),
+                    "assembly"));
+        }
+    };
+
+    struct Fixture
+      : public ManyLightsScene
+    {
+        static const size_t ShadingPointCount = 64;
+
+        TestSceneContext                        m_context;
+        std::unique_ptr<BackwardLightSampler>   m_light_sampler;
+        ShadingPoint                            m_shading_points[ShadingPointCount];
+        MersenneTwister                         m_rng;
+        float                                   m_dummy;
+
+        Fixture()
+          : m_context(*this)
+          , m_dummy(0.0f)
+        {
+            m_light_sampler.reset(
+                new BackwardLightSampler(
+                    m_scene,
+                    get_light_sampler_params()));
+
+            // Shading points with random positions and orientations in and around the lights.
+            for (size_t i = 0; i < ShadingPointCount; ++i)
+            {
+                Vector3d point;
+                point[0] = rand_double1(m_rng, -0.5, 1.5);
+                point[1] = rand_double1(m_rng, -0.5, 1.5);
+                point[2] = rand_double1(m_rng, -0.5, 1.5);
+
+                Vector2d s;
+                s[0] = rand_double1(m_rng);
+                s[1] = rand_double1(m_rng);
+                const Vector3d normal = sample_sphere_uniform(s);
+
+                ShadingPointBuilder builder(m_shading_points[i]);
+                builder.set_scene(&m_scene);
+                builder.set_ray(
+                    ShadingRay(
+                        point + normal,
+                        -normal,
+                        ShadingRay::Time(),
+                        VisibilityFlags::CameraRay,
+                        0));
+                builder.set_primitive_type(ShadingPoint::PrimitiveTriangle);
+                builder.set_distance(1.0);
+                builder.set_point(point);
+                builder.set_geometric_normal(normal);
+                builder.set_shading_basis(Basis3d(normal));
+                builder.set_side(ObjectInstance::FrontSide);
+            }
+        }
+
+        static ParamArray get_light_sampler_params()
+        {
+            return ParamArray().insert("algorithm", "lighttree");
+        }
+    };
+
+    BENCHMARK_CASE_F(BuildLightTree_100KEmittingTriangles, Fixture)
+    {
+        BackwardLightSampler light_sampler(m_scene, get_light_sampler_params());
+        m_dummy += static_cast<float>(light_sampler.has_lightset());
+    }
+
+    BENCHMARK_CASE_F(SampleLightTree_100KEmittingTriangles, Fixture)
+    {
+        for (size_t i = 0; i < ShadingPointCount; ++i)
+        {
+            Vector3f s;
+            s[0] = rand_float1(m_rng);
+            s[1] = rand_float1(m_rng);
+            s[2] = rand_float1(m_rng);
+
+            LightSample light_sample;
+            m_light_sampler->sample_lightset(
+                ShadingRay::Time(),
+                s,
+                m_shading_points[i],
+                light_sample);
+
+            m_dummy += light_sample.m_probability;
+        }
+    }
+}
@@ -0,0 +1,244 @@
+
+//
+// This source file is part of appleseed.
+// Visit https://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2019 The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+// appleseed.renderer headers.
+#include "renderer/kernel/texturing/texturestore.h"
+#include "renderer/modeling/input/texturesource.h"
+#include "renderer/modeling/scene/containers.h"
+#include "renderer/modeling/scene/scene.h"
+#include "renderer/modeling/texture/texture.h"
+#include "renderer/modeling/texture/tileptr.h"
+#include "renderer/utility/paramarray.h"
+
+// appleseed.foundation headers.
+#include "foundation/image/canvasproperties.h"
+#include "foundation/image/colorspace.h"
+#include "foundation/image/pixel.h"
+#include "foundation/image/tile.h"
+#include "foundation/log/log.h"
+#include "foundation/math/rng/distribution.h"
+#include "foundation/math/rng/mersennetwister.h"
+#include "foundation/memory/autoreleaseptr.h"
+#include "foundation/utility/benchmark.h"
+#include "foundation/utility/job.h"
+
+// Standard headers.
+#include <cstddef>
+#include <cstdint>
+
+using namespace foundation;
+using namespace renderer;
+
+BENCHMARK_SUITE(Renderer_Kernel_Texturing_TextureStore)
+{
+    // A texture made of many small tiles, loaded on demand.
+    class ProceduralTexture
+      : public Texture
+    {
+      public:
+        ProceduralTexture()
+          : Texture("procedural_texture", ParamArray())
+          , m_props(
+                TileCount * 16, TileCount * 16,
+                16, 16,
+                3,
+                PixelFormatFloat)
+        {
+        }
+
+        static const size_t TileCount = 64;
+
+        void release() override
+        {
+            delete this;
+        }
+
+        const char* get_model() const override
+        {
+            return "procedural_texture";
+        }
+
+        ColorSpace get_color_space() const override
+        {
+            return ColorSpaceLinearRGB;
+        }
+
+        const CanvasProperties& properties() override
+        {
+            return m_props;
+        }
+
+        Source* create_source(
+            const UniqueID          assembly_uid,
+            const TextureInstance&  texture_instance) override
+        {
+            return new TextureSource(assembly_uid, texture_instance);
+        }
+
+        TilePtr load_tile(
+            const size_t            tile_x,
+            const size_t            tile_y) override
+        {
+            return
+                TilePtr::make_owning(
+                    new Tile(
+                        m_props.m_tile_width,
+                        m_props.m_tile_height,
+                        m_props.m_channel_count,
+                        m_props.m_pixel_format));
+        }
+
+      private:
+        const CanvasProperties m_props;
+    };
+
+    // A job that fetches random tiles from the texture store.
+    class FetchTilesJob
+      : public IJob
+    {
+      public:
+        FetchTilesJob(
+            TextureStore&           texture_store,
+            const UniqueID          texture_uid,
+            const std::uint32_t     seed)
+          : m_texture_store(texture_store)
+          , m_texture_uid(texture_uid)
+          , m_seed(seed)
+        {
+        }
+
+        void execute(const size_t thread_index) override
+        {
+            MersenneTwister rng(m_seed);
+
+            for (size_t i = 0; i < 1000; ++i)
+            {
+                const std::int32_t max_tile = static_cast<std::int32_t>(ProceduralTexture::TileCount) - 1;
+                const size_t tile_x = static_cast<size_t>(rand_int1(rng, 0, max_tile));
+                const size_t tile_y = static_cast<size_t>(rand_int1(rng, 0, max_tile));
+
+                const TextureStore::TileKey key(~UniqueID(0), m_texture_uid, tile_x, tile_y);
+                TextureStore::TileRecord& record = m_texture_store.acquire(key);
+                m_texture_store.release(record);
+            }
+        }
+
+      private:
+        TextureStore&           m_texture_store;
+        const UniqueID          m_texture_uid;
+        const std::uint32_t     m_seed;
+    };
+
+    template <size_t ShardCount, size_t ThreadCount>
+    struct Fixture
+    {
+        auto_release_ptr<Scene>     m_scene;
+        UniqueID                    m_texture_uid;
+        TextureStore                m_texture_store;
+        Logger                      m_logger;
+        JobQueue                    m_job_queue;
+        JobManager                  m_job_manager;
+
+        Fixture()
+          : m_scene(create_scene(m_texture_uid))
+          , m_texture_store(
+                m_scene.ref(),
+                ParamArray()
+                    .insert("max_size", 1024 * 1024)    // smaller than the texture: forces evictions
+                    .insert("shard_count", ShardCount))
+          , m_job_manager(m_logger, m_job_queue, ThreadCount, JobManager::KeepRunningOnEmptyQueue)
+        {
+            m_job_manager.start();
+        }
+
+        static auto_release_ptr<Scene> create_scene(UniqueID& texture_uid)
+        {
+            auto_release_ptr<Scene> scene(SceneFactory::create());
+
+            auto_release_ptr<Texture> texture(new ProceduralTexture());
+            texture_uid = texture->get_uid();
+            scene->textures().insert(texture);
+
+            return scene;
+        }
+
+        void payload()
+        {
+            FetchTilesJob* jobs[ThreadCount * 4];
+
+            for (size_t i = 0; i < ThreadCount * 4; ++i)
+            {
+                jobs[i] =
+                    new FetchTilesJob(
+                        m_texture_store,
+                        m_texture_uid,
+                        static_cast<std::uint32_t>(i));
+                m_job_queue.schedule(jobs[i]);
+            }
+
+            m_job_queue.wait_until_completion();
+        }
+    };
+
+    typedef Fixture<1, 1> Fixture_1Shard_1Thread;
+    typedef Fixture<1, 8> Fixture_1Shard_8Threads;
+    typedef Fixture<16, 8> Fixture_16Shards_8Threads;
+    typedef Fixture<1, 32> Fixture_1Shard_32Threads;
+    typedef Fixture<16, 32> Fixture_16Shards_32Threads;
+    typedef Fixture<64, 32> Fixture_64Shards_32Threads;
+
+    BENCHMARK_CASE_F(FetchTiles_1Shard_1Thread, Fixture_1Shard_1Thread)
+    {
+        payload();
+    }
+
+    BENCHMARK_CASE_F(FetchTiles_1Shard_8Threads, Fixture_1Shard_8Threads)
+    {
+        payload();
+    }
+
+    BENCHMARK_CASE_F(FetchTiles_16Shards_8Threads, Fixture_16Shards_8Threads)
+    {
+        payload();
+    }
+
+    BENCHMARK_CASE_F(FetchTiles_1Shard_32Threads, Fixture_1Shard_32Threads)
+    {
+        payload();
+    }
+
+    BENCHMARK_CASE_F(FetchTiles_16Shards_32Threads, Fixture_16Shards_32Threads)
+    {
+        payload();
+    }
+
+    BENCHMARK_CASE_F(FetchTiles_64Shards_32Threads, Fixture_64Shards_32Threads)
+    {
+        payload();
+    }
+}
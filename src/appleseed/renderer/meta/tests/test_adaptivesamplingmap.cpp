@@ -0,0 +1,188 @@
+
+//
+// This source file is part of appleseed.
+// Visit https://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2019 The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+// appleseed.renderer headers.
+#include "renderer/kernel/rendering/adaptivesamplingmap.h"
+
+// appleseed.foundation headers.
+#include "foundation/image/accumulatortile.h"
+#include "foundation/math/aabb.h"
+#include "foundation/math/vector.h"
+#include "foundation/utility/iostreamop.h"
+#include "foundation/utility/test.h"
+
+// Standard headers.
+#include <cstddef>
+
+using namespace foundation;
+using namespace renderer;
+
+TEST_SUITE(Renderer_Kernel_Rendering_AdaptiveSamplingMap)
+{
+    // Fill a framebuffer with a given number of samples of a constant color per pixel.
+    void fill(
+        AccumulatorTile&    tile,
+        const size_t        sample_count,
+        const float         value)
+    {
+        const float values[4] = { value, value, value, 1.0f };
+
+        for (size_t y = 0; y < tile.get_height(); ++y)
+        {
+            for (size_t x = 0; x < tile.get_width(); ++x)
+            {
+                for (size_t i = 0; i < sample_count; ++i)
+                    tile.add(Vector2u(x, y), values);
+            }
+        }
+    }
+
+    struct Fixture
+    {
+        AABB2u              m_crop_window;
+        AdaptiveSamplingMap m_map;
+        AccumulatorTile     m_main;
+        AccumulatorTile     m_second;
+
+        Fixture()
+          : m_crop_window(Vector2u(0, 0), Vector2u(39, 19))
+          , m_map(m_crop_window, 16, 0.1f, 4)
+          , m_main(40, 20, 4)
+          , m_second(40, 20, 4)
+        {
+            m_main.clear();
+            m_second.clear();
+        }
+    };
+
+    TEST_CASE_F(Constructor_CoversCropWindowWithBlocks, Fixture)
+    {
+        EXPECT_EQ(3 * 2, m_map.get_block_count());
+    }
+
+    TEST_CASE_F(Constructor_SamplesUniformly, Fixture)
+    {
+        EXPECT_FALSE(m_map.is_converged());
+        EXPECT_EQ(1.0f, m_map.get_sampling_probability(0, 0));
+        EXPECT_EQ(1.0f, m_map.get_sampling_probability(39, 19));
+    }
+
+    TEST_CASE_F(GetBlock_LastBlock_IsClippedToCropWindow, Fixture)
+    {
+        const AABB2u block = m_map.get_block(5);
+
+        EXPECT_EQ(Vector2u(32, 16), block.min);
+        EXPECT_EQ(Vector2u(39, 19), block.max);
+    }
+
+    TEST_CASE_F(SampleBlock_BeforeUpdate_WeightsBlocksByPixelCount, Fixture)
+    {
+        // Blocks are 16x16, 16x16, 8x16, 16x4, 16x4 and 8x4 pixels, 800 pixels in total.
+        EXPECT_EQ(0, m_map.sample_block(0.0f));
+        EXPECT_EQ(0, m_map.sample_block(0.31f));
+        EXPECT_EQ(1, m_map.sample_block(0.33f));
+        EXPECT_EQ(2, m_map.sample_block(0.65f));
+        EXPECT_EQ(5, m_map.sample_block(0.99f));
+    }
+
+    TEST_CASE_F(Update_NoiselessFrame_Converges, Fixture)
+    {
+        fill(m_main, 8, 1.0f);
+        fill(m_second, 4, 1.0f);
+
+        m_map.update(m_main, m_second);
+
+        EXPECT_TRUE(m_map.is_converged());
+        EXPECT_EQ(m_map.get_block_count(), m_map.get_converged_block_count());
+        EXPECT_EQ(0.0f, m_map.get_sampling_probability(20, 10));
+    }
+
+    TEST_CASE_F(Update_NotEnoughSamples_DoesNotConverge, Fixture)
+    {
+        fill(m_main, 2, 1.0f);
+        fill(m_second, 1, 1.0f);
+
+        m_map.update(m_main, m_second);
+
+        EXPECT_FALSE(m_map.is_converged());
+        EXPECT_EQ(0, m_map.get_converged_block_count());
+        EXPECT_EQ(1.0f, m_map.get_sampling_probability(20, 10));
+    }
+
+    TEST_CASE_F(Update_NoisyBlock_OnlyNoisyBlockIsSampled, Fixture)
+    {
+        fill(m_main, 8, 1.0f);
+        fill(m_second, 4, 1.0f);
+
+        // Make one pixel of the bottom right block noisy.
+        const float values[4] = { 4.0f, 4.0f, 4.0f, 1.0f };
+        m_main.add(Vector2u(35, 18), values);
+
+        m_map.update(m_main, m_second);
+
+        EXPECT_FALSE(m_map.is_converged());
+        EXPECT_EQ(m_map.get_block_count() - 1, m_map.get_converged_block_count());
+        EXPECT_EQ(0.0f, m_map.get_sampling_probability(0, 0));
+        EXPECT_EQ(1.0f, m_map.get_sampling_probability(32, 16));
+        EXPECT_EQ(1.0f, m_map.get_sampling_probability(39, 19));
+        EXPECT_EQ(5, m_map.sample_block(0.0f));
+        EXPECT_EQ(5, m_map.sample_block(0.5f));
+        EXPECT_EQ(5, m_map.sample_block(0.99f));
+    }
+
+    TEST_CASE_F(Update_BlocksWithDifferentNoiseLevels_SamplesNoisiestBlockMore, Fixture)
+    {
+        fill(m_main, 8, 1.0f);
+        fill(m_second, 4, 1.0f);
+
+        const float low_noise[4] = { 2.0f, 2.0f, 2.0f, 1.0f };
+        m_main.add(Vector2u(0, 0), low_noise);
+
+        const float high_noise[4] = { 8.0f, 8.0f, 8.0f, 1.0f };
+        m_main.add(Vector2u(39, 19), high_noise);
+
+        m_map.update(m_main, m_second);
+
+        EXPECT_LT(1.0f, m_map.get_sampling_probability(0, 0));
+        EXPECT_GT(0.0f, m_map.get_sampling_probability(0, 0));
+        EXPECT_EQ(1.0f, m_map.get_sampling_probability(39, 19));
+    }
+
+    TEST_CASE_F(Clear_AfterConvergence_SamplesUniformly, Fixture)
+    {
+        fill(m_main, 8, 1.0f);
+        fill(m_second, 4, 1.0f);
+        m_map.update(m_main, m_second);
+
+        m_map.clear();
+
+        EXPECT_FALSE(m_map.is_converged());
+        EXPECT_EQ(0, m_map.get_converged_block_count());
+        EXPECT_EQ(1.0f, m_map.get_sampling_probability(20, 10));
+    }
+}
@@ -0,0 +1,216 @@
+
+//
+// This source file is part of appleseed.
+// Visit https://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2019 The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+// appleseed.renderer headers.
+#include "renderer/modeling/frame/checkpointstore.h"
+
+// appleseed.foundation headers.
+#include "foundation/image/canvasproperties.h"
+#include "foundation/image/image.h"
+#include "foundation/image/pixel.h"
+#include "foundation/image/tile.h"
+#include "foundation/utility/test.h"
+
+// Boost headers.
+#include "boost/filesystem/operations.hpp"
+#include "boost/filesystem/path.hpp"
+
+// Standard headers.
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace bf = boost::filesystem;
+using namespace foundation;
+using namespace renderer;
+
+TEST_SUITE(Renderer_Modeling_Frame_CheckpointStore)
+{
+    void fill_tile(Tile& tile, const float value)
+    {
+        float* p = reinterpret_cast<float*>(tile.get_storage());
+        for (size_t i = 0, e = tile.get_pixel_count() * tile.get_channel_count(); i < e; ++i)
+            p[i] = value + static_cast<float>(i);
+    }
+
+    void fill_image(Image& image, const float value)
+    {
+        const CanvasProperties& props = image.properties();
+        for (size_t i = 0; i < props.m_tile_count; ++i)
+            fill_tile(image.tile(i % props.m_tile_count_x, i / props.m_tile_count_x), value + 1000.0f * i);
+    }
+
+    bool are_images_equal(const Image& lhs, const Image& rhs)
+    {
+        const CanvasProperties& props = lhs.properties();
+        for (size_t i = 0; i < props.m_tile_count; ++i)
+        {
+            const Tile& lhs_tile = lhs.tile(i % props.m_tile_count_x, i / props.m_tile_count_x);
+            const Tile& rhs_tile = rhs.tile(i % props.m_tile_count_x, i / props.m_tile_count_x);
+            if (std::memcmp(lhs_tile.get_storage(), rhs_tile.get_storage(), lhs_tile.get_size()) != 0)
+                return false;
+        }
+
+        return true;
+    }
+
+    struct Fixture
+    {
+        const std::string   m_path;
+        Image               m_image1;
+        Image               m_image2;
+
+        Fixture()
+          : m_path(bf::absolute("unit tests/outputs/test_checkpointstore/render.checkpoint").string())
+          , m_image1(80, 64, 32, 32, 4, PixelFormatFloat)
+          , m_image2(80, 64, 32, 32, 2, PixelFormatFloat)
+        {
+            bf::remove_all(bf::path(m_path).parent_path());
+            bf::create_directories(bf::path(m_path).parent_path());
+
+            fill_image(m_image1, 1.0f);
+            fill_image(m_image2, 2.0f);
+        }
+
+        static CheckpointStore::LayerVector make_layers(Image& image1, Image& image2)
+        {
+            CheckpointStore::LayerVector layers;
+            layers.push_back(CheckpointStore::Layer{ "layer1", &image1 });
+            layers.push_back(CheckpointStore::Layer{ "layer2", &image2 });
+            return layers;
+        }
+    };
+
+    TEST_CASE_F(Load_GivenSavedLayers_RestoresTilesAndPassIndex, Fixture)
+    {
+        {
+            CheckpointStore store(m_path);
+            store.save(make_layers(m_image1, m_image2), 0);
+            fill_tile(m_image1.tile(1, 1), 5.0f);
+            store.save(make_layers(m_image1, m_image2), 1);
+            ASSERT_TRUE(store.flush());
+        }
+
+        Image image1(80, 64, 32, 32, 4, PixelFormatFloat);
+        Image image2(80, 64, 32, 32, 2, PixelFormatFloat);
+        size_t pass_index = 0;
+        const bool success = CheckpointStore::load(m_path, make_layers(image1, image2), pass_index);
+
+        ASSERT_TRUE(success);
+        EXPECT_EQ(1, pass_index);
+        EXPECT_TRUE(are_images_equal(m_image1, image1));
+        EXPECT_TRUE(are_images_equal(m_image2, image2));
+    }
+
+    TEST_CASE_F(Save_GivenSingleChangedTile_AppendsOnlyThisTile, Fixture)
+    {
+        CheckpointStore store(m_path);
+        store.save(make_layers(m_image1, m_image2), 0);
+        ASSERT_TRUE(store.flush());
+        const size_t initial_size = bf::file_size(m_path);
+
+        fill_tile(m_image2.tile(2, 0), 7.0f);
+        store.save(make_layers(m_image1, m_image2), 1);
+        ASSERT_TRUE(store.flush());
+        const size_t appended_size = bf::file_size(m_path) - initial_size;
+
+        // One tile record and one commit record, each with a 24-byte header.
+        EXPECT_EQ(m_image2.tile(2, 0).get_size() + 24 + 24 + 8, appended_size);
+        EXPECT_EQ(initial_size + appended_size, store.get_written_bytes());
+    }
+
+    TEST_CASE_F(Save_GivenAllTilesChangedRepeatedly_CompactsFile, Fixture)
+    {
+        CheckpointStore store(m_path);
+        store.save(make_layers(m_image1, m_image2), 0);
+        ASSERT_TRUE(store.flush());
+        const size_t initial_size = bf::file_size(m_path);
+
+        for (size_t pass = 1; pass < 6; ++pass)
+        {
+            fill_image(m_image1, static_cast<float>(pass));
+            store.save(make_layers(m_image1, m_image2), pass);
+        }
+
+        ASSERT_TRUE(store.flush());
+
+        EXPECT_LT(initial_size * 2, bf::file_size(m_path));
+    }
+
+    TEST_CASE_F(Load_GivenUncommittedTrailingRecords_ReturnsLastCommittedPass, Fixture)
+    {
+        Image saved_image1(m_image1);
+
+        {
+            CheckpointStore store(m_path);
+            store.save(make_layers(m_image1, m_image2), 0);
+            ASSERT_TRUE(store.flush());
+            fill_tile(m_image1.tile(0, 0), 9.0f);
+            store.save(make_layers(m_image1, m_image2), 1);
+        }
+
+        // Simulate a write interrupted before the commit record of the second pass.
+        bf::resize_file(m_path, bf::file_size(m_path) - 10);
+
+        Image image1(80, 64, 32, 32, 4, PixelFormatFloat);
+        Image image2(80, 64, 32, 32, 2, PixelFormatFloat);
+        size_t pass_index = 42;
+        const bool success = CheckpointStore::load(m_path, make_layers(image1, image2), pass_index);
+
+        ASSERT_TRUE(success);
+        EXPECT_EQ(0, pass_index);
+        EXPECT_TRUE(are_images_equal(saved_image1, image1));
+    }
+
+    TEST_CASE_F(Load_GivenDifferentLayers_ReturnsFalse, Fixture)
+    {
+        {
+            CheckpointStore store(m_path);
+            store.save(make_layers(m_image1, m_image2), 0);
+        }
+
+        Image image1(80, 64, 32, 32, 4, PixelFormatFloat);
+        Image image2(80, 64, 32, 32, 3, PixelFormatFloat);
+        size_t pass_index;
+        const bool success = CheckpointStore::load(m_path, make_layers(image1, image2), pass_index);
+
+        EXPECT_FALSE(success);
+    }
+
+    TEST_CASE_F(IsCheckpointStore, Fixture)
+    {
+        {
+            CheckpointStore store(m_path);
+            store.save(make_layers(m_image1, m_image2), 0);
+        }
+
+        EXPECT_TRUE(CheckpointStore::is_checkpoint_store(m_path));
+        EXPECT_FALSE(CheckpointStore::is_checkpoint_store(m_path + ".missing"));
+    }
+}
@@ -0,0 +1,151 @@
+
+//
+// This source file is part of appleseed.
+// Visit https://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2019 The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+// appleseed.renderer headers.
+#include "renderer/global/globaltypes.h"
+#include "renderer/kernel/intersection/curvegroup.h"
+#include "renderer/kernel/intersection/intersectionsettings.h"
+
+// appleseed.foundation headers.
+#include "foundation/image/color.h"
+#include "foundation/math/beziercurve.h"
+#include "foundation/math/rng/distribution.h"
+#include "foundation/math/rng/mersennetwister.h"
+#include "foundation/math/vector.h"
+#include "foundation/utility/test.h"
+
+// Standard headers.
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+using namespace foundation;
+using namespace renderer;
+
+TEST_SUITE(Renderer_Kernel_Intersection_CurveGroup)
+{
+    // A patch of slightly bent hair strands growing upward from the unit square.
+    std::vector<Curve3Type> make_hair(MersenneTwister& rng, const size_t strand_count)
+    {
+        std::vector<Curve3Type> curves;
+
+        for (size_t i = 0; i < strand_count; ++i)
+        {
+            GVector3 ctrl_pts[4];
+            ctrl_pts[0] = GVector3(rand_float1(rng), 0.0f, rand_float1(rng));
+
+            for (size_t j = 1; j < 4; ++j)
+            {
+                ctrl_pts[j] =
+                    ctrl_pts[j - 1] +
+                    GVector3(rand_float1(rng, -0.05f, 0.05f), 0.1f, rand_float1(rng, -0.05f, 0.05f));
+            }
+
+            curves.emplace_back(ctrl_pts, 0.01f, 1.0f, Color3f(1.0f));
+        }
+
+        return curves;
+    }
+
+    // A ray aimed at a random point of a random strand.
+    GRay3 make_ray(MersenneTwister& rng, const std::vector<Curve3Type>& curves)
+    {
+        const Curve3Type& curve = curves[rand_int1(rng, 0, static_cast<std::int32_t>(curves.size()) - 1)];
+        const GVector3 target = curve.evaluate_point(rand_float1(rng));
+        const GVector3 org(rand_float1(rng, -1.0f, 2.0f), rand_float1(rng, 0.0f, 0.5f), -1.0f);
+        return GRay3(org, target - org, 0.0f, 10.0f);
+    }
+
+    TEST_CASE(Cull_NeverRejectsCurvesHitByTheRay)
+    {
+        MersenneTwister rng;
+        const std::vector<Curve3Type> curves = make_hair(rng, 256);
+
+        std::vector<CurveGroup<Curve3Type>> groups(curves.size() / 4);
+        for (size_t i = 0; i < groups.size(); ++i)
+            groups[i].set(&curves[4 * i], 4);
+
+        size_t hit_count = 0;
+        size_t missed_by_cull = 0;
+        size_t culled_count = 0;
+
+        for (size_t r = 0; r < 100; ++r)
+        {
+            const GRay3 ray = make_ray(rng, curves);
+
+            CurveMatrixType xfm;
+            make_curve_projection_transform(xfm, ray);
+
+            const GScalar tmax = ray.m_tmax * norm(ray.m_dir);
+
+            for (size_t g = 0; g < groups.size(); ++g)
+            {
+                const std::uint32_t mask = groups[g].cull(xfm, tmax);
+
+                for (size_t i = 0; i < 4; ++i)
+                {
+                    const bool kept = (mask & (1U << i)) != 0;
+
+                    if (!kept)
+                        ++culled_count;
+
+                    if (Curve3IntersectorType::intersect(curves[4 * g + i], ray, xfm))
+                    {
+                        ++hit_count;
+
+                        if (!kept)
+                            ++missed_by_cull;
+                    }
+                }
+            }
+        }
+
+        EXPECT_GT(0, hit_count);
+        EXPECT_EQ(0, missed_by_cull);
+
+        // Most of the strands are far from any given ray.
+        EXPECT_GT(100 * curves.size() * 9 / 10, culled_count);
+    }
+
+    TEST_CASE(Cull_GivenPartialGroup_NeverReportsUnusedLanes)
+    {
+        MersenneTwister rng;
+        const std::vector<Curve3Type> curves = make_hair(rng, 3);
+
+        CurveGroup<Curve3Type> group;
+        group.set(&curves[0], 3);
+
+        // A ray along the y axis starting below the patch, that would see any curve at the origin.
+        const GRay3 ray(GVector3(0.0f, -1.0f, 0.0f), GVector3(0.0f, 1.0f, 0.0f), 0.0f, 10.0f);
+
+        CurveMatrixType xfm;
+        make_curve_projection_transform(xfm, ray);
+
+        EXPECT_EQ(0, group.cull(xfm, 10.0f) & 8);
+    }
+}
@@ -43,6 +43,9 @@
 #include "boost/filesystem/operations.hpp"
 #include "boost/filesystem/path.hpp"
 
+// Standard headers.
+#include <cstdint>
+
 namespace bf = boost::filesystem;
 using namespace foundation;
 using namespace renderer;
@@ -112,6 +115,19 @@ TEST_SUITE(Renderer_Modeling_Frame_Frame)
         EXPECT_TRUE(bf::exists(m_output_directory / "default-indirect-glossy.exr"));        // note: exr extension added
     }
 
+    TEST_CASE_F(WriteMainAndAOVImages_RecordsImageWriteStatisticsInRenderInfo, Fixture)
+    {
+        m_frame->write_main_and_aov_images();
+
+        const ParamArray& render_info = m_frame->render_info();
+        ASSERT_TRUE(render_info.strings().exist("image_write_size"));
+        EXPECT_TRUE(render_info.strings().exist("image_write_time"));
+        EXPECT_TRUE(render_info.strings().exist("image_write_throughput"));
+
+        // At least the main image: 64x64 pixels, 4 channels, 32-bit floats.
+        EXPECT_TRUE(render_info.get<std::uint64_t>("image_write_size") >= 64 * 64 * 4 * 4);
+    }
+
     TEST_CASE_F(WriteMainImage_FilenameHasEXRExtension_WritesEXRFile, Fixture)
     {
         m_frame->write_main_image((m_output_directory / "override.exr").string().c_str());
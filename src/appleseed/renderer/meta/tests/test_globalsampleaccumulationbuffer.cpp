@@ -0,0 +1,160 @@
+
+//
+// This source file is part of appleseed.
+// Visit https://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2019 The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+// appleseed.renderer headers.
+#include "renderer/kernel/rendering/globalsampleaccumulationbuffer.h"
+#include "renderer/kernel/rendering/sample.h"
+#include "renderer/modeling/frame/frame.h"
+#include "renderer/utility/paramarray.h"
+
+// appleseed.foundation headers.
+#include "foundation/image/color.h"
+#include "foundation/image/image.h"
+#include "foundation/image/tile.h"
+#include "foundation/math/vector.h"
+#include "foundation/memory/autoreleaseptr.h"
+#include "foundation/platform/thread.h"
+#include "foundation/utility/job/abortswitch.h"
+#include "foundation/utility/test.h"
+
+// Standard headers.
+#include <cstddef>
+#include <vector>
+
+using namespace foundation;
+using namespace renderer;
+
+TEST_SUITE(Renderer_Kernel_Rendering_GlobalSampleAccumulationBuffer)
+{
+    struct Fixture
+    {
+        auto_release_ptr<Frame>         m_frame;
+        GlobalSampleAccumulationBuffer  m_buffer;
+        AbortSwitch                     m_abort_switch;
+
+        Fixture()
+          : m_frame(
+                FrameFactory::create(
+                    "beauty",
+                    ParamArray()
+                        .insert("resolution", "64 64")
+                        .insert("tile_size", "32 32")))
+          , m_buffer(64, 64)
+        {
+            m_buffer.clear();
+        }
+
+        // Store one sample per pixel, with a color that depends on the pixel.
+        void store_one_sample_per_pixel()
+        {
+            std::vector<Sample> samples;
+
+            for (int y = 0; y < 64; ++y)
+            {
+                for (int x = 0; x < 64; ++x)
+                {
+                    Sample sample;
+                    sample.m_pixel_coords = Vector2i(x, y);
+                    sample.m_color = Color4f(x / 64.0f, y / 64.0f, 0.5f, 1.0f);
+                    samples.push_back(sample);
+                }
+            }
+
+            m_buffer.store_samples(samples.size(), &samples[0], m_abort_switch);
+        }
+
+        bool frame_has_one_sample_per_pixel() const
+        {
+            for (int y = 0; y < 64; ++y)
+            {
+                for (int x = 0; x < 64; ++x)
+                {
+                    Color4f color;
+                    m_frame->image().tile(x / 32, y / 32).get_pixel(x % 32, y % 32, color);
+
+                    if (!feq(color, Color4f(x / 64.0f, y / 64.0f, 0.5f, 1.0f), 1.0e-5f))
+                        return false;
+                }
+            }
+
+            return true;
+        }
+    };
+
+    TEST_CASE_F(DevelopToFrame_AfterStoringSamples_AveragesSamples, Fixture)
+    {
+        store_one_sample_per_pixel();
+        store_one_sample_per_pixel();
+        m_buffer.increment_sample_count(2);
+
+        m_buffer.develop_to_frame(m_frame.ref(), m_abort_switch);
+
+        EXPECT_TRUE(frame_has_one_sample_per_pixel());
+    }
+
+    TEST_CASE_F(DevelopToFrame_AfterStoringSamplesFromManyThreads_AveragesSamples, Fixture)
+    {
+        // Enough samples to trigger merges while samples are being stored.
+        const size_t ThreadCount = 8;
+        const size_t PassCount = 16;
+
+        boost::thread_group threads;
+
+        for (size_t i = 0; i < ThreadCount; ++i)
+        {
+            threads.create_thread(
+                [this]()
+                {
+                    for (size_t j = 0; j < PassCount; ++j)
+                        store_one_sample_per_pixel();
+                });
+        }
+
+        threads.join_all();
+
+        m_buffer.increment_sample_count(ThreadCount * PassCount);
+        m_buffer.develop_to_frame(m_frame.ref(), m_abort_switch);
+
+        EXPECT_TRUE(frame_has_one_sample_per_pixel());
+    }
+
+    TEST_CASE_F(Clear_DiscardsQueuedSamples, Fixture)
+    {
+        store_one_sample_per_pixel();
+        m_buffer.increment_sample_count(1);
+
+        m_buffer.clear();
+
+        store_one_sample_per_pixel();
+        m_buffer.increment_sample_count(1);
+        m_buffer.develop_to_frame(m_frame.ref(), m_abort_switch);
+
+        EXPECT_EQ(1, m_buffer.get_sample_count());
+        EXPECT_TRUE(frame_has_one_sample_per_pixel());
+    }
+}
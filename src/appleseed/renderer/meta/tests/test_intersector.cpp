@@ -47,6 +47,7 @@
 
 // appleseed.foundation headers.
 #include "foundation/containers/dictionary.h"
+#include "foundation/math/bvh.h"
 #include "foundation/math/matrix.h"
 #include "foundation/math/transform.h"
 #include "foundation/math/vector.h"
@@ -146,6 +147,55 @@ TEST_SUITE(Renderer_Kernel_Intersection_Intersector)
         EXPECT_FALSE(hit);
     }
 
+    TEST_CASE_F(TraceWithAssemblyCulling_GivenAssemblyContainingEmptyBoundingBoxAndRaysWithTMaxInsideAssembly_ReturnsEmptyMask, Fixture<false>)
+    {
+        ShadingRay rays[4];
+        for (size_t i = 0; i < 4; ++i)
+        {
+            rays[i] =
+                ShadingRay(
+                    Vector3d(0.25 * i, 0.0, 2.0),
+                    Vector3d(0.0, 0.0, -1.0),
+                    0.0,                        // tmin
+                    2.0,                        // tmax
+                    ShadingRay::Time(),
+                    VisibilityFlags::CameraRay,
+                    0);                         // depth
+        }
+
+        ShadingPoint shading_points[4];
+        const bvh::PacketMask hit_mask = m_intersector.trace_with_assembly_culling(rays, 4, shading_points, bvh::make_packet_mask(4));
+
+        EXPECT_EQ(0, hit_mask);
+
+        for (size_t i = 0; i < 4; ++i)
+        {
+            ShadingPoint shading_point;
+            EXPECT_EQ(m_intersector.trace(rays[i], shading_point), shading_points[i].hit_surface());
+        }
+    }
+
+    TEST_CASE_F(TraceProbeWithAssemblyCulling_GivenAssemblyContainingEmptyBoundingBoxAndRaysWithTMaxInsideAssembly_ReturnsEmptyMask, Fixture<false>)
+    {
+        ShadingRay rays[4];
+        for (size_t i = 0; i < 4; ++i)
+        {
+            rays[i] =
+                ShadingRay(
+                    Vector3d(0.25 * i, 0.0, 2.0),
+                    Vector3d(0.0, 0.0, -1.0),
+                    0.0,                        // tmin
+                    2.0,                        // tmax
+                    ShadingRay::Time(),
+                    VisibilityFlags::CameraRay,
+                    0);                         // depth
+        }
+
+        const bvh::PacketMask hit_mask = m_intersector.trace_probe_with_assembly_culling(rays, 4, bvh::make_packet_mask(4));
+
+        EXPECT_EQ(0, hit_mask);
+    }
+
 #ifdef APPLESEED_WITH_EMBREE
 
     TEST_CASE_F(Trace_Embree_GivenAssemblyContainingEmptyBoundingBoxAndRayWithTMaxInsideAssembly_ReturnsFalse, Fixture<true>)
@@ -27,7 +27,9 @@
 //
 
 // appleseed.renderer headers.
+#include "renderer/kernel/rendering/adaptivesamplingmap.h"
 #include "renderer/kernel/rendering/localsampleaccumulationbuffer.h"
+#include "renderer/kernel/rendering/sample.h"
 
 // appleseed.foundation headers.
 #include "foundation/image/accumulatortile.h"
@@ -43,6 +45,7 @@
 // Standard headers.
 #include <cstddef>
 #include <cstdint>
+#include <vector>
 
 using namespace foundation;
 using namespace renderer;
@@ -136,4 +139,44 @@ TEST_SUITE(Renderer_Kernel_Rendering_LocalSampleAccumulationBuffer)
             EXPECT_TRUE(honors_crop_window(crop_window));
         }
     }
+
+    TEST_CASE(UpdateSamplingMap_NoiseEstimationDisabled_ReturnsFalse)
+    {
+        LocalSampleAccumulationBuffer buffer(32, 32);
+        AdaptiveSamplingMap map(AABB2u(Vector2u(0, 0), Vector2u(31, 31)), 16, 0.1f, 4);
+        AbortSwitch abort_switch;
+
+        EXPECT_FALSE(buffer.update_sampling_map(map, abort_switch));
+    }
+
+    TEST_CASE(UpdateSamplingMap_NoiselessSamples_Converges)
+    {
+        LocalSampleAccumulationBuffer buffer(32, 32);
+        AdaptiveSamplingMap map(AABB2u(Vector2u(0, 0), Vector2u(31, 31)), 16, 0.1f, 4);
+        AbortSwitch abort_switch;
+
+        buffer.enable_noise_estimation();
+
+        std::vector<Sample> samples;
+        for (size_t i = 0; i < 32; ++i)
+        {
+            for (int y = 0; y < 32; ++y)
+            {
+                for (int x = 0; x < 32; ++x)
+                {
+                    Sample sample;
+                    sample.m_pixel_coords = Vector2i(x, y);
+                    sample.m_color = Color4f(0.5f, 0.5f, 0.5f, 1.0f);
+                    samples.push_back(sample);
+                }
+            }
+        }
+
+        buffer.store_samples(samples.size(), &samples[0], abort_switch);
+
+        EXPECT_FALSE(map.is_converged());
+
+        EXPECT_TRUE(buffer.update_sampling_map(map, abort_switch));
+        EXPECT_TRUE(map.is_converged());
+    }
 }
@@ -0,0 +1,292 @@
+
+//
+// This source file is part of appleseed.
+// Visit https://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2019 The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+// appleseed.renderer headers.
+#include "renderer/global/globaltypes.h"
+#include "renderer/kernel/volume/majorantgrid.h"
+#include "renderer/kernel/volume/sparsevoxelgrid.h"
+#include "renderer/kernel/volume/volume.h"
+
+// appleseed.foundation headers.
+#include "foundation/math/ray.h"
+#include "foundation/math/rng/distribution.h"
+#include "foundation/math/rng/mersennetwister.h"
+#include "foundation/math/sampling/mappings.h"
+#include "foundation/math/scalar.h"
+#include "foundation/math/vector.h"
+#include "foundation/utility/test.h"
+
+// Standard headers.
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+using namespace foundation;
+using namespace renderer;
+
+TEST_SUITE(Renderer_Kernel_Volume_MajorantGrid)
+{
+    struct Extinction
+    {
+        const VoxelGrid&    m_grid;
+        const float         m_density_scale;
+        mutable size_t      m_evaluation_count;
+
+        Extinction(const VoxelGrid& grid, const float density_scale)
+          : m_grid(grid)
+          , m_density_scale(density_scale)
+          , m_evaluation_count(0)
+        {
+        }
+
+        float operator()(const Vector3d& point) const
+        {
+            ++m_evaluation_count;
+
+            float density;
+            m_grid.linear_lookup(point, &density);
+            return density * m_density_scale;
+        }
+    };
+
+    struct Segment
+    {
+        double  m_t0;
+        double  m_t1;
+        float   m_minorant;
+        float   m_majorant;
+    };
+
+    struct SegmentCollector
+    {
+        std::vector<Segment> m_segments;
+
+        bool operator()(const double t0, const double t1, const float minorant, const float majorant)
+        {
+            const Segment segment = { t0, t1, minorant, majorant };
+            m_segments.push_back(segment);
+            return true;
+        }
+    };
+
+    // A sphere of density with a noisy interior, surrounded by empty space.
+    void make_cloud(VoxelGrid& grid, MersenneTwister& rng)
+    {
+        const Vector3d center(0.5);
+
+        for (size_t z = 0; z < grid.get_zres(); ++z)
+        {
+            for (size_t y = 0; y < grid.get_yres(); ++y)
+            {
+                for (size_t x = 0; x < grid.get_xres(); ++x)
+                {
+                    const Vector3d p(
+                        static_cast<double>(x) / (grid.get_xres() - 1),
+                        static_cast<double>(y) / (grid.get_yres() - 1),
+                        static_cast<double>(z) / (grid.get_zres() - 1));
+
+                    grid.voxel(x, y, z)[0] =
+                        norm(p - center) < 0.3
+                            ? rand_float1(rng, 1.0f, 4.0f)
+                            : 0.0f;
+                }
+            }
+        }
+    }
+
+    Ray3d make_random_ray(MersenneTwister& rng)
+    {
+        const Vector3d org = rand_vector1<Vector3d>(rng) * 1.4 - Vector3d(0.2);
+        const Vector3d dir = sample_sphere_uniform(rand_vector2<Vector2d>(rng));
+        return Ray3d(org, dir, 0.0, 2.0);
+    }
+
+    // Return true if the segments returned by the traversal bound the extinction and only skip empty space.
+    bool is_traversal_conservative(
+        const MajorantGrid&     grid,
+        const Extinction&       extinction,
+        MersenneTwister&        rng)
+    {
+        for (size_t i = 0; i < 200; ++i)
+        {
+            const Ray3d ray = make_random_ray(rng);
+
+            SegmentCollector collector;
+            grid.traverse(ray, collector);
+
+            for (size_t j = 1; j < collector.m_segments.size(); ++j)
+            {
+                if (collector.m_segments[j - 1].m_t1 > collector.m_segments[j].m_t0 + 1.0e-9)
+                    return false;
+            }
+
+            for (size_t j = 0; j < 100; ++j)
+            {
+                const double t = ray.m_tmin + (j + 0.5) / 100 * (ray.m_tmax - ray.m_tmin);
+                const Vector3d p = ray.point_at(t);
+
+                if (p.x < 0.0 || p.y < 0.0 || p.z < 0.0 || p.x > 1.0 || p.y > 1.0 || p.z > 1.0)
+                    continue;
+
+                const float value = extinction(p);
+
+                bool found = false;
+
+                for (const Segment& segment : collector.m_segments)
+                {
+                    if (t >= segment.m_t0 && t <= segment.m_t1)
+                    {
+                        if (value < segment.m_minorant * (1.0f - 1.0e-5f) ||
+                            value > segment.m_majorant * (1.0f + 1.0e-5f))
+                            return false;
+
+                        found = true;
+                        break;
+                    }
+                }
+
+                if (!found && value != 0.0f)
+                    return false;
+            }
+        }
+
+        return true;
+    }
+
+    TEST_CASE(Traverse_GivenCloud_SegmentsBoundInterpolatedExtinctionAndSkipOnlyEmptySpace)
+    {
+        MersenneTwister rng;
+
+        VoxelGrid voxel_grid(33, 25, 29, 1);
+        make_cloud(voxel_grid, rng);
+
+        const float DensityScale = 3.0f;
+        const MajorantGrid grid(voxel_grid, 0, DensityScale, 4);
+        const Extinction extinction(voxel_grid, DensityScale);
+
+        EXPECT_TRUE(is_traversal_conservative(grid, extinction, rng));
+    }
+
+    TEST_CASE(Traverse_GivenSparseCloud_SegmentsBoundInterpolatedExtinctionAndSkipOnlyEmptySpace)
+    {
+        MersenneTwister rng;
+
+        VoxelGrid voxel_grid(70, 41, 57, 1);
+        make_cloud(voxel_grid, rng);
+
+        const float DensityScale = 3.0f;
+        const SparseVoxelGrid sparse_voxel_grid(voxel_grid);
+        const MajorantGrid grid(sparse_voxel_grid, 0, DensityScale);
+        const Extinction extinction(voxel_grid, DensityScale);
+
+        EXPECT_TRUE(is_traversal_conservative(grid, extinction, rng));
+    }
+
+    TEST_CASE(Traverse_GivenEmptyGrid_VisitsNoSegment)
+    {
+        VoxelGrid voxel_grid(16, 16, 16, 1);
+        const MajorantGrid grid(voxel_grid, 0);
+
+        SegmentCollector collector;
+        grid.traverse(Ray3d(Vector3d(-1.0, 0.5, 0.5), Vector3d(1.0, 0.0, 0.0)), collector);
+
+        EXPECT_TRUE(collector.m_segments.empty());
+        EXPECT_EQ(0.0f, grid.get_majorant());
+    }
+
+    TEST_CASE(RatioTracking_GivenHomogeneousGrid_ReturnsExactTransmissionWithoutDensityEvaluation)
+    {
+        VoxelGrid voxel_grid(8, 8, 8, 1);
+
+        for (size_t z = 0; z < 8; ++z)
+        {
+            for (size_t y = 0; y < 8; ++y)
+            {
+                for (size_t x = 0; x < 8; ++x)
+                    voxel_grid.voxel(x, y, z)[0] = 2.0f;
+            }
+        }
+
+        const MajorantGrid grid(voxel_grid, 0);
+        Extinction extinction(voxel_grid, 1.0f);
+
+        SamplingContext::RNGType rng;
+        SamplingContext sampling_context(rng, SamplingContext::RNGMode);
+
+        const float transmission =
+            ratio_tracking(
+                grid,
+                Ray3d(Vector3d(-1.0, 0.5, 0.5), Vector3d(1.0, 0.0, 0.0)),
+                extinction,
+                sampling_context);
+
+        EXPECT_FEQ_EPS(std::exp(-2.0f), transmission, 1.0e-5f);
+        EXPECT_EQ(0, extinction.m_evaluation_count);
+    }
+
+    TEST_CASE(Tracking_GivenLinearGradient_ConvergesToAnalyticTransmission)
+    {
+        // Extinction grows linearly from 0 to 4 along x, so the optical depth along x is 2.
+        VoxelGrid voxel_grid(17, 5, 5, 1);
+
+        for (size_t z = 0; z < 5; ++z)
+        {
+            for (size_t y = 0; y < 5; ++y)
+            {
+                for (size_t x = 0; x < 17; ++x)
+                    voxel_grid.voxel(x, y, z)[0] = 4.0f * x / 16;
+            }
+        }
+
+        const MajorantGrid grid(voxel_grid, 0);
+        Extinction extinction(voxel_grid, 1.0f);
+        const Ray3d ray(Vector3d(0.0, 0.3, 0.7), Vector3d(1.0, 0.0, 0.0), 0.0, 1.0);
+
+        SamplingContext::RNGType rng;
+        SamplingContext sampling_context(rng, SamplingContext::RNGMode);
+
+        const size_t SampleCount = 20000;
+        double transmission_sum = 0.0;
+        size_t escaped_count = 0;
+
+        for (size_t i = 0; i < SampleCount; ++i)
+        {
+            transmission_sum +=
+                ratio_tracking(grid, ray, extinction, sampling_context);
+
+            double distance;
+            if (!delta_tracking(grid, ray, extinction, sampling_context, distance))
+                ++escaped_count;
+            else EXPECT_TRUE(distance >= 0.0 && distance < 1.0);
+        }
+
+        const double expected = std::exp(-2.0);
+        EXPECT_FEQ_EPS(expected, transmission_sum / SampleCount, 0.01);
+        EXPECT_FEQ_EPS(expected, static_cast<double>(escaped_count) / SampleCount, 0.05);
+    }
+}
@@ -0,0 +1,102 @@
+
+//
+// This source file is part of appleseed.
+// Visit https://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2019 The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+// appleseed.renderer headers.
+#include "renderer/kernel/rendering/noisethresholdrenderercontroller.h"
+#include "renderer/utility/paramarray.h"
+
+// appleseed.foundation headers.
+#include "foundation/math/vector.h"
+#include "foundation/utility/test.h"
+
+// Standard headers.
+#include <vector>
+
+using namespace foundation;
+using namespace renderer;
+
+TEST_SUITE(Renderer_Kernel_Rendering_NoiseThresholdRendererController)
+{
+    TEST_CASE(ExtrapolateTimeToNoiseLevel_NoRecord_ReturnsNegativeValue)
+    {
+        const std::vector<Vector2d> records;
+
+        EXPECT_LT(0.0, NoiseThresholdRendererController::extrapolate_time_to_noise_level(records, 0.1));
+    }
+
+    TEST_CASE(ExtrapolateTimeToNoiseLevel_SingleRecord_AssumesMonteCarloConvergenceRate)
+    {
+        std::vector<Vector2d> records;
+        records.emplace_back(1.0, 0.4);
+
+        // Halving the noise level takes four times as long.
+        EXPECT_FEQ(16.0, NoiseThresholdRendererController::extrapolate_time_to_noise_level(records, 0.1));
+    }
+
+    TEST_CASE(ExtrapolateTimeToNoiseLevel_NoiseInverselyProportionalToTime_FollowsFittedCurve)
+    {
+        std::vector<Vector2d> records;
+        records.emplace_back(1.0, 1.0);
+        records.emplace_back(2.0, 0.5);
+        records.emplace_back(4.0, 0.25);
+
+        EXPECT_FEQ(8.0, NoiseThresholdRendererController::extrapolate_time_to_noise_level(records, 0.125));
+    }
+
+    TEST_CASE(ExtrapolateTimeToNoiseLevel_NoiseNotDecreasing_AssumesMonteCarloConvergenceRate)
+    {
+        std::vector<Vector2d> records;
+        records.emplace_back(1.0, 0.4);
+        records.emplace_back(2.0, 0.4);
+
+        EXPECT_FEQ(32.0, NoiseThresholdRendererController::extrapolate_time_to_noise_level(records, 0.1));
+    }
+
+    TEST_CASE(ExtrapolateTimeToNoiseLevel_TargetAlreadyReached_ReturnsTimeOfLastRecord)
+    {
+        std::vector<Vector2d> records;
+        records.emplace_back(1.0, 0.4);
+        records.emplace_back(3.0, 0.05);
+
+        EXPECT_EQ(3.0, NoiseThresholdRendererController::extrapolate_time_to_noise_level(records, 0.1));
+    }
+
+    TEST_CASE(GetStatus_FrameConverged_TerminatesRendering)
+    {
+        ParamArray render_info;
+        NoiseThresholdRendererController controller(0.1f, render_info);
+        controller.on_frame_begin();
+
+        controller.record_noise_level(0.5f, false);
+        EXPECT_EQ(IRendererController::ContinueRendering, controller.get_status());
+
+        controller.record_noise_level(0.05f, true);
+        EXPECT_EQ(IRendererController::TerminateRendering, controller.get_status());
+        EXPECT_EQ(0.0, controller.get_time_to_noise_threshold());
+    }
+}
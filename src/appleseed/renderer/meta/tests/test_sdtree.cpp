@@ -0,0 +1,196 @@
+
+//
+// This source file is part of appleseed.
+// Visit https://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2019 The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+// appleseed.renderer headers.
+#include "renderer/kernel/lighting/sdtree.h"
+
+// appleseed.foundation headers.
+#include "foundation/math/aabb.h"
+#include "foundation/math/rng/distribution.h"
+#include "foundation/math/rng/mersennetwister.h"
+#include "foundation/math/sampling/mappings.h"
+#include "foundation/math/scalar.h"
+#include "foundation/math/vector.h"
+#include "foundation/utility/test.h"
+
+// Standard headers.
+#include <cmath>
+#include <cstddef>
+
+using namespace foundation;
+using namespace renderer;
+
+TEST_SUITE(Renderer_Kernel_Lighting_SDTree)
+{
+    struct Fixture
+    {
+        MersenneTwister m_rng;
+
+        Vector3f random_direction()
+        {
+            return sample_sphere_uniform(rand_vector2<Vector2f>(m_rng));
+        }
+
+        // Record a lobe of radiance around a given direction, and some radiance from all directions.
+        void record_radiance(DTree& dtree)
+        {
+            const Vector3f lobe_direction = normalize(Vector3f(0.3f, 0.2f, 1.0f));
+
+            for (size_t i = 0; i < 10000; ++i)
+                dtree.record(normalize(lobe_direction + 0.2f * random_direction()), 1.0f);
+
+            for (size_t i = 0; i < 1000; ++i)
+                dtree.record(random_direction(), 0.2f);
+        }
+
+        // Build a quadtree refined from a first round of recording, as done between training passes.
+        void build_trained_dtree(DTree& dtree)
+        {
+            DTree first_pass;
+            record_radiance(first_pass);
+
+            dtree.refine_from(first_pass, 0.01f, 20, 100000);
+            record_radiance(dtree);
+        }
+    };
+
+    TEST_CASE(IsValid_GivenNoRecordedRadiance_ReturnsFalse)
+    {
+        DTree dtree;
+
+        EXPECT_FALSE(dtree.is_valid());
+    }
+
+    TEST_CASE_F(RefineFrom_GivenConcentratedRadiance_SubdividesQuadtree, Fixture)
+    {
+        DTree first_pass;
+        record_radiance(first_pass);
+
+        DTree dtree;
+        dtree.refine_from(first_pass, 0.01f, 20, 100000);
+
+        EXPECT_GT(1, dtree.get_node_count());
+        EXPECT_FALSE(dtree.is_valid());
+    }
+
+    TEST_CASE_F(RefineFrom_HonorsMaxNodeCount, Fixture)
+    {
+        DTree first_pass;
+        record_radiance(first_pass);
+
+        DTree dtree;
+        dtree.refine_from(first_pass, 0.01f, 20, 8);
+
+        EXPECT_EQ(8, dtree.get_node_count());
+    }
+
+    TEST_CASE_F(EvaluatePdf_IntegratesToOneOverSphere, Fixture)
+    {
+        DTree dtree;
+        build_trained_dtree(dtree);
+
+        // Integrate over the cylindrical parameterization of the sphere, whose Jacobian is 4 * Pi.
+        const size_t N = 512;
+        double integral = 0.0;
+
+        for (size_t y = 0; y < N; ++y)
+        {
+            for (size_t x = 0; x < N; ++x)
+            {
+                const float cos_theta = 2.0f * (x + 0.5f) / N - 1.0f;
+                const float sin_theta = std::sqrt(1.0f - cos_theta * cos_theta);
+                const float phi = TwoPi<float>() * (y + 0.5f) / N;
+                const Vector3f direction(sin_theta * std::cos(phi), sin_theta * std::sin(phi), cos_theta);
+
+                integral += dtree.evaluate_pdf(direction);
+            }
+        }
+
+        integral *= FourPi<double>() / (N * N);
+
+        EXPECT_FEQ_EPS(1.0, integral, 1.0e-3);
+    }
+
+    TEST_CASE_F(Sample_ReturnsPdfMatchingEvaluatePdf, Fixture)
+    {
+        DTree dtree;
+        build_trained_dtree(dtree);
+
+        for (size_t i = 0; i < 1000; ++i)
+        {
+            float pdf;
+            const Vector3f direction = dtree.sample(rand_vector2<Vector2f>(m_rng), pdf);
+
+            EXPECT_FEQ_EPS(1.0f, norm(direction), 1.0e-4f);
+            EXPECT_FEQ_EPS(pdf, dtree.evaluate_pdf(direction), 1.0e-3f * pdf);
+        }
+    }
+
+    TEST_CASE_F(GetSamplingDTree_BeforeFirstUpdate_ReturnsNull, Fixture)
+    {
+        SDTree sd_tree(AABB3d(Vector3d(0.0), Vector3d(1.0)), 0.5f, 2, 1024 * 1024);
+        sd_tree.record(Vector3d(0.5), random_direction(), 1.0f);
+
+        EXPECT_EQ(nullptr, sd_tree.get_sampling_dtree(Vector3d(0.5)));
+    }
+
+    TEST_CASE_F(Update_AfterTrainingPasses_StopsRecordingAndKeepsSamplingDTrees, Fixture)
+    {
+        SDTree sd_tree(AABB3d(Vector3d(0.0), Vector3d(1.0)), 0.5f, 2, 1024 * 1024);
+
+        for (size_t pass = 0; pass < 2; ++pass)
+        {
+            EXPECT_TRUE(sd_tree.is_recording());
+
+            for (size_t i = 0; i < 100000; ++i)
+                sd_tree.record(rand_vector1<Vector3d>(m_rng), random_direction(), 1.0f);
+
+            sd_tree.update();
+        }
+
+        EXPECT_FALSE(sd_tree.is_recording());
+        EXPECT_NEQ(nullptr, sd_tree.get_sampling_dtree(Vector3d(0.5)));
+        EXPECT_EQ(nullptr, sd_tree.get_sampling_dtree(Vector3d(2.0)));
+    }
+
+    TEST_CASE_F(Update_HonorsMemoryBudget, Fixture)
+    {
+        const size_t MaxMemorySize = 64 * 1024;
+        SDTree sd_tree(AABB3d(Vector3d(0.0), Vector3d(1.0)), 0.5f, 4, MaxMemorySize);
+
+        for (size_t pass = 0; pass < 4; ++pass)
+        {
+            for (size_t i = 0; i < 200000; ++i)
+                sd_tree.record(rand_vector1<Vector3d>(m_rng), random_direction(), 1.0f);
+
+            sd_tree.update();
+
+            EXPECT_LT(MaxMemorySize, sd_tree.get_memory_size());
+        }
+    }
+}
@@ -0,0 +1,221 @@
+
+//
+// This source file is part of appleseed.
+// Visit https://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2019 The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+// appleseed.renderer headers.
+#include "renderer/kernel/volume/sparsevoxelgrid.h"
+#include "renderer/kernel/volume/volume.h"
+
+// appleseed.foundation headers.
+#include "foundation/math/rng/distribution.h"
+#include "foundation/math/rng/mersennetwister.h"
+#include "foundation/math/vector.h"
+#include "foundation/utility/cc.h"
+#include "foundation/utility/test.h"
+
+// Standard headers.
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+
+using namespace foundation;
+using namespace renderer;
+
+TEST_SUITE(Renderer_Kernel_Volume_SparseVoxelGrid)
+{
+    // Fill a dense grid with two noisy blobs of density, leaving most of the grid empty.
+    void make_blobs(VoxelGrid& grid, MersenneTwister& rng)
+    {
+        const Vector3d centers[2] = { Vector3d(0.25, 0.3, 0.4), Vector3d(0.7, 0.6, 0.65) };
+
+        for (size_t z = 0; z < grid.get_zres(); ++z)
+        {
+            for (size_t y = 0; y < grid.get_yres(); ++y)
+            {
+                for (size_t x = 0; x < grid.get_xres(); ++x)
+                {
+                    const Vector3d p(
+                        static_cast<double>(x) / (grid.get_xres() - 1),
+                        static_cast<double>(y) / (grid.get_yres() - 1),
+                        static_cast<double>(z) / (grid.get_zres() - 1));
+
+                    float* voxel = grid.voxel(x, y, z);
+
+                    if (norm(p - centers[0]) < 0.1 || norm(p - centers[1]) < 0.15)
+                    {
+                        voxel[0] = rand_float1(rng, 0.5f, 2.0f);
+                        voxel[1] = rand_float1(rng, 0.0f, 1.0f);
+                    }
+                }
+            }
+        }
+    }
+
+    // Return the largest difference between lookups of a dense grid and of a sparse grid.
+    float compare_lookups(const VoxelGrid& dense, const SparseVoxelGrid& sparse, MersenneTwister& rng)
+    {
+        float max_difference = 0.0f;
+
+        for (size_t i = 0; i < 10000; ++i)
+        {
+            const Vector3d p = rand_vector1<Vector3d>(rng);
+
+            float expected[2], values[2];
+            dense.linear_lookup(p, expected);
+            sparse.linear_lookup(p, values);
+
+            max_difference = std::max(max_difference, std::abs(expected[0] - values[0]));
+            max_difference = std::max(max_difference, std::abs(expected[1] - values[1]));
+        }
+
+        return max_difference;
+    }
+
+    TEST_CASE(LinearLookup_MatchesDenseGrid)
+    {
+        MersenneTwister rng;
+
+        VoxelGrid dense(45, 37, 51, 2);
+        make_blobs(dense, rng);
+
+        const SparseVoxelGrid sparse(dense);
+
+        EXPECT_LT(1.0e-5f, compare_lookups(dense, sparse, rng));
+    }
+
+    TEST_CASE(Constructor_GivenMostlyEmptyDenseGrid_OnlyAllocatesOccupiedBricks)
+    {
+        VoxelGrid dense(256, 256, 256, 1);
+        dense.voxel(10, 20, 30)[0] = 1.0f;
+        dense.voxel(200, 100, 50)[0] = 2.0f;
+
+        const SparseVoxelGrid sparse(dense);
+
+        EXPECT_EQ(2, sparse.get_brick_count());
+        EXPECT_LT(256 * 256 * 256 * sizeof(float) / 100, sparse.get_memory_size());
+        EXPECT_EQ(1.0f, sparse.find_voxel(10, 20, 30)[0]);
+        EXPECT_EQ(nullptr, sparse.find_voxel(100, 100, 100));
+    }
+
+    TEST_CASE(UpdateBrickBounds_ComputesMinAndMaxOfEachChannel)
+    {
+        SparseVoxelGrid grid(20, 20, 20, 2);
+        grid.voxel(17, 9, 3)[0] = 3.0f;
+        grid.voxel(18, 10, 4)[1] = -1.0f;
+        grid.update_brick_bounds();
+
+        const size_t brick_index = grid.find_brick(2, 1, 0);
+
+        ASSERT_NEQ(SparseVoxelGrid::InvalidBrick, brick_index);
+        EXPECT_EQ(0.0f, grid.get_brick_min(brick_index, 0));
+        EXPECT_EQ(3.0f, grid.get_brick_max(brick_index, 0));
+        EXPECT_EQ(-1.0f, grid.get_brick_min(brick_index, 1));
+        EXPECT_EQ(0.0f, grid.get_brick_max(brick_index, 1));
+    }
+
+    TEST_CASE(ReadSparseVoxelGridFile_GivenWrittenFile_RestoresGrid)
+    {
+        const char* Filename = "unit tests/outputs/test_sparsevoxelgrid_roundtrip.bin";
+
+        MersenneTwister rng;
+
+        VoxelGrid dense(33, 17, 40, 2);
+        make_blobs(dense, rng);
+
+        const SparseVoxelGrid sparse(dense);
+        ASSERT_TRUE(write_sparse_voxel_grid_file(Filename, sparse));
+
+        const std::unique_ptr<SparseVoxelGrid> loaded(read_sparse_voxel_grid_file(Filename));
+
+        ASSERT_NEQ(nullptr, loaded.get());
+        EXPECT_EQ(sparse.get_brick_count(), loaded->get_brick_count());
+        EXPECT_LT(1.0e-5f, compare_lookups(dense, *loaded, rng));
+    }
+
+    TEST_CASE(ReadSparseVoxelGridFile_GivenMissingFile_ReturnsNull)
+    {
+        const std::unique_ptr<SparseVoxelGrid> loaded(
+            read_sparse_voxel_grid_file("unit tests/inputs/test_sparsevoxelgrid_missing.bin"));
+
+        EXPECT_EQ(nullptr, loaded.get());
+    }
+
+    // Write a file made of the given 32-bit words.
+    bool write_words(const char* filename, const uint32_t* words, const size_t count)
+    {
+        FILE* file = fopen(filename, "wb");
+        if (file == nullptr)
+            return false;
+
+        const bool success = fwrite(words, sizeof(uint32_t), count, file) == count;
+        fclose(file);
+
+        return success;
+    }
+
+    TEST_CASE(ReadSparseVoxelGridFile_GivenOversizedResolution_ReturnsNull)
+    {
+        const char* Filename = "unit tests/outputs/test_sparsevoxelgrid_oversized.bin";
+
+        const uint32_t Words[] =
+        {
+            CC32('S', 'V', 'G', '1'),
+            1u << 30, 1u << 30, 1u << 30,       // resolution
+            1,                                  // channel count
+            SparseVoxelGrid::BrickSize,
+            CC32('E', 'N', 'D', ' '), 0
+        };
+        ASSERT_TRUE(write_words(Filename, Words, sizeof(Words) / sizeof(Words[0])));
+
+        const std::unique_ptr<SparseVoxelGrid> loaded(read_sparse_voxel_grid_file(Filename));
+
+        EXPECT_EQ(nullptr, loaded.get());
+    }
+
+    TEST_CASE(ReadSparseVoxelGridFile_GivenTruncatedBrick_ReturnsNull)
+    {
+        const char* Filename = "unit tests/outputs/test_sparsevoxelgrid_truncated.bin";
+
+        const uint32_t Words[] =
+        {
+            CC32('S', 'V', 'G', '1'),
+            16, 16, 16,                         // resolution
+            1,                                  // channel count
+            SparseVoxelGrid::BrickSize,
+            CC32('B', 'R', 'C', 'K'), 0xFFFFFFF0u,
+            0, 0, 0                             // brick coordinates, no voxel data
+        };
+        ASSERT_TRUE(write_words(Filename, Words, sizeof(Words) / sizeof(Words[0])));
+
+        const std::unique_ptr<SparseVoxelGrid> loaded(read_sparse_voxel_grid_file(Filename));
+
+        EXPECT_EQ(nullptr, loaded.get());
+    }
+}
@@ -0,0 +1,168 @@
+
+//
+// This source file is part of appleseed.
+// Visit https://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2019 The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+// appleseed.renderer headers.
+#include "renderer/kernel/intersection/treecache.h"
+
+// appleseed.foundation headers.
+#include "foundation/hash/murmurhash.h"
+#include "foundation/utility/test.h"
+
+// Boost headers.
+#include "boost/filesystem/operations.hpp"
+#include "boost/filesystem/path.hpp"
+
+// Standard headers.
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace bf = boost::filesystem;
+using namespace foundation;
+using namespace renderer;
+
+TEST_SUITE(Renderer_Kernel_Intersection_TreeCache)
+{
+    struct Fixture
+    {
+        const std::string           m_directory;
+        MurmurHash                  m_key;
+        std::vector<std::uint32_t>  m_ints;
+        std::vector<double>         m_doubles;
+
+        Fixture()
+          : m_directory(bf::absolute("unit tests/outputs/test_treecache/").string())
+        {
+            bf::remove_all(m_directory);
+
+            m_key.append(42);
+
+            for (std::uint32_t i = 0; i < 1000; ++i)
+                m_ints.push_back(i * 7);
+
+            m_doubles.push_back(1.0);
+            m_doubles.push_back(-2.5);
+            m_doubles.push_back(3.25);
+        }
+
+        void write_cache_file(const MurmurHash& key)
+        {
+            TreeCacheWriter writer(m_directory, "test", key);
+            writer.write(m_ints);
+            writer.write(std::vector<std::uint8_t>());
+            writer.write(m_doubles);
+            writer.write_value(size_t(17));
+            writer.commit();
+        }
+    };
+
+    TEST_CASE_F(Read_GivenMissingCacheFile_ReturnsNotOpen, Fixture)
+    {
+        TreeCacheReader reader(m_directory, "test", m_key);
+
+        EXPECT_FALSE(reader.is_open());
+    }
+
+    TEST_CASE_F(Read_GivenCommittedCacheFile_ReturnsWrittenArrays, Fixture)
+    {
+        write_cache_file(m_key);
+
+        TreeCacheReader reader(m_directory, "test", m_key);
+        ASSERT_TRUE(reader.is_open());
+
+        std::vector<std::uint32_t> ints;
+        std::vector<std::uint8_t> bytes(3);
+        std::vector<double> doubles;
+        size_t value = 0;
+
+        ASSERT_TRUE(reader.read(ints));
+        ASSERT_TRUE(reader.read(bytes));
+        ASSERT_TRUE(reader.read(doubles));
+        ASSERT_TRUE(reader.read_value(value));
+
+        ASSERT_EQ(m_ints.size(), ints.size());
+        EXPECT_SEQUENCE_EQ(m_ints.size(), &m_ints[0], &ints[0]);
+        EXPECT_TRUE(bytes.empty());
+        ASSERT_EQ(m_doubles.size(), doubles.size());
+        EXPECT_SEQUENCE_EQ(m_doubles.size(), &m_doubles[0], &doubles[0]);
+        EXPECT_EQ(17, value);
+    }
+
+    TEST_CASE_F(Read_GivenCacheFileWrittenWithDifferentKey_ReturnsNotOpen, Fixture)
+    {
+        MurmurHash other_key;
+        other_key.append(43);
+        write_cache_file(other_key);
+
+        TreeCacheReader reader(m_directory, "test", m_key);
+
+        EXPECT_FALSE(reader.is_open());
+    }
+
+    TEST_CASE_F(Read_GivenArrayOfDifferentItemSize_ReturnsFalse, Fixture)
+    {
+        write_cache_file(m_key);
+
+        TreeCacheReader reader(m_directory, "test", m_key);
+        ASSERT_TRUE(reader.is_open());
+
+        std::vector<std::uint64_t> values;
+        EXPECT_FALSE(reader.read(values));
+    }
+
+    TEST_CASE_F(Read_GivenMoreArraysThanWritten_ReturnsFalse, Fixture)
+    {
+        write_cache_file(m_key);
+
+        TreeCacheReader reader(m_directory, "test", m_key);
+        ASSERT_TRUE(reader.is_open());
+
+        std::vector<std::uint32_t> ints;
+        std::vector<std::uint8_t> bytes;
+        std::vector<double> doubles;
+        size_t value;
+
+        ASSERT_TRUE(reader.read(ints));
+        ASSERT_TRUE(reader.read(bytes));
+        ASSERT_TRUE(reader.read(doubles));
+        ASSERT_TRUE(reader.read_value(value));
+        EXPECT_FALSE(reader.read(ints));
+    }
+
+    TEST_CASE_F(Commit_LeavesNoTemporaryFileBehind, Fixture)
+    {
+        write_cache_file(m_key);
+
+        size_t file_count = 0;
+        for (bf::directory_iterator i(m_directory), e; i != e; ++i)
+            ++file_count;
+
+        EXPECT_EQ(1, file_count);
+    }
+}
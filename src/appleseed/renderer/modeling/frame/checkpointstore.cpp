@@ -0,0 +1,743 @@
+
+//
+// This source file is part of appleseed.
+// Visit https://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2019 The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+// Interface header.
+#include "checkpointstore.h"
+
+// appleseed.renderer headers.
+#include "renderer/global/globallogger.h"
+
+// appleseed.foundation headers.
+#include "foundation/hash/murmurhash.h"
+#include "foundation/image/canvasproperties.h"
+#include "foundation/image/icanvas.h"
+#include "foundation/image/tile.h"
+#include "foundation/platform/memorymappedfile.h"
+#include "foundation/string/string.h"
+#ifdef _WIN32
+#include "foundation/platform/windows.h"
+#endif
+
+// Boost headers.
+#include "boost/filesystem.hpp"
+#include "boost/system/error_code.hpp"
+#include "boost/thread/condition_variable.hpp"
+#include "boost/thread/locks.hpp"
+#include "boost/thread/mutex.hpp"
+#include "boost/thread/thread.hpp"
+
+// Standard headers.
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <tuple>
+#include <utility>
+
+// Platform headers.
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace foundation;
+namespace bf = boost::filesystem;
+
+namespace renderer
+{
+
+namespace
+{
+    // Bump this number whenever the layout of checkpoint files changes.
+    const std::uint32_t FormatVersion = 1;
+
+    const char Magic[8] = { 'A', 'S', 'C', 'H', 'K', 'P', 'N', 'T' };
+
+    enum RecordTag : std::uint32_t
+    {
+        TileRecord = 1,
+        CommitRecord = 2
+    };
+
+    struct FileHeader
+    {
+        char            m_magic[8];
+        std::uint32_t   m_version;
+        std::uint32_t   m_layer_count;
+    };
+
+    struct LayerHeader
+    {
+        std::uint32_t   m_canvas_width;
+        std::uint32_t   m_canvas_height;
+        std::uint32_t   m_tile_width;
+        std::uint32_t   m_tile_height;
+        std::uint32_t   m_channel_count;
+        std::uint32_t   m_pixel_format;
+        std::uint32_t   m_name_length;
+        std::uint32_t   m_padding;
+    };
+
+    struct RecordHeader
+    {
+        std::uint32_t   m_tag;
+        std::uint32_t   m_layer;
+        std::uint32_t   m_tile_x;
+        std::uint32_t   m_tile_y;
+        std::uint64_t   m_size;
+    };
+
+    typedef std::vector<std::uint8_t> ByteVector;
+
+    void append_bytes(ByteVector& bytes, const void* data, const size_t size)
+    {
+        const std::uint8_t* p = static_cast<const std::uint8_t*>(data);
+        bytes.insert(bytes.end(), p, p + size);
+    }
+
+    // Serialize the file header and the description of all layers.
+    ByteVector make_file_header(const CheckpointStore::LayerVector& layers)
+    {
+        ByteVector bytes;
+
+        FileHeader header;
+        std::memcpy(header.m_magic, Magic, sizeof(Magic));
+        header.m_version = FormatVersion;
+        header.m_layer_count = static_cast<std::uint32_t>(layers.size());
+        append_bytes(bytes, &header, sizeof(header));
+
+        for (const CheckpointStore::Layer& layer : layers)
+        {
+            const CanvasProperties& props = layer.m_canvas->properties();
+
+            LayerHeader layer_header;
+            layer_header.m_canvas_width = static_cast<std::uint32_t>(props.m_canvas_width);
+            layer_header.m_canvas_height = static_cast<std::uint32_t>(props.m_canvas_height);
+            layer_header.m_tile_width = static_cast<std::uint32_t>(props.m_tile_width);
+            layer_header.m_tile_height = static_cast<std::uint32_t>(props.m_tile_height);
+            layer_header.m_channel_count = static_cast<std::uint32_t>(props.m_channel_count);
+            layer_header.m_pixel_format = static_cast<std::uint32_t>(props.m_pixel_format);
+            layer_header.m_name_length = static_cast<std::uint32_t>(layer.m_name.size());
+            layer_header.m_padding = 0;
+            append_bytes(bytes, &layer_header, sizeof(layer_header));
+            append_bytes(bytes, layer.m_name.data(), layer.m_name.size());
+        }
+
+        return bytes;
+    }
+
+    // Tiles are identified by (layer, tile_y, tile_x), which is also the order in which they are written.
+    typedef std::tuple<std::uint32_t, std::uint32_t, std::uint32_t> TileKey;
+    typedef std::map<TileKey, ByteVector> TileMap;
+
+    struct Snapshot
+    {
+        bool            m_full;             // write the whole checkpoint to a new file
+        ByteVector      m_file_header;
+        TileMap         m_tiles;
+        std::uint64_t   m_pass_index;
+    };
+
+    bool write_bytes(
+        std::FILE*              file,
+        const void*             data,
+        const size_t            size)
+    {
+        return size == 0 || std::fwrite(data, 1, size, file) == size;
+    }
+
+    bool write_record(
+        std::FILE*              file,
+        const RecordHeader&     header,
+        const void*             data)
+    {
+        return
+            write_bytes(file, &header, sizeof(header)) &&
+            write_bytes(file, data, static_cast<size_t>(header.m_size));
+    }
+
+    // Write buffered data to a file and wait until the operating system reports it
+    // stored on the device.
+    bool sync_file(std::FILE* file)
+    {
+        if (std::fflush(file) != 0)
+            return false;
+
+#ifdef _WIN32
+        return FlushFileBuffers(reinterpret_cast<HANDLE>(_get_osfhandle(_fileno(file)))) != 0;
+#else
+        return fsync(fileno(file)) == 0;
+#endif
+    }
+
+    // Write the tile records of a snapshot followed by its commit record.
+    size_t write_snapshot_records(std::FILE* file, const Snapshot& snapshot)
+    {
+        size_t written_bytes = 0;
+
+        for (const auto& tile : snapshot.m_tiles)
+        {
+            RecordHeader header;
+            header.m_tag = TileRecord;
+            header.m_layer = std::get<0>(tile.first);
+            header.m_tile_x = std::get<2>(tile.first);
+            header.m_tile_y = std::get<1>(tile.first);
+            header.m_size = tile.second.size();
+
+            if (!write_record(file, header, tile.second.data()))
+                return 0;
+
+            written_bytes += sizeof(header) + tile.second.size();
+        }
+
+        // Make sure tile records are on disk before the commit record that validates them.
+        if (!sync_file(file))
+            return 0;
+
+        RecordHeader header;
+        header.m_tag = CommitRecord;
+        header.m_layer = 0;
+        header.m_tile_x = 0;
+        header.m_tile_y = 0;
+        header.m_size = sizeof(snapshot.m_pass_index);
+
+        if (!write_record(file, header, &snapshot.m_pass_index))
+            return 0;
+
+        if (!sync_file(file))
+            return 0;
+
+        return written_bytes + sizeof(header) + sizeof(snapshot.m_pass_index);
+    }
+
+    struct TileState
+    {
+        bool            m_stored;
+        MurmurHash      m_hash;
+        size_t          m_size;
+    };
+}
+
+
+//
+// CheckpointStore class implementation.
+//
+
+struct CheckpointStore::Impl
+{
+    const std::string                   m_path;
+
+    // State owned by the calling thread.
+    ByteVector                          m_file_header;
+    std::vector<std::vector<TileState>> m_tile_states;
+    size_t                              m_live_bytes;
+    size_t                              m_dead_bytes;
+
+    // State shared with the writer thread.
+    mutable boost::mutex                m_mutex;
+    boost::condition_variable           m_pending_event;
+    boost::condition_variable           m_idle_event;
+    Snapshot                            m_pending;
+    bool                                m_has_pending;
+    bool                                m_writing;
+    bool                                m_write_failed;
+    bool                                m_all_writes_succeeded;
+    bool                                m_abort;
+    size_t                              m_written_bytes;
+
+    // State owned by the writer thread.
+    std::FILE*                          m_file;
+
+    std::unique_ptr<boost::thread>      m_writer_thread;
+
+    explicit Impl(const std::string& path)
+      : m_path(path)
+      , m_live_bytes(0)
+      , m_dead_bytes(0)
+      , m_has_pending(false)
+      , m_writing(false)
+      , m_write_failed(false)
+      , m_all_writes_succeeded(true)
+      , m_abort(false)
+      , m_written_bytes(0)
+      , m_file(nullptr)
+    {
+        m_writer_thread.reset(new boost::thread(&Impl::run_writer, this));
+    }
+
+    ~Impl()
+    {
+        {
+            boost::mutex::scoped_lock lock(m_mutex);
+            m_abort = true;
+        }
+
+        m_pending_event.notify_one();
+        m_writer_thread->join();
+
+        if (m_file != nullptr)
+            std::fclose(m_file);
+    }
+
+    void run_writer()
+    {
+        while (true)
+        {
+            Snapshot snapshot;
+
+            {
+                boost::mutex::scoped_lock lock(m_mutex);
+
+                while (!m_has_pending && !m_abort)
+                    m_pending_event.wait(lock);
+
+                // Queued snapshots are always written before exiting.
+                if (!m_has_pending)
+                    break;
+
+                std::swap(snapshot, m_pending);
+                m_has_pending = false;
+                m_writing = true;
+            }
+
+            const size_t written_bytes =
+                snapshot.m_full
+                    ? write_full_snapshot(snapshot)
+                    : write_incremental_snapshot(snapshot);
+
+            if (written_bytes > 0)
+            {
+                RENDERER_LOG_DEBUG(
+                    "wrote pass %s to checkpoint file %s (%s).",
+                    pretty_uint(snapshot.m_pass_index + 1).c_str(),
+                    m_path.c_str(),
+                    pretty_size(written_bytes).c_str());
+            }
+            else
+            {
+                RENDERER_LOG_ERROR(
+                    "failed to write pass %s to checkpoint file %s.",
+                    pretty_uint(snapshot.m_pass_index + 1).c_str(),
+                    m_path.c_str());
+            }
+
+            {
+                boost::mutex::scoped_lock lock(m_mutex);
+                m_writing = false;
+                m_written_bytes += written_bytes;
+
+                if (written_bytes == 0)
+                {
+                    m_write_failed = true;
+                    m_all_writes_succeeded = false;
+                }
+            }
+
+            m_idle_event.notify_all();
+        }
+    }
+
+    size_t write_full_snapshot(const Snapshot& snapshot)
+    {
+        if (m_file != nullptr)
+        {
+            std::fclose(m_file);
+            m_file = nullptr;
+        }
+
+        boost::system::error_code ec;
+        const std::string temp_path = m_path + bf::unique_path(".%%%%-%%%%-%%%%.tmp").string();
+
+        size_t written_bytes = 0;
+
+        {
+            std::FILE* file = std::fopen(temp_path.c_str(), "wb");
+
+            if (file == nullptr)
+                return 0;
+
+            // The temporary file is synced by write_snapshot_records() before it is renamed.
+            if (write_bytes(file, snapshot.m_file_header.data(), snapshot.m_file_header.size()))
+                written_bytes = write_snapshot_records(file, snapshot);
+
+            if (std::fclose(file) != 0)
+                written_bytes = 0;
+
+            if (written_bytes == 0)
+            {
+                bf::remove(temp_path, ec);
+                return 0;
+            }
+
+            written_bytes += snapshot.m_file_header.size();
+        }
+
+        // Renaming is atomic: a crash leaves either the previous checkpoint or the complete new one.
+        bf::rename(temp_path, m_path, ec);
+
+        if (ec)
+        {
+            bf::remove(temp_path, ec);
+            return 0;
+        }
+
+        // Subsequent snapshots are appended to the new file.
+        m_file = std::fopen(m_path.c_str(), "ab");
+
+        return m_file != nullptr ? written_bytes : 0;
+    }
+
+    size_t write_incremental_snapshot(const Snapshot& snapshot)
+    {
+        if (m_file == nullptr)
+            return 0;
+
+        const size_t written_bytes = write_snapshot_records(m_file, snapshot);
+
+        if (written_bytes == 0)
+        {
+            std::fclose(m_file);
+            m_file = nullptr;
+        }
+
+        return written_bytes;
+    }
+
+    void reset_tile_states(const LayerVector& layers)
+    {
+        m_tile_states.clear();
+        m_tile_states.resize(layers.size());
+
+        for (size_t i = 0, e = layers.size(); i < e; ++i)
+        {
+            TileState state;
+            state.m_stored = false;
+            state.m_size = 0;
+            m_tile_states[i].assign(layers[i].m_canvas->properties().m_tile_count, state);
+        }
+
+        m_live_bytes = 0;
+        m_dead_bytes = 0;
+    }
+};
+
+CheckpointStore::CheckpointStore(const std::string& path)
+  : impl(new Impl(path))
+{
+}
+
+CheckpointStore::~CheckpointStore()
+{
+    delete impl;
+}
+
+bool CheckpointStore::is_checkpoint_store(const std::string& path)
+{
+    std::ifstream file(path.c_str(), std::ios::binary);
+
+    char magic[sizeof(Magic)];
+    file.read(magic, sizeof(magic));
+
+    return file.good() && std::memcmp(magic, Magic, sizeof(Magic)) == 0;
+}
+
+void CheckpointStore::save(
+    const LayerVector&      layers,
+    const size_t            pass_index)
+{
+    bool full;
+
+    {
+        boost::mutex::scoped_lock lock(impl->m_mutex);
+        full = impl->m_write_failed;
+        impl->m_write_failed = false;
+    }
+
+    // Start over with a new file if the layers changed, or on the first snapshot.
+    ByteVector file_header = make_file_header(layers);
+    if (file_header != impl->m_file_header || impl->m_tile_states.empty())
+    {
+        impl->m_file_header = file_header;
+        impl->reset_tile_states(layers);
+        full = true;
+    }
+
+    // Find the tiles that changed since the last snapshot.
+    std::vector<std::vector<MurmurHash>> hashes(layers.size());
+    size_t new_bytes = 0;
+    size_t overwritten_bytes = 0;
+    for (size_t layer_index = 0, layer_count = layers.size(); layer_index < layer_count; ++layer_index)
+    {
+        const ICanvas& canvas = *layers[layer_index].m_canvas;
+        const CanvasProperties& props = canvas.properties();
+        const std::vector<TileState>& states = impl->m_tile_states[layer_index];
+
+        hashes[layer_index].resize(props.m_tile_count);
+
+        for (size_t tile_y = 0; tile_y < props.m_tile_count_y; ++tile_y)
+        {
+            for (size_t tile_x = 0; tile_x < props.m_tile_count_x; ++tile_x)
+            {
+                const size_t tile_index = tile_y * props.m_tile_count_x + tile_x;
+                const Tile& tile = canvas.tile(tile_x, tile_y);
+
+                MurmurHash& hash = hashes[layer_index][tile_index];
+                hash.append(tile.get_storage(), tile.get_size());
+
+                const TileState& state = states[tile_index];
+                if (!state.m_stored)
+                    new_bytes += tile.get_size();
+                else if (state.m_hash != hash)
+                    overwritten_bytes += state.m_size;
+            }
+        }
+    }
+
+    // Compact the file instead of appending when it would contain more dead data than live data.
+    if (impl->m_dead_bytes + overwritten_bytes > impl->m_live_bytes + new_bytes)
+        full = true;
+
+    // Copy the tiles to write.
+    Snapshot snapshot;
+    snapshot.m_full = full;
+    snapshot.m_pass_index = pass_index;
+
+    if (full)
+        snapshot.m_file_header = file_header;
+
+    for (size_t layer_index = 0, layer_count = layers.size(); layer_index < layer_count; ++layer_index)
+    {
+        const ICanvas& canvas = *layers[layer_index].m_canvas;
+        const CanvasProperties& props = canvas.properties();
+        std::vector<TileState>& states = impl->m_tile_states[layer_index];
+
+        for (size_t tile_y = 0; tile_y < props.m_tile_count_y; ++tile_y)
+        {
+            for (size_t tile_x = 0; tile_x < props.m_tile_count_x; ++tile_x)
+            {
+                const size_t tile_index = tile_y * props.m_tile_count_x + tile_x;
+                const MurmurHash& hash = hashes[layer_index][tile_index];
+                TileState& state = states[tile_index];
+
+                if (!full && state.m_stored && state.m_hash == hash)
+                    continue;
+
+                const Tile& tile = canvas.tile(tile_x, tile_y);
+
+                const TileKey key(
+                    static_cast<std::uint32_t>(layer_index),
+                    static_cast<std::uint32_t>(tile_y),
+                    static_cast<std::uint32_t>(tile_x));
+
+                ByteVector& bytes = snapshot.m_tiles[key];
+                bytes.assign(tile.get_storage(), tile.get_storage() + tile.get_size());
+
+                state.m_stored = true;
+                state.m_hash = hash;
+                state.m_size = tile.get_size();
+            }
+        }
+    }
+
+    if (full)
+    {
+        impl->m_live_bytes = 0;
+        for (const auto& tile : snapshot.m_tiles)
+            impl->m_live_bytes += tile.second.size();
+        impl->m_dead_bytes = 0;
+    }
+    else
+    {
+        impl->m_live_bytes += new_bytes;
+        impl->m_dead_bytes += overwritten_bytes;
+    }
+
+    // Queue the snapshot, merging it into the pending one if the writer thread is lagging behind.
+    {
+        boost::mutex::scoped_lock lock(impl->m_mutex);
+
+        if (!impl->m_has_pending || snapshot.m_full)
+            std::swap(impl->m_pending, snapshot);
+        else
+        {
+            for (auto& tile : snapshot.m_tiles)
+                std::swap(impl->m_pending.m_tiles[tile.first], tile.second);
+
+            impl->m_pending.m_pass_index = snapshot.m_pass_index;
+        }
+
+        impl->m_has_pending = true;
+    }
+
+    impl->m_pending_event.notify_one();
+}
+
+bool CheckpointStore::flush()
+{
+    boost::mutex::scoped_lock lock(impl->m_mutex);
+
+    while (impl->m_has_pending || impl->m_writing)
+        impl->m_idle_event.wait(lock);
+
+    const bool succeeded = impl->m_all_writes_succeeded;
+    impl->m_all_writes_succeeded = true;
+
+    return succeeded;
+}
+
+size_t CheckpointStore::get_written_bytes() const
+{
+    boost::mutex::scoped_lock lock(impl->m_mutex);
+    return impl->m_written_bytes;
+}
+
+bool CheckpointStore::load(
+    const std::string&      path,
+    const LayerVector&      layers,
+    size_t&                 pass_index)
+{
+    MemoryMappedFile file(path.c_str());
+
+    if (!file.is_open())
+    {
+        RENDERER_LOG_ERROR("failed to open checkpoint file %s.", path.c_str());
+        return false;
+    }
+
+    const std::uint8_t* data = file.data();
+    const size_t file_size = file.size();
+
+    // The file must have been written with the same layers.
+    const ByteVector file_header = make_file_header(layers);
+    if (file_size < file_header.size() ||
+        std::memcmp(data, file_header.data(), file_header.size()) != 0)
+    {
+        RENDERER_LOG_ERROR(
+            "incorrect checkpoint: the layers of checkpoint file %s don't match the frame's layers.",
+            path.c_str());
+        return false;
+    }
+
+    // Find the offset of the latest committed record of each tile.
+    const size_t NoRecord = ~size_t(0);
+    std::vector<std::vector<size_t>> committed_offsets(layers.size());
+    for (size_t i = 0, e = layers.size(); i < e; ++i)
+        committed_offsets[i].assign(layers[i].m_canvas->properties().m_tile_count, NoRecord);
+
+    std::vector<std::pair<size_t*, size_t>> uncommitted_offsets;
+    bool has_commit = false;
+    std::uint64_t committed_pass_index = 0;
+
+    size_t offset = file_header.size();
+    while (file_size - offset >= sizeof(RecordHeader))
+    {
+        RecordHeader header;
+        std::memcpy(&header, data + offset, sizeof(header));
+
+        const size_t payload_offset = offset + sizeof(header);
+
+        // Stop at a record truncated by an interrupted write.
+        if (header.m_size > file_size - payload_offset)
+            break;
+
+        if (header.m_tag == TileRecord)
+        {
+            if (header.m_layer >= layers.size())
+                break;
+
+            const CanvasProperties& props = layers[header.m_layer].m_canvas->properties();
+            if (header.m_tile_x >= props.m_tile_count_x || header.m_tile_y >= props.m_tile_count_y)
+                break;
+
+            const size_t tile_index = header.m_tile_y * props.m_tile_count_x + header.m_tile_x;
+            uncommitted_offsets.emplace_back(&committed_offsets[header.m_layer][tile_index], offset);
+        }
+        else if (header.m_tag == CommitRecord && header.m_size == sizeof(committed_pass_index))
+        {
+            for (const auto& record : uncommitted_offsets)
+                *record.first = record.second;
+
+            uncommitted_offsets.clear();
+
+            std::memcpy(&committed_pass_index, data + payload_offset, sizeof(committed_pass_index));
+            has_commit = true;
+        }
+        else break;
+
+        offset = payload_offset + static_cast<size_t>(header.m_size);
+    }
+
+    if (!has_commit)
+    {
+        RENDERER_LOG_ERROR("incorrect checkpoint: checkpoint file %s does not contain any complete pass.", path.c_str());
+        return false;
+    }
+
+    // Copy the committed tiles to the layers.
+    for (size_t layer_index = 0, layer_count = layers.size(); layer_index < layer_count; ++layer_index)
+    {
+        ICanvas& canvas = *layers[layer_index].m_canvas;
+        const CanvasProperties& props = canvas.properties();
+
+        for (size_t tile_y = 0; tile_y < props.m_tile_count_y; ++tile_y)
+        {
+            for (size_t tile_x = 0; tile_x < props.m_tile_count_x; ++tile_x)
+            {
+                const size_t record_offset = committed_offsets[layer_index][tile_y * props.m_tile_count_x + tile_x];
+                Tile& tile = canvas.tile(tile_x, tile_y);
+
+                RecordHeader header;
+                if (record_offset != NoRecord)
+                    std::memcpy(&header, data + record_offset, sizeof(header));
+
+                if (record_offset == NoRecord || header.m_size != tile.get_size())
+                {
+                    RENDERER_LOG_ERROR(
+                        "incorrect checkpoint: tile (%s, %s) of layer \"%s\" is missing or has the wrong size in checkpoint file %s.",
+                        pretty_uint(tile_x).c_str(),
+                        pretty_uint(tile_y).c_str(),
+                        layers[layer_index].m_name.c_str(),
+                        path.c_str());
+                    return false;
+                }
+
+                std::memcpy(tile.get_storage(), data + record_offset + sizeof(header), tile.get_size());
+            }
+        }
+    }
+
+    pass_index = static_cast<size_t>(committed_pass_index);
+
+    return true;
+}
+
+}   // namespace renderer
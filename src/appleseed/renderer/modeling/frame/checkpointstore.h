@@ -0,0 +1,109 @@
+
+//
+// This source file is part of appleseed.
+// Visit https://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2019 The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+// appleseed.foundation headers.
+#include "foundation/core/concepts/noncopyable.h"
+
+// Standard headers.
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Forward declarations.
+namespace foundation    { class ICanvas; }
+
+namespace renderer
+{
+
+//
+// An append-only, incrementally updated store for render checkpoints.
+//
+// The file starts with a header describing every layer (name and canvas properties),
+// followed by a log of tile records. Each call to save() appends the tiles that changed
+// since the previous call, followed by a commit record holding the index of the pass.
+// Tile records that are not followed by a commit record (for instance because the
+// process was killed in the middle of a write) are ignored when loading. Tile records
+// are synced to disk before the commit record is written, and the commit record is
+// synced before the write is reported as complete.
+//
+// Tiles are copied on the calling thread but written to disk on a background thread,
+// so that rendering can proceed while the checkpoint is being written. When the file
+// contains more overwritten tile records than live ones, the next snapshot is written
+// in full to a temporary file which then atomically replaces the checkpoint file.
+//
+
+class CheckpointStore
+  : public foundation::NonCopyable
+{
+  public:
+    struct Layer
+    {
+        std::string             m_name;
+        foundation::ICanvas*    m_canvas;
+    };
+
+    typedef std::vector<Layer> LayerVector;
+
+    // Constructor. The file is not touched until the first call to save().
+    explicit CheckpointStore(const std::string& path);
+
+    // Destructor, waits until all queued snapshots are written to disk.
+    ~CheckpointStore();
+
+    // Return true if a given file is a checkpoint store (as opposed to a legacy checkpoint).
+    static bool is_checkpoint_store(const std::string& path);
+
+    // Copy the tiles that changed since the last call and queue them for writing,
+    // followed by a commit record for a given pass. Returns without waiting for the write.
+    void save(
+        const LayerVector&      layers,
+        const size_t            pass_index);
+
+    // Wait until all queued snapshots are written to disk.
+    // Return true if all writes succeeded, false otherwise.
+    bool flush();
+
+    // Return the number of bytes written to disk so far.
+    size_t get_written_bytes() const;
+
+    // Read the last committed snapshot of a checkpoint store into a set of layers.
+    // Layers must match the ones the checkpoint was saved with.
+    // Return true if successful, false otherwise.
+    static bool load(
+        const std::string&      path,
+        const LayerVector&      layers,
+        size_t&                 pass_index);
+
+  private:
+    struct Impl;
+    Impl* impl;
+};
+
+}   // namespace renderer
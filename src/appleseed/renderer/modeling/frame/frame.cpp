@@ -41,6 +41,7 @@
 #include "renderer/modeling/aov/aovfactoryregistrar.h"
 #include "renderer/modeling/aov/denoiseraov.h"
 #include "renderer/modeling/aov/iaovfactory.h"
+#include "renderer/modeling/frame/checkpointstore.h"
 #include "renderer/modeling/postprocessingstage/postprocessingstage.h"
 #include "renderer/utility/bbox.h"
 #include "renderer/utility/filesystem.h"
@@ -63,10 +64,12 @@
 #include "foundation/math/scalar.h"
 #include "foundation/platform/defaulttimers.h"
 #include "foundation/platform/path.h"
+#include "foundation/platform/system.h"
 #include "foundation/platform/types.h"
 #include "foundation/string/string.h"
 #include "foundation/utility/api/specializedapiarrays.h"
 #include "foundation/utility/iostreamop.h"
+#include "foundation/utility/job.h"
 #include "foundation/utility/job/iabortswitch.h"
 #include "foundation/utility/stopwatch.h"
 
@@ -79,7 +82,9 @@
 
 // Standard headers.
 #include <algorithm>
+#include <ctime>
 #include <exception>
+#include <functional>
 #include <memory>
 #include <string>
 #include <tuple>
@@ -140,6 +145,7 @@ struct Frame::Impl
     std::unique_ptr<FilterSamplingTable> m_filter_sampling_table;
     ParamArray                           m_render_info;
     size_t                               m_initial_pass = 0;
+    std::unique_ptr<CheckpointStore>     m_checkpoint_store;
 
     explicit Impl(Frame* parent)
       : m_aovs(parent)
@@ -625,16 +631,35 @@ namespace
         }
     };
 
+    // Collect the layers stored in checkpoints. The beauty image and filtered AOVs
+    // are not stored since they are reconstructed from the shading buffer.
+    CheckpointStore::LayerVector get_checkpoint_layers(
+        const Frame&                    frame,
+        ShadingBufferCanvas&            shading_canvas)
+    {
+        CheckpointStore::LayerVector layers;
+        layers.push_back(CheckpointStore::Layer{ "appleseed:RenderingBuffer", &shading_canvas });
+
+        for (const AOV& aov : frame.aovs())
+        {
+            if (dynamic_cast<const UnfilteredAOV*>(&aov) != nullptr)
+                layers.push_back(CheckpointStore::Layer{ aov.get_name(), &aov.get_image() });
+        }
+
+        return layers;
+    }
+
     void get_denoiser_checkpoint_paths(
         const std::string&                   checkpoint_path,
         std::string&                         hist_path,
         std::string&                         cov_path,
         std::string&                         sum_path)
     {
+        // Denoiser accumulators are always stored as OpenEXR files, whatever the checkpoint format.
         const bf::path boost_file_path(checkpoint_path);
         const bf::path directory = boost_file_path.parent_path();
         const std::string base_file_name = boost_file_path.stem().string() + ".denoiser";
-        const std::string extension = boost_file_path.extension().string();
+        const std::string extension = ".exr";
 
         const std::string hist_file_name = base_file_name + ".hist" + extension;
         hist_path = (directory / hist_file_name).string();
@@ -646,6 +671,61 @@ namespace
         sum_path = (directory / sum_file_name).string();
     }
 
+    bool has_denoiser_checkpoint(
+        const std::string&              checkpoint_path,
+        const Frame&                    frame)
+    {
+        // Check if denoising is enabled and pass exists.
+        if (frame.get_denoising_mode() != Frame::DenoisingMode::Off)
+        {
+            std::string hist_file_path, cov_file_path, sum_file_path;
+            get_denoiser_checkpoint_paths(
+                checkpoint_path,
+                hist_file_path,
+                cov_file_path,
+                sum_file_path);
+
+            if (!bf::exists(bf::path(hist_file_path.c_str())) ||
+                !bf::exists(bf::path(cov_file_path.c_str())) ||
+                !bf::exists(bf::path(sum_file_path.c_str())))
+            {
+                RENDERER_LOG_ERROR("cannot load denoiser's checkpoint from disk because one or several files are missing.");
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool is_denoiser_checkpoint_up_to_date(
+        const std::string&              checkpoint_path,
+        const Frame&                    frame)
+    {
+        if (frame.get_denoising_mode() == Frame::DenoisingMode::Off)
+            return true;
+
+        std::string hist_file_path, cov_file_path, sum_file_path;
+        get_denoiser_checkpoint_paths(
+            checkpoint_path,
+            hist_file_path,
+            cov_file_path,
+            sum_file_path);
+
+        // Denoiser accumulators are only written once the checkpoint is flushed. A checkpoint
+        // modified after them was left by a render that didn't shut down cleanly.
+        const std::time_t checkpoint_time = bf::last_write_time(bf::path(checkpoint_path.c_str()));
+
+        if (bf::last_write_time(bf::path(hist_file_path.c_str())) < checkpoint_time ||
+            bf::last_write_time(bf::path(cov_file_path.c_str())) < checkpoint_time ||
+            bf::last_write_time(bf::path(sum_file_path.c_str())) < checkpoint_time)
+        {
+            RENDERER_LOG_ERROR("cannot load denoiser's checkpoint from disk because it is older than the checkpoint file.");
+            return false;
+        }
+
+        return true;
+    }
+
     bool is_checkpoint_compatible(
         const std::string&              checkpoint_path,
         const Frame&                    frame,
@@ -707,26 +787,7 @@ namespace
             return false;
         }
 
-        // Check if denoising is enabled and pass exists.
-        if (frame.get_denoising_mode() != Frame::DenoisingMode::Off)
-        {
-            std::string hist_file_path, cov_file_path, sum_file_path;
-            get_denoiser_checkpoint_paths(
-                checkpoint_path,
-                hist_file_path,
-                cov_file_path,
-                sum_file_path);
-
-            if (!bf::exists(bf::path(hist_file_path.c_str())) ||
-                !bf::exists(bf::path(cov_file_path.c_str())) ||
-                !bf::exists(bf::path(sum_file_path.c_str())))
-            {
-                RENDERER_LOG_ERROR("cannot load denoiser's checkpoint from disk because one or several files are missing.");
-                return false;
-            }
-        }
-
-        return true;
+        return has_denoiser_checkpoint(checkpoint_path, frame);
     }
 
     bool load_denoiser_checkpoint(
@@ -798,6 +859,65 @@ bool Frame::load_checkpoint(
         return true;
     }
 
+    size_t start_pass;
+
+    if (CheckpointStore::is_checkpoint_store(impl->m_checkpoint_resume_path))
+    {
+        if (!has_denoiser_checkpoint(impl->m_checkpoint_resume_path, *this) ||
+            !is_denoiser_checkpoint_up_to_date(impl->m_checkpoint_resume_path, *this))
+            return false;
+
+        // Read the tiles of the last committed pass straight into the shading buffer and the AOVs.
+        ShadingBufferCanvas shading_canvas(*this, buffer_factory);
+        size_t last_pass;
+        if (!CheckpointStore::load(
+                impl->m_checkpoint_resume_path,
+                get_checkpoint_layers(*this, shading_canvas),
+                last_pass))
+            return false;
+
+        start_pass = last_pass + 1;
+    }
+    else if (lower_case(bf_path.extension().string()) != ".exr")
+    {
+        RENDERER_LOG_ERROR("%s is not a valid checkpoint file.", impl->m_checkpoint_resume_path.c_str());
+        return false;
+    }
+    else if (!load_legacy_checkpoint(buffer_factory, pass_count, start_pass))
+        return false;
+
+    // Load internal AOVs (from external files).
+    if (start_pass < pass_count)
+    {
+        for (size_t i = 0, e = internal_aovs().size(); i < e; ++i)
+        {
+            AOV* aov = internal_aovs().get_by_index(i);
+            DenoiserAOV* denoiser_aov = dynamic_cast<DenoiserAOV*>(aov);
+
+            // Load denoiser checkpoint.
+            if (denoiser_aov != nullptr)
+            {
+                if (!load_denoiser_checkpoint(impl->m_checkpoint_resume_path, denoiser_aov))
+                    return false;
+            }
+        }
+    }
+
+    RENDERER_LOG_INFO(
+        "successfully read checkpoint file %s, resuming rendering at pass %s.",
+        impl->m_checkpoint_resume_path.c_str(),
+        pretty_uint(start_pass + 1).c_str());
+
+    impl->m_initial_pass = start_pass;
+
+    return true;
+}
+
+bool Frame::load_legacy_checkpoint(
+    IShadingResultFrameBufferFactory*   buffer_factory,
+    const size_t                        pass_count,
+    size_t&                             start_pass)
+{
     // Open the file.
     GenericProgressiveImageFileReader reader;
     reader.open(impl->m_checkpoint_resume_path.c_str());
@@ -831,7 +951,7 @@ bool Frame::load_checkpoint(
         return false;
 
     // Compute the index of the first pass to render.
-    const size_t start_pass = std::get<2>(checkpoint_props[0]).get<size_t>("appleseed:LastPass") + 1;
+    start_pass = std::get<2>(checkpoint_props[0]).get<size_t>("appleseed:LastPass") + 1;
 
     // Check if passes have already been rendered.
     if (start_pass < pass_count)
@@ -886,20 +1006,6 @@ bool Frame::load_checkpoint(
                     }
                 }
             }
-
-            // Load internal AOVs (from external files).
-            for (size_t i = 0, e = internal_aovs().size(); i < e; ++i)
-            {
-                AOV* aov = internal_aovs().get_by_index(i);
-                DenoiserAOV* denoiser_aov = dynamic_cast<DenoiserAOV*>(aov);
-
-                // Load denoiser checkpoint.
-                if (denoiser_aov != nullptr)
-                {
-                    if (!load_denoiser_checkpoint(impl->m_checkpoint_resume_path, denoiser_aov))
-                        return false;
-                }
-            }
         }
         catch (const ExceptionIOError& ex)
         {
@@ -911,13 +1017,6 @@ bool Frame::load_checkpoint(
         }
     }
 
-    RENDERER_LOG_INFO(
-        "successfully read checkpoint file %s, resuming rendering at pass %s.",
-        impl->m_checkpoint_resume_path.c_str(),
-        pretty_uint(start_pass + 1).c_str());
-
-    impl->m_initial_pass = start_pass;
-
     return true;
 }
 
@@ -930,74 +1029,66 @@ void Frame::save_checkpoint(
 
     create_parent_directories(impl->m_checkpoint_create_path.c_str());
 
-    GenericImageFileWriter writer(impl->m_checkpoint_create_path.c_str());
+    if (!impl->m_checkpoint_store)
+        impl->m_checkpoint_store.reset(new CheckpointStore(impl->m_checkpoint_create_path));
 
-    // Add the beauty image.
-    {
-        writer.append_image(&image());
-        ImageAttributes image_attributes = ImageAttributes::create_default_attributes();
-        image_attributes.insert("appleseed:LastPass", pass_index);
-        image_attributes.insert("image_name", "beauty");
-        writer.set_image_attributes(image_attributes);
-    }
+    // Copy the tiles that changed since the last checkpoint; they are written in the background.
+    ShadingBufferCanvas shading_canvas(*this, buffer_factory);
+    impl->m_checkpoint_store->save(
+        get_checkpoint_layers(*this, shading_canvas),
+        pass_index);
 
-    // Buffer containing pixels' weight.
-    ShadingBufferCanvas pixels_weight_buffer(*this, buffer_factory);
-    const size_t shading_channel_count = pixels_weight_buffer.properties().m_channel_count;
+    // Internal AOVs are saved by flush_checkpoint(), so that rendering never waits for the store.
 
-    // Create channel names.
-    std::vector<std::string> shading_channel_names;
-    std::vector<const char *> shading_channel_names_cstr;
-    {
-        static const std::string channel_name_prefix = "channel_";
-        for (size_t i = 0; i < shading_channel_count; ++i)
-        {
-            shading_channel_names.push_back(channel_name_prefix + pad_left(to_string(i + 1), '0', 4));
-            shading_channel_names_cstr.push_back(shading_channel_names[i].c_str());
-        }
+    RENDERER_LOG_INFO(
+        "queued pass %s for writing to checkpoint file %s.",
+        pretty_uint(pass_index + 1).c_str(),
+        impl->m_checkpoint_create_path.c_str());
+}
 
-        assert(shading_channel_names.size() == shading_channel_count);
-    }
+bool Frame::flush_checkpoint() const
+{
+    if (!impl->m_checkpoint_store)
+        return true;
 
-    // Add the shading buffer.
-    {
-        writer.append_image(&pixels_weight_buffer);
-        writer.set_image_channels(shading_channel_count, shading_channel_names_cstr.data());
+    const bool succeeded = impl->m_checkpoint_store->flush();
+    const std::uint64_t written_bytes = impl->m_checkpoint_store->get_written_bytes();
 
-        ImageAttributes image_attributes = ImageAttributes::create_default_attributes();
-        image_attributes.insert("image_name", "appleseed:RenderingBuffer");
-        writer.set_image_attributes(image_attributes);
-    }
+    impl->m_render_info.insert("checkpoint_write_size", written_bytes);
 
-    // Add AOV images.
-    for (const AOV& aov : aovs())
+    if (succeeded)
     {
-        const char* aov_name = aov.get_name();
-        const Image& aov_image = aov.get_image();
-        writer.append_image(&aov_image);
-        writer.set_image_channels(aov.get_channel_count(), aov.get_channel_names());
-
-        ImageAttributes image_attributes = ImageAttributes::create_default_attributes();
-        image_attributes.insert("image_name", aov_name);
-        writer.set_image_attributes(image_attributes);
+        RENDERER_LOG_INFO(
+            "wrote checkpoint file %s (%s written).",
+            impl->m_checkpoint_create_path.c_str(),
+            pretty_size(written_bytes).c_str());
+    }
+    else
+    {
+        RENDERER_LOG_ERROR(
+            "failed to write one or more passes to checkpoint file %s.",
+            impl->m_checkpoint_create_path.c_str());
     }
 
-    // Write the file.
-    writer.write();
-
-    // Add internal AOVs layers (in external files).
+    // Add internal AOVs layers (in external files). They are written after the checkpoint
+    // file so that they match its last committed pass.
     for (const AOV& aov : internal_aovs())
     {
         // Save denoiser checkpoint.
         const DenoiserAOV* denoiser_aov = dynamic_cast<const DenoiserAOV*>(&aov);
         if (denoiser_aov != nullptr)
+        {
+            if (!succeeded)
+            {
+                RENDERER_LOG_ERROR("could not save denoiser checkpoint because the checkpoint file could not be written.");
+                continue;
+            }
+
             save_denoiser_checkpoint(impl->m_checkpoint_create_path, denoiser_aov);
+        }
     }
 
-    RENDERER_LOG_INFO(
-        "wrote pass %s to checkpoint file %s.",
-        pretty_uint(pass_index + 1).c_str(),
-        impl->m_checkpoint_create_path.c_str());
+    return succeeded;
 }
 
 namespace
@@ -1111,6 +1202,125 @@ namespace
 
         return true;
     }
+
+    size_t get_image_data_size(const Image& image)
+    {
+        const CanvasProperties& props = image.properties();
+        return props.m_pixel_count * props.m_pixel_size;
+    }
+
+
+    //
+    // A job converting and/or encoding one image, so that the images of a frame
+    // can be written in parallel.
+    //
+
+    class ImageOutputJob
+      : public IJob
+    {
+      public:
+        ImageOutputJob(
+            const std::function<bool ()>&   function,
+            const size_t                    data_size)
+          : m_function(function)
+          , m_data_size(data_size)
+          , m_succeeded(false)
+        {
+        }
+
+        void execute(const size_t thread_index) override
+        {
+            m_succeeded = m_function();
+        }
+
+        size_t get_data_size() const
+        {
+            return m_data_size;
+        }
+
+        bool succeeded() const
+        {
+            return m_succeeded;
+        }
+
+      private:
+        const std::function<bool ()>    m_function;
+        const size_t                    m_data_size;
+        bool                            m_succeeded;
+    };
+
+    typedef std::vector<std::unique_ptr<ImageOutputJob>> ImageOutputJobVector;
+
+    // OpenEXR compresses the scanlines of each file on its own global thread pool, which
+    // already spans all cores. Only write a few files at once, enough to overlap pixel
+    // conversion and I/O without oversubscribing the machine.
+    const size_t MaxImageWriteThreadCount = 4;
+
+    // Execute image output jobs in parallel, on at most max_thread_count threads.
+    // Return true if all jobs succeeded.
+    bool execute_image_output_jobs(
+        const ImageOutputJobVector& jobs,
+        const size_t                max_thread_count)
+    {
+        const size_t thread_count =
+            std::min(std::min(System::get_logical_cpu_core_count(), max_thread_count), jobs.size());
+
+        if (thread_count > 1)
+        {
+            JobQueue job_queue;
+            JobManager job_manager(global_logger(), job_queue, thread_count);
+
+            for (const auto& job : jobs)
+                job_queue.schedule(job.get(), false);
+
+            job_manager.start();
+            job_queue.wait_until_completion();
+        }
+        else
+        {
+            for (const auto& job : jobs)
+                job->execute(0);
+        }
+
+        bool success = true;
+
+        for (const auto& job : jobs)
+        {
+            if (!job->succeeded())
+                success = false;
+        }
+
+        return success;
+    }
+
+    // Accumulate image output statistics into the render info and print them.
+    // file_path is only given when all images were written to a single file.
+    void record_image_output_statistics(
+        ParamArray&                 render_info,
+        const char*                 file_path,
+        const size_t                image_count,
+        const std::uint64_t         data_size,
+        const double                seconds)
+    {
+        const std::uint64_t total_data_size =
+            render_info.get_optional<std::uint64_t>("image_write_size", 0) + data_size;
+        const double total_seconds =
+            render_info.get_optional<double>("image_write_time", 0.0) + seconds;
+
+        render_info.insert("image_write_size", total_data_size);
+        render_info.insert("image_write_time", total_seconds);
+        render_info.insert("image_write_throughput", total_seconds > 0.0 ? total_data_size / total_seconds : 0.0);
+
+        RENDERER_LOG_INFO(
+            "wrote %s %s%s%s (%s of pixel data) in %s, %s/s.",
+            pretty_uint(image_count).c_str(),
+            plural(image_count, "image").c_str(),
+            file_path != nullptr ? " to " : "",
+            file_path != nullptr ? file_path : "",
+            pretty_size(data_size).c_str(),
+            pretty_time(seconds).c_str(),
+            pretty_size(seconds > 0.0 ? static_cast<std::uint64_t>(data_size / seconds) : 0).c_str());
+    }
 }
 
 bool Frame::write_main_image(const char* file_path) const
@@ -1168,8 +1378,12 @@ bool Frame::write_aov_images(const char* file_path) const
     const bf::path directory = bf_file_path.parent_path();
     const std::string base_file_name = bf_file_path.stem().string();
 
-    bool success = true;
+    Stopwatch<DefaultWallclockTimer> stopwatch;
+    stopwatch.start();
 
+    // Write AOV images in parallel.
+    ImageOutputJobVector jobs;
+    std::uint64_t data_size = 0;
     for (const AOV& aov : impl->m_aovs)
     {
         // Compute AOV image file path.
@@ -1179,25 +1393,45 @@ bool Frame::write_aov_images(const char* file_path) const
         const std::string aov_file_path = (directory / aov_file_name).string();
 
         // Write AOV image.
-        ImageAttributes image_attributes = ImageAttributes::create_default_attributes();
-        if (!aov.write_images(aov_file_path.c_str(), image_attributes))
-            success = false;
+        jobs.emplace_back(
+            new ImageOutputJob(
+                [&aov, aov_file_path]()
+                {
+                    ImageAttributes image_attributes = ImageAttributes::create_default_attributes();
+                    return aov.write_images(aov_file_path.c_str(), image_attributes);
+                },
+                get_image_data_size(aov.get_image())));
+        data_size += jobs.back()->get_data_size();
     }
 
+    const bool success = execute_image_output_jobs(jobs, MaxImageWriteThreadCount);
+
+    stopwatch.measure();
+    record_image_output_statistics(impl->m_render_info, nullptr, jobs.size(), data_size, stopwatch.get_seconds());
+
     return success;
 }
 
 bool Frame::write_main_and_aov_images() const
 {
-    bool success = true;
+    Stopwatch<DefaultWallclockTimer> stopwatch;
+    stopwatch.start();
+
+    // The main image and the AOV images are converted and encoded in parallel.
+    ImageOutputJobVector jobs;
 
     // Write main image.
     {
         const std::string file_path = get_parameters().get_optional<std::string>("output_filename");
         if (!file_path.empty())
         {
-            if (!write_main_image(file_path.c_str()))
-                success = false;
+            jobs.emplace_back(
+                new ImageOutputJob(
+                    [this, file_path]()
+                    {
+                        return write_main_image(file_path.c_str());
+                    },
+                    get_image_data_size(*impl->m_image)));
         }
     }
 
@@ -1221,12 +1455,30 @@ bool Frame::write_main_and_aov_images() const
                 bf_file_path.replace_extension(".exr");
             }
 
-            ImageAttributes image_attributes = ImageAttributes::create_default_attributes();
-            if (!aov.write_images(bf_file_path.string().c_str(), image_attributes))
-                success = false;
+            const std::string file_path = bf_file_path.string();
+            jobs.emplace_back(
+                new ImageOutputJob(
+                    [&aov, file_path]()
+                    {
+                        ImageAttributes image_attributes = ImageAttributes::create_default_attributes();
+                        return aov.write_images(file_path.c_str(), image_attributes);
+                    },
+                    get_image_data_size(aov.get_image())));
         }
     }
 
+    if (jobs.empty())
+        return true;
+
+    const bool success = execute_image_output_jobs(jobs, MaxImageWriteThreadCount);
+
+    std::uint64_t data_size = 0;
+    for (const auto& job : jobs)
+        data_size += job->get_data_size();
+
+    stopwatch.measure();
+    record_image_output_statistics(impl->m_render_info, nullptr, jobs.size(), data_size, stopwatch.get_seconds());
+
     return success;
 }
 
@@ -1239,37 +1491,60 @@ void Frame::write_main_and_aov_images_to_multipart_exr(const char* file_path) co
     add_chromaticities_attributes(image_attributes);
     image_attributes.insert("color_space", "linear");
 
-    std::vector<Image> images;
+    // Convert the main image and the AOV images with color data to half floats in parallel.
+    // The main image is always saved as half floats; if an AOV has color data, assume
+    // we can save it as half floats too.
+    std::vector<std::unique_ptr<Image>> half_images(impl->m_aovs.size() + 1);
+    ImageOutputJobVector jobs;
+    std::uint64_t data_size = get_image_data_size(*impl->m_image);
+
+    for (size_t i = 0, e = half_images.size(); i < e; ++i)
+    {
+        const AOV* aov = i > 0 ? impl->m_aovs.get_by_index(i - 1) : nullptr;
+        const Image& image = aov != nullptr ? aov->get_image() : *impl->m_image;
+
+        if (aov != nullptr)
+            data_size += get_image_data_size(image);
+
+        if (aov != nullptr && !aov->has_color_data())
+            continue;
+
+        std::unique_ptr<Image>& half_image = half_images[i];
+        jobs.emplace_back(
+            new ImageOutputJob(
+                [&image, &half_image]()
+                {
+                    const CanvasProperties& props = image.properties();
+                    half_image.reset(new Image(image, props.m_tile_width, props.m_tile_height, PixelFormatHalf));
+                    return true;
+                },
+                get_image_data_size(image)));
+    }
+
+    // Conversions don't involve OpenEXR's thread pool and can use all cores.
+    execute_image_output_jobs(jobs, System::get_logical_cpu_core_count());
 
     create_parent_directories(file_path);
 
     GenericImageFileWriter writer(file_path);
 
-    // Always save the main image as half floats.
+    // Add the main image.
     {
-        const Image& image = *impl->m_image;
-        const CanvasProperties& props = image.properties();
-        images.emplace_back(image, props.m_tile_width, props.m_tile_height, PixelFormatHalf);
-
         image_attributes.insert("image_name", "beauty");
 
-        writer.append_image(&(images.back()));
+        writer.append_image(half_images[0].get());
         writer.set_image_attributes(image_attributes);
     }
 
-    for (const AOV& aov : impl->m_aovs)
+    // Add AOV images.
+    for (size_t i = 0, e = impl->m_aovs.size(); i < e; ++i)
     {
+        const AOV& aov = *impl->m_aovs.get_by_index(i);
         const std::string aov_name = aov.get_name();
-        const Image& image = aov.get_image();
 
-        if (aov.has_color_data())
-        {
-            // If the AOV has color data, assume we can save it as half floats.
-            const CanvasProperties& props = image.properties();
-            images.emplace_back(image, props.m_tile_width, props.m_tile_height, PixelFormatHalf);
-            writer.append_image(&(images.back()));
-        }
-        else writer.append_image(&image);
+        if (half_images[i + 1])
+            writer.append_image(half_images[i + 1].get());
+        else writer.append_image(&aov.get_image());
 
         image_attributes.insert("image_name", aov_name.c_str());
 
@@ -1279,10 +1554,8 @@ void Frame::write_main_and_aov_images_to_multipart_exr(const char* file_path) co
 
     writer.write();
 
-    RENDERER_LOG_INFO(
-        "wrote multipart exr image file %s in %s.",
-        file_path,
-        pretty_time(stopwatch.get_seconds()).c_str());
+    stopwatch.measure();
+    record_image_output_statistics(impl->m_render_info, file_path, half_images.size(), data_size, stopwatch.get_seconds());
 }
 
 bool Frame::archive(
@@ -1434,26 +1707,31 @@ void Frame::extract_parameters()
 
             bf::path bf_path(path.c_str());
 
+            // Derive the checkpoint file name from the output file name.
+            if (use_default_path)
+                bf_path.replace_extension(".checkpoint");
+
             const std::string extension = lower_case(bf_path.extension().string());
 
-            if (extension != ".exr")
+            // Checkpoints are no longer written as OpenEXR files.
+            if (extension == ".exr")
             {
-                // Only .exr files are allowed.
-                RENDERER_LOG_ERROR("checkpoint file must be an \".exr\" file, disabling checkpoint creation.");
-                impl->m_checkpoint_create = false;
+                const std::string legacy_path = bf_path.string();
+                bf_path.replace_extension(".checkpoint");
+
+                RENDERER_LOG_WARNING(
+                    "checkpoints are no longer written as OpenEXR files, writing checkpoint to %s instead of %s.",
+                    bf_path.string().c_str(),
+                    legacy_path.c_str());
+
+                impl->m_checkpoint_create_path = bf_path.string();
             }
-            else
+            else if (extension != ".checkpoint")
             {
-                // Add ".checkpoint" in the filename.
-                if (use_default_path && !ends_with(path, ".checkpoint.exr"))
-                {
-                    const bf::path directory = bf_path.parent_path();
-                    const std::string base_file_name = bf_path.stem().string();
-                    path = (directory / (base_file_name + ".checkpoint.exr")).string();
-                }
-
-                impl->m_checkpoint_create_path = path;
+                RENDERER_LOG_ERROR("checkpoint file must be a \".checkpoint\" file, disabling checkpoint creation.");
+                impl->m_checkpoint_create = false;
             }
+            else impl->m_checkpoint_create_path = bf_path.string();
         }
 
         // Resume option.
@@ -1470,26 +1748,27 @@ void Frame::extract_parameters()
 
             bf::path bf_path(path.c_str());
 
+            // Derive the checkpoint file name from the output file name,
+            // falling back to a legacy OpenEXR checkpoint if there is one.
+            if (use_default_path)
+            {
+                bf::path legacy_path = bf_path;
+                legacy_path.replace_extension(".checkpoint.exr");
+                bf_path.replace_extension(".checkpoint");
+
+                if (!bf::exists(bf_path) && bf::exists(legacy_path))
+                    bf_path = legacy_path;
+            }
+
             const std::string extension = lower_case(bf_path.extension().string());
 
-            if (extension != ".exr")
+            if (extension != ".checkpoint" && extension != ".exr")
             {
-                // Only .exr files are allowed.
-                RENDERER_LOG_ERROR("checkpoint file must be an \".exr\" file, disabling checkpoint resuming.");
+                // Legacy checkpoints were written as OpenEXR files.
+                RENDERER_LOG_ERROR("checkpoint file must be a \".checkpoint\" or a legacy \".exr\" file, disabling checkpoint resuming.");
                 impl->m_checkpoint_resume = false;
             }
-            else
-            {
-                // Add ".checkpoint" in the filename.
-                if (use_default_path && !ends_with(path, ".checkpoint.exr"))
-                {
-                    const bf::path directory = bf_path.parent_path();
-                    const std::string base_file_name = bf_path.stem().string();
-                    path = (directory / (base_file_name + ".checkpoint.exr")).string();
-                }
-
-                impl->m_checkpoint_resume_path = path;
-            }
+            else impl->m_checkpoint_resume_path = bf_path.string();
         }
     }
 
@@ -163,7 +163,8 @@ class APPLESEED_DLLSYMBOL Frame
 
     // Access render info. Render info contain statistics and additional results
     // from the rendering process such as render time. They are used in particular
-    // by the Render Stamp post-processing stage.
+    // by the Render Stamp post-processing stage. Writing images to disk adds the
+    // image_write_size, image_write_time and image_write_throughput entries.
     ParamArray& render_info();
 
     enum class DenoisingMode
@@ -188,24 +189,33 @@ class APPLESEED_DLLSYMBOL Frame
         const size_t                                pass_count);        // total number of passes to render
 
     // Save a checkpoint file to disk if checkpoint creation is enabled.
+    // Only tiles that changed since the previous call are saved, and they
+    // are written to disk in the background.
     void save_checkpoint(
         IShadingResultFrameBufferFactory*           buffer_factory,
         const size_t                                pass_index) const;  // index of the pass to be written
 
+    // Wait until all checkpoint passes are written to disk, write the denoiser's
+    // checkpoint, and record the number of bytes written as checkpoint_write_size
+    // in the render info. Must be called once rendering ends, even if it was aborted.
+    // Returns true if all writes succeeded or checkpoint creation is disabled.
+    bool flush_checkpoint() const;
+
     // Write the main image to disk.
     // Return true if successful, false otherwise.
     bool write_main_image(const char* file_path) const;
 
-    // Write the AOV images to disk.
+    // Write the AOV images to disk. Images are written in parallel.
     // Return true if successful, false otherwise.
     bool write_aov_images(const char* file_path) const;
 
-    // Write the main image and the AOV images to disk.
+    // Write the main image and the AOV images to disk. Images are written in parallel.
     // Output file paths are taken from the frame's and AOVs' "output_filename" parameters.
     // Return true if successful, false otherwise.
     bool write_main_and_aov_images() const;
 
     // Write the main image and the AOV images to a multipart OpenEXR file.
+    // Images are converted to half floats in parallel.
     void write_main_and_aov_images_to_multipart_exr(const char* file_path) const;
 
     // Archive the frame to a given directory on disk. If output_path is provided,
@@ -239,6 +249,12 @@ class APPLESEED_DLLSYMBOL Frame
 
     // Access the internal AOVs.
     AOVContainer& internal_aovs() const;
+
+    // Load a checkpoint written as a multilayer OpenEXR file.
+    bool load_legacy_checkpoint(
+        IShadingResultFrameBufferFactory*           buffer_factory,
+        const size_t                                pass_count,
+        size_t&                                     start_pass);
 };
 
 
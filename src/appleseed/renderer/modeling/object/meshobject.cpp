@@ -165,6 +165,13 @@ size_t MeshObject::push_vertex(const GVector3& vertex)
     return index;
 }
 
+size_t MeshObject::push_vertices(const GVector3 vertices[], const size_t count)
+{
+    const size_t index = impl->m_tess.m_vertices.size();
+    impl->m_tess.m_vertices.insert(impl->m_tess.m_vertices.end(), vertices, vertices + count);
+    return index;
+}
+
 size_t MeshObject::get_vertex_count() const
 {
     return impl->m_tess.m_vertices.size();
@@ -189,6 +196,13 @@ size_t MeshObject::push_vertex_normal(const GVector3& normal)
     return index;
 }
 
+size_t MeshObject::push_vertex_normals(const GVector3 normals[], const size_t count)
+{
+    const size_t index = impl->m_tess.m_vertex_normals.size();
+    impl->m_tess.m_vertex_normals.insert(impl->m_tess.m_vertex_normals.end(), normals, normals + count);
+    return index;
+}
+
 size_t MeshObject::get_vertex_normal_count() const
 {
     return impl->m_tess.m_vertex_normals.size();
@@ -454,6 +468,17 @@ bool MeshObjectFactory::create(
     const SearchPaths&      search_paths,
     const bool              omit_loading_assets,
     ObjectArray&            objects) const
+{
+    return create(name, params, search_paths, omit_loading_assets, 1, objects);
+}
+
+bool MeshObjectFactory::create(
+    const char*             name,
+    const ParamArray&       params,
+    const SearchPaths&      search_paths,
+    const bool              omit_loading_assets,
+    const size_t            thread_count,
+    ObjectArray&            objects) const
 {
     if (params.strings().exist("primitive"))
     {
@@ -476,7 +501,8 @@ bool MeshObjectFactory::create(
             search_paths,
             name,
             params,
-            object_array))
+            object_array,
+            thread_count))
         return false;
 
     objects = array_vector<ObjectArray>(object_array);
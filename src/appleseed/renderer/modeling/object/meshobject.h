@@ -90,12 +90,14 @@ class APPLESEED_DLLSYMBOL MeshObject
     // Insert and access vertices.
     void reserve_vertices(const size_t count);
     size_t push_vertex(const GVector3& vertex);
+    size_t push_vertices(const GVector3 vertices[], const size_t count);     // return the index of the first vertex
     size_t get_vertex_count() const;
     const GVector3& get_vertex(const size_t index) const;
 
     // Insert and access vertex normals.
     void reserve_vertex_normals(const size_t count);
     size_t push_vertex_normal(const GVector3& normal);      // the normal must be unit-length
+    size_t push_vertex_normals(const GVector3 normals[], const size_t count);   // return the index of the first normal
     size_t get_vertex_normal_count() const;
     const GVector3& get_vertex_normal(const size_t index) const;
     void clear_vertex_normals();
@@ -224,6 +226,15 @@ class APPLESEED_DLLSYMBOL MeshObjectFactory
         const foundation::SearchPaths&  search_paths,
         const bool                      omit_loading_assets,
         ObjectArray&                    objects) const override;
+
+    // Same as above, but compressed mesh files may be read using up to thread_count threads.
+    bool create(
+        const char*                     name,
+        const ParamArray&               params,
+        const foundation::SearchPaths&  search_paths,
+        const bool                      omit_loading_assets,
+        const size_t                    thread_count,
+        ObjectArray&                    objects) const;
 };
 
 }   // namespace renderer
@@ -174,26 +174,78 @@ namespace
 
         size_t push_vertex_normal(const Vector3d& v) override
         {
-            GVector3 n(v);
+            return m_objects.back()->push_vertex_normal(normalize_vertex_normal(GVector3(v)));
+        }
 
-            const GScalar norm_n = norm(n);
+        size_t push_tex_coords(const Vector2d& v) override
+        {
+            return m_objects.back()->push_tex_coords(GVector2(v));
+        }
 
-            if (norm_n > GScalar(0.0))
-                n /= norm_n;
-            else
-            {
-                ++m_null_normal_vector_count;
-                n = GVector3(GScalar(1.0), GScalar(0.0), GScalar(0.0));
-            }
+        void push_vertex_array(const Vector3f vertices[], const size_t count) override
+        {
+            m_objects.back()->push_vertices(vertices, count);
+        }
 
-            ++m_normal_count;
+        void push_vertex_normal_array(const Vector3f vertex_normals[], const size_t count) override
+        {
+            m_normals.resize(count);
+
+            for (size_t i = 0; i < count; ++i)
+                m_normals[i] = normalize_vertex_normal(vertex_normals[i]);
 
-            return m_objects.back()->push_vertex_normal(n);
+            if (count > 0)
+                m_objects.back()->push_vertex_normals(&m_normals[0], count);
         }
 
-        size_t push_tex_coords(const Vector2d& v) override
+        void push_tex_coords_array(const Vector2f tex_coords[], const size_t count) override
         {
-            return m_objects.back()->push_tex_coords(GVector2(v));
+            MeshObject* object = m_objects.back();
+            object->reserve_tex_coords(object->get_tex_coords_count() + count);
+
+            for (size_t i = 0; i < count; ++i)
+                object->push_tex_coords(tex_coords[i]);
+        }
+
+        void push_triangle_array(
+            const std::uint32_t     indices[],
+            const std::uint16_t     materials[],
+            const size_t            count) override
+        {
+            MeshObject* object = m_objects.back();
+            object->reserve_triangles(object->get_triangle_count() + count);
+
+            for (size_t i = 0; i < count; ++i)
+            {
+                const std::uint32_t* corners = indices + i * 9;
+
+                Triangle triangle;
+                triangle.m_v0 = corners[0];
+                triangle.m_v1 = corners[3];
+                triangle.m_v2 = corners[6];
+
+                if (!m_ignore_vertex_normals)
+                {
+                    triangle.m_n0 = corners[1];
+                    triangle.m_n1 = corners[4];
+                    triangle.m_n2 = corners[7];
+                }
+                else
+                {
+                    triangle.m_n0 = Triangle::None;
+                    triangle.m_n1 = Triangle::None;
+                    triangle.m_n2 = Triangle::None;
+                }
+
+                triangle.m_a0 = corners[2];
+                triangle.m_a1 = corners[5];
+                triangle.m_a2 = corners[8];
+                triangle.m_pa = materials[i];
+
+                object->push_triangle(triangle);
+            }
+
+            m_face_count += count;
         }
 
         size_t push_material_slot(const char* name) override
@@ -309,6 +361,9 @@ namespace
         std::vector<std::uint32_t>        m_face_tex_coords;
         std::uint32_t                     m_face_material;
 
+        // Support data for bulk insertion of vertex normals.
+        std::vector<GVector3>             m_normals;
+
         // Support data for face triangulation.
         Triangulator<double>              m_triangulator;
         std::vector<Vector3d>             m_polygon;
@@ -332,6 +387,23 @@ namespace
             m_null_normal_vector_count = 0;
         }
 
+        GVector3 normalize_vertex_normal(GVector3 n)
+        {
+            const GScalar norm_n = norm(n);
+
+            if (norm_n > GScalar(0.0))
+                n /= norm_n;
+            else
+            {
+                ++m_null_normal_vector_count;
+                n = GVector3(GScalar(1.0), GScalar(0.0), GScalar(0.0));
+            }
+
+            ++m_normal_count;
+
+            return n;
+        }
+
         std::string make_unique_mesh_name(std::string mesh_name)
         {
             if (mesh_name.empty())
@@ -398,10 +470,14 @@ namespace
         const char*             filename,
         const char*             base_object_name,
         const ParamArray&       params,
+        const size_t            thread_count,
         MeshObjectArray&        objects)
     {
         GenericMeshFileReader reader(filename);
 
+        if (thread_count > 1)
+            reader.set_thread_count(global_logger(), thread_count);
+
         const std::string obj_parsing_mode = params.get_optional<std::string>("obj_parsing_mode", "fast");
 
         if (obj_parsing_mode == "fast")
@@ -701,6 +777,7 @@ namespace
         const StringDictionary& filenames,
         const char*             base_object_name,
         const ParamArray&       params,
+        const size_t            thread_count,
         MeshObjectArray&        objects)
     {
         assert(filenames.size() >= 2);
@@ -721,6 +798,7 @@ namespace
                 search_paths.qualify(key_frames[0].m_filename).c_str(),
                 base_object_name,
                 params,
+                thread_count,
                 objects))
             return false;
 
@@ -743,6 +821,7 @@ namespace
                     search_paths.qualify(filename).c_str(),
                     base_object_name,
                     params,
+                    thread_count,
                     poses))
                 return false;
 
@@ -810,7 +889,8 @@ bool MeshObjectReader::read(
     const SearchPaths&  search_paths,
     const char*         base_object_name,
     const ParamArray&   params,
-    MeshObjectArray&    objects)
+    MeshObjectArray&    objects,
+    const size_t        thread_count)
 {
     assert(base_object_name);
 
@@ -835,6 +915,7 @@ bool MeshObjectReader::read(
                 search_paths.qualify(params.strings().get<std::string>("filename")).c_str(),
                 base_object_name,
                 completed_params,
+                thread_count,
                 objects))
             return false;
     }
@@ -860,6 +941,7 @@ bool MeshObjectReader::read(
                         search_paths.qualify(filenames.begin().value()).c_str(),
                         base_object_name,
                         completed_params,
+                        thread_count,
                         objects))
                     return false;
             }
@@ -883,6 +965,7 @@ bool MeshObjectReader::read(
                         filenames,
                         base_object_name,
                         completed_params,
+                        thread_count,
                         objects))
                     return false;
             }
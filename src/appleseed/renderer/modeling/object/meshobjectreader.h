@@ -60,11 +60,13 @@ class APPLESEED_DLLSYMBOL MeshObjectReader
     // Read mesh objects from disk. The filenames are defined in params.
     // Returns true on success, false otherwise. When false is returned,
     // nothing should be assumed on the state of the objects parameter.
+    // Compressed mesh files may be read using up to thread_count threads.
     static bool read(
         const foundation::SearchPaths&  search_paths,
         const char*                     base_object_name,
         const ParamArray&               params,
-        MeshObjectArray&                objects);
+        MeshObjectArray&                objects,
+        const size_t                    thread_count = 1);
 };
 
 }   // namespace renderer
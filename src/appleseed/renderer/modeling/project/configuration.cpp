@@ -170,6 +170,14 @@ Dictionary Configuration::get_metadata()
             .insert("label", "Render Threads")
             .insert("help", "Number of threads to use for rendering"));
 
+    metadata.insert(
+        "tree_cache_directory",
+        Dictionary()
+            .insert("type", "text")
+            .insert("default", "")
+            .insert("label", "Tree Cache Directory")
+            .insert("help", "Directory where ray tracing acceleration structures are cached across renders; leave empty to disable caching"));
+
 #ifdef APPLESEED_WITH_EMBREE
 
     metadata.insert(
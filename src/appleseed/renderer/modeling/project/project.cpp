@@ -340,6 +340,18 @@ LightPathRecorder& Project::get_light_path_recorder() const
     return impl->m_light_path_recorder;
 }
 
+void Project::set_tree_cache_directory(const char* path)
+{
+    if (impl->m_trace_context)
+        impl->m_trace_context->set_tree_cache_directory(path);
+}
+
+void Project::set_tree_build_thread_count(const size_t thread_count)
+{
+    if (impl->m_trace_context)
+        impl->m_trace_context->set_tree_build_thread_count(thread_count);
+}
+
 #ifdef APPLESEED_WITH_EMBREE
 
 void Project::set_use_embree(const bool value)
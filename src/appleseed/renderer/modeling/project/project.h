@@ -160,6 +160,12 @@ class APPLESEED_DLLSYMBOL Project
     // Access the light path recorder.
     LightPathRecorder& get_light_path_recorder() const;
 
+    // Set the directory where the trace context caches triangle and curve trees.
+    void set_tree_cache_directory(const char* path);
+
+    // Set the number of threads the trace context uses to build triangle trees.
+    void set_tree_build_thread_count(const size_t thread_count);
+
 #ifdef APPLESEED_WITH_EMBREE
     // Set use Embree flag for trace context
     void set_use_embree(const bool value);
@@ -65,6 +65,7 @@
 #include "renderer/modeling/material/material.h"
 #include "renderer/modeling/material/materialfactoryregistrar.h"
 #include "renderer/modeling/object/iobjectfactory.h"
+#include "renderer/modeling/object/meshobject.h"
 #include "renderer/modeling/object/object.h"
 #include "renderer/modeling/object/objectfactoryregistrar.h"
 #include "renderer/modeling/postprocessingstage/ipostprocessingstagefactory.h"
@@ -96,10 +97,12 @@
 #include "renderer/modeling/volume/volumefactoryregistrar.h"
 #include "renderer/utility/paramarray.h"
 #include "renderer/utility/pluginstore.h"
+#include "renderer/utility/settingsparsing.h"
 #include "renderer/utility/transformsequence.h"
 
 // appleseed.foundation headers.
 #include "foundation/containers/dictionary.h"
+#include "foundation/core/concepts/noncopyable.h"
 #include "foundation/core/exceptions/exceptionunsupportedfileformat.h"
 #include "foundation/log/log.h"
 #include "foundation/math/aabb.h"
@@ -110,12 +113,14 @@
 #include "foundation/memory/memory.h"
 #include "foundation/platform/compiler.h"
 #include "foundation/platform/defaulttimers.h"
+#include "foundation/platform/system.h"
 #include "foundation/platform/types.h"
 #include "foundation/string/string.h"
 #include "foundation/utility/api/apiarray.h"
 #include "foundation/utility/api/apistring.h"
 #include "foundation/utility/foreach.h"
 #include "foundation/utility/iterators.h"
+#include "foundation/utility/job.h"
 #include "foundation/utility/otherwise.h"
 #include "foundation/utility/searchpaths.h"
 #include "foundation/utility/stopwatch.h"
@@ -134,6 +139,7 @@
 #include "boost/filesystem/operations.hpp"
 
 // Standard headers.
+#include <algorithm>
 #include <cassert>
 #include <cstddef>
 #include <cstring>
@@ -204,6 +210,286 @@ namespace
     };
 
 
+    //
+    // Creates objects in parallel once the project has been parsed.
+    //
+    // Creating an object may require reading large mesh or curve files. Instead of creating
+    // objects as <object> elements are parsed, element handlers enqueue object loads and
+    // register the assemblies that will receive the resulting objects. All loads are then
+    // executed in parallel, and objects are inserted into their assemblies in document order
+    // such that the resulting scene is identical to the one obtained by loading serially.
+    //
+    // Loads are executed once the whole project has been parsed, so that the number of
+    // threads can be taken from the rendering settings of the final configuration.
+    //
+
+    class ObjectLoader
+      : public NonCopyable
+    {
+      public:
+        static const size_t InvalidLoad = ~size_t(0);
+
+        ObjectLoader(
+            const SearchPaths&  search_paths,
+            const bool          omit_reading_mesh_files)
+          : m_search_paths(search_paths)
+          , m_omit_reading_mesh_files(omit_reading_mesh_files)
+          , m_object_count(0)
+          , m_thread_count(0)
+          , m_loading_time(0.0)
+        {
+        }
+
+        // Enqueue the creation of an object. Return the index of the load.
+        size_t enqueue(
+            const IObjectFactory*       factory,
+            const std::string&          name,
+            const ParamArray&           params)
+        {
+            m_jobs.emplace_back(
+                new LoadObjectJob(
+                    factory,
+                    name,
+                    params,
+                    m_search_paths,
+                    m_omit_reading_mesh_files));
+
+            return m_jobs.size() - 1;
+        }
+
+        // Object loads whose results must be inserted into a given assembly.
+        typedef std::vector<std::pair<Assembly*, std::vector<size_t>>> AssemblyLoadsVector;
+
+        // Register object loads. Assemblies must already belong to the scene, so that
+        // they are still alive when objects are inserted into them.
+        void add_assemblies(const AssemblyLoadsVector& assembly_loads)
+        {
+            m_assemblies.insert(m_assemblies.end(), assembly_loads.begin(), assembly_loads.end());
+        }
+
+        // Execute all enqueued loads using up to a given number of threads,
+        // and insert the resulting objects into their assemblies.
+        void load(
+            const size_t                available_thread_count,
+            EventCounters&              event_counters)
+        {
+            if (m_jobs.empty())
+                return;
+
+            Stopwatch<DefaultWallclockTimer> stopwatch;
+            stopwatch.start();
+
+            // Only spawn threads when there are files to read.
+            m_thread_count =
+                m_omit_reading_mesh_files
+                    ? 1
+                    : std::min(available_thread_count, m_jobs.size());
+
+            // When there are fewer loads than threads, let each load use the spare threads
+            // (e.g. to decompress mesh files in parallel) rather than nesting thread pools.
+            const size_t thread_count_per_load =
+                m_omit_reading_mesh_files
+                    ? 1
+                    : std::max<size_t>(available_thread_count / m_jobs.size(), 1);
+
+            for (const auto& job : m_jobs)
+                job->set_thread_count(thread_count_per_load);
+
+            if (m_thread_count > 1)
+            {
+                JobQueue job_queue;
+                JobManager job_manager(global_logger(), job_queue, m_thread_count);
+
+                for (const auto& job : m_jobs)
+                    job_queue.schedule(job.get(), false);
+
+                job_manager.start();
+                job_queue.wait_until_completion();
+            }
+            else
+            {
+                for (const auto& job : m_jobs)
+                    job->execute(0);
+            }
+
+            for (const auto& job : m_jobs)
+            {
+                if (!job->succeeded())
+                    event_counters.signal_error();
+            }
+
+            for (const auto& entry : m_assemblies)
+            {
+                ObjectContainer& objects = entry.first->objects();
+
+                for (const size_t load : entry.second)
+                {
+                    for (Object*& object_ptr : m_jobs[load]->get_objects())
+                    {
+                        auto_release_ptr<Object> object(object_ptr);
+                        object_ptr = nullptr;
+
+                        if (objects.get_by_name(object->get_name()) != nullptr)
+                        {
+                            RENDERER_LOG_ERROR(
+                                "an entity with the path \"%s\" already exists.",
+                                object->get_path().c_str());
+                            event_counters.signal_error();
+                            continue;
+                        }
+
+                        objects.insert(object);
+                        ++m_object_count;
+                    }
+                }
+            }
+
+            m_jobs.clear();
+            m_assemblies.clear();
+
+            stopwatch.measure();
+            m_loading_time += stopwatch.get_seconds();
+        }
+
+        size_t get_object_count() const
+        {
+            return m_object_count;
+        }
+
+        size_t get_thread_count() const
+        {
+            return m_thread_count;
+        }
+
+        double get_loading_time() const
+        {
+            return m_loading_time;
+        }
+
+      private:
+        typedef std::vector<Object*> ObjectVector;
+
+        class LoadObjectJob
+          : public IJob
+        {
+          public:
+            LoadObjectJob(
+                const IObjectFactory*   factory,
+                const std::string&      name,
+                const ParamArray&       params,
+                const SearchPaths&      search_paths,
+                const bool              omit_reading_mesh_files)
+              : m_factory(factory)
+              , m_name(name)
+              , m_params(params)
+              , m_search_paths(search_paths)
+              , m_omit_reading_mesh_files(omit_reading_mesh_files)
+              , m_thread_count(1)
+              , m_succeeded(true)
+            {
+            }
+
+            void set_thread_count(const size_t thread_count)
+            {
+                m_thread_count = thread_count;
+            }
+
+            ~LoadObjectJob() override
+            {
+                // Release objects that were not inserted into an assembly.
+                for (Object* object : m_objects)
+                {
+                    if (object)
+                        object->release();
+                }
+            }
+
+            void execute(const size_t thread_index) override
+            {
+                try
+                {
+                    // Mesh files are the only assets that can be read with several threads.
+                    const MeshObjectFactory* mesh_factory =
+                        dynamic_cast<const MeshObjectFactory*>(m_factory);
+
+                    ObjectArray objects;
+                    const bool success =
+                        mesh_factory != nullptr
+                            ? mesh_factory->create(
+                                  m_name.c_str(),
+                                  m_params,
+                                  m_search_paths,
+                                  m_omit_reading_mesh_files,
+                                  m_thread_count,
+                                  objects)
+                            : m_factory->create(
+                                  m_name.c_str(),
+                                  m_params,
+                                  m_search_paths,
+                                  m_omit_reading_mesh_files,
+                                  objects);
+                    if (!success)
+                        m_succeeded = false;
+
+                    m_objects = array_vector<ObjectVector>(objects);
+                }
+                catch (const ExceptionDictionaryKeyNotFound& e)
+                {
+                    RENDERER_LOG_ERROR(
+                        "while defining object \"%s\": required parameter \"%s\" missing.",
+                        m_name.c_str(),
+                        e.string());
+                    m_succeeded = false;
+                }
+                catch (const ExceptionUnknownEntity& e)
+                {
+                    RENDERER_LOG_ERROR(
+                        "while defining object \"%s\": unknown entity \"%s\".",
+                        m_name.c_str(),
+                        e.string());
+                    m_succeeded = false;
+                }
+                catch (const Exception& e)
+                {
+                    RENDERER_LOG_ERROR(
+                        "while defining object \"%s\": %s",
+                        m_name.c_str(),
+                        e.what());
+                    m_succeeded = false;
+                }
+            }
+
+            bool succeeded() const
+            {
+                return m_succeeded;
+            }
+
+            ObjectVector& get_objects()
+            {
+                return m_objects;
+            }
+
+          private:
+            const IObjectFactory*                   m_factory;
+            const std::string                       m_name;
+            const ParamArray                        m_params;
+            const SearchPaths&                      m_search_paths;
+            const bool                              m_omit_reading_mesh_files;
+            size_t                                  m_thread_count;
+            bool                                    m_succeeded;
+            ObjectVector                            m_objects;
+        };
+
+        const SearchPaths&                                      m_search_paths;
+        const bool                                              m_omit_reading_mesh_files;
+        std::vector<std::unique_ptr<LoadObjectJob>>             m_jobs;
+        AssemblyLoadsVector                                     m_assemblies;
+        size_t                                                  m_object_count;
+        size_t                                                  m_thread_count;
+        double                                                  m_loading_time;
+    };
+
+
     //
     // A set of objects that is passed to all element handlers.
     //
@@ -218,6 +504,9 @@ namespace
           : m_project(project)
           , m_options(options)
           , m_event_counters(event_counters)
+          , m_object_loader(
+                project.search_paths(),
+                (options & ProjectFileReader::OmitReadingMeshFiles) != 0)
         {
         }
 
@@ -236,10 +525,16 @@ namespace
             return m_event_counters;
         }
 
+        ObjectLoader& get_object_loader()
+        {
+            return m_object_loader;
+        }
+
       private:
         Project&            m_project;
         const int           m_options;
         EventCounters&      m_event_counters;
+        ObjectLoader        m_object_loader;
     };
 
 
@@ -1524,10 +1819,9 @@ namespace
       : public ParametrizedElementHandler
     {
       public:
-        typedef std::vector<Object*> ObjectVector;
-
         explicit ObjectElementHandler(ParseContext& context)
           : m_context(context)
+          , m_load(ObjectLoader::InvalidLoad)
         {
         }
 
@@ -1535,7 +1829,7 @@ namespace
         {
             ParametrizedElementHandler::start_element(attrs);
 
-            clear_keep_memory(m_objects);
+            m_load = ObjectLoader::InvalidLoad;
 
             m_name = get_value(attrs, "name");
             m_model = get_value(attrs, "model");
@@ -1545,67 +1839,33 @@ namespace
         {
             ParametrizedElementHandler::end_element();
 
-            try
-            {
-                const IObjectFactory* factory =
-                    m_context.get_project().get_factory_registrar<Object>().lookup(m_model.c_str());
+            const IObjectFactory* factory =
+                m_context.get_project().get_factory_registrar<Object>().lookup(m_model.c_str());
 
-                if (factory)
-                {
-                    ObjectArray objects;
-                    if (!factory->create(
-                            m_name.c_str(),
-                            m_params,
-                            m_context.get_project().search_paths(),
-                            m_context.get_options() & ProjectFileReader::OmitReadingMeshFiles,
-                            objects))
-                        m_context.get_event_counters().signal_error();
-
-                    m_objects = array_vector<ObjectVector>(objects);
-                }
-                else
-                {
-                    RENDERER_LOG_ERROR(
-                        "while defining object \"%s\": invalid model \"%s\".",
-                        m_name.c_str(),
-                        m_model.c_str());
-                    m_context.get_event_counters().signal_error();
-                }
-            }
-            catch (const ExceptionDictionaryKeyNotFound& e)
-            {
-                RENDERER_LOG_ERROR(
-                    "while defining object \"%s\": required parameter \"%s\" missing.",
-                    m_name.c_str(),
-                    e.string());
-                m_context.get_event_counters().signal_error();
-            }
-            catch (const ExceptionUnknownEntity& e)
+            if (factory)
             {
-                RENDERER_LOG_ERROR(
-                    "while defining object \"%s\": unknown entity \"%s\".",
-                    m_name.c_str(),
-                    e.string());
-                m_context.get_event_counters().signal_error();
+                // The object is created, and its files read, once the whole scene has been parsed.
+                m_load = m_context.get_object_loader().enqueue(factory, m_name, m_params);
             }
-            catch (const Exception& e)
+            else
             {
                 RENDERER_LOG_ERROR(
-                    "while defining object \"%s\": %s",
+                    "while defining object \"%s\": invalid model \"%s\".",
                     m_name.c_str(),
-                    e.what());
+                    m_model.c_str());
                 m_context.get_event_counters().signal_error();
             }
         }
 
-        const ObjectVector& get_objects() const
+        // Return the index of the object load, or ObjectLoader::InvalidLoad.
+        size_t get_object_load() const
         {
-            return m_objects;
+            return m_load;
         }
 
       private:
         ParseContext&   m_context;
-        ObjectVector    m_objects;
+        size_t          m_load;
         std::string     m_name;
         std::string     m_model;
     };
@@ -2039,11 +2299,12 @@ namespace
       protected:
         ParseContext& m_context;
 
+        // Insert an entity into a container. Return false if the entity was discarded.
         template <typename Container, typename Entity>
-        void insert(Container& container, auto_release_ptr<Entity> entity)
+        bool insert(Container& container, auto_release_ptr<Entity> entity)
         {
             if (entity.get() == nullptr)
-                return;
+                return false;
 
             if (container.get_by_name(entity->get_name()) != nullptr)
             {
@@ -2051,10 +2312,11 @@ namespace
                     "an entity with the path \"%s\" already exists.",
                     entity->get_path().c_str());
                 m_context.get_event_counters().signal_error();
-                return;
+                return false;
             }
 
             container.insert(entity);
+            return true;
         }
     };
 
@@ -2086,7 +2348,8 @@ namespace
             m_edfs.clear();
             m_lights.clear();
             m_materials.clear();
-            m_objects.clear();
+            m_object_loads.clear();
+            m_assembly_loads.clear();
             m_object_instances.clear();
             m_volumes.clear();
             m_shader_groups.clear();
@@ -2117,13 +2380,17 @@ namespace
                 m_assembly->edfs().swap(m_edfs);
                 m_assembly->lights().swap(m_lights);
                 m_assembly->materials().swap(m_materials);
-                m_assembly->objects().swap(m_objects);
                 m_assembly->object_instances().swap(m_object_instances);
                 m_assembly->volumes().swap(m_volumes);
                 m_assembly->shader_groups().swap(m_shader_groups);
                 m_assembly->surface_shaders().swap(m_surface_shaders);
                 m_assembly->textures().swap(m_textures);
                 m_assembly->texture_instances().swap(m_texture_instances);
+
+                // Objects are inserted once they have been loaded. The loads are only handed
+                // over to the object loader once this assembly was inserted into the scene.
+                if (!m_object_loads.empty())
+                    m_assembly_loads.emplace_back(m_assembly.get(), m_object_loads);
             }
             else
             {
@@ -2142,9 +2409,14 @@ namespace
             switch (element)
             {
               case ElementAssembly:
-                insert(
-                    m_assemblies,
-                    static_cast<AssemblyElementHandler*>(handler)->get_assembly());
+                {
+                    AssemblyElementHandler* assembly_handler = static_cast<AssemblyElementHandler*>(handler);
+                    if (insert(m_assemblies, assembly_handler->get_assembly()))
+                    {
+                        const ObjectLoader::AssemblyLoadsVector& child_loads = assembly_handler->get_assembly_loads();
+                        m_assembly_loads.insert(m_assembly_loads.end(), child_loads.begin(), child_loads.end());
+                    }
+                }
                 break;
 
               case ElementAssemblyInstance:
@@ -2190,8 +2462,11 @@ namespace
                 break;
 
               case ElementObject:
-                for (Object* object : static_cast<ObjectElementHandler*>(handler)->get_objects())
-                    insert(m_objects, auto_release_ptr<Object>(object));
+                {
+                    const size_t load = static_cast<ObjectElementHandler*>(handler)->get_object_load();
+                    if (load != ObjectLoader::InvalidLoad)
+                        m_object_loads.push_back(load);
+                }
                 break;
 
               case ElementObjectInstance:
@@ -2241,25 +2516,32 @@ namespace
             return m_assembly;
         }
 
+        // Return the object loads of this assembly and of its child assemblies.
+        const ObjectLoader::AssemblyLoadsVector& get_assembly_loads() const
+        {
+            return m_assembly_loads;
+        }
+
       private:
-        auto_release_ptr<Assembly>  m_assembly;
-        std::string                 m_name;
-        std::string                 m_model;
-        AssemblyContainer           m_assemblies;
-        AssemblyInstanceContainer   m_assembly_instances;
-        BSDFContainer               m_bsdfs;
-        BSSRDFContainer             m_bssrdfs;
-        ColorContainer              m_colors;
-        EDFContainer                m_edfs;
-        LightContainer              m_lights;
-        MaterialContainer           m_materials;
-        ObjectContainer             m_objects;
-        ObjectInstanceContainer     m_object_instances;
-        VolumeContainer             m_volumes;
-        ShaderGroupContainer        m_shader_groups;
-        SurfaceShaderContainer      m_surface_shaders;
-        TextureContainer            m_textures;
-        TextureInstanceContainer    m_texture_instances;
+        auto_release_ptr<Assembly>          m_assembly;
+        std::string                         m_name;
+        std::string                         m_model;
+        AssemblyContainer                   m_assemblies;
+        AssemblyInstanceContainer           m_assembly_instances;
+        BSDFContainer                       m_bsdfs;
+        BSSRDFContainer                     m_bssrdfs;
+        ColorContainer                      m_colors;
+        EDFContainer                        m_edfs;
+        LightContainer                      m_lights;
+        MaterialContainer                   m_materials;
+        std::vector<size_t>                 m_object_loads;
+        ObjectLoader::AssemblyLoadsVector   m_assembly_loads;
+        ObjectInstanceContainer             m_object_instances;
+        VolumeContainer                     m_volumes;
+        ShaderGroupContainer                m_shader_groups;
+        SurfaceShaderContainer              m_surface_shaders;
+        TextureContainer                    m_textures;
+        TextureInstanceContainer            m_texture_instances;
     };
 
 
@@ -2290,18 +2572,8 @@ namespace
         {
             ParametrizedElementHandler::end_element();
 
+            // Objects are loaded once the whole project has been parsed.
             m_scene->get_parameters() = m_params;
-
-            const GAABB3 scene_bbox = m_scene->compute_bbox();
-            const Vector3d scene_center(scene_bbox.center());
-
-            RENDERER_LOG_INFO(
-                "scene bounding box: (%f, %f, %f)-(%f, %f, %f).\n"
-                "scene bounding sphere: center (%f, %f, %f), diameter %f.",
-                scene_bbox.min[0], scene_bbox.min[1], scene_bbox.min[2],
-                scene_bbox.max[0], scene_bbox.max[1], scene_bbox.max[2],
-                scene_center[0], scene_center[1], scene_center[2],
-                scene_bbox.diameter());
         }
 
         void end_child_element(
@@ -2313,9 +2585,11 @@ namespace
             switch (element)
             {
               case ElementAssembly:
-                insert(
-                    m_scene->assemblies(),
-                    static_cast<AssemblyElementHandler*>(handler)->get_assembly());
+                {
+                    AssemblyElementHandler* assembly_handler = static_cast<AssemblyElementHandler*>(handler);
+                    if (insert(m_scene->assemblies(), assembly_handler->get_assembly()))
+                        m_context.get_object_loader().add_assemblies(assembly_handler->get_assembly_loads());
+                }
                 break;
 
               case ElementAssemblyInstance:
@@ -2973,6 +3247,32 @@ namespace
             m_context.get_project().set_format_revision(format_revision);
         }
 
+        void end_element() override
+        {
+            ElementHandlerBaseType::end_element();
+
+            // Load all objects of the scene in parallel.
+            m_context.get_object_loader().load(
+                get_loading_thread_count(),
+                m_context.get_event_counters());
+
+            const Scene* scene = m_context.get_project().get_scene();
+
+            if (scene)
+            {
+                const GAABB3 scene_bbox = scene->compute_bbox();
+                const Vector3d scene_center(scene_bbox.center());
+
+                RENDERER_LOG_INFO(
+                    "scene bounding box: (%f, %f, %f)-(%f, %f, %f).\n"
+                    "scene bounding sphere: center (%f, %f, %f), diameter %f.",
+                    scene_bbox.min[0], scene_bbox.min[1], scene_bbox.min[2],
+                    scene_bbox.max[0], scene_bbox.max[1], scene_bbox.max[2],
+                    scene_center[0], scene_center[1], scene_center[2],
+                    scene_bbox.diameter());
+            }
+        }
+
         void end_child_element(
             const ProjectElementID      element,
             ElementHandlerType*         handler) override
@@ -3011,6 +3311,18 @@ namespace
 
       private:
         ParseContext& m_context;
+
+        // Use as many threads as the final configuration uses for rendering.
+        size_t get_loading_thread_count() const
+        {
+            const Configuration* configuration =
+                m_context.get_project().configurations().get_by_name("final");
+
+            return
+                configuration != nullptr
+                    ? get_rendering_thread_count(configuration->get_inherited_parameters())
+                    : System::get_logical_cpu_core_count();
+        }
     };
 
 
@@ -3319,6 +3631,8 @@ auto_release_ptr<Project> XMLProjectFileReader::load_project_file(
 
     // Load the project file.
     RENDERER_LOG_INFO("loading project file %s...", project_filepath);
+    Stopwatch<DefaultWallclockTimer> stopwatch;
+    stopwatch.start();
     try
     {
         parser->parse(project_filepath);
@@ -3331,6 +3645,20 @@ auto_release_ptr<Project> XMLProjectFileReader::load_project_file(
     {
         return auto_release_ptr<Project>(nullptr);
     }
+    stopwatch.measure();
+
+    // Report loading times.
+    const ObjectLoader& object_loader = context.get_object_loader();
+    const double loading_time = object_loader.get_loading_time();
+    RENDERER_LOG_INFO(
+        "project file %s: parsed in %s, loaded %s %s in %s using %s %s.",
+        project_filepath,
+        pretty_time(std::max(stopwatch.get_seconds() - loading_time, 0.0)).c_str(),
+        pretty_uint(object_loader.get_object_count()).c_str(),
+        plural(object_loader.get_object_count(), "object").c_str(),
+        pretty_time(loading_time).c_str(),
+        pretty_uint(object_loader.get_thread_count()).c_str(),
+        plural(object_loader.get_thread_count(), "thread").c_str());
 
     // Report a failure in case of warnings or errors.
     if (error_handler->get_warning_count() > 0 ||
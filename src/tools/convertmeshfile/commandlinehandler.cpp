@@ -56,6 +56,18 @@ CommandLineHandler::CommandLineHandler()
             .add_name("--print-bounding-boxes")
             .add_name("-b")
             .set_description("print mesh bounding boxes"));
+
+    parser().add_option_handler(
+        &m_binarymesh_version
+            .add_name("--binarymesh-version")
+            .set_description("set the version of the binarymesh format to write (4 or 5, default is 4)")
+            .set_syntax("version")
+            .set_exact_value_count(1));
+
+    parser().add_option_handler(
+        &m_uncompressed
+            .add_name("--uncompressed")
+            .set_description("write uncompressed binarymesh files (version 5 only), which can be memory-mapped in place"));
 }
 
 void CommandLineHandler::print_program_usage(
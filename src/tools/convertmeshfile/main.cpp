@@ -48,6 +48,7 @@
 
 // Standard headers.
 #include <cstddef>
+#include <cstdint>
 #include <deque>
 #include <exception>
 #include <list>
@@ -336,6 +337,15 @@ int main(int argc, char* argv[])
     GenericMeshFileWriter writer(output_filepath.c_str());
     try
     {
+        if (cl.m_binarymesh_version.is_set())
+        {
+            writer.set_binarymesh_format(
+                static_cast<std::uint16_t>(cl.m_binarymesh_version.value()),
+                !cl.m_uncompressed.is_set());
+        }
+        else if (cl.m_uncompressed.is_set())
+            LOG_WARNING(logger, "--uncompressed only applies to binarymesh version 5 and was ignored.");
+
         for (const_each<std::list<Mesh>> i = builder.get_meshes(); i; ++i)
         {
             const MeshWalker walker(*i);